@@ -6,9 +6,9 @@
 #include "corefile.h"
 #include "coretexture.h"
 #include "glfunctionlist.h"
-#include "GpaDumpAnalyzeTool.h"
-#include <QMessageBox>
-#include <QString>
+#include "gpaframe.h"
+#include "glstate.h"
+#include "vertexformat.h"
 #include "meshdata.h"
 #include "debugout.h"
 
@@ -34,7 +34,7 @@ string g_primitive_name[10] = {
 };
 
 
-uint32_t fill_uint(unsigned char* parse_ptr, uint32_t num_bytes = 4)
+uint32_t fill_uint(const unsigned char* parse_ptr, uint32_t num_bytes = 4)
 {
 	uint32_t result = 0xdeadbeef;
 	if (num_bytes > 0)
@@ -51,7 +51,7 @@ uint32_t fill_uint(unsigned char* parse_ptr, uint32_t num_bytes = 4)
 	return result;
 }
 
-uint64_t fill_ulong(unsigned char* parse_ptr, uint32_t num_bytes = 8)
+uint64_t fill_ulong(const unsigned char* parse_ptr, uint32_t num_bytes = 8)
 {
 	uint64_t result = 0xdeadbeefdeadbeef;
 	if (num_bytes > 0)
@@ -77,7 +77,7 @@ uint64_t fill_ulong(unsigned char* parse_ptr, uint32_t num_bytes = 8)
 }
 
 
-int32_t fill_int(unsigned char* parse_ptr, uint32_t num_bytes = 4)
+int32_t fill_int(const unsigned char* parse_ptr, uint32_t num_bytes = 4)
 {
 	uint32_t result = 0xdeadbeef;
 	if (num_bytes > 0)
@@ -94,7 +94,7 @@ int32_t fill_int(unsigned char* parse_ptr, uint32_t num_bytes = 4)
 	return *((int32_t*)&result);
 }
 
-uint16_t fill_ushort(unsigned char* parse_ptr, uint32_t num_bytes = 2)
+uint16_t fill_ushort(const unsigned char* parse_ptr, uint32_t num_bytes = 2)
 {
 	uint16_t result = 0xdead;
 	if (num_bytes > 0)
@@ -107,37 +107,37 @@ uint16_t fill_ushort(unsigned char* parse_ptr, uint32_t num_bytes = 2)
 	return result;
 }
 
-uint32_t check_uint(unsigned char* parse_ptr, uint32_t num_bytes = 4)
+uint32_t check_uint(const unsigned char* parse_ptr, uint32_t num_bytes = 4)
 {
 	uint32_t result = fill_uint(parse_ptr, num_bytes);
 	return result;
 }
 
-uint64_t check_ulong(unsigned char* parse_ptr, uint32_t num_bytes = 8)
+uint64_t check_ulong(const unsigned char* parse_ptr, uint32_t num_bytes = 8)
 {
 	uint64_t result = fill_ulong(parse_ptr, num_bytes);
 	return result;
 }
 
-int32_t check_int(unsigned char* parse_ptr, uint32_t num_bytes = 4)
+int32_t check_int(const unsigned char* parse_ptr, uint32_t num_bytes = 4)
 {
 	int32_t result = fill_int(parse_ptr, num_bytes);
 	return result;
 }
 
-uint16_t check_ushort(unsigned char* parse_ptr, uint32_t num_bytes = 2)
+uint16_t check_ushort(const unsigned char* parse_ptr, uint32_t num_bytes = 2)
 {
 	uint16_t result = fill_ushort(parse_ptr, num_bytes);
 	return result;
 }
 
-float check_float(unsigned char* parse_ptr, uint32_t num_bytes = 4)
+float check_float(const unsigned char* parse_ptr, uint32_t num_bytes = 4)
 {
 	uint32_t result = fill_uint(parse_ptr, num_bytes);
 	return *(float*)&result;
 }
 
-uint32_t read_uint(unsigned char*& parse_ptr, uint32_t num_bytes = 4)
+uint32_t read_uint(const unsigned char*& parse_ptr, uint32_t num_bytes = 4)
 {
 	uint32_t result = fill_uint(parse_ptr, num_bytes);
 	parse_ptr+=4;
@@ -225,12 +225,14 @@ struct DataZoneInfo
 
     vector<DataBlockInfo> block_list;
 
-	DataZoneInfo() { memset(this, 0, sizeof(DataZoneInfo)); }
+	DataZoneInfo() : tag_info(TagInfo(0)), link_index(0), buffer_size(0), int_data_address(nullptr) {}
 };
 
 struct CommandZoneInfo
 {
 	TagInfo		tag_info;
+	uint32_t	zone_idx;
+	uint32_t	offset;
 	uint32_t	buffer_size;
 	union
 	{
@@ -241,21 +243,6 @@ struct CommandZoneInfo
 	};
 };
 
-struct BufferDataInfo
-{
-	BufferType		buffer_type;
-	uint32_t		buffer_obj_id;
-	uint32_t		buffer_size;
-	uint32_t		buffer_usage;
-	union
-	{
-		uint32_t*	int_data_address;
-		float*		float_data_address;
-		uint16_t*	short_data_address;
-		char*		byte_data_address;
-	};
-};
-
 void Matrix4fToMatrix4d(const core::matrix4f& src_mat, core::matrix4d& dst_mat)
 {
     core::vec4f row_0 = src_mat.get_row(0);
@@ -268,7 +255,7 @@ void Matrix4fToMatrix4d(const core::matrix4f& src_mat, core::matrix4d& dst_mat)
     dst_mat.set_row(3, core::vec4d(double(row_3.x), double(row_3.y), double(row_3.z), double(row_3.w)));
 }
 
-void CheckValidInternalFormat(uint32_t format)
+bool CheckValidInternalFormat(uint32_t format)
 {
 	uint32_t base_internal_format[] = { kGlDepthComponent, kGlDepthStencil, kGlRed, kGlRg, kGlRgb, kGlRgba };
 	uint32_t sized_internal_format[] = { kGlR8,	kGlR8SNorm,	kGlR16,	kGlR16SNorm, kGlRg8, kGlRg8SNorm, kGlRg16, kGlRg16SNorm, kGlR3G3B2,
@@ -308,10 +295,10 @@ void CheckValidInternalFormat(uint32_t format)
 		}
 	}
 
-	assert(found);
+	return found;
 }
 
-void CheckValidFormat(uint32_t format)
+bool CheckValidFormat(uint32_t format)
 {
 	uint32_t valid_format_list[] = { kGlRed, kGlRg, kGlRgb, kGlBgr, kGlRgba, kGlBgra, kGlRedInteger, kGlRgInteger, kGlRgbInteger, kGlLuminance, kGlLuminanceAlpha,
 								  kGlBgrInteger, kGlRgbaInteger, kGlBgraInteger, kGlStencilIndex, kGlDepthComponent, kGlDepthStencil, kGlAlpha };
@@ -323,10 +310,10 @@ void CheckValidFormat(uint32_t format)
 			found = true;
 	}
 
-	assert(found);
+	return found;
 }
 
-void CheckValidPixelType(uint32_t type)
+bool CheckValidPixelType(uint32_t type)
 {
 	uint32_t void_type_list[] = { kGlUByte, kGlByte, kGlUShort, kGlShort, kGlUInt, kGlInt, kGlFloat, kGlUByte332, kGlUByte332Rev,
 								 kGlUShort565, kGlUShort565Rev, kGlUShort4444, kGlUShort4444Rev, kGlUShort5551, kGlUShort5551Rev,
@@ -338,10 +325,10 @@ void CheckValidPixelType(uint32_t type)
 			found = true;
 	}
 
-	assert(found);
+	return found;
 }
 
-void CheckValidTextureParameterAction(uint32_t action)
+bool CheckValidTextureParameterAction(uint32_t action)
 {
 	uint32_t void_action_list[] = { kGlTextureMagFilter, kGlTextureMinFilter, kGlTextureWrapS, kGlTextureWrapT, kGlTextureWrapRExt, kGlGenerateMipmap,
 								  kGlGenerateMipmapHint, kGlTextureBaseLevel, kGlTextureMaxLevel, kGlTextureMinLod, kGlTextureMaxLod, kGlTextureBorderColor,
@@ -354,10 +341,10 @@ void CheckValidTextureParameterAction(uint32_t action)
 			found = true;
 	}
 
-	assert(found);
+	return found;
 }
 
-void CheckValidTextureEnvMode(uint32_t mode)
+bool CheckValidTextureEnvMode(uint32_t mode)
 {
 	uint32_t void_mode_list[] = { kGlTextureEnvMode, kGlTextureEnvColor, kGlTextureLodBias, kGlCombineRgb, kGlCombineAlpha, kGlSrc0Rgb, kGlSrc1Rgb, kGlSrc2Rgb,
 								  kGlSrc0Alpha, kGlSrc1Alpha, kGlSrc2Alpha, kGlOperand0Rgb, kGlOperand1Rgb, kGlOperand2Rgb, kGlOperand0Alpha,
@@ -369,10 +356,10 @@ void CheckValidTextureEnvMode(uint32_t mode)
 			found = true;
 	}
 
-	assert(found);
+	return found;
 }
 
-void CheckValidTextureEnvOp(uint32_t op)
+bool CheckValidTextureEnvOp(uint32_t op)
 {
 	uint32_t void_ops_list[] = { kGlAdd, kGlAddSigned, kGlInterpolate, kGlModulate, kGlDecal, kGlBlend, kGlReplace, kGlSubstract, kGlCombine,
 								  kGlTexture, kGlConstant, kGlPrimaryColor, kGlPrevious, kGlSrcColor, kGlOneMinusSrcColor, kGlSrcAlpha,	kGlOneMinusSrcAlpha };
@@ -383,10 +370,10 @@ void CheckValidTextureEnvOp(uint32_t op)
 			found = true;
 	}
 
-	assert(found);
+	return found;
 }
 
-void CheckValidBufferUsage(uint32_t usage)
+bool CheckValidBufferUsage(uint32_t usage)
 {
 	uint32_t void_usage_list[] = { kGlStreamDraw, kGlStreamRead, kGlStreamCopy, kGlStaticDraw, kGlStaticRead, kGlStaticCopy,
 								   kGlDynamicDraw, kGlDynamicRead, kGlDynamicCopy };
@@ -397,25 +384,92 @@ void CheckValidBufferUsage(uint32_t usage)
 			found = true;
 	}
 
-	assert(found);
+	return found;
 }
 
-DataZoneInfo FindDataZoneByIndex(const vector<DataZoneInfo>& data_zone_list, uint32_t data_index)
+// command zones are copied with this many zero bytes after them, so decoding arguments a
+// short command does not have reads zeros. commands that change state check their size.
+const uint32_t kGpaCommandPadBytes = 64;
+
+// the zone being parsed, errors found in it are reported against it.
+struct GpaParseContext
+{
+	GpaParseReport*	report;
+	uint32_t		zone_idx;
+	uint32_t		offset;
+	uint32_t		tag;
+
+	void add_error(GpaParseErrorType type) const
+	{
+		GpaParseError error;
+		error.type = type;
+		error.zone_idx = zone_idx;
+		error.offset = offset;
+		error.tag = tag;
+		report->error_list.push_back(error);
+	}
+
+	bool check_value(bool is_valid) const
+	{
+		if (!is_valid)
+		{
+			add_error(kGpaErrorInvalidEnum);
+		}
+		return is_valid;
+	}
+};
+
+const DataZoneInfo* FindDataZoneByIndex(const vector<DataZoneInfo>& data_zone_list, uint32_t data_index)
 {
+	if (data_zone_list.empty())
+	{
+		return nullptr;
+	}
+
 	if (data_index == 0)
 	{
-		return data_zone_list[0];
+		return &data_zone_list[0];
 	}
 	else
 	{
-		assert(data_index >= data_zone_list[0].link_index);
+		if (data_index < data_zone_list[0].link_index)
+		{
+			return nullptr;
+		}
+
 		uint32_t index = data_index - data_zone_list[0].link_index;
-		assert(index < data_zone_list.size());
-		assert(data_zone_list[index].link_index == data_index);
-		return data_zone_list[index];
+		if (index >= data_zone_list.size() || data_zone_list[index].link_index != data_index)
+		{
+			return nullptr;
+		}
+		return &data_zone_list[index];
 	}
 }
 
+// the data zone a command points at if it holds at least min_size bytes.
+const DataZoneInfo* GetDataZone(const vector<DataZoneInfo>& data_zone_list, uint32_t data_index, uint32_t min_size, const GpaParseContext& context)
+{
+	const DataZoneInfo* data_zone_info = FindDataZoneByIndex(data_zone_list, data_index);
+	if (!data_zone_info || data_zone_info->buffer_size < min_size || (min_size > 0 && !data_zone_info->byte_data_address))
+	{
+		context.add_error(kGpaErrorDataReference);
+		return nullptr;
+	}
+
+	return data_zone_info;
+}
+
+bool HasCommandArgs(const CommandZoneInfo& command_zone, uint32_t num_bytes, const GpaParseContext& context)
+{
+	if (command_zone.buffer_size < num_bytes)
+	{
+		context.add_error(kGpaErrorCommandSize);
+		return false;
+	}
+
+	return true;
+}
+
 const DataBlockInfo* FindDataZoneByVsTag(const vector<DataZoneInfo>& data_zone_list, uint32_t vertexstream_tag)
 {
 	if (vertexstream_tag != 0)
@@ -438,62 +492,6 @@ const DataBlockInfo* FindDataZoneByVsTag(const vector<DataZoneInfo>& data_zone_l
     return nullptr;
 }
 
-uint32_t GetDataElementSize(uint32_t data_type)
-{
-	switch (data_type)
-	{
-	case kGlByte:
-	case kGlUByte:
-	case kGlUByte332:
-	case kGlUByte332Rev:
-		return 1;
-	case kGlShort:
-	case kGlUShort:
-	case kGl2Bytes:
-	case kGlUShort565:
-	case kGlUShort565Rev:
-	case kGlUShort4444:
-	case kGlUShort4444Rev:
-	case kGlUShort5551:
-	case kGlUShort5551Rev:
-		return 2;
-	case kGl3Bytes:
-		return 3;
-	case kGlInt:
-	case kGlUInt:
-	case kGlFloat:
-	case kGl4Bytes:
-	case kGlUInt8888:
-	case kGlUInt8888Rev:
-	case kGlUInt1010102:
-	case kGlUInt1010102Rev:
-		return 4;
-	case kGlDouble:
-		return 8;
-	}
-
-	return 4;
-}
-
-enum BindBufferTypeList
-{
-	kGlArrayBufferIdx,
-	kGlAtomicCounterBufferIdx,
-	kGlCopyReadBufferIdx,
-	kGlCopyWriteBufferIdx,
-	kGlDispatchIndirectBufferIdx,
-	kGlDrawIndirectBufferIdx,
-	kGlElementArrayBufferIdx,
-	kGlPixelPackBufferIdx,
-	kGlPixelUnpackBufferIdx,
-	kGlQueryBufferIdx,
-	kGlShaderStorageBufferIdx,
-	kGlTextureBufferIdx,
-	kGlTransformFeedbackBufferIdx,
-	kGlUniformBufferIdx,
-	kGlNumBufferTypeIdx,
-};
-
 struct Vec2
 {
 	float	m_x;
@@ -515,20 +513,8 @@ struct Vec4
 	float	m_w;
 };
 
-struct VertexAttrib
-{
-	uint32_t	is_enabled;
-	uint32_t	data_buffer_obj;
-	uint32_t	num_elements;
-	DataType	data_type;
-	uint32_t	is_normalized;
-	uint32_t	stride;
-	uint32_t	start_offset;
-};
-
 struct DrawCallParameters
 {
-	uint32_t	element_buffer_obj;
 	uint32_t	primitive_type;
 	uint32_t	num_indexes;
 	DataType	data_type;
@@ -540,15 +526,9 @@ struct TextureSlotInfo
     uint32_t        index_in_list;
 };
 
-int32_t g_currentBindTexture = -1;
-int32_t g_current_bind_buffer = -1; // for uploading data only.
-int32_t g_bind_buffer_list[kGlNumBufferTypeIdx];
-
 struct RenderingStates
 {
 	DrawCallParameters		draw_call_params;
-	int32_t					binding_buffer_list[kGlNumBufferTypeIdx];
-    VertexAttrib			m_vertexStream[256];
     TextureSlotInfo			m_textureSlot[256];
     core::matrix4f			m_transform_matrix;
     core::matrix4d			m_first_inv_transform_matrix;
@@ -556,33 +536,145 @@ struct RenderingStates
 	RenderingStates() 
 	{ 
         for (int i = 0; i < 256; i++) m_textureSlot[i].index_in_list = INVALID_VALUE;
-        for (int i = 0; i < 16; i++) m_vertexStream[i].is_enabled = 0;
-		for (int i = 0; i < kGlNumBufferTypeIdx; i++) binding_buffer_list[i] = -1;
 	}
 };
 
+// the list entry of a texture object, added on its first bind.
+uint32_t GetTextureListIndex(GlStateEmulator& gl_state, uint64_t texture_key, GroupMeshData* group_mesh_data)
+{
+	GlTextureObject* texture = gl_state.get_texture(texture_key);
+	if (!texture)
+	{
+		return INVALID_VALUE;
+	}
+
+	if (texture->list_idx == INVALID_VALUE)
+	{
+        core::Texture2DInfo* tex_info = new core::Texture2DInfo;
+        tex_info->m_objectId = GetGlObjectName(texture_key);
+        tex_info->m_levelCount = 0;
+        texture->list_idx = uint32_t(group_mesh_data->loaded_textures.size());
+        group_mesh_data->loaded_textures.push_back(tex_info);
+	}
+	return texture->list_idx;
+}
+
+// the texture bound to target on the active unit if there is one and it has the mip level.
+core::Texture2DInfo* GetBoundTexture(GlStateEmulator& gl_state, uint32_t target, GroupMeshData* group_mesh_data, uint32_t level, const GpaParseContext& context)
+{
+	uint64_t texture_key = gl_state.get_bound_texture(gl_state.get_active_texture_unit(), GetGlTextureBindTarget(target));
+	uint32_t list_idx = GetTextureListIndex(gl_state, texture_key, group_mesh_data);
+	if (list_idx >= group_mesh_data->loaded_textures.size())
+	{
+		context.add_error(kGpaErrorObjectId);
+		return nullptr;
+	}
+
+	core::Texture2DInfo* tex_info = group_mesh_data->loaded_textures[list_idx];
+	if (level >= sizeof(tex_info->m_mips) / sizeof(tex_info->m_mips[0]))
+	{
+		context.add_error(kGpaErrorObjectId);
+		return nullptr;
+	}
+
+	return tex_info;
+}
+
+// the bytes a stream reads, from its buffer object or else from the vertex stream block
+// tagged with offset. false without data or if the start is past the buffer.
+bool GetStreamRange(const GlStateEmulator& gl_state,
+                    uint64_t buffer_key,
+                    uint64_t offset,
+                    const vector<DataZoneInfo>& data_zone_list,
+                    const GpaParseContext& context,
+                    const char*& start_address,
+                    size_t& num_bytes)
+{
+	start_address = nullptr;
+	num_bytes = 0;
+	if (buffer_key != 0)
+	{
+		const GlBufferObject* buffer = gl_state.get_buffer(buffer_key);
+		if (!buffer)
+		{
+			context.add_error(kGpaErrorObjectId);
+			return false;
+		}
+
+		if (offset > buffer->num_bytes)
+		{
+			context.add_error(kGpaErrorBufferRange);
+			return false;
+		}
+
+		start_address = reinterpret_cast<const char*>(buffer->data) + offset;
+		num_bytes = buffer->num_bytes - size_t(offset);
+	}
+	else
+	{
+		const DataBlockInfo* block_data = offset <= UINT32_MAX ? FindDataZoneByVsTag(data_zone_list, uint32_t(offset)) : nullptr;
+		if (block_data)
+		{
+			start_address = block_data->byte_data_address;
+			num_bytes = size_t(block_data->block_size);
+		}
+	}
+
+	return start_address != nullptr;
+}
+
+// decode one attribute, an instanced one holds the value of the first instance for every vertex.
+template <class T>
+void DecodeStreamData(const GlStateEmulator& gl_state,
+                      const GlVertexAttrib& stream,
+                      uint32_t num_components,
+                      const vector<DataZoneInfo>& data_zone_list,
+                      const GpaParseContext& context,
+                      vector<T>& stream_data)
+{
+	const char* start_address;
+	size_t num_bytes;
+	if (!IsValidVertexFormat(stream.format) || stream.stride == 0)
+	{
+		context.add_error(kGpaErrorInvalidEnum);
+	}
+	else if (GetStreamRange(gl_state, stream.buffer_key, stream.offset, data_zone_list, context, start_address, num_bytes))
+	{
+		size_t max_elements = stream.divisor == 0 ? SIZE_MAX : 1;
+		stream_data.resize(min(num_bytes / stream.stride + 1, max_elements));
+		stream_data.resize(DecodeVertexStream(reinterpret_cast<const uint8_t*>(start_address), num_bytes, stream.stride,
+											  stream.format, &stream_data[0][0], num_components, max_elements));
+	}
+}
+
 void CreateObjectFile(RenderingStates const& current_state, 
-                    vector<core::matrix4f> matrix_stack,
-                    const vector<BufferDataInfo>& buffer_data_list,
+                    const GlStateEmulator& gl_state,
+                    const vector<core::matrix4f>& matrix_stack,
                     const vector<DataZoneInfo>& data_zone_list,
                     string obj_name,
                     string mtl_file_name,
+                    const GpaParseContext& context,
 					MeshData*& mesh_data)
 {
 /*    if (mtl_file_name == string("material_triangles_303.mtl")) {
         int hit = 1;
     }*/
 
-	bool has_mesh_data_texture = current_state.m_vertexStream[0].is_enabled &&
-								 current_state.m_vertexStream[0].data_buffer_obj != (uint32_t)-1 &&
-								 current_state.m_vertexStream[3].is_enabled &&
-								 current_state.m_vertexStream[3].data_buffer_obj != (uint32_t)-1 &&
-								 current_state.draw_call_params.data_type != (DataType)-1 &&
-								 current_state.draw_call_params.element_buffer_obj != (uint32_t)-1;
+	const GlVertexAttrib& position_stream = gl_state.get_vertex_attrib(0);
+	const GlVertexAttrib& color_stream = gl_state.get_vertex_attrib(2);
+	const GlVertexAttrib& uv_stream = gl_state.get_vertex_attrib(3);
+	uint64_t element_buffer_key = gl_state.get_element_buffer();
+
+	bool has_mesh_data_texture = position_stream.b_enabled &&
+								 position_stream.buffer_key != 0 &&
+								 uv_stream.b_enabled &&
+								 uv_stream.buffer_key != 0 &&
+								 current_state.draw_call_params.data_type != kGlNoDataType &&
+								 element_buffer_key != 0;
 
-	bool has_draw_data = current_state.m_vertexStream[0].is_enabled &&
-						 (current_state.m_vertexStream[0].data_buffer_obj != (uint32_t)-1 ||
-						  current_state.m_vertexStream[0].start_offset > 0);
+	bool has_draw_data = position_stream.b_enabled &&
+						 (position_stream.buffer_key != 0 ||
+						  position_stream.offset > 0);
 
     bool is_ge_polygon = current_state.draw_call_params.primitive_type == kGlTriangleStrip;
     bool is_ge_mesh = current_state.draw_call_params.primitive_type == kGlTriangles;
@@ -597,153 +689,90 @@ void CreateObjectFile(RenderingStates const& current_state,
         vector<core::vec3f> position_data;
         vector<core::vec2f> texture_coord_data;
         vector<uint32_t> color_data;
-        vector<uint16_t> index_data;
+        vector<uint32_t> index_data;
 		position_data.reserve(10240);
 		texture_coord_data.reserve(10240);
 		color_data.reserve(10240);
 		index_data.reserve(10240);
 
-        uint32_t block_size = 0;
-
-		if (current_state.m_vertexStream[0].is_enabled)
+		if (position_stream.b_enabled)
 		{
-			char* start_address = nullptr;
-			char* end_address = nullptr;
-			if (current_state.m_vertexStream[0].data_buffer_obj != (uint32_t)-1)
-			{
-				BufferDataInfo data_info = buffer_data_list[current_state.m_vertexStream[0].data_buffer_obj];
-				start_address = data_info.byte_data_address + current_state.m_vertexStream[0].start_offset;
-				end_address = data_info.byte_data_address + data_info.buffer_size;
-			}
-			else
-			{
-				const DataBlockInfo* block_data = FindDataZoneByVsTag(data_zone_list, current_state.m_vertexStream[0].start_offset);
-				if (block_data)
-				{
-					start_address = block_data->byte_data_address;
-					end_address = block_data->byte_data_address + block_data->block_size;
-
-                    block_size = block_data->block_size;
-				}
-			}
-
-            while (start_address < end_address)
-			{
-				assert(current_state.m_vertexStream[0].num_elements == 3);
-                float x = check_float(reinterpret_cast<uint8_t*>(start_address) + 4 * 0);
-                float y = check_float(reinterpret_cast<uint8_t*>(start_address) + 4 * 1);
-                float z = check_float(reinterpret_cast<uint8_t*>(start_address) + 4 * 2);
-
-                position_data.push_back(core::vec3f(x, y, z));
-
-				start_address += current_state.m_vertexStream[0].stride;
-			}
+			DecodeStreamData(gl_state, position_stream, 3, data_zone_list, context, position_data);
 		}
 
-		if (current_state.m_vertexStream[3].is_enabled)
+		if (uv_stream.b_enabled && uv_stream.buffer_key != 0)
 		{
-            if (current_state.m_vertexStream[3].data_buffer_obj != INVALID_VALUE)
-			{
-				BufferDataInfo data_info = buffer_data_list[current_state.m_vertexStream[3].data_buffer_obj];
-				char* start_address = data_info.byte_data_address + current_state.m_vertexStream[3].start_offset;
-
-                while (start_address < data_info.byte_data_address + data_info.buffer_size)
-				{
-                    core::vec2f uv;
-                    for (int32_t i = 0; i < int32_t(current_state.m_vertexStream[3].num_elements); i++)
-					{
-                        uv[i] = check_float(reinterpret_cast<uint8_t*>(start_address) + 4 * i);
-					}
-
-					texture_coord_data.push_back(uv);
-					start_address += current_state.m_vertexStream[3].stride;
-				}
-			}
+			DecodeStreamData(gl_state, uv_stream, 2, data_zone_list, context, texture_coord_data);
 		}
 
-        if (is_ge_polygon && current_state.m_vertexStream[2].is_enabled) // color channel.
+        if (is_ge_polygon && color_stream.b_enabled) // color channel.
 		{
-			char* start_address = nullptr;
-			char* end_address = nullptr;
-            if (current_state.m_vertexStream[2].data_buffer_obj != INVALID_VALUE)
+			const char* start_address;
+			size_t num_bytes;
+			// color bytes mean 0 to 255 whether or not the capture flagged them normalized.
+			VertexFormat color_format = color_stream.format;
+			color_format.b_normalized = true;
+			if (!IsValidVertexFormat(color_format) || color_stream.stride == 0)
 			{
-				BufferDataInfo data_info = buffer_data_list[current_state.m_vertexStream[2].data_buffer_obj];
-				start_address = data_info.byte_data_address + current_state.m_vertexStream[2].start_offset;
-				end_address = data_info.byte_data_address + data_info.buffer_size;
+				context.add_error(kGpaErrorInvalidEnum);
 			}
-			else
+			else if (GetStreamRange(gl_state, color_stream.buffer_key, color_stream.offset, data_zone_list, context, start_address, num_bytes))
 			{
-				const DataBlockInfo* block_data = FindDataZoneByVsTag(data_zone_list, current_state.m_vertexStream[2].start_offset);
-				if (block_data)
-				{
-					start_address = block_data->byte_data_address;
-					end_address = block_data->byte_data_address + block_data->block_size;
-				}
-			}
-
-            while (start_address < end_address)
-			{
-				uint32_t color = 0;
-				for (uint32_t i = 0; i < current_state.m_vertexStream[2].num_elements; i++)
-				{
-                    uint32_t value = (reinterpret_cast<uint8_t*>(start_address))[i];
-					color |= (value << (8 * i));
-				}
-				color_data.push_back(color);
-				start_address += current_state.m_vertexStream[2].stride;
+				size_t max_elements = color_stream.divisor == 0 ? SIZE_MAX : 1;
+				color_data.resize(min(num_bytes / color_stream.stride + 1, max_elements));
+				color_data.resize(DecodeVertexColorStream(reinterpret_cast<const uint8_t*>(start_address), num_bytes, color_stream.stride,
+														  color_format, color_data.data(), max_elements));
 			}
 		}
 
-        if (current_state.draw_call_params.data_type != DataType(-1)) // drawelements.
+		// an instanced attribute holds one value, every vertex of the first instance reads it.
+		if (uv_stream.divisor != 0 && texture_coord_data.size() == 1)
 		{
-			char* start_address = nullptr;
-			char* end_address = nullptr;
+			texture_coord_data.resize(max(position_data.size(), size_t(1)), texture_coord_data[0]);
+		}
+		if (color_stream.divisor != 0 && color_data.size() == 1)
+		{
+			color_data.resize(max(position_data.size(), size_t(1)), color_data[0]);
+		}
 
-            if (current_state.m_vertexStream[2].data_buffer_obj != INVALID_VALUE &&
-                current_state.draw_call_params.element_buffer_obj != INVALID_VALUE)
-			{
-				BufferDataInfo data_info = buffer_data_list[current_state.draw_call_params.element_buffer_obj];
-				start_address = data_info.byte_data_address + current_state.draw_call_params.data_offset;
-				end_address = data_info.byte_data_address + data_info.buffer_size;
-			}
-			else
-			{
-				const DataBlockInfo* block_data = FindDataZoneByVsTag(data_zone_list, current_state.draw_call_params.data_offset);
-				if (block_data)
+        if (current_state.draw_call_params.data_type != kGlNoDataType) // drawelements.
+		{
+			const char* start_address;
+			size_t num_bytes;
+			uint32_t index_size = current_state.draw_call_params.data_type == kGlUByte ? 1 :
+								  current_state.draw_call_params.data_type == kGlUShort ? 2 :
+								  current_state.draw_call_params.data_type == kGlUInt ? 4 : 0;
+			if (index_size == 0)
+			{
+				context.add_error(kGpaErrorInvalidEnum);
+			}
+			// the element buffer of the bound vertex array, else the indexes are client memory.
+			else if (GetStreamRange(gl_state, element_buffer_key, current_state.draw_call_params.data_offset, data_zone_list, context, start_address, num_bytes))
+			{
+				const uint8_t* index_address = reinterpret_cast<const uint8_t*>(start_address);
+				size_t num_indexes = current_state.draw_call_params.num_indexes;
+				size_t num_stored = num_bytes / index_size;
+				if (num_indexes > num_stored)
 				{
-					start_address = block_data->byte_data_address;
-					end_address = block_data->byte_data_address + block_data->block_size;
+					context.add_error(kGpaErrorBufferRange);
 				}
-			}
 
-			if (current_state.draw_call_params.primitive_type == kGlTriangles)
-			{
-				for (uint32_t i = 0; i < current_state.draw_call_params.num_indexes; i += 3)
+				size_t num_read = min(num_indexes, num_stored);
+				if (current_state.draw_call_params.primitive_type == kGlTriangles)
 				{
-                    uint16_t idx0 = check_ushort(reinterpret_cast<uint8_t*>(start_address));
-                    uint16_t idx1 = check_ushort(reinterpret_cast<uint8_t*>(start_address + 2));
-                    uint16_t idx2 = check_ushort(reinterpret_cast<uint8_t*>(start_address + 4));
-					index_data.push_back(idx0);
-					index_data.push_back(idx1);
-					index_data.push_back(idx2);
-					start_address += sizeof(uint16_t) * 3;
+					num_read -= num_read % 3;
 				}
-			}
-            else if (current_state.draw_call_params.primitive_type == kGlTriangleStrip) {
-                for (uint32_t i = 0; i < current_state.draw_call_params.num_indexes; i ++)
-                {
-                    uint16_t idx0 = check_ushort(reinterpret_cast<uint8_t*>(start_address));
-                    index_data.push_back(idx0);
-                    start_address += sizeof(uint16_t);
-                }
-            }
-			else if (current_state.draw_call_params.primitive_type == kGlLineStrip)
-			{
-				for (uint32_t i = 0; i < current_state.draw_call_params.num_indexes; i ++)
+				else if (current_state.draw_call_params.primitive_type != kGlTriangleStrip &&
+						 current_state.draw_call_params.primitive_type != kGlLineStrip)
 				{
-                    uint16_t idx0 = check_ushort(reinterpret_cast<uint8_t*>(start_address));
-					index_data.push_back(idx0);
-					start_address += sizeof(uint16_t);
+					num_read = 0;
+				}
+
+				for (size_t i = 0; i < num_read; i++)
+				{
+					const uint8_t* index_ptr = index_address + i * index_size;
+					index_data.push_back(index_size == 1 ? *index_ptr :
+										 index_size == 2 ? check_ushort(index_ptr) : check_uint(index_ptr));
 				}
 			}
 		}
@@ -782,27 +811,37 @@ void CreateObjectFile(RenderingStates const& current_state,
                 for (uint32_t i = 0; i < num_vertex; i++)
 				{
                     vertex_list[i] = position_data[uint32_t(new_index_match_table[i])];
-                    assert(new_index_match_table[i] < position_data.size());
 				}
             }
 
+			// uv and color streams shorter than the positions leave the rest zero.
             if (texture_coord_data.size() > 0)
 			{
+				if (texture_coord_data.size() < position_data.size())
+				{
+					context.add_error(kGpaErrorBufferRange);
+				}
+
                 mesh_data->uv_list = make_unique<core::vec2f[]>(num_vertex);
                 for (uint32_t i = 0; i < num_vertex; i++)
 				{
-                    mesh_data->uv_list[i] = texture_coord_data[uint32_t(new_index_match_table[i])];
-					assert(new_index_match_table[i] < texture_coord_data.size());
+					uint32_t idx = uint32_t(new_index_match_table[i]);
+                    mesh_data->uv_list[i] = idx < texture_coord_data.size() ? texture_coord_data[idx] : core::vec2f(0.0f, 0.0f);
 				}
 			}
 
 			if (color_data.size() > 0)
 			{
+				if (color_data.size() < position_data.size())
+				{
+					context.add_error(kGpaErrorBufferRange);
+				}
+
                 mesh_data->color_list = make_unique<uint32_t[]>(num_vertex);
                 for (uint32_t i = 0; i < num_vertex; i++)
 				{
-                    mesh_data->color_list[i] = color_data[uint32_t(new_index_match_table[i])];
-					assert(new_index_match_table[i] < color_data.size());
+					uint32_t idx = uint32_t(new_index_match_table[i]);
+                    mesh_data->color_list[i] = idx < color_data.size() ? color_data[idx] : 0;
 				}
 			}
 
@@ -824,7 +863,7 @@ void CreateObjectFile(RenderingStates const& current_state,
                 {
                     mesh_data->add_draw_call_list(kGlTriangles, int32_t(index_data.size()), int32_t(num_vertex));
                     DrawCallInfo& last_draw_call_info = mesh_data->get_last_draw_call_info();
-                    for (uint32_t i = 0; i < index_data.size(); i += 3)
+                    for (uint32_t i = 0; i + 2 < index_data.size(); i += 3)
 					{
 						if (index_data[i + 0] < index_match_table.size() &&
 							index_data[i + 1] < index_match_table.size() &&
@@ -837,6 +876,12 @@ void CreateObjectFile(RenderingStates const& current_state,
 					}
 				}
 			}
+
+			// callers look at the first draw call, a mesh of other primitives is dropped.
+			if (mesh_data->draw_call_list.empty())
+			{
+				SAFE_DELETE(mesh_data);
+			}
 		}
 
         if (mesh_data)
@@ -846,65 +891,51 @@ void CreateObjectFile(RenderingStates const& current_state,
 	}
 }
 
-void CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_mesh_data)
+bool ParseGpaFrame(const uint8_t* data, size_t size, GroupMeshData* group_mesh_data, GpaParseReport* report)
 {
+    GpaFrameIndex index;
+    BuildGpaFrameIndex(data, size, index);
+    return ParseGpaFrame(data, size, index, group_mesh_data, report);
+}
+
+bool ParseGpaFrame(const uint8_t* data, size_t size, const GpaFrameIndex& index, GroupMeshData* group_mesh_data, GpaParseReport* report)
+{
+    GpaParseReport local_report;
+    if (!report)
+    {
+        report = &local_report;
+    }
+    *report = GpaParseReport();
+
     vector<CommandZoneInfo> command_zone_list;
     vector<DataZoneInfo> data_zone_list;
-    vector<BufferDataInfo> buffer_data_list;
     vector<core::matrix4f> matrix_stack;
 
 	data_zone_list.reserve(0x10000);
 	uint32_t num_dispatches = 0;
-
-    uint32_t length = 0;
-    uint8_t* buffer = reinterpret_cast<uint8_t*>(core::LoadFileToMemory(dump_file_name, length));
     bool mesh_dump_done = false;
 
-	if (length > 0)
-	{
-        uint8_t* parse_ptr = buffer;
-		uint32_t file_tag = read_uint(parse_ptr);
+    // objects and bindings as the capture creates them, replayed in command order.
+    GlStateEmulator gl_state;
 
-		if (file_tag == 0xaabbccdd)
+    GpaParseContext context = { report, 0, 0, 0 };
+	if (data && index.file_size == size)
+	{
+		if (index.b_valid)
 		{
-			uint32_t version_number = read_uint(parse_ptr);
             uint32_t counter = INVALID_VALUE;
 
-            while (!mesh_dump_done)
-			{
-                uint32_t offset = uint32_t(parse_ptr - buffer);
-                assert(offset < length);
-
-				uint32_t num_bytes = read_uint(parse_ptr);
-				uint32_t block_tag = read_uint(parse_ptr);
-
-				CommandBlockInfo this_info;
-				this_info.m_offset = offset;
-				this_info.m_numBytes = num_bytes;
-                this_info.m_blockTag = TagInfo(block_tag);
-				this_info.m_data1 = check_uint(parse_ptr, num_bytes);
-				this_info.m_data2 = check_uint(parse_ptr + 4, num_bytes > 4 ? num_bytes - 4 : 0);
-				this_info.m_data3 = check_uint(parse_ptr + 8, num_bytes > 8 ? num_bytes - 8 : 0);
-				this_info.m_data4 = check_uint(parse_ptr + 12, num_bytes > 12 ? num_bytes - 12 : 0);
-				this_info.m_data5 = check_uint(parse_ptr + 16, num_bytes > 16 ? num_bytes - 16 : 0);
-				this_info.m_data6 = check_uint(parse_ptr + 20, num_bytes > 20 ? num_bytes - 20 : 0);
-				this_info.m_data7 = check_uint(parse_ptr + 24, num_bytes > 24 ? num_bytes - 24 : 0);
-				this_info.m_data8 = check_uint(parse_ptr + 28, num_bytes > 28 ? num_bytes - 28 : 0);
-
-				uint32_t data_value = 0x37692;
-				if (this_info.m_data1 == data_value ||
-					this_info.m_data2 == data_value ||
-					this_info.m_data3 == data_value ||
-					this_info.m_data4 == data_value ||
-					this_info.m_data5 == data_value ||
-					this_info.m_data6 == data_value ||
-					this_info.m_data7 == data_value ||
-					this_info.m_data8 == data_value)
-				{
-				}
-				// end of file parse.
-				if (block_tag == 0xf0000000)
-					break;
+            // the index lists zones up to the end tag, or up to the first one running past the
+            // end of the file. zones are only delimited by their sizes, nothing after that can be found.
+            for (uint32_t i_zone = 0; i_zone < index.zone_list.size(); i_zone++)
+			{
+                const GpaZoneEntry& zone = index.zone_list[i_zone];
+                context = { report, i_zone, uint32_t(zone.offset), zone.tag };
+                report->num_zones++;
+
+                const uint8_t* parse_ptr = data + zone.offset + 8;
+				uint32_t num_bytes = zone.num_bytes;
+				uint32_t block_tag = zone.tag;
 
 				if ((block_tag & 0xf0000000) == 0x50000000)
 				{
@@ -916,56 +947,78 @@ void CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_m
 				{
 					if (block_tag == 0x30001001)
 					{
-						uint32_t flag0 = check_uint(parse_ptr);
-						uint32_t flag1 = check_uint(parse_ptr + 4);
-						uint32_t flag2 = check_uint(parse_ptr + 8);
-						uint32_t size = check_uint(parse_ptr + 12);
-						uint32_t format = check_uint(parse_ptr + 16) & 0xffff;
-
-						uint32_t w = size & 0xffff;
-						uint32_t h = size >> 16;
-
-						char* src_buffer = (char*)parse_ptr + 18;
-
-                        core::ExportBmpImageFile(g_root_folder_name + "/capture.bmp", src_buffer, num_bytes - 18, w, h);
+                        if (num_bytes < 18)
+                        {
+                            context.add_error(kGpaErrorZoneSize);
+                            report->num_skipped_zones++;
+                        }
+                        else
+                        {
+						    uint32_t image_size = check_uint(parse_ptr + 12);
+						    uint32_t w = image_size & 0xffff;
+						    uint32_t h = image_size >> 16;
+
+						    const char* src_buffer = reinterpret_cast<const char*>(parse_ptr) + 18;
+
+                            core::ExportBmpImageFile(g_root_folder_name + "/capture.bmp", src_buffer, num_bytes - 18, w, h);
+                        }
 					}
 				}
 				// data zone.
 				else if ((block_tag & 0xf0000000) == 0x20000000)
 				{
-					uint32_t stamp = check_uint(parse_ptr);
-
-					if (counter == -1)					{
-						counter = stamp;
-					}
-					else
+					const uint32_t header_size = 4;
+                    uint32_t expected_stamp = counter == INVALID_VALUE ? 0 : counter + 1;
+					uint32_t stamp = num_bytes >= header_size ? check_uint(parse_ptr) : expected_stamp;
+
+                    // a damaged zone is kept empty under the stamp it should have had, so the
+                    // zones after it are still found by theirs.
+                    bool is_damaged = false;
+                    if (num_bytes < header_size)
+                    {
+                        context.add_error(kGpaErrorZoneSize);
+                        is_damaged = true;
+                    }
+					else if (counter != INVALID_VALUE && stamp != expected_stamp)
 					{
-						assert((counter + 1) == stamp);
-						counter = stamp;
+                        context.add_error(kGpaErrorZoneStamp);
+                        stamp = expected_stamp;
+                        is_damaged = true;
 					}
+					counter = stamp;
 
 					DataZoneInfo data_info;
-					const int header_size = 4;
-					uint32_t zone_uint_size = (this_info.m_numBytes - header_size + 3) / 4;
 					data_info.tag_info = (TagInfo)block_tag;
 					data_info.link_index = stamp;
-					data_info.buffer_size = this_info.m_numBytes - header_size;
-					data_info.int_data_address = 0;
+					data_info.buffer_size = 0;
+					data_info.int_data_address = nullptr;
 
-					if ((TagInfo)block_tag == kVertexStreamBlock)
+                    if (is_damaged)
+                    {
+                        report->num_skipped_zones++;
+                    }
+					else if ((TagInfo)block_tag == kVertexStreamBlock)
 					{
-                        uint8_t* block_parse_ptr = parse_ptr + 4;
-                        uint8_t* parse_end_ptr = parse_ptr + this_info.m_numBytes - header_size;
+                        const uint8_t* block_parse_ptr = parse_ptr + header_size;
+                        const uint8_t* parse_end_ptr = parse_ptr + num_bytes;
 						while (block_parse_ptr < parse_end_ptr)
 						{
+                            size_t bytes_left = size_t(parse_end_ptr - block_parse_ptr);
+                            uint64_t block_size = bytes_left >= 16 ? check_ulong(block_parse_ptr + 8) : 0;
+                            if (bytes_left < 16 || block_size > bytes_left - 16)
+                            {
+                                context.add_error(kGpaErrorDataBlock);
+                                break;
+                            }
+
 							DataBlockInfo data_block_info;
 							data_block_info.ref_tag = check_ulong(block_parse_ptr);
-							data_block_info.block_size = check_ulong(block_parse_ptr + 8);
+							data_block_info.block_size = block_size;
                             uint32_t num_uint = uint32_t((data_block_info.block_size + 3) / 4);
 							data_block_info.int_data_address = new uint32_t[num_uint];
 							memcpy(data_block_info.int_data_address, block_parse_ptr + 16, data_block_info.block_size);
-                            uint32_t bytes_left = uint32_t(num_uint * 4 - data_block_info.block_size);
-							memset((char*)data_block_info.int_data_address + data_block_info.block_size, 0, bytes_left);
+                            uint32_t pad_bytes = uint32_t(num_uint * 4 - data_block_info.block_size);
+							memset((char*)data_block_info.int_data_address + data_block_info.block_size, 0, pad_bytes);
 
 							data_info.block_list.push_back(data_block_info);
 							block_parse_ptr = block_parse_ptr + 16 + data_block_info.block_size;
@@ -978,10 +1031,12 @@ void CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_m
                              TagInfo(block_tag) == kTextureBuffer1Block ||
                              TagInfo(block_tag) == kParamsBlock)
 					{
+					    uint32_t zone_uint_size = (num_bytes - header_size + 3) / 4;
+					    data_info.buffer_size = num_bytes - header_size;
 						data_info.int_data_address = new uint32_t[zone_uint_size];
 						memcpy(data_info.int_data_address, parse_ptr + header_size, data_info.buffer_size);
-						uint32_t bytes_left = zone_uint_size * 4 - data_info.buffer_size;
-						memset((char*)data_info.int_data_address + data_info.buffer_size, 0, bytes_left);
+						uint32_t pad_bytes = zone_uint_size * 4 - data_info.buffer_size;
+						memset((char*)data_info.int_data_address + data_info.buffer_size, 0, pad_bytes);
 					}
 					else if (block_tag == 0x20000c01 ||
 							 block_tag == 0x20000c02 ||
@@ -991,265 +1046,357 @@ void CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_m
 					}
 					else
 					{
-						assert(0);
+                        context.add_error(kGpaErrorZoneTag);
+                        report->num_skipped_zones++;
 					}
 					data_zone_list.push_back(data_info);
 				}
 				// command zone.
 				else if ((block_tag & 0xf0000000) == 0x10000000)
 				{
-					uint32_t zone_uint_size = (this_info.m_numBytes + 3) / 4;
+					uint32_t zone_uint_size = uint32_t((uint64_t(num_bytes) + kGpaCommandPadBytes + 3) / 4);
 					CommandZoneInfo data_info;
 					data_info.tag_info = (TagInfo)block_tag;
+					data_info.zone_idx = i_zone;
+					data_info.offset = uint32_t(zone.offset);
 					data_info.int_data_address = new uint32_t[zone_uint_size];
-					data_info.buffer_size = this_info.m_numBytes;
-					memcpy(data_info.int_data_address, parse_ptr, this_info.m_numBytes);
-					uint32_t bytes_left = zone_uint_size * 4 - this_info.m_numBytes;
-					memset((char*)data_info.int_data_address + this_info.m_numBytes, 0, bytes_left);
+					data_info.buffer_size = num_bytes;
+					memcpy(data_info.int_data_address, parse_ptr, num_bytes);
+					uint32_t pad_bytes = zone_uint_size * 4 - num_bytes;
+					memset((char*)data_info.int_data_address + num_bytes, 0, pad_bytes);
 					command_zone_list.push_back(data_info);
 				}
 				else
 				{
-					assert(0);
+                    context.add_error(kGpaErrorZoneTag);
+                    report->num_skipped_zones++;
 				}
-
-				parse_ptr += num_bytes;
 			}
+
+            context = { report, uint32_t(index.zone_list.size()), uint32_t(index.end_offset), index.end_tag };
+            bool has_end_zone = size - index.end_offset >= 8;
+            if (has_end_zone)
+            {
+                report->num_zones++;
+            }
+
+            if (!has_end_zone || index.end_tag != kGpaFrameEndTag)
+            {
+                context.add_error(kGpaErrorTruncated);
+                report->num_skipped_zones += has_end_zone ? 1 : 0;
+            }
 		}
+        else
+        {
+            context.add_error(kGpaErrorFileHeader);
+        }
 
-		uint16_t* buffer_id_match_table = new uint16_t[0x10000];
-		memset(buffer_id_match_table, 0xff, sizeof(uint16_t) * 10000);
+		RenderingStates current_render_states;
+        MaxtrixMode current_matrix_mode = MaxtrixMode(-1);
 
-		// data processing pass.
-		for (uint32_t i = 0; i < command_zone_list.size(); i++)
+        for (uint32_t i_cmd = 0; i_cmd < command_zone_list.size(); i_cmd++)
 		{
-			TagInfo block_tag = command_zone_list[i].tag_info;
-			uint8_t* parse_ptr = (uint8_t*)command_zone_list[i].byte_data_address;
+			TagInfo block_tag = command_zone_list[i_cmd].tag_info;
+            uint8_t* parse_ptr = reinterpret_cast<uint8_t*>(command_zone_list[i_cmd].byte_data_address);
+			GpaParseContext context = { report, command_zone_list[i_cmd].zone_idx, command_zone_list[i_cmd].offset, uint32_t(block_tag) };
+
+			if (block_tag == kGlVertexAttribPointer ||
+				block_tag == kGlVertexAttribIPointer ||
+				block_tag == kGlVertexAttribLPointer)
+			{
+				if (!HasCommandArgs(command_zone_list[i_cmd], block_tag == kGlVertexAttribPointer ? 24 : 20, context))
+				{
+					continue;
+				}
+
+				uint32_t iterazer = 0;
+				uint32_t attrib_index = check_uint(parse_ptr + iterazer); iterazer += 4;
+				uint32_t num_elements = check_uint(parse_ptr + iterazer); iterazer += 4;
+                DataType data_type = DataType(check_uint(parse_ptr + iterazer)); iterazer += 4;
+				uint32_t is_normalized = 0;
+				if (block_tag == kGlVertexAttribPointer)
+				{
+					is_normalized = check_uint(parse_ptr + iterazer); iterazer += 4;
+				}
+				uint32_t stride = check_uint(parse_ptr + iterazer); iterazer += 4;
+				uint32_t data_offset = check_uint(parse_ptr + iterazer);
+				const DataZoneInfo* data_zone_info = GetDataZone(data_zone_list, data_offset, 4, context);
+				if (!data_zone_info)
+				{
+					continue;
+				}
+
+				if (attrib_index >= kGlMaxVertexAttribs)
+				{
+					context.add_error(kGpaErrorObjectId);
+					continue;
+				}
+
+				// the offset into the bound array buffer, or the tag of the client vertex stream.
+				VertexFormat format(uint32_t(data_type), num_elements, is_normalized != 0);
+				if (!gl_state.vertex_attrib_pointer(attrib_index, format, stride, data_zone_info->int_data_address[0]))
+				{
+					context.add_error(kGpaErrorInvalidEnum);
+				}
+			}
+			else if (block_tag == kGlEnableVertexAttribArray)
+			{
+				if (!HasCommandArgs(command_zone_list[i_cmd], 4, context))
+				{
+					continue;
+				}
+
+				uint32_t attrib_index = check_uint(parse_ptr);
+				if (!gl_state.enable_vertex_attrib_array(attrib_index, true))
+				{
+					context.add_error(kGpaErrorObjectId);
+				}
+			}
+			else if (block_tag == kGlDisableVertexAttribArray)
+			{
+				if (!HasCommandArgs(command_zone_list[i_cmd], 4, context))
+				{
+					continue;
+				}
+
+				uint32_t attrib_index = check_uint(parse_ptr);
+				if (!gl_state.enable_vertex_attrib_array(attrib_index, false))
+				{
+					context.add_error(kGpaErrorObjectId);
+				}
+			}
+			else if (block_tag == kGlVertexAttribDivisor)
+			{
+				if (!HasCommandArgs(command_zone_list[i_cmd], 8, context))
+				{
+					continue;
+				}
+
+				uint32_t attrib_index = check_uint(parse_ptr);
+				uint32_t divisor = check_uint(parse_ptr + 4);
+				if (!gl_state.vertex_attrib_divisor(attrib_index, divisor))
+				{
+					context.add_error(kGpaErrorObjectId);
+				}
+			}
+			else if (block_tag == kGlMatrixMode)
+			{
+                MaxtrixMode matrix_mode = MaxtrixMode(check_uint(parse_ptr));
+				context.check_value(matrix_mode == kGlModelView ||
+					matrix_mode == kGlProjection ||
+					matrix_mode == kGlTexture ||
+					matrix_mode == kGlColor);
+				current_matrix_mode = matrix_mode;
+			}
+			else if (block_tag == kGlCreateProgram)
+			{
+				if (!HasCommandArgs(command_zone_list[i_cmd], 4, context))
+				{
+					continue;
+				}
 
-			if (block_tag == kGlTexImage2D)
+				// the returned name.
+				context.check_value(gl_state.create_program(check_uint(parse_ptr)));
+			}
+			else if (block_tag == kGlUseProgram)
 			{
+				if (!HasCommandArgs(command_zone_list[i_cmd], 4, context))
+				{
+					continue;
+				}
+
+				if (!gl_state.use_program(check_uint(parse_ptr)))
+				{
+					context.add_error(kGpaErrorObjectId);
+				}
+			}
+			else if (block_tag == kGlDeleteProgram)
+			{
+				if (!HasCommandArgs(command_zone_list[i_cmd], 4, context))
+				{
+					continue;
+				}
+
+				gl_state.delete_program(check_uint(parse_ptr));
+			}
+			else if (block_tag == kGlTexImage2D)
+			{
+				if (!HasCommandArgs(command_zone_list[i_cmd], 36, context))
+				{
+					continue;
+				}
+
                 TextureType texture_type = TextureType(check_uint(parse_ptr));
 				uint32_t level = check_uint(parse_ptr + 4);
 				uint32_t internal_format = check_uint(parse_ptr + 8);
-				CheckValidInternalFormat(internal_format);
 				uint32_t width = check_uint(parse_ptr + 12);
 				uint32_t height = check_uint(parse_ptr + 16);
 				uint32_t border = check_uint(parse_ptr + 20);
-				assert(border == 0);
                 PixelDataChannel format = PixelDataChannel(check_uint(parse_ptr + 24));
-				CheckValidFormat(format);
                 DataType type = DataType(check_uint(parse_ptr + 28));
-				CheckValidPixelType(type);
 				uint32_t texture_address = check_uint(parse_ptr + 32);
-				DataZoneInfo data_zone_info = FindDataZoneByIndex(data_zone_list, texture_address);
-				assert(g_currentBindTexture >= 0);
+				if (!CheckValidInternalFormat(internal_format) || !CheckValidFormat(format) || !CheckValidPixelType(type) || border != 0)
+				{
+					context.add_error(kGpaErrorInvalidEnum);
+					continue;
+				}
+
+				const DataZoneInfo* data_zone_info = GetDataZone(data_zone_list, texture_address, 1, context);
+                core::Texture2DInfo* tex_info = GetBoundTexture(gl_state, uint32_t(texture_type), group_mesh_data, level, context);
+				if (!data_zone_info || !tex_info)
+				{
+					continue;
+				}
 
-                core::Texture2DInfo* tex_info = group_mesh_data->loaded_textures[uint32_t(g_currentBindTexture)];
                 tex_info->m_levelCount = max(tex_info->m_levelCount, level + 1);
                 tex_info->m_internalFormat = internal_format;
                 tex_info->m_format = uint32_t(format);
                 tex_info->m_type = uint32_t(type);
                 tex_info->m_mips[level].m_width = width;
                 tex_info->m_mips[level].m_height = height;
-                tex_info->m_mips[level].m_size = data_zone_info.buffer_size;
-                tex_info->m_mips[level].m_imageData = make_unique<char[]>(data_zone_info.buffer_size);
-                memcpy(tex_info->m_mips[level].m_imageData.get(), data_zone_info.byte_data_address, data_zone_info.buffer_size);
+                tex_info->m_mips[level].m_size = data_zone_info->buffer_size;
+                tex_info->m_mips[level].m_imageData = make_unique<char[]>(data_zone_info->buffer_size);
+                memcpy(tex_info->m_mips[level].m_imageData.get(), data_zone_info->byte_data_address, data_zone_info->buffer_size);
 			}
 			else if (block_tag == kGlCompressedTexImage2D)
 			{
+				if (!HasCommandArgs(command_zone_list[i_cmd], 32, context))
+				{
+					continue;
+				}
+
                 TextureType texture_type = TextureType(check_uint(parse_ptr));
 				uint32_t level = check_uint(parse_ptr + 4);
 				CompressedPixelFormat internal_compression_format = (CompressedPixelFormat)check_uint(parse_ptr + 8);
 				uint32_t width = check_uint(parse_ptr + 12);
 				uint32_t height = check_uint(parse_ptr + 16);
 				uint32_t border = check_uint(parse_ptr + 20);
-				assert(border == 0);
-				uint32_t size = check_uint(parse_ptr + 24);
+				context.check_value(border == 0);
+				uint32_t image_size = check_uint(parse_ptr + 24);
 				uint32_t texture_address = check_uint(parse_ptr + 28);
-				DataZoneInfo data_zone_info = FindDataZoneByIndex(data_zone_list, texture_address);
-				assert(g_currentBindTexture >= 0);
 
-                core::Texture2DInfo* tex_info = group_mesh_data->loaded_textures[uint32_t(g_currentBindTexture)];
+				const DataZoneInfo* data_zone_info = GetDataZone(data_zone_list, texture_address, 1, context);
+                core::Texture2DInfo* tex_info = GetBoundTexture(gl_state, uint32_t(texture_type), group_mesh_data, level, context);
+				if (!data_zone_info || !tex_info)
+				{
+					continue;
+				}
+
                 tex_info->m_levelCount = max(tex_info->m_levelCount, level + 1);
                 tex_info->m_format = uint32_t(internal_compression_format);
                 tex_info->m_internalFormat = uint32_t(internal_compression_format);
                 tex_info->m_type = 0;
                 tex_info->m_mips[level].m_width = width;
                 tex_info->m_mips[level].m_height = height;
-                tex_info->m_mips[level].m_size = data_zone_info.buffer_size;
-                tex_info->m_mips[level].m_imageData = make_unique<char[]>(data_zone_info.buffer_size);
-                memcpy(tex_info->m_mips[level].m_imageData.get(), data_zone_info.byte_data_address, data_zone_info.buffer_size);
+                tex_info->m_mips[level].m_size = data_zone_info->buffer_size;
+                tex_info->m_mips[level].m_imageData = make_unique<char[]>(data_zone_info->buffer_size);
+                memcpy(tex_info->m_mips[level].m_imageData.get(), data_zone_info->byte_data_address, data_zone_info->buffer_size);
 			}
 			else if (block_tag == kGlBufferData)
 			{
-				assert(g_current_bind_buffer > 0);
-				assert(g_current_bind_buffer < 0x10000);
+				if (!HasCommandArgs(command_zone_list[i_cmd], 16, context))
+				{
+					continue;
+				}
 
                 BufferType buffer_type = BufferType(check_uint(parse_ptr));
 				uint32_t buffer_size = check_uint(parse_ptr + 4);
 				uint32_t buffer_addr = check_uint(parse_ptr + 8);
 				uint32_t buffer_usage = check_uint(parse_ptr + 12);
-				CheckValidBufferUsage(buffer_usage);
+				context.check_value(CheckValidBufferUsage(buffer_usage));
 
+				// without data the store is allocated but nothing of it is known yet.
+				const uint8_t* buffer_data = nullptr;
 				if (buffer_addr > 0)
 				{
-					DataZoneInfo data_zone_info;
-					data_zone_info = FindDataZoneByIndex(data_zone_list, buffer_addr);
-					assert(buffer_size == data_zone_info.buffer_size);
-
-                    buffer_id_match_table[g_current_bind_buffer] = uint16_t(buffer_data_list.size());
+					// reads of the buffer stop at buffer_size, the zone has to hold that much.
+					const DataZoneInfo* data_zone_info = GetDataZone(data_zone_list, buffer_addr, buffer_size, context);
+					if (!data_zone_info)
+					{
+						continue;
+					}
+					buffer_data = reinterpret_cast<const uint8_t*>(data_zone_info->byte_data_address);
+				}
 
-					BufferDataInfo this_buffer_info;
-					this_buffer_info.buffer_type = buffer_type;
-					this_buffer_info.buffer_size = buffer_size;
-					this_buffer_info.buffer_usage = buffer_usage;
-                    this_buffer_info.buffer_obj_id = uint32_t(g_current_bind_buffer);
-					this_buffer_info.int_data_address = data_zone_info.int_data_address;
-					buffer_data_list.push_back(this_buffer_info);
+				if (!gl_state.buffer_data(uint32_t(buffer_type), buffer_data, buffer_size, buffer_usage))
+				{
+					context.add_error(kGpaErrorObjectId);
 				}
 			}
 			else if (block_tag == kGlBufferSubData)
 			{
-				assert(g_current_bind_buffer > 0);
-				assert(g_current_bind_buffer < 0x10000);
+				if (!HasCommandArgs(command_zone_list[i_cmd], 16, context))
+				{
+					continue;
+				}
 
                 BufferType buffer_type = BufferType(check_uint(parse_ptr));
 				uint32_t buffer_offset = check_uint(parse_ptr + 4);
 				uint32_t buffer_size = check_uint(parse_ptr + 8);
 				uint32_t buffer_addr = check_uint(parse_ptr + 12);
 
-				if (buffer_addr > 0)
+				const DataZoneInfo* data_zone_info = GetDataZone(data_zone_list, buffer_addr, buffer_size, context);
+				if (!data_zone_info)
 				{
-					DataZoneInfo data_zone_info;
-					data_zone_info = FindDataZoneByIndex(data_zone_list, buffer_addr);
-					assert(buffer_size == data_zone_info.buffer_size);
-
-                    buffer_id_match_table[g_current_bind_buffer] = uint16_t(buffer_data_list.size());
+					continue;
+				}
 
-					BufferDataInfo this_buffer_info;
-					this_buffer_info.buffer_type = buffer_type;
-					this_buffer_info.buffer_size = buffer_size;
-					//this_buffer_info.buffer_usage = buffer_usage;
-                    this_buffer_info.buffer_obj_id = uint32_t(g_current_bind_buffer);
-					this_buffer_info.int_data_address = data_zone_info.int_data_address;
-					buffer_data_list.push_back(this_buffer_info);
+				if (!gl_state.buffer_sub_data(uint32_t(buffer_type), buffer_offset, reinterpret_cast<const uint8_t*>(data_zone_info->byte_data_address), buffer_size))
+				{
+					context.add_error(kGpaErrorBufferRange);
 				}
 			}
-			else if (block_tag == kGlGenBuffers)
+			else if (block_tag == kGlDeleteBuffers ||
+				block_tag == kGlDeleteTextures ||
+				block_tag == kGlDeleteVertexArrays)
 			{
-				uint32_t num_buffers = check_uint(parse_ptr);
-				uint32_t buffer_objects_address = check_uint(parse_ptr + 4);
-				DataZoneInfo data_zone_info = FindDataZoneByIndex(data_zone_list, buffer_objects_address);
-			}
-			else if (block_tag == kGlGenTextures)
-			{
-				uint32_t num_textures = check_uint(parse_ptr);
-				uint32_t texture_objects_address = check_uint(parse_ptr + 4);
-			}
-			else if (block_tag == kGlGenFrameBuffers)
-			{
-				uint32_t num_fbuffers = check_uint(parse_ptr);
-				uint32_t framebuffer_objects_address = check_uint(parse_ptr + 4);
-			}
-			else if (block_tag == kGlBindBuffer)
-			{
-				BufferType buffer_type = (BufferType)check_uint(parse_ptr);
-				uint32_t buffer_index = -1;
-				uint32_t buffer_object_id = -1;
-				if (block_tag == kGlBindBufferBase)
+				if (!HasCommandArgs(command_zone_list[i_cmd], 8, context))
 				{
-					buffer_index = check_uint(parse_ptr + 4);
-					buffer_object_id = check_uint(parse_ptr + 8);
+					continue;
 				}
-				else
+
+				uint32_t num_names = check_uint(parse_ptr);
+				uint32_t name_address = check_uint(parse_ptr + 4);
+				if (num_names > UINT32_MAX / 4)
 				{
-					buffer_object_id = check_uint(parse_ptr + 4);
+					context.add_error(kGpaErrorBufferRange);
+					continue;
 				}
 
-				g_current_bind_buffer = buffer_object_id;
-			}
-			else if (block_tag == kGlBindBufferBase || block_tag == kGlBindBuffersBase)
-			{
-				BufferType buffer_type = (BufferType)check_uint(parse_ptr);
-				uint32_t buffer_index = -1;
-				uint32_t buffer_object_id = -1;
-				if (block_tag == kGlBindBufferBase)
+				const DataZoneInfo* data_zone_info = num_names > 0 ? GetDataZone(data_zone_list, name_address, num_names * 4, context) : nullptr;
+				if (!data_zone_info)
 				{
-					buffer_index = check_uint(parse_ptr + 4);
-					buffer_object_id = check_uint(parse_ptr + 8);
+					continue;
 				}
-				else
+
+				if (block_tag == kGlDeleteBuffers)
 				{
-					buffer_object_id = check_uint(parse_ptr + 4);
+					gl_state.delete_buffers(data_zone_info->int_data_address, num_names);
 				}
-			}
-			else if (block_tag == kGlBindTexture)
-			{
-				TextureType texture_type = (TextureType)check_uint(parse_ptr);
-				uint32_t texture_name_id = check_uint(parse_ptr + 4);
-
-				int32_t found_texture = -1;
-                for (uint32_t i = 0; i < group_mesh_data->loaded_textures.size(); i++)
+				else if (block_tag == kGlDeleteTextures)
 				{
-                    if (group_mesh_data->loaded_textures[i]->m_objectId == texture_name_id)
-					{
-						found_texture = i;
-						break;
-					}
+					gl_state.delete_textures(data_zone_info->int_data_address, num_names);
 				}
-
-				if (found_texture < 0)
+				else
 				{
-                    core::Texture2DInfo* tex_info = new core::Texture2DInfo;
-                    tex_info->m_objectId = texture_name_id;
-                    tex_info->m_levelCount = 0;
-                    group_mesh_data->loaded_textures.push_back(tex_info);
-                    found_texture = int32_t(group_mesh_data->loaded_textures.size() - 1);
+					gl_state.delete_vertex_arrays(data_zone_info->int_data_address, num_names);
 				}
-
-				g_currentBindTexture = found_texture;
 			}
-			else if (block_tag == kGlBindTextures)
+			else if (block_tag == kGlBindVertexArray)
 			{
-				uint32_t start = check_uint(parse_ptr);
-				uint32_t count = check_uint(parse_ptr + 4);
-				uint32_t texture_address = check_uint(parse_ptr + 8);
+				if (!HasCommandArgs(command_zone_list[i_cmd], 4, context))
+				{
+					continue;
+				}
 
-				DataZoneInfo data_zone_info = FindDataZoneByIndex(data_zone_list, texture_address);
+				gl_state.bind_vertex_array(check_uint(parse_ptr));
 			}
-			else if (block_tag == kGlBindSampler)
-			{
-			}
-			else if (block_tag == kGlBindSamplers)
-			{
-				uint32_t start = check_uint(parse_ptr);
-				uint32_t count = check_uint(parse_ptr + 4);
-				uint32_t sampler_address = check_uint(parse_ptr + 8);
-			}
-			else if (block_tag == kGlBindFrameBuffer)
-			{
-				uint32_t frame_buffer_type = check_uint(parse_ptr);
-				assert(frame_buffer_type == kGlFrameBuffer ||
-					frame_buffer_type == kGlDrawFrameBuffer ||
-					frame_buffer_type == kGlReadFrameBuffer);
-			}
-			else if (block_tag == kGlBindTransformFeedback)
-			{
-				uint32_t buffer_type = check_uint(parse_ptr);
-				assert(buffer_type == kGlTransformFeedback);
-			}
-			else if (block_tag == kGlBindRenderBuffer)
-			{
-				uint32_t frame_buffer_type = check_uint(parse_ptr);
-				assert(frame_buffer_type == kGlRenderBuffer);
-			}
-			else if (block_tag == kGlBindProgramPipeline)
-			{
-				uint32_t pipeline_id = check_uint(parse_ptr);
-			}
-			else if (block_tag == kGlPixelStoref || block_tag == kGlPixelStorei)
+			else if (block_tag == kGlGenBuffers ||
+				block_tag == kGlGenTextures ||
+				block_tag == kGlGenVertexArrays ||
+				block_tag == kGlGenFrameBuffers)
 			{
-				PixelStoreInfo pixel_store_info = (PixelStoreInfo)check_uint(parse_ptr);
+				// objects are made on their first bind.
 			}
 			else if (block_tag == kGlShaderSource)
 			{
@@ -1257,12 +1404,16 @@ void CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_m
 				uint32_t count = check_uint(parse_ptr + 4);
 				uint32_t address_of_code_list = check_uint(parse_ptr + 8);
 				uint32_t address_of_length_list = check_uint(parse_ptr + 12);
-				DataZoneInfo code_zone_info = FindDataZoneByIndex(data_zone_list, address_of_code_list);
+				const DataZoneInfo* code_zone_info = GetDataZone(data_zone_list, address_of_code_list, 1, context);
 				if (address_of_length_list > 0)
 				{
-					DataZoneInfo length_zone_info = FindDataZoneByIndex(data_zone_list, address_of_length_list);
+					const DataZoneInfo* length_zone_info = FindDataZoneByIndex(data_zone_list, address_of_length_list);
+				}
+				context.check_value(count == 1);
+				if (!code_zone_info)
+				{
+					continue;
 				}
-				assert(count == 1);
 
                 ostringstream s_name;
 				s_name << g_shaders_folder_name << "\\shader_" << shader_obj << ".glsl";
@@ -1270,205 +1421,64 @@ void CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_m
                 string file_name(s_name.str());
 				ofstream outFile;
 				outFile.open(file_name, ofstream::binary);
-				outFile.write(code_zone_info.byte_data_address, code_zone_info.buffer_size);
+				outFile.write(code_zone_info->byte_data_address, code_zone_info->buffer_size);
 				outFile.close();
 			}
-		}
-
-		for (uint32_t i = 0; i < data_zone_list.size(); i++)
-		{
-			int32_t idx = (data_zone_list[i].link_index - data_zone_list[0].link_index);
-			assert(idx == i);
-		}
-			
-		g_current_bind_buffer = -1;
-		memset(g_bind_buffer_list, 0xff, sizeof(g_bind_buffer_list));
-
-		RenderingStates current_render_states;
-        uint32_t currentTextureSlot = INVALID_VALUE;
-        MaxtrixMode current_matrix_mode = MaxtrixMode(-1);
-
-        for (uint32_t i_cmd = 0; i_cmd < command_zone_list.size(); i_cmd++)
-		{
-			TagInfo block_tag = command_zone_list[i_cmd].tag_info;
-            uint8_t* parse_ptr = reinterpret_cast<uint8_t*>(command_zone_list[i_cmd].byte_data_address);
-
-			if (block_tag == kGlVertexAttribPointer ||
-				block_tag == kGlVertexAttribIPointer ||
-				block_tag == kGlVertexAttribLPointer)
+			else if (block_tag == kGlActiveTexture ||
+				block_tag == kGlClientActiveTexture ||
+				block_tag == kGlActiveTextureArb ||
+				block_tag == kGlClientActiveTextureArb)
 			{
-				uint32_t iterazer = 0;
-				uint32_t attrib_index = check_uint(parse_ptr + iterazer); iterazer += 4;
-				uint32_t num_elements = check_uint(parse_ptr + iterazer); iterazer += 4;
-                DataType data_type = DataType(check_uint(parse_ptr + iterazer)); iterazer += 4;
-				uint32_t is_normalized = 0;
-				if (block_tag == kGlVertexAttribPointer)
+				if (!HasCommandArgs(command_zone_list[i_cmd], 4, context))
 				{
-					is_normalized = check_uint(parse_ptr + iterazer); iterazer += 4;
+					continue;
 				}
-				uint32_t stride = check_uint(parse_ptr + iterazer); iterazer += 4;
-				uint32_t data_offset = check_uint(parse_ptr + iterazer);
-				DataZoneInfo data_zone_info = FindDataZoneByIndex(data_zone_list, data_offset);
-                uint32_t element_size = GetDataElementSize(uint32_t(data_type));
-				int currentBindBuffer = g_bind_buffer_list[kGlArrayBufferIdx];
 
-				VertexAttrib& vertexAttrib = current_render_states.m_vertexStream[attrib_index];
-				vertexAttrib.data_type = data_type;
-				vertexAttrib.num_elements = num_elements;
-				vertexAttrib.is_normalized = is_normalized;
-				vertexAttrib.stride = stride == 0 ? num_elements * element_size : stride;
-				vertexAttrib.start_offset = data_zone_info.int_data_address[0];
-				if (currentBindBuffer > 0)
+                TextureSlot tex_slot = TextureSlot(check_uint(parse_ptr));
+
+				// the client unit only selects texture coordinate arrays, the binding unit stays.
+                uint32_t slot_index = uint32_t(tex_slot - kGlTexture0);
+				if (slot_index >= kGlMaxTextureUnits)
 				{
-					vertexAttrib.data_buffer_obj = buffer_id_match_table[currentBindBuffer] == 0xffff ? -1 : buffer_id_match_table[currentBindBuffer];
-					assert(vertexAttrib.data_buffer_obj != -1);
+					context.add_error(kGpaErrorObjectId);
 				}
-				else
+				else if (block_tag == kGlActiveTexture || block_tag == kGlActiveTextureArb)
 				{
-                    vertexAttrib.data_buffer_obj = INVALID_VALUE;
+					gl_state.active_texture(slot_index);
 				}
 			}
-			else if (block_tag == kGlEnableVertexAttribArray)
-			{
-				uint32_t attrib_index = check_uint(parse_ptr);
-				assert(attrib_index < 16);
-				current_render_states.m_vertexStream[attrib_index].is_enabled = 1;
-			}
-			else if (block_tag == kGlDisableVertexAttribArray)
-			{
-				uint32_t attrib_index = check_uint(parse_ptr);
-				assert(attrib_index < 16);
-				current_render_states.m_vertexStream[attrib_index].is_enabled = 0;
-			}
-			else if (block_tag == kGlMatrixMode)
-			{
-                MaxtrixMode matrix_mode = MaxtrixMode(check_uint(parse_ptr));
-				assert(matrix_mode == kGlModelView ||
-					matrix_mode == kGlProjection ||
-					matrix_mode == kGlTexture ||
-					matrix_mode == kGlColor);
-				current_matrix_mode = matrix_mode;
-			}
-			else if (block_tag == kGlUseProgram)
-			{
-				uint32_t shader_address = check_uint(parse_ptr);
-			}
-			else if (block_tag == kGlTexImage2D ||
-				block_tag == kGlCompressedTexImage2D ||
-				block_tag == kGlGenBuffers ||
-				block_tag == kGlBufferData ||
-				block_tag == kGlGenTextures ||
-				block_tag == kGlGenFrameBuffers ||
-				block_tag == kGlShaderSource)
-			{
-				// done in previous pass.
-			}
-			else if (block_tag == kGlActiveTexture ||
-				block_tag == kGlClientActiveTexture ||
-				block_tag == kGlActiveTextureArb ||
-				block_tag == kGlClientActiveTextureArb)
-			{
-                TextureSlot tex_slot = TextureSlot(check_uint(parse_ptr));
-
-                int32_t slot_index = int32_t(tex_slot - kGlTexture0);
-                assert(slot_index >= 0 && slot_index < 256);
-				currentTextureSlot = slot_index;
-			}
 			else if (block_tag == kGlBindBuffer/* || block_tag == kGlBindBufferBase || block_tag == kGlBindBuffersBase*/)
 			{
-                BufferType buffer_type = BufferType(check_uint(parse_ptr));
-                uint32_t buffer_index = INVALID_VALUE;
-				int32_t buffer_object_id = -1;
-				if (block_tag == kGlBindBufferBase)
+				if (!HasCommandArgs(command_zone_list[i_cmd], 8, context))
 				{
-					buffer_index = check_uint(parse_ptr + 4);
-					buffer_object_id = check_int(parse_ptr + 8);
+					continue;
 				}
-				else
+
+                BufferType buffer_type = BufferType(check_uint(parse_ptr));
+				uint32_t buffer_object_id = check_uint(parse_ptr + 4);
+				if (!gl_state.bind_buffer(uint32_t(buffer_type), buffer_object_id))
 				{
-					buffer_object_id = check_int(parse_ptr + 4);
-				}
-
-				BindBufferTypeList bufferTypeIdx = kGlArrayBufferIdx;
-				switch (buffer_type)
-				{
-				case kGlArrayBuffer:
-					bufferTypeIdx = kGlArrayBufferIdx;
-					break;
-				case kGlAtomicCounterBuffer:
-					bufferTypeIdx = kGlAtomicCounterBufferIdx;
-					break;
-				case kGlCopyReadBuffer:
-					bufferTypeIdx = kGlCopyReadBufferIdx;
-					break;
-				case kGlCopyWriteBuffer:
-					bufferTypeIdx = kGlCopyWriteBufferIdx;
-					break;
-				case kGlDispatchIndirectBuffer:
-					bufferTypeIdx = kGlDispatchIndirectBufferIdx;
-					break;
-				case kGlDrawIndirectBuffer:
-					bufferTypeIdx = kGlDrawIndirectBufferIdx;
-					break;
-				case kGlElementArrayBuffer:
-					bufferTypeIdx = kGlElementArrayBufferIdx;
-					break;
-				case kGlPixelPackBuffer:
-					bufferTypeIdx = kGlPixelPackBufferIdx;
-					break;
-				case kGlPixelUnpackBuffer:
-					bufferTypeIdx = kGlPixelUnpackBufferIdx;
-					break;
-				case kGlQueryBuffer:
-					bufferTypeIdx = kGlQueryBufferIdx;
-					break;
-				case kGlShaderStorageBuffer:
-					bufferTypeIdx = kGlShaderStorageBufferIdx;
-					break;
-				case kGlTextureBuffer:
-					bufferTypeIdx = kGlTextureBufferIdx;
-					break;
-				case kGlTransformFeedbackBuffer:
-					bufferTypeIdx = kGlTransformFeedbackBufferIdx;
-					break;
-				case kGlUniformBuffer:
-                    bufferTypeIdx = kGlUniformBufferIdx;
-					break;
-				default:
-                    assert(0);
-				}
-
-				g_bind_buffer_list[bufferTypeIdx] = buffer_object_id;
-				current_render_states.binding_buffer_list[bufferTypeIdx] = buffer_object_id;
+					context.add_error(kGpaErrorInvalidEnum);
+				}
 			}
 			else if (block_tag == kGlBindTexture)
 			{
-                TextureType texture_type = static_cast<TextureType>(check_uint(parse_ptr));
-				uint32_t texture_name_id = check_uint(parse_ptr + 4);
-
-				int32_t found_texture = -1;
-                for (uint32_t i = 0; i < group_mesh_data->loaded_textures.size(); i++)
+				if (!HasCommandArgs(command_zone_list[i_cmd], 8, context))
 				{
-                    if (group_mesh_data->loaded_textures[i]->m_objectId == texture_name_id)
-					{
-                        found_texture = static_cast<int32_t>(i);
-						break;
-					}
+					continue;
 				}
 
-				if (found_texture < 0)
+                TextureType texture_type = static_cast<TextureType>(check_uint(parse_ptr));
+				uint32_t texture_name_id = check_uint(parse_ptr + 4);
+				if (!gl_state.bind_texture(uint32_t(texture_type), texture_name_id))
 				{
-                    core::Texture2DInfo* tex_info = new core::Texture2DInfo;
-                    tex_info->m_objectId = texture_name_id;
-                    tex_info->m_levelCount = 0;
-                    group_mesh_data->loaded_textures.push_back(tex_info);
-                    found_texture = int32_t(group_mesh_data->loaded_textures.size() - 1);
+					context.add_error(kGpaErrorInvalidEnum);
+					continue;
 				}
 
-				g_currentBindTexture = found_texture;
-
-                assert(currentTextureSlot < 256);
-                current_render_states.m_textureSlot[currentTextureSlot].index_in_list = found_texture;
+				uint32_t texture_unit = gl_state.get_active_texture_unit();
+				uint64_t texture_key = gl_state.get_bound_texture(texture_unit, uint32_t(texture_type));
+                current_render_states.m_textureSlot[texture_unit].index_in_list = GetTextureListIndex(gl_state, texture_key, group_mesh_data);
             }
 			else if (block_tag == kGlBindTextures)
 			{
@@ -1476,7 +1486,7 @@ void CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_m
 				uint32_t count = check_uint(parse_ptr + 4);
 				uint32_t texture_address = check_uint(parse_ptr + 8);
 
-				DataZoneInfo data_zone_info = FindDataZoneByIndex(data_zone_list, texture_address);
+				const DataZoneInfo* data_zone_info = FindDataZoneByIndex(data_zone_list, texture_address);
             }
 			else if (block_tag == kGlBindSampler)
 			{
@@ -1490,19 +1500,19 @@ void CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_m
 			else if (block_tag == kGlBindFrameBuffer)
 			{
 				uint32_t frame_buffer_type = check_uint(parse_ptr);
-				assert(frame_buffer_type == kGlFrameBuffer ||
+				context.check_value(frame_buffer_type == kGlFrameBuffer ||
 					frame_buffer_type == kGlDrawFrameBuffer ||
 					frame_buffer_type == kGlReadFrameBuffer);
 			}
 			else if (block_tag == kGlBindTransformFeedback)
 			{
 				uint32_t buffer_type = check_uint(parse_ptr);
-				assert(buffer_type == kGlTransformFeedback);
+				context.check_value(buffer_type == kGlTransformFeedback);
 			}
 			else if (block_tag == kGlBindRenderBuffer)
 			{
 				uint32_t frame_buffer_type = check_uint(parse_ptr);
-				assert(frame_buffer_type == kGlRenderBuffer);
+				context.check_value(frame_buffer_type == kGlRenderBuffer);
 			}
 			else if (block_tag == kGlBindProgramPipeline)
 			{
@@ -1524,7 +1534,7 @@ void CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_m
 				if (block_tag == kGlMaterialiv || block_tag == kGlMaterialfv)
 				{
 					uint32_t param_address = (MaterialLightAttrib)check_uint(parse_ptr + 8);
-					DataZoneInfo data_zone_info = FindDataZoneByIndex(data_zone_list, param_address);
+					const DataZoneInfo* data_zone_info = FindDataZoneByIndex(data_zone_list, param_address);
 				}
 			}
 			else if (block_tag == kGlLighti ||
@@ -1557,7 +1567,7 @@ void CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_m
 				TextureType texture_type = (TextureType)check_uint(parse_ptr);
 				TextureParameterAction texture_param_act = (TextureParameterAction)check_uint(parse_ptr + 4);
 
-				CheckValidTextureParameterAction(texture_param_act);
+				context.check_value(CheckValidTextureParameterAction(texture_param_act));
 
 				uint32_t texture_param_value = (uint32_t)-1;
 				if (block_tag == kGlTexParameteri || block_tag == kGlTexParameterf)
@@ -1571,7 +1581,7 @@ void CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_m
 						texture_param_act == kGlTextureWrapT ||
 						texture_param_act == kGlTextureWrapRExt)
 					{
-						assert(texture_param_value == kGlNearest ||
+						context.check_value(texture_param_value == kGlNearest ||
 							texture_param_value == kGlLinear ||
 							texture_param_value == kGlNearestMipmapNearest ||
 							texture_param_value == kGlLinearMipmapNearest ||
@@ -1583,7 +1593,7 @@ void CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_m
 					}
 					else if (texture_param_act == kGlGenerateMipmap)
 					{
-						assert(texture_param_value == kGlFalse || texture_param_value == kGlTrue);
+						context.check_value(texture_param_value == kGlFalse || texture_param_value == kGlTrue);
 					}
 					else if (texture_param_act == kGlTextureBaseLevel ||
 						texture_param_act == kGlTextureMaxLevel ||
@@ -1595,7 +1605,7 @@ void CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_m
 					}
 					else if (texture_param_act == kGlTextureCompareFunc)
 					{
-						assert(texture_param_value == kGlLess ||
+						context.check_value(texture_param_value == kGlLess ||
 							texture_param_value == kGlEqual ||
 							texture_param_value == kGlLEqual ||
 							texture_param_value == kGlGreater ||
@@ -1605,7 +1615,7 @@ void CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_m
 					}
 					else if (texture_param_act == kGlTextureCompareMode)
 					{
-						assert(texture_param_value == kGlNone || texture_param_value == kGlCompareRToTexture);
+						context.check_value(texture_param_value == kGlNone || texture_param_value == kGlCompareRToTexture);
 					}
 					else if (texture_param_act == kGlTextureSwizzleR ||
 						texture_param_act == kGlTextureSwizzleG ||
@@ -1613,7 +1623,7 @@ void CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_m
 						texture_param_act == kGlTextureSwizzleA ||
 						texture_param_act == kGlTextureSwizzleRgba)
 					{
-						assert(texture_param_value == kGlRed ||
+						context.check_value(texture_param_value == kGlRed ||
 							texture_param_value == kGlGreen ||
 							texture_param_value == kGlBlue ||
 							texture_param_value == kGlAlpha ||
@@ -1622,11 +1632,11 @@ void CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_m
 					}
 					else if (texture_param_act == kGlDepthStencilTextureMode)
 					{
-						assert(texture_param_value == kGlDepthComponent);
+						context.check_value(texture_param_value == kGlDepthComponent);
 					}
 					else
 					{
-						assert(0);
+						context.add_error(kGpaErrorInvalidEnum);
 					}
 				}
 			}
@@ -1636,9 +1646,9 @@ void CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_m
 				block_tag == kGlTexEnvfv)
 			{
 				TextureEnvMode tex_env_mode = (TextureEnvMode)check_uint(parse_ptr);
-				assert(tex_env_mode == kGlTextureEnv || tex_env_mode == kGlTextureFilterControl || tex_env_mode == kGlPointSprite);
+				context.check_value(tex_env_mode == kGlTextureEnv || tex_env_mode == kGlTextureFilterControl || tex_env_mode == kGlPointSprite);
 				TextureEnvParameters tex_env_param = (TextureEnvParameters)check_uint(parse_ptr + 4);
-				CheckValidTextureEnvMode(tex_env_param);
+				context.check_value(CheckValidTextureEnvMode(tex_env_param));
 
 				if (block_tag == kGlTexEnvi || block_tag == kGlTexEnvf)
 				{
@@ -1653,7 +1663,7 @@ void CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_m
 					else
 					{
 						uint32_t ops = check_uint(parse_ptr + 8);
-						CheckValidTextureEnvOp(ops);
+						context.check_value(CheckValidTextureEnvOp(ops));
 					}
 				}
 			}
@@ -1689,16 +1699,27 @@ void CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_m
 				block_tag == kGlStencilOp)
 			{
 			}
-			else if (block_tag == kGlDrawArrays)
+			// an instanced draw gives the mesh of its first instance.
+			else if (block_tag == kGlDrawArrays || block_tag == kGlDrawArraysInstanced)
 			{
-				PrimitiveType primitive_type = (PrimitiveType)check_uint(parse_ptr);
+				if (!HasCommandArgs(command_zone_list[i_cmd], block_tag == kGlDrawArrays ? 12 : 16, context))
+				{
+					continue;
+				}
+
+				uint32_t primitive_value = check_uint(parse_ptr);
 				uint32_t start_idx = check_uint(parse_ptr + 4);
 				uint32_t count = check_uint(parse_ptr + 8);
+				if (primitive_value >= 10)
+				{
+					context.add_error(kGpaErrorInvalidEnum);
+					continue;
+				}
+				PrimitiveType primitive_type = PrimitiveType(primitive_value);
 
-				current_render_states.draw_call_params.element_buffer_obj = (uint32_t)-1;
 				current_render_states.draw_call_params.primitive_type = primitive_type;
 				current_render_states.draw_call_params.num_indexes = count;
-				current_render_states.draw_call_params.data_type = (DataType)-1;
+				current_render_states.draw_call_params.data_type = kGlNoDataType;
 				current_render_states.draw_call_params.data_offset = start_idx;
 
                 string prim_name = g_primitive_name[primitive_type];
@@ -1707,7 +1728,7 @@ void CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_m
 				mtl_name << g_materials_folder_name << "/material_" << prim_name << "_" << num_dispatches << ".mtl";
 
 				MeshData* mesh_data = nullptr;
-				CreateObjectFile(current_render_states, matrix_stack, buffer_data_list, data_zone_list, obj_name.str(), mtl_name.str(), mesh_data);
+				CreateObjectFile(current_render_states, gl_state, matrix_stack, data_zone_list, obj_name.str(), mtl_name.str(), context, mesh_data);
                 if (mesh_data && (!mesh_dump_done || mesh_data->draw_call_list[0].is_ge_polygon()))
 				{
                     group_mesh_data->meshes.push_back(mesh_data);
@@ -1715,28 +1736,36 @@ void CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_m
 					
 				num_dispatches++;
 			}
-			else if (block_tag == kGlDrawElements)
+			else if (block_tag == kGlDrawElements || block_tag == kGlDrawElementsInstanced)
 			{
-				PrimitiveType primitive_type = (PrimitiveType)check_uint(parse_ptr);
+				if (!HasCommandArgs(command_zone_list[i_cmd], block_tag == kGlDrawElements ? 16 : 20, context))
+				{
+					continue;
+				}
+
+				uint32_t primitive_value = check_uint(parse_ptr);
 				uint32_t num_indexes = check_uint(parse_ptr + 4);
-				DataType data_type = (DataType)check_uint(parse_ptr + 8);
+				uint32_t data_type_value = check_uint(parse_ptr + 8);
 				uint32_t data_offset_addr = check_uint(parse_ptr + 12);
-				DataZoneInfo data_zone_info = FindDataZoneByIndex(data_zone_list, data_offset_addr);
-
-				int32_t current_element_buffer_id = current_render_states.binding_buffer_list[kGlElementArrayBufferIdx];
-				if (current_element_buffer_id <= 0) // no buffer bind.
+				// range checked before the casts, an enum can't hold just any value.
+				if (primitive_value >= 10 ||
+					(data_type_value != kGlUByte && data_type_value != kGlUShort && data_type_value != kGlUInt))
 				{
-					current_render_states.draw_call_params.element_buffer_obj = -1;
-					data_zone_info = FindDataZoneByIndex(data_zone_list, data_offset_addr);
+					context.add_error(kGpaErrorInvalidEnum);
+					continue;
 				}
-				else
+				PrimitiveType primitive_type = PrimitiveType(primitive_value);
+
+				const DataZoneInfo* data_zone_info = GetDataZone(data_zone_list, data_offset_addr, 4, context);
+				if (!data_zone_info)
 				{
-					current_render_states.draw_call_params.element_buffer_obj = buffer_id_match_table[current_element_buffer_id] == 0xffff ? -1 : buffer_id_match_table[current_element_buffer_id];
+					continue;
 				}
+
 				current_render_states.draw_call_params.primitive_type = primitive_type;
 				current_render_states.draw_call_params.num_indexes = num_indexes;
-				current_render_states.draw_call_params.data_type = data_type;
-				current_render_states.draw_call_params.data_offset = data_zone_info.int_data_address[0];
+				current_render_states.draw_call_params.data_type = DataType(data_type_value);
+				current_render_states.draw_call_params.data_offset = data_zone_info->int_data_address[0];
 
                 string prim_name = g_primitive_name[primitive_type];
                 ostringstream obj_name, mtl_name;
@@ -1744,7 +1773,7 @@ void CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_m
 				mtl_name << g_materials_folder_name << "/material_" << prim_name << "_" << num_dispatches << ".mtl";
 
 				MeshData* mesh_data = nullptr;
-				CreateObjectFile(current_render_states, matrix_stack, buffer_data_list, data_zone_list, obj_name.str(), mtl_name.str(), mesh_data);
+				CreateObjectFile(current_render_states, gl_state, matrix_stack, data_zone_list, obj_name.str(), mtl_name.str(), context, mesh_data);
                 if (mesh_data && (!mesh_dump_done || mesh_data->draw_call_list[0].is_ge_polygon()))
 				{
                     group_mesh_data->meshes.push_back(mesh_data);
@@ -1754,8 +1783,13 @@ void CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_m
 			}
 			else if (block_tag == kGlClipPlane)
 			{
+				if (!HasCommandArgs(command_zone_list[i_cmd], 8, context))
+				{
+					continue;
+				}
+
 				uint32_t plane_idx = check_uint(parse_ptr);
-				assert(plane_idx >= kGlClipPlane0 && plane_idx <= kGlClipPlane7);
+				context.check_value(plane_idx >= kGlClipPlane0 && plane_idx <= kGlClipPlane7);
 				uint32_t address = check_uint(parse_ptr + 4);
 			}
 			else if (block_tag == kGlColorMask || block_tag == kGlColorMaski)
@@ -1791,7 +1825,7 @@ void CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_m
 				uint32_t count = check_uint(parse_ptr + 4);
 				uint32_t transpose = check_uint(parse_ptr + 8);
 				uint32_t matrix_address = check_uint(parse_ptr + 12);
-				DataZoneInfo data_zone_info = FindDataZoneByIndex(data_zone_list, matrix_address);
+				const DataZoneInfo* data_zone_info = FindDataZoneByIndex(data_zone_list, matrix_address);
 			}
 			else if (block_tag == kGlUniformMatrix4fv)
 			{
@@ -1799,13 +1833,17 @@ void CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_m
 				uint32_t count = check_uint(parse_ptr + 4);
 				uint32_t transpose = check_uint(parse_ptr + 8);
 				uint32_t matrix_address = check_uint(parse_ptr + 12);
-				DataZoneInfo data_zone_info = FindDataZoneByIndex(data_zone_list, matrix_address);
+				const DataZoneInfo* data_zone_info = GetDataZone(data_zone_list, matrix_address, 16 * sizeof(float), context);
+				if (!data_zone_info)
+				{
+					continue;
+				}
 
                 core::matrix4f shader_matrix;
-                shader_matrix.set_row(0, core::vec4f(data_zone_info.float_data_address[0], data_zone_info.float_data_address[1], data_zone_info.float_data_address[2], data_zone_info.float_data_address[3]));
-                shader_matrix.set_row(1, core::vec4f(data_zone_info.float_data_address[4], data_zone_info.float_data_address[5], data_zone_info.float_data_address[6], data_zone_info.float_data_address[7]));
-                shader_matrix.set_row(2, core::vec4f(data_zone_info.float_data_address[8], data_zone_info.float_data_address[9], data_zone_info.float_data_address[10], data_zone_info.float_data_address[11]));
-                shader_matrix.set_row(3, core::vec4f(data_zone_info.float_data_address[12], data_zone_info.float_data_address[13], data_zone_info.float_data_address[14], data_zone_info.float_data_address[15]));
+                shader_matrix.set_row(0, core::vec4f(data_zone_info->float_data_address[0], data_zone_info->float_data_address[1], data_zone_info->float_data_address[2], data_zone_info->float_data_address[3]));
+                shader_matrix.set_row(1, core::vec4f(data_zone_info->float_data_address[4], data_zone_info->float_data_address[5], data_zone_info->float_data_address[6], data_zone_info->float_data_address[7]));
+                shader_matrix.set_row(2, core::vec4f(data_zone_info->float_data_address[8], data_zone_info->float_data_address[9], data_zone_info->float_data_address[10], data_zone_info->float_data_address[11]));
+                shader_matrix.set_row(3, core::vec4f(data_zone_info->float_data_address[12], data_zone_info->float_data_address[13], data_zone_info->float_data_address[14], data_zone_info->float_data_address[15]));
 
                 current_render_states.m_transform_matrix = shader_matrix;
                 if (group_mesh_data->meshes.size() == 0) {
@@ -1864,7 +1902,7 @@ void CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_m
 				uint32_t result = check_uint(parse_ptr);
 				uint32_t program_idx = check_uint(parse_ptr + 4);
 				uint32_t name_address = check_uint(parse_ptr + 8);
-				DataZoneInfo data_zone_info = FindDataZoneByIndex(data_zone_list, name_address);
+				const DataZoneInfo* data_zone_info = FindDataZoneByIndex(data_zone_list, name_address);
 			}
 			else if (block_tag == kGlPushDebugGroup)
 			{
@@ -1872,7 +1910,7 @@ void CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_m
 				uint32_t id = check_uint(parse_ptr + 4);
 				uint32_t length = check_uint(parse_ptr + 8);
 				uint32_t messsage_addr = check_uint(parse_ptr + 12);
-				DataZoneInfo data_zone_info = FindDataZoneByIndex(data_zone_list, messsage_addr);
+				const DataZoneInfo* data_zone_info = FindDataZoneByIndex(data_zone_list, messsage_addr);
 			}
 			else if (block_tag == kGlPopDebugGroup)
 			{
@@ -1881,15 +1919,20 @@ void CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_m
 			else if (block_tag == kGlLoadMatrixf)
 			{
 				uint32_t matrix_address = check_uint(parse_ptr);
-				DataZoneInfo data_zone_info = FindDataZoneByIndex(data_zone_list, matrix_address);
 				if (current_matrix_mode == kGlModelView)
 				{
                     //memcpy(current_render_states.m_transform_matrix, data_zone_info.int_data_address, sizeof(float) * 16);
 				}
 				else if (current_matrix_mode == kGlProjection)
 				{
+					const DataZoneInfo* data_zone_info = GetDataZone(data_zone_list, matrix_address, 16 * sizeof(float), context);
+					if (!data_zone_info)
+					{
+						continue;
+					}
+
                     core::matrix4d p_m;
-					float* m_data = data_zone_info.float_data_address;
+					float* m_data = data_zone_info->float_data_address;
                     p_m.set_row(0, core::vec4d(m_data[0], m_data[1], m_data[2], m_data[3]));
                     p_m.set_row(1, core::vec4d(m_data[4], m_data[5], m_data[6], m_data[7]));
                     p_m.set_row(2, core::vec4d(m_data[8], m_data[9], m_data[10], m_data[11]));
@@ -2024,7 +2067,7 @@ void CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_m
 				uint32_t result = check_uint(parse_ptr);
 				uint32_t program_id = check_uint(parse_ptr + 4);
 				uint32_t name_address = check_uint(parse_ptr + 8);
-				DataZoneInfo data_zone_info = FindDataZoneByIndex(data_zone_list, name_address);
+				const DataZoneInfo* data_zone_info = FindDataZoneByIndex(data_zone_list, name_address);
 			}
 			else if (block_tag == kGlCreateShader)
 			{
@@ -2035,9 +2078,7 @@ void CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_m
 			{
 
 			}
-			else if (block_tag == kGlCreateProgram ||
-				block_tag == kGlDeleteProgram ||
-				block_tag == kGlCreateShaderProgramEXT ||
+			else if (block_tag == kGlCreateShaderProgramEXT ||
 				block_tag == kGlCreateShaderProgramv ||
 				block_tag == kGlGenRenderbuffers ||
 				block_tag == kGlGenQueries ||
@@ -2046,7 +2087,6 @@ void CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_m
 				block_tag == kGlEndQuery ||
 				block_tag == kGlAttachShader ||
 				block_tag == kGlDetachShader ||
-				block_tag == kGlBindVertexArray ||
 				block_tag == kGlBindVertexBuffer ||
 				block_tag == kGlBindVertexBuffers ||
 				block_tag == kGlShadeModel ||
@@ -2114,7 +2154,7 @@ void CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_m
 				uint32_t op = check_uint(parse_ptr);
 				if (op == kGlTexture1D || op == kGlTexture2D)
 				{
-                    current_render_states.m_textureSlot[currentTextureSlot].index_in_list = INVALID_VALUE;
+                    current_render_states.m_textureSlot[gl_state.get_active_texture_unit()].index_in_list = INVALID_VALUE;
 				}
 			}
 			else if (block_tag == kGlIsEnabled)
@@ -2127,7 +2167,7 @@ void CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_m
                 vector<string> name_list;
 				for (int i = 0; i < total_num; i++)
 				{
-					uint32_t num_items = command_zone_list[i].buffer_size / 4;
+					uint32_t num_items = command_zone_list[i_cmd].buffer_size / 4;
 					if (!g_glFunctionsInfo[i].m_used && g_glFunctionsInfo[i].m_numPointers == 0 && (g_glFunctionsInfo[i].m_numParameters + g_glFunctionsInfo[i].m_return) == num_items)
 					{
 						name_list.push_back(g_glFunctionsInfo[i].m_name);
@@ -2136,10 +2176,67 @@ void CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_m
 			}
 		}
 
-        delete[] buffer;
+        for (auto& data_zone : data_zone_list)
+        {
+            for (auto& data_block : data_zone.block_list)
+            {
+                delete[] data_block.int_data_address;
+            }
+            delete[] data_zone.int_data_address;
+        }
+
+        for (auto& command_zone : command_zone_list)
+        {
+            delete[] command_zone.int_data_address;
+        }
     }
+    else
+    {
+        context.add_error(kGpaErrorFileHeader);
+    }
+
+    return report->error_list.empty();
 }
 
+bool CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_mesh_data, GpaParseReport* report,
+                            bool b_verify_index/* = false*/)
+{
+    uint32_t length = 0;
+    unique_ptr<char[]> buffer(core::LoadFileToMemory(dump_file_name, length));
+
+    GpaParseReport local_report;
+    if (!report)
+    {
+        report = &local_report;
+    }
 
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(buffer.get());
+    size_t size = buffer ? size_t(length) : 0;
+
+    // the sidecar saves walking and hashing the zones again when a capture is reopened.
+    GpaFrameIndex index;
+    string index_file_name = GetGpaFrameIndexFileName(dump_file_name);
+    uint64_t file_size = 0;
+    int64_t file_time = 0;
+    bool has_file_stamp = GetGpaFrameFileStamp(dump_file_name, file_size, file_time) && file_size == size;
+    if (!has_file_stamp ||
+        !LoadGpaFrameIndex(index_file_name, file_size, file_time, index) ||
+        !(b_verify_index ? VerifyGpaFrameIndex(data, size, index) : IsGpaFrameIndexCurrent(data, size, index)))
+    {
+        if (BuildGpaFrameIndex(data, size, index) && has_file_stamp)
+        {
+            index.file_time = file_time;
+            SaveGpaFrameIndex(index_file_name, index);
+        }
+    }
+
+    bool b_succeed = ParseGpaFrame(data, size, index, group_mesh_data, report);
+    if (!b_succeed)
+    {
+        core::output_debug_info("error", dump_file_name + " : " + to_string(report->error_list.size()) + " parse errors, " +
+                                FormatGpaParseError(report->error_list[0]));
+    }
+    return b_succeed;
+}
 
 
@@ -6,23 +6,26 @@
 #include "meshtexture.h"
 #include "meshdata.h"
 #include "imagedownload.h"
+#include "gpaframe.h"
 
 struct GroupMeshData;
 struct BatchMeshData;
 
 void earth_mesh_init();
-void CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_mesh_data);
 void DumpGoogleEarthMeshes(const vector<string>& file_name_list, BatchMeshData* batch_mesh_data, QProgressBar* progress_bar);
 void DumpKmlSplineMeshes(const vector<string>& file_name_list, BatchMeshData* batch_mesh_data, QProgressBar* progress_bar);
 void ExportFbxMeshFile(const string& fbx_file_name, const vector<BatchMeshData*>& batch_mesh_data, QProgressBar* progress_bar);
 void ExportMaMeshFile(const string& fbx_file_name, const vector<BatchMeshData*>& batch_mesh_data, QProgressBar* progress_bar);
-void ImportAndTransformFbxMeshFile(const string& file_name);
+void ImportAndTransformFbxMeshFile(const string& file_name, bool b_orthometric_heights = false);
 void DumpUSGSTexture(const vector<shared_ptr<string>>& file_name_list,
                      vector<DumppedTextureInfo>& dumpped_texture_info_list);
 void DumpUSGSData(const vector<unique_ptr<string>>& file_name_list,
                   const vector<DumppedTextureInfo>& dumpped_texture_info_list,
                   bool split_texture,
                   BatchMeshData* batch_mesh_data);
+bool ExportUSGSTerrainTiles(const vector<unique_ptr<string>>& file_name_list,
+                            const string& folder_name,
+                            const shared_ptr<core::GeoidModel>& geoid_model);
 
 void PreLoadUSGSData(FileDownloader *download,
                      const vector<unique_ptr<string>>& map_name_list,
@@ -31,3 +34,5 @@ void PreLoadUSGSData(FileDownloader *download,
 void GenerateMeshData(const vector<MapInfo>& map_info_list,
                       const uint32_t& grid_size_by_angle,
                       BatchMeshData* batch_mesh_data);
+
+shared_ptr<core::GeoidModel> LoadGeoidModel(bool b_geoid_correction);
@@ -11,8 +11,12 @@
 #include "coregeographic.h"
 #include "GpaDumpAnalyzeTool.h"
 #include "meshdata.h"
+#include "meshclip.h"
+#include "meshbatch.h"
+#include "textureatlas.h"
 #include "worlddata.h"
 #include "kmlfileparser.h"
+#include "registration.h"
 #include <fbxsdk.h>
 
 using namespace std;
@@ -21,192 +25,11 @@ namespace fs = experimental::filesystem::v1;
 core::vec3d ApplyMatrix(const core::vec3f& src_point, const core::matrix4d& transform_mat)
 {
     core::vec3d result;
-    core::vec3d src_point_d(double(src_point.x), double(src_point.y), double(src_point.z));
-    core::vec4d col_0 = transform_mat.get_column(0);
-    core::vec4d col_1 = transform_mat.get_column(1);
-    core::vec4d col_2 = transform_mat.get_column(2);
-
-    result.x = src_point_d.x * col_0.x + src_point_d.y * col_0.y + src_point_d.z * col_0.z + col_0.w;
-    result.y = src_point_d.x * col_1.x + src_point_d.y * col_1.y + src_point_d.z * col_1.z + col_1.w;
-    result.z = src_point_d.x * col_2.x + src_point_d.y * col_2.y + src_point_d.z * col_2.z + col_2.w;
+    core::TransformPointsAffine(&src_point, 1, transform_mat, &result);
 
     return result;
 }
 
-cv::Point3d ApplyRotMatrix(const cv::Point3d& a, const cv::Mat& m)
-{
-    cv::Point3d r;
-    r.x = a.x * m.at<double>(0, 0) + a.y * m.at<double>(1, 0) + a.z * m.at<double>(2, 0);
-    r.y = a.x * m.at<double>(0, 1) + a.y * m.at<double>(1, 1) + a.z * m.at<double>(2, 1);
-    r.z = a.x * m.at<double>(0, 2) + a.y * m.at<double>(1, 2) + a.z * m.at<double>(2, 2);
-
-    return r;
-}
-
-core::vec3f ApplyRotMatrix(const core::vec3f& a, const cv::Mat& m)
-{
-    cv::Point3d r = ApplyRotMatrix(cv::Point3d(double(a.x), double(a.y), double(a.z)), m);
-    return core::vec3f(float(r.x), float(r.y), float(r.z));
-}
-
-void MulMatrix(const core::matrix4d& local_mat, const cv::Mat& global_trans_mat, core::matrix4d& final_trans_mat)
-{
-    for (int i_row = 0; i_row < 4; i_row++)
-        for (int i_col = 0; i_col < 4; i_col++)
-        {
-            core::vec4d row = local_mat.get_row(i_row);
-            core::vec4d col(global_trans_mat.at<double>(0, i_col),
-                            global_trans_mat.at<double>(1, i_col),
-                            global_trans_mat.at<double>(2, i_col),
-                            global_trans_mat.at<double>(3, i_col));
-            final_trans_mat(i_row, i_col) = dot(row, col);
-        }
-}
-
-void GenerateRotateMatrix(const cv::Point3d& axis, const double& angle, cv::Mat& rot_mat)
-{
-    double ca = cos(angle);
-    double osca = (1.0 - ca);
-    double sa = sin(angle);
-    double x = axis.x;
-    double y = axis.y;
-    double z = axis.z;
-    double xx = x * x;
-    double yy = y * y;
-    double zz = z * z;
-    double xy = x * y;
-    double xz = x * z;
-    double yz = y * z;
-
-    rot_mat.at<double>(0, 0) = ca + xx * osca;
-    rot_mat.at<double>(0, 1) = xy * osca - z * sa;
-    rot_mat.at<double>(0, 2) = xz * osca + y * sa;
-    rot_mat.at<double>(1, 0) = xy * osca + z * sa;
-    rot_mat.at<double>(1, 1) = ca + yy * osca;
-    rot_mat.at<double>(1, 2) = yz * osca - x * sa;
-    rot_mat.at<double>(2, 0) = xz * osca - y * sa;
-    rot_mat.at<double>(2, 1) = yz * osca + x * sa;
-    rot_mat.at<double>(2, 2) = ca + zz * osca;
-}
-
-double GetDet(const cv::Point3d& vec)
-{
-    return sqrt(vec.x * vec.x + vec.y * vec.y + vec.z * vec.z);
-}
-
-cv::Point3d Normalize(const cv::Point3d& vec)
-{
-    double det = GetDet(vec);
-    return vec / det;
-}
-
-bool GetRigidTransform(const vector<cv::Point3d>& src_points, const vector<cv::Point3d>& dst_points, cv::Mat& transform_mat)
-{
-    uint64_t num_points = min(src_points.size(), dst_points.size());
-    if (num_points < 3)
-    {
-        return false;
-    }
-    num_points = 3;
-
-    // Bring all the points to the centroid
-    cv::Point3d src_centroid(0, 0, 0);
-    cv::Point3d dst_centroid(0, 0, 0);
-
-    for (uint32_t i = 0; i < num_points; i++)
-    {
-        src_centroid += src_points[i];
-        dst_centroid += dst_points[i];
-    }
-
-    src_centroid /= double(num_points);
-    dst_centroid /= double(num_points);
-
-    vector<cv::Point3d> adj_src_points, adj_dst_points;
-    adj_src_points.reserve(src_points.size());
-    adj_dst_points.reserve(dst_points.size());
-    for (uint32_t i = 0; i < num_points; i++)
-    {
-        adj_src_points.push_back(src_points[i] - src_centroid);
-        adj_dst_points.push_back(dst_points[i] - dst_centroid);
-    }
-
-    double sum_src_dist = 0, sum_dst_dist = 0;
-    for (uint32_t i = 0; i < num_points; i++)
-    {
-        sum_src_dist += sqrt(adj_src_points[i].dot(adj_src_points[i]));
-        sum_dst_dist += sqrt(adj_dst_points[i].dot(adj_dst_points[i]));
-    }
-
-    double src_scale = sum_src_dist / num_points;
-    double dst_scale = sum_dst_dist / num_points;
-
-    cv::Point3d s_sum_normal(0, 0, 0), d_sum_normal(0, 0, 0);
-    for (uint32_t i = 0; i < num_points; i++)
-    {
-        cv::Point3d s_vec_0 = Normalize(adj_src_points[i]);
-        cv::Point3d s_vec_1 = Normalize(adj_src_points[(i + 1) % num_points]);
-        cv::Point3d d_vec_0 = Normalize(adj_dst_points[i]);
-        cv::Point3d d_vec_1 = Normalize(adj_dst_points[(i + 1) % num_points]);
-        double s_weight = acos(abs(s_vec_0.dot(s_vec_1)));
-        s_sum_normal += Normalize(s_vec_0.cross(s_vec_1)) * s_weight;
-        double d_weight = acos(abs(d_vec_0.dot(d_vec_1)));
-        d_sum_normal += Normalize(d_vec_0.cross(d_vec_1)) * d_weight;
-    }
-
-    cv::Point3d s_poly_normal = Normalize(s_sum_normal);
-    cv::Point3d d_poly_normal = Normalize(d_sum_normal);
-
-    cv::Point3d cross_vec = s_poly_normal.cross(d_poly_normal);
-    double sin_a = GetDet(cross_vec);
-    cv::Point3d rot_axis = cross_vec / sin_a;
-
-    cv::Mat rot_mat_0(3, 3, CV_64F);
-    GenerateRotateMatrix(rot_axis, -asin(sin_a), rot_mat_0);
-
-    cv::Point3d& rot_axis_1 = d_poly_normal;
-
-    double sum_rot_angle = 0.0;
-    for (uint32_t i = 0; i < num_points; i++)
-    {
-        cv::Point3d n_s_vec_1 = Normalize(ApplyRotMatrix(adj_src_points[i], rot_mat_0));
-        cv::Point3d n_d_vec_1 = Normalize(adj_dst_points[i]);
-
-        cv::Point3d n_s_norm_1 = Normalize(rot_axis_1.cross(n_s_vec_1));
-        cv::Point3d n_d_norm_1 = Normalize(rot_axis_1.cross(n_d_vec_1));
-
-        cv::Point3d cross_vec_1 = n_s_norm_1.cross(n_d_norm_1);
-        double sin_a_1 = GetDet(cross_vec_1);
-
-        if (rot_axis_1.dot(cross_vec_1) < 0.0)
-        {
-            sin_a_1 = -sin_a_1;
-        }
-
-        sum_rot_angle += -asin(sin_a_1);
-    }
-
-    cv::Mat rot_mat_1(3, 3, CV_64F);
-    GenerateRotateMatrix(rot_axis_1, sum_rot_angle / num_points, rot_mat_1);
-
-    double scale_value = dst_scale / src_scale;
-    cv::Mat scale_mat = (cv::Mat_<double>(3, 3) << scale_value, 0, 0, 0, scale_value, 0, 0, 0, scale_value);
-
-    cv::Mat rot_scale_mat = rot_mat_0 * rot_mat_1 * scale_mat;
-
-    cv::Mat rot_scale_mat4x4 = (cv::Mat_<double>(4, 4) <<
-        rot_scale_mat.at<double>(0, 0), rot_scale_mat.at<double>(0, 1), rot_scale_mat.at<double>(0, 2), 0,
-        rot_scale_mat.at<double>(1, 0), rot_scale_mat.at<double>(1, 1), rot_scale_mat.at<double>(1, 2), 0,
-        rot_scale_mat.at<double>(2, 0), rot_scale_mat.at<double>(2, 1), rot_scale_mat.at<double>(2, 2), 0,
-        0, 0, 0, 1);
-
-    cv::Mat pre_trans_mat4x4 = (cv::Mat_<double>(4, 4) << 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, -src_centroid.x, -src_centroid.y, -src_centroid.z, 1);
-    cv::Mat post_trans_mat4x4 = (cv::Mat_<double>(4, 4) << 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, dst_centroid.x, dst_centroid.y, dst_centroid.z, 1);
-    transform_mat = pre_trans_mat4x4 * rot_scale_mat4x4 * post_trans_mat4x4;
-
-    return true;
-}
-
 cv::Mat EulerAnglesToRotationMatrix(core::vec3d &theta)
 {
     // Calculate rotation about x axis
@@ -309,10 +132,12 @@ bool IsMeshAreTheSame(const MeshData* mesh_0, const MeshData* mesh_1)
     return false;
 }
 
-bool DumpGeFilesWithReference(const string& kml_name,
+// the dump's meshes, and the ge polygon corners paired with the kml polygon's.
+bool LoadGeFilesWithReference(const string& kml_name,
                               const string& dump_name,
-                              const core::CoordinateTransformer& gps_to_env_cnvt,
-                              GroupMeshData* group_mesh_data)
+                              GroupMeshData* group_mesh_data,
+                              PointCorrespondences& correspondences,
+                              bool& has_reference)
 {
     vector<pair<uint32_t, unique_ptr<core::vec3d[]>>> lines;
     vector<pair<uint32_t, unique_ptr<core::vec3d[]>>> polys;
@@ -325,17 +150,17 @@ bool DumpGeFilesWithReference(const string& kml_name,
         return false;
     }
 
-    vector<cv::Point3d> target_point_list;
+    vector<core::vec3d> target_point_list;
     if (polys.size() > 0) {
         core::vec3d* poly_array = polys[0].second.get();
         for (uint32_t i = 0; i < polys[0].first - 1; i++)
         {
             core::vec4d pos_ls = core::vec4d(poly_array[i].x, poly_array[i].y, poly_array[i].z, 1.0);
-            target_point_list.push_back(cv::Point3d(pos_ls.x, pos_ls.y, pos_ls.z));
+            target_point_list.push_back(core::vec3d(pos_ls.x, pos_ls.y, pos_ls.z));
         }
     }
 
-    vector<cv::Point3d> source_point_list;
+    vector<core::vec3d> source_point_list;
     uint32_t num_non_tri_meshes = 0;
     for (uint32_t i = 0; i < group_mesh_data->meshes.size(); i++)
     {
@@ -357,10 +182,12 @@ bool DumpGeFilesWithReference(const string& kml_name,
                 auto& vertex_list = data_mesh->vertex_list;
                 if (vertex_list)
                 {
-                    for (int j = 0; j < data_mesh->num_vertex - 1; j++)
+                    uint32_t num_points = uint32_t(max(data_mesh->num_vertex - 1, 0));
+                    vector<core::vec3d> transformed_list(num_points);
+                    core::TransformPointsAffine(vertex_list.get(), num_points, data_mesh->dumpped_matrix, transformed_list.data());
+                    for (uint32_t j = 0; j < num_points; j++)
                     {
-                        core::vec3d transformed_position = ApplyMatrix(vertex_list[j], data_mesh->dumpped_matrix);
-                        source_point_list.push_back(cv::Point3d(transformed_position.x, transformed_position.y, transformed_position.z));
+                        source_point_list.push_back(transformed_list[j]);
                     }
 
                     // polygon (TriangleStrip index order is 1, 2, 0, 3)
@@ -374,9 +201,25 @@ bool DumpGeFilesWithReference(const string& kml_name,
         }
     }
 
-    double data[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
-    cv::Mat rigid_transform_matrix =  cv::Mat(4, 4, CV_64F, data);
-    GetRigidTransform(source_point_list, target_point_list, rigid_transform_matrix);
+    has_reference = target_point_list.size() > 0;
+    size_t num_pairs = min(source_point_list.size(), target_point_list.size());
+    correspondences.src_list.assign(source_point_list.begin(), source_point_list.begin() + num_pairs);
+    correspondences.dst_list.assign(target_point_list.begin(), target_point_list.begin() + num_pairs);
+
+    return true;
+}
+
+// place the meshes with the capture to earth transform, identity if the registration failed.
+void ApplyGeReference(const RegistrationResult& registration,
+                      bool has_reference,
+                      const core::CoordinateTransformer& gps_to_env_cnvt,
+                      GroupMeshData* group_mesh_data)
+{
+    core::matrix4d reference_matrix;
+    if (registration.b_valid)
+    {
+        reference_matrix = registration.transform;
+    }
 
     for (uint32_t iMesh = 0; iMesh < group_mesh_data->meshes.size(); iMesh++)
     {
@@ -385,11 +228,10 @@ bool DumpGeFilesWithReference(const string& kml_name,
         if (mesh_data)
         {
             bool is_renderable_mesh = mesh_data->draw_call_list[0].is_ge_mesh();
-            core::matrix4d local_world_matrix;
-            MulMatrix(mesh_data->dumpped_matrix, rigid_transform_matrix, local_world_matrix);
+            core::matrix4d local_world_matrix = mesh_data->dumpped_matrix * reference_matrix;
 
             if (is_renderable_mesh) {
-                if (target_point_list.size() > 0) {
+                if (has_reference) {
                     auto& vertex_list = mesh_data->vertex_list;
                     std::vector<core::vec3d> tmp_vertex_list;
                     tmp_vertex_list.resize(mesh_data->num_vertex);
@@ -439,21 +281,77 @@ bool DumpGeFilesWithReference(const string& kml_name,
             }
         }
     }
+}
 
-    return true;
+// cut the dump's meshes exactly at the scissor rectangle instead of keeping whole tiles
+// that hang past it. needs the gps coordinates a referenced dump has.
+void ClipGroupToScissor(const core::bounds2d& scissor_bbox, GroupMeshData* group_mesh_data)
+{
+    vector<core::vec2d> polygon = { scissor_bbox.bb_min, core::vec2d(scissor_bbox.bb_max.x, scissor_bbox.bb_min.y),
+                                    scissor_bbox.bb_max, core::vec2d(scissor_bbox.bb_min.x, scissor_bbox.bb_max.y) };
+    vector<unique_ptr<MeshData>> clipped_mesh_list;
+    ClipMeshesToPolygon(group_mesh_data->meshes, polygon, kMeshClipGps, clipped_mesh_list);
+
+    vector<MeshData*> mesh_list;
+    group_mesh_data->bbox_ws.Reset();
+    group_mesh_data->bbox_gps.Reset();
+    for (uint32_t i = 0; i < group_mesh_data->meshes.size(); i++)
+    {
+        SAFE_DELETE(group_mesh_data->meshes[i]);
+        if (clipped_mesh_list[i])
+        {
+            group_mesh_data->bbox_ws += clipped_mesh_list[i]->bbox_ws;
+            group_mesh_data->bbox_gps += clipped_mesh_list[i]->bbox_gps;
+            mesh_list.push_back(clipped_mesh_list[i].release());
+        }
+    }
+    group_mesh_data->meshes = move(mesh_list);
 }
 
 void DumpGoogleEarthMeshes(const vector<string>& file_name_list, BatchMeshData* batch_mesh_data, QProgressBar* progress_bar)
 {
     core::CoordinateTransformer gps_to_env_cnvt(batch_mesh_data->reference_pos.y, batch_mesh_data->reference_pos.x, 0.0);
 
+    // each frame is registered as it loads, a wrong kml point is left out of its frame's
+    // fit instead of skewing it. noisy references still get the fit over all their pairs.
+    RegistrationOptions registration_options;
+    registration_options.least_squares_fallback = true;
+
     for (uint32_t i_dump = 0; i_dump < file_name_list.size(); i_dump++)
     {
         uint64_t file_name_pos = file_name_list[i_dump].rfind('.');
         string kml_file_name = file_name_list[i_dump].substr(0, file_name_pos) + ".kml";
         GroupMeshData* group_mesh_data = new GroupMeshData;
 
-        bool has_valid_tri_meshes = DumpGeFilesWithReference(kml_file_name, file_name_list[i_dump], gps_to_env_cnvt, group_mesh_data);
+        PointCorrespondences correspondences;
+        bool has_reference = false;
+        bool has_valid_tri_meshes = LoadGeFilesWithReference(kml_file_name, file_name_list[i_dump], group_mesh_data, correspondences, has_reference);
+
+        RegistrationOptions dump_options = registration_options;
+        dump_options.random_seed = registration_options.random_seed + i_dump;
+        RegistrationResult registration;
+        RegisterPoints(correspondences, dump_options, registration);
+
+        if (has_reference && !registration.b_valid)
+        {
+            core::output_debug_info("reference failed", file_name_list[i_dump] + " : no transform from " +
+                                    to_string(correspondences.src_list.size()) + " reference points, placed untransformed");
+        }
+        else if (registration.b_least_squares || registration.num_inliers < registration.residual_list.size())
+        {
+            string residuals;
+            for (uint32_t i = 0; i < registration.residual_list.size(); i++)
+            {
+                residuals += (i > 0 ? ", " : "") + to_string(registration.residual_list[i]);
+            }
+            core::output_debug_info(registration.b_least_squares ? "reference least squares" : "reference outliers",
+                                    file_name_list[i_dump] + " residuals : " + residuals);
+        }
+
+        if (has_valid_tri_meshes)
+        {
+            ApplyGeReference(registration, has_reference, gps_to_env_cnvt, group_mesh_data);
+        }
 
         // remove all non-tri meshes.
         if (has_valid_tri_meshes)
@@ -488,6 +386,12 @@ void DumpGoogleEarthMeshes(const vector<string>& file_name_list, BatchMeshData*
             }
         }
 
+        // if scissor rectangle not empty, only what is inside it is kept.
+        if (has_valid_tri_meshes && has_reference && batch_mesh_data->scissor_bbox.GetRadius() > 0.0001)
+        {
+            ClipGroupToScissor(batch_mesh_data->scissor_bbox, group_mesh_data);
+        }
+
         if (group_mesh_data->meshes.size() > 0)
         {
             for (uint32_t i = 0; i < batch_mesh_data->group_meshes.size(); i++)
@@ -537,6 +441,9 @@ void DumpGoogleEarthMeshes(const vector<string>& file_name_list, BatchMeshData*
                 }
             }
 
+            // one bind per atlas page instead of one per mesh.
+            BuildGroupTextureAtlas(group_mesh_data);
+
             batch_mesh_data->group_meshes.push_back(group_mesh_data);
             batch_mesh_data->bbox_ws += group_mesh_data->bbox_ws;
             batch_mesh_data->bbox_gps += group_mesh_data->bbox_gps;
@@ -544,6 +451,14 @@ void DumpGoogleEarthMeshes(const vector<string>& file_name_list, BatchMeshData*
 
         progress_bar->setValue(int32_t(float(i_dump + 1) / float(file_name_list.size()) * 100.0f));
     }
+
+    // merged once every dump is in, the duplicate test above compares single meshes.
+    MeshBatchStats batch_stats;
+    for (auto group_mesh_data : batch_mesh_data->group_meshes)
+    {
+        batch_stats += MergeGroupMeshes(group_mesh_data);
+    }
+    core::output_debug_info("mesh batching", FormatMeshBatchStats(batch_stats));
 }
 
 struct GpsRay
@@ -135,35 +135,36 @@ void ExportTextureList(const GroupMeshData* group_mesh_data,
 
             if (decode_dxt1 || tex_info->m_format == kGlRgb || tex_info->m_format == kGlRgba)
             {
-                uint8_t* src_tex_data = nullptr;
-                unique_ptr<uint32_t[]> tmp_tex_data;
                 uint32_t w = tex_info->m_mips[0].m_width;
                 uint32_t h = tex_info->m_mips[0].m_height;
                 uint32_t channel_count = tex_info->m_format == kGlRgb ? 3 : 4;
 
                 uint8_t* src_img_data = reinterpret_cast<uint8_t*>(tex_info->m_mips[0].m_imageData.get());
+
+                string texture_name = tex_idx_string + ".jpg";
+                tex_name_list[i] = texture_root_path + "texture_" + texture_name;
+
                 if (decode_dxt1)
                 {
-                    tmp_tex_data = make_unique<uint32_t[]>(w * h);
-                    src_tex_data = reinterpret_cast<uint8_t*>(tmp_tex_data.get());
-                    core::Dxt1Convertor::DecodeDxt1Texture(tmp_tex_data.get(), w, h, src_img_data);
+                    // decoded straight to flipped bgr, opencv's layout, no split/merge/flip pass.
+                    unique_ptr<uint8_t[]> bgr_data = make_unique<uint8_t[]>(size_t(w) * h * 3);
+                    core::Dxt1Convertor::DecodeDxt1Image(bgr_data.get(), w, h, src_img_data, 3, true, true);
+                    cv::imwrite(tex_name_list[i], cv::Mat(int32_t(h), int32_t(w), CV_8UC3, bgr_data.get()));
                 }
                 else
                 {
-                    src_tex_data = src_img_data;
+                    ExportJpgFile(tex_name_list[i], w, h, channel_count, true, src_img_data);
                 }
-
-                string texture_name = tex_idx_string + ".jpg";
-                tex_name_list[i] = texture_root_path + "texture_" + texture_name;
-
-                ExportJpgFile(tex_name_list[i], w, h, channel_count, !decode_dxt1, src_tex_data);
             }
             else
             {
                 core::TextureFileInfo tex_file_info;
                 if (tex_info->m_format == kGLCmpsdRgbaS3tcDxt3Ext || tex_info->m_format == kGLCmpsdRgbaS3tcDxt5Ext)
                 {
-                    core::ExportDdsImageFile(tex_info, &tex_file_info);
+                    // captured textures usually carry level 0 only, give the dds a full chain.
+                    core::Texture2DInfo mipped_info;
+                    bool has_mips = tex_info->m_levelCount == 1 && core::BuildMipChain(tex_info, &mipped_info);
+                    core::ExportDdsImageFile(has_mips ? &mipped_info : tex_info, &tex_file_info);
                     tex_name_list[i] = texture_root_path + "texture_" + tex_idx_string + ".dds";
 
                     ExportTextureFile(tex_name_list[i], &tex_file_info);
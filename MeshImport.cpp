@@ -483,7 +483,7 @@ void SaveSmapToKmlFile(const std::string& file_name)
     }
 }
 
-void ImportAndTransformFbxMeshFile(const string& file_name)
+void ImportAndTransformFbxMeshFile(const string& file_name, bool b_orthometric_heights/* = false*/)
 {
     core::vec2d ref_utm_coord(582186.375, 4137432.25);
     int zone_id = 10;
@@ -562,6 +562,10 @@ void ImportAndTransformFbxMeshFile(const string& file_name)
         exit(-1);
     }
 
+    // an fbx carries no vertical datum, heights are taken as ellipsoidal unless the caller
+    // says they are orthometric, enu space is relative to the ellipsoid.
+    shared_ptr<core::GeoidModel> geoid_model = LoadGeoidModel(b_orthometric_heights);
+
     core::vec2d max_error(0.0, 0.0);
     for (int32_t i_node = 0; i_node < pScene->GetNodeCount(); i_node++)
     {
@@ -572,16 +576,35 @@ void ImportAndTransformFbxMeshFile(const string& file_name)
         {
             fbxsdk::FbxMesh* mesh = lMeshNode->GetMesh();
             FbxVector4* vertices = mesh->GetControlPoints();
-            for (int32_t i_cp = 0; i_cp < mesh->GetControlPointsCount(); i_cp++)
+            int32_t num_control_points = mesh->GetControlPointsCount();
+
+            // project the whole mesh at once, the round trip is only kept for the error check.
+            vector<core::vec2d> utm_coords(size_t(max(num_control_points, 0)));
+            vector<core::vec2d> gps_coords(utm_coords.size());
+            vector<core::vec2d> utm_check_coords(utm_coords.size());
+            for (int32_t i_cp = 0; i_cp < num_control_points; i_cp++)
+            {
+                utm_coords[i_cp] = core::vec2d(vertices[i_cp][0] + ref_utm_coord.x, -vertices[i_cp][2] + ref_utm_coord.y);
+            }
+
+            bool northp = true;
+            ToGeographicCoords(utm_coords.data(), gps_coords.data(), utm_coords.size(), zone_id, northp);
+            FromGeographicCoords(gps_coords.data(), utm_check_coords.data(), gps_coords.size(), zone_id, northp);
+
+            for (int32_t i_cp = 0; i_cp < num_control_points; i_cp++)
             {
                 FbxVector4 v = FbxVector4(vertices[i_cp][0], -vertices[i_cp][2], vertices[i_cp][1], vertices[i_cp][3]);
                 v += FbxVector4(ref_utm_coord.x, ref_utm_coord.y, 0.0, 0.0);
-                core::vec2d gps_coord_2d = ToGeographicCoord(core::vec2d(v[0], v[1]), zone_id);
-                core::vec2d utm_coord_2d = FromGeographicCoord(gps_coord_2d, zone_id);
+                const core::vec2d& gps_coord_2d = gps_coords[i_cp];
+                const core::vec2d& utm_coord_2d = utm_check_coords[i_cp];
 
                 //core::output_debug_info("Import Fbx File, position : ", to_string(gps_coord_2d.x) + " " + to_string(gps_coord_2d.y));
 
                 core::GpsCoord gps_coord(gps_coord_2d.y, gps_coord_2d.x, v[2]);
+                if (geoid_model)
+                {
+                    gps_coord.alt += geoid_model->undulation(gps_coord.lat, gps_coord.lon);
+                }
                 core::vec3d pos_ws = gps_to_env_cnvt.lla_to_enu(gps_coord);
                 core::GpsCoord pos_gps = gps_to_env_cnvt.enu_to_lla(pos_ws);
                 core::vec3d pos_ws_1 = gps_to_env_cnvt.lla_to_enu(pos_gps);
@@ -66,7 +66,24 @@ SOURCES += \
     KmlFileParser.cpp \
     CoreGeographic.cpp \
     MeshExport.cpp \
+    boundsgrid.cpp \
+    coreblockcodec.cpp \
+    corepng.cpp \
     coretexture.cpp \
+    elevationgrid.cpp \
+    gpadiff.cpp \
+    gpaframe.cpp \
+    glstate.cpp \
+    meshbatch.cpp \
+    meshclip.cpp \
+    occlusionculling.cpp \
+    pointcloud.cpp \
+    quantizedmesh.cpp \
+    registration.cpp \
+    textureatlas.cpp \
+    tileset.cpp \
+    tiledimage.cpp \
+    vertexformat.cpp \
     hfa/hfaband.cpp \
     hfa/hfacompress.cpp \
     hfa/hfadictionary.cpp \
@@ -84,6 +101,7 @@ SOURCES += \
     port/cpl_string.cpp \
     port/cpl_vsi_mem.cpp \
     port/cpl_vsil.cpp \
+    port/cpl_vsil_mmap.cpp \
     port/cpl_vsil_win32.cpp \
     port/cpl_vsisimple.cpp \
     UsgsMeshCreator.cpp \
@@ -112,20 +130,39 @@ HEADERS += \
     port/cpl_vsi_private.h \
     include/meshtexture.h \
     include/base.h \
+    include/boundsgrid.h \
+    include/coreblockcodec.h \
     include/corebounds.h \
     include/corefile.h \
     include/coregeographic.h \
     include/coremath.h \
+    include/corepng.h \
     include/corematrix.h \
     include/coreprimitive.h \
+    include/coresimd.h \
+    include/corethread.h \
     include/corequaternion.h \
     include/coretexture.h \
+    include/elevationgrid.h \
+    include/gpadiff.h \
+    include/gpaframe.h \
+    include/glstate.h \
+    include/pointcloud.h \
+    include/quantizedmesh.h \
+    include/registration.h \
+    include/textureatlas.h \
+    include/tileset.h \
+    include/tiledimage.h \
+    include/vertexformat.h \
     include/corevector.h \
     include/glfunctionlist.h \
     include/kmlfileparser.h \
     include/mainwindow.h \
+    include/meshclip.h \
+    include/meshbatch.h \
     include/meshdata.h \
     include/meshtexture.h \
+    include/occlusionculling.h \
     include/oglwidget.h \
     include/worlddata.h \
     include/oglshaders.h \
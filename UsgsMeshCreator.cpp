@@ -12,6 +12,10 @@
 #include "GpaDumpAnalyzeTool.h"
 #include "coregeographic.h"
 #include "meshdata.h"
+#include "elevationgrid.h"
+#include "tiledimage.h"
+#include "quantizedmesh.h"
+#include "debugout.h"
 #include "meshtexture.h"
 #include "worlddata.h"
 #include "kmlfileparser.h"
@@ -77,24 +81,30 @@ core::vec2d GetSubImageInfo(core::vec2i sample_idx, core::vec2i num_samples, cor
     return ofs + pixel_size * img_index;
 }
 
-float LookupAltitudeMap(double s_x, double s_y, const float* height_map, int nXSize)
+shared_ptr<core::GeoidModel> LoadGeoidModel(bool b_geoid_correction)
 {
-    int x_low = int32_t(floor(s_x));
-    int y_low = int32_t(floor(s_y));
-
-    float h_00 = height_map[y_low * nXSize + x_low];
-    float h_01 = height_map[y_low * nXSize + x_low + 1];
-    float h_10 = height_map[(y_low + 1) * nXSize + x_low];
-    float h_11 = height_map[(y_low + 1) * nXSize + x_low + 1];
-
-    double s_x_ofs = s_x - double(x_low);
-    double s_y_ofs = s_y - double(y_low);
+    // off unless asked for, heights must not depend on which grids a machine has installed.
+    if (!b_geoid_correction)
+    {
+        return nullptr;
+    }
 
-    h_00 = h_00 * (1.0f - float(s_x_ofs)) + h_01 * float(s_x_ofs);
-    h_10 = h_10 * (1.0f - float(s_x_ofs)) + h_11 * float(s_x_ofs);
-    float h = h_00 * (1.0f - float(s_y_ofs)) + h_10 * float(s_y_ofs);
+    // loaded once. the default grid is egm96, a global model and not the hybrid geoid
+    // navd88 heights are defined by (geoid18), the two differ by decimeters up to a meter.
+    if (!g_world.geoid_model)
+    {
+        auto geoid_model = make_shared<core::GeoidModel>();
+        if (geoid_model->load())
+        {
+            g_world.geoid_model = geoid_model;
+        }
+        else
+        {
+            core::output_debug_info("geoid", "no geoid grid installed, heights are left orthometric");
+        }
+    }
 
-    return h;
+    return g_world.geoid_model;
 }
 
 void PreLoadUSGSData(FileDownloader *download,
@@ -125,7 +135,6 @@ void PreLoadUSGSData(FileDownloader *download,
                 core::vec2d s_pixel_size(pixel_size.width, -pixel_size.height);
                 core::vec2d img_ul_center(ul_center.x, ul_center.y);
 
-                HFABand ** papoBandList = hHFA->papoBand;
                 for (int b = 1; b <= nBands; b++)
                 {
                     int	nDataType, nOverviews;
@@ -137,47 +146,7 @@ void PreLoadUSGSData(FileDownloader *download,
                     printf("Band %d: %dx%d tiles, type = %d\n",
                         b, nBlockXSize, nBlockYSize, nDataType);
 
-                    int nBlocksPerRow = (nXSize + nBlockXSize - 1) / nBlockXSize;
-                    int nBlocksPerColumn = (nYSize + nBlockYSize - 1) / nBlockYSize;
-
-                    HFABand* poBand = papoBandList[b - 1];
-                    int nDataBits = HFAGetDataTypeBits(poBand->nDataType);
-
-                    double t_min = 100000.0;
-                    double t_max = -100000.0;
-                    uint8_t *pabyTile = new uint8_t[uint32_t(nBlockXSize * nBlockYSize * nDataBits / 8)];
                     MapInfo map_info;
-                    map_info.alt_list = make_unique<float[]>(uint32_t(nXSize * nYSize));
-
-                    if (pabyTile)
-                    {
-                        for (int b_y = 0; b_y < nBlocksPerColumn; b_y++)
-                        {
-                            for (int b_x = 0; b_x < nBlocksPerRow; b_x++)
-                            {
-                                if (poBand->GetRasterBlock(b_x, b_y, pabyTile) != CE_Failure)
-                                {
-                                    float* f_height = reinterpret_cast<float*>(pabyTile);
-                                    for (int i = 0; i < nBlockYSize; i++)
-                                    {
-                                        int y = b_y * nBlockYSize + i;
-                                        for (int j = 0; j < nBlockXSize; j++)
-                                        {
-                                            int x = b_x * nBlockXSize + j;
-                                            if (y < nYSize && x < nXSize)
-                                            {
-                                                float h = f_height[i * nBlockXSize + j];
-                                                map_info.alt_list[uint32_t(y * nXSize + x)] = h;
-                                                t_min = min(t_min, double(h));
-                                                t_max = max(t_max, double(h));
-                                            }
-                                        }
-                                    }
-                                }
-                            }
-                        }
-                    }
-
                     map_info.ul_corner = img_ul_center;
                     map_info.pixel_size = s_pixel_size;
                     map_info.pixel_count = core::vec2i(nXSize, nYSize);
@@ -238,12 +207,28 @@ void GenerateMeshData(const vector<MapInfo>& map_info_list,
         render_block->num_vertex = num_y * num_x;
         render_block->vertex_list = make_unique<core::vec3f[]>(uint32_t(render_block->num_vertex));
 
+        vector<core::GpsCoord> gps_coord_list;
+        gps_coord_list.reserve(uint32_t(render_block->num_vertex));
+        for (int y = i_bbox.bb_min.y; y <= i_bbox.bb_max.y; y++)
+        {
+            for (int x = i_bbox.bb_min.x; x <= i_bbox.bb_max.x; x++)
+            {
+                gps_coord_list.push_back(core::GpsCoord(double(x) / grid_size_by_angle, double(y) / grid_size_by_angle, 0.0));
+            }
+        }
+
+        // grid sits at orthometric height 0, move it onto the geoid.
+        if (batch_mesh_data->geoid_model)
+        {
+            batch_mesh_data->geoid_model->orthometric_to_ellipsoidal(gps_coord_list.data(), gps_coord_list.size());
+        }
+
         int idx = 0;
         for (int y = i_bbox.bb_min.y; y <= i_bbox.bb_max.y; y++)
         {
             for (int x = i_bbox.bb_min.x; x <= i_bbox.bb_max.x; x++)
             {
-                core::GpsCoord gps_coord(double(x) / grid_size_by_angle, double(y) / grid_size_by_angle, 0.0);
+                const core::GpsCoord& gps_coord = gps_coord_list[uint32_t(idx)];
                 render_block->vertex_list[uint32_t(idx)] = gps_to_env_cnvt.lla_to_enu(gps_coord);
                 render_block->uv_list[uint32_t(idx)] = core::vec2f(0, 0);
                 render_block->bbox_ws += render_block->vertex_list[uint32_t(idx)];
@@ -338,6 +323,45 @@ struct ScissorMeshInfo
     int tex_id;
 };
 
+// elevation band of every map, opened together so the maps are meshed as one surface.
+void OpenUSGSElevationMosaic(const vector<unique_ptr<string>>& file_name_list,
+                             ElevationMosaic& elevation_mosaic,
+                             vector<int32_t>& tile_idx_list)
+{
+    tile_idx_list.assign(file_name_list.size(), -1);
+    for (uint32_t i_map = 0; i_map < file_name_list.size(); i_map++)
+    {
+        const string& file_name = *file_name_list[i_map].get();
+        HFAHandle hHFA = HFAOpen(file_name.c_str(), "r");
+        if (hHFA)
+        {
+            const Eprj_MapInfo* psMapInfo = HFAGetMapInfo(hHFA);
+            auto height_map = make_shared<ElevationGrid>();
+            if (psMapInfo && height_map->open(file_name, 1, elevation_mosaic.get_cache()))
+            {
+                core::vec2d s_pixel_size(psMapInfo->pixelSize.width, -psMapInfo->pixelSize.height);
+                core::vec2d img_ul_center(psMapInfo->upperLeftCenter.x, psMapInfo->upperLeftCenter.y);
+                tile_idx_list[i_map] = int32_t(elevation_mosaic.add_tile(height_map, img_ul_center, s_pixel_size));
+            }
+            HFAClose(hHFA);
+        }
+    }
+
+    elevation_mosaic.build();
+}
+
+// quantized mesh terrain tiles of the maps, for cesium style streaming clients.
+bool ExportUSGSTerrainTiles(const vector<unique_ptr<string>>& file_name_list,
+                            const string& folder_name,
+                            const shared_ptr<core::GeoidModel>& geoid_model)
+{
+    ElevationMosaic elevation_mosaic;
+    vector<int32_t> tile_idx_list;
+    OpenUSGSElevationMosaic(file_name_list, elevation_mosaic, tile_idx_list);
+
+    return ExportQuantizedMeshTiles(elevation_mosaic, folder_name, TerrainTilerOptions(), geoid_model.get());
+}
+
 void DumpUSGSData(const vector<unique_ptr<string>>& file_name_list,
                   const vector<DumppedTextureInfo>& dumpped_texture_info_list,
                   bool split_texture,
@@ -345,6 +369,10 @@ void DumpUSGSData(const vector<unique_ptr<string>>& file_name_list,
 {
     core::CoordinateTransformer gps_to_env_cnvt(batch_mesh_data->reference_pos.y, batch_mesh_data->reference_pos.x, 0.0);
 
+    ElevationMosaic elevation_mosaic;
+    vector<int32_t> tile_idx_list;
+    OpenUSGSElevationMosaic(file_name_list, elevation_mosaic, tile_idx_list);
+
     for (uint32_t i_map = 0; i_map < file_name_list.size(); i_map++)
     {
         HFAHandle	hHFA;
@@ -389,11 +417,7 @@ void DumpUSGSData(const vector<unique_ptr<string>>& file_name_list,
                     printf("Band %d: %dx%d tiles, type = %d\n",
                         b, nBlockXSize, nBlockYSize, nDataType);
 
-                    int nBlocksPerRow = (nXSize + nBlockXSize - 1) / nBlockXSize;
-                    int nBlocksPerColumn = (nYSize + nBlockYSize - 1) / nBlockYSize;
-
                     HFABand* poBand = papoBandList[b - 1];
-                    int nDataBits = HFAGetDataTypeBits(poBand->nDataType);
 
                     double h_min = 0;
                     double h_max = 0;
@@ -412,12 +436,10 @@ void DumpUSGSData(const vector<unique_ptr<string>>& file_name_list,
                         h_stddev = poStats->GetDoubleField("stddev");
                     }
 
-                    double t_min = 100000.0;
-                    double t_max = -100000.0;
-                    uint8_t *pabyTile = new uint8_t[uint32_t(nBlockXSize * nBlockYSize * nDataBits / 8)];
-                    float* height_map = new float[uint32_t(nXSize * nYSize)];
-
-                    if (pabyTile)
+                    // elevation blocks are paged in on demand while the mesh blocks are swept,
+                    // heights near the edges are blended with the neighbouring maps.
+                    int32_t tile_idx = b == 1 ? tile_idx_list[i_map] : -1;
+                    if (tile_idx >= 0)
                     {
                         GroupMeshData* group_mesh_data = new GroupMeshData;
                         for (uint32_t i_tex = 0; i_tex < dumpped_texture_info_list.size(); i_tex++)
@@ -425,37 +447,13 @@ void DumpUSGSData(const vector<unique_ptr<string>>& file_name_list,
                             group_mesh_data->texture_names.push_back(dumpped_texture_info_list[i_tex].file_name);
                         }
 
-                        for (int b_y = 0; b_y < nBlocksPerColumn; b_y++)
-                        {
-                            for (int b_x = 0; b_x < nBlocksPerRow; b_x++)
-                            {
-                                if (poBand->GetRasterBlock(b_x, b_y, pabyTile) != CE_Failure)
-                                {
-                                    float* f_height = reinterpret_cast<float*>(pabyTile);
-                                    for (int i = 0; i < nBlockYSize; i++)
-                                    {
-                                        int y = b_y * nBlockYSize + i;
-                                        for (int j = 0; j < nBlockXSize; j++)
-                                        {
-                                            int x = b_x * nBlockXSize + j;
-                                            if (y < nYSize && x < nXSize)
-                                            {
-                                                float h = f_height[i * nBlockXSize + j];
-                                                height_map[y * nXSize + x] = h;
-                                                t_min = min(t_min, double(h));
-                                                t_max = max(t_max, double(h));
-                                            }
-                                        }
-                                    }
-                                }
-                            }
-                        }
-
-                        core::vec2d g = img_ul_center + s_pixel_size * core::vec2d(nXSize -1, nYSize -1);
+                        // only the part of the raster this map owns, overlaps with the neighbours
+                        // end on a lattice line both of them mesh.
+                        core::bounds2d owned_bbox = elevation_mosaic.get_owned_pixel_bounds(size_t(tile_idx));
 
                         core::bounds2d img_bbox;
-                        img_bbox += img_ul_center;
-                        img_bbox += g;
+                        img_bbox += elevation_mosaic.get_position(size_t(tile_idx), owned_bbox.bb_min);
+                        img_bbox += elevation_mosaic.get_position(size_t(tile_idx), owned_bbox.bb_max);
 
                         // if scissor rectangle not empty, then do intersect check.
                         if (batch_mesh_data->scissor_bbox.GetRadius() > 0.0001)
@@ -482,21 +480,23 @@ void DumpUSGSData(const vector<unique_ptr<string>>& file_name_list,
                         {
                             ScissorMeshInfo& info = scissor_mesh_info_list[i];
 
-                            cv::Mat src_tex;
+                            // sub images are gathered and written in one streaming pass after the sweep.
+                            TiledImageReader src_tex;
+                            vector<ImageCropInfo> crop_list;
                             if (split_texture)
                             {
-                                src_tex = cv::imread(dumpped_texture_info_list[uint32_t(info.tex_id)].file_name.get()->c_str());
+                                src_tex.open(*dumpped_texture_info_list[uint32_t(info.tex_id)].file_name.get());
                             }
 
                             const DumppedTextureInfo* p_tex_info = &dumpped_texture_info_list[uint32_t(info.tex_id)];
                             string sub_img_name = *dumpped_texture_info_list[uint32_t(info.tex_id)].file_name.get();
                             sub_img_name = sub_img_name.substr(0, sub_img_name.rfind("."));
 
-                            int w = src_tex.cols;
-                            int h = src_tex.rows;
+                            int w = src_tex.get_x_size();
+                            int h = src_tex.get_y_size();
 
-                            core::vec2d min_idx = (info.bbox.bb_min - img_ul_center) / s_pixel_size;
-                            core::vec2d max_idx = (info.bbox.bb_max - img_ul_center) / s_pixel_size;
+                            core::vec2d min_idx = ElevationMosaic::snap_to_lattice((info.bbox.bb_min - img_ul_center) / s_pixel_size);
+                            core::vec2d max_idx = ElevationMosaic::snap_to_lattice((info.bbox.bb_max - img_ul_center) / s_pixel_size);
 
                             core::bounds2d img_bbox;
                             img_bbox += min_idx;
@@ -557,13 +557,15 @@ void DumpUSGSData(const vector<unique_ptr<string>>& file_name_list,
                                             int32_t s_w = min(bbox_i.bb_max.x - bbox_i.bb_min.x + 1, w - bbox_i.bb_min.x);
                                             int32_t s_h = min(bbox_i.bb_max.y - bbox_i.bb_min.y + 1, h - bbox_i.bb_min.y);
 
-                                            cv::Mat sub_img = cv::Mat(src_tex, cv::Rect(int(bbox_i.bb_min.x), int(h - bbox_i.bb_min.y - s_h), int(s_w), int(s_h)));
-
-                                            string tex_file_name = sub_img_name + "_" + to_string(mesh_index) + ".png";
-                                            render_block->tex_file_name = make_unique<string>(tex_file_name);
+                                            ImageCropInfo crop;
+                                            crop.x = int(bbox_i.bb_min.x);
+                                            crop.y = int(h - bbox_i.bb_min.y - s_h);
+                                            crop.w = int(s_w);
+                                            crop.h = int(s_h);
+                                            crop.file_name = sub_img_name + "_" + to_string(mesh_index) + ".png";
+                                            render_block->tex_file_name = make_unique<string>(crop.file_name);
 
-                                            cv::imwrite(tex_file_name, sub_img);
-                                            sub_img.release();
+                                            crop_list.push_back(move(crop));
                                         }
                                         else
                                         {
@@ -596,10 +598,18 @@ void DumpUSGSData(const vector<unique_ptr<string>>& file_name_list,
                                                     double s_x = x == 0 ? img_bbox.bb_min.x : (x == num_samples.x - 1 ? img_bbox.bb_max.x : x + floor(img_bbox.bb_min.x));
                                                     double s_y = y == 0 ? img_bbox.bb_min.y : (y == num_samples.y - 1 ? img_bbox.bb_max.y : y + floor(img_bbox.bb_min.y));
 
-                                                    float h = LookupAltitudeMap(s_x, s_y, height_map, nXSize);
+                                                    // lattice positions, the same bits in every map sharing the node.
+                                                    core::vec2d pos_gps = elevation_mosaic.get_position(size_t(tile_idx), core::vec2d(s_x, s_y));
+                                                    float h = elevation_mosaic.get_height(pos_gps);
 
-                                                    double g_x = img_ul_center.x + s_pixel_size.x * s_x;
-                                                    double g_y = img_ul_center.y + s_pixel_size.y * s_y;
+                                                    double g_x = pos_gps.x;
+                                                    double g_y = pos_gps.y;
+
+                                                    // usgs heights are orthometric (navd88).
+                                                    if (batch_mesh_data->geoid_model)
+                                                    {
+                                                        h += float(batch_mesh_data->geoid_model->undulation(g_y, g_x));
+                                                    }
 
                                                     vertex_list[idx] = gps_to_env_cnvt.lla_to_enu(core::GpsCoord(g_x, g_y, double(h)));
 
@@ -653,24 +663,18 @@ void DumpUSGSData(const vector<unique_ptr<string>>& file_name_list,
                                 }
                             }
 
-                            src_tex.release();
+                            if (split_texture && !CropImageFiles(src_tex, crop_list))
+                            {
+                                core::output_debug_info("error", "failed to write sub images of " + sub_img_name);
+                            }
+                            src_tex.close();
                         }
 
                         batch_mesh_data->group_meshes.push_back(group_mesh_data);
                         batch_mesh_data->bbox_ws += group_mesh_data->bbox_ws;
                     }
 
-                    if (pabyTile)
-                    {
-                        delete[] pabyTile;
-                        pabyTile = nullptr;
-                    }
-
-                    if (height_map)
-                    {
-                        delete[] height_map;
-                        height_map = nullptr;
-                    }
+                    elevation_mosaic.flush();
 
                     if (HFAGetPCT(hHFA, b, &nColors, &padfRed, &padfGreen, &padfBlue, &padfAlpha) == CE_None)
                     {
@@ -0,0 +1,46 @@
+#include "benchmark.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+// a run shorter than this is noise, the iteration count doubles until one is not.
+constexpr double kMinRunSeconds = 0.2;
+}
+
+vector<Benchmark>& GetBenchmarkList()
+{
+    static vector<Benchmark> benchmark_list;
+    return benchmark_list;
+}
+
+int main(int argc, char** argv)
+{
+    const char* filter = argc > 1 ? argv[1] : "";
+    for (const Benchmark& benchmark : GetBenchmarkList())
+    {
+        if (strstr(benchmark.name, filter) == nullptr)
+        {
+            continue;
+        }
+
+        uint32_t num_iterations = 1;
+        double seconds = 0.0;
+        for (;;)
+        {
+            auto start = chrono::steady_clock::now();
+            benchmark.func(num_iterations);
+            seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            if (seconds >= kMinRunSeconds || num_iterations >= (1u << 30))
+            {
+                break;
+            }
+            num_iterations *= 2;
+        }
+
+        printf("%-48s %12.3f us/iteration %10u iterations\n", benchmark.name, seconds * 1.0e6 / num_iterations, num_iterations);
+    }
+
+    return 0;
+}
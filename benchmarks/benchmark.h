@@ -0,0 +1,40 @@
+#pragma once
+#include "base.h"
+#include <functional>
+
+// a benchmark runs its body num_iterations times, the harness grows the count until a run
+// takes long enough to time.
+struct Benchmark
+{
+    const char*                             name;
+    function<void(uint32_t num_iterations)> func;
+};
+
+vector<Benchmark>& GetBenchmarkList();
+
+struct BenchmarkRegistrar
+{
+    BenchmarkRegistrar(const char* name, const function<void(uint32_t)>& func)
+    {
+        GetBenchmarkList().push_back({name, func});
+    }
+};
+
+#define BENCHMARK(name) \
+    static void name(uint32_t num_iterations); \
+    static BenchmarkRegistrar name##_registrar(#name, name); \
+    static void name(uint32_t num_iterations)
+
+// reads every byte of the results once, so the compiler can not drop the work that made them.
+template <class T>
+void KeepResult(const T* data, size_t count)
+{
+    static volatile uint8_t sink;
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+    uint8_t x = 0;
+    for (size_t i = 0; i < count * sizeof(T); i++)
+    {
+        x ^= bytes[i];
+    }
+    sink = x;
+}
@@ -0,0 +1,66 @@
+#-------------------------------------------------
+#
+# timing runs of the hot kernels against their scalar or previous versions,
+# "MeshToolBenchmarks [filter]" runs the benchmarks whose name contains filter.
+#
+#-------------------------------------------------
+
+QT       -= core gui
+
+TARGET = MeshToolBenchmarks
+TEMPLATE = app
+CONFIG += console c++17 release
+CONFIG -= app_bundle qt
+
+DEFINES += _HAS_STD_BYTE=0
+
+INCLUDEPATH += $$PWD/../../../ThirdParty/opencv/include
+INCLUDEPATH += $$PWD/../../../ThirdParty/geographiclib/include
+INCLUDEPATH += $$PWD/../../../ThirdParty/zlib-1.2.3/
+INCLUDEPATH += $$PWD/../include
+INCLUDEPATH += $$PWD/..
+INCLUDEPATH += $$PWD/../port
+
+QMAKE_LIBDIR += $$PWD/../../../ThirdParty/opencv/x64/vc15/lib
+LIBS += opencv_world341.lib
+
+HEADERS += \
+    benchmark.h
+
+SOURCES += \
+    benchmark.cpp \
+    coresimd_bench.cpp \
+    coregeographic_bench.cpp \
+    coretexture_bench.cpp \
+    corepng_bench.cpp \
+    gpaframe_bench.cpp \
+    cpl_vsil_mmap_bench.cpp \
+    ../corepng.cpp \
+    ../GpaDumpAnalyzeTool.cpp \
+    ../gpaframe.cpp \
+    ../GlFunctionList.cpp \
+    ../glstate.cpp \
+    ../vertexformat.cpp \
+    ../coretexture.cpp \
+    ../coreblockcodec.cpp \
+    ../corefile.cpp \
+    ../meshdata.cpp \
+    ../meshclip.cpp \
+    ../boundsgrid.cpp \
+    ../coregeographic.cpp \
+    ../port/cpl_conv.cpp \
+    ../port/cpl_csv.cpp \
+    ../port/cpl_dir.cpp \
+    ../port/cpl_error.cpp \
+    ../port/cpl_findfile.cpp \
+    ../port/cpl_multiproc.cpp \
+    ../port/cpl_path.cpp \
+    ../port/cpl_string.cpp \
+    ../port/cpl_vsi_mem.cpp \
+    ../port/cpl_vsil.cpp \
+    ../port/cpl_vsil_mmap.cpp \
+    ../port/cpl_vsil_win32.cpp \
+    ../port/cpl_vsisimple.cpp
+
+SOURCES += $$files($$PWD/../../../ThirdParty/geographiclib/src/*.cpp)
+SOURCES += $$files($$PWD/../../../ThirdParty/zlib-1.2.11/*.c)
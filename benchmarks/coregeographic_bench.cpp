@@ -0,0 +1,115 @@
+#include "benchmark.h"
+#include "coregeographic.h"
+#include "GeographicLib/UTMUPS.hpp"
+#include <random>
+
+namespace
+{
+// a dataset of 100000 points over the edge of zones 10 and 11.
+constexpr size_t kNumPoints = 100000;
+constexpr int32_t kTestZone = 11;
+
+const vector<core::vec2d>& GetTestPoints()
+{
+    static vector<core::vec2d> gps_list;
+    if (gps_list.empty())
+    {
+        mt19937 rng(30);
+        uniform_real_distribution<double> lat(36.0, 38.0), lon(-121.0, -117.0);
+        gps_list.resize(kNumPoints);
+        for (core::vec2d& gps_loc : gps_list)
+        {
+            gps_loc = core::vec2d(lat(rng), lon(rng));
+        }
+    }
+    return gps_list;
+}
+
+void RunForward(uint32_t num_iterations, bool b_batched)
+{
+    const vector<core::vec2d>& gps_list = GetTestPoints();
+    vector<core::vec2d> utm_list(gps_list.size());
+    core::UTMProjector projector;
+    for (uint32_t i = 0; i < num_iterations; i++)
+    {
+        if (b_batched)
+        {
+            bool northp = true;
+            projector.forward(gps_list.data(), utm_list.data(), gps_list.size(), core::UTMProjector::kAutoZone, northp);
+        }
+        else
+        {
+            for (size_t j = 0; j < gps_list.size(); j++)
+            {
+                utm_list[j] = projector.forward(gps_list[j], kTestZone, true);
+            }
+        }
+    }
+    KeepResult(utm_list.data(), utm_list.size());
+}
+
+void RunGeographicLibForward(uint32_t num_iterations)
+{
+    const vector<core::vec2d>& gps_list = GetTestPoints();
+    vector<core::vec2d> utm_list(gps_list.size());
+    for (uint32_t i = 0; i < num_iterations; i++)
+    {
+        for (size_t j = 0; j < gps_list.size(); j++)
+        {
+            int32_t zone;
+            bool northp;
+            GeographicLib::UTMUPS::Forward(gps_list[j].x, gps_list[j].y, zone, northp, utm_list[j].x, utm_list[j].y, kTestZone);
+        }
+    }
+    KeepResult(utm_list.data(), utm_list.size());
+}
+
+void RunReverse(uint32_t num_iterations, bool b_batched)
+{
+    const vector<core::vec2d>& gps_list = GetTestPoints();
+    core::UTMProjector projector;
+    vector<core::vec2d> utm_list(gps_list.size()), back_list(gps_list.size());
+    bool northp = true;
+    projector.forward(gps_list.data(), utm_list.data(), gps_list.size(), kTestZone, northp);
+    for (uint32_t i = 0; i < num_iterations; i++)
+    {
+        if (b_batched)
+        {
+            projector.reverse(utm_list.data(), back_list.data(), utm_list.size(), kTestZone, northp);
+        }
+        else
+        {
+            for (size_t j = 0; j < utm_list.size(); j++)
+            {
+                back_list[j] = projector.reverse(utm_list[j], kTestZone, northp);
+            }
+        }
+    }
+    KeepResult(back_list.data(), back_list.size());
+}
+
+void RunGeographicLibReverse(uint32_t num_iterations)
+{
+    const vector<core::vec2d>& gps_list = GetTestPoints();
+    core::UTMProjector projector;
+    vector<core::vec2d> utm_list(gps_list.size()), back_list(gps_list.size());
+    bool northp = true;
+    projector.forward(gps_list.data(), utm_list.data(), gps_list.size(), kTestZone, northp);
+    for (uint32_t i = 0; i < num_iterations; i++)
+    {
+        for (size_t j = 0; j < utm_list.size(); j++)
+        {
+            GeographicLib::UTMUPS::Reverse(kTestZone, northp, utm_list[j].x, utm_list[j].y, back_list[j].x, back_list[j].y);
+        }
+    }
+    KeepResult(back_list.data(), back_list.size());
+}
+}
+
+// 100000 points per iteration, point by point, batched over threads and through geographiclib.
+BENCHMARK(UtmForwardScalar) { RunForward(num_iterations, false); }
+BENCHMARK(UtmForwardBatched) { RunForward(num_iterations, true); }
+BENCHMARK(UtmForwardGeographicLib) { RunGeographicLibForward(num_iterations); }
+BENCHMARK(UtmReverseScalar) { RunReverse(num_iterations, false); }
+BENCHMARK(UtmReverseBatched) { RunReverse(num_iterations, true); }
+BENCHMARK(UtmReverseGeographicLib) { RunGeographicLibReverse(num_iterations); }
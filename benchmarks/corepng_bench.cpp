@@ -0,0 +1,85 @@
+#include "benchmark.h"
+#include "corepng.h"
+#include <opencv2/opencv.hpp>
+#include <cstdio>
+#include <random>
+
+namespace
+{
+// an aerial texture sized image, what the tile and texture exports write.
+constexpr int32_t kImageSize = 2048;
+constexpr int32_t kCompressionLevel = 6;
+
+const cv::Mat& GetTestImage()
+{
+    static cv::Mat image;
+    if (image.empty())
+    {
+        image = cv::Mat(kImageSize, kImageSize, CV_8UC3);
+        mt19937 rng(1);
+        uniform_int_distribution<int32_t> noise(0, 11);
+        for (int32_t y = 0; y < kImageSize; y++)
+        {
+            uint8_t* row = image.ptr(y);
+            for (int32_t x = 0; x < kImageSize * 3; x++)
+            {
+                row[x] = uint8_t(((x / 3) * (x % 3 + 1) / 16 + y / 8 + noise(rng)) & 0xff);
+            }
+        }
+    }
+    return image;
+}
+
+void RunCoreEncode(uint32_t num_iterations)
+{
+    const cv::Mat& image = GetTestImage();
+    vector<uint8_t> png_data;
+    for (uint32_t i = 0; i < num_iterations; i++)
+    {
+        core::EncodePngImage(image.data, uint32_t(image.cols), uint32_t(image.rows), image.step, 3, 8, true,
+                             png_data, core::kPngFilterAdaptive, kCompressionLevel);
+    }
+    KeepResult(png_data.data(), png_data.size());
+}
+
+void RunOpenCvEncode(uint32_t num_iterations)
+{
+    const cv::Mat& image = GetTestImage();
+    vector<uint8_t> png_data;
+    vector<int> params = { cv::IMWRITE_PNG_COMPRESSION, kCompressionLevel };
+    for (uint32_t i = 0; i < num_iterations; i++)
+    {
+        cv::imencode(".png", image, png_data, params);
+    }
+    KeepResult(png_data.data(), png_data.size());
+}
+
+// the file writes include the disk, what the exports actually pay.
+void RunCoreWrite(uint32_t num_iterations)
+{
+    const cv::Mat& image = GetTestImage();
+    for (uint32_t i = 0; i < num_iterations; i++)
+    {
+        core::ExportPngFile("corepng_bench.png", image.data, uint32_t(image.cols), uint32_t(image.rows), image.step, 3, 8, true,
+                            core::kPngFilterAdaptive, kCompressionLevel);
+    }
+    remove("corepng_bench.png");
+}
+
+void RunOpenCvWrite(uint32_t num_iterations)
+{
+    const cv::Mat& image = GetTestImage();
+    vector<int> params = { cv::IMWRITE_PNG_COMPRESSION, kCompressionLevel };
+    for (uint32_t i = 0; i < num_iterations; i++)
+    {
+        cv::imwrite("corepng_bench.png", image, params);
+    }
+    remove("corepng_bench.png");
+}
+}
+
+// one 2048 x 2048 bgr image per iteration, both at zlib level 6.
+BENCHMARK(PngEncodeCore) { RunCoreEncode(num_iterations); }
+BENCHMARK(PngEncodeOpenCv) { RunOpenCvEncode(num_iterations); }
+BENCHMARK(PngWriteCore) { RunCoreWrite(num_iterations); }
+BENCHMARK(PngWriteOpenCv) { RunOpenCvWrite(num_iterations); }
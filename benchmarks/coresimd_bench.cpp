@@ -0,0 +1,121 @@
+#include "benchmark.h"
+#include "coremath.h"
+#include <random>
+
+namespace
+{
+constexpr size_t kNumPoints = 1 << 16;
+
+template <class T>
+core::matrix4<T> GetTestMatrix()
+{
+    core::matrix4<T> m;
+    for (int32_t i = 0; i < 16; i++)
+    {
+        m._array[i] = T(i % 5) * T(0.25) + T(1);
+    }
+    return m;
+}
+
+const vector<core::vec3f>& GetTestPoints()
+{
+    static vector<core::vec3f> points;
+    if (points.empty())
+    {
+        mt19937 rng(1);
+        uniform_real_distribution<float> value(-1000.0f, 1000.0f);
+        points.resize(kNumPoints);
+        for (auto& p : points)
+        {
+            p = core::vec3f(value(rng), value(rng), value(rng));
+        }
+    }
+    return points;
+}
+
+// the generic loops matrix4 used before the simd backend.
+template <class T>
+core::matrix4<T> ScalarProduct(const core::matrix4<T>& lhs, const core::matrix4<T>& rhs)
+{
+    core::matrix4<T> r(T(0));
+    for (int32_t i = 0; i < 4; i++)
+        for (int32_t j = 0; j < 4; j++)
+            for (int32_t k = 0; k < 4; k++)
+                r(i, j) += lhs(i, k) * rhs(k, j);
+    return r;
+}
+
+template <class T>
+void RunProduct(uint32_t num_iterations, bool b_scalar)
+{
+    core::matrix4<T> m = GetTestMatrix<T>();
+    core::matrix4<T> r = m;
+    for (uint32_t i = 0; i < num_iterations; i++)
+    {
+        for (int32_t j = 0; j < 1024; j++)
+        {
+            // keep the values bounded, the chain is what is timed.
+            r = b_scalar ? ScalarProduct(r, m) : r * m;
+            r._array[0] = T(1);
+        }
+    }
+    KeepResult(r._array, 16);
+}
+
+template <class T>
+void RunTransformPoints(uint32_t num_iterations, bool b_scalar)
+{
+    core::matrix4<T> m = GetTestMatrix<T>();
+    const vector<core::vec3f>& points = GetTestPoints();
+    vector<core::vec4<T>> clip(points.size());
+    for (uint32_t i = 0; i < num_iterations; i++)
+    {
+        if (b_scalar)
+        {
+            core::TransformPoints<T, float>(m, points.data(), clip.data(), points.size());
+        }
+        else
+        {
+            core::TransformPoints(m, points.data(), clip.data(), points.size());
+        }
+    }
+    KeepResult(clip.data(), clip.size());
+}
+
+template <class T>
+void RunInverse(uint32_t num_iterations, bool b_adjugate)
+{
+    core::matrix4<T> m = GetTestMatrix<T>();
+    for (int32_t i = 0; i < 4; i++)
+    {
+        m(i, i) += T(10);
+    }
+
+    core::matrix4<T> r;
+    for (uint32_t i = 0; i < num_iterations; i++)
+    {
+        for (int32_t j = 0; j < 1024; j++)
+        {
+            m._array[15] = T(10) + T(j & 7);
+            r = b_adjugate ? core::inverse(m) : core::InverseGaussian(m);
+        }
+    }
+    KeepResult(r._array, 16);
+}
+}
+
+// 1024 chained products per iteration.
+BENCHMARK(MatrixProductFloatScalar) { RunProduct<float>(num_iterations, true); }
+BENCHMARK(MatrixProductFloatSimd) { RunProduct<float>(num_iterations, false); }
+BENCHMARK(MatrixProductDoubleScalar) { RunProduct<double>(num_iterations, true); }
+BENCHMARK(MatrixProductDoubleSimd) { RunProduct<double>(num_iterations, false); }
+
+// kNumPoints points per iteration.
+BENCHMARK(TransformPointsFloatScalar) { RunTransformPoints<float>(num_iterations, true); }
+BENCHMARK(TransformPointsFloatSimd) { RunTransformPoints<float>(num_iterations, false); }
+BENCHMARK(TransformPointsDoubleScalar) { RunTransformPoints<double>(num_iterations, true); }
+BENCHMARK(TransformPointsDoubleSimd) { RunTransformPoints<double>(num_iterations, false); }
+
+// 1024 inverses per iteration.
+BENCHMARK(InverseDoubleGaussian) { RunInverse<double>(num_iterations, false); }
+BENCHMARK(InverseDoubleAdjugate) { RunInverse<double>(num_iterations, true); }
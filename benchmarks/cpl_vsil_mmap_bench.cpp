@@ -0,0 +1,97 @@
+#include "benchmark.h"
+#include "cpl_vsi.h"
+#include <cstdio>
+#include <random>
+
+namespace
+{
+// a 16 mb raster of 64 x 64 float blocks, the layout of the usgs elevation files.
+constexpr size_t kFileSize = 16 * 1024 * 1024;
+constexpr size_t kBlockSize = 64 * 64 * sizeof(float);
+constexpr uint32_t kNumBlockReads = 4096;
+const char* kFileName = "cpl_vsil_mmap_bench.bin";
+
+// written once, before the first timed run of the first benchmark that reads it.
+struct TestFile
+{
+    TestFile()
+    {
+        vector<uint32_t> data(kFileSize / sizeof(uint32_t));
+        mt19937 rng(1);
+        for (uint32_t& value : data)
+        {
+            value = uint32_t(rng());
+        }
+        FILE* file = fopen(kFileName, "wb");
+        if (file)
+        {
+            fwrite(data.data(), sizeof(uint32_t), data.size(), file);
+            fclose(file);
+        }
+    }
+
+    ~TestFile()
+    {
+        remove(kFileName);
+    }
+};
+
+void CreateTestFile()
+{
+    static TestFile test_file;
+}
+
+// blocks in a random order, what a sweep over several rasters does to each file.
+void RunBlockReads(uint32_t num_iterations, const string& file_name)
+{
+    CreateTestFile();
+    vector<uint8_t> block(kBlockSize);
+    mt19937 rng(2);
+    uniform_int_distribution<size_t> block_idx(0, kFileSize / kBlockSize - 1);
+    for (uint32_t i = 0; i < num_iterations; i++)
+    {
+        FILE* file = VSIFOpenL(file_name.c_str(), "rb");
+        if (!file)
+        {
+            return;
+        }
+        for (uint32_t j = 0; j < kNumBlockReads; j++)
+        {
+            VSIFSeekL(file, vsi_l_offset(block_idx(rng) * kBlockSize), SEEK_SET);
+            VSIFReadL(block.data(), 1, block.size(), file);
+        }
+        VSIFCloseL(file);
+    }
+    KeepResult(block.data(), block.size());
+}
+
+// the block headers hfa walks when it opens a file, a few bytes at a time.
+void RunSmallReads(uint32_t num_iterations, const string& file_name)
+{
+    CreateTestFile();
+    uint32_t value = 0, sum = 0;
+    mt19937 rng(3);
+    uniform_int_distribution<size_t> offset(0, kFileSize - sizeof(value));
+    for (uint32_t i = 0; i < num_iterations; i++)
+    {
+        FILE* file = VSIFOpenL(file_name.c_str(), "rb");
+        if (!file)
+        {
+            return;
+        }
+        for (uint32_t j = 0; j < kNumBlockReads * 16; j++)
+        {
+            VSIFSeekL(file, vsi_l_offset(offset(rng)), SEEK_SET);
+            VSIFReadL(&value, sizeof(value), 1, file);
+            sum += value;
+        }
+        VSIFCloseL(file);
+    }
+    KeepResult(&sum, 1);
+}
+}
+
+BENCHMARK(VsiBlockReadsStdio) { RunBlockReads(num_iterations, kFileName); }
+BENCHMARK(VsiBlockReadsMMap) { RunBlockReads(num_iterations, string("/vsimmap/") + kFileName); }
+BENCHMARK(VsiSmallReadsStdio) { RunSmallReads(num_iterations, kFileName); }
+BENCHMARK(VsiSmallReadsMMap) { RunSmallReads(num_iterations, string("/vsimmap/") + kFileName); }
@@ -0,0 +1,151 @@
+#include "benchmark.h"
+#include "gpaframe.h"
+#include "glfunctionlist.h"
+#include "meshdata.h"
+#include "debugout.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace core
+{
+// debugout.cpp needs qt, the benchmarks only need the messages gone.
+void output_debug_info(const string& category, const string& message)
+{
+    (void)category;
+    (void)message;
+}
+}
+
+namespace
+{
+// about what a dense google earth frame holds, 5000 draws make an 8 mb file of 60000 zones.
+constexpr uint32_t kNumDraws = 5000;
+constexpr uint32_t kNumDrawVertices = 100;
+const char* kFrameFileName = "gpaframe_bench.gpa_frame";
+
+void AppendWord(vector<uint8_t>& data, uint32_t value)
+{
+    for (int32_t i = 0; i < 4; i++)
+    {
+        data.push_back(uint8_t(value >> (i * 8)));
+    }
+}
+
+void AppendCommandZone(vector<uint8_t>& data, uint32_t tag, const vector<uint32_t>& arg_list)
+{
+    AppendWord(data, uint32_t(arg_list.size() * 4));
+    AppendWord(data, tag);
+    for (uint32_t arg : arg_list)
+    {
+        AppendWord(data, arg);
+    }
+}
+
+void AppendDataZone(vector<uint8_t>& data, uint32_t tag, uint32_t stamp, const vector<float>& value_list)
+{
+    AppendWord(data, uint32_t(4 + value_list.size() * 4));
+    AppendWord(data, tag);
+    AppendWord(data, stamp);
+    for (float value : value_list)
+    {
+        uint32_t word;
+        memcpy(&word, &value, 4);
+        AppendWord(data, word);
+    }
+}
+
+// each draw uploads its vertices, strip indexes and a matrix, and binds buffers out of a
+// pool like the earth client does. the parser only builds meshes of indexed draws.
+vector<uint8_t> CreateTestFrame()
+{
+    vector<uint8_t> data;
+    AppendWord(data, kGpaFrameFileTag);
+    AppendWord(data, 1);
+
+    vector<float> vertex_list(kNumDrawVertices * 3);
+    for (uint32_t i = 0; i < vertex_list.size(); i++)
+    {
+        vertex_list[i] = float(i % 97);
+    }
+    const vector<float> matrix = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+
+    // 16 bit indexes two to a word, the data zone writer takes floats.
+    vector<float> index_list(kNumDrawVertices / 2);
+    for (uint32_t i = 0; i < index_list.size(); i++)
+    {
+        uint32_t word = (2 * i) | (2 * i + 1) << 16;
+        memcpy(&index_list[i], &word, 4);
+    }
+
+    uint32_t stamp = 1;
+    for (uint32_t i_draw = 0; i_draw < kNumDraws; i_draw++)
+    {
+        uint32_t vertex_stamp = stamp++;
+        AppendDataZone(data, kArrayBufferBlock, vertex_stamp, vertex_list);
+        uint32_t index_stamp = stamp++;
+        AppendDataZone(data, kArrayBufferBlock, index_stamp, index_list);
+        uint32_t offset_stamp = stamp++;
+        AppendDataZone(data, kParamsBlock, offset_stamp, { 0.0f });
+        uint32_t matrix_stamp = stamp++;
+        AppendDataZone(data, kParamsBlock, matrix_stamp, matrix);
+
+        AppendCommandZone(data, kGlBindBuffer, { kGlArrayBuffer, 1 + i_draw % 4096 });
+        AppendCommandZone(data, kGlBufferData, { kGlArrayBuffer, kNumDrawVertices * 12, vertex_stamp, kGlStaticDraw });
+        AppendCommandZone(data, kGlVertexAttribPointer, { 0, 3, kGlFloat, 0, 12, offset_stamp });
+        AppendCommandZone(data, kGlEnableVertexAttribArray, { 0 });
+        AppendCommandZone(data, kGlBindBuffer, { kGlElementArrayBuffer, 4097 + i_draw % 4096 });
+        AppendCommandZone(data, kGlBufferData, { kGlElementArrayBuffer, kNumDrawVertices * 2, index_stamp, kGlStaticDraw });
+        AppendCommandZone(data, kGlUniformMatrix4fv, { 0, 1, 0, matrix_stamp });
+        AppendCommandZone(data, kGlDrawElements, { kGlTriangleStrip, kNumDrawVertices, kGlUShort, offset_stamp });
+    }
+
+    AppendWord(data, 0);
+    AppendWord(data, kGpaFrameEndTag);
+    return data;
+}
+
+// written once for all the runs, removed with its sidecar at exit.
+struct TestFrameFile
+{
+    TestFrameFile()
+    {
+        vector<uint8_t> data = CreateTestFrame();
+        ofstream file(kFrameFileName, ofstream::binary);
+        file.write(reinterpret_cast<const char*>(data.data()), data.size());
+    }
+
+    ~TestFrameFile()
+    {
+        remove(GetGpaFrameIndexFileName(kFrameFileName).c_str());
+        remove(kFrameFileName);
+    }
+};
+
+void OpenTestFrame(uint32_t num_iterations, bool b_cold)
+{
+    static TestFrameFile frame_file;
+    size_t num_meshes = 0;
+    for (uint32_t i = 0; i < num_iterations; i++)
+    {
+        // cold is a capture opened for the first time, its sidecar is written on the way.
+        if (b_cold)
+        {
+            remove(GetGpaFrameIndexFileName(kFrameFileName).c_str());
+        }
+
+        GroupMeshData group_mesh_data;
+        CreateMeshFromDumpFile(kFrameFileName, &group_mesh_data);
+        num_meshes += group_mesh_data.meshes.size();
+        for (auto& mesh_data : group_mesh_data.meshes)
+        {
+            SAFE_DELETE(mesh_data);
+        }
+    }
+    KeepResult(&num_meshes, 1);
+}
+}
+
+// one open of a 5000 draw capture per iteration, without and with a current sidecar index.
+BENCHMARK(GpaFrameOpenCold) { OpenTestFrame(num_iterations, true); }
+BENCHMARK(GpaFrameOpenIndexed) { OpenTestFrame(num_iterations, false); }
@@ -0,0 +1,133 @@
+#include "boundsgrid.h"
+#include <algorithm>
+
+namespace
+{
+int32_t GetCellCoord(double v, double cell_size)
+{
+    double cell = floor(v / cell_size);
+    return int32_t(min(max(cell, double(INT32_MIN)), double(INT32_MAX)));
+}
+
+uint64_t GetCellKey(int32_t x, int32_t y)
+{
+    return uint64_t(uint32_t(x)) << 32 | uint32_t(y);
+}
+
+// only boxes with area can ever match under operator ^, the others are stored but never indexed.
+bool HasArea(const core::bounds2d& bbox)
+{
+    return bbox.b_valid && bbox.bb_min.x < bbox.bb_max.x && bbox.bb_min.y < bbox.bb_max.y;
+}
+}
+
+BoundsGridIndex::BoundsGridIndex(double cell_size) : cell_size_(cell_size > 0.0 ? cell_size : 1.0)
+{
+}
+
+bool BoundsGridIndex::get_cell_range(const core::bounds2d& bbox, core::vec2i& min_cell, core::vec2i& max_cell) const
+{
+    if (!HasArea(bbox))
+    {
+        return false;
+    }
+
+    min_cell = core::vec2i(GetCellCoord(bbox.bb_min.x, cell_size_), GetCellCoord(bbox.bb_min.y, cell_size_));
+    max_cell = core::vec2i(GetCellCoord(bbox.bb_max.x, cell_size_), GetCellCoord(bbox.bb_max.y, cell_size_));
+    return true;
+}
+
+uint32_t BoundsGridIndex::add(const core::bounds2d& bbox)
+{
+    uint32_t idx = uint32_t(bbox_list_.size());
+    bbox_list_.push_back(bbox);
+
+    core::vec2i min_cell, max_cell;
+    if (!get_cell_range(bbox, min_cell, max_cell))
+    {
+        return idx;
+    }
+
+    uint64_t num_cells = uint64_t(int64_t(max_cell.x) - min_cell.x + 1) * uint64_t(int64_t(max_cell.y) - min_cell.y + 1);
+    if (num_cells > kMaxBoundsGridItemCells)
+    {
+        large_item_list_.push_back(idx);
+        return idx;
+    }
+
+    for (int32_t y = min_cell.y; y <= max_cell.y; y++)
+    {
+        for (int32_t x = min_cell.x; x <= max_cell.x; x++)
+        {
+            cell_map_[GetCellKey(x, y)].push_back(idx);
+        }
+    }
+    return idx;
+}
+
+void BoundsGridIndex::clear()
+{
+    bbox_list_.clear();
+    cell_map_.clear();
+    large_item_list_.clear();
+}
+
+void BoundsGridIndex::query(const core::bounds2d& bbox, vector<uint32_t>& item_list) const
+{
+    item_list.clear();
+    core::vec2i min_cell, max_cell;
+    if (!get_cell_range(bbox, min_cell, max_cell))
+    {
+        return;
+    }
+
+    uint64_t num_cells = uint64_t(int64_t(max_cell.x) - min_cell.x + 1) * uint64_t(int64_t(max_cell.y) - min_cell.y + 1);
+    if (num_cells > cell_map_.size())
+    {
+        // a query wider than the populated grid walks the cells there are instead.
+        for (const auto& cell : cell_map_)
+        {
+            int32_t x = int32_t(uint32_t(cell.first >> 32));
+            int32_t y = int32_t(uint32_t(cell.first));
+            if (x >= min_cell.x && x <= max_cell.x && y >= min_cell.y && y <= max_cell.y)
+            {
+                item_list.insert(item_list.end(), cell.second.begin(), cell.second.end());
+            }
+        }
+    }
+    else
+    {
+        for (int32_t y = min_cell.y; y <= max_cell.y; y++)
+        {
+            for (int32_t x = min_cell.x; x <= max_cell.x; x++)
+            {
+                auto it = cell_map_.find(GetCellKey(x, y));
+                if (it != cell_map_.end())
+                {
+                    item_list.insert(item_list.end(), it->second.begin(), it->second.end());
+                }
+            }
+        }
+    }
+    item_list.insert(item_list.end(), large_item_list_.begin(), large_item_list_.end());
+
+    sort(item_list.begin(), item_list.end());
+    item_list.erase(unique(item_list.begin(), item_list.end()), item_list.end());
+    item_list.erase(remove_if(item_list.begin(), item_list.end(), [&](uint32_t idx) { return !(bbox ^ bbox_list_[idx]).b_valid; }), item_list.end());
+}
+
+double BoundsGridIndex::suggest_cell_size(const vector<core::bounds2d>& bbox_list)
+{
+    double sum = 0.0;
+    uint32_t count = 0;
+    for (const auto& bbox : bbox_list)
+    {
+        if (HasArea(bbox))
+        {
+            core::vec2d size = bbox.GetDiagonal();
+            sum += max(size.x, size.y);
+            count++;
+        }
+    }
+    return count > 0 ? sum / count : 1.0;
+}
@@ -0,0 +1,798 @@
+#include "coreblockcodec.h"
+#include "corethread.h"
+#include "glfunctionlist.h"
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+namespace core
+{
+
+namespace
+{
+// interpolation weights of the 4 bit index modes, out of 64.
+constexpr uint32_t kBc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// gather the 4x4 block at (b_x, b_y), texels past the edge repeat the last row and column.
+void LoadBlock(const uint8_t* rgba_data, uint32_t w, uint32_t h, uint32_t b_x, uint32_t b_y, uint8_t texels[64])
+{
+    for (uint32_t y = 0; y < 4; y++)
+    {
+        const uint8_t* src_row = rgba_data + size_t(min(b_y * 4 + y, h - 1)) * w * 4;
+        for (uint32_t x = 0; x < 4; x++)
+        {
+            memcpy(&texels[(y * 4 + x) * 4], &src_row[min(b_x * 4 + x, w - 1) * 4], 4);
+        }
+    }
+}
+
+void StoreBlock(const uint8_t texels[64], uint32_t w, uint32_t h, uint32_t b_x, uint32_t b_y, uint8_t* rgba_data)
+{
+    uint32_t cols = min(4u, w - b_x * 4);
+    for (uint32_t y = 0; y < 4 && b_y * 4 + y < h; y++)
+    {
+        memcpy(rgba_data + (size_t(b_y * 4 + y) * w + b_x * 4) * 4, &texels[y * 16], cols * 4);
+    }
+}
+
+//
+// bc4, also the alpha half of bc3 and both halves of bc5.
+//
+void GetBc4Palette(uint32_t a0, uint32_t a1, uint32_t palette[8])
+{
+    palette[0] = a0;
+    palette[1] = a1;
+    if (a0 > a1)
+    {
+        for (uint32_t i = 1; i < 7; i++)
+        {
+            palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+        }
+    }
+    else
+    {
+        for (uint32_t i = 1; i < 5; i++)
+        {
+            palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+// nearest palette entry for each value, returns the squared error.
+uint32_t FitBc4Indices(const uint8_t values[16], uint32_t a0, uint32_t a1, uint8_t indices[16])
+{
+    uint32_t palette[8];
+    GetBc4Palette(a0, a1, palette);
+
+    uint32_t error = 0;
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        uint32_t best_dist = UINT32_MAX;
+        for (uint32_t j = 0; j < 8; j++)
+        {
+            int32_t d = int32_t(palette[j]) - int32_t(values[i]);
+            uint32_t dist = uint32_t(d * d);
+            if (dist < best_dist)
+            {
+                best_dist = dist;
+                indices[i] = uint8_t(j);
+            }
+        }
+        error += best_dist;
+    }
+    return error;
+}
+
+// least squares endpoints for fixed indices, false if the fit is degenerate.
+bool RefitBc4Endpoints(const uint8_t values[16], const uint8_t indices[16], bool eight_values, uint32_t& a0, uint32_t& a1)
+{
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f, av = 0.0f, bv = 0.0f;
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        float t;
+        if (indices[i] < 2)
+        {
+            t = float(indices[i]);
+        }
+        else if (eight_values)
+        {
+            t = (indices[i] - 1) / 7.0f;
+        }
+        else if (indices[i] < 6)
+        {
+            t = (indices[i] - 1) / 5.0f;
+        }
+        else
+        {
+            continue;   // fixed 0 or 255
+        }
+
+        float s = 1.0f - t;
+        aa += s * s;
+        ab += s * t;
+        bb += t * t;
+        av += s * values[i];
+        bv += t * values[i];
+    }
+
+    float det = aa * bb - ab * ab;
+    if (fabs(det) < 1e-6f)
+    {
+        return false;
+    }
+
+    float e0 = (av * bb - bv * ab) / det;
+    float e1 = (bv * aa - av * ab) / det;
+    a0 = uint32_t(min(max(e0 + 0.5f, 0.0f), 255.0f));
+    a1 = uint32_t(min(max(e1 + 0.5f, 0.0f), 255.0f));
+    return true;
+}
+
+// one endpoint pair in the given mode, refined once. returns the squared error.
+uint32_t SearchBc4Mode(const uint8_t values[16], bool eight_values, uint32_t lo, uint32_t hi,
+                       uint32_t& best_a0, uint32_t& best_a1, uint8_t best_indices[16])
+{
+    // 8 values need a0 > a1, 6 values need a0 <= a1.
+    uint32_t a0 = eight_values ? hi : lo;
+    uint32_t a1 = eight_values ? lo : hi;
+    uint32_t best_error = FitBc4Indices(values, a0, a1, best_indices);
+    best_a0 = a0;
+    best_a1 = a1;
+
+    uint8_t indices[16];
+    if (RefitBc4Endpoints(values, best_indices, eight_values, a0, a1))
+    {
+        uint32_t r_lo = min(a0, a1), r_hi = max(a0, a1);
+        a0 = eight_values ? r_hi : r_lo;
+        a1 = eight_values ? r_lo : r_hi;
+        if (!eight_values || a0 > a1)
+        {
+            uint32_t error = FitBc4Indices(values, a0, a1, indices);
+            if (error < best_error)
+            {
+                best_error = error;
+                best_a0 = a0;
+                best_a1 = a1;
+                memcpy(best_indices, indices, 16);
+            }
+        }
+    }
+    return best_error;
+}
+
+void EncodeBc4Block(const uint8_t values[16], uint8_t* block)
+{
+    uint32_t v_min = 255, v_max = 0;
+    uint32_t inner_min = 255, inner_max = 0;
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        v_min = min(v_min, uint32_t(values[i]));
+        v_max = max(v_max, uint32_t(values[i]));
+        if (values[i] != 0 && values[i] != 255)
+        {
+            inner_min = min(inner_min, uint32_t(values[i]));
+            inner_max = max(inner_max, uint32_t(values[i]));
+        }
+    }
+
+    uint32_t a0 = v_max, a1 = v_min;
+    uint8_t indices[16] = {};
+    if (v_max > v_min)
+    {
+        uint32_t error = SearchBc4Mode(values, true, v_min, v_max, a0, a1, indices);
+
+        // blocks touching 0 or 255 can use the 6 value mode and its two fixed entries.
+        if (error > 0 && (v_min == 0 || v_max == 255))
+        {
+            uint32_t b0, b1;
+            uint8_t six_indices[16];
+            inner_min = min(inner_min, inner_max);
+            if (SearchBc4Mode(values, false, inner_min, inner_max, b0, b1, six_indices) < error)
+            {
+                a0 = b0;
+                a1 = b1;
+                memcpy(indices, six_indices, 16);
+            }
+        }
+    }
+
+    uint64_t index_bits = 0;
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        index_bits |= uint64_t(indices[i]) << (3 * i);
+    }
+
+    block[0] = uint8_t(a0);
+    block[1] = uint8_t(a1);
+    for (uint32_t i = 0; i < 6; i++)
+    {
+        block[2 + i] = uint8_t(index_bits >> (8 * i));
+    }
+}
+
+void DecodeBc4Block(const uint8_t* block, uint8_t* texels, uint32_t channel)
+{
+    uint32_t palette[8];
+    GetBc4Palette(block[0], block[1], palette);
+
+    uint64_t index_bits = 0;
+    for (uint32_t i = 0; i < 6; i++)
+    {
+        index_bits |= uint64_t(block[2 + i]) << (8 * i);
+    }
+
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        texels[i * 4 + channel] = uint8_t(palette[(index_bits >> (3 * i)) & 0x07]);
+    }
+}
+
+//
+// bc1 color, the reference expansion of 565 endpoints.
+//
+void DecodeBc1ColorBlock(const uint8_t* block, uint8_t* texels, bool four_color)
+{
+    uint32_t c0 = uint32_t(block[0]) | (uint32_t(block[1]) << 8);
+    uint32_t c1 = uint32_t(block[2]) | (uint32_t(block[3]) << 8);
+
+    uint32_t palette[4][4];
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        uint32_t c = i == 0 ? c0 : c1;
+        uint32_t r = (c >> 11) & 0x1f, g = (c >> 5) & 0x3f, b = c & 0x1f;
+        palette[i][0] = (r << 3) | (r >> 2);
+        palette[i][1] = (g << 2) | (g >> 4);
+        palette[i][2] = (b << 3) | (b >> 2);
+        palette[i][3] = 255;
+    }
+
+    for (uint32_t k = 0; k < 4; k++)
+    {
+        if (four_color || c0 > c1)
+        {
+            palette[2][k] = (2 * palette[0][k] + palette[1][k]) / 3;
+            palette[3][k] = (palette[0][k] + 2 * palette[1][k]) / 3;
+        }
+        else
+        {
+            palette[2][k] = (palette[0][k] + palette[1][k]) / 2;
+            palette[3][k] = 0;
+        }
+    }
+
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        uint32_t idx = (block[4 + i / 4] >> (2 * (i & 3))) & 0x03;
+        for (uint32_t k = 0; k < 4; k++)
+        {
+            texels[i * 4 + k] = uint8_t(palette[idx][k]);
+        }
+    }
+}
+
+//
+// bc7, mode 6 only: one subset, rgba 7.7.7.7 endpoints with a p bit each, 4 bit indices.
+//
+struct Bc7BitWriter
+{
+    uint8_t*    block;
+    uint32_t    pos;
+
+    void write(uint32_t value, uint32_t num_bits)
+    {
+        for (uint32_t i = 0; i < num_bits; i++, pos++)
+        {
+            block[pos >> 3] |= uint8_t(((value >> i) & 1) << (pos & 7));
+        }
+    }
+};
+
+struct Bc7BitReader
+{
+    const uint8_t*  block;
+    uint32_t        pos;
+
+    uint32_t read(uint32_t num_bits)
+    {
+        uint32_t value = 0;
+        for (uint32_t i = 0; i < num_bits; i++, pos++)
+        {
+            value |= uint32_t((block[pos >> 3] >> (pos & 7)) & 1) << i;
+        }
+        return value;
+    }
+};
+
+// closest 7 bit + p bit endpoint, returns the squared error.
+float QuantizeBc7Endpoint(const float color[4], uint32_t q[4], uint32_t& p_bit)
+{
+    float best_error = FLT_MAX;
+    for (uint32_t p = 0; p < 2; p++)
+    {
+        uint32_t q_p[4];
+        float error = 0.0f;
+        for (uint32_t k = 0; k < 4; k++)
+        {
+            int32_t v = int32_t(floor((color[k] - p) * 0.5f + 0.5f));
+            q_p[k] = uint32_t(min(max(v, 0), 127));
+            float d = float((q_p[k] << 1) | p) - color[k];
+            error += d * d;
+        }
+
+        if (error < best_error)
+        {
+            best_error = error;
+            p_bit = p;
+            memcpy(q, q_p, sizeof(q_p));
+        }
+    }
+    return best_error;
+}
+
+// nearest of the 16 interpolated colors for each texel, returns the squared error.
+uint32_t FitBc7Indices(const uint8_t texels[64], const uint32_t e0[4], const uint32_t e1[4], uint8_t indices[16])
+{
+    uint32_t palette[16][4];
+    for (uint32_t j = 0; j < 16; j++)
+    {
+        for (uint32_t k = 0; k < 4; k++)
+        {
+            palette[j][k] = ((64 - kBc7Weights4[j]) * e0[k] + kBc7Weights4[j] * e1[k] + 32) >> 6;
+        }
+    }
+
+    uint32_t error = 0;
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        uint32_t best_dist = UINT32_MAX;
+        for (uint32_t j = 0; j < 16; j++)
+        {
+            uint32_t dist = 0;
+            for (uint32_t k = 0; k < 4; k++)
+            {
+                int32_t d = int32_t(palette[j][k]) - int32_t(texels[i * 4 + k]);
+                dist += uint32_t(d * d);
+            }
+
+            if (dist < best_dist)
+            {
+                best_dist = dist;
+                indices[i] = uint8_t(j);
+            }
+        }
+        error += best_dist;
+    }
+    return error;
+}
+
+struct Bc7Mode6Fit
+{
+    uint32_t    q[2][4];
+    uint32_t    p[2];
+    uint8_t     indices[16];
+    uint32_t    error;
+};
+
+void FitBc7Endpoints(const uint8_t texels[64], const float ends[2][4], Bc7Mode6Fit& fit)
+{
+    uint32_t e[2][4];
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        QuantizeBc7Endpoint(ends[i], fit.q[i], fit.p[i]);
+        for (uint32_t k = 0; k < 4; k++)
+        {
+            e[i][k] = (fit.q[i][k] << 1) | fit.p[i];
+        }
+    }
+    fit.error = FitBc7Indices(texels, e[0], e[1], fit.indices);
+}
+
+void EncodeBc7Block(const uint8_t texels[64], uint8_t* block)
+{
+    // principal axis of the block in rgba by power iteration.
+    float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    float c_min[4] = { 255.0f, 255.0f, 255.0f, 255.0f };
+    float c_max[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        for (uint32_t k = 0; k < 4; k++)
+        {
+            float v = texels[i * 4 + k];
+            mean[k] += v / 16.0f;
+            c_min[k] = min(c_min[k], v);
+            c_max[k] = max(c_max[k], v);
+        }
+    }
+
+    float cov[4][4] = {};
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        for (uint32_t a = 0; a < 4; a++)
+        {
+            for (uint32_t b = 0; b < 4; b++)
+            {
+                cov[a][b] += (texels[i * 4 + a] - mean[a]) * (texels[i * 4 + b] - mean[b]);
+            }
+        }
+    }
+
+    float axis[4];
+    for (uint32_t k = 0; k < 4; k++)
+    {
+        axis[k] = c_max[k] - c_min[k];
+    }
+
+    for (uint32_t iter = 0; iter < 8; iter++)
+    {
+        float next[4] = {};
+        float len = 0.0f;
+        for (uint32_t a = 0; a < 4; a++)
+        {
+            for (uint32_t b = 0; b < 4; b++)
+            {
+                next[a] += cov[a][b] * axis[b];
+            }
+            len = max(len, fabs(next[a]));
+        }
+
+        if (len < 1e-6f)
+        {
+            break;
+        }
+
+        for (uint32_t k = 0; k < 4; k++)
+        {
+            axis[k] = next[k] / len;
+        }
+    }
+
+    float axis_len2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2] + axis[3] * axis[3];
+    float t_min = 0.0f, t_max = 0.0f;
+    if (axis_len2 > 1e-12f)
+    {
+        t_min = FLT_MAX;
+        t_max = -FLT_MAX;
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            float t = 0.0f;
+            for (uint32_t k = 0; k < 4; k++)
+            {
+                t += (texels[i * 4 + k] - mean[k]) * axis[k];
+            }
+            t /= axis_len2;
+            t_min = min(t_min, t);
+            t_max = max(t_max, t);
+        }
+    }
+
+    float ends[2][4];
+    for (uint32_t k = 0; k < 4; k++)
+    {
+        ends[0][k] = min(max(mean[k] + axis[k] * t_min, 0.0f), 255.0f);
+        ends[1][k] = min(max(mean[k] + axis[k] * t_max, 0.0f), 255.0f);
+    }
+
+    Bc7Mode6Fit best;
+    FitBc7Endpoints(texels, ends, best);
+
+    // least squares refit of the endpoints for the chosen indices, twice.
+    for (uint32_t iter = 0; iter < 2 && best.error > 0; iter++)
+    {
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        float av[4] = {}, bv[4] = {};
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            float t = kBc7Weights4[best.indices[i]] / 64.0f;
+            float s = 1.0f - t;
+            aa += s * s;
+            ab += s * t;
+            bb += t * t;
+            for (uint32_t k = 0; k < 4; k++)
+            {
+                av[k] += s * texels[i * 4 + k];
+                bv[k] += t * texels[i * 4 + k];
+            }
+        }
+
+        float det = aa * bb - ab * ab;
+        if (fabs(det) < 1e-6f)
+        {
+            break;
+        }
+
+        float refit_ends[2][4];
+        for (uint32_t k = 0; k < 4; k++)
+        {
+            refit_ends[0][k] = min(max((av[k] * bb - bv[k] * ab) / det, 0.0f), 255.0f);
+            refit_ends[1][k] = min(max((bv[k] * aa - av[k] * ab) / det, 0.0f), 255.0f);
+        }
+
+        Bc7Mode6Fit refit;
+        FitBc7Endpoints(texels, refit_ends, refit);
+        if (refit.error >= best.error)
+        {
+            break;
+        }
+        best = refit;
+    }
+
+    // the msb of the first index is implied 0, swap the endpoints to make it so.
+    if (best.indices[0] >= 8)
+    {
+        for (uint32_t k = 0; k < 4; k++)
+        {
+            swap(best.q[0][k], best.q[1][k]);
+        }
+        swap(best.p[0], best.p[1]);
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            best.indices[i] = uint8_t(15 - best.indices[i]);
+        }
+    }
+
+    memset(block, 0, 16);
+    Bc7BitWriter writer = { block, 0 };
+    writer.write(1 << 6, 7);
+    for (uint32_t k = 0; k < 4; k++)
+    {
+        writer.write(best.q[0][k], 7);
+        writer.write(best.q[1][k], 7);
+    }
+    writer.write(best.p[0], 1);
+    writer.write(best.p[1], 1);
+    writer.write(best.indices[0], 3);
+    for (uint32_t i = 1; i < 16; i++)
+    {
+        writer.write(best.indices[i], 4);
+    }
+}
+
+bool DecodeBc7Block(const uint8_t* block, uint8_t* texels)
+{
+    // mode is the number of zero bits before the first set bit.
+    if ((block[0] & 0x7f) != 0x40)
+    {
+        return false;
+    }
+
+    Bc7BitReader reader = { block, 7 };
+    uint32_t e[2][4];
+    for (uint32_t k = 0; k < 4; k++)
+    {
+        e[0][k] = reader.read(7);
+        e[1][k] = reader.read(7);
+    }
+
+    uint32_t p0 = reader.read(1);
+    uint32_t p1 = reader.read(1);
+    for (uint32_t k = 0; k < 4; k++)
+    {
+        e[0][k] = (e[0][k] << 1) | p0;
+        e[1][k] = (e[1][k] << 1) | p1;
+    }
+
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        uint32_t w = kBc7Weights4[reader.read(i == 0 ? 3 : 4)];
+        for (uint32_t k = 0; k < 4; k++)
+        {
+            texels[i * 4 + k] = uint8_t(((64 - w) * e[0][k] + w * e[1][k] + 32) >> 6);
+        }
+    }
+    return true;
+}
+
+void EncodeBlock(const uint8_t texels[64], BlockFormat format, Dxt1Convertor& convertor, uint8_t* block)
+{
+    uint8_t values[16];
+    int output_bytes = 0;
+    switch (format)
+    {
+    case kBlockFormatBc1:
+        convertor.CompressImageDXT1(texels, 4, 4, 4, false, output_bytes, block);
+        break;
+
+    case kBlockFormatBc3:
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            values[i] = texels[i * 4 + 3];
+        }
+        EncodeBc4Block(values, block);
+        convertor.CompressImageDXT1(texels, 4, 4, 4, false, output_bytes, block + 8);
+        break;
+
+    case kBlockFormatBc4:
+    case kBlockFormatBc5:
+        for (uint32_t c = 0; c < (format == kBlockFormatBc4 ? 1u : 2u); c++)
+        {
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                values[i] = texels[i * 4 + c];
+            }
+            EncodeBc4Block(values, block + c * 8);
+        }
+        break;
+
+    case kBlockFormatBc7:
+        EncodeBc7Block(texels, block);
+        break;
+    }
+}
+
+bool DecodeBlock(const uint8_t* block, BlockFormat format, uint8_t texels[64])
+{
+    switch (format)
+    {
+    case kBlockFormatBc1:
+        DecodeBc1ColorBlock(block, texels, false);
+        return true;
+
+    case kBlockFormatBc3:
+        DecodeBc1ColorBlock(block + 8, texels, true);
+        DecodeBc4Block(block, texels, 3);
+        return true;
+
+    case kBlockFormatBc4:
+    case kBlockFormatBc5:
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            texels[i * 4 + 1] = texels[i * 4 + 2] = 0;
+            texels[i * 4 + 3] = 255;
+        }
+        DecodeBc4Block(block, texels, 0);
+        if (format == kBlockFormatBc5)
+        {
+            DecodeBc4Block(block + 8, texels, 1);
+        }
+        return true;
+
+    case kBlockFormatBc7:
+        return DecodeBc7Block(block, texels);
+    }
+    return false;
+}
+}
+
+uint32_t GetBlockFormatSize(BlockFormat format)
+{
+    return (format == kBlockFormatBc1 || format == kBlockFormatBc4) ? 8 : 16;
+}
+
+uint32_t GetBlockFormatGlFormat(BlockFormat format)
+{
+    switch (format)
+    {
+    case kBlockFormatBc1:   return kGLCmpsdRgbS3tcDxt1Ext;
+    case kBlockFormatBc3:   return kGLCmpsdRgbaS3tcDxt5Ext;
+    case kBlockFormatBc4:   return kGlCmpsdRedRgtc1;
+    case kBlockFormatBc5:   return kGlCmpsdRgRgtc2;
+    case kBlockFormatBc7:   return kGlCmpsdRgbaBptcUnorm;
+    }
+    return 0;
+}
+
+bool GetGlBlockFormat(uint32_t gl_format, BlockFormat& format)
+{
+    switch (gl_format)
+    {
+    case kGLCmpsdRgbS3tcDxt1Ext:
+    case kGLCmpsdRgbaS3tcDxt1Ext:   format = kBlockFormatBc1; return true;
+    case kGLCmpsdRgbaS3tcDxt5Ext:   format = kBlockFormatBc3; return true;
+    case kGlCmpsdRedRgtc1:          format = kBlockFormatBc4; return true;
+    case kGlCmpsdRgRgtc2:           format = kBlockFormatBc5; return true;
+    case kGlCmpsdRgbaBptcUnorm:     format = kBlockFormatBc7; return true;
+    default:                        return false;
+    }
+}
+
+void CompressBlockImage(const uint8_t* rgba_data, uint32_t w, uint32_t h, BlockFormat format, uint8_t* dst)
+{
+    uint32_t block_w = (w + 3) / 4;
+    uint32_t block_h = (h + 3) / 4;
+    uint32_t block_size = GetBlockFormatSize(format);
+
+    // bc7 costs far more per block, let it split finer.
+    ParallelFor(block_h, format == kBlockFormatBc7 ? 1 : 8, [&](size_t begin, size_t end)
+    {
+        Dxt1Convertor convertor;
+        uint8_t texels[64];
+        for (size_t b_y = begin; b_y < end; b_y++)
+        {
+            for (uint32_t b_x = 0; b_x < block_w; b_x++)
+            {
+                LoadBlock(rgba_data, w, h, b_x, uint32_t(b_y), texels);
+                EncodeBlock(texels, format, convertor, dst + (b_y * block_w + b_x) * block_size);
+            }
+        }
+    });
+}
+
+bool DecompressBlockImage(const uint8_t* src, uint32_t w, uint32_t h, BlockFormat format, uint8_t* rgba_data)
+{
+    uint32_t block_w = (w + 3) / 4;
+    uint32_t block_h = (h + 3) / 4;
+    uint32_t block_size = GetBlockFormatSize(format);
+
+    bool succeeded = true;
+    ParallelFor(block_h, 16, [&](size_t begin, size_t end)
+    {
+        uint8_t texels[64];
+        for (size_t b_y = begin; b_y < end; b_y++)
+        {
+            for (uint32_t b_x = 0; b_x < block_w; b_x++)
+            {
+                if (!DecodeBlock(src + (b_y * block_w + b_x) * block_size, format, texels))
+                {
+                    memset(texels, 0, sizeof(texels));
+                    succeeded = false;
+                }
+                StoreBlock(texels, w, h, b_x, uint32_t(b_y), rgba_data);
+            }
+        }
+    });
+    return succeeded;
+}
+
+float ComputeBlockPsnr(const uint8_t* rgba_data, uint32_t w, uint32_t h, BlockFormat format, const uint8_t* blocks)
+{
+    vector<uint8_t> decoded(size_t(w) * h * 4);
+    if (!DecompressBlockImage(blocks, w, h, format, decoded.data()))
+    {
+        return 0.0f;
+    }
+
+    uint32_t channel_count = format == kBlockFormatBc4 ? 1 : (format == kBlockFormatBc5 ? 2 : (format == kBlockFormatBc1 ? 3 : 4));
+    double error = 0.0;
+    for (size_t i = 0; i < size_t(w) * h; i++)
+    {
+        for (uint32_t k = 0; k < channel_count; k++)
+        {
+            double d = double(decoded[i * 4 + k]) - double(rgba_data[i * 4 + k]);
+            error += d * d;
+        }
+    }
+
+    double mse = error / (double(w) * h * channel_count);
+    // lossless blocks, cap instead of infinity.
+    return mse > 0.0 ? float(10.0 * log10(255.0 * 255.0 / mse)) : 100.0f;
+}
+
+bool CompressTexture(const core::Texture2DInfo* src_info, core::Texture2DInfo* dst_info, BlockFormat format, float* psnr/* = nullptr*/)
+{
+    uint32_t block_size = GetBlockFormatSize(format);
+    vector<uint8_t> rgba_data;
+    for (uint32_t level = 0; level < src_info->m_levelCount; level++)
+    {
+        if (!DecodeTextureLevel(src_info, level, rgba_data))
+        {
+            return false;
+        }
+
+        uint32_t w = src_info->m_mips[level].m_width;
+        uint32_t h = src_info->m_mips[level].m_height;
+        Texture2DSurfaceInfo& mip = dst_info->m_mips[level];
+        mip.m_width = w;
+        mip.m_height = h;
+        mip.m_size = ((w + 3) / 4) * ((h + 3) / 4) * block_size;
+        mip.m_imageData = make_unique<char[]>(mip.m_size);
+
+        uint8_t* blocks = reinterpret_cast<uint8_t*>(mip.m_imageData.get());
+        CompressBlockImage(rgba_data.data(), w, h, format, blocks);
+
+        if (level == 0 && psnr)
+        {
+            *psnr = ComputeBlockPsnr(rgba_data.data(), w, h, format, blocks);
+        }
+    }
+
+    dst_info->m_objectId = src_info->m_objectId;
+    dst_info->m_levelCount = src_info->m_levelCount;
+    dst_info->m_internalFormat = GetBlockFormatGlFormat(format);
+    dst_info->m_format = dst_info->m_internalFormat;
+    dst_info->m_type = src_info->m_type;
+    return true;
+}
+
+}
@@ -1,4 +1,7 @@
 #include "coregeographic.h"
+#include "corethread.h"
+#include "GeographicLib/Geoid.hpp"
+#include <complex>
 
 namespace core
 {
@@ -73,4 +76,288 @@ core::matrix4d CreateLocalTransformMatrixByReferenceCoordinate(const core::vec3d
     return inverse(transform_mat);
 }
 
+namespace
+{
+constexpr double kUtmScale = 0.9996;
+constexpr double kUtmFalseEasting = 500000.0;
+constexpr double kUtmFalseNorthing = 10000000.0;
+constexpr double kUpsScale = 0.994;
+constexpr double kUpsFalseOrigin = 2000000.0;
+
+// sum of coeffs[j] * sin(2 * (j + 1) * zeta) by clenshaw recurrence, complex zeta
+// evaluates both the northing and easting series in one go.
+complex<double> SinSeries(const double coeffs[6], const complex<double>& zeta)
+{
+    complex<double> c2 = 2.0 * cos(2.0 * zeta);
+    complex<double> y0(0.0), y1(0.0);
+    for (int j = 5; j >= 0; j--)
+    {
+        complex<double> y = c2 * y0 - y1 + coeffs[j];
+        y1 = y0;
+        y0 = y;
+    }
+    return y0 * sin(2.0 * zeta);
+}
+}
+
+UTMProjector::UTMProjector()
+{
+    const double a = emajor;
+    const double f = 1.0 / 298.257223563;
+    const double n = f / (2.0 - f);
+    const double n2 = n * n;
+    const double n3 = n2 * n;
+    const double n4 = n3 * n;
+    const double n5 = n4 * n;
+    const double n6 = n5 * n;
+
+    m_e = sqrt(f * (2.0 - f));
+    m_e2m = 1.0 - m_e * m_e;
+    m_a1 = a / (1.0 + n) * (1.0 + n2 / 4.0 + n4 / 64.0 + n6 / 256.0);
+    m_ups_c = sqrt(pow(1.0 + m_e, 1.0 + m_e) * pow(1.0 - m_e, 1.0 - m_e));
+
+    m_alpha[0] = n / 2.0 - 2.0 / 3.0 * n2 + 5.0 / 16.0 * n3 + 41.0 / 180.0 * n4 - 127.0 / 288.0 * n5 + 7891.0 / 37800.0 * n6;
+    m_alpha[1] = 13.0 / 48.0 * n2 - 3.0 / 5.0 * n3 + 557.0 / 1440.0 * n4 + 281.0 / 630.0 * n5 - 1983433.0 / 1935360.0 * n6;
+    m_alpha[2] = 61.0 / 240.0 * n3 - 103.0 / 140.0 * n4 + 15061.0 / 26880.0 * n5 + 167603.0 / 181440.0 * n6;
+    m_alpha[3] = 49561.0 / 161280.0 * n4 - 179.0 / 168.0 * n5 + 6601661.0 / 7257600.0 * n6;
+    m_alpha[4] = 34729.0 / 80640.0 * n5 - 3418889.0 / 1995840.0 * n6;
+    m_alpha[5] = 212378941.0 / 319334400.0 * n6;
+
+    m_beta[0] = n / 2.0 - 2.0 / 3.0 * n2 + 37.0 / 96.0 * n3 - 1.0 / 360.0 * n4 - 81.0 / 512.0 * n5 + 96199.0 / 604800.0 * n6;
+    m_beta[1] = 1.0 / 48.0 * n2 + 1.0 / 15.0 * n3 - 437.0 / 1440.0 * n4 + 46.0 / 105.0 * n5 - 1118711.0 / 3870720.0 * n6;
+    m_beta[2] = 17.0 / 480.0 * n3 - 37.0 / 840.0 * n4 - 209.0 / 4480.0 * n5 + 5569.0 / 90720.0 * n6;
+    m_beta[3] = 4397.0 / 161280.0 * n4 - 11.0 / 504.0 * n5 - 830251.0 / 7257600.0 * n6;
+    m_beta[4] = 4583.0 / 161280.0 * n5 - 108847.0 / 3991680.0 * n6;
+    m_beta[5] = 20648693.0 / 638668800.0 * n6;
+}
+
+// tan of the conformal latitude from tan of the geographic latitude.
+double UTMProjector::taupf(double tau) const
+{
+    double tau1 = hypot(1.0, tau);
+    double sig = sinh(m_e * atanh(m_e * tau / tau1));
+    return hypot(1.0, sig) * tau - sig * tau1;
+}
+
+// inverse of taupf by newton iteration, converges in 2 or 3 steps.
+double UTMProjector::tauf(double taup) const
+{
+    const double tol = sqrt(numeric_limits<double>::epsilon()) / 10.0;
+    const double stol = tol * max(1.0, abs(taup));
+    double tau = taup / m_e2m;
+    for (int i = 0; i < 5; i++)
+    {
+        double taupa = taupf(tau);
+        double dtau = (taup - taupa) * (1.0 + m_e2m * tau * tau) /
+                      (m_e2m * hypot(1.0, tau) * hypot(1.0, taupa));
+        tau += dtau;
+        if (!(abs(dtau) >= stol))
+        {
+            break;
+        }
+    }
+    return tau;
+}
+
+int32_t UTMProjector::standard_zone(double lat, double lon)
+{
+    if (lat >= 84.0 || lat < -80.0)
+    {
+        return kUpsZone;
+    }
+
+    double lon_n = lon - 360.0 * floor((lon + 180.0) / 360.0);
+    int32_t zone = min(int32_t(floor((lon_n + 180.0) / 6.0)) + 1, 60);
+
+    if (lat >= 56.0 && lat < 64.0 && lon_n >= 3.0 && lon_n < 12.0)
+    {
+        zone = 32;
+    }
+    else if (lat >= 72.0 && lon_n >= 0.0 && lon_n < 42.0)
+    {
+        zone = lon_n < 9.0 ? 31 : (lon_n < 21.0 ? 33 : (lon_n < 33.0 ? 35 : 37));
+    }
+
+    return zone;
+}
+
+int32_t UTMProjector::common_zone(const core::vec2d* gps_loc, size_t count, bool& northp)
+{
+    // votes per zone, 0 and 61 are the north and south ups.
+    size_t zone_votes[62] = {};
+    size_t north_votes = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        int32_t zone = standard_zone(gps_loc[i].x, gps_loc[i].y);
+        zone_votes[zone == kUpsZone && gps_loc[i].x < 0.0 ? 61 : zone]++;
+        north_votes += gps_loc[i].x >= 0.0 ? 1 : 0;
+    }
+
+    int32_t best_zone = 1;
+    for (int32_t zone = 0; zone < 62; zone++)
+    {
+        if (zone_votes[zone] > zone_votes[best_zone])
+        {
+            best_zone = zone;
+        }
+    }
+
+    if (best_zone == 0 || best_zone == 61)
+    {
+        northp = best_zone == 0;
+        return kUpsZone;
+    }
+
+    northp = north_votes * 2 >= count;
+    return best_zone;
+}
+
+core::vec2d UTMProjector::forward(const core::vec2d& gps_loc, int32_t zone, bool northp) const
+{
+    double phi = core::DegreesToRadians(gps_loc.x);
+
+    if (zone == kUpsZone)
+    {
+        double lam = core::DegreesToRadians(gps_loc.y);
+        double taup = taupf(tan(northp ? phi : -phi));
+        double t = taup >= 0.0 ? 1.0 / (hypot(1.0, taup) + taup) : hypot(1.0, taup) - taup;
+        double rho = 2.0 * kUpsScale * emajor * t / m_ups_c;
+        return core::vec2d(kUpsFalseOrigin + rho * sin(lam),
+                           kUpsFalseOrigin + (northp ? -rho : rho) * cos(lam));
+    }
+
+    double lam = gps_loc.y - (zone * 6.0 - 183.0);
+    lam = core::DegreesToRadians(lam - 360.0 * floor((lam + 180.0) / 360.0));
+
+    double taup = taupf(tan(phi));
+    double xip = atan2(taup, cos(lam));
+    double etap = asinh(sin(lam) / hypot(taup, cos(lam)));
+    complex<double> zetap(xip, etap);
+    complex<double> zeta = zetap + SinSeries(m_alpha, zetap);
+
+    return core::vec2d(kUtmFalseEasting + kUtmScale * m_a1 * zeta.imag(),
+                       (northp ? 0.0 : kUtmFalseNorthing) + kUtmScale * m_a1 * zeta.real());
+}
+
+core::vec2d UTMProjector::reverse(const core::vec2d& utm_loc, int32_t zone, bool northp) const
+{
+    if (zone == kUpsZone)
+    {
+        double dx = utm_loc.x - kUpsFalseOrigin;
+        double dy = utm_loc.y - kUpsFalseOrigin;
+        double rho = hypot(dx, dy);
+        double t = rho * m_ups_c / (2.0 * kUpsScale * emajor);
+        double phi = t > 0.0 ? atan(tauf((1.0 / t - t) / 2.0)) : PI / 2.0;
+        double lam = atan2(dx, northp ? -dy : dy);
+        return core::vec2d(core::RadiansToDegrees(northp ? phi : -phi), core::RadiansToDegrees(lam));
+    }
+
+    double xi = (utm_loc.y - (northp ? 0.0 : kUtmFalseNorthing)) / (kUtmScale * m_a1);
+    double eta = (utm_loc.x - kUtmFalseEasting) / (kUtmScale * m_a1);
+    complex<double> zeta(xi, eta);
+    complex<double> zetap = zeta - SinSeries(m_beta, zeta);
+
+    double s = sinh(zetap.imag());
+    double c = max(0.0, cos(zetap.real()));
+    double r = hypot(s, c);
+    double lam = atan2(s, c);
+    double phi = r > 0.0 ? atan(tauf(sin(zetap.real()) / r)) : (zetap.real() < 0.0 ? -PI / 2.0 : PI / 2.0);
+
+    return core::vec2d(core::RadiansToDegrees(phi), zone * 6.0 - 183.0 + core::RadiansToDegrees(lam));
+}
+
+int32_t UTMProjector::forward(const core::vec2d* gps_loc, core::vec2d* utm_loc, size_t count, int32_t zone, bool& northp) const
+{
+    if (zone == kAutoZone)
+    {
+        zone = common_zone(gps_loc, count, northp);
+    }
+
+    ParallelFor(count, 4096, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            utm_loc[i] = forward(gps_loc[i], zone, northp);
+        }
+    });
+
+    return zone;
+}
+
+void UTMProjector::reverse(const core::vec2d* utm_loc, core::vec2d* gps_loc, size_t count, int32_t zone, bool northp) const
+{
+    ParallelFor(count, 4096, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            gps_loc[i] = reverse(utm_loc[i], zone, northp);
+        }
+    });
+}
+
+GeoidModel::GeoidModel()
+{
+}
+
+GeoidModel::~GeoidModel()
+{
+}
+
+bool GeoidModel::load(const string& name/* = ""*/, const string& path/* = ""*/, bool cubic/* = true*/)
+{
+    m_geoid.reset();
+
+    // GeographicLib reports missing or damaged grid files by throwing.
+    try
+    {
+        // thread safe mode caches the whole grid, batched lookups run in parallel.
+        m_geoid = make_unique<GeographicLib::Geoid>(name.empty() ? GeographicLib::Geoid::DefaultGeoidName() : name,
+                                                    path, cubic, true);
+    }
+    catch (const GeographicLib::GeographicErr&)
+    {
+        m_geoid.reset();
+    }
+
+    return m_geoid != nullptr;
+}
+
+double GeoidModel::undulation(double lat, double lon) const
+{
+    return m_geoid ? double((*m_geoid)(lat, lon)) : 0.0;
+}
+
+void GeoidModel::undulations(const core::GpsCoord* coords, double* result, size_t count) const
+{
+    ParallelFor(count, 4096, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            result[i] = undulation(coords[i].lat, coords[i].lon);
+        }
+    });
+}
+
+void GeoidModel::orthometric_to_ellipsoidal(core::GpsCoord* coords, size_t count) const
+{
+    ParallelFor(count, 4096, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            coords[i].alt += undulation(coords[i].lat, coords[i].lon);
+        }
+    });
+}
+
+void GeoidModel::ellipsoidal_to_orthometric(core::GpsCoord* coords, size_t count) const
+{
+    ParallelFor(count, 4096, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            coords[i].alt -= undulation(coords[i].lat, coords[i].lon);
+        }
+    });
+}
+
 }
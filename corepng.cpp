@@ -0,0 +1,313 @@
+#include "corepng.h"
+#include "corethread.h"
+#include <fstream>
+#include <algorithm>
+#include "zlib.h"
+
+namespace core
+{
+
+namespace
+{
+// filtered bytes per deflate job, big enough that the primed dictionary is cheap.
+constexpr size_t kPngDeflateChunkSize = 256 * 1024;
+constexpr size_t kPngDictionarySize = 32 * 1024;
+// zlib header for a 32k window, any level.
+constexpr uint8_t kZlibHeader[2] = { 0x78, 0x9c };
+
+void WriteBigEndian32(uint32_t value, uint8_t* dst)
+{
+    dst[0] = uint8_t(value >> 24);
+    dst[1] = uint8_t(value >> 16);
+    dst[2] = uint8_t(value >> 8);
+    dst[3] = uint8_t(value);
+}
+
+void AppendPngChunk(vector<uint8_t>& png_data, const char type[4], const uint8_t* data, size_t size)
+{
+    size_t ofs = png_data.size();
+    png_data.resize(ofs + 12 + size);
+    WriteBigEndian32(uint32_t(size), &png_data[ofs]);
+    memcpy(&png_data[ofs + 4], type, 4);
+    if (size > 0)
+    {
+        memcpy(&png_data[ofs + 8], data, size);
+    }
+
+    // the crc covers the type and the data.
+    uint32_t crc = uint32_t(crc32(0, &png_data[ofs + 4], uInt(size + 4)));
+    WriteBigEndian32(crc, &png_data[ofs + 8 + size]);
+}
+
+// one source row in png sample order: r g b a, 16 bit big endian.
+void LoadPngRow(const uint8_t* src_row, uint32_t w, uint32_t channel_count, uint32_t bit_depth, bool bgr_order, uint8_t* dst)
+{
+    bool swap_rb = bgr_order && channel_count >= 3;
+    if (bit_depth == 8)
+    {
+        memcpy(dst, src_row, size_t(w) * channel_count);
+        if (swap_rb)
+        {
+            for (uint32_t x = 0; x < w; x++)
+            {
+                swap(dst[x * channel_count], dst[x * channel_count + 2]);
+            }
+        }
+        return;
+    }
+
+    const uint16_t* src = reinterpret_cast<const uint16_t*>(src_row);
+    for (uint32_t x = 0; x < w; x++)
+    {
+        for (uint32_t c = 0; c < channel_count; c++)
+        {
+            uint32_t src_c = (swap_rb && c != 1 && c != 3) ? 2 - c : c;
+            uint16_t v = src[x * channel_count + src_c];
+            dst[(x * channel_count + c) * 2 + 0] = uint8_t(v >> 8);
+            dst[(x * channel_count + c) * 2 + 1] = uint8_t(v);
+        }
+    }
+}
+
+uint8_t PaethPredictor(int32_t a, int32_t b, int32_t c)
+{
+    int32_t p = a + b - c;
+    int32_t pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    return uint8_t((pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c));
+}
+
+// filter type byte followed by the filtered row, prev is all zero for the first row.
+// the first pixel has no left neighbour, a and c read as 0 there.
+void ApplyPngFilter(uint32_t filter, const uint8_t* row, const uint8_t* prev, size_t row_bytes, uint32_t bpp, uint8_t* dst)
+{
+    *dst++ = uint8_t(filter);
+    size_t head = min(size_t(bpp), row_bytes);
+    switch (filter)
+    {
+    case kPngFilterNone:
+        memcpy(dst, row, row_bytes);
+        break;
+
+    case kPngFilterSub:
+        memcpy(dst, row, head);
+        for (size_t i = bpp; i < row_bytes; i++)
+        {
+            dst[i] = uint8_t(row[i] - row[i - bpp]);
+        }
+        break;
+
+    case kPngFilterUp:
+        for (size_t i = 0; i < row_bytes; i++)
+        {
+            dst[i] = uint8_t(row[i] - prev[i]);
+        }
+        break;
+
+    case kPngFilterAverage:
+        for (size_t i = 0; i < head; i++)
+        {
+            dst[i] = uint8_t(row[i] - (prev[i] >> 1));
+        }
+        for (size_t i = bpp; i < row_bytes; i++)
+        {
+            dst[i] = uint8_t(row[i] - ((uint32_t(row[i - bpp]) + prev[i]) >> 1));
+        }
+        break;
+
+    default:
+        for (size_t i = 0; i < head; i++)
+        {
+            dst[i] = uint8_t(row[i] - prev[i]);
+        }
+        for (size_t i = bpp; i < row_bytes; i++)
+        {
+            dst[i] = uint8_t(row[i] - PaethPredictor(row[i - bpp], prev[i], prev[i - bpp]));
+        }
+        break;
+    }
+}
+
+uint64_t GetFilterCost(const uint8_t* filtered, size_t row_bytes)
+{
+    uint64_t cost = 0;
+    for (size_t i = 0; i < row_bytes; i++)
+    {
+        cost += uint64_t(abs(int32_t(int8_t(filtered[i]))));
+    }
+    return cost;
+}
+
+struct DeflateChunk
+{
+    vector<uint8_t>     data;
+    uint32_t            adler;
+    bool                succeeded;
+};
+
+void DeflateChunkData(const uint8_t* src, size_t size, const uint8_t* dictionary, size_t dictionary_size,
+                      bool last, int32_t level, int32_t strategy, DeflateChunk& chunk)
+{
+    chunk.succeeded = false;
+    chunk.adler = uint32_t(adler32(adler32(0, nullptr, 0), src, uInt(size)));
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    // raw deflate, the zlib header and adler are written once around all chunks.
+    if (deflateInit2(&stream, level, Z_DEFLATED, -15, 8, strategy) != Z_OK)
+    {
+        return;
+    }
+
+    if (dictionary_size > 0)
+    {
+        deflateSetDictionary(&stream, dictionary, uInt(dictionary_size));
+    }
+
+    // bound plus room for the empty stored block of the sync flush.
+    chunk.data.resize(deflateBound(&stream, uLong(size)) + 64);
+    stream.next_in = const_cast<Bytef*>(src);
+    stream.avail_in = uInt(size);
+    stream.next_out = chunk.data.data();
+    stream.avail_out = uInt(chunk.data.size());
+
+    int32_t result = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+    chunk.succeeded = last ? result == Z_STREAM_END : (result == Z_OK && stream.avail_in == 0);
+    chunk.data.resize(stream.total_out);
+    deflateEnd(&stream);
+}
+}
+
+bool EncodePngImage(const void* src_data, uint32_t w, uint32_t h, size_t pitch,
+                    uint32_t channel_count, uint32_t bit_depth, bool bgr_order,
+                    vector<uint8_t>& png_data,
+                    PngFilter filter/* = kPngFilterAdaptive*/, int32_t compression_level/* = 6*/)
+{
+    if (!src_data || w == 0 || h == 0 || channel_count < 1 || channel_count > 4 || (bit_depth != 8 && bit_depth != 16))
+    {
+        return false;
+    }
+
+    uint32_t bpp = channel_count * bit_depth / 8;
+    size_t row_bytes = size_t(w) * bpp;
+    size_t filtered_pitch = row_bytes + 1;
+    vector<uint8_t> filtered(filtered_pitch * h);
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(src_data);
+
+    // rows only depend on the unfiltered row above, so any row range filters on its own.
+    ParallelFor(h, 64, [&](size_t begin, size_t end)
+    {
+        vector<uint8_t> rows(row_bytes * 2, 0);
+        vector<uint8_t> candidates(filter == kPngFilterAdaptive ? filtered_pitch * 5 : 0);
+        uint8_t* prev = rows.data();
+        uint8_t* cur = rows.data() + row_bytes;
+        if (begin > 0)
+        {
+            LoadPngRow(src + (begin - 1) * pitch, w, channel_count, bit_depth, bgr_order, prev);
+        }
+
+        for (size_t y = begin; y < end; y++)
+        {
+            LoadPngRow(src + y * pitch, w, channel_count, bit_depth, bgr_order, cur);
+            uint8_t* dst = &filtered[y * filtered_pitch];
+            if (filter != kPngFilterAdaptive)
+            {
+                ApplyPngFilter(filter, cur, prev, row_bytes, bpp, dst);
+            }
+            else
+            {
+                uint32_t best_filter = 0;
+                uint64_t best_cost = UINT64_MAX;
+                for (uint32_t f = kPngFilterNone; f <= kPngFilterPaeth; f++)
+                {
+                    uint8_t* candidate = &candidates[f * filtered_pitch];
+                    ApplyPngFilter(f, cur, prev, row_bytes, bpp, candidate);
+                    uint64_t cost = GetFilterCost(candidate + 1, row_bytes);
+                    if (cost < best_cost)
+                    {
+                        best_cost = cost;
+                        best_filter = f;
+                    }
+                }
+                memcpy(dst, &candidates[best_filter * filtered_pitch], filtered_pitch);
+            }
+            swap(prev, cur);
+        }
+    });
+
+    size_t total_size = filtered.size();
+    size_t num_chunks = (total_size + kPngDeflateChunkSize - 1) / kPngDeflateChunkSize;
+    vector<DeflateChunk> chunks(num_chunks);
+    int32_t strategy = filter == kPngFilterNone ? Z_DEFAULT_STRATEGY : Z_FILTERED;
+    ParallelFor(num_chunks, 1, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            size_t ofs = i * kPngDeflateChunkSize;
+            size_t size = min(kPngDeflateChunkSize, total_size - ofs);
+            size_t dictionary_size = min(ofs, kPngDictionarySize);
+            DeflateChunkData(&filtered[ofs], size, &filtered[ofs - dictionary_size], dictionary_size,
+                             i + 1 == num_chunks, compression_level, strategy, chunks[i]);
+        }
+    });
+
+    uint32_t adler = uint32_t(adler32(0, nullptr, 0));
+    size_t stream_size = sizeof(kZlibHeader) + 4;
+    for (size_t i = 0; i < num_chunks; i++)
+    {
+        if (!chunks[i].succeeded)
+        {
+            return false;
+        }
+        size_t size = min(kPngDeflateChunkSize, total_size - i * kPngDeflateChunkSize);
+        adler = uint32_t(adler32_combine(adler, chunks[i].adler, z_off_t(size)));
+        stream_size += chunks[i].data.size();
+    }
+
+    vector<uint8_t> stream;
+    stream.reserve(stream_size);
+    stream.insert(stream.end(), kZlibHeader, kZlibHeader + sizeof(kZlibHeader));
+    for (auto& chunk : chunks)
+    {
+        stream.insert(stream.end(), chunk.data.begin(), chunk.data.end());
+        chunk.data = vector<uint8_t>();
+    }
+    uint8_t adler_data[4];
+    WriteBigEndian32(adler, adler_data);
+    stream.insert(stream.end(), adler_data, adler_data + 4);
+
+    static const uint8_t kPngSignature[8] = { 0x89, 'P', 'N', 'G', 0x0d, 0x0a, 0x1a, 0x0a };
+    static const uint8_t kPngColorTypes[4] = { 0, 4, 2, 6 };
+    uint8_t ihdr[13];
+    WriteBigEndian32(w, ihdr);
+    WriteBigEndian32(h, ihdr + 4);
+    ihdr[8] = uint8_t(bit_depth);
+    ihdr[9] = kPngColorTypes[channel_count - 1];
+    ihdr[10] = 0;   // deflate
+    ihdr[11] = 0;   // adaptive filtering
+    ihdr[12] = 0;   // no interlace
+
+    png_data.clear();
+    png_data.reserve(stream.size() + 64);
+    png_data.insert(png_data.end(), kPngSignature, kPngSignature + 8);
+    AppendPngChunk(png_data, "IHDR", ihdr, sizeof(ihdr));
+    AppendPngChunk(png_data, "IDAT", stream.data(), stream.size());
+    AppendPngChunk(png_data, "IEND", nullptr, 0);
+    return true;
+}
+
+bool ExportPngFile(const string& file_name, const void* src_data, uint32_t w, uint32_t h, size_t pitch,
+                   uint32_t channel_count, uint32_t bit_depth, bool bgr_order,
+                   PngFilter filter/* = kPngFilterAdaptive*/, int32_t compression_level/* = 6*/)
+{
+    vector<uint8_t> png_data;
+    if (!EncodePngImage(src_data, w, h, pitch, channel_count, bit_depth, bgr_order, png_data, filter, compression_level))
+    {
+        return false;
+    }
+
+    ofstream out_file(file_name, ofstream::binary);
+    out_file.write(reinterpret_cast<const char*>(png_data.data()), streamsize(png_data.size()));
+    return bool(out_file);
+}
+
+}
@@ -1,9 +1,20 @@
 #include "coretexture.h"
+#include "coreblockcodec.h"
 #include "glfunctionlist.h"
+#include "corethread.h"
 #include <fstream>
 #include <algorithm>
 #include "assert.h"
 
+// byte shuffles need ssse3 (implied by avx) or aarch64 neon, plain sse2 has no lane
+// lookup and the scalar palette fetch beats a compare and select.
+#if defined(CORE_SIMD_SSE) && (defined(__SSSE3__) || defined(CORE_SIMD_AVX))
+#define CORE_DXT1_SHUFFLE_SSSE3 1
+#include <tmmintrin.h>
+#elif defined(CORE_SIMD_NEON64)
+#define CORE_DXT1_SHUFFLE_NEON 1
+#endif
+
 namespace core
 {
 
@@ -154,7 +165,11 @@ void Dxt1Convertor::EmitColorIndices( const uint8_t *colorBlock, const uint8_t *
     EmitDoubleWord( result );
 }
 
-void Dxt1Convertor::DecodeDxt1Block(uint32_t* dst_iamge_buffer, uint32_t x, uint32_t y, uint32_t w, const uint8_t* dxt_block)
+namespace
+{
+// palette in the 0x00rrggbb layout of DecodeDxt1Block, returns true for the 3 color
+// mode where index 3 is transparent black. dxt3/5 color blocks are always 4 color.
+bool DecodeDxt1Palette(const uint8_t* dxt_block, uint32_t color8[4], bool four_color = false)
 {
     uint32_t color_0 = (uint32_t(dxt_block[1]) << 8) | dxt_block[0];
     uint32_t color_1 = (uint32_t(dxt_block[3]) << 8) | dxt_block[2];
@@ -164,12 +179,11 @@ void Dxt1Convertor::DecodeDxt1Block(uint32_t* dst_iamge_buffer, uint32_t x, uint
     uint32_t color_1_r = (color_1 << 8) & 0xf80000;
     uint32_t color_1_g = (color_1 << 5) & 0xfc00;
     uint32_t color_1_b = (color_1 << 3) & 0xf8;
-    uint32_t color8[4];
 
     color8[0] = color_0_r | color_0_g | color_0_b;
     color8[1] = color_1_r | color_1_g | color_1_b;
 
-    if (color_0 > color_1)
+    if (four_color || color_0 > color_1)
     {
         color8[2] = color8[0] * 2 + color8[1];
         color8[3] = color8[0] + color8[1] * 2;
@@ -183,12 +197,188 @@ void Dxt1Convertor::DecodeDxt1Block(uint32_t* dst_iamge_buffer, uint32_t x, uint
 
         color8[2] = (color_2_r & 0xff0000) | (color_2_g & 0xff00) | color_2_b;
         color8[3] = (color_3_r & 0xff0000) | (color_3_g & 0xff00) | color_3_b;
+
+        return false;
     }
     else
     {
         color8[2] = (color8[0] + color8[1]) >> 1;
         color8[3] = 0;
+
+        return true;
     }
+}
+
+#if defined(CORE_DXT1_SHUFFLE_SSSE3) || defined(CORE_DXT1_SHUFFLE_NEON)
+// byte shuffles expanding one row of 2 bit indices into 4 palette entries, packed
+// as 4 channel texels or 3 channel texels in the low 12 bytes.
+struct Dxt1RowShuffleTable
+{
+    alignas(16) uint8_t lanes[2][256][16];
+
+    Dxt1RowShuffleTable()
+    {
+        for (uint32_t row = 0; row < 256; row++)
+        {
+            memset(lanes[1][row], 0x80, 16);
+            for (uint32_t x = 0; x < 4; x++)
+            {
+                uint32_t idx = (row >> (2 * x)) & 0x03;
+                for (uint32_t c = 0; c < 4; c++)
+                {
+                    lanes[0][row][x * 4 + c] = uint8_t(idx * 4 + c);
+                    if (c < 3)
+                    {
+                        lanes[1][row][x * 3 + c] = uint8_t(idx * 4 + c);
+                    }
+                }
+            }
+        }
+    }
+};
+
+const Dxt1RowShuffleTable& GetDxt1RowShuffleTable()
+{
+    static const Dxt1RowShuffleTable table;
+    return table;
+}
+#endif
+
+// decode the top left cols x rows texels of a block into dst, byte order r g b (a)
+// or b g r (a). alpha is 0 for the transparent index of the 3 color mode, 255 otherwise.
+template<uint32_t kChannels>
+void StoreDxt1Block(const uint8_t* dxt_block, uint8_t* dst, ptrdiff_t dst_pitch, uint32_t cols, uint32_t rows, bool bgr_order)
+{
+    // 0x00rrggbb is b g r x in memory, add alpha and swap r and b for rgb order.
+    uint32_t palette[4];
+    bool punch_through = DecodeDxt1Palette(dxt_block, palette);
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        uint32_t c = palette[i];
+        c = bgr_order ? c : ((c & 0xff00) | ((c >> 16) & 0xff) | ((c & 0xff) << 16));
+        palette[i] = c | 0xff000000;
+    }
+    palette[3] = punch_through ? 0 : palette[3];
+
+#if defined(CORE_DXT1_SHUFFLE_SSSE3) || defined(CORE_DXT1_SHUFFLE_NEON)
+    if (cols == 4)
+    {
+        const uint8_t (*lanes)[16] = GetDxt1RowShuffleTable().lanes[kChannels == 4 ? 0 : 1];
+#if defined(CORE_DXT1_SHUFFLE_SSSE3)
+        // built from registers, a vector load of the palette just stored stalls.
+        __m128i palette_v = _mm_setr_epi32(int32_t(palette[0]), int32_t(palette[1]), int32_t(palette[2]), int32_t(palette[3]));
+        for (uint32_t b_y = 0; b_y < rows; b_y++, dst += dst_pitch)
+        {
+            __m128i c = _mm_shuffle_epi8(palette_v, _mm_load_si128(reinterpret_cast<const __m128i*>(lanes[dxt_block[4 + b_y]])));
+            if (kChannels == 4)
+            {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), c);
+            }
+            else
+            {
+                int32_t tail = _mm_cvtsi128_si32(_mm_srli_si128(c, 8));
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), c);
+                memcpy(dst + 8, &tail, 4);
+            }
+        }
+#else
+        uint32x4_t palette_u32 = vdupq_n_u32(palette[0]);
+        palette_u32 = vsetq_lane_u32(palette[1], palette_u32, 1);
+        palette_u32 = vsetq_lane_u32(palette[2], palette_u32, 2);
+        palette_u32 = vsetq_lane_u32(palette[3], palette_u32, 3);
+        uint8x16_t palette_v = vreinterpretq_u8_u32(palette_u32);
+        for (uint32_t b_y = 0; b_y < rows; b_y++, dst += dst_pitch)
+        {
+            uint8x16_t c = vqtbl1q_u8(palette_v, vld1q_u8(lanes[dxt_block[4 + b_y]]));
+            if (kChannels == 4)
+            {
+                vst1q_u8(dst, c);
+            }
+            else
+            {
+                uint32_t tail = vgetq_lane_u32(vreinterpretq_u32_u8(c), 2);
+                vst1_u8(dst, vget_low_u8(c));
+                memcpy(dst + 8, &tail, 4);
+            }
+        }
+#endif
+        return;
+    }
+#endif
+
+    for (uint32_t b_y = 0; b_y < rows; b_y++, dst += dst_pitch)
+    {
+        // one byte of 2 bit indices per row, texel x in bits 2x and 2x + 1.
+        uint32_t row_indices = dxt_block[4 + b_y];
+        uint32_t texels[4] = { palette[row_indices & 0x03],
+                               palette[(row_indices >> 2) & 0x03],
+                               palette[(row_indices >> 4) & 0x03],
+                               palette[(row_indices >> 6) & 0x03] };
+
+        if (cols < 4)
+        {
+            for (uint32_t b_x = 0; b_x < cols; b_x++)
+            {
+                memcpy(dst + b_x * kChannels, &texels[b_x], kChannels);
+            }
+        }
+        else if (kChannels == 4)
+        {
+            memcpy(dst, texels, 16);
+        }
+        else
+        {
+            uint32_t words[3] = { (texels[0] & 0xffffff) | (texels[1] << 24),
+                                  ((texels[1] >> 8) & 0xffff) | (texels[2] << 16),
+                                  ((texels[2] >> 16) & 0xff) | (texels[3] << 8) };
+            memcpy(dst, words, 12);
+        }
+    }
+}
+
+template<uint32_t kChannels>
+void DecodeDxt1Rows(uint8_t* dst_image_buffer, uint32_t w, uint32_t h, const uint8_t* dxt_src,
+                    bool bgr_order, bool flip_y, uint32_t begin_row, uint32_t end_row)
+{
+    uint32_t block_w = (w + 3) / 4;
+    ptrdiff_t pitch = ptrdiff_t(w) * ptrdiff_t(kChannels);
+
+    for (uint32_t b_y = begin_row; b_y < end_row; b_y++)
+    {
+        uint32_t y = b_y * 4;
+        uint32_t rows = min(h - y, 4u);
+        uint8_t* dst_row = dst_image_buffer + (flip_y ? ptrdiff_t(h - 1 - y) : ptrdiff_t(y)) * pitch;
+        const uint8_t* src_row = dxt_src + size_t(b_y) * block_w * 8;
+
+        for (uint32_t b_x = 0; b_x < block_w; b_x++)
+        {
+            StoreDxt1Block<kChannels>(src_row + b_x * 8, dst_row + ptrdiff_t(b_x) * 4 * kChannels, flip_y ? -pitch : pitch,
+                                      min(w - b_x * 4, 4u), rows, bgr_order);
+        }
+    }
+}
+}
+
+void Dxt1Convertor::DecodeDxt1Image(uint8_t* dst_image_buffer, uint32_t w, uint32_t h, const uint8_t* dxt_src,
+                                    uint32_t channel_count, bool bgr_order, bool flip_y)
+{
+    ParallelFor((h + 3) / 4, 16, [&](size_t begin, size_t end)
+    {
+        if (channel_count == 4)
+        {
+            DecodeDxt1Rows<4>(dst_image_buffer, w, h, dxt_src, bgr_order, flip_y, uint32_t(begin), uint32_t(end));
+        }
+        else
+        {
+            DecodeDxt1Rows<3>(dst_image_buffer, w, h, dxt_src, bgr_order, flip_y, uint32_t(begin), uint32_t(end));
+        }
+    });
+}
+
+void Dxt1Convertor::DecodeDxt1Block(uint32_t* dst_iamge_buffer, uint32_t x, uint32_t y, uint32_t w, const uint8_t* dxt_block)
+{
+    uint32_t color8[4];
+    DecodeDxt1Palette(dxt_block, color8);
 
     uint32_t index_list = dxt_block[4] | (uint32_t(dxt_block[5]) << 8) | (uint32_t(dxt_block[6]) << 16) | (uint32_t(dxt_block[7]) << 24);
     for (uint32_t b_y = 0; b_y < 4; b_y++)
@@ -235,7 +425,8 @@ void ExportBmpImageFile(const core::Texture2DInfo* texture_info, core::TextureFi
     if (decode_dds)
     {
         tmp_image_buffer = new uint32_t[w * h];
-        Dxt1Convertor::DecodeDxt1Texture(tmp_image_buffer, w, h, reinterpret_cast<uint8_t*>(texture_info->m_mips[0].m_imageData.get()));
+        Dxt1Convertor::DecodeDxt1Image(reinterpret_cast<uint8_t*>(tmp_image_buffer), w, h,
+                                       reinterpret_cast<uint8_t*>(texture_info->m_mips[0].m_imageData.get()), 4, true, false);
     }
 
     uint32_t file_size = sizeof(BmpHeader) + sizeof(DIBHeader) + buffer_size;
@@ -277,14 +468,17 @@ void ExportDdsImageFile(const core::Texture2DInfo* texture_info, core::TextureFi
     if (texture_info->m_format == kGLCmpsdRgbS3tcDxt1Ext ||
         texture_info->m_format == kGLCmpsdRgbaS3tcDxt1Ext ||
         texture_info->m_format == kGLCmpsdRgbaS3tcDxt3Ext ||
-        texture_info->m_format == kGLCmpsdRgbaS3tcDxt5Ext)
+        texture_info->m_format == kGLCmpsdRgbaS3tcDxt5Ext ||
+        texture_info->m_format == kGlCmpsdRedRgtc1 ||
+        texture_info->m_format == kGlCmpsdRgRgtc2 ||
+        texture_info->m_format == kGlCmpsdRgbaBptcUnorm)
         is_compressed_texture = true;
 
     uint32_t block_size = 16;
 
     DdsHeaderInfo dds_header;
     DdsHeader& header = dds_header.header;
-    //DdsHeaderDx10& header10 = dds_header.header10;
+    DdsHeaderDx10& header10 = dds_header.header10;
 
     header.dwReserved2 = 0;
     memset(header.dwReserved1, 0, sizeof(header.dwReserved1));
@@ -320,6 +514,21 @@ void ExportDdsImageFile(const core::Texture2DInfo* texture_info, core::TextureFi
     {
         header.ddspf = DdsPixelFormat(kFourCcDxt5);
     }
+    else if (texture_info->m_format == kGlCmpsdRedRgtc1 ||
+             texture_info->m_format == kGlCmpsdRgRgtc2 ||
+             texture_info->m_format == kGlCmpsdRgbaBptcUnorm)
+    {
+        // no fourcc for these, described by the dx10 header.
+        header.ddspf = DdsPixelFormat(kFourCcDx10);
+        header10.dxgiFormat = texture_info->m_format == kGlCmpsdRedRgtc1 ? kDxgiBc4Unorm :
+                              (texture_info->m_format == kGlCmpsdRgRgtc2 ? kDxgiBc5Unorm : kDxgiBc7Unorm);
+        header10.resourceDimension = kDdsDimensionTexture2D;
+        header10.miscFlag = 0;
+        header10.arraySize = 1;
+        header10.miscFlags2 = texture_info->m_format == kGlCmpsdRgbaBptcUnorm ? kDdsAlphaModeStraight : kDdsAlphaModeOpaque;
+        block_size = texture_info->m_format == kGlCmpsdRedRgtc1 ? 8 : 16;
+        need_dx10_header = true;
+    }
     else
     {
         // new texture format.
@@ -373,5 +582,395 @@ void ExportDdsImageFile(const core::Texture2DInfo* texture_info, core::TextureFi
         mem_ofs += texture_info->m_mips[i].m_size;
     }
 }
+
+namespace
+{
+constexpr float kKaiserAlpha = 4.0f;
+constexpr float kKaiserLobes = 3.0f;
+
+// bytes per 4x4 block, 0 for uncompressed formats.
+uint32_t GetCompressedBlockSize(uint32_t format)
+{
+    BlockFormat block_format;
+    if (format == kGLCmpsdRgbaS3tcDxt3Ext)
+    {
+        return 16;
+    }
+    return GetGlBlockFormat(format, block_format) ? GetBlockFormatSize(block_format) : 0;
+}
+
+float SrgbToLinear(float c)
+{
+    return c <= 0.04045f ? c / 12.92f : pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+uint8_t LinearToSrgb8(float c)
+{
+    c = min(max(c, 0.0f), 1.0f);
+    float s = c <= 0.0031308f ? c * 12.92f : 1.055f * pow(c, 1.0f / 2.4f) - 0.055f;
+    return uint8_t(s * 255.0f + 0.5f);
+}
+
+uint8_t LinearToUnorm8(float c)
+{
+    return uint8_t(min(max(c, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+// 16 rgba texels of one dxt3 block, the color half is always 4 color.
+void DecodeDxt3Block(const uint8_t* block, uint8_t texels[64])
+{
+    uint32_t palette[4];
+    DecodeDxt1Palette(block + 8, palette, true);
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        uint32_t c = palette[(block[12 + i / 4] >> (2 * (i & 3))) & 0x03];
+        texels[i * 4 + 0] = uint8_t(c >> 16);
+        texels[i * 4 + 1] = uint8_t(c >> 8);
+        texels[i * 4 + 2] = uint8_t(c);
+        texels[i * 4 + 3] = uint8_t(((block[i / 2] >> ((i & 1) * 4)) & 0x0f) * 17);
+    }
+}
+
+// explicit 4 bit alpha half of the dxt3 block at (b_x, b_y), edge texels repeat.
+void EncodeDxt3AlphaBlock(const uint8_t* rgba_data, uint32_t w, uint32_t h, uint32_t b_x, uint32_t b_y, uint8_t* block)
+{
+    memset(block, 0, 8);
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        uint32_t x = min(b_x * 4 + (i & 3), w - 1);
+        uint32_t y = min(b_y * 4 + i / 4, h - 1);
+        uint32_t a = (uint32_t(rgba_data[(size_t(y) * w + x) * 4 + 3]) * 15 + 127) / 255;
+        block[i / 2] |= uint8_t(a << ((i & 1) * 4));
+    }
+}
+
+// dst sample x takes the weighted sum of src[first[x] + k] * weights[first[x] + k].
+struct FilterTaps
+{
+    vector<uint32_t>    offsets;    // dst_size + 1 entries into indices/weights
+    vector<uint32_t>    indices;
+    vector<float>       weights;
+};
+
+float KaiserBessel0(float x)
+{
+    // power series of the modified bessel function of the first kind, order 0.
+    float sum = 1.0f, term = 1.0f;
+    for (int k = 1; k < 20; k++)
+    {
+        term *= (x / (2.0f * k)) * (x / (2.0f * k));
+        sum += term;
+    }
+    return sum;
 }
 
+float KaiserSincWeight(float t)
+{
+    if (abs(t) >= kKaiserLobes)
+    {
+        return 0.0f;
+    }
+
+    float sinc = t == 0.0f ? 1.0f : float(sin(PI * double(t)) / (PI * double(t)));
+    float r = t / kKaiserLobes;
+    return sinc * KaiserBessel0(kKaiserAlpha * sqrt(1.0f - r * r)) / KaiserBessel0(kKaiserAlpha);
+}
+
+void BuildFilterTaps(uint32_t src_size, uint32_t dst_size, MipFilter filter, FilterTaps& taps)
+{
+    double scale = double(src_size) / double(dst_size);
+    double radius = filter == kMipFilterBox ? 0.5 * scale : double(kKaiserLobes) * scale;
+
+    taps.offsets.assign(1, 0);
+    taps.indices.clear();
+    taps.weights.clear();
+
+    for (uint32_t x = 0; x < dst_size; x++)
+    {
+        double center = (x + 0.5) * scale;
+        int32_t lo = int32_t(floor(center - radius));
+        int32_t hi = int32_t(ceil(center + radius));
+        size_t first = taps.weights.size();
+        float sum = 0.0f;
+
+        for (int32_t s = lo; s < hi; s++)
+        {
+            float w;
+            if (filter == kMipFilterBox)
+            {
+                w = float(max(0.0, min(double(s + 1), center + radius) - max(double(s), center - radius)));
+            }
+            else
+            {
+                w = KaiserSincWeight(float((s + 0.5 - center) / scale));
+            }
+
+            if (w == 0.0f)
+            {
+                continue;
+            }
+
+            // clamp to edge, fold the weight into the border sample.
+            uint32_t idx = uint32_t(min(max(s, 0), int32_t(src_size) - 1));
+            if (taps.weights.size() > first && taps.indices.back() == idx)
+            {
+                taps.weights.back() += w;
+            }
+            else
+            {
+                taps.indices.push_back(idx);
+                taps.weights.push_back(w);
+            }
+            sum += w;
+        }
+
+        for (size_t i = first; i < taps.weights.size(); i++)
+        {
+            taps.weights[i] /= sum;
+        }
+        taps.offsets.push_back(uint32_t(taps.weights.size()));
+    }
+}
+
+// separable resize of a 4 channel float image.
+void ResampleLevel(const vector<float>& src, uint32_t src_w, uint32_t src_h,
+                   vector<float>& dst, uint32_t dst_w, uint32_t dst_h, MipFilter filter)
+{
+    FilterTaps taps_x, taps_y;
+    BuildFilterTaps(src_w, dst_w, filter, taps_x);
+    BuildFilterTaps(src_h, dst_h, filter, taps_y);
+
+    vector<float> tmp(size_t(dst_w) * src_h * 4);
+    ParallelFor(src_h, 64, [&](size_t begin, size_t end)
+    {
+        for (size_t y = begin; y < end; y++)
+        {
+            const float* src_row = &src[y * src_w * 4];
+            float* tmp_row = &tmp[y * dst_w * 4];
+            for (uint32_t x = 0; x < dst_w; x++)
+            {
+                float c[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+                for (uint32_t k = taps_x.offsets[x]; k < taps_x.offsets[x + 1]; k++)
+                {
+                    const float* p = &src_row[taps_x.indices[k] * 4];
+                    float w = taps_x.weights[k];
+                    c[0] += p[0] * w; c[1] += p[1] * w; c[2] += p[2] * w; c[3] += p[3] * w;
+                }
+                memcpy(&tmp_row[x * 4], c, sizeof(c));
+            }
+        }
+    });
+
+    dst.resize(size_t(dst_w) * dst_h * 4);
+    ParallelFor(dst_h, 64, [&](size_t begin, size_t end)
+    {
+        for (size_t y = begin; y < end; y++)
+        {
+            float* dst_row = &dst[y * dst_w * 4];
+            memset(dst_row, 0, dst_w * 4 * sizeof(float));
+            for (uint32_t k = taps_y.offsets[y]; k < taps_y.offsets[y + 1]; k++)
+            {
+                const float* tmp_row = &tmp[size_t(taps_y.indices[k]) * dst_w * 4];
+                float w = taps_y.weights[k];
+                for (uint32_t i = 0; i < dst_w * 4; i++)
+                {
+                    dst_row[i] += tmp_row[i] * w;
+                }
+            }
+        }
+    });
+}
+
+// encode a float level into m_mips[level] of texture_info in the texture's format.
+void EncodeLevel(const vector<float>& linear, uint32_t w, uint32_t h, bool srgb, core::Texture2DInfo* texture_info, uint32_t level)
+{
+    uint32_t format = texture_info->m_format;
+    uint32_t block_size = GetCompressedBlockSize(format);
+    uint32_t channel_count = format == kGlRgb ? 3 : 4;
+
+    Texture2DSurfaceInfo& mip = texture_info->m_mips[level];
+    mip.m_width = w;
+    mip.m_height = h;
+    mip.m_size = block_size ? ((w + 3) / 4) * ((h + 3) / 4) * block_size : w * h * channel_count;
+    mip.m_imageData = make_unique<char[]>(mip.m_size);
+    uint8_t* dst = reinterpret_cast<uint8_t*>(mip.m_imageData.get());
+
+    // uncompressed levels are quantized in place, the rest through an rgba8 copy.
+    vector<uint8_t> rgba_data(block_size ? size_t(w) * h * 4 : 0);
+    uint8_t* quantized = block_size ? rgba_data.data() : dst;
+    ParallelFor(h, 16, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin * w; i < end * w; i++)
+        {
+            const float* p = &linear[i * 4];
+            uint8_t* q = &quantized[i * channel_count];
+            for (uint32_t k = 0; k < 3; k++)
+            {
+                q[k] = srgb ? LinearToSrgb8(p[k]) : LinearToUnorm8(p[k]);
+            }
+            if (channel_count == 4)
+            {
+                q[3] = LinearToUnorm8(p[3]);
+            }
+        }
+    });
+
+    if (block_size == 0)
+    {
+        return;
+    }
+
+    BlockFormat block_format;
+    if (GetGlBlockFormat(format, block_format))
+    {
+        CompressBlockImage(rgba_data.data(), w, h, block_format, dst);
+        return;
+    }
+
+    // dxt3 shares the dxt5 color half, only the alpha half is rewritten.
+    CompressBlockImage(rgba_data.data(), w, h, kBlockFormatBc3, dst);
+    uint32_t block_w = (w + 3) / 4;
+    for (uint32_t b_y = 0; b_y < (h + 3) / 4; b_y++)
+    {
+        for (uint32_t b_x = 0; b_x < block_w; b_x++)
+        {
+            EncodeDxt3AlphaBlock(rgba_data.data(), w, h, b_x, b_y, dst + (b_y * block_w + b_x) * block_size);
+        }
+    }
+}
+}
+
+bool DecodeTextureLevel(const core::Texture2DInfo* texture_info, uint32_t level, vector<uint8_t>& rgba_data)
+{
+    if (level >= texture_info->m_levelCount || !texture_info->m_mips[level].m_imageData)
+    {
+        return false;
+    }
+
+    const Texture2DSurfaceInfo& mip = texture_info->m_mips[level];
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(mip.m_imageData.get());
+    uint32_t w = mip.m_width;
+    uint32_t h = mip.m_height;
+    uint32_t format = texture_info->m_format;
+    rgba_data.resize(size_t(w) * h * 4);
+
+    uint32_t block_size = GetCompressedBlockSize(format);
+    if (block_size)
+    {
+        uint32_t block_w = (w + 3) / 4;
+        if (mip.m_size < block_w * ((h + 3) / 4) * block_size)
+        {
+            return false;
+        }
+
+        // dxt1 keeps the decoder the viewer and the exporters use.
+        if (format == kGLCmpsdRgbS3tcDxt1Ext || format == kGLCmpsdRgbaS3tcDxt1Ext)
+        {
+            Dxt1Convertor::DecodeDxt1Image(rgba_data.data(), w, h, src, 4, false, false);
+            return true;
+        }
+
+        BlockFormat block_format;
+        if (GetGlBlockFormat(format, block_format))
+        {
+            return DecompressBlockImage(src, w, h, block_format, rgba_data.data());
+        }
+
+        ParallelFor((h + 3) / 4, 16, [&](size_t begin, size_t end)
+        {
+            uint8_t texels[64];
+            for (size_t b_y = begin; b_y < end; b_y++)
+            {
+                for (uint32_t b_x = 0; b_x < block_w; b_x++)
+                {
+                    DecodeDxt3Block(src + (b_y * block_w + b_x) * block_size, texels);
+                    for (uint32_t y = 0; y < 4 && b_y * 4 + y < h; y++)
+                    {
+                        uint32_t cols = min(4u, w - b_x * 4);
+                        memcpy(&rgba_data[((b_y * 4 + y) * w + b_x * 4) * 4], &texels[y * 16], cols * 4);
+                    }
+                }
+            }
+        });
+        return true;
+    }
+
+    if ((format == kGlRgb || format == kGlRgba) && (texture_info->m_type == kGlUByte || texture_info->m_type == 0))
+    {
+        uint32_t channel_count = format == kGlRgb ? 3 : 4;
+        if (mip.m_size < w * h * channel_count)
+        {
+            return false;
+        }
+
+        for (size_t i = 0; i < size_t(w) * h; i++)
+        {
+            rgba_data[i * 4 + 0] = src[i * channel_count + 0];
+            rgba_data[i * 4 + 1] = src[i * channel_count + 1];
+            rgba_data[i * 4 + 2] = src[i * channel_count + 2];
+            rgba_data[i * 4 + 3] = channel_count == 4 ? src[i * 4 + 3] : 255;
+        }
+        return true;
+    }
+
+    return false;
+}
+
+bool BuildMipChain(const core::Texture2DInfo* src_info, core::Texture2DInfo* dst_info, MipFilter filter/* = kMipFilterKaiser*/)
+{
+    vector<uint8_t> rgba_data;
+    if (!DecodeTextureLevel(src_info, 0, rgba_data))
+    {
+        return false;
+    }
+
+    const Texture2DSurfaceInfo& src_mip = src_info->m_mips[0];
+    dst_info->m_objectId = src_info->m_objectId;
+    dst_info->m_internalFormat = src_info->m_internalFormat;
+    dst_info->m_format = src_info->m_format;
+    dst_info->m_type = src_info->m_type;
+    dst_info->m_mips[0].m_width = src_mip.m_width;
+    dst_info->m_mips[0].m_height = src_mip.m_height;
+    dst_info->m_mips[0].m_size = src_mip.m_size;
+    dst_info->m_mips[0].m_imageData = make_unique<char[]>(src_mip.m_size);
+    memcpy(dst_info->m_mips[0].m_imageData.get(), src_mip.m_imageData.get(), src_mip.m_size);
+
+    // bc4/bc5 hold heights and normals, not colors.
+    bool srgb = src_info->m_format != kGlCmpsdRedRgtc1 && src_info->m_format != kGlCmpsdRgRgtc2;
+    float to_linear[256];
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        to_linear[i] = srgb ? SrgbToLinear(i / 255.0f) : i / 255.0f;
+    }
+
+    uint32_t w = src_mip.m_width;
+    uint32_t h = src_mip.m_height;
+    vector<float> linear(size_t(w) * h * 4);
+    for (size_t i = 0; i < size_t(w) * h; i++)
+    {
+        linear[i * 4 + 0] = to_linear[rgba_data[i * 4 + 0]];
+        linear[i * 4 + 1] = to_linear[rgba_data[i * 4 + 1]];
+        linear[i * 4 + 2] = to_linear[rgba_data[i * 4 + 2]];
+        linear[i * 4 + 3] = rgba_data[i * 4 + 3] / 255.0f;
+    }
+
+    uint32_t level_count = 1;
+    vector<float> next_level;
+    while ((w > 1 || h > 1) && level_count < 15)
+    {
+        uint32_t next_w = max(w / 2, 1u);
+        uint32_t next_h = max(h / 2, 1u);
+        ResampleLevel(linear, w, h, next_level, next_w, next_h, filter);
+        EncodeLevel(next_level, next_w, next_h, srgb, dst_info, level_count);
+
+        linear.swap(next_level);
+        w = next_w;
+        h = next_h;
+        level_count++;
+    }
+
+    dst_info->m_levelCount = level_count;
+    return true;
+}
+
+}
@@ -0,0 +1,514 @@
+#include "elevationgrid.h"
+#include "boundsgrid.h"
+#include "hfa/hfa_p.h"
+#include "hfa/hfa.h"
+
+namespace
+{
+// bilinear lookups straddle up to 4 blocks, fewer than that would thrash whatever the budget.
+constexpr size_t kMinCachedBlocks = 4;
+
+uint64_t GetBlockKey(uint32_t grid_id, int block_idx)
+{
+    return uint64_t(grid_id) << 32 | uint32_t(block_idx);
+}
+}
+
+ElevationBlockCache::ElevationBlockCache(size_t memory_cap/* = kDefaultElevationCacheSize*/) :
+    memory_cap_(memory_cap),
+    memory_used_(0),
+    next_grid_id_(0),
+    num_evictions_(0)
+{
+}
+
+float* ElevationBlockCache::find(uint32_t grid_id, int block_idx)
+{
+    auto it = block_lookup_.find(GetBlockKey(grid_id, block_idx));
+    if (it == block_lookup_.end())
+    {
+        return nullptr;
+    }
+
+    // move to the front, most recently used.
+    cached_blocks_.splice(cached_blocks_.begin(), cached_blocks_, it->second);
+    return cached_blocks_.front().height_list.get();
+}
+
+float* ElevationBlockCache::insert(uint32_t grid_id, int block_idx, size_t num_heights)
+{
+    // evict the least recently used blocks, the memory of one the same size is reused.
+    unique_ptr<float[]> height_list;
+    size_t num_bytes = num_heights * sizeof(float);
+    while (cached_blocks_.size() >= kMinCachedBlocks && memory_used_ + num_bytes > memory_cap_)
+    {
+        CachedBlock& lru_block = cached_blocks_.back();
+        block_lookup_.erase(lru_block.key);
+        memory_used_ -= lru_block.num_heights * sizeof(float);
+        if (lru_block.num_heights == num_heights)
+        {
+            height_list = move(lru_block.height_list);
+        }
+        cached_blocks_.pop_back();
+        num_evictions_++;
+    }
+
+    if (!height_list)
+    {
+        height_list = make_unique<float[]>(num_heights);
+    }
+
+    CachedBlock block;
+    block.key = GetBlockKey(grid_id, block_idx);
+    block.num_heights = num_heights;
+    block.height_list = move(height_list);
+    cached_blocks_.push_front(move(block));
+    block_lookup_[cached_blocks_.front().key] = cached_blocks_.begin();
+    memory_used_ += num_bytes;
+
+    return cached_blocks_.front().height_list.get();
+}
+
+void ElevationBlockCache::erase(uint32_t grid_id)
+{
+    for (auto it = cached_blocks_.begin(); it != cached_blocks_.end();)
+    {
+        if (uint32_t(it->key >> 32) == grid_id)
+        {
+            block_lookup_.erase(it->key);
+            memory_used_ -= it->num_heights * sizeof(float);
+            it = cached_blocks_.erase(it);
+            num_evictions_++;
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void ElevationBlockCache::clear()
+{
+    cached_blocks_.clear();
+    block_lookup_.clear();
+    memory_used_ = 0;
+    num_evictions_++;
+}
+
+ElevationGrid::ElevationGrid() : hfa_handle_(nullptr),
+                                 band_(nullptr),
+                                 x_size_(0),
+                                 y_size_(0),
+                                 block_x_size_(1),
+                                 block_y_size_(1),
+                                 blocks_per_row_(0),
+                                 blocks_per_column_(0),
+                                 grid_id_(0),
+                                 last_block_idx_(-1),
+                                 last_block_(nullptr),
+                                 last_num_evictions_(0),
+                                 num_block_loads_(0)
+{
+}
+
+ElevationGrid::~ElevationGrid()
+{
+    close();
+}
+
+bool ElevationGrid::open(const string& file_name, int band_idx, const shared_ptr<ElevationBlockCache>& cache/* = nullptr*/)
+{
+    close();
+
+    HFAHandle h_hfa = HFAOpen(file_name.c_str(), "r");
+    if (!h_hfa)
+    {
+        return false;
+    }
+
+    int n_x_size, n_y_size, n_bands;
+    HFAGetRasterInfo(h_hfa, &n_x_size, &n_y_size, &n_bands);
+
+    int n_data_type, n_block_x_size, n_block_y_size, n_overviews, n_compression_type;
+    if (band_idx < 1 || band_idx > n_bands ||
+        HFAGetBandInfo(h_hfa, band_idx, &n_data_type, &n_block_x_size, &n_block_y_size,
+                       &n_overviews, &n_compression_type) != CE_None ||
+        n_data_type != EPT_f32)
+    {
+        HFAClose(h_hfa);
+        return false;
+    }
+
+    hfa_handle_ = h_hfa;
+    band_ = h_hfa->papoBand[band_idx - 1];
+    x_size_ = n_x_size;
+    y_size_ = n_y_size;
+    block_x_size_ = n_block_x_size;
+    block_y_size_ = n_block_y_size;
+    blocks_per_row_ = (n_x_size + n_block_x_size - 1) / n_block_x_size;
+    blocks_per_column_ = (n_y_size + n_block_y_size - 1) / n_block_y_size;
+
+    cache_ = cache ? cache : make_shared<ElevationBlockCache>();
+    grid_id_ = cache_->add_grid();
+
+    return true;
+}
+
+void ElevationGrid::close()
+{
+    flush();
+
+    if (hfa_handle_)
+    {
+        HFAClose(HFAHandle(hfa_handle_));
+        hfa_handle_ = nullptr;
+    }
+
+    band_ = nullptr;
+    cache_.reset();
+    x_size_ = y_size_ = 0;
+    blocks_per_row_ = blocks_per_column_ = 0;
+    num_block_loads_ = 0;
+}
+
+void ElevationGrid::flush()
+{
+    if (cache_)
+    {
+        cache_->erase(grid_id_);
+    }
+    last_block_ = nullptr;
+}
+
+const float* ElevationGrid::load_block(int b_x, int b_y)
+{
+    int block_idx = b_y * blocks_per_row_ + b_x;
+
+    float* height_list = cache_->find(grid_id_, block_idx);
+    if (!height_list)
+    {
+        size_t num_heights = size_t(block_x_size_) * size_t(block_y_size_);
+        height_list = cache_->insert(grid_id_, block_idx, num_heights);
+        if (band_->GetRasterBlock(b_x, b_y, height_list) == CE_Failure)
+        {
+            memset(height_list, 0, num_heights * sizeof(float));
+        }
+        num_block_loads_++;
+    }
+
+    last_block_idx_ = block_idx;
+    last_block_ = height_list;
+    last_num_evictions_ = cache_->get_num_evictions();
+    return height_list;
+}
+
+namespace
+{
+// pixel coordinates this close to a whole number are taken as a lattice node.
+constexpr double kLatticeSnapTolerance = 1e-6;
+
+double SnapToLattice(double v)
+{
+    double r = round(v);
+    return fabs(v - r) < kLatticeSnapTolerance ? r : v;
+}
+
+// split the overlap of two node ranges on one axis, a one node gap counts as touching
+// and the lower tile reaches over it. a tile inside the other's range is left alone.
+// a tile only gives up nodes where the other spans all of its rows (or columns), or
+// the part it gave up would be meshed by nobody: if only one of them spans the
+// other's, the spanning one keeps the whole overlap.
+void SplitOverlap(int& lo_max, int& hi_min, int lo_tile_max, int hi_tile_min, int hi_tile_max,
+                  bool hi_spans_lo, bool lo_spans_hi)
+{
+    if (hi_tile_min > lo_tile_max + 1 || hi_tile_max <= lo_tile_max)
+    {
+        return;
+    }
+
+    if (hi_tile_min == lo_tile_max + 1)
+    {
+        if (hi_spans_lo)
+        {
+            lo_max = max(lo_max, hi_tile_min);
+        }
+        else
+        {
+            hi_min = min(hi_min, lo_tile_max);
+        }
+        return;
+    }
+
+    if (hi_spans_lo && lo_spans_hi)
+    {
+        int mid = (hi_tile_min + lo_tile_max) / 2;
+        lo_max = min(lo_max, mid);
+        hi_min = max(hi_min, mid);
+    }
+    else if (hi_spans_lo)
+    {
+        lo_max = min(lo_max, hi_tile_min);
+    }
+    else
+    {
+        hi_min = max(hi_min, lo_tile_max);
+    }
+}
+}
+
+ElevationMosaic::ElevationMosaic(size_t memory_cap/* = kDefaultElevationCacheSize*/) :
+    origin_(0.0, 0.0),
+    pixel_size_(1.0, 1.0),
+    feather_size_(kDefaultElevationFeatherSize),
+    cache_(make_shared<ElevationBlockCache>(memory_cap))
+{
+}
+
+ElevationMosaic::~ElevationMosaic()
+{
+}
+
+size_t ElevationMosaic::add_tile(const shared_ptr<ElevationGrid>& grid, const core::vec2d& ul_corner, const core::vec2d& pixel_size)
+{
+    if (tiles_.empty())
+    {
+        origin_ = ul_corner;
+        pixel_size_ = pixel_size;
+    }
+
+    Tile tile;
+    tile.grid = grid;
+    tile.ul_corner = ul_corner;
+    tile.pixel_size = pixel_size;
+    tile.pixel_count = core::vec2i(grid->get_x_size(), grid->get_y_size());
+
+    core::vec2d ofs = (ul_corner - origin_) / pixel_size_;
+    tile.lattice_ofs = core::vec2i(int32_t(round(ofs.x)), int32_t(round(ofs.y)));
+    tile.aligned = fabs(pixel_size.x - pixel_size_.x) <= fabs(pixel_size_.x) * kLatticeSnapTolerance &&
+                   fabs(pixel_size.y - pixel_size_.y) <= fabs(pixel_size_.y) * kLatticeSnapTolerance &&
+                   fabs(ofs.x - tile.lattice_ofs.x) < 1e-3 && fabs(ofs.y - tile.lattice_ofs.y) < 1e-3;
+    tile.owned_min = tile.lattice_ofs;
+    tile.owned_max = tile.lattice_ofs + tile.pixel_count - 1;
+
+    tiles_.push_back(move(tile));
+    return tiles_.size() - 1;
+}
+
+void ElevationMosaic::build(double feather_size/* = kDefaultElevationFeatherSize*/)
+{
+    feather_size_ = max(feather_size, 1.0);
+
+    for (auto& tile : tiles_)
+    {
+        tile.owned_min = tile.lattice_ofs;
+        tile.owned_max = tile.lattice_ofs + tile.pixel_count - 1;
+    }
+
+    for (size_t i = 0; i < tiles_.size(); i++)
+    {
+        for (size_t j = i + 1; j < tiles_.size(); j++)
+        {
+            Tile& a = tiles_[i];
+            Tile& b = tiles_[j];
+            if (!a.aligned || !b.aligned)
+            {
+                continue;
+            }
+
+            core::vec2i a_max = a.lattice_ofs + a.pixel_count - 1;
+            core::vec2i b_max = b.lattice_ofs + b.pixel_count - 1;
+            int overlap_x = min(a_max.x, b_max.x) - max(a.lattice_ofs.x, b.lattice_ofs.x) + 1;
+            int overlap_y = min(a_max.y, b_max.y) - max(a.lattice_ofs.y, b.lattice_ofs.y) + 1;
+            if (overlap_x < 0 || overlap_y < 0 || (overlap_x == 0 && overlap_y == 0))
+            {
+                continue;
+            }
+
+            // neighbours along the axis of the thinner overlap. diagonal neighbours, neither
+            // spanning the other across it, are left to the tiles beside them.
+            int axis = overlap_x <= overlap_y ? 0 : 1;
+            int side = 1 - axis;
+            Tile& lo = a.lattice_ofs[axis] <= b.lattice_ofs[axis] ? a : b;
+            Tile& hi = &lo == &a ? b : a;
+            core::vec2i lo_max = lo.lattice_ofs + lo.pixel_count - 1;
+            core::vec2i hi_max = hi.lattice_ofs + hi.pixel_count - 1;
+            bool hi_spans_lo = hi.lattice_ofs[side] <= lo.lattice_ofs[side] && hi_max[side] >= lo_max[side];
+            bool lo_spans_hi = lo.lattice_ofs[side] <= hi.lattice_ofs[side] && lo_max[side] >= hi_max[side];
+            if (!hi_spans_lo && !lo_spans_hi)
+            {
+                continue;
+            }
+
+            SplitOverlap(lo.owned_max[axis], hi.owned_min[axis], lo_max[axis], hi.lattice_ofs[axis], hi_max[axis],
+                         hi_spans_lo, lo_spans_hi);
+        }
+    }
+
+    // half a pixel around the outer pixel centers, so single row rasters have an area too.
+    vector<core::bounds2d> bbox_list(tiles_.size());
+    for (size_t i = 0; i < tiles_.size(); i++)
+    {
+        const Tile& tile = tiles_[i];
+        core::vec2d half_pixel = core::vec2d(fabs(tile.pixel_size.x), fabs(tile.pixel_size.y)) * 0.5;
+        bbox_list[i] += tile.ul_corner;
+        bbox_list[i] += tile.ul_corner + tile.pixel_size * core::vec2d(double(tile.pixel_count.x - 1), double(tile.pixel_count.y - 1));
+        bbox_list[i].bb_min -= half_pixel;
+        bbox_list[i].bb_max += half_pixel;
+    }
+
+    tile_index_ = make_unique<BoundsGridIndex>(BoundsGridIndex::suggest_cell_size(bbox_list));
+    for (const auto& bbox : bbox_list)
+    {
+        tile_index_->add(bbox);
+    }
+}
+
+void ElevationMosaic::clear()
+{
+    tiles_.clear();
+    tile_index_.reset();
+}
+
+void ElevationMosaic::flush()
+{
+    for (auto& tile : tiles_)
+    {
+        tile.grid->flush();
+    }
+}
+
+core::vec2d ElevationMosaic::snap_to_lattice(const core::vec2d& s)
+{
+    return core::vec2d(SnapToLattice(s.x), SnapToLattice(s.y));
+}
+
+core::bounds2d ElevationMosaic::get_owned_pixel_bounds(size_t tile_idx) const
+{
+    const Tile& tile = tiles_[tile_idx];
+    core::bounds2d bbox;
+    bbox += core::vec2d(double(tile.owned_min.x - tile.lattice_ofs.x), double(tile.owned_min.y - tile.lattice_ofs.y));
+    bbox += core::vec2d(double(tile.owned_max.x - tile.lattice_ofs.x), double(tile.owned_max.y - tile.lattice_ofs.y));
+    return bbox;
+}
+
+core::vec2d ElevationMosaic::get_position(size_t tile_idx, const core::vec2d& s) const
+{
+    const Tile& tile = tiles_[tile_idx];
+    core::vec2d snapped = snap_to_lattice(s);
+    if (!tile.aligned)
+    {
+        return tile.ul_corner + tile.pixel_size * snapped;
+    }
+
+    return origin_ + pixel_size_ * (snapped + core::vec2d(double(tile.lattice_ofs.x), double(tile.lattice_ofs.y)));
+}
+
+core::bounds2d ElevationMosaic::get_bounds() const
+{
+    core::bounds2d bbox;
+    for (const auto& tile : tiles_)
+    {
+        bbox += tile.ul_corner;
+        bbox += tile.ul_corner + tile.pixel_size * core::vec2d(double(tile.pixel_count.x - 1), double(tile.pixel_count.y - 1));
+    }
+    return bbox;
+}
+
+const vector<uint32_t>& ElevationMosaic::find_tiles(const core::vec2d& pos) const
+{
+    if (!tile_index_)
+    {
+        candidate_list_.resize(tiles_.size());
+        for (uint32_t i = 0; i < uint32_t(tiles_.size()); i++)
+        {
+            candidate_list_[i] = i;
+        }
+        return candidate_list_;
+    }
+
+    // a box of no size has no overlap with an area, query a sliver of a pixel around pos.
+    core::vec2d eps = core::vec2d(fabs(pixel_size_.x), fabs(pixel_size_.y)) * 1e-3;
+    core::bounds2d bbox;
+    bbox += pos - eps;
+    bbox += pos + eps;
+    tile_index_->query(bbox, candidate_list_);
+    return candidate_list_;
+}
+
+bool ElevationMosaic::contains(const core::vec2d& pos) const
+{
+    for (uint32_t tile_idx : find_tiles(pos))
+    {
+        const Tile& tile = tiles_[tile_idx];
+        core::vec2d s = snap_to_lattice((pos - tile.ul_corner) / tile.pixel_size);
+        if (s.x >= 0.0 && s.y >= 0.0 && s.x <= double(tile.pixel_count.x - 1) && s.y <= double(tile.pixel_count.y - 1))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+float ElevationMosaic::lookup_height(Tile& tile, const core::vec2d& s) const
+{
+    int x_low = int32_t(floor(s.x));
+    int y_low = int32_t(floor(s.y));
+    ElevationGrid& grid = *tile.grid;
+
+    float h_00 = grid.get_height(x_low, y_low);
+    float h_01 = grid.get_height(x_low + 1, y_low);
+    float h_10 = grid.get_height(x_low, y_low + 1);
+    float h_11 = grid.get_height(x_low + 1, y_low + 1);
+
+    float s_x_ofs = float(s.x - double(x_low));
+    float s_y_ofs = float(s.y - double(y_low));
+
+    h_00 = h_00 * (1.0f - s_x_ofs) + h_01 * s_x_ofs;
+    h_10 = h_10 * (1.0f - s_x_ofs) + h_11 * s_x_ofs;
+    return h_00 * (1.0f - s_y_ofs) + h_10 * s_y_ofs;
+}
+
+float ElevationMosaic::get_height(const core::vec2d& pos)
+{
+    double sum_weight = 0.0;
+    double sum_height = 0.0;
+    for (uint32_t tile_idx : find_tiles(pos))
+    {
+        Tile& tile = tiles_[tile_idx];
+        // positions of nodes on the outer edge may come back a rounding outside.
+        core::vec2d s = snap_to_lattice((pos - tile.ul_corner) / tile.pixel_size);
+        double dist = min(min(s.x, double(tile.pixel_count.x - 1) - s.x),
+                          min(s.y, double(tile.pixel_count.y - 1) - s.y));
+        if (dist >= 0.0)
+        {
+            // a small floor keeps a point on the outer edge of a single raster defined.
+            double weight = min(dist / feather_size_, 1.0) + 1e-6;
+            sum_weight += weight;
+            sum_height += weight * double(lookup_height(tile, s));
+        }
+    }
+
+    if (sum_weight > 0.0)
+    {
+        return float(sum_height / sum_weight);
+    }
+
+    // outside of all rasters, the nearest is searched over every tile.
+    Tile* nearest_tile = nullptr;
+    core::vec2d nearest_s;
+    double nearest_dist = -1e30;
+    for (auto& tile : tiles_)
+    {
+        core::vec2d s = (pos - tile.ul_corner) / tile.pixel_size;
+        double dist = min(min(s.x, double(tile.pixel_count.x - 1) - s.x),
+                          min(s.y, double(tile.pixel_count.y - 1) - s.y));
+        if (dist > nearest_dist)
+        {
+            nearest_dist = dist;
+            nearest_tile = &tile;
+            nearest_s = s;
+        }
+    }
+
+    return nearest_tile ? lookup_height(*nearest_tile, nearest_s) : 0.0f;
+}
@@ -0,0 +1,46 @@
+#-------------------------------------------------
+#
+# gpa frame parser fuzzer. "qmake CONFIG+=libfuzzer" with clang links libfuzzer's
+# driver, otherwise "MeshToolFuzz <file or corpus folder> ..." replays inputs once.
+# corpus/ holds seed frames: an empty one, indexed draws, vertex array state,
+# textures, the capture zone and a truncated frame.
+#
+#-------------------------------------------------
+
+QT       -= core gui
+
+TARGET = MeshToolFuzz
+TEMPLATE = app
+CONFIG += console c++17
+CONFIG -= app_bundle qt
+
+DEFINES += _HAS_STD_BYTE=0
+
+INCLUDEPATH += $$PWD/../../../ThirdParty/geographiclib/include
+INCLUDEPATH += $$PWD/../../../ThirdParty/zlib-1.2.3/
+INCLUDEPATH += $$PWD/../include
+INCLUDEPATH += $$PWD/..
+
+libfuzzer {
+    QMAKE_CXXFLAGS += -fsanitize=fuzzer,address,undefined
+    QMAKE_LFLAGS += -fsanitize=fuzzer,address,undefined
+    DEFINES += MESHTOOL_LIBFUZZER
+}
+
+SOURCES += \
+    gpaframe_fuzz.cpp \
+    ../GpaDumpAnalyzeTool.cpp \
+    ../gpaframe.cpp \
+    ../GlFunctionList.cpp \
+    ../glstate.cpp \
+    ../vertexformat.cpp \
+    ../coretexture.cpp \
+    ../coreblockcodec.cpp \
+    ../corefile.cpp \
+    ../meshdata.cpp \
+    ../meshclip.cpp \
+    ../boundsgrid.cpp \
+    ../coregeographic.cpp
+
+SOURCES += $$files($$PWD/../../../ThirdParty/geographiclib/src/*.cpp)
+SOURCES += $$files($$PWD/../../../ThirdParty/zlib-1.2.11/*.c)
@@ -0,0 +1,116 @@
+#include "gpaframe.h"
+#include "meshdata.h"
+#include "coretexture.h"
+#include "debugout.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <filesystem>
+
+// the parser writes shaders and the capture image under these, a folder that does not
+// exist makes those writes fail instead of filling the disk.
+extern string g_root_folder_name;
+extern string g_shaders_folder_name;
+
+namespace core
+{
+// debugout.cpp needs qt, the fuzzer only needs the messages gone.
+void output_debug_info(const string& category, const string& message)
+{
+    (void)category;
+    (void)message;
+}
+}
+
+namespace
+{
+void FreeGroupMeshData(GroupMeshData& group_mesh_data)
+{
+    for (auto& mesh_data : group_mesh_data.meshes)
+    {
+        SAFE_DELETE(mesh_data);
+    }
+    for (auto& texture : group_mesh_data.loaded_textures)
+    {
+        SAFE_DELETE(texture);
+    }
+}
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    g_root_folder_name = "gpaframe_fuzz_no_output";
+    g_shaders_folder_name = "gpaframe_fuzz_no_output";
+
+    GroupMeshData group_mesh_data;
+    GpaParseReport report;
+    bool b_succeed = ParseGpaFrame(data, size, &group_mesh_data, &report);
+    FreeGroupMeshData(group_mesh_data);
+
+    // the result has to agree with the report, an error must never be dropped.
+    if (b_succeed != report.error_list.empty() || report.num_skipped_zones > report.num_zones)
+    {
+        abort();
+    }
+    return 0;
+}
+
+#ifndef MESHTOOL_LIBFUZZER
+namespace
+{
+bool RunFile(const string& file_name)
+{
+    ifstream file(file_name, ifstream::binary | ifstream::ate);
+    if (!file)
+    {
+        return false;
+    }
+
+    size_t size = size_t(file.tellg());
+    file.seekg(0);
+    // an exact size copy, so a sanitizer build catches reads one past the end.
+    unique_ptr<uint8_t[]> data(new uint8_t[size ? size : 1]);
+    file.read(reinterpret_cast<char*>(data.get()), size);
+    LLVMFuzzerTestOneInput(data.get(), size);
+    return true;
+}
+}
+
+// without libfuzzer, replay the files and corpus folders on the command line once.
+int main(int argc, char** argv)
+{
+    namespace fs = std::filesystem;
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s <file or corpus folder> ...\n", argv[0]);
+        return 1;
+    }
+
+    uint32_t num_files = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        error_code ec;
+        if (fs::is_directory(argv[i], ec))
+        {
+            for (const auto& entry : fs::recursive_directory_iterator(argv[i], ec))
+            {
+                if (entry.is_regular_file(ec) && RunFile(entry.path().string()))
+                {
+                    num_files++;
+                }
+            }
+        }
+        else if (RunFile(argv[i]))
+        {
+            num_files++;
+        }
+        else
+        {
+            fprintf(stderr, "can't read %s\n", argv[i]);
+            return 1;
+        }
+    }
+    printf("%u inputs ran\n", num_files);
+    return 0;
+}
+#endif
@@ -0,0 +1,416 @@
+#include "glstate.h"
+#include "glfunctionlist.h"
+#include <cstring>
+
+namespace
+{
+bool IsBufferTarget(uint32_t target)
+{
+    switch (target)
+    {
+    case kGlArrayBuffer:
+    case kGlAtomicCounterBuffer:
+    case kGlCopyReadBuffer:
+    case kGlCopyWriteBuffer:
+    case kGlDispatchIndirectBuffer:
+    case kGlDrawIndirectBuffer:
+    case kGlElementArrayBuffer:
+    case kGlPixelPackBuffer:
+    case kGlPixelUnpackBuffer:
+    case kGlQueryBuffer:
+    case kGlShaderStorageBuffer:
+    case kGlTextureBuffer:
+    case kGlTransformFeedbackBuffer:
+    case kGlUniformBuffer:
+        return true;
+    }
+    return false;
+}
+
+bool IsTextureTarget(uint32_t target)
+{
+    switch (target)
+    {
+    case kGlTexture1D:
+    case kGlTexture2D:
+    case kGlTexture3DExt:
+    case kGlTextureRectangleExt:
+    case kGlTextureCubemapArb:
+    case kGlTexture1DArrayExt:
+    case kGlTexture2DArrayExt:
+        return true;
+    }
+    return false;
+}
+
+uint64_t GetTextureBindingKey(uint32_t unit, uint32_t target)
+{
+    return (uint64_t(unit) << 32) | target;
+}
+
+// the key of a name, creating the object on first use.
+template <class T>
+uint64_t GetOrCreateObject(const unordered_map<uint32_t, uint32_t>& generation_map, unordered_map<uint64_t, T>& object_map, uint32_t name)
+{
+    auto it = generation_map.find(name);
+    uint64_t key = MakeGlObjectKey(name, it == generation_map.end() ? 0 : it->second);
+    object_map.emplace(key, T());
+    return key;
+}
+}
+
+uint32_t GetGlTextureBindTarget(uint32_t image_target)
+{
+    if (image_target >= kGlTextureCubemapPositiveXArb && image_target <= kGlTextureCubemapNegativeZArb)
+    {
+        return kGlTextureCubemapArb;
+    }
+    return image_target;
+}
+
+GlStateEmulator::GlStateEmulator()
+{
+    reset();
+}
+
+void GlStateEmulator::reset()
+{
+    buffer_generation_map_.clear();
+    texture_generation_map_.clear();
+    vertex_array_generation_map_.clear();
+    program_generation_map_.clear();
+    buffer_map_.clear();
+    texture_map_.clear();
+    vertex_array_map_.clear();
+    program_map_.clear();
+    buffer_binding_map_.clear();
+    texture_binding_map_.clear();
+    default_vertex_array_ = GlVertexArrayObject();
+    vertex_array_key_ = 0;
+    active_texture_unit_ = 0;
+    program_key_ = 0;
+}
+
+uint64_t GlStateEmulator::get_live_key(const unordered_map<uint32_t, uint32_t>& generation_map, uint32_t name) const
+{
+    auto it = generation_map.find(name);
+    return MakeGlObjectKey(name, it == generation_map.end() ? 0 : it->second);
+}
+
+GlVertexArrayObject& GlStateEmulator::get_vertex_array()
+{
+    if (vertex_array_key_ == 0)
+    {
+        return default_vertex_array_;
+    }
+    return vertex_array_map_[vertex_array_key_];
+}
+
+GlBufferObject* GlStateEmulator::get_bound_buffer_object(uint32_t target)
+{
+    uint64_t key = get_bound_buffer(target);
+    auto it = buffer_map_.find(key);
+    return it == buffer_map_.end() ? nullptr : &it->second;
+}
+
+bool GlStateEmulator::bind_buffer(uint32_t target, uint32_t name)
+{
+    if (!IsBufferTarget(target))
+    {
+        return false;
+    }
+
+    uint64_t key = name == 0 ? 0 : GetOrCreateObject(buffer_generation_map_, buffer_map_, name);
+    if (target == kGlElementArrayBuffer)
+    {
+        get_vertex_array().element_buffer_key = key;
+    }
+    else
+    {
+        buffer_binding_map_[target] = key;
+    }
+    return true;
+}
+
+bool GlStateEmulator::buffer_data(uint32_t target, const uint8_t* data, size_t size, uint32_t usage)
+{
+    GlBufferObject* buffer = IsBufferTarget(target) ? get_bound_buffer_object(target) : nullptr;
+    if (!buffer)
+    {
+        return false;
+    }
+
+    // a new store, draws already replayed read the old one.
+    buffer->usage = usage;
+    buffer->size = size;
+    buffer->data = data;
+    buffer->num_bytes = data ? size : 0;
+    vector<uint8_t>().swap(buffer->owned_data);
+    return true;
+}
+
+bool GlStateEmulator::buffer_sub_data(uint32_t target, size_t offset, const uint8_t* data, size_t size)
+{
+    GlBufferObject* buffer = IsBufferTarget(target) ? get_bound_buffer_object(target) : nullptr;
+    if (!buffer || !data || offset > buffer->size || size > buffer->size - offset)
+    {
+        return false;
+    }
+
+    // copied out of the capture on the first change, the undefined part of a store made
+    // without data only grows as far as it is written.
+    if (buffer->data != buffer->owned_data.data() || buffer->owned_data.empty())
+    {
+        buffer->owned_data.assign(buffer->data, buffer->data + buffer->num_bytes);
+    }
+    if (buffer->owned_data.size() < offset + size)
+    {
+        buffer->owned_data.resize(offset + size, 0);
+    }
+
+    memcpy(buffer->owned_data.data() + offset, data, size);
+    buffer->data = buffer->owned_data.data();
+    buffer->num_bytes = buffer->owned_data.size();
+    return true;
+}
+
+void GlStateEmulator::delete_buffers(const uint32_t* name_list, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t name = name_list[i];
+        uint64_t key = get_live_key(buffer_generation_map_, name);
+        if (key == 0)
+        {
+            continue;
+        }
+
+        for (auto& binding : buffer_binding_map_)
+        {
+            binding.second = binding.second == key ? 0 : binding.second;
+        }
+
+        GlVertexArrayObject& vertex_array = get_vertex_array();
+        vertex_array.element_buffer_key = vertex_array.element_buffer_key == key ? 0 : vertex_array.element_buffer_key;
+        for (auto& attrib : vertex_array.attrib_list)
+        {
+            attrib.buffer_key = attrib.buffer_key == key ? 0 : attrib.buffer_key;
+        }
+
+        // still attached to other vertex arrays, the store stays readable through them.
+        buffer_generation_map_[name]++;
+    }
+}
+
+uint64_t GlStateEmulator::get_bound_buffer(uint32_t target) const
+{
+    if (target == kGlElementArrayBuffer)
+    {
+        return get_element_buffer();
+    }
+
+    auto it = buffer_binding_map_.find(target);
+    return it == buffer_binding_map_.end() ? 0 : it->second;
+}
+
+const GlBufferObject* GlStateEmulator::get_buffer(uint64_t key) const
+{
+    auto it = buffer_map_.find(key);
+    return it == buffer_map_.end() ? nullptr : &it->second;
+}
+
+bool GlStateEmulator::bind_vertex_array(uint32_t name)
+{
+    vertex_array_key_ = name == 0 ? 0 : GetOrCreateObject(vertex_array_generation_map_, vertex_array_map_, name);
+    return true;
+}
+
+void GlStateEmulator::delete_vertex_arrays(const uint32_t* name_list, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t name = name_list[i];
+        uint64_t key = get_live_key(vertex_array_generation_map_, name);
+        if (key == 0)
+        {
+            continue;
+        }
+
+        if (vertex_array_key_ == key)
+        {
+            vertex_array_key_ = 0;
+        }
+        vertex_array_map_.erase(key);
+        vertex_array_generation_map_[name]++;
+    }
+}
+
+bool GlStateEmulator::vertex_attrib_pointer(uint32_t index, const VertexFormat& format, uint32_t stride, uint64_t offset)
+{
+    if (index >= kGlMaxVertexAttribs || !IsValidVertexFormat(format))
+    {
+        return false;
+    }
+
+    GlVertexAttrib& attrib = get_vertex_array().attrib_list[index];
+    attrib.format = format;
+    attrib.stride = stride == 0 ? GetVertexFormatSize(format) : stride;
+    attrib.offset = offset;
+    attrib.buffer_key = get_bound_buffer(kGlArrayBuffer);
+    return true;
+}
+
+bool GlStateEmulator::enable_vertex_attrib_array(uint32_t index, bool b_enabled)
+{
+    if (index >= kGlMaxVertexAttribs)
+    {
+        return false;
+    }
+
+    get_vertex_array().attrib_list[index].b_enabled = b_enabled;
+    return true;
+}
+
+bool GlStateEmulator::vertex_attrib_divisor(uint32_t index, uint32_t divisor)
+{
+    if (index >= kGlMaxVertexAttribs)
+    {
+        return false;
+    }
+
+    get_vertex_array().attrib_list[index].divisor = divisor;
+    return true;
+}
+
+const GlVertexAttrib& GlStateEmulator::get_vertex_attrib(uint32_t index) const
+{
+    static const GlVertexAttrib disabled_attrib;
+    if (index >= kGlMaxVertexAttribs)
+    {
+        return disabled_attrib;
+    }
+
+    if (vertex_array_key_ == 0)
+    {
+        return default_vertex_array_.attrib_list[index];
+    }
+
+    auto it = vertex_array_map_.find(vertex_array_key_);
+    return it == vertex_array_map_.end() ? disabled_attrib : it->second.attrib_list[index];
+}
+
+uint64_t GlStateEmulator::get_element_buffer() const
+{
+    if (vertex_array_key_ == 0)
+    {
+        return default_vertex_array_.element_buffer_key;
+    }
+
+    auto it = vertex_array_map_.find(vertex_array_key_);
+    return it == vertex_array_map_.end() ? 0 : it->second.element_buffer_key;
+}
+
+bool GlStateEmulator::active_texture(uint32_t unit)
+{
+    if (unit >= kGlMaxTextureUnits)
+    {
+        return false;
+    }
+
+    active_texture_unit_ = unit;
+    return true;
+}
+
+bool GlStateEmulator::bind_texture(uint32_t target, uint32_t name)
+{
+    if (!IsTextureTarget(target))
+    {
+        return false;
+    }
+
+    uint64_t key = 0;
+    if (name != 0)
+    {
+        key = GetOrCreateObject(texture_generation_map_, texture_map_, name);
+        GlTextureObject& texture = texture_map_[key];
+        if (texture.target == 0)
+        {
+            texture.target = target;
+        }
+        else if (texture.target != target)
+        {
+            return false;
+        }
+    }
+
+    texture_binding_map_[GetTextureBindingKey(active_texture_unit_, target)] = key;
+    return true;
+}
+
+void GlStateEmulator::delete_textures(const uint32_t* name_list, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t name = name_list[i];
+        uint64_t key = get_live_key(texture_generation_map_, name);
+        if (key == 0)
+        {
+            continue;
+        }
+
+        // every unit falls back to the default texture, the object stays for meshes using it.
+        for (auto& binding : texture_binding_map_)
+        {
+            binding.second = binding.second == key ? 0 : binding.second;
+        }
+        texture_generation_map_[name]++;
+    }
+}
+
+uint64_t GlStateEmulator::get_bound_texture(uint32_t unit, uint32_t target) const
+{
+    auto it = texture_binding_map_.find(GetTextureBindingKey(unit, target));
+    return it == texture_binding_map_.end() ? 0 : it->second;
+}
+
+GlTextureObject* GlStateEmulator::get_texture(uint64_t key)
+{
+    auto it = texture_map_.find(key);
+    return it == texture_map_.end() ? nullptr : &it->second;
+}
+
+bool GlStateEmulator::create_program(uint32_t name)
+{
+    if (name == 0)
+    {
+        return false;
+    }
+
+    GetOrCreateObject(program_generation_map_, program_map_, name);
+    return true;
+}
+
+bool GlStateEmulator::use_program(uint32_t name)
+{
+    uint64_t key = get_live_key(program_generation_map_, name);
+    if (key != 0 && program_map_.find(key) == program_map_.end())
+    {
+        return false;
+    }
+
+    program_key_ = key;
+    return true;
+}
+
+void GlStateEmulator::delete_program(uint32_t name)
+{
+    uint64_t key = get_live_key(program_generation_map_, name);
+    if (key == 0 || program_map_.find(key) == program_map_.end())
+    {
+        return;
+    }
+
+    // the current program is deleted once it is no longer in use, its key stays valid till then.
+    program_map_.erase(key);
+    program_generation_map_[name]++;
+}
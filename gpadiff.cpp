@@ -0,0 +1,554 @@
+#include "gpadiff.h"
+#include "meshdata.h"
+#include "registration.h"
+#include "coresimd.h"
+#include "corethread.h"
+#include "gpaframe.h"
+#include <fstream>
+#include <cfloat>
+#include <algorithm>
+#include <unordered_map>
+
+namespace
+{
+template <class T>
+uint64_t HashValue(uint64_t hash, T value)
+{
+    return HashGpaZone(reinterpret_cast<const uint8_t*>(&value), sizeof(T), hash);
+}
+
+uint64_t HashMeshTexture(const MeshData& mesh, const GroupMeshData& group_mesh_data)
+{
+    uint64_t hash = kGpaZoneHashSeed;
+    if (mesh.idx_in_texture_list < group_mesh_data.loaded_textures.size() && group_mesh_data.loaded_textures[mesh.idx_in_texture_list])
+    {
+        const core::Texture2DInfo* tex_info = group_mesh_data.loaded_textures[mesh.idx_in_texture_list];
+        const core::Texture2DSurfaceInfo& mip = tex_info->m_mips[0];
+        hash = HashValue(hash, tex_info->m_internalFormat);
+        hash = HashValue(hash, mip.m_width);
+        hash = HashValue(hash, mip.m_height);
+        if (mip.m_imageData)
+        {
+            hash = HashGpaZone(reinterpret_cast<const uint8_t*>(mip.m_imageData.get()), mip.m_size, hash);
+        }
+    }
+    return hash;
+}
+
+uint64_t HashMeshGeometry(const MeshData& mesh)
+{
+    uint64_t hash = kGpaZoneHashSeed;
+    size_t num_vertex = size_t(max(mesh.num_vertex, 0));
+    hash = HashValue(hash, uint64_t(num_vertex));
+    if (mesh.vertex_list)
+    {
+        hash = HashGpaZone(reinterpret_cast<const uint8_t*>(mesh.vertex_list.get()), num_vertex * sizeof(core::vec3f), hash);
+    }
+    if (mesh.uv_list)
+    {
+        hash = HashGpaZone(reinterpret_cast<const uint8_t*>(mesh.uv_list.get()), num_vertex * sizeof(core::vec2f), hash);
+    }
+    if (mesh.color_list)
+    {
+        hash = HashGpaZone(reinterpret_cast<const uint8_t*>(mesh.color_list.get()), num_vertex * sizeof(uint32_t), hash);
+    }
+
+    for (const auto& draw_call : mesh.draw_call_list)
+    {
+        hash = HashValue(hash, uint32_t(draw_call.is_ge_polygon()));
+        hash = HashValue(hash, draw_call.get_index_count());
+        for (int i = 0; i < draw_call.get_index_count(); i++)
+        {
+            hash = HashValue(hash, draw_call.get_index(i));
+        }
+    }
+    return hash;
+}
+
+// mesh vertices in the capture's frame, then through to_old when given. the two are applied
+// one after the other, a dumpped matrix can carry a projective column the product would mix in.
+void GetCapturePositions(const MeshData& mesh, const core::matrix4d* to_old, vector<core::vec3d>& position_list)
+{
+    position_list.clear();
+    if (!mesh.vertex_list || mesh.num_vertex <= 0)
+    {
+        return;
+    }
+
+    position_list.resize(size_t(mesh.num_vertex));
+    core::TransformPointsAffine(mesh.vertex_list.get(), position_list.size(), mesh.dumpped_matrix, position_list.data());
+    if (to_old)
+    {
+        vector<core::vec3d> capture_list(position_list);
+        core::TransformPointsAffine(capture_list.data(), capture_list.size(), *to_old, position_list.data());
+    }
+}
+
+bool GetCaptureCentroid(const MeshData& mesh, core::vec3d& centroid)
+{
+    vector<core::vec3d> position_list;
+    GetCapturePositions(mesh, nullptr, position_list);
+    if (position_list.empty())
+    {
+        return false;
+    }
+
+    centroid = core::vec3d(0, 0, 0);
+    for (const auto& position : position_list)
+    {
+        centroid += position;
+    }
+    centroid = centroid / double(position_list.size());
+    return true;
+}
+
+int32_t GetCellCoord(double v, double cell_size)
+{
+    const double kMaxCell = double(1 << 30);
+    double cell = floor(v / cell_size);
+    return cell < kMaxCell ? (cell > -kMaxCell ? int32_t(cell) : -(1 << 30)) : (1 << 30);
+}
+
+core::vec3i GetCell(const core::vec3d& p, double cell_size)
+{
+    return core::vec3i(GetCellCoord(p.x, cell_size), GetCellCoord(p.y, cell_size), GetCellCoord(p.z, cell_size));
+}
+
+// 21 bits a coordinate, cells far enough apart to wrap only ever hold far apart points.
+uint64_t GetCellKey(int32_t x, int32_t y, int32_t z)
+{
+    return (uint64_t(uint32_t(x)) & 0x1fffff) << 42 | (uint64_t(uint32_t(y)) & 0x1fffff) << 21 | (uint64_t(uint32_t(z)) & 0x1fffff);
+}
+
+// nearest point queries over one mesh's vertices, searched ring by ring out from the query
+// cell. rings only walk the cells inside the occupied box, a far query costs no more.
+class NearestPointGrid
+{
+public:
+    explicit NearestPointGrid(const vector<core::vec3d>& point_list) : point_list_(point_list), cell_size_(1.0)
+    {
+        core::bounds3d bbox;
+        for (const auto& point : point_list_)
+        {
+            bbox += point;
+        }
+
+        core::vec3d extent = bbox.bb_max - bbox.bb_min;
+        double max_extent = max(max(extent.x, extent.y), extent.z);
+        cell_size_ = max_extent > 0.0 ? max_extent / max(cbrt(double(point_list_.size())), 1.0) : 1.0;
+
+        min_cell_ = GetCell(bbox.bb_min, cell_size_);
+        max_cell_ = GetCell(bbox.bb_max, cell_size_);
+        for (uint32_t i = 0; i < point_list_.size(); i++)
+        {
+            core::vec3i cell = GetCell(point_list_[i], cell_size_);
+            cell_map_[GetCellKey(cell.x, cell.y, cell.z)].push_back(i);
+        }
+    }
+
+    NearestPointGrid(const NearestPointGrid&) = delete;
+    NearestPointGrid& operator=(const NearestPointGrid&) = delete;
+
+    double get_nearest_distance(const core::vec3d& p) const
+    {
+        core::vec3i c = GetCell(p, cell_size_);
+
+        // chebyshev distance in cells to the nearest and the farthest occupied cell, in 64 bits
+        // as a far query can be 2^31 cells out.
+        int64_t first_ring = 0, last_ring = 0;
+        int64_t lo[3], hi[3];
+        for (int32_t axis = 0; axis < 3; axis++)
+        {
+            lo[axis] = int64_t(min_cell_[axis]) - c[axis];
+            hi[axis] = int64_t(max_cell_[axis]) - c[axis];
+            first_ring = max(first_ring, lo[axis] > 0 ? lo[axis] : (hi[axis] < 0 ? -hi[axis] : 0));
+            last_ring = max(last_ring, max(abs(lo[axis]), abs(hi[axis])));
+        }
+
+        double best_dist_2 = DBL_MAX;
+        for (int64_t ring = first_ring; ring <= last_ring; ring++)
+        {
+            for (int64_t z = max(-ring, lo[2]); z <= min(ring, hi[2]); z++)
+            {
+                for (int64_t y = max(-ring, lo[1]); y <= min(ring, hi[1]); y++)
+                {
+                    // inside the shell only x = -ring and x = ring belong to this ring.
+                    bool is_face = abs(z) == ring || abs(y) == ring;
+                    int64_t x_step = is_face || ring == 0 ? 1 : 2 * ring;
+                    int64_t x_begin = is_face ? max(-ring, lo[0]) : -ring;
+                    int64_t x_end = is_face ? min(ring, hi[0]) : ring;
+                    for (int64_t x = x_begin; x <= x_end; x += x_step)
+                    {
+                        if (x < lo[0] || x > hi[0])
+                        {
+                            continue;
+                        }
+
+                        auto it = cell_map_.find(GetCellKey(int32_t(c.x + x), int32_t(c.y + y), int32_t(c.z + z)));
+                        if (it == cell_map_.end())
+                        {
+                            continue;
+                        }
+                        for (uint32_t idx : it->second)
+                        {
+                            core::vec3d d = point_list_[idx] - p;
+                            best_dist_2 = min(best_dist_2, d.x * d.x + d.y * d.y + d.z * d.z);
+                        }
+                    }
+                }
+            }
+
+            // anything in a further ring is at least ring cells away.
+            double searched = double(ring) * cell_size_;
+            if (best_dist_2 <= searched * searched)
+            {
+                break;
+            }
+        }
+        return best_dist_2 < DBL_MAX ? sqrt(best_dist_2) : 0.0;
+    }
+
+private:
+    const vector<core::vec3d>&                  point_list_;
+    double                                      cell_size_;
+    core::vec3i                                 min_cell_;
+    core::vec3i                                 max_cell_;
+    unordered_map<uint64_t, vector<uint32_t>>   cell_map_;
+};
+
+VertexDeviation GetVertexDeviation(const vector<core::vec3d>& old_list, const vector<core::vec3d>& new_list)
+{
+    VertexDeviation deviation;
+    if (old_list.empty() || new_list.empty())
+    {
+        return deviation;
+    }
+
+    NearestPointGrid new_grid(new_list);
+    vector<double> dist_list(old_list.size());
+    double sum = 0.0, sum_2 = 0.0;
+    for (size_t i = 0; i < old_list.size(); i++)
+    {
+        dist_list[i] = new_grid.get_nearest_distance(old_list[i]);
+        sum += dist_list[i];
+        sum_2 += dist_list[i] * dist_list[i];
+        deviation.max_distance = max(deviation.max_distance, dist_list[i]);
+    }
+    deviation.mean_distance = sum / double(dist_list.size());
+    deviation.rms_distance = sqrt(sum_2 / double(dist_list.size()));
+
+    size_t p95_idx = min(dist_list.size() - 1, size_t(double(dist_list.size()) * 0.95));
+    nth_element(dist_list.begin(), dist_list.begin() + ptrdiff_t(p95_idx), dist_list.end());
+    deviation.p95_distance = dist_list[p95_idx];
+
+    // a vertex added to the new mesh only shows up going the other way.
+    NearestPointGrid old_grid(old_list);
+    for (const auto& position : new_list)
+    {
+        deviation.max_distance = max(deviation.max_distance, old_grid.get_nearest_distance(position));
+    }
+    return deviation;
+}
+
+struct MeshDiffKey
+{
+    uint64_t            hash;
+    uint64_t            texture_hash;
+    bool                has_centroid;
+    core::vec3d         centroid;
+    int32_t             primitive;          // of the first draw call, meshes of different ones never match
+};
+
+void GetMeshDiffKeys(const GroupMeshData& group_mesh_data, vector<MeshDiffKey>& key_list)
+{
+    key_list.resize(group_mesh_data.meshes.size());
+    core::ParallelFor(key_list.size(), 64, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            const MeshData* mesh = group_mesh_data.meshes[i];
+            MeshDiffKey& key = key_list[i];
+            key.texture_hash = HashMeshTexture(*mesh, group_mesh_data);
+            key.hash = HashValue(HashMeshGeometry(*mesh), key.texture_hash);
+            key.has_centroid = GetCaptureCentroid(*mesh, key.centroid);
+            key.primitive = mesh->draw_call_list.empty() ? -1 : int32_t(mesh->draw_call_list[0].is_ge_polygon());
+        }
+    });
+}
+
+struct MeshPairCandidate
+{
+    bool                b_same_hash;
+    double              distance;
+    uint32_t            old_idx;
+    uint32_t            new_idx;
+
+    bool operator<(const MeshPairCandidate& other) const
+    {
+        if (b_same_hash != other.b_same_hash)
+        {
+            return b_same_hash;
+        }
+        if (distance != other.distance)
+        {
+            return distance < other.distance;
+        }
+        return old_idx != other.old_idx ? old_idx < other.old_idx : new_idx < other.new_idx;
+    }
+};
+}
+
+uint64_t HashMeshContent(const MeshData& mesh, const GroupMeshData& group_mesh_data)
+{
+    return HashValue(HashMeshGeometry(mesh), HashMeshTexture(mesh, group_mesh_data));
+}
+
+void DiffCaptureMeshes(const GroupMeshData& old_group, const GroupMeshData& new_group,
+                       const MeshDiffOptions& options, CaptureDiff& diff)
+{
+    diff = CaptureDiff();
+    double match_distance = options.match_distance > 0.0 ? options.match_distance : 1.0;
+
+    vector<MeshDiffKey> old_key_list, new_key_list;
+    GetMeshDiffKeys(old_group, old_key_list);
+    GetMeshDiffKeys(new_group, new_key_list);
+
+    vector<uint32_t> old_match_list(old_key_list.size(), INVALID_VALUE);
+    vector<uint32_t> new_match_list(new_key_list.size(), INVALID_VALUE);
+
+    // content hashes found once on each side pair up without looking at positions.
+    unordered_map<uint64_t, vector<uint32_t>> new_hash_map;
+    unordered_map<uint64_t, uint32_t> old_hash_count;
+    for (uint32_t i = 0; i < new_key_list.size(); i++)
+    {
+        new_hash_map[new_key_list[i].hash].push_back(i);
+    }
+    for (const auto& key : old_key_list)
+    {
+        old_hash_count[key.hash]++;
+    }
+
+    PointCorrespondences anchors;
+    for (uint32_t i = 0; i < old_key_list.size(); i++)
+    {
+        auto it = new_hash_map.find(old_key_list[i].hash);
+        if (old_hash_count[old_key_list[i].hash] == 1 && it != new_hash_map.end() && it->second.size() == 1)
+        {
+            uint32_t new_idx = it->second[0];
+            old_match_list[i] = new_idx;
+            new_match_list[new_idx] = i;
+            if (old_key_list[i].has_centroid && new_key_list[new_idx].has_centroid)
+            {
+                anchors.src_list.push_back(new_key_list[new_idx].centroid);
+                anchors.dst_list.push_back(old_key_list[i].centroid);
+            }
+        }
+    }
+
+    // each capture is relative to its own first draw, the unchanged meshes tell how the two line up.
+    if (options.align_captures && anchors.src_list.size() >= 3)
+    {
+        RegistrationOptions registration_options;
+        registration_options.estimate_scale = false;
+        registration_options.inlier_threshold = match_distance;
+
+        RegistrationResult result;
+        if (RegisterPoints(anchors, registration_options, result))
+        {
+            diff.b_aligned = true;
+            diff.new_to_old = result.transform;
+        }
+    }
+
+    for (auto& key : new_key_list)
+    {
+        core::vec4d p = core::vec4d(key.centroid.x, key.centroid.y, key.centroid.z, 1.0) * diff.new_to_old;
+        key.centroid = core::vec3d(p.x, p.y, p.z);
+    }
+
+    // the rest pair by centroid, a grid of match_distance cells holds every candidate in the 27 around.
+    unordered_map<uint64_t, vector<uint32_t>> new_cell_map;
+    for (uint32_t i = 0; i < new_key_list.size(); i++)
+    {
+        if (new_match_list[i] == INVALID_VALUE && new_key_list[i].has_centroid)
+        {
+            core::vec3i cell = GetCell(new_key_list[i].centroid, match_distance);
+            new_cell_map[GetCellKey(cell.x, cell.y, cell.z)].push_back(i);
+        }
+    }
+
+    vector<MeshPairCandidate> candidate_list;
+    for (uint32_t i = 0; i < old_key_list.size(); i++)
+    {
+        const MeshDiffKey& old_key = old_key_list[i];
+        if (old_match_list[i] != INVALID_VALUE || !old_key.has_centroid)
+        {
+            continue;
+        }
+
+        core::vec3i cell = GetCell(old_key.centroid, match_distance);
+        for (int32_t z = -1; z <= 1; z++)
+        {
+            for (int32_t y = -1; y <= 1; y++)
+            {
+                for (int32_t x = -1; x <= 1; x++)
+                {
+                    auto it = new_cell_map.find(GetCellKey(cell.x + x, cell.y + y, cell.z + z));
+                    if (it == new_cell_map.end())
+                    {
+                        continue;
+                    }
+
+                    for (uint32_t new_idx : it->second)
+                    {
+                        const MeshDiffKey& new_key = new_key_list[new_idx];
+                        double distance = core::length(new_key.centroid - old_key.centroid);
+                        if (new_key.primitive == old_key.primitive && distance <= match_distance)
+                        {
+                            candidate_list.push_back({ new_key.hash == old_key.hash, distance, i, new_idx });
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // equal content first, then closest first.
+    sort(candidate_list.begin(), candidate_list.end());
+    for (const auto& candidate : candidate_list)
+    {
+        if (old_match_list[candidate.old_idx] == INVALID_VALUE && new_match_list[candidate.new_idx] == INVALID_VALUE)
+        {
+            old_match_list[candidate.old_idx] = candidate.new_idx;
+            new_match_list[candidate.new_idx] = candidate.old_idx;
+        }
+    }
+
+    vector<uint32_t> changed_list;
+    for (uint32_t i = 0; i < old_key_list.size(); i++)
+    {
+        MeshDiffEntry entry;
+        entry.old_idx = i;
+        entry.new_idx = old_match_list[i];
+        entry.old_hash = old_key_list[i].hash;
+        entry.new_hash = 0;
+        entry.old_num_vertex = uint32_t(max(old_group.meshes[i]->num_vertex, 0));
+        entry.new_num_vertex = 0;
+        entry.b_texture_changed = false;
+
+        if (entry.new_idx == INVALID_VALUE)
+        {
+            entry.type = kMeshDiffRemoved;
+            diff.num_removed++;
+        }
+        else
+        {
+            const MeshDiffKey& new_key = new_key_list[entry.new_idx];
+            entry.new_hash = new_key.hash;
+            entry.new_num_vertex = uint32_t(max(new_group.meshes[entry.new_idx]->num_vertex, 0));
+            entry.b_texture_changed = new_key.texture_hash != old_key_list[i].texture_hash;
+
+            // an unchanged mesh that moved is a change too.
+            bool has_moved = new_key.has_centroid && old_key_list[i].has_centroid &&
+                             core::length(new_key.centroid - old_key_list[i].centroid) > match_distance;
+            if (entry.new_hash == entry.old_hash && !has_moved)
+            {
+                entry.type = kMeshDiffUnchanged;
+                diff.num_unchanged++;
+            }
+            else
+            {
+                entry.type = kMeshDiffChanged;
+                diff.num_changed++;
+                changed_list.push_back(uint32_t(diff.entry_list.size()));
+            }
+        }
+        diff.entry_list.push_back(entry);
+    }
+
+    for (uint32_t i = 0; i < new_key_list.size(); i++)
+    {
+        if (new_match_list[i] == INVALID_VALUE)
+        {
+            MeshDiffEntry entry;
+            entry.type = kMeshDiffAdded;
+            entry.old_idx = INVALID_VALUE;
+            entry.new_idx = i;
+            entry.old_hash = 0;
+            entry.new_hash = new_key_list[i].hash;
+            entry.old_num_vertex = 0;
+            entry.new_num_vertex = uint32_t(max(new_group.meshes[i]->num_vertex, 0));
+            entry.b_texture_changed = false;
+            diff.entry_list.push_back(entry);
+            diff.num_added++;
+        }
+    }
+
+    core::ParallelFor(changed_list.size(), 16, [&](size_t begin, size_t end)
+    {
+        vector<core::vec3d> old_position_list, new_position_list;
+        for (size_t i = begin; i < end; i++)
+        {
+            MeshDiffEntry& entry = diff.entry_list[changed_list[i]];
+            GetCapturePositions(*old_group.meshes[entry.old_idx], nullptr, old_position_list);
+            GetCapturePositions(*new_group.meshes[entry.new_idx], &diff.new_to_old, new_position_list);
+            entry.deviation = GetVertexDeviation(old_position_list, new_position_list);
+        }
+    });
+}
+
+bool DiffGpaFrames(const string& old_file_name, const string& new_file_name,
+                   const MeshDiffOptions& options, CaptureDiff& diff)
+{
+    GroupMeshData old_group, new_group;
+    CreateMeshFromDumpFile(old_file_name, &old_group);
+    CreateMeshFromDumpFile(new_file_name, &new_group);
+
+    bool b_succeed = !old_group.meshes.empty() && !new_group.meshes.empty();
+    if (b_succeed)
+    {
+        DiffCaptureMeshes(old_group, new_group, options, diff);
+    }
+    else
+    {
+        diff = CaptureDiff();
+        core::output_debug_info("error", "no meshes to diff in " + (old_group.meshes.empty() ? old_file_name : new_file_name));
+    }
+
+    for (GroupMeshData* group_mesh_data : { &old_group, &new_group })
+    {
+        for (auto& mesh : group_mesh_data->meshes)
+        {
+            SAFE_DELETE(mesh);
+        }
+        for (auto& texture : group_mesh_data->loaded_textures)
+        {
+            SAFE_DELETE(texture);
+        }
+    }
+    return b_succeed;
+}
+
+bool WriteCaptureDiffReport(const string& csv_file_name, const CaptureDiff& diff)
+{
+    static const char* type_names[] = { "unchanged", "changed", "added", "removed" };
+
+    ofstream report_file(csv_file_name);
+    report_file << "type,old_idx,new_idx,old_vertices,new_vertices,texture_changed,max_deviation,mean_deviation,rms_deviation,p95_deviation\n";
+    for (const auto& entry : diff.entry_list)
+    {
+        report_file << type_names[entry.type] << ","
+                    << (entry.old_idx == INVALID_VALUE ? -1 : int64_t(entry.old_idx)) << ","
+                    << (entry.new_idx == INVALID_VALUE ? -1 : int64_t(entry.new_idx)) << ","
+                    << entry.old_num_vertex << "," << entry.new_num_vertex << "," << (entry.b_texture_changed ? 1 : 0) << ","
+                    << entry.deviation.max_distance << "," << entry.deviation.mean_distance << ","
+                    << entry.deviation.rms_distance << "," << entry.deviation.p95_distance << "\n";
+    }
+
+    if (!report_file)
+    {
+        core::output_debug_info("error", "failed to write " + csv_file_name);
+        return false;
+    }
+    return true;
+}
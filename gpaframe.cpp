@@ -0,0 +1,299 @@
+#include "gpaframe.h"
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+const uint32_t kGpaIndexMagic = 0x49415047;    // "GPAI"
+const uint32_t kGpaIndexVersion = 1;
+const size_t kGpaIndexHeaderSize = 44;
+const size_t kGpaIndexEntrySize = 24;
+
+template <class T>
+void AppendValue(vector<uint8_t>& data, T value)
+{
+    size_t ofs = data.size();
+    data.resize(ofs + sizeof(T));
+    memcpy(&data[ofs], &value, sizeof(T));
+}
+
+template <class T>
+bool ReadValue(const uint8_t* data, size_t size, size_t& ofs, T& value)
+{
+    if (ofs + sizeof(T) > size)
+    {
+        return false;
+    }
+    memcpy(&value, data + ofs, sizeof(T));
+    ofs += sizeof(T);
+    return true;
+}
+
+uint32_t ReadZoneWord(const uint8_t* data)
+{
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+}
+
+const char* GetGpaParseErrorName(GpaParseErrorType type)
+{
+    switch (type)
+    {
+    case kGpaErrorFileHeader:
+        return "file header";
+    case kGpaErrorTruncated:
+        return "truncated";
+    case kGpaErrorZoneSize:
+        return "zone size";
+    case kGpaErrorZoneTag:
+        return "zone tag";
+    case kGpaErrorZoneStamp:
+        return "zone stamp";
+    case kGpaErrorDataBlock:
+        return "data block";
+    case kGpaErrorCommandSize:
+        return "command size";
+    case kGpaErrorDataReference:
+        return "data reference";
+    case kGpaErrorObjectId:
+        return "object id";
+    case kGpaErrorInvalidEnum:
+        return "invalid enum";
+    case kGpaErrorBufferRange:
+        return "buffer range";
+    }
+
+    return "unknown";
+}
+
+string FormatGpaParseError(const GpaParseError& error)
+{
+    ostringstream line;
+    line << "zone " << error.zone_idx << " at 0x" << hex << error.offset << " tag 0x" << error.tag << ": " << GetGpaParseErrorName(error.type);
+    return line.str();
+}
+
+uint64_t HashGpaZone(const uint8_t* data, size_t size, uint64_t hash)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ data[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+bool BuildGpaFrameIndex(const uint8_t* data, size_t size, GpaFrameIndex& index)
+{
+    index = GpaFrameIndex();
+    index.file_size = size;
+    if (!data || size < 8 || ReadZoneWord(data) != kGpaFrameFileTag)
+    {
+        return false;
+    }
+
+    index.b_valid = true;
+    index.version_number = ReadZoneWord(data + 4);
+
+    size_t offset = 8;
+    while (size - offset >= 8)
+    {
+        uint32_t num_bytes = ReadZoneWord(data + offset);
+        uint32_t tag = ReadZoneWord(data + offset + 4);
+        if (tag == kGpaFrameEndTag || num_bytes > size - offset - 8)
+        {
+            index.end_tag = tag;
+            break;
+        }
+
+        GpaZoneEntry zone;
+        zone.offset = offset;
+        zone.num_bytes = num_bytes;
+        zone.tag = tag;
+        zone.hash = HashGpaZone(data + offset + 8, num_bytes);
+        index.zone_list.push_back(zone);
+
+        offset += 8 + size_t(num_bytes);
+    }
+    index.end_offset = offset;
+    return true;
+}
+
+bool IsGpaFrameIndexCurrent(const uint8_t* data, size_t size, const GpaFrameIndex& index)
+{
+    if (!data || !index.b_valid || index.file_size != size || size < 8 || ReadZoneWord(data) != kGpaFrameFileTag)
+    {
+        return false;
+    }
+
+    for (const auto& zone : index.zone_list)
+    {
+        if (zone.offset + 8 + zone.num_bytes > size ||
+            ReadZoneWord(data + zone.offset) != zone.num_bytes ||
+            ReadZoneWord(data + zone.offset + 4) != zone.tag)
+        {
+            return false;
+        }
+    }
+    return index.end_offset <= size;
+}
+
+bool VerifyGpaFrameIndex(const uint8_t* data, size_t size, const GpaFrameIndex& index)
+{
+    if (!IsGpaFrameIndexCurrent(data, size, index))
+    {
+        return false;
+    }
+
+    for (const auto& zone : index.zone_list)
+    {
+        if (HashGpaZone(data + zone.offset + 8, zone.num_bytes) != zone.hash)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+string GetGpaFrameIndexFileName(const string& frame_file_name)
+{
+    return frame_file_name + ".idx";
+}
+
+bool GetGpaFrameFileStamp(const string& file_name, uint64_t& file_size, int64_t& file_time)
+{
+    error_code ec;
+    file_size = fs::file_size(file_name, ec);
+    if (ec)
+    {
+        return false;
+    }
+
+    fs::file_time_type write_time = fs::last_write_time(file_name, ec);
+    if (ec)
+    {
+        return false;
+    }
+    file_time = int64_t(write_time.time_since_epoch().count());
+    return true;
+}
+
+bool SaveGpaFrameIndex(const string& index_file_name, const GpaFrameIndex& index)
+{
+    if (!index.b_valid)
+    {
+        return false;
+    }
+
+    vector<uint8_t> data;
+    data.reserve(kGpaIndexHeaderSize + index.zone_list.size() * kGpaIndexEntrySize);
+    AppendValue(data, kGpaIndexMagic);
+    AppendValue(data, kGpaIndexVersion);
+    AppendValue(data, index.file_size);
+    AppendValue(data, index.file_time);
+    AppendValue(data, index.version_number);
+    AppendValue(data, index.end_tag);
+    AppendValue(data, index.end_offset);
+    AppendValue(data, uint32_t(index.zone_list.size()));
+    for (const auto& zone : index.zone_list)
+    {
+        AppendValue(data, zone.offset);
+        AppendValue(data, zone.num_bytes);
+        AppendValue(data, zone.tag);
+        AppendValue(data, zone.hash);
+    }
+
+    // written aside and renamed, a reader never sees half an index.
+    string temp_file_name = index_file_name + ".tmp";
+    {
+        ofstream out_file(temp_file_name, ofstream::binary);
+        out_file.write(reinterpret_cast<const char*>(data.data()), streamsize(data.size()));
+        if (!out_file)
+        {
+            return false;
+        }
+    }
+
+    error_code ec;
+    fs::rename(temp_file_name, index_file_name, ec);
+    if (ec)
+    {
+        fs::remove(temp_file_name, ec);
+        return false;
+    }
+    return true;
+}
+
+bool LoadGpaFrameIndex(const string& index_file_name, uint64_t file_size, int64_t file_time, GpaFrameIndex& index)
+{
+    index = GpaFrameIndex();
+
+    ifstream in_file(index_file_name, ifstream::binary | ifstream::ate);
+    if (!in_file)
+    {
+        return false;
+    }
+
+    vector<uint8_t> data(size_t(in_file.tellg()));
+    in_file.seekg(0);
+    in_file.read(reinterpret_cast<char*>(data.data()), streamsize(data.size()));
+    if (!in_file)
+    {
+        return false;
+    }
+
+    size_t ofs = 0;
+    uint32_t magic = 0, version = 0, num_zones = 0;
+    GpaFrameIndex loaded;
+    if (!ReadValue(data.data(), data.size(), ofs, magic) ||
+        !ReadValue(data.data(), data.size(), ofs, version) ||
+        !ReadValue(data.data(), data.size(), ofs, loaded.file_size) ||
+        !ReadValue(data.data(), data.size(), ofs, loaded.file_time) ||
+        !ReadValue(data.data(), data.size(), ofs, loaded.version_number) ||
+        !ReadValue(data.data(), data.size(), ofs, loaded.end_tag) ||
+        !ReadValue(data.data(), data.size(), ofs, loaded.end_offset) ||
+        !ReadValue(data.data(), data.size(), ofs, num_zones))
+    {
+        return false;
+    }
+
+    if (magic != kGpaIndexMagic ||
+        version != kGpaIndexVersion ||
+        loaded.file_size != file_size ||
+        loaded.file_time != file_time ||
+        loaded.end_offset > file_size ||
+        file_size < 8 ||
+        data.size() != kGpaIndexHeaderSize + size_t(num_zones) * kGpaIndexEntrySize)
+    {
+        return false;
+    }
+
+    // zones follow each other inside the file, the parser relies on it.
+    uint64_t zone_end = 8;
+    loaded.zone_list.resize(num_zones);
+    for (auto& zone : loaded.zone_list)
+    {
+        ReadValue(data.data(), data.size(), ofs, zone.offset);
+        ReadValue(data.data(), data.size(), ofs, zone.num_bytes);
+        ReadValue(data.data(), data.size(), ofs, zone.tag);
+        ReadValue(data.data(), data.size(), ofs, zone.hash);
+        if (zone.offset != zone_end || file_size - zone.offset < 8 || zone.num_bytes > file_size - zone.offset - 8)
+        {
+            return false;
+        }
+        zone_end = zone.offset + 8 + zone.num_bytes;
+    }
+
+    if (zone_end != loaded.end_offset)
+    {
+        return false;
+    }
+
+    loaded.b_valid = true;
+    index = move(loaded);
+    return true;
+}
@@ -186,7 +186,19 @@ HFAHandle HFAOpen( const char * pszFilename, const char * pszAccess )
 /*      Open the file.                                                  */
 /* -------------------------------------------------------------------- */
     if( EQUAL(pszAccess,"r") || EQUAL(pszAccess,"rb" ) )
-        fp = VSIFOpenL( pszFilename, "rb" );
+    {
+        /* read only access is served from a memory mapped view unless  */
+        /* disabled, the mmap handler falls back to stdio on its own.   */
+        if( !EQUALN(pszFilename,"/vsi",4)
+            && CSLTestBoolean( CPLGetConfigOption( "HFA_USE_MMAP", "YES" ) ) )
+        {
+            CPLString osMMapFilename = "/vsimmap/";
+            osMMapFilename += pszFilename;
+            fp = VSIFOpenL( osMMapFilename, "rb" );
+        }
+        else
+            fp = VSIFOpenL( pszFilename, "rb" );
+    }
     else
         fp = VSIFOpenL( pszFilename, "r+b" );
 
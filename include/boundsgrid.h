@@ -0,0 +1,38 @@
+#pragma once
+#include "coremath.h"
+#include <unordered_map>
+
+// boxes wider than this many cells are not spread over the grid, queries test them directly.
+constexpr uint64_t kMaxBoundsGridItemCells = 1024;
+
+// uniform hash grid over 2d boxes for overlap queries. boxes can be added at any time,
+// each goes into every cell it overlaps. query is const and safe to call from several
+// threads at once, as long as nothing is added meanwhile.
+class BoundsGridIndex
+{
+    double                                      cell_size_;
+    vector<core::bounds2d>                      bbox_list_;
+    unordered_map<uint64_t, vector<uint32_t>>   cell_map_;
+    vector<uint32_t>                            large_item_list_;
+
+    bool get_cell_range(const core::bounds2d& bbox, core::vec2i& min_cell, core::vec2i& max_cell) const;
+
+public:
+    explicit BoundsGridIndex(double cell_size);
+
+    BoundsGridIndex(const BoundsGridIndex&) = delete;
+    BoundsGridIndex& operator=(const BoundsGridIndex&) = delete;
+
+    // index of the box, boxes are numbered in the order they are added.
+    uint32_t add(const core::bounds2d& bbox);
+    void clear();
+
+    size_t get_num_items() const { return bbox_list_.size(); }
+    double get_cell_size() const { return cell_size_; }
+
+    // every box whose overlap with bbox has an area, the test operator ^ makes, ascending.
+    void query(const core::bounds2d& bbox, vector<uint32_t>& item_list) const;
+
+    // the mean box extent, a cell about the size of a typical box.
+    static double suggest_cell_size(const vector<core::bounds2d>& bbox_list);
+};
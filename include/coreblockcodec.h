@@ -0,0 +1,50 @@
+#pragma once
+#include "coretexture.h"
+
+namespace core
+{
+
+enum BlockFormat
+{
+    kBlockFormatBc1,        // rgb, dxt1
+    kBlockFormatBc3,        // rgba, dxt5
+    kBlockFormatBc4,        // r, single channel heightmaps and masks
+    kBlockFormatBc5,        // rg, two channel normal maps
+    kBlockFormatBc7,        // rgba, mode 6 only
+};
+
+// bytes per 4x4 block, 8 for bc1/bc4 and 16 for the others.
+uint32_t GetBlockFormatSize(BlockFormat format);
+// gl internal format written to Texture2DInfo::m_format.
+uint32_t GetBlockFormatGlFormat(BlockFormat format);
+// false if the gl format has no encoder here (dxt3, uncompressed).
+bool GetGlBlockFormat(uint32_t gl_format, BlockFormat& format);
+
+/**
+ * @brief  Compress w x h rgba8 rows into blocks, partial edge blocks repeat the last
+ *         row and column. Block rows are split across hardware threads, dst needs
+ *         ((w + 3) / 4) * ((h + 3) / 4) * GetBlockFormatSize(format) bytes.
+ */
+void CompressBlockImage(const uint8_t* rgba_data, uint32_t w, uint32_t h, BlockFormat format, uint8_t* dst);
+
+/**
+ * @brief  Decode blocks back to w x h rgba8 rows. Channels the format does not store
+ *         are 0 (bc4 g/b, bc5 b) and alpha is 255.
+ *
+ * @return  False for bc7 blocks in a mode other than 6
+ */
+bool DecompressBlockImage(const uint8_t* src, uint32_t w, uint32_t h, BlockFormat format, uint8_t* rgba_data);
+
+// psnr in db over the channels the format stores, 0 if the block data can't be decoded.
+float ComputeBlockPsnr(const uint8_t* rgba_data, uint32_t w, uint32_t h, BlockFormat format, const uint8_t* blocks);
+
+/**
+ * @brief  Compress every level of an rgb/rgba or dxt texture into dst_info. Levels are
+ *         decoded to rgba8 first, so an existing dxt1 texture can be moved to bc7.
+ *
+ * @param  psnr  If not null, receives the psnr of level 0
+ * @return  False if a source level can't be decoded
+ */
+bool CompressTexture(const core::Texture2DInfo* src_info, core::Texture2DInfo* dst_info, BlockFormat format, float* psnr = nullptr);
+
+};
@@ -3,6 +3,11 @@
 #define GEOGRAPHICLIB_SHARED_LIB 0
 #include "GeographicLib/UTMUPS.hpp"
 
+namespace GeographicLib
+{
+class Geoid;
+}
+
 namespace core
 {
 constexpr double emajor = 6378137.0;
@@ -497,97 +502,94 @@ protected:
     static constexpr size_t MAX_ECEF_TO_LLA_ITERATION = 10;
 };
 
-struct UTMConvertor
+/**
+ * @brief  Batched UTM/UPS projection on WGS84. Transverse mercator uses the 6th order
+ *         Krueger series (Karney 2011), good to a few nanometers within the zone and
+ *         still sub millimeter several degrees outside of it, so a batch straddling a
+ *         zone boundary can be projected into one common zone without a seam.
+ *         gps coordinates are (lat, lon) in degrees, utm coordinates (easting, northing)
+ *         in meters. Zone 0 is UPS, the south hemisphere uses a 10000km false northing.
+ */
+class UTMProjector
 {
-    const double a = 6378.137;
-    const double f = 1.0 / 298.257223563;
-    const double N0 = 0;
-    const double k0 = 0.9996;
-    const double E0 = 500.0;
-    const double Lambda0 = 0.0;
-
-    const double n = f / (2.0 - f);
-    const double n2 = n * n;
-    const double n3 = n2 * n;
-    const double A = a / (1.0 + n) * (1.0 + n2 / 4.0 + n2 * n2 / 64.0);
-    const core::vec3d alpha = core::vec3d(1.0 / 2.0 * n - 2.0 / 3.0 * n2 + 5.0 / 16.0 * n3,
-        13.0 / 48.0 * n2 - 3.0 / 5.0 * n3,
-        61.0 / 240.0 * n3);
-    const core::vec3d beta = core::vec3d(1.0 / 2.0 * n - 2.0 / 3.0 * n2 + 37.0 / 96.0 * n3,
-        1.0 / 48.0 * n2 + 1.0 / 15.0 * n3,
-        17.0 / 480.0 * n3);
-    const core::vec3d delta = core::vec3d(2.0 * n - 2.0 / 3.0 * n2 - 2.0 * n3,
-        7.0 / 3.0 * n2 - 8.0 / 5.0 * n3,
-        56.0 / 15.0 * n3);
-
-    core::vec2d FromGeographicCoord(const core::vec2d& gps_loc, int32_t zone) const
-    {
-        double lambda_0 = core::DegreesToRadians(zone * 6.0 - 183.0);
-        const double& latitude = core::DegreesToRadians(gps_loc.x);
-        const double& longitude = core::DegreesToRadians(gps_loc.y);
-        const double n_t = 2.0 * sqrt(n) / (1.0 + n);
-        double t = sinh(atanh(sin(latitude)) - n_t * atanh(n_t * sin(latitude)));
-        double epsilon_t = atan(t / cos(longitude - lambda_0));
-        double cos_epsilon_t[] = { cos(2.0 * epsilon_t), cos(4.0 * epsilon_t), cos(6.0 * epsilon_t) };
-        double sin_epsilon_t[] = { sin(2.0 * epsilon_t), sin(4.0 * epsilon_t), sin(6.0 * epsilon_t) };
-
-        double eta_t = atanh(sin(longitude - lambda_0) / sqrt(1.0 + t * t));
-        double cosh_eta_t[] = { cosh(2.0 * eta_t), cosh(4.0 * eta_t), cosh(6.0 * eta_t) };
-        double sinh_eta_t[] = { sinh(2.0 * eta_t), sinh(4.0 * eta_t), sinh(6.0 * eta_t) };
-        double sigma = 1.0;
-        double tau = 0.0;
-        for (int i = 0; i < 3; i++)
-        {
-            sigma += 2.0 * i * alpha[i] * cos_epsilon_t[i] * cosh_eta_t[i];
-            tau += 2.0 * i * alpha[i] * sin_epsilon_t[i] * sinh_eta_t[i];
-        }
+    double m_e;             // eccentricity
+    double m_e2m;           // 1 - e^2
+    double m_a1;            // rectifying radius
+    double m_ups_c;         // polar stereographic radius factor
+    double m_alpha[6];      // conformal to rectifying
+    double m_beta[6];       // rectifying to conformal
 
-        core::vec2d utm_loc;
-        utm_loc.x = E0 + k0 * A * (eta_t + alpha[0] * cos_epsilon_t[0] * sinh_eta_t[0]
-            + alpha[1] * cos_epsilon_t[1] * sinh_eta_t[1]
-            + alpha[2] * cos_epsilon_t[2] * sinh_eta_t[2]);
-        utm_loc.y = N0 + k0 * A * (epsilon_t + alpha[0] * sin_epsilon_t[0] * cosh_eta_t[0]
-            + alpha[1] * sin_epsilon_t[1] * cosh_eta_t[1]
-            + alpha[2] * sin_epsilon_t[2] * cosh_eta_t[2]);
+    double taupf(double tau) const;
+    double tauf(double taup) const;
 
-        return utm_loc * 1000.0;
-    }
+public:
+    static constexpr int32_t kUpsZone = 0;
+    static constexpr int32_t kAutoZone = -1;
 
-    core::vec2d ToGeographicCoord(const core::vec2d& utm_loc, int32_t zone) const
-    {
-        double E = utm_loc.x / 1000.0;
-        double N = utm_loc.y / 1000.0;
-
-        double epislon = (N - N0) / (k0 * A);
-        double eta = (E - E0) / (k0 * A);
-
-        core::vec3d cos_epislon(cos(2.0 * epislon), cos(4.0 * epislon), cos(6.0 * epislon));
-        core::vec3d sin_epislon(sin(2.0 * epislon), sin(4.0 * epislon), sin(6.0 * epislon));
-        core::vec3d cosh_eta(cosh(2.0 * eta), cosh(4.0 * eta), cosh(6.0 * eta));
-        core::vec3d sinh_eta(sinh(2.0 * eta), sinh(4.0 * eta), sinh(6.0 * eta));
-        core::vec3d i_t(2.0, 4.0, 6.0);
-
-        double epislon_t = epislon - core::dot(beta * sin_epislon, cosh_eta);
-        double eta_t = eta - core::dot(beta * cos_epislon, sinh_eta);
-        double chi = asin(sin(epislon_t) / cosh(eta_t));
-
-        double phi = chi + core::dot(delta, core::vec3d(sin(2.0 * chi), sin(4.0 * chi), sin(6.0 * chi)));
-        double lambda_0 = zone * 6.0 - 183.0;
-        double lambda = lambda_0 + core::RadiansToDegrees(atan(sinh(eta_t) / cos(epislon_t)));
-        core::vec2d gps_loc;
-        gps_loc.x = core::RadiansToDegrees(phi);
-        gps_loc.y = lambda;
-
-        return gps_loc;
-    }
+    UTMProjector();
+
+    // standard zone of a point, including the norway and svalbard exceptions.
+    static int32_t standard_zone(double lat, double lon);
+
+    // zone and hemisphere shared by most points of the batch.
+    static int32_t common_zone(const core::vec2d* gps_loc, size_t count, bool& northp);
+
+    core::vec2d forward(const core::vec2d& gps_loc, int32_t zone, bool northp) const;
+    core::vec2d reverse(const core::vec2d& utm_loc, int32_t zone, bool northp) const;
+
+    /**
+     * @brief  Project a batch into a single zone, split across hardware threads.
+     *
+     * @param[in]   zone    target zone, kAutoZone picks the common zone of the batch
+     * @param[out]  northp  hemisphere of the result, only an input if zone is given
+     *
+     * @return  The zone used for the whole batch
+     */
+    int32_t forward(const core::vec2d* gps_loc, core::vec2d* utm_loc, size_t count, int32_t zone, bool& northp) const;
+    void reverse(const core::vec2d* utm_loc, core::vec2d* gps_loc, size_t count, int32_t zone, bool northp) const;
+};
+
+/**
+ * @brief  Geoid undulation model loaded from a GeographicLib geoid grid (egm84, egm96,
+ *         egm2008 pgm files). The undulation N is the height of the geoid above the
+ *         WGS84 ellipsoid, so ellipsoidal height h = H + N for an orthometric height H.
+ *         USGS dem heights are orthometric, google earth and lla_to_ecef are ellipsoidal.
+ *         The egm grids are global models, NAVD88 heights are defined by a hybrid geoid
+ *         (GEOID18) fitted to leveling, which departs from egm96 by up to about a meter.
+ */
+class GeoidModel
+{
+    unique_ptr<GeographicLib::Geoid> m_geoid;
+
+public:
+    GeoidModel();
+    ~GeoidModel();
+
+    /**
+     * @param[in]   name    grid name, e.g. "egm96-5", empty for the GeographicLib default
+     * @param[in]   path    directory of the grid files, empty for GEOGRAPHICLIB_GEOID_PATH
+     * @param[in]   cubic   bicubic interpolation if true, bilinear otherwise
+     *
+     * @return  True if the grid was loaded
+     */
+    bool load(const string& name = "", const string& path = "", bool cubic = true);
+    bool is_valid() const { return m_geoid != nullptr; }
+
+    // undulation in meters at (lat, lon) in degrees.
+    double undulation(double lat, double lon) const;
+
+    // batched lookups, split across hardware threads for large inputs.
+    void undulations(const core::GpsCoord* coords, double* result, size_t count) const;
+    void orthometric_to_ellipsoidal(core::GpsCoord* coords, size_t count) const;
+    void ellipsoidal_to_orthometric(core::GpsCoord* coords, size_t count) const;
 };
 
 #define kUseGeographicLib 0
 inline core::vec2d ToGeographicCoord(const core::vec2d& utm_loc, int32_t zone)
 {
 #if kUseGeographicLib == 0
-    UTMConvertor convertor;
-    core::vec2d gps_loc = convertor.ToGeographicCoord(utm_loc, zone);
+    static const UTMProjector projector;
+    core::vec2d gps_loc = projector.reverse(utm_loc, zone, true);
 #else
     core::vec2d gps_loc;
     GeographicLib::UTMUPS::Reverse(zone, true, utm_loc.x, utm_loc.y, gps_loc.x, gps_loc.y);
@@ -598,8 +600,8 @@ inline core::vec2d ToGeographicCoord(const core::vec2d& utm_loc, int32_t zone)
 inline core::vec2d FromGeographicCoord(const core::vec2d& gps_loc, int32_t zone)
 {
 #if kUseGeographicLib == 0
-    UTMConvertor convertor;
-    core::vec2d utm_loc = convertor.FromGeographicCoord(gps_loc, zone);
+    static const UTMProjector projector;
+    core::vec2d utm_loc = projector.forward(gps_loc, zone, true);
 #else
     zone = 0;
     core::vec2d utm_loc;
@@ -610,4 +612,19 @@ inline core::vec2d FromGeographicCoord(const core::vec2d& gps_loc, int32_t zone)
     return utm_loc;
 }
 
+// batched versions, zone and northp are in/out like UTMProjector::forward.
+inline int32_t FromGeographicCoords(const core::vec2d* gps_loc, core::vec2d* utm_loc, size_t count,
+                                    int32_t zone, bool& northp)
+{
+    static const UTMProjector projector;
+    return projector.forward(gps_loc, utm_loc, count, zone, northp);
+}
+
+inline void ToGeographicCoords(const core::vec2d* utm_loc, core::vec2d* gps_loc, size_t count,
+                               int32_t zone, bool northp = true)
+{
+    static const UTMProjector projector;
+    projector.reverse(utm_loc, gps_loc, count, zone, northp);
+}
+
 };
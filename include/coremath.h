@@ -3,6 +3,7 @@
 #include "corematrix.h"
 #include "corequaternion.h"
 #include "corebounds.h"
+#include "coresimd.h"
 
 namespace core
 {
@@ -541,29 +541,22 @@ public:
         return v;
     }
 
-    matrix4 & operator *= ( const matrix4 & rhs ) {
-        matrix4 mt(*this);
-        set_value(T(0));
-
-        for(int32_t i=0; i < 4; i++)
-            for(int32_t j=0; j < 4; j++)
-                for(int32_t c=0; c < 4; c++)
-                    element(i,j) += mt(i,c) * rhs(c,j);
-        return *this;
-    }
+    // scalar reference kernels, float and double have simd
+    // specializations in coresimd.h.
 
-    friend matrix4 operator * ( const matrix4 & lhs, const matrix4 & rhs ) {
+    // this = lhs * rhs, safe if this aliases lhs or rhs.
+    void set_product( const matrix4 & lhs, const matrix4 & rhs ) {
         matrix4 r(T(0));
 
         for(int32_t i=0; i < 4; i++)
             for(int32_t j=0; j < 4; j++)
                 for(int32_t c=0; c < 4; c++)
                     r.element(i,j) += lhs(i,c) * rhs(c,j);
-        return r;
+        *this = r;
     }
 
     // dst = M * src
-    vec4<T> operator *( const vec4<T> &src) const {
+    vec4<T> transform( const vec4<T> &src ) const {
         vec4<T> r;
         for ( int32_t i = 0; i < 4; i++)
             r[i]  = ( src[0] * element(i,0) + src[1] * element(i,1) +
@@ -572,14 +565,35 @@ public:
     }
 
     // dst = src * M
-    friend vec4<T> operator *( const vec4<T> &lhs, const matrix4 &rhs) {
+    vec4<T> transform_transposed( const vec4<T> &src ) const {
         vec4<T> r;
         for ( int32_t i = 0; i < 4; i++)
-            r[i]  = ( lhs[0] * rhs.element(0,i) + lhs[1] * rhs.element(1,i) +
-                      lhs[2] * rhs.element(2,i) + lhs[3] * rhs.element(3,i));
+            r[i]  = ( src[0] * element(0,i) + src[1] * element(1,i) +
+                      src[2] * element(2,i) + src[3] * element(3,i));
+        return r;
+    }
+
+    matrix4 & operator *= ( const matrix4 & rhs ) {
+        set_product(*this, rhs);
+        return *this;
+    }
+
+    friend matrix4 operator * ( const matrix4 & lhs, const matrix4 & rhs ) {
+        matrix4 r(T(0));
+        r.set_product(lhs, rhs);
         return r;
     }
 
+    // dst = M * src
+    vec4<T> operator *( const vec4<T> &src) const {
+        return transform(src);
+    }
+
+    // dst = src * M
+    friend vec4<T> operator *( const vec4<T> &lhs, const matrix4 &rhs) {
+        return rhs.transform_transposed(lhs);
+    }
+
     T & operator () (int32_t row, int32_t col) {
         return element(row,col);
     }
@@ -651,8 +665,9 @@ public:
 //   Not actually declared friends due to VC's template handling
 //
 //////////////////////////////////////////////////////////////////////
+// gaussian elimination with partial pivoting, the generic inverse.
 template<class T>
-matrix4<T> inverse( const matrix4<T> & m) {
+matrix4<T> InverseGaussian( const matrix4<T> & m) {
     matrix4<T> minv;
 
     T r1[8], r2[8], r3[8], r4[8];
@@ -745,6 +760,12 @@ matrix4<T> inverse( const matrix4<T> & m) {
     return minv;
 }
 
+// float and double specialize this in coresimd.h.
+template<class T>
+matrix4<T> inverse( const matrix4<T> & m) {
+    return InverseGaussian(m);
+}
+
 
 //
 // transpose
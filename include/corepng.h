@@ -0,0 +1,38 @@
+#pragma once
+#include "base.h"
+
+namespace core
+{
+
+enum PngFilter
+{
+    kPngFilterNone,
+    kPngFilterSub,
+    kPngFilterUp,
+    kPngFilterAverage,
+    kPngFilterPaeth,
+    kPngFilterAdaptive,     // per row, the filter with the smallest sum of absolute bytes
+};
+
+/**
+ * @brief  Encode an 8 or 16 bit gray, gray alpha, rgb or rgba image as png. Rows are
+ *         filtered and deflated in independent chunks across hardware threads; each
+ *         chunk is primed with the 32k before it and ends on a sync flush, so the
+ *         pieces join into one zlib stream any decoder reads.
+ *
+ * @param  src_data       Top row first, pitch bytes apart. 16 bit samples are uint16_t
+ *                        in native byte order
+ * @param  channel_count  1 gray, 2 gray alpha, 3 rgb, 4 rgba
+ * @param  bgr_order      Source stores b g r (a), as opencv does
+ * @return  False for unsupported layouts or a zlib failure
+ */
+bool EncodePngImage(const void* src_data, uint32_t w, uint32_t h, size_t pitch,
+                    uint32_t channel_count, uint32_t bit_depth, bool bgr_order,
+                    vector<uint8_t>& png_data,
+                    PngFilter filter = kPngFilterAdaptive, int32_t compression_level = 6);
+
+bool ExportPngFile(const string& file_name, const void* src_data, uint32_t w, uint32_t h, size_t pitch,
+                   uint32_t channel_count, uint32_t bit_depth, bool bgr_order,
+                   PngFilter filter = kPngFilterAdaptive, int32_t compression_level = 6);
+
+};
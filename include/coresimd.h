@@ -0,0 +1,450 @@
+#pragma once
+#include "corevector.h"
+#include "corematrix.h"
+#include "corebounds.h"
+
+// simd backend is selected at build time from the compiler target flags,
+// define CORE_SIMD_SCALAR to force the scalar reference templates.
+#if !defined(CORE_SIMD_SCALAR)
+#  if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    define CORE_SIMD_SSE 1
+#    include <emmintrin.h>
+#    if defined(__AVX__)
+#      define CORE_SIMD_AVX 1
+#      include <immintrin.h>
+#    endif
+#  elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#    define CORE_SIMD_NEON 1
+#    include <arm_neon.h>
+#    if defined(__aarch64__) || defined(_M_ARM64)
+#      define CORE_SIMD_NEON64 1
+#    endif
+#  endif
+#endif
+
+namespace core
+{
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Scalar reference kernels
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// dst[i] = m * vec4(src[i], 1)
+template<class T, class S>
+void TransformPoints(const matrix4<T>& m, const vec3<S>* src, vec4<T>* dst, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        const vec3<S>& p = src[i];
+        for (int32_t r = 0; r < 4; r++)
+        {
+            dst[i][r] = T(p.x) * m(r, 0) + T(p.y) * m(r, 1) + T(p.z) * m(r, 2) + m(r, 3);
+        }
+    }
+}
+
+// dst[i] = (vec4(src[i], 1) * m).xyz, same convention as ApplyMatrix.
+template<class T, class S>
+void TransformPointsAffine(const vec3<S>* src, size_t count, const matrix4<T>& m, vec3<T>* dst)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        const vec3<S>& p = src[i];
+        for (int32_t c = 0; c < 3; c++)
+        {
+            dst[i][c] = T(p.x) * m(0, c) + T(p.y) * m(1, c) + T(p.z) * m(2, c) + m(3, c);
+        }
+    }
+}
+
+// the 8 corners of bbox transformed by m, w is kept for clipping.
+template<class T>
+void TransformBounds(const matrix4<T>& m, const bounds3<T>& bbox, vec4<T> corners[8])
+{
+    vec3<T> p[8];
+    for (int32_t i = 0; i < 8; i++)
+    {
+        p[i] = vec3<T>((i & 1) ? bbox.bb_max.x : bbox.bb_min.x,
+                       (i & 2) ? bbox.bb_max.y : bbox.bb_min.y,
+                       (i & 4) ? bbox.bb_max.z : bbox.bb_min.z);
+    }
+
+    TransformPoints(m, p, corners, 8);
+}
+
+// axis aligned bounds of bbox under the affine part of m (column convention).
+template<class T>
+bounds3<T> TransformBoundsAffine(const matrix4<T>& m, const bounds3<T>& bbox)
+{
+    bounds3<T> r;
+    for (int32_t i = 0; i < 3; i++)
+    {
+        T v_min = m(i, 3);
+        T v_max = m(i, 3);
+        for (int32_t j = 0; j < 3; j++)
+        {
+            T a = m(i, j) * bbox.bb_min[j];
+            T b = m(i, j) * bbox.bb_max[j];
+            v_min += a < b ? a : b;
+            v_max += a < b ? b : a;
+        }
+        r.bb_min[i] = v_min;
+        r.bb_max[i] = v_max;
+    }
+    r.b_valid = bbox.b_valid;
+
+    return r;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Simd lanes
+//
+////////////////////////////////////////////////////////////////////////////////
+namespace simd
+{
+
+#if defined(CORE_SIMD_SSE)
+
+#define CORE_SIMD_FLOAT4 1
+#define CORE_SIMD_DOUBLE4 1
+
+struct float4 { __m128 v; };
+inline float4 load4(const float* p) { return { _mm_loadu_ps(p) }; }
+inline void store4(float* p, float4 a) { _mm_storeu_ps(p, a.v); }
+inline float4 splat4(float s) { return { _mm_set1_ps(s) }; }
+inline float4 operator + (float4 a, float4 b) { return { _mm_add_ps(a.v, b.v) }; }
+inline float4 operator * (float4 a, float4 b) { return { _mm_mul_ps(a.v, b.v) }; }
+inline float4 min4(float4 a, float4 b) { return { _mm_min_ps(a.v, b.v) }; }
+inline float4 max4(float4 a, float4 b) { return { _mm_max_ps(a.v, b.v) }; }
+inline float4 operator - (float4 a, float4 b) { return { _mm_sub_ps(a.v, b.v) }; }
+// masks are all bits set in the lanes where the compare holds.
+inline float4 cmpge4(float4 a, float4 b) { return { _mm_cmpge_ps(a.v, b.v) }; }
+inline float4 and4(float4 a, float4 b) { return { _mm_and_ps(a.v, b.v) }; }
+inline float4 select4(float4 mask, float4 a, float4 b) { return { _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)) }; }
+
+#if defined(CORE_SIMD_AVX)
+struct double4 { __m256d v; };
+inline double4 load4(const double* p) { return { _mm256_loadu_pd(p) }; }
+inline void store4(double* p, double4 a) { _mm256_storeu_pd(p, a.v); }
+inline double4 splat4(double s) { return { _mm256_set1_pd(s) }; }
+inline double4 operator + (double4 a, double4 b) { return { _mm256_add_pd(a.v, b.v) }; }
+inline double4 operator * (double4 a, double4 b) { return { _mm256_mul_pd(a.v, b.v) }; }
+inline double4 min4(double4 a, double4 b) { return { _mm256_min_pd(a.v, b.v) }; }
+inline double4 max4(double4 a, double4 b) { return { _mm256_max_pd(a.v, b.v) }; }
+#else
+struct double4 { __m128d lo, hi; };
+inline double4 load4(const double* p) { return { _mm_loadu_pd(p), _mm_loadu_pd(p + 2) }; }
+inline void store4(double* p, double4 a) { _mm_storeu_pd(p, a.lo); _mm_storeu_pd(p + 2, a.hi); }
+inline double4 splat4(double s) { return { _mm_set1_pd(s), _mm_set1_pd(s) }; }
+inline double4 operator + (double4 a, double4 b) { return { _mm_add_pd(a.lo, b.lo), _mm_add_pd(a.hi, b.hi) }; }
+inline double4 operator * (double4 a, double4 b) { return { _mm_mul_pd(a.lo, b.lo), _mm_mul_pd(a.hi, b.hi) }; }
+inline double4 min4(double4 a, double4 b) { return { _mm_min_pd(a.lo, b.lo), _mm_min_pd(a.hi, b.hi) }; }
+inline double4 max4(double4 a, double4 b) { return { _mm_max_pd(a.lo, b.lo), _mm_max_pd(a.hi, b.hi) }; }
+#endif
+
+#elif defined(CORE_SIMD_NEON)
+
+#define CORE_SIMD_FLOAT4 1
+
+struct float4 { float32x4_t v; };
+inline float4 load4(const float* p) { return { vld1q_f32(p) }; }
+inline void store4(float* p, float4 a) { vst1q_f32(p, a.v); }
+inline float4 splat4(float s) { return { vdupq_n_f32(s) }; }
+inline float4 operator + (float4 a, float4 b) { return { vaddq_f32(a.v, b.v) }; }
+inline float4 operator * (float4 a, float4 b) { return { vmulq_f32(a.v, b.v) }; }
+inline float4 min4(float4 a, float4 b) { return { vminq_f32(a.v, b.v) }; }
+inline float4 max4(float4 a, float4 b) { return { vmaxq_f32(a.v, b.v) }; }
+inline float4 operator - (float4 a, float4 b) { return { vsubq_f32(a.v, b.v) }; }
+inline float4 cmpge4(float4 a, float4 b) { return { vreinterpretq_f32_u32(vcgeq_f32(a.v, b.v)) }; }
+inline float4 and4(float4 a, float4 b) { return { vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a.v), vreinterpretq_u32_f32(b.v))) }; }
+inline float4 select4(float4 mask, float4 a, float4 b) { return { vbslq_f32(vreinterpretq_u32_f32(mask.v), a.v, b.v) }; }
+
+#if defined(CORE_SIMD_NEON64)
+#define CORE_SIMD_DOUBLE4 1
+
+struct double4 { float64x2_t lo, hi; };
+inline double4 load4(const double* p) { return { vld1q_f64(p), vld1q_f64(p + 2) }; }
+inline void store4(double* p, double4 a) { vst1q_f64(p, a.lo); vst1q_f64(p + 2, a.hi); }
+inline double4 splat4(double s) { return { vdupq_n_f64(s), vdupq_n_f64(s) }; }
+inline double4 operator + (double4 a, double4 b) { return { vaddq_f64(a.lo, b.lo), vaddq_f64(a.hi, b.hi) }; }
+inline double4 operator * (double4 a, double4 b) { return { vmulq_f64(a.lo, b.lo), vmulq_f64(a.hi, b.hi) }; }
+inline double4 min4(double4 a, double4 b) { return { vminq_f64(a.lo, b.lo), vminq_f64(a.hi, b.hi) }; }
+inline double4 max4(double4 a, double4 b) { return { vmaxq_f64(a.lo, b.lo), vmaxq_f64(a.hi, b.hi) }; }
+#endif
+
+#endif
+
+template<class T> struct lanes {};
+#if defined(CORE_SIMD_FLOAT4)
+template<> struct lanes<float> { typedef float4 type; };
+#endif
+#if defined(CORE_SIMD_DOUBLE4)
+template<> struct lanes<double> { typedef double4 type; };
+#endif
+
+// the lane kernels below accumulate in the same order as the scalar
+// reference, so results only differ where the compiler contracts to fma.
+
+template<class T>
+void SetProduct(matrix4<T>& r, const matrix4<T>& lhs, const matrix4<T>& rhs)
+{
+    typedef typename lanes<T>::type V;
+    V c0 = load4(&lhs._array[0]);
+    V c1 = load4(&lhs._array[4]);
+    V c2 = load4(&lhs._array[8]);
+    V c3 = load4(&lhs._array[12]);
+
+    V col[4];
+    for (int32_t j = 0; j < 4; j++)
+    {
+        col[j] = c0 * splat4(rhs(0, j)) + c1 * splat4(rhs(1, j)) + c2 * splat4(rhs(2, j)) + c3 * splat4(rhs(3, j));
+    }
+
+    for (int32_t j = 0; j < 4; j++)
+    {
+        store4(&r._array[j * 4], col[j]);
+    }
+}
+
+template<class T>
+vec4<T> Transform(const matrix4<T>& m, const vec4<T>& v)
+{
+    vec4<T> r;
+    store4(r._array, load4(&m._array[0]) * splat4(v.x) + load4(&m._array[4]) * splat4(v.y) +
+                     load4(&m._array[8]) * splat4(v.z) + load4(&m._array[12]) * splat4(v.w));
+    return r;
+}
+
+template<class T>
+void LoadRows(const matrix4<T>& m, typename lanes<T>::type rows[4])
+{
+    T t[16];
+    for (int32_t i = 0; i < 4; i++)
+        for (int32_t j = 0; j < 4; j++)
+            t[i * 4 + j] = m(i, j);
+
+    for (int32_t i = 0; i < 4; i++)
+    {
+        rows[i] = load4(&t[i * 4]);
+    }
+}
+
+template<class T>
+vec4<T> TransformTransposed(const matrix4<T>& m, const vec4<T>& v)
+{
+    typedef typename lanes<T>::type V;
+    V rows[4];
+    LoadRows(m, rows);
+
+    vec4<T> r;
+    store4(r._array, rows[0] * splat4(v.x) + rows[1] * splat4(v.y) + rows[2] * splat4(v.z) + rows[3] * splat4(v.w));
+    return r;
+}
+
+template<class T, class S>
+void TransformPoints(const matrix4<T>& m, const vec3<S>* src, vec4<T>* dst, size_t count)
+{
+    typedef typename lanes<T>::type V;
+    V c0 = load4(&m._array[0]);
+    V c1 = load4(&m._array[4]);
+    V c2 = load4(&m._array[8]);
+    V c3 = load4(&m._array[12]);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        store4(dst[i]._array, c0 * splat4(T(src[i].x)) + c1 * splat4(T(src[i].y)) + c2 * splat4(T(src[i].z)) + c3);
+    }
+}
+
+template<class T, class S>
+void TransformPointsAffine(const vec3<S>* src, size_t count, const matrix4<T>& m, vec3<T>* dst)
+{
+    typedef typename lanes<T>::type V;
+    V rows[4];
+    LoadRows(m, rows);
+
+    T t[4];
+    for (size_t i = 0; i < count; i++)
+    {
+        // vec3 is 3 wide, go through a temporary to not write past dst.
+        store4(t, rows[0] * splat4(T(src[i].x)) + rows[1] * splat4(T(src[i].y)) + rows[2] * splat4(T(src[i].z)) + rows[3]);
+        dst[i].x = t[0];
+        dst[i].y = t[1];
+        dst[i].z = t[2];
+    }
+}
+
+template<class T>
+bounds3<T> TransformBoundsAffine(const matrix4<T>& m, const bounds3<T>& bbox)
+{
+    typedef typename lanes<T>::type V;
+    V v_min = load4(&m._array[12]);
+    V v_max = v_min;
+    for (int32_t j = 0; j < 3; j++)
+    {
+        V col = load4(&m._array[j * 4]);
+        V a = col * splat4(bbox.bb_min[j]);
+        V b = col * splat4(bbox.bb_max[j]);
+        v_min = v_min + min4(a, b);
+        v_max = v_max + max4(a, b);
+    }
+
+    T t_min[4], t_max[4];
+    store4(t_min, v_min);
+    store4(t_max, v_max);
+
+    bounds3<T> r;
+    r.bb_min = vec3<T>(t_min[0], t_min[1], t_min[2]);
+    r.bb_max = vec3<T>(t_max[0], t_max[1], t_max[2]);
+    r.b_valid = bbox.b_valid;
+
+    return r;
+}
+
+} // namespace simd
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Simd specializations
+//
+////////////////////////////////////////////////////////////////////////////////
+#if defined(CORE_SIMD_FLOAT4)
+template<> inline void matrix4<float>::set_product(const matrix4<float>& lhs, const matrix4<float>& rhs)
+{
+    simd::SetProduct(*this, lhs, rhs);
+}
+
+template<> inline vec4<float> matrix4<float>::transform(const vec4<float>& src) const
+{
+    return simd::Transform(*this, src);
+}
+
+template<> inline vec4<float> matrix4<float>::transform_transposed(const vec4<float>& src) const
+{
+    return simd::TransformTransposed(*this, src);
+}
+
+template<class S>
+void TransformPoints(const matrix4<float>& m, const vec3<S>* src, vec4<float>* dst, size_t count)
+{
+    simd::TransformPoints(m, src, dst, count);
+}
+
+template<class S>
+void TransformPointsAffine(const vec3<S>* src, size_t count, const matrix4<float>& m, vec3<float>* dst)
+{
+    simd::TransformPointsAffine(src, count, m, dst);
+}
+
+inline bounds3<float> TransformBoundsAffine(const matrix4<float>& m, const bounds3<float>& bbox)
+{
+    return simd::TransformBoundsAffine(m, bbox);
+}
+#endif
+
+#if defined(CORE_SIMD_DOUBLE4)
+template<> inline void matrix4<double>::set_product(const matrix4<double>& lhs, const matrix4<double>& rhs)
+{
+    simd::SetProduct(*this, lhs, rhs);
+}
+
+template<> inline vec4<double> matrix4<double>::transform(const vec4<double>& src) const
+{
+    return simd::Transform(*this, src);
+}
+
+template<> inline vec4<double> matrix4<double>::transform_transposed(const vec4<double>& src) const
+{
+    return simd::TransformTransposed(*this, src);
+}
+
+template<class S>
+void TransformPoints(const matrix4<double>& m, const vec3<S>* src, vec4<double>* dst, size_t count)
+{
+    simd::TransformPoints(m, src, dst, count);
+}
+
+template<class S>
+void TransformPointsAffine(const vec3<S>* src, size_t count, const matrix4<double>& m, vec3<double>* dst)
+{
+    simd::TransformPointsAffine(src, count, m, dst);
+}
+
+inline bounds3<double> TransformBoundsAffine(const matrix4<double>& m, const bounds3<double>& bbox)
+{
+    return simd::TransformBoundsAffine(m, bbox);
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Inverse
+//
+//  float and double use the closed form adjugate instead of the pivoting
+//  gaussian elimination, it is branch free and the compiler vectorizes the
+//  independent cofactor products. singular matrices still return identity.
+//
+////////////////////////////////////////////////////////////////////////////////
+template<class T>
+matrix4<T> InverseAdjugate(const matrix4<T>& m)
+{
+    T s0 = m(0,0) * m(1,1) - m(1,0) * m(0,1);
+    T s1 = m(0,0) * m(1,2) - m(1,0) * m(0,2);
+    T s2 = m(0,0) * m(1,3) - m(1,0) * m(0,3);
+    T s3 = m(0,1) * m(1,2) - m(1,1) * m(0,2);
+    T s4 = m(0,1) * m(1,3) - m(1,1) * m(0,3);
+    T s5 = m(0,2) * m(1,3) - m(1,2) * m(0,3);
+
+    T c5 = m(2,2) * m(3,3) - m(3,2) * m(2,3);
+    T c4 = m(2,1) * m(3,3) - m(3,1) * m(2,3);
+    T c3 = m(2,1) * m(3,2) - m(3,1) * m(2,2);
+    T c2 = m(2,0) * m(3,3) - m(3,0) * m(2,3);
+    T c1 = m(2,0) * m(3,2) - m(3,0) * m(2,2);
+    T c0 = m(2,0) * m(3,1) - m(3,0) * m(2,1);
+
+    T det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+
+    matrix4<T> minv;
+    if (det == T(0))
+        return minv; // singular matrix!
+
+    T inv_det = T(1) / det;
+
+    minv(0,0) = ( m(1,1) * c5 - m(1,2) * c4 + m(1,3) * c3) * inv_det;
+    minv(0,1) = (-m(0,1) * c5 + m(0,2) * c4 - m(0,3) * c3) * inv_det;
+    minv(0,2) = ( m(3,1) * s5 - m(3,2) * s4 + m(3,3) * s3) * inv_det;
+    minv(0,3) = (-m(2,1) * s5 + m(2,2) * s4 - m(2,3) * s3) * inv_det;
+
+    minv(1,0) = (-m(1,0) * c5 + m(1,2) * c2 - m(1,3) * c1) * inv_det;
+    minv(1,1) = ( m(0,0) * c5 - m(0,2) * c2 + m(0,3) * c1) * inv_det;
+    minv(1,2) = (-m(3,0) * s5 + m(3,2) * s2 - m(3,3) * s1) * inv_det;
+    minv(1,3) = ( m(2,0) * s5 - m(2,2) * s2 + m(2,3) * s1) * inv_det;
+
+    minv(2,0) = ( m(1,0) * c4 - m(1,1) * c2 + m(1,3) * c0) * inv_det;
+    minv(2,1) = (-m(0,0) * c4 + m(0,1) * c2 - m(0,3) * c0) * inv_det;
+    minv(2,2) = ( m(3,0) * s4 - m(3,1) * s2 + m(3,3) * s0) * inv_det;
+    minv(2,3) = (-m(2,0) * s4 + m(2,1) * s2 - m(2,3) * s0) * inv_det;
+
+    minv(3,0) = (-m(1,0) * c3 + m(1,1) * c1 - m(1,2) * c0) * inv_det;
+    minv(3,1) = ( m(0,0) * c3 - m(0,1) * c1 + m(0,2) * c0) * inv_det;
+    minv(3,2) = (-m(3,0) * s3 + m(3,1) * s1 - m(3,2) * s0) * inv_det;
+    minv(3,3) = ( m(2,0) * s3 - m(2,1) * s1 + m(2,2) * s0) * inv_det;
+
+    return minv;
+}
+
+// not behind the simd guards, scalar builds must invert to the same values.
+template<> inline matrix4<float> inverse(const matrix4<float>& m)
+{
+    return InverseAdjugate(m);
+}
+
+template<> inline matrix4<double> inverse(const matrix4<double>& m)
+{
+    return InverseAdjugate(m);
+}
+
+}
@@ -219,6 +219,10 @@ struct Dxt1Convertor
 {
     void CompressImageDXT1( const uint8_t *inBuf, int width, int height, int channels, bool flipChannel, int &outputBytes, uint8_t *outBuf );
     static void DecodeDxt1Texture(uint32_t* dst_iamge_buffer, uint32_t w, uint32_t h, const uint8_t* dxt_src);
+    // same colors as DecodeDxt1Texture written as packed 3 or 4 channel rows, r g b (a) or
+    // b g r (a), bottom row first if flip_y. split across hardware threads for large images.
+    static void DecodeDxt1Image(uint8_t* dst_image_buffer, uint32_t w, uint32_t h, const uint8_t* dxt_src,
+                                uint32_t channel_count, bool bgr_order, bool flip_y);
 
 private:
     void ExtractBlock( const uint8_t *inPtr, int width, int channels, uint8_t *colorBlock );
@@ -278,4 +282,25 @@ void ExportBmpImageFile(const string& file_name, const char* src_buffer, uint32_
 void ExportBmpImageFile(const core::Texture2DInfo* texture_info, core::TextureFileInfo* tex_file_info);
 void ExportDdsImageFile(const core::Texture2DInfo* texture_info, core::TextureFileInfo* tex_file_info);
 
+enum MipFilter
+{
+    kMipFilterBox,          // exact area average, also for odd sizes
+    kMipFilterKaiser,       // kaiser windowed sinc, 3 lobes, sharper
+};
+
+// one level as rgba8 rows, dxt1/3/5 and bc4/5/7 are decoded. false for other formats.
+bool DecodeTextureLevel(const core::Texture2DInfo* texture_info, uint32_t level, vector<uint8_t>& rgba_data);
+
+/**
+ * @brief  Copy level 0 of src_info into dst_info and build the remaining levels down
+ *         to 1x1. Each level is filtered from the previous one in linear space (srgb
+ *         color, linear alpha), sizes are halved and rounded down so non power of two
+ *         textures work, and levels are encoded back to the source format (dxt1/3/5,
+ *         bc4/5/7, rgb or rgba) with the block rows split across threads. bc4/bc5
+ *         are treated as linear data.
+ *
+ * @return  False if the source format is not supported
+ */
+bool BuildMipChain(const core::Texture2DInfo* src_info, core::Texture2DInfo* dst_info, MipFilter filter = kMipFilterKaiser);
+
 };
@@ -0,0 +1,164 @@
+#pragma once
+#include "base.h"
+#include <thread>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+namespace core
+{
+// number of worker threads used by the batched kernels.
+inline uint32_t GetNumWorkerThreads()
+{
+    uint32_t num_threads = thread::hardware_concurrency();
+    return num_threads == 0 ? 1 : num_threads;
+}
+
+// split [0, count) in contiguous ranges and run func(begin, end) on each,
+// ranges smaller than min_batch_size are not worth a thread and run inline.
+inline void ParallelFor(size_t count, size_t min_batch_size, const function<void(size_t, size_t)>& func)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    size_t num_batches = min(size_t(GetNumWorkerThreads()), (count + min_batch_size - 1) / max(min_batch_size, size_t(1)));
+    if (num_batches <= 1)
+    {
+        func(0, count);
+        return;
+    }
+
+    size_t batch_size = (count + num_batches - 1) / num_batches;
+    vector<thread> workers;
+    workers.reserve(num_batches - 1);
+    for (size_t i = 1; i < num_batches; i++)
+    {
+        size_t begin = i * batch_size;
+        size_t end = min(begin + batch_size, count);
+        if (begin < end)
+        {
+            workers.emplace_back(func, begin, end);
+        }
+    }
+
+    func(0, min(batch_size, count));
+
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+// threads started once and kept for kernels that run every frame, where starting them
+// per call as ParallelFor does costs more than the work. one run at a time.
+class WorkerPool
+{
+    vector<thread>              workers_;
+    mutex                       mutex_;
+    mutex                       run_mutex_;
+    condition_variable          work_cv_;
+    condition_variable          done_cv_;
+    const function<void(size_t)>* job_;
+    size_t                      num_jobs_;
+    atomic<size_t>              next_job_;
+    uint32_t                    num_busy_;
+    uint64_t                    generation_;
+    bool                        b_stop_;
+
+    void run_jobs()
+    {
+        for (size_t i = next_job_++; i < num_jobs_; i = next_job_++)
+        {
+            (*job_)(i);
+        }
+    }
+
+    void work()
+    {
+        uint64_t generation = 0;
+        for (;;)
+        {
+            {
+                unique_lock<mutex> lock(mutex_);
+                work_cv_.wait(lock, [&]() { return b_stop_ || generation_ != generation; });
+                if (b_stop_)
+                {
+                    return;
+                }
+                generation = generation_;
+            }
+
+            run_jobs();
+
+            lock_guard<mutex> lock(mutex_);
+            if (--num_busy_ == 0)
+            {
+                done_cv_.notify_one();
+            }
+        }
+    }
+
+public:
+    // num_threads counts the calling thread, 0 is one per core.
+    explicit WorkerPool(uint32_t num_threads = 0) : job_(nullptr), num_jobs_(0), next_job_(0), num_busy_(0), generation_(0), b_stop_(false)
+    {
+        num_threads = num_threads == 0 ? GetNumWorkerThreads() : num_threads;
+        for (uint32_t i = 1; i < num_threads; i++)
+        {
+            workers_.emplace_back(&WorkerPool::work, this);
+        }
+    }
+
+    ~WorkerPool()
+    {
+        {
+            lock_guard<mutex> lock(mutex_);
+            b_stop_ = true;
+        }
+        work_cv_.notify_all();
+        for (auto& worker : workers_)
+        {
+            worker.join();
+        }
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    uint32_t get_num_threads() const { return uint32_t(workers_.size()) + 1; }
+
+    // func(i) for every i in [0, count), on the workers and the calling thread, in any
+    // order. returns once all are done.
+    void run(size_t count, const function<void(size_t)>& func)
+    {
+        if (workers_.empty() || count <= 1)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                func(i);
+            }
+            return;
+        }
+
+        lock_guard<mutex> run_lock(run_mutex_);
+        {
+            lock_guard<mutex> lock(mutex_);
+            job_ = &func;
+            num_jobs_ = count;
+            next_job_ = 0;
+            num_busy_ = uint32_t(workers_.size());
+            generation_++;
+        }
+        work_cv_.notify_all();
+
+        run_jobs();
+
+        unique_lock<mutex> lock(mutex_);
+        done_cv_.wait(lock, [&]() { return num_busy_ == 0; });
+        job_ = nullptr;
+    }
+};
+}
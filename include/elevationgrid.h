@@ -0,0 +1,187 @@
+#pragma once
+#include <list>
+#include <unordered_map>
+#include "coremath.h"
+
+class HFABand;
+class BoundsGridIndex;
+
+// default memory budget for cached elevation blocks, per cache.
+constexpr size_t kDefaultElevationCacheSize = 64 * 1024 * 1024;
+
+// lru cache of raster blocks under one memory budget. grids opened on the same cache,
+// the tiles of a mosaic, share the budget instead of each keeping its own. not thread
+// safe, like the grids using it.
+class ElevationBlockCache
+{
+    struct CachedBlock
+    {
+        uint64_t            key;            // grid id in the high bits, block index in the low
+        size_t              num_heights;
+        unique_ptr<float[]> height_list;
+    };
+
+    size_t                  memory_cap_;
+    size_t                  memory_used_;
+    uint32_t                next_grid_id_;
+    uint64_t                num_evictions_;
+    list<CachedBlock>       cached_blocks_;
+    unordered_map<uint64_t, list<CachedBlock>::iterator> block_lookup_;
+
+public:
+    explicit ElevationBlockCache(size_t memory_cap = kDefaultElevationCacheSize);
+
+    ElevationBlockCache(const ElevationBlockCache&) = delete;
+    ElevationBlockCache& operator=(const ElevationBlockCache&) = delete;
+
+    // id telling the blocks of one grid apart from the others'.
+    uint32_t add_grid() { return next_grid_id_++; }
+
+    // null if not cached, a hit becomes the most recently used block.
+    float* find(uint32_t grid_id, int block_idx);
+    // room for a block, least recently used blocks go while the budget is exceeded.
+    float* insert(uint32_t grid_id, int block_idx, size_t num_heights);
+    // drops the blocks of one grid.
+    void erase(uint32_t grid_id);
+    void clear();
+
+    size_t get_memory_cap() const { return memory_cap_; }
+    size_t get_memory_used() const { return memory_used_; }
+    // changes whenever a block is dropped, block pointers stay valid until it does.
+    uint64_t get_num_evictions() const { return num_evictions_; }
+};
+
+// out-of-core view of one float band of an HFA elevation raster. raster blocks
+// are read from disk on demand and kept in a block cache bounded by a memory cap,
+// so only the blocks touched by the current sweep need to be resident.
+class ElevationGrid
+{
+    void*                   hfa_handle_;
+    HFABand*                band_;
+    int                     x_size_;
+    int                     y_size_;
+    int                     block_x_size_;
+    int                     block_y_size_;
+    int                     blocks_per_row_;
+    int                     blocks_per_column_;
+    shared_ptr<ElevationBlockCache> cache_;
+    uint32_t                grid_id_;
+    int                     last_block_idx_;
+    const float*            last_block_;
+    uint64_t                last_num_evictions_;
+    uint64_t                num_block_loads_;
+
+    const float* load_block(int b_x, int b_y);
+
+public:
+    ElevationGrid();
+    ~ElevationGrid();
+
+    ElevationGrid(const ElevationGrid&) = delete;
+    ElevationGrid& operator=(const ElevationGrid&) = delete;
+
+    // band_idx is 1 based like HFAGetBandInfo. without a cache the grid gets its own
+    // with the default budget.
+    bool open(const string& file_name, int band_idx, const shared_ptr<ElevationBlockCache>& cache = nullptr);
+    void close();
+
+    bool is_valid() const { return band_ != nullptr; }
+    int get_x_size() const { return x_size_; }
+    int get_y_size() const { return y_size_; }
+    uint64_t get_num_block_loads() const { return num_block_loads_; }
+
+    // samples outside of the raster are clamped to the edge.
+    float get_height(int x, int y)
+    {
+        x = x < 0 ? 0 : (x >= x_size_ ? x_size_ - 1 : x);
+        y = y < 0 ? 0 : (y >= y_size_ ? y_size_ - 1 : y);
+
+        int b_x = x / block_x_size_;
+        int b_y = y / block_y_size_;
+        // another grid on the cache may have evicted the last block.
+        const float* block = (last_block_ && last_block_idx_ == b_y * blocks_per_row_ + b_x &&
+                              last_num_evictions_ == cache_->get_num_evictions()) ?
+                                 last_block_ : load_block(b_x, b_y);
+
+        return block[(y - b_y * block_y_size_) * block_x_size_ + (x - b_x * block_x_size_)];
+    }
+
+    // drop the cached blocks of this grid, next access reloads from disk.
+    void flush();
+};
+
+// width in pixels over which a raster fades out toward its edge where rasters overlap.
+constexpr double kDefaultElevationFeatherSize = 8.0;
+
+// several elevation rasters seen as one surface. rasters sharing a pixel size and a
+// pixel aligned corner are put on one lattice of nodes; where two of them overlap or
+// touch, each owns the nodes up to the middle of the overlap and both own the middle
+// line, so meshes built raster by raster share their boundary vertices. where only one
+// of them spans the other's side, that one keeps the whole overlap. heights are
+// blended by the distance to each raster's edge, continuous across the seams.
+class ElevationMosaic
+{
+    struct Tile
+    {
+        shared_ptr<ElevationGrid> grid;
+        core::vec2d         ul_corner;      // center of the upper left pixel
+        core::vec2d         pixel_size;     // y negative, rows go south
+        core::vec2i         pixel_count;
+        core::vec2i         lattice_ofs;    // node of the upper left pixel
+        bool                aligned;
+        core::vec2i         owned_min;      // lattice nodes meshed by this tile, inclusive
+        core::vec2i         owned_max;
+    };
+
+    vector<Tile>            tiles_;
+    core::vec2d             origin_;
+    core::vec2d             pixel_size_;
+    double                  feather_size_;
+    shared_ptr<ElevationBlockCache> cache_;
+    unique_ptr<BoundsGridIndex> tile_index_;    // tile bounds, made by build
+    mutable vector<uint32_t> candidate_list_;
+
+    float lookup_height(Tile& tile, const core::vec2d& s) const;
+    // tiles whose bounds may hold pos, every tile before build.
+    const vector<uint32_t>& find_tiles(const core::vec2d& pos) const;
+
+public:
+    ElevationMosaic(size_t memory_cap = kDefaultElevationCacheSize);
+    ~ElevationMosaic();
+
+    ElevationMosaic(const ElevationMosaic&) = delete;
+    ElevationMosaic& operator=(const ElevationMosaic&) = delete;
+
+    // the block cache to open tile grids on, one budget for the whole mosaic.
+    const shared_ptr<ElevationBlockCache>& get_cache() const { return cache_; }
+
+    // returns the tile index, the lattice follows the first tile added.
+    size_t add_tile(const shared_ptr<ElevationGrid>& grid, const core::vec2d& ul_corner, const core::vec2d& pixel_size);
+    // split the overlaps between tiles, call once all tiles are added.
+    void build(double feather_size = kDefaultElevationFeatherSize);
+    void clear();
+    void flush();
+
+    size_t get_num_tiles() const { return tiles_.size(); }
+    // false if the tile is off the lattice and keeps its own bounds and positions.
+    bool is_aligned(size_t tile_idx) const { return tiles_[tile_idx].aligned; }
+
+    // pixel coordinates within rounding of a whole number are moved onto it.
+    static core::vec2d snap_to_lattice(const core::vec2d& s);
+
+    // owned area of a tile in its own pixel coordinates, x and y sorted.
+    core::bounds2d get_owned_pixel_bounds(size_t tile_idx) const;
+
+    // position of a tile's pixel coordinate, taken from the lattice so that tiles
+    // evaluating the same node get the very same value.
+    core::vec2d get_position(size_t tile_idx, const core::vec2d& s) const;
+
+    // area covered by the rasters, from the outer pixel centers.
+    core::bounds2d get_bounds() const;
+    bool contains(const core::vec2d& pos) const;
+    // pixel size of the lattice, the first tile's.
+    const core::vec2d& get_pixel_size() const { return pixel_size_; }
+
+    // blended height at a position, clamped to the nearest raster outside of all.
+    float get_height(const core::vec2d& pos);
+};
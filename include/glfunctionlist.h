@@ -1,6 +1,10 @@
 #pragma once
 #include "base.h"
 
+// the capture numbers gl calls 0x10000800 + the position of the call in the gles 2.0
+// list sorted by name, and 0x10000900 + the position in gl3.h for gles 3.0. calls not
+// seen in a capture yet take their id from that order, tests/glstate_test.cpp checks
+// them against the neighbours that were.
 enum TagInfo
 {
     kArrayBufferBlock = 0x20000004,
@@ -32,6 +36,8 @@ enum TagInfo
     kGlUseProgram = 0x10000883,
     kGlDrawArrays = 0x10000829,
     kGlDrawElements = 0x1000082a,
+    kGlDrawArraysInstanced = 0x10000940,
+    kGlDrawElementsInstanced = 0x10000941,
     kGlVertexAttribPointer = 0x1000088d,
     kGlVertexAttribIPointer = 0x10000923,
     kGlVertexAttribLPointer = 0x10001081,
@@ -68,6 +74,9 @@ enum TagInfo
     kGlBindVertexArray = 0x10000918,
     kGlBindVertexBuffer = 0x100009a3,
     kGlBindVertexBuffers = 0x100009f3,
+    kGlGenVertexArrays = 0x1000091a,
+    kGlDeleteVertexArrays = 0x10000919,
+    kGlVertexAttribDivisor = 0x10000955,
     kGlBlendColor = 0x10000808,
     kGlBlendEquation = 0x10000809,
     kGlBlendEquationSeparate = 0x1000080a,
@@ -148,6 +157,8 @@ enum TagInfo
     kGlBindAttribLocation = 0x10000803,
     kGlBufferData = 0x1000080d,
     kGlBufferSubData = 0x1000080e,
+    kGlDeleteBuffers = 0x1000081d,
+    kGlDeleteTextures = 0x10000822,
     kGlCreateShader = 0x1000081b,
     kGlDeleteShader = 0x10000821,
     kGlCreateProgram = 0x1000081a,
@@ -490,6 +501,8 @@ enum DataType
     kGl3Bytes = 0x1408,
     kGl4Bytes = 0x1409,
     kGlDouble = 0x140a,
+    kGlHalfFloat = 0x140b,
+    kGlFixed = 0x140c,
     kGlUByte332 = 0x8032,
     kGlUByte332Rev = 0x8362,
     kGlUShort565 = 0x8363,
@@ -502,6 +515,9 @@ enum DataType
     kGlUInt8888Rev = 0x8367,
     kGlUInt1010102 = 0x8036,
     kGlUInt1010102Rev = 0x8368,
+    kGlInt2101010Rev = 0x8d9f,
+    kGlUInt10f11f11fRev = 0x8c3b,
+    kGlNoDataType = -1,             // draw arrays, no index data
 };
 
 enum MaxtrixMode
@@ -583,6 +599,8 @@ enum TextureType
     kGlTexture3DExt = 0x806f,
     kGlTextureRectangleExt = 0x84f5,
     kGlTextureCubemapArb = 0x8513,
+    kGlTextureCubemapPositiveXArb = 0x8515,
+    kGlTextureCubemapNegativeZArb = 0x851a,
     kGlTexture1DArrayExt = 0x8c18,
     kGlTexture2DArrayExt = 0x8c1a,
 };
@@ -0,0 +1,133 @@
+#pragma once
+#include <unordered_map>
+#include "vertexformat.h"
+
+const uint32_t kGlMaxVertexAttribs = 16;
+const uint32_t kGlMaxTextureUnits = 256;
+
+// an object is a name and the generation of the name, a name deleted and generated again
+// is another object. 0 is no object.
+inline uint64_t MakeGlObjectKey(uint32_t name, uint32_t generation)
+{
+    return name == 0 ? 0 : (uint64_t(generation) << 32) | name;
+}
+
+inline uint32_t GetGlObjectName(uint64_t key)
+{
+    return uint32_t(key);
+}
+
+struct GlBufferObject
+{
+    uint32_t            usage;
+    size_t              size;               // of the data store, as given to glBufferData
+    const uint8_t*      data;               // into the capture, or owned_data once sub data changed it
+    size_t              num_bytes;          // readable at data, less than size if never written whole
+    vector<uint8_t>     owned_data;
+
+    GlBufferObject() : usage(0), size(0), data(nullptr), num_bytes(0) {}
+};
+
+struct GlVertexAttrib
+{
+    bool                b_enabled;
+    VertexFormat        format;
+    uint32_t            stride;             // 0 given is the format size
+    uint64_t            offset;             // into the buffer, or the vertex stream tag of client memory
+    uint64_t            buffer_key;         // 0 for client memory
+    uint32_t            divisor;            // instances per element, 0 per vertex
+
+    GlVertexAttrib() : b_enabled(false), stride(0), offset(0), buffer_key(0), divisor(0) {}
+};
+
+struct GlVertexArrayObject
+{
+    GlVertexAttrib      attrib_list[kGlMaxVertexAttribs];
+    uint64_t            element_buffer_key;
+
+    GlVertexArrayObject() : element_buffer_key(0) {}
+};
+
+struct GlTextureObject
+{
+    uint32_t            target;             // of the first bind
+    uint32_t            list_idx;           // the owner's, INVALID_VALUE until set
+
+    GlTextureObject() : target(0), list_idx(INVALID_VALUE) {}
+};
+
+/**
+ * @brief  The object state of a gl context as a capture replays it: buffers, textures,
+ *         vertex arrays and programs, with the bindings gl keeps for each. Objects live
+ *         in hash maps under generation aware keys, names are not bounded. Buffer data
+ *         is not copied until glBufferSubData changes it. Calls return false where gl
+ *         would raise an error, the state is left as gl leaves it.
+ */
+class GlStateEmulator
+{
+    unordered_map<uint32_t, uint32_t>               buffer_generation_map_;
+    unordered_map<uint32_t, uint32_t>               texture_generation_map_;
+    unordered_map<uint32_t, uint32_t>               vertex_array_generation_map_;
+    unordered_map<uint32_t, uint32_t>               program_generation_map_;
+
+    unordered_map<uint64_t, GlBufferObject>         buffer_map_;
+    unordered_map<uint64_t, GlTextureObject>        texture_map_;
+    unordered_map<uint64_t, GlVertexArrayObject>    vertex_array_map_;
+    unordered_map<uint64_t, bool>                   program_map_;
+
+    unordered_map<uint32_t, uint64_t>               buffer_binding_map_;    // target, element array excluded
+    unordered_map<uint64_t, uint64_t>               texture_binding_map_;   // unit << 32 | target
+    GlVertexArrayObject                             default_vertex_array_;
+    uint64_t                                        vertex_array_key_;
+    uint32_t                                        active_texture_unit_;
+    uint64_t                                        program_key_;
+
+    uint64_t get_live_key(const unordered_map<uint32_t, uint32_t>& generation_map, uint32_t name) const;
+    GlVertexArrayObject& get_vertex_array();
+    GlBufferObject* get_bound_buffer_object(uint32_t target);
+
+public:
+    GlStateEmulator();
+
+    GlStateEmulator(const GlStateEmulator&) = delete;
+    GlStateEmulator& operator=(const GlStateEmulator&) = delete;
+
+    void reset();
+
+    // bind creates the object of a name not seen before, like compatibility profiles do.
+    bool bind_buffer(uint32_t target, uint32_t name);
+    // data null leaves the store undefined, nothing is readable until sub data writes it.
+    bool buffer_data(uint32_t target, const uint8_t* data, size_t size, uint32_t usage);
+    bool buffer_sub_data(uint32_t target, size_t offset, const uint8_t* data, size_t size);
+    // unbinds them from the targets and the bound vertex array, other vertex arrays keep theirs.
+    void delete_buffers(const uint32_t* name_list, uint32_t count);
+    uint64_t get_bound_buffer(uint32_t target) const;
+    const GlBufferObject* get_buffer(uint64_t key) const;
+
+    bool bind_vertex_array(uint32_t name);
+    void delete_vertex_arrays(const uint32_t* name_list, uint32_t count);
+    uint64_t get_bound_vertex_array() const { return vertex_array_key_; }
+
+    // the buffer bound to the array target is captured with the pointer.
+    bool vertex_attrib_pointer(uint32_t index, const VertexFormat& format, uint32_t stride, uint64_t offset);
+    bool enable_vertex_attrib_array(uint32_t index, bool b_enabled);
+    bool vertex_attrib_divisor(uint32_t index, uint32_t divisor);
+    const GlVertexAttrib& get_vertex_attrib(uint32_t index) const;
+    uint64_t get_element_buffer() const;
+
+    // unit counted from 0, not from GL_TEXTURE0.
+    bool active_texture(uint32_t unit);
+    bool bind_texture(uint32_t target, uint32_t name);
+    void delete_textures(const uint32_t* name_list, uint32_t count);
+    uint32_t get_active_texture_unit() const { return active_texture_unit_; }
+    uint64_t get_bound_texture(uint32_t unit, uint32_t target) const;
+    GlTextureObject* get_texture(uint64_t key);
+
+    bool create_program(uint32_t name);
+    bool use_program(uint32_t name);
+    void delete_program(uint32_t name);
+    uint64_t get_current_program() const { return program_key_; }
+};
+
+// the bind target of a texture image target, cube map faces go to the cube map.
+uint32_t GetGlTextureBindTarget(uint32_t image_target);
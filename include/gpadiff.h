@@ -0,0 +1,77 @@
+#pragma once
+#include "coremath.h"
+
+struct MeshData;
+struct GroupMeshData;
+
+enum MeshDiffType
+{
+    kMeshDiffUnchanged,         // same content hash
+    kMeshDiffChanged,           // matched by position, content differs
+    kMeshDiffAdded,             // only in the new capture
+    kMeshDiffRemoved,           // only in the old capture
+};
+
+struct MeshDiffOptions
+{
+    double              match_distance;     // centroids further apart are different meshes, in capture units
+    bool                align_captures;     // fit the new capture onto the old by the unchanged meshes
+
+    MeshDiffOptions() : match_distance(10.0), align_captures(true) {}
+};
+
+// distances from each vertex to the nearest vertex of the other mesh.
+struct VertexDeviation
+{
+    double              max_distance;       // both ways, the hausdorff distance of the vertex sets
+    double              mean_distance;      // old to new
+    double              rms_distance;
+    double              p95_distance;
+
+    VertexDeviation() : max_distance(0.0), mean_distance(0.0), rms_distance(0.0), p95_distance(0.0) {}
+};
+
+struct MeshDiffEntry
+{
+    MeshDiffType        type;
+    uint32_t            old_idx;            // INVALID_VALUE if added
+    uint32_t            new_idx;            // INVALID_VALUE if removed
+    uint64_t            old_hash;
+    uint64_t            new_hash;
+    uint32_t            old_num_vertex;
+    uint32_t            new_num_vertex;
+    bool                b_texture_changed;
+    VertexDeviation     deviation;          // changed only
+};
+
+struct CaptureDiff
+{
+    vector<MeshDiffEntry>   entry_list;     // removed and matched in old order, then added in new order
+    uint32_t                num_unchanged;
+    uint32_t                num_changed;
+    uint32_t                num_added;
+    uint32_t                num_removed;
+    bool                    b_aligned;
+    core::matrix4d          new_to_old;     // row vectors, applied to new capture positions
+
+    CaptureDiff() : num_unchanged(0), num_changed(0), num_added(0), num_removed(0), b_aligned(false) {}
+};
+
+// vertices, uvs, colors, draw calls and the level 0 texels of the mesh's texture.
+uint64_t HashMeshContent(const MeshData& mesh, const GroupMeshData& group_mesh_data);
+
+/**
+ * @brief  Match the meshes of two captures. Meshes with a content hash unique on both
+ *         sides are unchanged and, when there are 3 or more, register the new capture
+ *         onto the old. The rest are paired by centroid through a hash grid, closest
+ *         pairs first, so nothing is compared all against all.
+ */
+void DiffCaptureMeshes(const GroupMeshData& old_group, const GroupMeshData& new_group,
+                       const MeshDiffOptions& options, CaptureDiff& diff);
+
+// load both frames with CreateMeshFromDumpFile and diff them, false if either has no meshes.
+bool DiffGpaFrames(const string& old_file_name, const string& new_file_name,
+                   const MeshDiffOptions& options, CaptureDiff& diff);
+
+// one line per entry.
+bool WriteCaptureDiffReport(const string& csv_file_name, const CaptureDiff& diff);
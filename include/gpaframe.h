@@ -0,0 +1,119 @@
+#pragma once
+#include "base.h"
+
+struct GroupMeshData;
+
+enum GpaParseErrorType
+{
+    kGpaErrorFileHeader,        // not a gpa frame
+    kGpaErrorTruncated,         // a zone runs past the end of the file, or there is no end tag
+    kGpaErrorZoneSize,          // zone smaller than its fixed header
+    kGpaErrorZoneTag,           // unknown zone tag
+    kGpaErrorZoneStamp,         // data zone out of sequence
+    kGpaErrorDataBlock,         // vertex stream block runs past its zone
+    kGpaErrorCommandSize,       // command shorter than its arguments
+    kGpaErrorDataReference,     // command refers to a missing or too small data zone
+    kGpaErrorObjectId,          // buffer, texture, attribute, slot or mip level out of range
+    kGpaErrorInvalidEnum,       // argument outside the values gl accepts
+    kGpaErrorBufferRange,       // vertex, index or texture data past the end of its buffer
+};
+
+struct GpaParseError
+{
+    GpaParseErrorType   type;
+    uint32_t            zone_idx;           // in file order
+    uint32_t            offset;             // of the zone in the file
+    uint32_t            tag;                // of the zone
+};
+
+struct GpaParseReport
+{
+    vector<GpaParseError>   error_list;
+    uint32_t                num_zones;
+    uint32_t                num_skipped_zones; // dropped, or kept empty so later zones still line up
+
+    GpaParseReport() : num_zones(0), num_skipped_zones(0) {}
+};
+
+const uint32_t kGpaFrameFileTag = 0xaabbccdd;
+const uint32_t kGpaFrameEndTag = 0xf0000000;
+
+struct GpaZoneEntry
+{
+    uint64_t            offset;             // of the zone header in the file
+    uint32_t            num_bytes;          // after the header
+    uint32_t            tag;
+    uint64_t            hash;               // fnv-1a of the zone bytes, checked by VerifyGpaFrameIndex
+};
+
+// where every zone of a frame is, so it can be parsed without walking the file again.
+struct GpaFrameIndex
+{
+    bool                    b_valid;        // the file header was a gpa frame
+    uint64_t                file_size;
+    int64_t                 file_time;      // last write time, in the file system's clock
+    uint32_t                version_number;
+    uint64_t                end_offset;     // where the walk stopped
+    uint32_t                end_tag;        // kGpaFrameEndTag, or of the zone running past the end
+    vector<GpaZoneEntry>    zone_list;
+
+    GpaFrameIndex() : b_valid(false), file_size(0), file_time(0), version_number(0), end_offset(0), end_tag(0) {}
+};
+
+const char* GetGpaParseErrorName(GpaParseErrorType type);
+
+// one line per error, "zone 12 at 0x1f40 tag 0x2000000a: data block".
+string FormatGpaParseError(const GpaParseError& error);
+
+/**
+ * @brief  Parse a captured frame from memory. Every size, id and offset read from the
+ *         data is checked before use; a damaged zone is reported and skipped and the
+ *         rest of the frame still parsed, so meshes from intact draw calls are kept.
+ *         Does not keep pointers into data.
+ *
+ * @return  False if the frame had any error, group_mesh_data holds what was recovered
+ */
+bool ParseGpaFrame(const uint8_t* data, size_t size, GroupMeshData* group_mesh_data, GpaParseReport* report = nullptr);
+
+// same, going through the zones of index instead of walking data. index must be current for data.
+bool ParseGpaFrame(const uint8_t* data, size_t size, const GpaFrameIndex& index,
+                   GroupMeshData* group_mesh_data, GpaParseReport* report = nullptr);
+
+// read a frame file, through its sidecar index when that is current. b_verify_index also
+// checks the zone hashes of the sidecar, a mismatch rebuilds it.
+bool CreateMeshFromDumpFile(const string& dump_file_name, GroupMeshData* group_mesh_data, GpaParseReport* report = nullptr,
+                            bool b_verify_index = false);
+
+// 64 bit fnv-1a of the bytes, continuing hash to chain several buffers.
+constexpr uint64_t kGpaZoneHashSeed = 0xcbf29ce484222325ull;
+uint64_t HashGpaZone(const uint8_t* data, size_t size, uint64_t hash = kGpaZoneHashSeed);
+
+/**
+ * @brief  Walk the zones of a frame in memory and hash them. The walk stops at the end
+ *         tag, or at the first zone running past the end of data.
+ *
+ * @return  False if data is not a gpa frame
+ */
+bool BuildGpaFrameIndex(const uint8_t* data, size_t size, GpaFrameIndex& index);
+
+// size and zone headers match data, catches an index written for another version of the file.
+bool IsGpaFrameIndexCurrent(const uint8_t* data, size_t size, const GpaFrameIndex& index);
+
+// current, and every zone hashes as it did when indexed. reads the whole frame, so only
+// done on demand; zone contents that changed under the same headers are caught here.
+bool VerifyGpaFrameIndex(const uint8_t* data, size_t size, const GpaFrameIndex& index);
+
+// the sidecar next to a frame, "frame.gpa_frame.idx".
+string GetGpaFrameIndexFileName(const string& frame_file_name);
+
+bool GetGpaFrameFileStamp(const string& file_name, uint64_t& file_size, int64_t& file_time);
+
+bool SaveGpaFrameIndex(const string& index_file_name, const GpaFrameIndex& index);
+
+/**
+ * @brief  Load a sidecar index, only if it was written for a frame file of this size and
+ *         last write time.
+ *
+ * @return  False if missing, damaged or stale, index is left invalid
+ */
+bool LoadGpaFrameIndex(const string& index_file_name, uint64_t file_size, int64_t file_time, GpaFrameIndex& index);
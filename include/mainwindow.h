@@ -28,12 +28,18 @@ private slots:
 
     void handleImportMapButton();
 
+    void handleExportTerrainButton();
+
     void on_RegionSelectButton_clicked();
 
     void on_ImportFbxData_clicked();
 
     void on_ImportKml_clicked();
 
+    void on_OcclusionCulling_toggled(bool checked);
+
+    void on_DiffGpaFrames_clicked();
+
 private:
 
     Ui::MainWindow *ui;
@@ -0,0 +1,45 @@
+#pragma once
+#include "meshdata.h"
+
+// vertices of a merged mesh at most, its draw calls need 32 bit indices past 65536.
+constexpr uint32_t kDefaultBatchMaxVertices = 0x40000;
+
+// world units of the cells meshes are batched in, about a tile of the dumps.
+constexpr double kDefaultBatchCellSize = 256.0;
+
+struct MeshBatchStats
+{
+    uint32_t    num_meshes_before;
+    uint32_t    num_meshes_after;
+    uint32_t    num_draw_calls_before;
+    uint32_t    num_draw_calls_after;
+    uint32_t    num_wide_draw_calls;    // merged draw calls that needed 32 bit indices
+
+    MeshBatchStats() : num_meshes_before(0), num_meshes_after(0), num_draw_calls_before(0), num_draw_calls_after(0), num_wide_draw_calls(0) {}
+
+    MeshBatchStats& operator+=(const MeshBatchStats& other);
+};
+
+/**
+ * @brief  Merge the meshes of a group that share a texture, vertex attributes and
+ *         primitive types into one mesh per batch, and within it the draw calls of
+ *         the same primitive type and flags into one draw call. Point, line and
+ *         triangle lists are appended, triangle strips are joined with degenerate
+ *         triangles that keep the winding of the strip after them, other primitives
+ *         stay separate draw calls. Indices are rebased and stay 16 bit unless a
+ *         merged draw call addresses a vertex past 0xffff.
+ *         vertex_list + translation, what drawing and export use, is kept; a batch
+ *         takes the dumpped_matrix of its first mesh. Meshes with patches or with
+ *         indices past their vertices are left alone.
+ *         Only meshes whose bbox_ws centers fall in the same cell_size grid cell are
+ *         merged, so a batch stays about a cell large and frustum and occlusion
+ *         culling still drop the parts out of view. Larger cells mean fewer draw
+ *         calls but more drawn off screen, 0 merges across the whole group.
+ *
+ * @return  The meshes and draw calls of the group before and after
+ */
+MeshBatchStats MergeGroupMeshes(GroupMeshData* group_mesh_data, uint32_t max_vertices = kDefaultBatchMaxVertices,
+                                double cell_size = kDefaultBatchCellSize);
+
+// "draw calls 120 -> 9, meshes 60 -> 4", for the debug output.
+string FormatMeshBatchStats(const MeshBatchStats& stats);
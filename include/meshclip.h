@@ -0,0 +1,30 @@
+#pragma once
+#include "meshdata.h"
+
+enum MeshClipSpace
+{
+    kMeshClipGps,       // lon lat of gps_vert_list
+    kMeshClipLocal,     // x y of vertex_list plus translation, the batch's enu frame
+};
+
+/**
+ * @brief  Keep the part of the mesh's triangles inside a simple polygon, convex or
+ *         concave, either winding. Triangles crossing the outline are cut and their new
+ *         vertices interpolate positions, gps coordinates, uvs and colors. A cut point
+ *         on a mesh edge is computed from that edge alone and shared by both triangles
+ *         of the edge, so a watertight mesh stays watertight. Concave polygons are ear
+ *         clipped into triangles first, triangles inside one of them are kept whole.
+ *
+ * @param  clipped_mesh  One kGlTriangles draw call, texture and translation of mesh_data
+ * @return  False if nothing is left, the polygon is degenerate, or the clip space has no
+ *          coordinates in the mesh
+ */
+bool ClipMeshToPolygon(const MeshData& mesh_data, const vector<core::vec2d>& polygon,
+                       MeshClipSpace clip_space, MeshData& clipped_mesh);
+
+bool ClipMeshToBounds(const MeshData& mesh_data, const core::bounds2d& bbox,
+                      MeshClipSpace clip_space, MeshData& clipped_mesh);
+
+// one clipped mesh per input, nullptr where nothing is left; meshes are cut in parallel.
+void ClipMeshesToPolygon(const vector<MeshData*>& mesh_list, const vector<core::vec2d>& polygon,
+                         MeshClipSpace clip_space, vector<unique_ptr<MeshData>>& clipped_mesh_list);
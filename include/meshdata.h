@@ -4,6 +4,12 @@
 #include "glfunctionlist.h"
 #include "debugout.h"
 
+namespace core
+{
+class GeoidModel;
+class CoordinateTransformer;
+}
+
 struct DrawCallInfo
 {
 private:
@@ -130,6 +136,9 @@ public:
         num_index_ = max(idx, num_index_);
     }
 
+    // triangles and strips appended as a triangle list, other primitives add nothing.
+    void get_triangle_list(vector<uint32_t>& index_list) const;
+
     void add_index(uint32_t idx)
     {
         if (index_type_ == kGlUInt)
@@ -177,6 +186,12 @@ struct MeshData : public core::Primitive
 
     bool culling(const core::vec3d& reference_pos, const core::matrix4f& world_proj_mat, float scale);
 
+    // triangle list of all the draw calls, strips unrolled the way the fbx export does.
+    void get_triangle_list(vector<uint32_t>& index_list) const;
+
+    // gps_vert_list if kept, the vertex in the batch's enu frame otherwise.
+    core::GpsCoord get_gps_coord(uint32_t idx, const core::CoordinateTransformer& enu_frame) const;
+
     void draw(CoreGLSLProgram* program);
 
     DrawCallInfo& get_last_draw_call_info()
@@ -186,11 +201,11 @@ struct MeshData : public core::Primitive
 
     void add_draw_call_list(PrimitiveType prim_type, int index_count, int max_index = 65535)
     {
-        DrawCallInfo* lastest_draw_call = new DrawCallInfo;
-        lastest_draw_call->set_primitive_type(prim_type);
-        lastest_draw_call->allocate_index_buffer(index_count, max_index);
+        DrawCallInfo lastest_draw_call;
+        lastest_draw_call.set_primitive_type(prim_type);
+        lastest_draw_call.allocate_index_buffer(index_count, max_index);
 
-        draw_call_list.push_back(move(*lastest_draw_call));
+        draw_call_list.push_back(move(lastest_draw_call));
     }
 };
 
@@ -222,6 +237,7 @@ struct BatchMeshData
     core::bounds3d          bbox_ws;
     core::bounds3d          bbox_gps;
     vector<GroupMeshData*>  group_meshes;
+    shared_ptr<core::GeoidModel> geoid_model; // optional, orthometric to ellipsoidal heights.
 
     BatchMeshData() : is_spline_mesh(false),
                       is_texture_loaded(false),
@@ -242,7 +258,6 @@ struct MapInfo
     core::vec2d              pixel_size;
     core::vec2i              pixel_count;
     core::vec2i              size;
-    unique_ptr<float[]>      alt_list;
 };
 
 struct TexInfo
@@ -252,6 +267,11 @@ struct TexInfo
     unique_ptr<uint8_t[]>    channel_list;
 };
 
+// the part of a mesh with gps_vert_list inside the patch, cut exactly along its border.
+// a library entry for patch lists, the dump import clips to the scissor rectangle
+// through ClipMeshesToPolygon instead.
+bool PatchCutting(const PatchInfo& patch_info, const MeshData& mesh_data, MeshData& patch_mesh_data);
+
 void PatchesCutting(const vector<core::bounds2d>& patch_list,
                     const vector<core::bounds2d>& map_list,
                     const vector<core::bounds2d>& tex_list,
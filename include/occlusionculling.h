@@ -0,0 +1,107 @@
+#pragma once
+#include "coremath.h"
+
+struct MeshData;
+struct BatchMeshData;
+
+namespace core
+{
+class WorkerPool;
+}
+
+// depth buffer size the viewer rasterizes occluders at, the height follows the aspect.
+constexpr int32_t kDefaultOcclusionBufferWidth = 256;
+// screen tiles are binned and rasterized independently, blocks keep the farthest depth of
+// their pixels. both are multiples of the 4 pixels a simd row step covers.
+constexpr int32_t kOcclusionTileWidth = 32;
+constexpr int32_t kOcclusionTileHeight = 16;
+constexpr int32_t kOcclusionBlockSize = 8;
+// triangles binned over all tiles a frame needs before its tiles go to the worker threads,
+// below that handing them over costs more than it saves.
+constexpr size_t kMinParallelOcclusionBins = 2048;
+// occluder triangles rasterized per frame at most, larger meshes on screen go first.
+constexpr uint32_t kMaxOccluderTriangles = 1 << 17;
+// meshes covering fewer pixels of the depth buffer are not worth rasterizing as occluders.
+constexpr float kMinOccluderPixels = 16.0f;
+
+// screen space triangle, edges are a * x + b * y + c, positive inside, depth is a plane the same way.
+struct OcclusionTriangle
+{
+    float       edge[3][3];
+    float       depth[3];
+    float       min_depth;
+    int32_t     rect[4];    // pixels touched, x0 y0 x1 y1 inclusive
+};
+
+/**
+ * @brief  Software occlusion culling against a low resolution depth buffer on the cpu.
+ *         Occluder triangles are clipped to the near plane and a guard band, binned
+ *         into screen tiles and rasterized a tile per job on a pool of worker threads
+ *         kept for the culler, with simd rows of 4 pixels. Tiles own their pixels,
+ *         so the depth does not depend on the number of threads. Depth is 1 / w, larger is nearer and 0 is cleared,
+ *         so it stays precise over the whole range of a perspective projection. A
+ *         pixel keeps the farthest depth its nearest occluder reaches within it, and
+ *         each block the farthest of its pixels, so bounds are tested a block at a
+ *         time and per pixel only where a block does not hide them. Occluders are
+ *         two sided. Adding is not thread safe, tests are const and can run from
+ *         several threads once rasterize returned.
+ */
+class OcclusionCuller
+{
+    int32_t                     width_;
+    int32_t                     height_;
+    int32_t                     num_tiles_x_;
+    int32_t                     num_tiles_y_;
+    vector<float>               depth_list_;        // num_tiles_x_ * kOcclusionTileWidth wide rows
+    vector<float>               block_depth_list_;
+    vector<OcclusionTriangle>   triangle_list_;
+    vector<vector<uint32_t>>    tile_bin_list_;
+    vector<core::vec4f>         clip_vert_list_;
+    vector<uint32_t>            index_list_;
+    uint32_t                    num_threads_;
+    unique_ptr<core::WorkerPool> worker_pool_;
+
+    int32_t get_stride() const { return num_tiles_x_ * kOcclusionTileWidth; }
+    int32_t get_num_blocks_x() const { return get_stride() / kOcclusionBlockSize; }
+    void add_triangle(const core::vec4f& v0, const core::vec4f& v1, const core::vec4f& v2);
+    void rasterize_tile(int32_t tile_x, int32_t tile_y);
+
+public:
+    OcclusionCuller(int32_t width = kDefaultOcclusionBufferWidth, int32_t height = kDefaultOcclusionBufferWidth / 2);
+    ~OcclusionCuller();
+
+    OcclusionCuller(const OcclusionCuller&) = delete;
+    OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+
+    // clears too if the size changes.
+    void set_resolution(int32_t width, int32_t height);
+    // drops the occluders and clears the depth.
+    void clear();
+    // threads rasterize uses counting the calling one, 0 is one per core and 1 rasterizes
+    // on the calling thread only.
+    void set_num_threads(uint32_t num_threads);
+
+    // the triangles of index_list over vertex_list, local_proj_mat takes them to clip space.
+    void add_occluder_triangles(const core::vec3f* vertex_list, uint32_t num_vertex, const uint32_t* index_list, size_t num_index, const core::matrix4f& local_proj_mat);
+    // the triangles the viewer draws of mesh, placed as OGLWidget::Draw places them.
+    void add_occluder(const MeshData* mesh, const core::vec3d& reference_pos, const core::matrix4f& world_proj_mat, float scale);
+    // occluders added after this are not in the depth until it is called again.
+    void rasterize();
+
+    // false if bbox, in the space CullingCore takes it, is hidden behind the occluders.
+    // bounds crossing the near plane or off the screen are visible, the frustum decides those.
+    bool is_visible(const core::bounds3f& bbox, const core::matrix4f& world_proj_mat, float scale) const;
+    bool is_visible(const MeshData* mesh, const core::vec3d& reference_pos, const core::matrix4f& world_proj_mat, float scale) const;
+
+    // pixels bbox covers on the depth buffer, the whole buffer if it crosses the near plane.
+    float get_screen_area(const core::bounds3f& bbox, const core::matrix4f& world_proj_mat, float scale) const;
+
+    int32_t get_width() const { return width_; }
+    int32_t get_height() const { return height_; }
+    size_t get_num_triangles() const { return triangle_list_.size(); }
+    float get_depth(int32_t x, int32_t y) const { return depth_list_[size_t(y) * get_stride() + x]; }
+};
+
+// the frustum visible tri meshes of the world's batches as occluders, larger on screen first,
+// until kMaxOccluderTriangles. rasterize is left to the caller. the number of meshes added.
+uint32_t AddWorldOccluders(OcclusionCuller& culler, const vector<BatchMeshData*>& mesh_data_batches, const core::vec3d& reference_pos, const core::matrix4f& world_proj_mat, float scale);
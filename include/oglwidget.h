@@ -5,6 +5,7 @@
 #include "oglshaders.h"
 #include "oglcamera.h"
 #include "glfunctionlist.h"
+#include "occlusionculling.h"
 #include <QWidget>
 #include <QPushButton>
 #include <QMouseEvent>
@@ -32,6 +33,8 @@ public:
     void wheelEvent(QWheelEvent *event) override;
     void scrollWithPixels(QWheelEvent *event, QPoint num_pixels);
     void scrollWithDegrees(QWheelEvent *event, QPoint num_degrees);
+    // off draws every mesh the frustum keeps, to compare against or when occluders misbehave.
+    void setOcclusionCulling(bool enabled);
 
 signals:
 
@@ -83,10 +86,10 @@ protected:
     GLuint LoadTexture(const core::Texture2DInfo* tex_info);
     GLuint LoadTexture(const QImage* tex_info);
     void UploadTextures(BatchMeshData* batch_meshes);
-    void DrawBatchMeshes(BatchMeshData* batch_meshes, const core::vec3d& reference_pos, const core::matrix4f& world_screen_mat, GLuint program, float scale, bool draw_tri_meshes);
-    void DrawBatchMeshesSelectMask(BatchMeshData* batch_meshes, const core::vec3d& reference_pos, const core::matrix4f& world_screen_mat, GLuint program, float scale);
-    void DrawWorldMeshes(WorldData* world, const core::vec3d& reference_pos, const core::matrix4f& world_screen_mat, GLuint program, float scale, bool draw_tri_meshes);
-    void DrawWorldMeshesSelectMask(WorldData* world, const core::vec3d& reference_pos, const core::matrix4f& world_screen_mat, GLuint program, float scale);
+    void DrawBatchMeshes(BatchMeshData* batch_meshes, const core::vec3d& reference_pos, const core::matrix4f& world_screen_mat, GLuint program, float scale, bool draw_tri_meshes, const OcclusionCuller* occlusion_culler);
+    void DrawBatchMeshesSelectMask(BatchMeshData* batch_meshes, const core::vec3d& reference_pos, const core::matrix4f& world_screen_mat, GLuint program, float scale, const OcclusionCuller* occlusion_culler);
+    void DrawWorldMeshes(WorldData* world, const core::vec3d& reference_pos, const core::matrix4f& world_screen_mat, GLuint program, float scale, bool draw_tri_meshes, const OcclusionCuller* occlusion_culler);
+    void DrawWorldMeshesSelectMask(WorldData* world, const core::vec3d& reference_pos, const core::matrix4f& world_screen_mat, GLuint program, float scale, const OcclusionCuller* occlusion_culler);
     void Draw(const MeshData* mesh_data, const core::vec3d& reference_pos, uint32_t draw_call_index, GLuint program, float scale);
     void DrawMask(const MeshData* mesh_data, uint32_t draw_call_index, GLuint program, float scale);
     void DrawQuad(const core::vec4f& quad_params, uint32_t tex_id);
@@ -106,6 +109,8 @@ private:
     GLuint m_programs[kNumPrograms];
     core::matrix4f m_proj_mat;
     core::matrix4f m_view_mat;
+    OcclusionCuller m_occlusion_culler;
+    bool m_occlusion_culling = true;
     unique_ptr<core::vec2f[]> m_quad_vert;
     unique_ptr<uint16_t[]> m_quad_index;
     GLuint m_star_tex_idx;
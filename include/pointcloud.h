@@ -0,0 +1,64 @@
+#pragma once
+#include "meshdata.h"
+
+enum PointSampleMode
+{
+    kPointSampleVertices,       // one point per mesh vertex
+    kPointSampleSurface,        // random points on every triangle, by area
+};
+
+struct PointCloudOptions
+{
+    PointSampleMode     sample_mode;
+    double              surface_density;    // points per square meter, surface mode only
+    double              voxel_size;         // meters, 0 keeps every sample
+
+    PointCloudOptions() : sample_mode(kPointSampleSurface),
+                          surface_density(4.0),
+                          voxel_size(0.25)
+    {}
+};
+
+// points in utm meters (easting, northing, altitude), all batches share one zone.
+struct PointCloud
+{
+    vector<core::vec3d>     position_list;
+    vector<uint32_t>        color_list;     // rgba8, r in the low byte
+    int32_t                 utm_zone;       // 0 for ups
+    bool                    northp;
+    core::bounds3d          bbox;
+
+    PointCloud() : utm_zone(0), northp(true) {}
+};
+
+/**
+ * @brief  Sample the world geometry as colored points. Positions come from gps_vert_list
+ *         when a mesh keeps it and from the batch's enu frame otherwise, so every batch
+ *         lands in the same utm zone. Colors are bilinear texture lookups (decoded
+ *         captured textures or the texture file of the mesh), the vertex colors, or
+ *         white. Meshes of a group are sampled across hardware threads with a fixed
+ *         seed per mesh, the result does not depend on the thread count.
+ *
+ * @return  False if there is no geometry
+ */
+bool SamplePointCloud(const vector<BatchMeshData*>& batch_mesh_data, const PointCloudOptions& options,
+                      PointCloud& point_cloud);
+
+/**
+ * @brief  Replace the points of each voxel_size cube by their average position and color.
+ *         Chunks of points are binned into their own hash grids in parallel and the grids
+ *         are merged per key shard, the output is sorted by voxel.
+ *
+ * @return  False if the bounds span more than 2^21 voxels on an axis
+ */
+bool DownsamplePointCloud(PointCloud& point_cloud, double voxel_size);
+
+// binary little endian ply, double x y z and uchar red green blue.
+bool ExportPlyPointFile(const string& file_name, const PointCloud& point_cloud);
+
+// las 1.2, point format 2 with millimeter scale and a geokey record of the utm zone.
+bool ExportLasPointFile(const string& file_name, const PointCloud& point_cloud);
+
+// sample, downsample and write .ply or .las by the file extension.
+bool ExportPointCloudFile(const string& file_name, const vector<BatchMeshData*>& batch_mesh_data,
+                          const PointCloudOptions& options = PointCloudOptions());
@@ -0,0 +1,80 @@
+#pragma once
+#include "coremath.h"
+#include "elevationgrid.h"
+
+namespace core
+{
+class GeoidModel;
+}
+
+// samples per tile side, 2^n + 1 for the right triangulated irregular network.
+constexpr uint32_t kDefaultTerrainGridSize = 65;
+// cesium's level zero geometric error for 65 sample heightmaps on the wgs84 ellipsoid.
+constexpr double kTerrainLevelZeroGeometricError = 77067.34;
+
+struct TerrainTilerOptions
+{
+    int32_t             min_level;
+    int32_t             max_level;      // -1 picks the level matching the raster resolution
+    uint32_t            grid_size;
+    double              error_scale;    // allowed mesh error as a share of the level's geometric error
+
+    TerrainTilerOptions() : min_level(0),
+                            max_level(-1),
+                            grid_size(kDefaultTerrainGridSize),
+                            error_scale(1.0)
+    {}
+};
+
+struct QuantizedMeshTileInfo
+{
+    int32_t             level;
+    int32_t             x;              // tms, level 0 has two tiles of 180 degrees
+    int32_t             y;              // counted from the south
+    uint32_t            num_vertices;
+    uint32_t            num_triangles;
+    float               max_error;      // meters, largest gap between the mesh and the samples
+    float               min_height;
+    float               max_height;
+};
+
+// decoded quantized-mesh-1.0 tile. u, v and height are 0 - 32767 across the tile, v
+// from the south edge; vertices are numbered in the order the triangles first use them.
+struct QuantizedMesh
+{
+    core::vec3d         center;                     // ecef
+    float               min_height;
+    float               max_height;
+    core::vec3d         bounding_sphere_center;
+    double              bounding_sphere_radius;
+    core::vec3d         horizon_occlusion_point;    // ellipsoid scaled space
+    vector<uint16_t>    u_list;
+    vector<uint16_t>    v_list;
+    vector<uint16_t>    height_list;
+    vector<uint32_t>    index_list;
+    vector<uint32_t>    west_index_list;
+    vector<uint32_t>    south_index_list;
+    vector<uint32_t>    east_index_list;
+    vector<uint32_t>    north_index_list;
+};
+
+// zig-zag delta vertices, high water mark indices, 16 bit indices up to 65536 vertices.
+bool EncodeQuantizedMesh(const QuantizedMesh& mesh, vector<uint8_t>& data);
+// false on truncated data or indices out of range.
+bool DecodeQuantizedMesh(const uint8_t* data, size_t size, QuantizedMesh& mesh);
+
+/**
+ * @brief  Write the rasters of the mosaic as a geographic (EPSG:4326, tms) quadtree of
+ *         quantized-mesh-1.0 tiles, folder/z/x/y.terrain, with layer.json and a csv of
+ *         the per tile error metrics. Each tile samples grid_size^2 heights, simplified
+ *         as a right triangulated irregular network down to the level's error budget.
+ *         Heights are sampled tile batch by tile batch, the batch is then meshed,
+ *         encoded and written across hardware threads.
+ *
+ * @param  geoid_model  Orthometric raster heights are moved onto the ellipsoid if set
+ * @return  False if nothing could be written
+ */
+bool ExportQuantizedMeshTiles(ElevationMosaic& elevation_mosaic, const string& folder_name,
+                              const TerrainTilerOptions& options = TerrainTilerOptions(),
+                              const core::GeoidModel* geoid_model = nullptr,
+                              vector<QuantizedMeshTileInfo>* tile_info_list = nullptr);
@@ -0,0 +1,64 @@
+#pragma once
+#include "coremath.h"
+
+struct RegistrationOptions
+{
+    bool                estimate_scale;     // similarity, otherwise rigid
+    double              inlier_threshold;   // residual in units of the points, meters for ecef
+    uint32_t            max_iterations;     // ransac samples, all triples when there are fewer
+    double              confidence;         // of having drawn one outlier free sample
+    uint32_t            random_seed;
+    bool                least_squares_fallback; // fit every pair when fewer than 3 agree
+
+    RegistrationOptions() : estimate_scale(true),
+                            inlier_threshold(1.0),
+                            max_iterations(1000),
+                            confidence(0.999),
+                            random_seed(5489),
+                            least_squares_fallback(false)
+    {}
+};
+
+struct PointCorrespondences
+{
+    vector<core::vec3d> src_list;
+    vector<core::vec3d> dst_list;           // dst_list[i] matches src_list[i]
+};
+
+struct RegistrationResult
+{
+    bool                b_valid;
+    bool                b_least_squares;    // the fallback fit, every pair counts as an inlier
+    core::matrix4d      transform;          // row vectors, dst = vec4d(src, 1) * transform
+    double              scale;
+    uint32_t            num_inliers;
+    double              rms_error;          // over the inliers
+    vector<double>      residual_list;      // |src * transform - dst| per correspondence
+    vector<uint8_t>     inlier_list;
+
+    RegistrationResult() : b_valid(false), b_least_squares(false), scale(1.0), num_inliers(0), rms_error(0.0) {}
+};
+
+/**
+ * @brief  Closed form least squares fit of dst = s * R * src + t over all the pairs
+ *         (Umeyama). The rotation comes from Horn's quaternion form of the same problem,
+ *         so it is always proper, never a reflection.
+ *
+ * @return  False with fewer than 3 pairs or when the points are collinear
+ */
+bool EstimateSimilarityTransform(const vector<core::vec3d>& src_list, const vector<core::vec3d>& dst_list,
+                                 bool estimate_scale, core::matrix4d& transform, double* scale = nullptr);
+
+/**
+ * @brief  Fit a similarity or rigid transform robust to wrong pairs. Three point
+ *         samples are fit and scored by their inliers, the best set is refit until it
+ *         no longer changes. With few pairs every triple is tried, so the result does
+ *         not depend on the seed. When fewer than 3 pairs agree within the threshold,
+ *         least_squares_fallback fits all of them instead.
+ *         There is no batched form: the ingest registers each dump as it loads so only
+ *         one dump's meshes are held at a time, seeding each with random_seed + dump index.
+ *
+ * @return  False with fewer than 3 pairs, mismatched lists, or when neither fit succeeds
+ */
+bool RegisterPoints(const PointCorrespondences& correspondences, const RegistrationOptions& options,
+                    RegistrationResult& result);
@@ -0,0 +1,22 @@
+#pragma once
+#include "meshdata.h"
+
+// default atlas page size in texels, a dxt1 page of this size is 2MB.
+constexpr uint32_t kDefaultAtlasPageSize = 2048;
+// gutter around each packed texture in texels, rounded up to whole 4x4 blocks.
+constexpr uint32_t kDefaultAtlasGutter = 4;
+
+/**
+ * @brief  Pack the dxt1 textures of a group into a few atlas pages and rewrite the
+ *         uvs and texture indices of the meshes that use them. Textures are placed on
+ *         4x4 block boundaries and copied block by block, so nothing is re-encoded;
+ *         the gutter repeats the edge texels by rewriting the block indices, which
+ *         keeps bilinear filtering from bleeding across neighbours.
+ *         Textures that are not dxt1, not a multiple of 4 texels, larger than a page
+ *         or sampled with uvs outside [0, 1] stay as separate textures.
+ *
+ * @return  Number of textures moved into atlas pages
+ */
+uint32_t BuildGroupTextureAtlas(GroupMeshData* group_mesh_data,
+                                uint32_t page_size = kDefaultAtlasPageSize,
+                                uint32_t gutter = kDefaultAtlasGutter);
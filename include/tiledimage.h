@@ -0,0 +1,73 @@
+#pragma once
+#include <fstream>
+#include "coremath.h"
+#include "opencv2/opencv.hpp"
+
+// default memory budget for the decoded rows held while cropping one image.
+constexpr size_t kDefaultImageCropMemorySize = 256 * 1024 * 1024;
+
+struct ImageCropInfo
+{
+    int32_t     x;              // left column
+    int32_t     y;              // top row, counted from the first row in the file
+    int32_t     w;
+    int32_t     h;
+    string      file_name;
+};
+
+// row range reader of an image file in the bgr layout cv::imread returns. uncompressed
+// 8 bit gray or rgb tiffs (strips or tiles, classic or bigtiff) are read from disk a
+// strip or a tile at a time, so only the rows asked for are ever resident. anything
+// else is decoded whole by opencv on open, the way it always was.
+class TiledImageReader
+{
+    ifstream            file_;
+    cv::Mat             full_image_;
+    bool                big_endian_;
+    bool                big_tiff_;
+    int                 x_size_;
+    int                 y_size_;
+    int                 samples_per_pixel_;
+    int                 rows_per_strip_;
+    int                 tile_x_size_;   // 0 for striped files
+    int                 tile_y_size_;
+    vector<uint64_t>    chunk_offsets_;
+    vector<uint8_t>     chunk_buffer_;
+
+    bool open_tiff(const string& file_name);
+    bool read_tag_values(uint32_t type, uint64_t count, const uint8_t* value_field, vector<uint64_t>& values);
+    uint64_t to_uint(const uint8_t* data, uint32_t num_bytes) const;
+    void convert_pixels(const uint8_t* src, int num_pixels, uint8_t* dst) const;
+
+public:
+    TiledImageReader();
+    ~TiledImageReader();
+
+    TiledImageReader(const TiledImageReader&) = delete;
+    TiledImageReader& operator=(const TiledImageReader&) = delete;
+
+    bool open(const string& file_name);
+    void close();
+
+    int get_x_size() const { return x_size_; }
+    int get_y_size() const { return y_size_; }
+    // false if open fell back to decoding the whole image.
+    bool is_streamed() const { return full_image_.empty() && x_size_ > 0; }
+    // the whole image of a reader that is not streamed, empty otherwise.
+    const cv::Mat& get_full_image() const { return full_image_; }
+
+    // rows [y, y + num_rows) as packed 3 channel bgr, x_size * 3 bytes per row.
+    bool read_rows(int y, int num_rows, uint8_t* dst);
+};
+
+/**
+ * @brief  Write each crop of the reader's image to its own file. Crops are swept top
+ *         to bottom in bands of rows that fit memory_cap, each band is decoded once
+ *         and the crops inside it are encoded in parallel, .png through ExportPngFile
+ *         and anything else through cv::imwrite. The pixels written are the same as
+ *         cropping the cv::imread result.
+ *
+ * @return  False if a band could not be read or a file could not be written
+ */
+bool CropImageFiles(TiledImageReader& reader, const vector<ImageCropInfo>& crop_list,
+                    size_t memory_cap = kDefaultImageCropMemorySize);
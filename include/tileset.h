@@ -0,0 +1,48 @@
+#pragma once
+#include "meshdata.h"
+
+struct TilesetOptions
+{
+    uint32_t            max_node_triangles; // nodes split until they hold at most this many
+    uint32_t            max_depth;
+    uint32_t            lod_grid_size;      // vertex clustering cells across an inner node
+
+    TilesetOptions() : max_node_triangles(65536),
+                       max_depth(16),
+                       lod_grid_size(64)
+    {}
+};
+
+struct TilesetNode
+{
+    core::bounds3d      bbox;               // east north up meters of the tileset frame
+    double              geometric_error;    // meters, 0 for leaves holding the full mesh
+    int32_t             parent;             // -1 for the root
+    uint32_t            depth;
+    vector<uint32_t>    child_list;
+    uint32_t            num_triangles;      // of the content, 0 without content
+    string              content_uri;        // relative to the tileset folder
+};
+
+// spatial index of the world geometry. nodes are stored root first, parents before
+// their children; the frame is east north up at origin.
+struct Tileset
+{
+    core::GpsCoord      origin;
+    vector<TilesetNode> node_list;
+    vector<string>      texture_uri_list;
+};
+
+/**
+ * @brief  Write the world geometry as a 3d tiles 1.1 tileset: tileset.json with box
+ *         bounding volumes and geometric errors, one glb per node under tiles/ and the
+ *         textures as png under textures/. Triangles are split by centroid into a
+ *         quadtree, an octree where a node is about as tall as it is wide. Leaves keep
+ *         the full mesh, inner nodes a vertex clustered copy that children replace.
+ *         Nodes are split level by level and their payloads built and written across
+ *         hardware threads.
+ *
+ * @return  False if there is no geometry or a file could not be written
+ */
+bool ExportTileset(const string& folder_name, const vector<BatchMeshData*>& batch_mesh_data,
+                   const TilesetOptions& options = TilesetOptions(), Tileset* tileset = nullptr);
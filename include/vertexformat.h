@@ -0,0 +1,45 @@
+#pragma once
+#include "base.h"
+
+// how one vertex attribute is stored, the arguments of glVertexAttribPointer.
+struct VertexFormat
+{
+    uint32_t            data_type;          // DataType
+    uint32_t            num_components;     // 1 to 4, or kGlBgra
+    bool                b_normalized;       // fixed point to [0, 1] or [-1, 1]
+
+    VertexFormat() : data_type(0), num_components(0), b_normalized(false) {}
+    VertexFormat(uint32_t type, uint32_t size, bool normalized) : data_type(type), num_components(size), b_normalized(normalized) {}
+};
+
+/**
+ * @brief  The type and size combinations gl accepts for a vertex attribute: 1 to 4
+ *         components of the scalar types, 4 for the packed 2_10_10_10 types, 3 for
+ *         10f_11f_11f, and kGlBgra only for normalized ubyte and 2_10_10_10.
+ */
+bool IsValidVertexFormat(const VertexFormat& format);
+
+// bytes of one attribute, 0 if the format is not valid.
+uint32_t GetVertexFormatSize(const VertexFormat& format);
+
+/**
+ * @brief  Convert an attribute stream to floats. Element i is read at i * stride and
+ *         written at dst + i * num_dst_components, components the format does not have
+ *         are filled from (0, 0, 0, 1) and extra ones dropped. kGlBgra swaps the first
+ *         and third component. Signed normalized values follow gl 4.2 and es 3.0,
+ *         max(c / (2^(b-1) - 1), -1). Common formats are converted with simd lanes and
+ *         match DecodeVertexElement bit for bit.
+ *
+ * @return  The number of elements decoded, those that fit in num_bytes up to max_elements
+ */
+size_t DecodeVertexStream(const uint8_t* data, size_t num_bytes, size_t stride, const VertexFormat& format,
+                          float* dst, uint32_t num_dst_components, size_t max_elements = SIZE_MAX);
+
+// scalar reference of one element, always 4 components. false if the format is not valid.
+bool DecodeVertexElement(const uint8_t* element, const VertexFormat& format, float value[4]);
+
+// same as DecodeVertexStream, each element clamped to [0, 1] and packed to rgba8, r in the low byte.
+size_t DecodeVertexColorStream(const uint8_t* data, size_t num_bytes, size_t stride, const VertexFormat& format,
+                               uint32_t* dst, size_t max_elements = SIZE_MAX);
+
+uint32_t PackVertexColor(const float value[4]);
@@ -6,6 +6,7 @@ struct WorldData
 {
     core::vec2d         reference_pos; // tmp data.
     core::bounds2d      scissor_bbox; // tmp data.
+    shared_ptr<core::GeoidModel> geoid_model; // loaded on the first geoid corrected import.
     core::bounds3d      bbox_ws;
     core::bounds3d      bbox_gps;
     vector<BatchMeshData*> mesh_data_batches;
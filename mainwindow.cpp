@@ -4,6 +4,9 @@
 #include "ui_mainwindow.h"
 #include "kmlfileparser.h"
 #include "GpaDumpAnalyzeTool.h"
+#include "pointcloud.h"
+#include "gpadiff.h"
+#include "tileset.h"
 #include <QDoubleValidator>
 #include <QFileDialog>
 #include <QDialog>
@@ -116,6 +119,12 @@ void MainWindow::on_ImportDumpData_clicked()
 
     QObject::connect(&importMapButton, SIGNAL (released()),this, SLOT (handleImportMapButton()));
 
+    QPushButton exportTerrainButton(&dialog);
+    exportTerrainButton.setText("export quantized mesh terrain");
+    form.addRow(&exportTerrainButton);
+
+    QObject::connect(&exportTerrainButton, SIGNAL (released()),this, SLOT (handleExportTerrainButton()));
+
     // Add some standard buttons (Cancel/Ok) at the bottom of the dialog
     QDialogButtonBox buttonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel,
                                Qt::Horizontal, &dialog);
@@ -150,6 +159,7 @@ void MainWindow::on_ImportDumpData_clicked()
             batch_mesh_data->scissor_bbox = g_world.scissor_bbox;
             batch_mesh_data->is_google_dump = false;
             batch_mesh_data->is_spline_mesh = false;
+            batch_mesh_data->geoid_model = LoadGeoidModel(ui->GeoidCorrection->isChecked());
             //DumpUSGSData(map_file_name_list, dumpped_texture_info_list, true, batch_mesh_data);
             vector<MapInfo> map_info_list;
             PreLoadUSGSData(m_download, map_file_name_list, map_info_list);
@@ -172,6 +182,26 @@ void MainWindow::handleImportMapButton()
            tr("Map File (*.img);;All Files (*)"));
 }
 
+void MainWindow::handleExportTerrainButton()
+{
+    if (selectUsgsMaps.empty())
+    {
+        handleImportMapButton();
+    }
+
+    QString folderName = QFileDialog::getExistingDirectory(this, tr("Export Terrain Tiles To"), "");
+    if (!selectUsgsMaps.empty() && !folderName.isEmpty())
+    {
+        vector<unique_ptr<string>> map_file_name_list;
+        for (int i = 0; i < selectUsgsMaps.size(); i++)
+        {
+            map_file_name_list.push_back(make_unique<string>(selectUsgsMaps[i].toUtf8().constData()));
+        }
+
+        ExportUSGSTerrainTiles(map_file_name_list, folderName.toUtf8().constData(), LoadGeoidModel(ui->GeoidCorrection->isChecked()));
+    }
+}
+
 void MainWindow::on_GoogleEarthDump_clicked()
 {
     ui->loadSaveProgressBar->reset();
@@ -212,7 +242,7 @@ void MainWindow::on_ExportMesh_clicked()
 
     QString fileName = QFileDialog::getSaveFileName(this,
            tr("Export Fbx/Ma File"), "",
-           tr("Fbx File (*.fbx);;Maya File (*.ma);;All Files (*)"));
+           tr("Fbx File (*.fbx);;Maya File (*.ma);;Point Cloud (*.ply *.las);;3D Tiles (tileset.json);;All Files (*)"));
 
     if (g_world.mesh_data_batches.size() > 0)
     {
@@ -222,6 +252,15 @@ void MainWindow::on_ExportMesh_clicked()
         {
             ExportMaMeshFile(file_name, g_world.mesh_data_batches, ui->loadSaveProgressBar);
         }
+        else if (ext_name == ".ply" || ext_name == ".las")
+        {
+            ExportPointCloudFile(file_name, g_world.mesh_data_batches);
+        }
+        else if (ext_name == ".json")
+        {
+            // the tileset's payloads go next to tileset.json.
+            ExportTileset(fileName.left(fileName.lastIndexOf('/')).toUtf8().constData(), g_world.mesh_data_batches);
+        }
         else
         {
             ExportFbxMeshFile(file_name, g_world.mesh_data_batches, ui->loadSaveProgressBar);
@@ -433,7 +472,7 @@ void MainWindow::on_ImportFbxData_clicked()
            tr("Open Fbx File"), "",
            tr("Fbx File (*.fbx);;All Files (*)"));
 
-    ImportAndTransformFbxMeshFile(selectFbxFile.toUtf8().constData());
+    ImportAndTransformFbxMeshFile(selectFbxFile.toUtf8().constData(), ui->GeoidCorrection->isChecked());
 }
 
 void MainWindow::on_ImportKml_clicked()
@@ -468,3 +507,49 @@ void MainWindow::on_ImportKml_clicked()
         }
     }
 }
+
+void MainWindow::on_OcclusionCulling_toggled(bool checked)
+{
+    ui->widget_ogl->setOcclusionCulling(checked);
+}
+
+void MainWindow::on_DiffGpaFrames_clicked()
+{
+    QString oldFileName = QFileDialog::getOpenFileName(this,
+           tr("Open Old GPA Dump File"), "",
+           tr("Gpa Dump File (*.gpa_frame);;All Files (*)"));
+    if (oldFileName.isEmpty())
+    {
+        return;
+    }
+
+    QString newFileName = QFileDialog::getOpenFileName(this,
+           tr("Open New GPA Dump File"), "",
+           tr("Gpa Dump File (*.gpa_frame);;All Files (*)"));
+    if (newFileName.isEmpty())
+    {
+        return;
+    }
+
+    QString reportFileName = QFileDialog::getSaveFileName(this,
+           tr("Save Diff Report"), "",
+           tr("Csv File (*.csv);;All Files (*)"));
+    if (reportFileName.isEmpty())
+    {
+        return;
+    }
+
+    CaptureDiff diff;
+    if (DiffGpaFrames(oldFileName.toUtf8().constData(), newFileName.toUtf8().constData(), MeshDiffOptions(), diff) &&
+        WriteCaptureDiffReport(reportFileName.toUtf8().constData(), diff))
+    {
+        QMessageBox::information(this, tr("Diff GPA Dumps"),
+            tr("%1 unchanged, %2 changed, %3 added, %4 removed%5")
+                .arg(diff.num_unchanged).arg(diff.num_changed).arg(diff.num_added).arg(diff.num_removed)
+                .arg(diff.b_aligned ? tr(", captures aligned") : QString()));
+    }
+    else
+    {
+        QMessageBox::warning(this, tr("Diff GPA Dumps"), tr("The dumps could not be compared, see the debug output."));
+    }
+}
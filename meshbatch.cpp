@@ -0,0 +1,369 @@
+#include "meshbatch.h"
+#include "glfunctionlist.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <tuple>
+
+namespace
+{
+enum MeshAttribBits
+{
+    kMeshAttribUv       = 1 << 0,
+    kMeshAttribColor    = 1 << 1,
+    kMeshAttribGps      = 1 << 2,
+};
+
+// texture, attributes, primitive types, grid cell.
+typedef tuple<uint32_t, uint32_t, string, uint32_t, uint32_t, int64_t, int64_t, int64_t> MeshBatchKey;
+
+struct MergedDrawCall
+{
+    PrimitiveType       primitive_type;
+    bool                b_drawable;
+    bool                b_drawable_patches;
+    bool                b_appendable;
+    vector<uint32_t>    index_list;
+};
+
+struct MeshBatch
+{
+    vector<uint32_t>    mesh_idx_list;
+    uint32_t            num_vertex;
+    uint32_t            num_draw_calls;
+};
+
+bool IsAppendablePrimitive(PrimitiveType primitive_type)
+{
+    return primitive_type == kGlPoints ||
+           primitive_type == kGlLines ||
+           primitive_type == kGlTriangles ||
+           primitive_type == kGlTriangleStrip;
+}
+
+bool CanMergeMesh(const MeshData* mesh_data, uint32_t max_vertices)
+{
+    if (!mesh_data || mesh_data->num_vertex <= 0 || uint32_t(mesh_data->num_vertex) > max_vertices ||
+        !mesh_data->vertex_list || !mesh_data->patch_list.empty() || mesh_data->draw_call_list.empty())
+    {
+        return false;
+    }
+
+    for (const auto& draw_call_info : mesh_data->draw_call_list)
+    {
+        if (uint32_t(draw_call_info.get_primitive_type()) >= 32)
+        {
+            return false;
+        }
+
+        for (int i = 0; i < draw_call_info.get_index_count(); i++)
+        {
+            if (draw_call_info.get_index(i) >= uint32_t(mesh_data->num_vertex))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+MeshBatchKey GetMeshBatchKey(const MeshData* mesh_data, double cell_size)
+{
+    uint32_t attrib_mask = (mesh_data->uv_list ? kMeshAttribUv : 0) |
+                           (mesh_data->color_list ? kMeshAttribColor : 0) |
+                           (mesh_data->gps_vert_list ? kMeshAttribGps : 0);
+
+    uint32_t primitive_mask = 0;
+    for (const auto& draw_call_info : mesh_data->draw_call_list)
+    {
+        primitive_mask |= 1u << uint32_t(draw_call_info.get_primitive_type());
+    }
+
+    int64_t cell[3] = { 0, 0, 0 };
+    if (cell_size > 0)
+    {
+        core::vec3d center = mesh_data->bbox_ws.b_valid ? mesh_data->bbox_ws.GetCentroid() : mesh_data->translation;
+        cell[0] = int64_t(floor(center.x / cell_size));
+        cell[1] = int64_t(floor(center.y / cell_size));
+        cell[2] = int64_t(floor(center.z / cell_size));
+    }
+
+    return MeshBatchKey(mesh_data->idx_in_texture_list,
+                        mesh_data->tex_id,
+                        mesh_data->tex_file_name ? *mesh_data->tex_file_name : string(),
+                        attrib_mask,
+                        primitive_mask,
+                        cell[0], cell[1], cell[2]);
+}
+
+// a strip joined to another repeats the last index of the first and the first of the second,
+// once more if needed so the second starts on an even position and keeps its winding. every
+// triangle across the seam has a repeated index and draws nothing.
+void AppendStrip(const DrawCallInfo& draw_call_info, uint32_t base_vertex, vector<uint32_t>& index_list)
+{
+    int num_index = draw_call_info.get_index_count();
+    if (num_index == 0)
+    {
+        return;
+    }
+
+    if (!index_list.empty())
+    {
+        uint32_t last_index = index_list.back();
+        size_t num_pad = 1 + index_list.size() % 2;
+        index_list.insert(index_list.end(), num_pad, last_index);
+        index_list.push_back(draw_call_info.get_index(0) + base_vertex);
+    }
+
+    for (int i = 0; i < num_index; i++)
+    {
+        index_list.push_back(draw_call_info.get_index(i) + base_vertex);
+    }
+}
+
+void AppendDrawCall(const DrawCallInfo& draw_call_info, uint32_t base_vertex, vector<MergedDrawCall>& draw_call_list)
+{
+    PrimitiveType primitive_type = draw_call_info.get_primitive_type();
+    bool b_appendable = IsAppendablePrimitive(primitive_type);
+
+    MergedDrawCall* merged = nullptr;
+    for (auto& candidate : draw_call_list)
+    {
+        if (b_appendable && candidate.b_appendable &&
+            candidate.primitive_type == primitive_type &&
+            candidate.b_drawable == draw_call_info.is_drawable() &&
+            candidate.b_drawable_patches == draw_call_info.is_drawable_patches())
+        {
+            merged = &candidate;
+            break;
+        }
+    }
+
+    if (!merged)
+    {
+        draw_call_list.emplace_back();
+        merged = &draw_call_list.back();
+        merged->primitive_type = primitive_type;
+        merged->b_drawable = draw_call_info.is_drawable();
+        merged->b_drawable_patches = draw_call_info.is_drawable_patches();
+        merged->b_appendable = b_appendable;
+    }
+
+    if (primitive_type == kGlTriangleStrip)
+    {
+        AppendStrip(draw_call_info, base_vertex, merged->index_list);
+    }
+    else
+    {
+        for (int i = 0; i < draw_call_info.get_index_count(); i++)
+        {
+            merged->index_list.push_back(draw_call_info.get_index(i) + base_vertex);
+        }
+    }
+}
+
+// one mesh of all of the batch, translated to the middle of theirs.
+MeshData* MergeMeshBatch(const GroupMeshData* group_mesh_data, const MeshBatch& batch, MeshBatchStats& stats)
+{
+    const MeshData* first_mesh = group_mesh_data->meshes[batch.mesh_idx_list[0]];
+
+    core::bounds3d translation_bbox;
+    for (uint32_t mesh_idx : batch.mesh_idx_list)
+    {
+        translation_bbox += group_mesh_data->meshes[mesh_idx]->translation;
+    }
+
+    MeshData* merged_mesh = new MeshData;
+    merged_mesh->num_vertex = int32_t(batch.num_vertex);
+    merged_mesh->idx_in_texture_list = first_mesh->idx_in_texture_list;
+    merged_mesh->tex_id = first_mesh->tex_id;
+    if (first_mesh->tex_file_name)
+    {
+        merged_mesh->tex_file_name = make_unique<string>(*first_mesh->tex_file_name);
+    }
+    merged_mesh->translation = translation_bbox.GetCentroid();
+    merged_mesh->dumpped_matrix = first_mesh->dumpped_matrix;
+    merged_mesh->vertex_list = make_unique<core::vec3f[]>(batch.num_vertex);
+    if (first_mesh->uv_list)
+    {
+        merged_mesh->uv_list = make_unique<core::vec2f[]>(batch.num_vertex);
+    }
+    if (first_mesh->color_list)
+    {
+        merged_mesh->color_list = make_unique<uint32_t[]>(batch.num_vertex);
+    }
+    if (first_mesh->gps_vert_list)
+    {
+        merged_mesh->gps_vert_list = make_unique<core::GpsCoord[]>(batch.num_vertex);
+    }
+
+    vector<MergedDrawCall> draw_call_list;
+    uint32_t base_vertex = 0;
+    for (uint32_t mesh_idx : batch.mesh_idx_list)
+    {
+        const MeshData* mesh_data = group_mesh_data->meshes[mesh_idx];
+        uint32_t num_vertex = uint32_t(mesh_data->num_vertex);
+
+        core::vec3d offset = mesh_data->translation - merged_mesh->translation;
+        for (uint32_t i = 0; i < num_vertex; i++)
+        {
+            const core::vec3f& v = mesh_data->vertex_list[i];
+            merged_mesh->vertex_list[base_vertex + i] = core::vec3f(core::vec3d(v.x, v.y, v.z) + offset);
+        }
+
+        if (merged_mesh->uv_list)
+        {
+            copy(mesh_data->uv_list.get(), mesh_data->uv_list.get() + num_vertex, merged_mesh->uv_list.get() + base_vertex);
+        }
+        if (merged_mesh->color_list)
+        {
+            copy(mesh_data->color_list.get(), mesh_data->color_list.get() + num_vertex, merged_mesh->color_list.get() + base_vertex);
+        }
+        if (merged_mesh->gps_vert_list)
+        {
+            copy(mesh_data->gps_vert_list.get(), mesh_data->gps_vert_list.get() + num_vertex, merged_mesh->gps_vert_list.get() + base_vertex);
+        }
+
+        if (mesh_data->bbox_ws.b_valid)
+        {
+            merged_mesh->bbox_ws += mesh_data->bbox_ws;
+        }
+        if (mesh_data->bbox_gps.b_valid)
+        {
+            merged_mesh->bbox_gps += mesh_data->bbox_gps;
+        }
+
+        for (const auto& draw_call_info : mesh_data->draw_call_list)
+        {
+            AppendDrawCall(draw_call_info, base_vertex, draw_call_list);
+        }
+        base_vertex += num_vertex;
+    }
+
+    for (const auto& merged : draw_call_list)
+    {
+        uint32_t max_index = 0;
+        for (uint32_t index : merged.index_list)
+        {
+            max_index = max(max_index, index);
+        }
+
+        merged_mesh->add_draw_call_list(merged.primitive_type, int(merged.index_list.size()), int(max_index));
+        DrawCallInfo& draw_call_info = merged_mesh->get_last_draw_call_info();
+        draw_call_info.set_drawable(merged.b_drawable);
+        draw_call_info.set_drawable_patches(merged.b_drawable_patches);
+        for (uint32_t index : merged.index_list)
+        {
+            draw_call_info.add_index(index);
+        }
+
+        stats.num_wide_draw_calls += draw_call_info.get_index_type() == kGlUInt ? 1 : 0;
+    }
+
+    return merged_mesh;
+}
+}
+
+MeshBatchStats& MeshBatchStats::operator+=(const MeshBatchStats& other)
+{
+    num_meshes_before += other.num_meshes_before;
+    num_meshes_after += other.num_meshes_after;
+    num_draw_calls_before += other.num_draw_calls_before;
+    num_draw_calls_after += other.num_draw_calls_after;
+    num_wide_draw_calls += other.num_wide_draw_calls;
+    return *this;
+}
+
+MeshBatchStats MergeGroupMeshes(GroupMeshData* group_mesh_data, uint32_t max_vertices, double cell_size)
+{
+    MeshBatchStats stats;
+    if (!group_mesh_data)
+    {
+        return stats;
+    }
+
+    // meshes go to the open batch of their key in group order, a new one is opened when
+    // the mesh would take it past max_vertices.
+    vector<MeshBatch> batch_list;
+    map<MeshBatchKey, uint32_t> open_batch_map;
+    for (uint32_t i_mesh = 0; i_mesh < group_mesh_data->meshes.size(); i_mesh++)
+    {
+        const MeshData* mesh_data = group_mesh_data->meshes[i_mesh];
+        if (!mesh_data)
+        {
+            continue;
+        }
+
+        stats.num_meshes_before++;
+        stats.num_draw_calls_before += uint32_t(mesh_data->draw_call_list.size());
+        if (!CanMergeMesh(mesh_data, max_vertices))
+        {
+            continue;
+        }
+
+        MeshBatchKey key = GetMeshBatchKey(mesh_data, cell_size);
+        auto it = open_batch_map.find(key);
+        if (it == open_batch_map.end() || batch_list[it->second].num_vertex + uint32_t(mesh_data->num_vertex) > max_vertices)
+        {
+            open_batch_map[key] = uint32_t(batch_list.size());
+            batch_list.push_back(MeshBatch{ {}, 0, 0 });
+            it = open_batch_map.find(key);
+        }
+
+        MeshBatch& batch = batch_list[it->second];
+        batch.mesh_idx_list.push_back(i_mesh);
+        batch.num_vertex += uint32_t(mesh_data->num_vertex);
+        batch.num_draw_calls += uint32_t(mesh_data->draw_call_list.size());
+    }
+
+    // the merged mesh takes the place of the batch's first, the others are deleted.
+    vector<uint8_t> removed_list(group_mesh_data->meshes.size(), 0);
+    for (const auto& batch : batch_list)
+    {
+        if (batch.mesh_idx_list.size() == 1 && batch.num_draw_calls == 1)
+        {
+            continue;
+        }
+
+        MeshData* merged_mesh = MergeMeshBatch(group_mesh_data, batch, stats);
+        for (uint32_t mesh_idx : batch.mesh_idx_list)
+        {
+            SAFE_DELETE(group_mesh_data->meshes[mesh_idx]);
+            removed_list[mesh_idx] = 1;
+        }
+        group_mesh_data->meshes[batch.mesh_idx_list[0]] = merged_mesh;
+        removed_list[batch.mesh_idx_list[0]] = 0;
+    }
+
+    uint32_t num_kept = 0;
+    for (uint32_t i_mesh = 0; i_mesh < group_mesh_data->meshes.size(); i_mesh++)
+    {
+        if (!removed_list[i_mesh])
+        {
+            group_mesh_data->meshes[num_kept++] = group_mesh_data->meshes[i_mesh];
+        }
+    }
+    group_mesh_data->meshes.resize(num_kept);
+
+    for (const MeshData* mesh_data : group_mesh_data->meshes)
+    {
+        if (mesh_data)
+        {
+            stats.num_meshes_after++;
+            stats.num_draw_calls_after += uint32_t(mesh_data->draw_call_list.size());
+        }
+    }
+
+    return stats;
+}
+
+string FormatMeshBatchStats(const MeshBatchStats& stats)
+{
+    string result = "draw calls " + to_string(stats.num_draw_calls_before) + " -> " + to_string(stats.num_draw_calls_after) +
+                    ", meshes " + to_string(stats.num_meshes_before) + " -> " + to_string(stats.num_meshes_after);
+    if (stats.num_wide_draw_calls > 0)
+    {
+        result += ", " + to_string(stats.num_wide_draw_calls) + " with 32 bit indices";
+    }
+    return result;
+}
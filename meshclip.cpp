@@ -0,0 +1,800 @@
+#include "meshclip.h"
+#include "corethread.h"
+#include <unordered_map>
+#include <algorithm>
+
+namespace
+{
+// the support of a clip polygon edge is a clip line with this bit, a triangle edge without.
+constexpr uint32_t kSupportLine = 0x80000000;
+
+enum ClipVertexType
+{
+    kClipVertexMesh,    // a vertex of the mesh
+    kClipVertexEdge,    // a mesh edge cut by a clip line
+    kClipVertexCorner,  // a corner of the polygon inside a triangle
+    kClipVertexCross,   // two clip lines crossing, dropped again by a later line
+};
+
+// a vertex of a triangle being clipped, named by how it was made so that every cut on
+// a mesh edge is computed from the edge alone, whichever triangle asks.
+struct ClipVertex
+{
+    ClipVertexType  type;
+    uint32_t        a;          // mesh vertex, lower edge vertex, corner or lower line
+    uint32_t        b;          // higher edge vertex or higher line
+    uint32_t        line;
+    double          t;          // from a to b
+    core::vec2d     pos;
+    uint32_t        support;    // of the edge leaving the vertex
+};
+
+struct ClipLine
+{
+    uint32_t        p_idx;      // corners of the polygon
+    uint32_t        q_idx;
+    core::vec2d     p;
+    core::vec2d     q;
+};
+
+// convex part of the region, inside where sign * side of every line is not negative.
+struct ClipPiece
+{
+    vector<uint32_t>    line_list;
+    vector<double>      sign_list;
+    core::bounds2d      bbox;
+};
+
+struct ClipRegion
+{
+    vector<core::vec2d> point_list;     // counter clockwise
+    vector<ClipLine>    line_list;      // polygon edges first, then the diagonals
+    vector<ClipPiece>   piece_list;
+    core::bounds2d      bbox;
+};
+
+struct EdgeKey
+{
+    uint32_t a, b, line;
+
+    bool operator==(const EdgeKey& other) const
+    {
+        return a == other.a && b == other.b && line == other.line;
+    }
+};
+
+struct EdgeKeyHash
+{
+    size_t operator()(const EdgeKey& key) const
+    {
+        return hash<uint64_t>()((uint64_t(key.a) << 32 | key.b) * 31 + key.line);
+    }
+};
+
+double Cross2(const core::vec2d& u, const core::vec2d& v)
+{
+    return u.x * v.y - u.y * v.x;
+}
+
+double Side(const ClipLine& line, const core::vec2d& pos)
+{
+    return Cross2(line.q - line.p, pos - line.p);
+}
+
+double SignedArea(const vector<core::vec2d>& point_list)
+{
+    double area = 0.0;
+    for (size_t i = 0; i < point_list.size(); i++)
+    {
+        area += Cross2(point_list[i], point_list[(i + 1) % point_list.size()]);
+    }
+    return area * 0.5;
+}
+
+// closed segment test, touching counts.
+bool SegmentsTouch(const core::vec2d& a0, const core::vec2d& a1, const core::vec2d& b0, const core::vec2d& b1)
+{
+    double o1 = Cross2(a1 - a0, b0 - a0);
+    double o2 = Cross2(a1 - a0, b1 - a0);
+    double o3 = Cross2(b1 - b0, a0 - b0);
+    double o4 = Cross2(b1 - b0, a1 - b0);
+    if ((o1 > 0.0 && o2 > 0.0) || (o1 < 0.0 && o2 < 0.0) || (o3 > 0.0 && o4 > 0.0) || (o3 < 0.0 && o4 < 0.0))
+    {
+        return false;
+    }
+
+    if (o1 == 0.0 && o2 == 0.0)
+    {
+        return min(a0.x, a1.x) <= max(b0.x, b1.x) && min(b0.x, b1.x) <= max(a0.x, a1.x) &&
+               min(a0.y, a1.y) <= max(b0.y, b1.y) && min(b0.y, b1.y) <= max(a0.y, a1.y);
+    }
+    return true;
+}
+
+bool PointInTriangle(const core::vec2d& pos, const core::vec2d& p0, const core::vec2d& p1, const core::vec2d& p2)
+{
+    double d0 = Cross2(p1 - p0, pos - p0);
+    double d1 = Cross2(p2 - p1, pos - p1);
+    double d2 = Cross2(p0 - p2, pos - p2);
+    return !((d0 < 0.0 || d1 < 0.0 || d2 < 0.0) && (d0 > 0.0 || d1 > 0.0 || d2 > 0.0));
+}
+
+bool PointInPolygon(const vector<core::vec2d>& point_list, const core::vec2d& pos)
+{
+    bool inside = false;
+    for (size_t i = 0, j = point_list.size() - 1; i < point_list.size(); j = i++)
+    {
+        const core::vec2d& pi = point_list[i];
+        const core::vec2d& pj = point_list[j];
+        if ((pi.y > pos.y) != (pj.y > pos.y) && pos.x < (pj.x - pi.x) * (pos.y - pi.y) / (pj.y - pi.y) + pi.x)
+        {
+            inside = !inside;
+        }
+    }
+    return inside;
+}
+
+// ear clipping of a counter clockwise simple polygon.
+bool TriangulatePolygon(const vector<core::vec2d>& point_list, vector<uint32_t>& triangle_list)
+{
+    vector<uint32_t> remaining(point_list.size());
+    for (uint32_t i = 0; i < remaining.size(); i++)
+    {
+        remaining[i] = i;
+    }
+
+    while (remaining.size() > 3)
+    {
+        bool found = false;
+        size_t n = remaining.size();
+        for (size_t i = 0; i < n && !found; i++)
+        {
+            uint32_t i0 = remaining[(i + n - 1) % n], i1 = remaining[i], i2 = remaining[(i + 1) % n];
+            const core::vec2d& p0 = point_list[i0];
+            const core::vec2d& p1 = point_list[i1];
+            const core::vec2d& p2 = point_list[i2];
+            if (Cross2(p1 - p0, p2 - p1) <= 0.0)
+            {
+                continue;
+            }
+
+            bool is_ear = true;
+            for (uint32_t idx : remaining)
+            {
+                if (idx != i0 && idx != i1 && idx != i2 && PointInTriangle(point_list[idx], p0, p1, p2))
+                {
+                    is_ear = false;
+                    break;
+                }
+            }
+
+            if (is_ear)
+            {
+                triangle_list.insert(triangle_list.end(), { i0, i1, i2 });
+                remaining.erase(remaining.begin() + ptrdiff_t(i));
+                found = true;
+            }
+        }
+
+        if (!found)
+        {
+            return false;
+        }
+    }
+
+    triangle_list.insert(triangle_list.end(), remaining.begin(), remaining.end());
+    return true;
+}
+
+bool BuildClipRegion(const vector<core::vec2d>& polygon, ClipRegion& region)
+{
+    // duplicated and collinear points would only give empty pieces.
+    vector<core::vec2d>& point_list = region.point_list;
+    point_list = polygon;
+    for (bool changed = true; changed && point_list.size() >= 3;)
+    {
+        changed = false;
+        for (size_t i = 0; i < point_list.size() && point_list.size() >= 3; i++)
+        {
+            size_t n = point_list.size();
+            const core::vec2d& p0 = point_list[(i + n - 1) % n];
+            const core::vec2d& p1 = point_list[i];
+            const core::vec2d& p2 = point_list[(i + 1) % n];
+            if (Cross2(p1 - p0, p2 - p1) == 0.0)
+            {
+                point_list.erase(point_list.begin() + ptrdiff_t(i));
+                changed = true;
+            }
+        }
+    }
+
+    if (point_list.size() < 3 || SignedArea(point_list) == 0.0)
+    {
+        return false;
+    }
+
+    if (SignedArea(point_list) < 0.0)
+    {
+        reverse(point_list.begin(), point_list.end());
+    }
+
+    uint32_t n = uint32_t(point_list.size());
+    region.bbox.Reset();
+    for (uint32_t i = 0; i < n; i++)
+    {
+        region.bbox += point_list[i];
+        region.line_list.push_back({ i, (i + 1) % n, point_list[i], point_list[(i + 1) % n] });
+    }
+
+    bool convex = true;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        convex = convex && Cross2(point_list[(i + 1) % n] - point_list[i], point_list[(i + 2) % n] - point_list[(i + 1) % n]) > 0.0;
+    }
+
+    if (convex)
+    {
+        ClipPiece piece;
+        for (uint32_t i = 0; i < n; i++)
+        {
+            piece.line_list.push_back(i);
+            piece.sign_list.push_back(1.0);
+        }
+        piece.bbox = region.bbox;
+        region.piece_list.push_back(move(piece));
+        return true;
+    }
+
+    vector<uint32_t> triangle_list;
+    if (!TriangulatePolygon(point_list, triangle_list))
+    {
+        return false;
+    }
+
+    unordered_map<uint64_t, uint32_t> diagonal_map;
+    for (size_t i = 0; i < triangle_list.size(); i += 3)
+    {
+        ClipPiece piece;
+        for (uint32_t k = 0; k < 3; k++)
+        {
+            uint32_t c0 = triangle_list[i + k], c1 = triangle_list[i + (k + 1) % 3];
+            piece.bbox += point_list[c0];
+            if (c1 == (c0 + 1) % n)
+            {
+                piece.line_list.push_back(c0);
+                piece.sign_list.push_back(1.0);
+            }
+            else if (c0 == (c1 + 1) % n)
+            {
+                piece.line_list.push_back(c1);
+                piece.sign_list.push_back(-1.0);
+            }
+            else
+            {
+                // a diagonal runs from its lower to its higher corner in both pieces it bounds.
+                uint32_t lo = min(c0, c1), hi = max(c0, c1);
+                auto result = diagonal_map.emplace(uint64_t(lo) << 32 | hi, uint32_t(region.line_list.size()));
+                if (result.second)
+                {
+                    region.line_list.push_back({ lo, hi, point_list[lo], point_list[hi] });
+                }
+                piece.line_list.push_back(result.first->second);
+                piece.sign_list.push_back(c0 < c1 ? 1.0 : -1.0);
+            }
+        }
+        region.piece_list.push_back(move(piece));
+    }
+    return true;
+}
+
+class MeshClipper
+{
+    const MeshData&             mesh_;
+    const ClipRegion&           region_;
+    vector<core::vec2d>         pos_list_;
+    vector<uint32_t>            vertex_map_;
+    vector<uint32_t>            corner_map_;
+    double                      tolerance_;
+    unordered_map<EdgeKey, uint32_t, EdgeKeyHash> edge_map_;
+
+    vector<core::vec3f>         vertex_list_;
+    vector<core::GpsCoord>      gps_vert_list_;
+    vector<core::vec2f>         uv_list_;
+    vector<uint32_t>            color_list_;
+    vector<uint32_t>            index_list_;
+
+    // new vertex from up to three mesh vertices and their weights.
+    uint32_t add_vertex(const uint32_t* idx, const double* weight, uint32_t count)
+    {
+        core::vec3d position(0.0, 0.0, 0.0);
+        core::GpsCoord gps_coord(0.0, 0.0, 0.0);
+        double u = 0.0, v = 0.0, rgba[4] = { 0.0, 0.0, 0.0, 0.0 };
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const core::vec3f& p = mesh_.vertex_list[idx[i]];
+            position += core::vec3d(p.x, p.y, p.z) * weight[i];
+            if (mesh_.gps_vert_list)
+            {
+                gps_coord += mesh_.gps_vert_list[idx[i]] * weight[i];
+            }
+            if (mesh_.uv_list)
+            {
+                u += mesh_.uv_list[idx[i]].x * weight[i];
+                v += mesh_.uv_list[idx[i]].y * weight[i];
+            }
+            if (mesh_.color_list)
+            {
+                for (uint32_t c = 0; c < 4; c++)
+                {
+                    rgba[c] += double((mesh_.color_list[idx[i]] >> (c * 8)) & 0xff) * weight[i];
+                }
+            }
+        }
+
+        vertex_list_.push_back(core::vec3f(float(position.x), float(position.y), float(position.z)));
+        gps_vert_list_.push_back(gps_coord);
+        uv_list_.push_back(core::vec2f(float(u), float(v)));
+        uint32_t color = 0;
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            color |= uint32_t(min(max(rgba[c] + 0.5, 0.0), 255.0)) << (c * 8);
+        }
+        color_list_.push_back(color);
+        return uint32_t(vertex_list_.size() - 1);
+    }
+
+    uint32_t get_output_vertex(const ClipVertex& vertex, const uint32_t* tri, unordered_map<uint64_t, uint32_t>& cross_map)
+    {
+        if (vertex.type == kClipVertexMesh)
+        {
+            if (vertex_map_[vertex.a] == INVALID_VALUE)
+            {
+                double weight = 1.0;
+                vertex_map_[vertex.a] = add_vertex(&vertex.a, &weight, 1);
+            }
+            return vertex_map_[vertex.a];
+        }
+
+        if (vertex.type == kClipVertexEdge)
+        {
+            auto result = edge_map_.emplace(EdgeKey{ vertex.a, vertex.b, vertex.line }, 0);
+            if (result.second)
+            {
+                uint32_t idx[2] = { vertex.a, vertex.b };
+                double weight[2] = { 1.0 - vertex.t, vertex.t };
+                result.first->second = add_vertex(idx, weight, 2);
+            }
+            return result.first->second;
+        }
+
+        // corners are shared by every triangle that reaches them.
+        uint32_t* corner = vertex.type == kClipVertexCorner ? &corner_map_[vertex.a] : nullptr;
+        if (corner && *corner != INVALID_VALUE)
+        {
+            return *corner;
+        }
+
+        if (corner)
+        {
+            // a corner on a mesh vertex is that vertex.
+            for (uint32_t k = 0; k < 3; k++)
+            {
+                if (core::length(vertex.pos - pos_list_[tri[k]]) <= tolerance_)
+                {
+                    ClipVertex mesh_vertex = vertex;
+                    mesh_vertex.type = kClipVertexMesh;
+                    mesh_vertex.a = tri[k];
+                    *corner = get_output_vertex(mesh_vertex, tri, cross_map);
+                    return *corner;
+                }
+            }
+        }
+
+        auto result = cross_map.emplace(uint64_t(vertex.a) << 32 | vertex.b, 0);
+        if (corner || result.second)
+        {
+            // inside the triangle, the point takes the triangle's plane.
+            const core::vec2d& p0 = pos_list_[tri[0]];
+            const core::vec2d& p1 = pos_list_[tri[1]];
+            const core::vec2d& p2 = pos_list_[tri[2]];
+            double area = Cross2(p1 - p0, p2 - p0);
+            double weight[3];
+            weight[1] = Cross2(vertex.pos - p0, p2 - p0) / area;
+            weight[2] = Cross2(p1 - p0, vertex.pos - p0) / area;
+            weight[0] = 1.0 - weight[1] - weight[2];
+            result.first->second = add_vertex(tri, weight, 3);
+            if (corner)
+            {
+                *corner = result.first->second;
+            }
+        }
+        return result.first->second;
+    }
+
+    // points this close to a line are on it, so every triangle and piece sees them alike.
+    double side(uint32_t line, const core::vec2d& pos) const
+    {
+        const ClipLine& clip_line = region_.line_list[line];
+        double d = Side(clip_line, pos);
+        return fabs(d) <= tolerance_ * core::length(clip_line.q - clip_line.p) ? 0.0 : d;
+    }
+
+    ClipVertex intersect(const ClipVertex& p, const uint32_t* tri, uint32_t line) const
+    {
+        ClipVertex vertex;
+        vertex.line = line;
+        if (p.support & kSupportLine)
+        {
+            uint32_t other = p.support & ~kSupportLine;
+            const ClipLine& l0 = region_.line_list[min(other, line)];
+            const ClipLine& l1 = region_.line_list[max(other, line)];
+            vertex.t = 0.0;
+            if (l0.p_idx == l1.p_idx || l0.p_idx == l1.q_idx || l0.q_idx == l1.p_idx || l0.q_idx == l1.q_idx)
+            {
+                vertex.type = kClipVertexCorner;
+                vertex.a = (l0.p_idx == l1.p_idx || l0.p_idx == l1.q_idx) ? l0.p_idx : l0.q_idx;
+                vertex.b = INVALID_VALUE;
+                vertex.pos = region_.point_list[vertex.a];
+            }
+            else
+            {
+                double denom = Cross2(l0.q - l0.p, l1.q - l1.p);
+                double s = denom != 0.0 ? Cross2(l1.p - l0.p, l1.q - l1.p) / denom : 0.0;
+                vertex.type = kClipVertexCross;
+                vertex.a = min(other, line);
+                vertex.b = max(other, line);
+                vertex.pos = l0.p + (l0.q - l0.p) * s;
+            }
+        }
+        else
+        {
+            uint32_t a = tri[p.support], b = tri[(p.support + 1) % 3];
+            vertex.type = kClipVertexEdge;
+            vertex.a = min(a, b);
+            vertex.b = max(a, b);
+            double da = side(line, pos_list_[vertex.a]);
+            double db = side(line, pos_list_[vertex.b]);
+            vertex.t = da != db ? min(max(da / (da - db), 0.0), 1.0) : 0.5;
+            vertex.pos = pos_list_[vertex.a] + (pos_list_[vertex.b] - pos_list_[vertex.a]) * vertex.t;
+            const ClipLine& clip_line = region_.line_list[line];
+            if (vertex.t == 0.0 || vertex.t == 1.0)
+            {
+                // a mesh vertex on the line is that vertex, not a copy of it.
+                vertex.type = kClipVertexMesh;
+                vertex.a = vertex.t == 0.0 ? vertex.a : vertex.b;
+                vertex.pos = pos_list_[vertex.a];
+            }
+            else if (core::length(vertex.pos - clip_line.p) <= tolerance_ || core::length(vertex.pos - clip_line.q) <= tolerance_)
+            {
+                // a corner on the edge, the lines meeting there would each cut a copy.
+                vertex.type = kClipVertexCorner;
+                vertex.a = core::length(vertex.pos - clip_line.p) <= tolerance_ ? clip_line.p_idx : clip_line.q_idx;
+                vertex.b = INVALID_VALUE;
+                vertex.pos = region_.point_list[vertex.a];
+            }
+        }
+        return vertex;
+    }
+
+    // sutherland hodgman of the triangle against a convex piece.
+    void clip_to_piece(const uint32_t* tri, const ClipPiece& piece, vector<ClipVertex>& polygon, vector<ClipVertex>& scratch) const
+    {
+        polygon.clear();
+        for (uint32_t k = 0; k < 3; k++)
+        {
+            ClipVertex vertex;
+            vertex.type = kClipVertexMesh;
+            vertex.a = tri[k];
+            vertex.b = 0;
+            vertex.line = 0;
+            vertex.t = 0.0;
+            vertex.pos = pos_list_[tri[k]];
+            vertex.support = k;
+            polygon.push_back(vertex);
+        }
+
+        for (size_t i = 0; i < piece.line_list.size() && polygon.size() >= 3; i++)
+        {
+            uint32_t line = piece.line_list[i];
+            double sign = piece.sign_list[i];
+            scratch.clear();
+            for (size_t k = 0; k < polygon.size(); k++)
+            {
+                const ClipVertex& p = polygon[k];
+                const ClipVertex& q = polygon[(k + 1) % polygon.size()];
+                bool p_in = sign * side(line, p.pos) >= 0.0;
+                bool q_in = sign * side(line, q.pos) >= 0.0;
+                if (p_in && q_in)
+                {
+                    scratch.push_back(q);
+                }
+                else if (p_in)
+                {
+                    scratch.push_back(intersect(p, tri, line));
+                    scratch.back().support = kSupportLine | line;
+                }
+                else if (q_in)
+                {
+                    scratch.push_back(intersect(p, tri, line));
+                    scratch.back().support = p.support;
+                    scratch.push_back(q);
+                }
+            }
+            swap(polygon, scratch);
+        }
+    }
+
+    // ear clipping of the clipped convex polygon, collinear ears are skipped so points on
+    // an edge stay connected to both sides.
+    void add_polygon(const vector<uint32_t>& idx_list, const vector<core::vec2d>& pos_list, double orientation)
+    {
+        vector<uint32_t> remaining(idx_list.size());
+        for (uint32_t i = 0; i < remaining.size(); i++)
+        {
+            remaining[i] = i;
+        }
+
+        while (remaining.size() >= 3)
+        {
+            size_t n = remaining.size();
+            size_t ear = n;
+            for (size_t i = 0; i < n && ear == n; i++)
+            {
+                const core::vec2d& p0 = pos_list[remaining[(i + n - 1) % n]];
+                const core::vec2d& p1 = pos_list[remaining[i]];
+                const core::vec2d& p2 = pos_list[remaining[(i + 1) % n]];
+                if (orientation * Cross2(p1 - p0, p2 - p1) > 0.0)
+                {
+                    ear = i;
+                }
+            }
+
+            if (ear == n)
+            {
+                break;
+            }
+
+            uint32_t i0 = idx_list[remaining[(ear + n - 1) % n]];
+            uint32_t i1 = idx_list[remaining[ear]];
+            uint32_t i2 = idx_list[remaining[(ear + 1) % n]];
+            if (i0 != i1 && i1 != i2 && i2 != i0)
+            {
+                index_list_.insert(index_list_.end(), { i0, i1, i2 });
+            }
+            remaining.erase(remaining.begin() + ptrdiff_t(ear));
+        }
+    }
+
+    bool is_edge_cut(uint32_t a, uint32_t b) const
+    {
+        const core::vec2d& p0 = pos_list_[min(a, b)];
+        const core::vec2d& p1 = pos_list_[max(a, b)];
+        for (const auto& line : region_.line_list)
+        {
+            if (SegmentsTouch(p0, p1, line.p, line.q))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+public:
+    MeshClipper(const MeshData& mesh_data, const ClipRegion& region, MeshClipSpace clip_space)
+        : mesh_(mesh_data), region_(region)
+    {
+        uint32_t num_vertex = uint32_t(mesh_data.num_vertex);
+        pos_list_.resize(num_vertex);
+        for (uint32_t i = 0; i < num_vertex; i++)
+        {
+            if (clip_space == kMeshClipGps)
+            {
+                pos_list_[i] = core::vec2d(mesh_data.gps_vert_list[i].lon, mesh_data.gps_vert_list[i].lat);
+            }
+            else
+            {
+                const core::vec3f& v = mesh_data.vertex_list[i];
+                pos_list_[i] = core::vec2d(v.x + mesh_data.translation.x, v.y + mesh_data.translation.y);
+            }
+        }
+        vertex_map_.assign(num_vertex, INVALID_VALUE);
+        corner_map_.assign(region.point_list.size(), INVALID_VALUE);
+
+        // a few ulps of the coordinates, what rounding leaves between points that coincide.
+        const core::bounds2d& bbox = region.bbox;
+        double scale = max(max(fabs(bbox.bb_min.x), fabs(bbox.bb_max.x)), max(fabs(bbox.bb_min.y), fabs(bbox.bb_max.y)));
+        tolerance_ = max(scale, core::length(bbox.bb_max - bbox.bb_min)) * 1e-12;
+    }
+
+    void clip()
+    {
+        vector<uint32_t> index_list;
+        mesh_.get_triangle_list(index_list);
+
+        uint32_t num_vertex = uint32_t(mesh_.num_vertex);
+        vector<ClipVertex> polygon, scratch;
+        vector<uint32_t> idx_list;
+        vector<core::vec2d> polygon_pos_list;
+        unordered_map<uint64_t, uint32_t> cross_map;
+        for (size_t i = 0; i + 2 < index_list.size(); i += 3)
+        {
+            const uint32_t* tri = &index_list[i];
+            if (tri[0] >= num_vertex || tri[1] >= num_vertex || tri[2] >= num_vertex)
+            {
+                continue;
+            }
+
+            const core::vec2d& p0 = pos_list_[tri[0]];
+            const core::vec2d& p1 = pos_list_[tri[1]];
+            const core::vec2d& p2 = pos_list_[tri[2]];
+            core::bounds2d tri_bbox;
+            tri_bbox += p0;
+            tri_bbox += p1;
+            tri_bbox += p2;
+            if (!(tri_bbox ^ region_.bbox).b_valid)
+            {
+                continue;
+            }
+
+            double orientation = Cross2(p1 - p0, p2 - p0);
+            bool split = orientation != 0.0 && (is_edge_cut(tri[0], tri[1]) || is_edge_cut(tri[1], tri[2]) || is_edge_cut(tri[2], tri[0]));
+            for (size_t k = 0; k < region_.point_list.size() && orientation != 0.0 && !split; k++)
+            {
+                split = PointInTriangle(region_.point_list[k], p0, p1, p2);
+            }
+
+            if (!split)
+            {
+                // whole inside one piece or outside, walls standing on the outline too.
+                if (PointInPolygon(region_.point_list, (p0 + p1 + p2) / 3.0))
+                {
+                    for (uint32_t k = 0; k < 3; k++)
+                    {
+                        ClipVertex vertex;
+                        vertex.type = kClipVertexMesh;
+                        vertex.a = tri[k];
+                        index_list_.push_back(get_output_vertex(vertex, tri, cross_map));
+                    }
+                }
+                continue;
+            }
+
+            cross_map.clear();
+            for (const auto& piece : region_.piece_list)
+            {
+                if (!(tri_bbox ^ piece.bbox).b_valid)
+                {
+                    continue;
+                }
+
+                clip_to_piece(tri, piece, polygon, scratch);
+                if (polygon.size() < 3)
+                {
+                    continue;
+                }
+
+                idx_list.clear();
+                polygon_pos_list.clear();
+                for (const auto& vertex : polygon)
+                {
+                    idx_list.push_back(get_output_vertex(vertex, tri, cross_map));
+                    polygon_pos_list.push_back(vertex.pos);
+                }
+                add_polygon(idx_list, polygon_pos_list, orientation);
+            }
+        }
+    }
+
+    bool get_mesh(MeshData& clipped_mesh)
+    {
+        if (index_list_.empty())
+        {
+            return false;
+        }
+
+        uint32_t num_vertex = uint32_t(vertex_list_.size());
+        clipped_mesh.num_vertex = int(num_vertex);
+        clipped_mesh.idx_in_texture_list = mesh_.idx_in_texture_list;
+        clipped_mesh.tex_id = mesh_.tex_id;
+        clipped_mesh.tex_file_name = mesh_.tex_file_name ? make_unique<string>(*mesh_.tex_file_name) : nullptr;
+        clipped_mesh.translation = mesh_.translation;
+        clipped_mesh.dumpped_matrix = mesh_.dumpped_matrix;
+        clipped_mesh.patch_list = mesh_.patch_list;
+        clipped_mesh.bbox_ws.Reset();
+        clipped_mesh.bbox_gps.Reset();
+
+        clipped_mesh.vertex_list = make_unique<core::vec3f[]>(num_vertex);
+        for (uint32_t i = 0; i < num_vertex; i++)
+        {
+            clipped_mesh.vertex_list[i] = vertex_list_[i];
+            clipped_mesh.bbox_ws += core::vec3d(vertex_list_[i].x, vertex_list_[i].y, vertex_list_[i].z) + mesh_.translation;
+        }
+
+        clipped_mesh.gps_vert_list = nullptr;
+        if (mesh_.gps_vert_list)
+        {
+            clipped_mesh.gps_vert_list = make_unique<core::GpsCoord[]>(num_vertex);
+            for (uint32_t i = 0; i < num_vertex; i++)
+            {
+                clipped_mesh.gps_vert_list[i] = gps_vert_list_[i];
+                clipped_mesh.bbox_gps += gps_vert_list_[i];
+            }
+        }
+
+        clipped_mesh.uv_list = nullptr;
+        if (mesh_.uv_list)
+        {
+            clipped_mesh.uv_list = make_unique<core::vec2f[]>(num_vertex);
+            copy(uv_list_.begin(), uv_list_.end(), clipped_mesh.uv_list.get());
+        }
+
+        clipped_mesh.color_list = nullptr;
+        if (mesh_.color_list)
+        {
+            clipped_mesh.color_list = make_unique<uint32_t[]>(num_vertex);
+            copy(color_list_.begin(), color_list_.end(), clipped_mesh.color_list.get());
+        }
+
+        clipped_mesh.draw_call_list.clear();
+        clipped_mesh.add_draw_call_list(kGlTriangles, int(index_list_.size()), int(num_vertex));
+        DrawCallInfo& draw_call_info = clipped_mesh.get_last_draw_call_info();
+        for (uint32_t idx : index_list_)
+        {
+            draw_call_info.add_index(idx);
+        }
+        return true;
+    }
+};
+
+bool ClipMeshToRegion(const MeshData& mesh_data, const ClipRegion& region, MeshClipSpace clip_space, MeshData& clipped_mesh)
+{
+    if (mesh_data.num_vertex <= 0 || !mesh_data.vertex_list || (clip_space == kMeshClipGps && !mesh_data.gps_vert_list))
+    {
+        return false;
+    }
+
+    MeshClipper clipper(mesh_data, region, clip_space);
+    clipper.clip();
+    return clipper.get_mesh(clipped_mesh);
+}
+}
+
+bool ClipMeshToPolygon(const MeshData& mesh_data, const vector<core::vec2d>& polygon,
+                       MeshClipSpace clip_space, MeshData& clipped_mesh)
+{
+    ClipRegion region;
+    return BuildClipRegion(polygon, region) && ClipMeshToRegion(mesh_data, region, clip_space, clipped_mesh);
+}
+
+bool ClipMeshToBounds(const MeshData& mesh_data, const core::bounds2d& bbox,
+                      MeshClipSpace clip_space, MeshData& clipped_mesh)
+{
+    vector<core::vec2d> polygon = { bbox.bb_min, core::vec2d(bbox.bb_max.x, bbox.bb_min.y),
+                                    bbox.bb_max, core::vec2d(bbox.bb_min.x, bbox.bb_max.y) };
+    return ClipMeshToPolygon(mesh_data, polygon, clip_space, clipped_mesh);
+}
+
+void ClipMeshesToPolygon(const vector<MeshData*>& mesh_list, const vector<core::vec2d>& polygon,
+                         MeshClipSpace clip_space, vector<unique_ptr<MeshData>>& clipped_mesh_list)
+{
+    clipped_mesh_list.clear();
+    clipped_mesh_list.resize(mesh_list.size());
+
+    ClipRegion region;
+    if (!BuildClipRegion(polygon, region))
+    {
+        return;
+    }
+
+    core::ParallelFor(mesh_list.size(), 1, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            auto clipped_mesh = make_unique<MeshData>();
+            if (mesh_list[i] && ClipMeshToRegion(*mesh_list[i], region, clip_space, *clipped_mesh))
+            {
+                clipped_mesh_list[i] = move(clipped_mesh);
+            }
+        }
+    });
+}
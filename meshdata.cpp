@@ -1,4 +1,8 @@
 #include "meshdata.h"
+#include "coregeographic.h"
+#include "meshclip.h"
+#include "boundsgrid.h"
+#include "corethread.h"
 
 bool CullingCore(const core::bounds3f& bbox, const core::matrix4f& world_proj_mat, float scale)
 {
@@ -7,14 +11,7 @@ bool CullingCore(const core::bounds3f& bbox, const core::matrix4f& world_proj_ma
     core::bounds3f bbox_scaled;
     bbox_scaled.bb_min = bbox.bb_min * scale;
     bbox_scaled.bb_max = bbox.bb_max * scale;
-    p[0] = world_proj_mat * core::vec4f(bbox_scaled.bb_min.x, bbox_scaled.bb_min.y, bbox_scaled.bb_min.z, 1.0);
-    p[1] = world_proj_mat * core::vec4f(bbox_scaled.bb_max.x, bbox_scaled.bb_min.y, bbox_scaled.bb_min.z, 1.0);
-    p[2] = world_proj_mat * core::vec4f(bbox_scaled.bb_min.x, bbox_scaled.bb_max.y, bbox_scaled.bb_min.z, 1.0);
-    p[3] = world_proj_mat * core::vec4f(bbox_scaled.bb_max.x, bbox_scaled.bb_max.y, bbox_scaled.bb_min.z, 1.0);
-    p[4] = world_proj_mat * core::vec4f(bbox_scaled.bb_min.x, bbox_scaled.bb_min.y, bbox_scaled.bb_max.z, 1.0);
-    p[5] = world_proj_mat * core::vec4f(bbox_scaled.bb_max.x, bbox_scaled.bb_min.y, bbox_scaled.bb_max.z, 1.0);
-    p[6] = world_proj_mat * core::vec4f(bbox_scaled.bb_min.x, bbox_scaled.bb_max.y, bbox_scaled.bb_max.z, 1.0);
-    p[7] = world_proj_mat * core::vec4f(bbox_scaled.bb_max.x, bbox_scaled.bb_max.y, bbox_scaled.bb_max.z, 1.0);
+    core::TransformBounds(world_proj_mat, bbox_scaled, p);
 
     for (int i = 0; i < 8; i++)
     {
@@ -70,57 +67,106 @@ bool MeshData::culling(const core::vec3d& reference_pos, const core::matrix4f& w
     return CullingCore(local_bbox, world_proj_mat, scale);
 }
 
-void PatchCutting(const PatchInfo& patch_info,
-                  const vector<MapInfo>& map_list,
-                  const vector<TexInfo>& tex_list,
-                  MeshData& mesh_data)
+void DrawCallInfo::get_triangle_list(vector<uint32_t>& index_list) const
 {
-    for (uint32_t i = 0; i < map_list.size(); i++)
+    if (primitive_type_ == kGlTriangleStrip)
     {
+        bool flip = false;
+        for (int i = 2; i < num_index_; i++)
+        {
+            uint32_t i0 = get_index(i - 2);
+            uint32_t i1 = get_index(i - 1);
+            uint32_t i2 = get_index(i);
+            if (i0 != i1 && i1 != i2 && i2 != i0)
+            {
+                index_list.push_back(flip ? i1 : i0);
+                index_list.push_back(flip ? i0 : i1);
+                index_list.push_back(i2);
+            }
+            flip = !flip;
+        }
+    }
+    else if (primitive_type_ == kGlTriangles)
+    {
+        for (int i = 0; i < num_index_; i++)
+        {
+            index_list.push_back(get_index(i));
+        }
+    }
+}
 
+void MeshData::get_triangle_list(vector<uint32_t>& index_list) const
+{
+    for (const auto& draw_call_info : draw_call_list)
+    {
+        draw_call_info.get_triangle_list(index_list);
     }
 }
 
+core::GpsCoord MeshData::get_gps_coord(uint32_t idx, const core::CoordinateTransformer& enu_frame) const
+{
+    if (gps_vert_list)
+    {
+        return gps_vert_list[idx];
+    }
+
+    const core::vec3f& v = vertex_list[idx];
+    return enu_frame.enu_to_lla(core::vec3d(v.x, v.y, v.z) + translation);
+}
+
+bool PatchCutting(const PatchInfo& patch_info, const MeshData& mesh_data, MeshData& patch_mesh_data)
+{
+    return ClipMeshToBounds(mesh_data, patch_info.bbox, kMeshClipGps, patch_mesh_data);
+}
+
 void PatchesCutting(const vector<core::bounds2d>& patch_list,
                     const vector<core::bounds2d>& map_list,
                     const vector<core::bounds2d>& tex_list,
                     vector<PatchInfo>& patch_info_list)
 {
-    for (uint32_t i_patch = 0; i_patch < patch_list.size(); i_patch++)
+    // maps and textures are found through a hash grid instead of testing every patch
+    // against every box; the lists come out the same, ascending.
+    vector<core::bounds2d> bbox_list(patch_list);
+    bbox_list.insert(bbox_list.end(), map_list.begin(), map_list.end());
+    bbox_list.insert(bbox_list.end(), tex_list.begin(), tex_list.end());
+    double cell_size = BoundsGridIndex::suggest_cell_size(bbox_list);
+
+    BoundsGridIndex map_index(cell_size);
+    for (const auto& map_bbox : map_list)
+    {
+        map_index.add(map_bbox);
+    }
+
+    BoundsGridIndex tex_index(cell_size);
+    for (const auto& tex_bbox : tex_list)
+    {
+        tex_index.add(tex_bbox);
+    }
+
+    size_t base = patch_info_list.size();
+    patch_info_list.resize(base + patch_list.size());
+    core::ParallelFor(patch_list.size(), 64, [&](size_t begin, size_t end)
     {
         vector<uint32_t> map_idx_list;
         vector<uint32_t> tex_idx_list;
-        for (uint32_t i_map = 0; i_map < map_list.size(); i_map++)
+        for (size_t i_patch = begin; i_patch < end; i_patch++)
         {
-            core::bounds2d intersect_bbox = patch_list[i_patch] ^ map_list[i_map];
-            if (intersect_bbox.b_valid)
+            map_index.query(patch_list[i_patch], map_idx_list);
+            tex_index.query(patch_list[i_patch], tex_idx_list);
+
+            PatchInfo& patch_info = patch_info_list[base + i_patch];
+            patch_info.bbox = patch_list[i_patch];
+            if (map_idx_list.size() > 0)
             {
-                map_idx_list.push_back(i_map);
+                patch_info.map_idx_list = make_unique<uint32_t[]>(map_idx_list.size());
+                memcpy(patch_info.map_idx_list.get(), map_idx_list.data(), sizeof(uint32_t) * map_idx_list.size());
             }
-        }
 
-        for (uint32_t i_tex = 0; i_tex < tex_list.size(); i_tex++)
-        {
-            core::bounds2d intersect_bbox = patch_list[i_patch] ^ tex_list[i_tex];
-            if (intersect_bbox.b_valid)
+            if (tex_idx_list.size() > 0)
             {
-                tex_idx_list.push_back(i_tex);
+                patch_info.tex_idx_list = make_unique<uint32_t[]>(tex_idx_list.size());
+                memcpy(patch_info.tex_idx_list.get(), tex_idx_list.data(), sizeof(uint32_t) * tex_idx_list.size());
             }
         }
-
-        PatchInfo patch_info;
-        if (map_idx_list.size() > 0)
-        {
-            patch_info.map_idx_list = make_unique<uint32_t[]>(map_idx_list.size());
-            memcpy(patch_info.map_idx_list.get(), map_idx_list.data(), sizeof(uint32_t) * map_idx_list.size());
-        }
-
-        if (tex_idx_list.size() > 0)
-        {
-            patch_info.tex_idx_list = make_unique<uint32_t[]>(tex_idx_list.size());
-            memcpy(patch_info.tex_idx_list.get(), tex_idx_list.data(), sizeof(uint32_t) * tex_idx_list.size());
-        }
-
-        patch_info_list.push_back(move(patch_info));
-    }
+    });
 }
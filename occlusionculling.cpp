@@ -0,0 +1,546 @@
+#include "occlusionculling.h"
+#include "meshdata.h"
+#include "corethread.h"
+#include <algorithm>
+#include <cfloat>
+
+namespace
+{
+// clip space planes occluders are clipped to, the near plane and a guard band twice the
+// screen. inside the band the edge functions stay exact enough in float.
+constexpr float kGuardBand = 2.0f;
+constexpr int32_t kNumClipPlanes = 5;
+const core::vec4f kClipPlanes[kNumClipPlanes] = {
+    core::vec4f(0.0f, 0.0f, 1.0f, 1.0f),
+    core::vec4f(-1.0f, 0.0f, 0.0f, kGuardBand),
+    core::vec4f(1.0f, 0.0f, 0.0f, kGuardBand),
+    core::vec4f(0.0f, -1.0f, 0.0f, kGuardBand),
+    core::vec4f(0.0f, 1.0f, 0.0f, kGuardBand)};
+// a triangle gains one vertex per plane at most.
+constexpr int32_t kMaxClipVertices = 3 + kNumClipPlanes;
+
+// relative depth a bound can be behind an occluder and still be visible, meshes and their
+// bounds round differently on the way to clip space.
+constexpr float kDepthTolerance = 1.0e-4f;
+
+float GetPlaneDistance(const core::vec4f& plane, const core::vec4f& v)
+{
+    return plane.x * v.x + plane.y * v.y + plane.z * v.z + plane.w * v.w;
+}
+
+uint32_t GetOutsideMask(const core::vec4f& v)
+{
+    uint32_t mask = 0;
+    for (int32_t i = 0; i < kNumClipPlanes; i++)
+    {
+        mask |= GetPlaneDistance(kClipPlanes[i], v) < 0.0f ? 1u << i : 0u;
+    }
+    return mask;
+}
+
+// sutherland hodgman against one plane, the number of vertices left.
+int32_t ClipPolygon(const core::vec4f* src, int32_t num_src, const core::vec4f& plane, core::vec4f* dst)
+{
+    int32_t num_dst = 0;
+    for (int32_t i = 0; i < num_src; i++)
+    {
+        const core::vec4f& a = src[i];
+        const core::vec4f& b = src[(i + 1) % num_src];
+        float da = GetPlaneDistance(plane, a);
+        float db = GetPlaneDistance(plane, b);
+        if (da >= 0.0f)
+        {
+            dst[num_dst++] = a;
+        }
+        if ((da >= 0.0f) != (db >= 0.0f))
+        {
+            float t = da / (da - db);
+            dst[num_dst++] = a + (b - a) * t;
+        }
+    }
+    return num_dst;
+}
+
+int32_t ToPixel(float v, int32_t size)
+{
+    return int32_t(floor(min(max(v, -1.0f), float(size))));
+}
+
+// clip space to pixels, false for triangles without area or not covering a pixel center.
+bool SetupTriangle(const core::vec4f& v0, const core::vec4f& v1, const core::vec4f& v2, int32_t width, int32_t height, OcclusionTriangle& tri)
+{
+    const core::vec4f* v[3] = {&v0, &v1, &v2};
+    float sx[3], sy[3], d[3];
+    for (int32_t i = 0; i < 3; i++)
+    {
+        float inv_w = 1.0f / v[i]->w;
+        sx[i] = (v[i]->x * inv_w * 0.5f + 0.5f) * width;
+        sy[i] = (v[i]->y * inv_w * 0.5f + 0.5f) * height;
+        d[i] = inv_w;
+    }
+
+    float area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sx[2] - sx[0]) * (sy[1] - sy[0]);
+    if (!(fabs(area) > 0.0f))
+    {
+        return false;
+    }
+
+    // two sided, wind every triangle counter clockwise.
+    if (area < 0.0f)
+    {
+        swap(sx[1], sx[2]);
+        swap(sy[1], sy[2]);
+        swap(d[1], d[2]);
+        area = -area;
+    }
+
+    // pixels whose center is within the bounds.
+    tri.rect[0] = max(ToPixel(min(min(sx[0], sx[1]), sx[2]) + 0.5f, width), 0);
+    tri.rect[1] = max(ToPixel(min(min(sy[0], sy[1]), sy[2]) + 0.5f, height), 0);
+    tri.rect[2] = min(ToPixel(max(max(sx[0], sx[1]), sx[2]) - 0.5f, width), width - 1);
+    tri.rect[3] = min(ToPixel(max(max(sy[0], sy[1]), sy[2]) - 0.5f, height), height - 1);
+    if (tri.rect[0] > tri.rect[2] || tri.rect[1] > tri.rect[3])
+    {
+        return false;
+    }
+
+    for (int32_t i = 0; i < 3; i++)
+    {
+        int32_t j = (i + 1) % 3;
+        tri.edge[i][0] = sy[i] - sy[j];
+        tri.edge[i][1] = sx[j] - sx[i];
+        tri.edge[i][2] = -(tri.edge[i][0] * sx[i] + tri.edge[i][1] * sy[i]);
+    }
+
+    // 1 / w is linear on screen. a pixel takes the farthest depth the plane reaches within it,
+    // but never farther than the triangle does.
+    float dx = ((d[1] - d[0]) * (sy[2] - sy[0]) - (d[2] - d[0]) * (sy[1] - sy[0])) / area;
+    float dy = ((d[2] - d[0]) * (sx[1] - sx[0]) - (d[1] - d[0]) * (sx[2] - sx[0])) / area;
+    tri.depth[0] = dx;
+    tri.depth[1] = dy;
+    tri.depth[2] = d[0] - dx * sx[0] - dy * sy[0] - 0.5f * (fabs(dx) + fabs(dy));
+    tri.min_depth = min(min(d[0], d[1]), d[2]);
+
+    return true;
+}
+
+// pixels [x_begin, x_end) of a row, x_begin 4 aligned, the row is padded to a multiple of 4.
+void RasterizeRow(float* depth_row, int32_t x_begin, int32_t x_end, float py, const OcclusionTriangle& tri)
+{
+    float row_edge[3];
+    for (int32_t i = 0; i < 3; i++)
+    {
+        row_edge[i] = tri.edge[i][1] * py + tri.edge[i][2];
+    }
+    float row_depth = tri.depth[1] * py + tri.depth[2];
+
+#if defined(CORE_SIMD_FLOAT4)
+    using namespace core::simd;
+    static const float kLaneCenters[4] = {0.5f, 1.5f, 2.5f, 3.5f};
+    float4 lane_centers = load4(kLaneCenters);
+    float4 zero = splat4(0.0f);
+    float4 edge_dx[3], edge_row[3];
+    for (int32_t i = 0; i < 3; i++)
+    {
+        edge_dx[i] = splat4(tri.edge[i][0]);
+        edge_row[i] = splat4(row_edge[i]);
+    }
+    float4 depth_dx = splat4(tri.depth[0]);
+    float4 depth_row_v = splat4(row_depth);
+    float4 min_depth = splat4(tri.min_depth);
+
+    for (int32_t x = x_begin; x < x_end; x += 4)
+    {
+        float4 px = splat4(float(x)) + lane_centers;
+        float4 inside = and4(and4(cmpge4(edge_dx[0] * px + edge_row[0], zero),
+                                  cmpge4(edge_dx[1] * px + edge_row[1], zero)),
+                                  cmpge4(edge_dx[2] * px + edge_row[2], zero));
+        float4 depth = max4(depth_dx * px + depth_row_v, min_depth);
+        float4 old_depth = load4(depth_row + x);
+        store4(depth_row + x, select4(inside, max4(old_depth, depth), old_depth));
+    }
+#else
+    for (int32_t x = x_begin; x < x_end; x++)
+    {
+        float px = float(x) + 0.5f;
+        if (tri.edge[0][0] * px + row_edge[0] >= 0.0f &&
+            tri.edge[1][0] * px + row_edge[1] >= 0.0f &&
+            tri.edge[2][0] * px + row_edge[2] >= 0.0f)
+        {
+            float depth = max(tri.depth[0] * px + row_depth, tri.min_depth);
+            depth_row[x] = max(depth_row[x], depth);
+        }
+    }
+#endif
+}
+
+// screen bounds and nearest depth of bbox scaled as CullingCore scales it, false if it
+// crosses the near plane.
+bool ProjectBounds(const core::bounds3f& bbox, const core::matrix4f& world_proj_mat, float scale, int32_t width, int32_t height,
+                   core::vec2f& rect_min, core::vec2f& rect_max, float& max_depth)
+{
+    core::vec4f p[8];
+    core::bounds3f bbox_scaled;
+    bbox_scaled.bb_min = bbox.bb_min * scale;
+    bbox_scaled.bb_max = bbox.bb_max * scale;
+    core::TransformBounds(world_proj_mat, bbox_scaled, p);
+
+    rect_min = core::vec2f(FLT_MAX, FLT_MAX);
+    rect_max = core::vec2f(-FLT_MAX, -FLT_MAX);
+    max_depth = 0.0f;
+    for (int32_t i = 0; i < 8; i++)
+    {
+        if (!(p[i].w > 0.0f) || p[i].z < -p[i].w)
+        {
+            return false;
+        }
+
+        float inv_w = 1.0f / p[i].w;
+        float sx = (p[i].x * inv_w * 0.5f + 0.5f) * width;
+        float sy = (p[i].y * inv_w * 0.5f + 0.5f) * height;
+        rect_min = core::vec2f(min(rect_min.x, sx), min(rect_min.y, sy));
+        rect_max = core::vec2f(max(rect_max.x, sx), max(rect_max.y, sy));
+        max_depth = max(max_depth, inv_w);
+    }
+    return true;
+}
+
+core::bounds3f GetLocalBounds(const MeshData* mesh, const core::vec3d& reference_pos)
+{
+    core::bounds3f local_bbox;
+    local_bbox += mesh->bbox_ws.bb_min - reference_pos;
+    local_bbox += mesh->bbox_ws.bb_max - reference_pos;
+    return local_bbox;
+}
+}
+
+OcclusionCuller::OcclusionCuller(int32_t width, int32_t height) : width_(0), height_(0), num_tiles_x_(0), num_tiles_y_(0), num_threads_(0)
+{
+    set_resolution(width, height);
+}
+
+OcclusionCuller::~OcclusionCuller()
+{
+}
+
+void OcclusionCuller::set_num_threads(uint32_t num_threads)
+{
+    if (num_threads != num_threads_)
+    {
+        num_threads_ = num_threads;
+        worker_pool_.reset();
+    }
+}
+
+void OcclusionCuller::set_resolution(int32_t width, int32_t height)
+{
+    width = max(width, 1);
+    height = max(height, 1);
+    if (width == width_ && height == height_)
+    {
+        return;
+    }
+
+    width_ = width;
+    height_ = height;
+    num_tiles_x_ = (width + kOcclusionTileWidth - 1) / kOcclusionTileWidth;
+    num_tiles_y_ = (height + kOcclusionTileHeight - 1) / kOcclusionTileHeight;
+    depth_list_.resize(size_t(get_stride()) * num_tiles_y_ * kOcclusionTileHeight);
+    block_depth_list_.resize(size_t(get_num_blocks_x()) * num_tiles_y_ * (kOcclusionTileHeight / kOcclusionBlockSize));
+    tile_bin_list_.resize(size_t(num_tiles_x_) * num_tiles_y_);
+    clear();
+}
+
+void OcclusionCuller::clear()
+{
+    fill(depth_list_.begin(), depth_list_.end(), 0.0f);
+    fill(block_depth_list_.begin(), block_depth_list_.end(), 0.0f);
+    triangle_list_.clear();
+}
+
+void OcclusionCuller::add_triangle(const core::vec4f& v0, const core::vec4f& v1, const core::vec4f& v2)
+{
+    uint32_t mask0 = GetOutsideMask(v0);
+    uint32_t mask1 = GetOutsideMask(v1);
+    uint32_t mask2 = GetOutsideMask(v2);
+    if (mask0 & mask1 & mask2)
+    {
+        return;
+    }
+
+    OcclusionTriangle tri;
+    uint32_t clip_mask = mask0 | mask1 | mask2;
+    if (clip_mask == 0)
+    {
+        if (SetupTriangle(v0, v1, v2, width_, height_, tri))
+        {
+            triangle_list_.push_back(tri);
+        }
+        return;
+    }
+
+    core::vec4f polygon[kMaxClipVertices] = {v0, v1, v2};
+    core::vec4f clipped[kMaxClipVertices];
+    int32_t num_vertex = 3;
+    for (int32_t i = 0; i < kNumClipPlanes && num_vertex >= 3; i++)
+    {
+        if (clip_mask & (1u << i))
+        {
+            num_vertex = ClipPolygon(polygon, num_vertex, kClipPlanes[i], clipped);
+            copy(clipped, clipped + num_vertex, polygon);
+        }
+    }
+
+    for (int32_t i = 1; i + 1 < num_vertex; i++)
+    {
+        if (SetupTriangle(polygon[0], polygon[i], polygon[i + 1], width_, height_, tri))
+        {
+            triangle_list_.push_back(tri);
+        }
+    }
+}
+
+void OcclusionCuller::add_occluder_triangles(const core::vec3f* vertex_list, uint32_t num_vertex, const uint32_t* index_list, size_t num_index, const core::matrix4f& local_proj_mat)
+{
+    clip_vert_list_.resize(num_vertex);
+    core::TransformPoints(local_proj_mat, vertex_list, clip_vert_list_.data(), num_vertex);
+
+    for (size_t i = 0; i + 2 < num_index; i += 3)
+    {
+        uint32_t i0 = index_list[i];
+        uint32_t i1 = index_list[i + 1];
+        uint32_t i2 = index_list[i + 2];
+        if (i0 < num_vertex && i1 < num_vertex && i2 < num_vertex)
+        {
+            add_triangle(clip_vert_list_[i0], clip_vert_list_[i1], clip_vert_list_[i2]);
+        }
+    }
+}
+
+void OcclusionCuller::add_occluder(const MeshData* mesh, const core::vec3d& reference_pos, const core::matrix4f& world_proj_mat, float scale)
+{
+    if (!mesh || !mesh->vertex_list || mesh->num_vertex <= 0)
+    {
+        return;
+    }
+
+    // the patches draw with the selection mask, only what is always drawn occludes.
+    index_list_.clear();
+    for (const auto& draw_call_info : mesh->draw_call_list)
+    {
+        if (draw_call_info.is_drawable() && !draw_call_info.is_drawable_patches())
+        {
+            draw_call_info.get_triangle_list(index_list_);
+        }
+    }
+
+    core::vec3f local_translation = mesh->translation - reference_pos;
+    core::matrix4f local_mat;
+    for (int32_t i = 0; i < 3; i++)
+    {
+        local_mat(i, i) = scale;
+        local_mat(i, 3) = local_translation[i] * scale;
+    }
+
+    add_occluder_triangles(mesh->vertex_list.get(), uint32_t(mesh->num_vertex), index_list_.data(), index_list_.size(), world_proj_mat * local_mat);
+}
+
+void OcclusionCuller::rasterize()
+{
+    for (auto& tile_bin : tile_bin_list_)
+    {
+        tile_bin.clear();
+    }
+
+    size_t num_bins = 0;
+    for (uint32_t i = 0; i < triangle_list_.size(); i++)
+    {
+        const OcclusionTriangle& tri = triangle_list_[i];
+        for (int32_t tile_y = tri.rect[1] / kOcclusionTileHeight; tile_y <= tri.rect[3] / kOcclusionTileHeight; tile_y++)
+        {
+            for (int32_t tile_x = tri.rect[0] / kOcclusionTileWidth; tile_x <= tri.rect[2] / kOcclusionTileWidth; tile_x++)
+            {
+                tile_bin_list_[size_t(tile_y) * num_tiles_x_ + tile_x].push_back(i);
+                num_bins++;
+            }
+        }
+    }
+
+    if (num_threads_ == 1 || num_bins < kMinParallelOcclusionBins)
+    {
+        for (int32_t tile_y = 0; tile_y < num_tiles_y_; tile_y++)
+        {
+            for (int32_t tile_x = 0; tile_x < num_tiles_x_; tile_x++)
+            {
+                rasterize_tile(tile_x, tile_y);
+            }
+        }
+        return;
+    }
+
+    // the pool is kept across frames, a frame only wakes its threads. tiles own disjoint
+    // pixels and blocks, no job writes where another does.
+    if (!worker_pool_)
+    {
+        worker_pool_ = make_unique<core::WorkerPool>(num_threads_);
+    }
+    worker_pool_->run(tile_bin_list_.size(), [&](size_t i)
+    {
+        rasterize_tile(int32_t(i % num_tiles_x_), int32_t(i / num_tiles_x_));
+    });
+}
+
+void OcclusionCuller::rasterize_tile(int32_t tile_x, int32_t tile_y)
+{
+    int32_t tile_x0 = tile_x * kOcclusionTileWidth;
+    int32_t tile_y0 = tile_y * kOcclusionTileHeight;
+    int32_t tile_x1 = tile_x0 + kOcclusionTileWidth - 1;
+    int32_t tile_y1 = tile_y0 + kOcclusionTileHeight - 1;
+    int32_t stride = get_stride();
+
+    for (uint32_t idx : tile_bin_list_[size_t(tile_y) * num_tiles_x_ + tile_x])
+    {
+        const OcclusionTriangle& tri = triangle_list_[idx];
+        int32_t x_begin = max(tri.rect[0], tile_x0) & ~3;
+        int32_t x_end = min(tri.rect[2], tile_x1) + 1;
+        int32_t y_begin = max(tri.rect[1], tile_y0);
+        int32_t y_end = min(tri.rect[3], tile_y1) + 1;
+        for (int32_t y = y_begin; y < y_end; y++)
+        {
+            RasterizeRow(&depth_list_[size_t(y) * stride], x_begin, x_end, float(y) + 0.5f, tri);
+        }
+    }
+
+    // padding past the buffer size is never tested, it does not count for the blocks.
+    int32_t num_blocks_x = get_num_blocks_x();
+    for (int32_t block_y = tile_y0 / kOcclusionBlockSize; block_y <= tile_y1 / kOcclusionBlockSize; block_y++)
+    {
+        for (int32_t block_x = tile_x0 / kOcclusionBlockSize; block_x <= tile_x1 / kOcclusionBlockSize; block_x++)
+        {
+            int32_t x_end = min((block_x + 1) * kOcclusionBlockSize, width_);
+            int32_t y_end = min((block_y + 1) * kOcclusionBlockSize, height_);
+            float block_depth = FLT_MAX;
+            for (int32_t y = block_y * kOcclusionBlockSize; y < y_end; y++)
+            {
+                for (int32_t x = block_x * kOcclusionBlockSize; x < x_end; x++)
+                {
+                    block_depth = min(block_depth, depth_list_[size_t(y) * stride + x]);
+                }
+            }
+            block_depth_list_[size_t(block_y) * num_blocks_x + block_x] = block_depth == FLT_MAX ? 0.0f : block_depth;
+        }
+    }
+}
+
+bool OcclusionCuller::is_visible(const core::bounds3f& bbox, const core::matrix4f& world_proj_mat, float scale) const
+{
+    core::vec2f rect_min, rect_max;
+    float max_depth;
+    if (!ProjectBounds(bbox, world_proj_mat, scale, width_, height_, rect_min, rect_max, max_depth))
+    {
+        return true;
+    }
+
+    // every pixel the bounds touch.
+    int32_t x0 = max(ToPixel(rect_min.x, width_), 0);
+    int32_t y0 = max(ToPixel(rect_min.y, height_), 0);
+    int32_t x1 = min(ToPixel(rect_max.x, width_), width_ - 1);
+    int32_t y1 = min(ToPixel(rect_max.y, height_), height_ - 1);
+    if (x0 > x1 || y0 > y1)
+    {
+        return true;
+    }
+
+    float depth_limit = max_depth * (1.0f + kDepthTolerance);
+    int32_t num_blocks_x = get_num_blocks_x();
+    for (int32_t block_y = y0 / kOcclusionBlockSize; block_y <= y1 / kOcclusionBlockSize; block_y++)
+    {
+        for (int32_t block_x = x0 / kOcclusionBlockSize; block_x <= x1 / kOcclusionBlockSize; block_x++)
+        {
+            if (block_depth_list_[size_t(block_y) * num_blocks_x + block_x] > depth_limit)
+            {
+                continue;
+            }
+
+            int32_t px_end = min((block_x + 1) * kOcclusionBlockSize - 1, x1);
+            int32_t py_end = min((block_y + 1) * kOcclusionBlockSize - 1, y1);
+            for (int32_t y = max(block_y * kOcclusionBlockSize, y0); y <= py_end; y++)
+            {
+                for (int32_t x = max(block_x * kOcclusionBlockSize, x0); x <= px_end; x++)
+                {
+                    if (get_depth(x, y) <= depth_limit)
+                    {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+bool OcclusionCuller::is_visible(const MeshData* mesh, const core::vec3d& reference_pos, const core::matrix4f& world_proj_mat, float scale) const
+{
+    return is_visible(GetLocalBounds(mesh, reference_pos), world_proj_mat, scale);
+}
+
+float OcclusionCuller::get_screen_area(const core::bounds3f& bbox, const core::matrix4f& world_proj_mat, float scale) const
+{
+    core::vec2f rect_min, rect_max;
+    float max_depth;
+    if (!ProjectBounds(bbox, world_proj_mat, scale, width_, height_, rect_min, rect_max, max_depth))
+    {
+        return float(width_) * float(height_);
+    }
+
+    float w = min(rect_max.x, float(width_)) - max(rect_min.x, 0.0f);
+    float h = min(rect_max.y, float(height_)) - max(rect_min.y, 0.0f);
+    return w > 0.0f && h > 0.0f ? w * h : 0.0f;
+}
+
+uint32_t AddWorldOccluders(OcclusionCuller& culler, const vector<BatchMeshData*>& mesh_data_batches, const core::vec3d& reference_pos, const core::matrix4f& world_proj_mat, float scale)
+{
+    vector<pair<float, MeshData*>> candidate_list;
+    for (BatchMeshData* batch_meshes : mesh_data_batches)
+    {
+        if (batch_meshes->is_spline_mesh)
+        {
+            continue;
+        }
+
+        for (GroupMeshData* mesh_group : batch_meshes->group_meshes)
+        {
+            for (MeshData* mesh_data : mesh_group->meshes)
+            {
+                if (mesh_data && mesh_data->culling(reference_pos, world_proj_mat, scale))
+                {
+                    float area = culler.get_screen_area(GetLocalBounds(mesh_data, reference_pos), world_proj_mat, scale);
+                    if (area >= kMinOccluderPixels)
+                    {
+                        candidate_list.emplace_back(area, mesh_data);
+                    }
+                }
+            }
+        }
+    }
+
+    stable_sort(candidate_list.begin(), candidate_list.end(), [](const pair<float, MeshData*>& a, const pair<float, MeshData*>& b)
+    {
+        return a.first > b.first;
+    });
+
+    uint32_t num_meshes = 0;
+    for (const auto& candidate : candidate_list)
+    {
+        if (culler.get_num_triangles() >= kMaxOccluderTriangles)
+        {
+            break;
+        }
+
+        culler.add_occluder(candidate.second, reference_pos, world_proj_mat, scale);
+        num_meshes++;
+    }
+
+    return num_meshes;
+}
@@ -238,7 +238,8 @@ void OGLWidget::DrawBatchMeshes(
         const core::matrix4f& world_screen_mat,
         GLuint program,
         float scale,
-        bool draw_tri_meshes)
+        bool draw_tri_meshes,
+        const OcclusionCuller* occlusion_culler)
 {
     glUseProgram(program);
 
@@ -255,7 +256,8 @@ void OGLWidget::DrawBatchMeshes(
         for (uint32_t i_mesh = 0; i_mesh < mesh_group->meshes.size(); i_mesh++)
         {
            MeshData* mesh_data = mesh_group->meshes[i_mesh];
-           if (mesh_data->culling(reference_pos, world_screen_mat, scale))
+           if (mesh_data->culling(reference_pos, world_screen_mat, scale) &&
+               (!occlusion_culler || occlusion_culler->is_visible(mesh_data, reference_pos, world_screen_mat, scale)))
            {
                for (uint32_t i_draw = 0; i_draw < mesh_data->draw_call_list.size(); i_draw++)
                {
@@ -280,7 +282,8 @@ void OGLWidget::DrawBatchMeshesSelectMask(
         const core::vec3d& reference_pos,
         const core::matrix4f& world_screen_mat,
         GLuint program,
-        float scale)
+        float scale,
+        const OcclusionCuller* occlusion_culler)
 {
     glUseProgram(program);
 
@@ -292,7 +295,8 @@ void OGLWidget::DrawBatchMeshesSelectMask(
         for (uint32_t i_mesh = 0; i_mesh < mesh_group->meshes.size(); i_mesh++)
         {
            MeshData* mesh_data = mesh_group->meshes[i_mesh];
-           if (mesh_data->culling(reference_pos, world_screen_mat, scale) && mesh_data->patch_list.size() > 0)
+           if (mesh_data->culling(reference_pos, world_screen_mat, scale) && mesh_data->patch_list.size() > 0 &&
+               (!occlusion_culler || occlusion_culler->is_visible(mesh_data, reference_pos, world_screen_mat, scale)))
            {
                for (uint32_t i_draw = 0; i_draw < mesh_data->draw_call_list.size(); i_draw++)
                {
@@ -315,7 +319,8 @@ void OGLWidget::DrawWorldMeshes(
         const core::matrix4f& world_screen_mat,
         GLuint program,
         float scale,
-        bool draw_tri_meshes)
+        bool draw_tri_meshes,
+        const OcclusionCuller* occlusion_culler)
 {
     for (uint32_t i_batch = 0; i_batch < world->mesh_data_batches.size(); i_batch++)
     {
@@ -323,7 +328,7 @@ void OGLWidget::DrawWorldMeshes(
                             !world->mesh_data_batches[i_batch]->is_spline_mesh;
         if (draw_batches)
         {
-            DrawBatchMeshes(world->mesh_data_batches[i_batch], reference_pos, world_screen_mat, program, scale, draw_tri_meshes);
+            DrawBatchMeshes(world->mesh_data_batches[i_batch], reference_pos, world_screen_mat, program, scale, draw_tri_meshes, occlusion_culler);
         }
     }
 }
@@ -333,13 +338,14 @@ void OGLWidget::DrawWorldMeshesSelectMask(
         const core::vec3d& reference_pos,
         const core::matrix4f& world_screen_mat,
         GLuint program,
-        float scale)
+        float scale,
+        const OcclusionCuller* occlusion_culler)
 {
     for (uint32_t i_batch = 0; i_batch < world->mesh_data_batches.size(); i_batch++)
     {
         if (!world->mesh_data_batches[i_batch]->is_spline_mesh)
         {
-            DrawBatchMeshesSelectMask(world->mesh_data_batches[i_batch], reference_pos, world_screen_mat, program, scale);
+            DrawBatchMeshesSelectMask(world->mesh_data_batches[i_batch], reference_pos, world_screen_mat, program, scale, occlusion_culler);
         }
     }
 }
@@ -578,10 +584,21 @@ void OGLWidget::paintGL()
 
         SelectPatches(world_screen_mat, scale);
 
+        // the largest meshes on screen occlude the rest, all three passes test against them.
+        const OcclusionCuller* occlusion_culler = nullptr;
+        if (m_occlusion_culling)
+        {
+            m_occlusion_culler.set_resolution(kDefaultOcclusionBufferWidth, max(int32_t(kDefaultOcclusionBufferWidth / aspect_x), 1));
+            m_occlusion_culler.clear();
+            AddWorldOccluders(m_occlusion_culler, g_world.mesh_data_batches, ref_pos_ws, world_screen_mat, scale);
+            m_occlusion_culler.rasterize();
+            occlusion_culler = &m_occlusion_culler;
+        }
+
         {
-            DrawWorldMeshes(&g_world, ref_pos_ws, world_screen_mat, m_programs[kBasicLightProgram], scale, true);
-            DrawWorldMeshesSelectMask(&g_world, ref_pos_ws, world_screen_mat, m_programs[kBasicNoLightProgram], scale);
-            DrawWorldMeshes(&g_world, ref_pos_ws, world_screen_mat, m_programs[kBasicNoLightProgram], scale, false);
+            DrawWorldMeshes(&g_world, ref_pos_ws, world_screen_mat, m_programs[kBasicLightProgram], scale, true, occlusion_culler);
+            DrawWorldMeshesSelectMask(&g_world, ref_pos_ws, world_screen_mat, m_programs[kBasicNoLightProgram], scale, occlusion_culler);
+            DrawWorldMeshes(&g_world, ref_pos_ws, world_screen_mat, m_programs[kBasicNoLightProgram], scale, false, occlusion_culler);
         }
     }
 
@@ -656,6 +673,12 @@ void OGLWidget::scrollWithDegrees(QWheelEvent *event, QPoint num_degrees)
     }
 }
 
+void OGLWidget::setOcclusionCulling(bool enabled)
+{
+    m_occlusion_culling = enabled;
+    update();
+}
+
 void OGLWidget::wheelEvent(QWheelEvent *event)
 {
     QPoint num_pixels = event->pixelDelta();
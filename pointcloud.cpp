@@ -0,0 +1,672 @@
+#include "pointcloud.h"
+#include "corethread.h"
+#include "coregeographic.h"
+#include "opencv2/opencv.hpp"
+#include <fstream>
+#include <random>
+#include <ctime>
+#include <unordered_map>
+#include <algorithm>
+
+namespace
+{
+// points per job of the voxel binning, fixed so the sums do not depend on the thread count.
+constexpr size_t kVoxelChunkSize = 64 * 1024;
+constexpr uint32_t kNumVoxelShards = 64;
+constexpr uint32_t kVoxelAxisBits = 21;
+constexpr uint64_t kVoxelAxisMask = (uint64_t(1) << kVoxelAxisBits) - 1;
+
+constexpr uint32_t kPlyPointSize = 3 * 8 + 3;
+constexpr uint32_t kLasHeaderSize = 227;
+constexpr uint32_t kLasVlrHeaderSize = 54;
+constexpr uint32_t kLasPointFormat = 2;
+constexpr uint32_t kLasPointSize = 26;
+constexpr double kLasScale = 0.001;
+
+// decoded texture, rows top first as the texture data is stored, which is v = 0.
+struct TextureImage
+{
+    vector<uint8_t>     rgba_data;
+    uint32_t            w = 0;
+    uint32_t            h = 0;
+};
+
+struct VoxelSum
+{
+    uint64_t            key;
+    double              x, y, z;
+    uint32_t            r, g, b, a;
+    uint32_t            count;
+};
+
+template <class T>
+void AppendValue(vector<uint8_t>& data, T value)
+{
+    size_t ofs = data.size();
+    data.resize(ofs + sizeof(T));
+    memcpy(&data[ofs], &value, sizeof(T));
+}
+
+void AppendString(vector<uint8_t>& data, const string& value, size_t size)
+{
+    size_t ofs = data.size();
+    data.resize(ofs + size, 0);
+    memcpy(&data[ofs], value.c_str(), min(value.size(), size));
+}
+
+bool WriteFileData(const string& file_name, const vector<uint8_t>& header, const vector<uint8_t>& body)
+{
+    ofstream out_file(file_name, ofstream::binary);
+    out_file.write(reinterpret_cast<const char*>(header.data()), streamsize(header.size()));
+    out_file.write(reinterpret_cast<const char*>(body.data()), streamsize(body.size()));
+    if (!out_file)
+    {
+        core::output_debug_info("error", "failed to write " + file_name);
+        return false;
+    }
+    return true;
+}
+
+bool LoadTextureFile(const string& file_name, TextureImage& texture)
+{
+    cv::Mat image = cv::imread(file_name);
+    if (image.empty())
+    {
+        return false;
+    }
+
+    texture.w = uint32_t(image.cols);
+    texture.h = uint32_t(image.rows);
+    texture.rgba_data.resize(size_t(texture.w) * texture.h * 4);
+    for (uint32_t y = 0; y < texture.h; y++)
+    {
+        const uint8_t* src = image.ptr(int32_t(y));
+        uint8_t* dst = &texture.rgba_data[size_t(y) * texture.w * 4];
+        for (uint32_t x = 0; x < texture.w; x++)
+        {
+            dst[x * 4 + 0] = src[x * 3 + 2];
+            dst[x * 4 + 1] = src[x * 3 + 1];
+            dst[x * 4 + 2] = src[x * 3 + 0];
+            dst[x * 4 + 3] = 255;
+        }
+    }
+    return true;
+}
+
+// bilinear with repeat wrapping, the sampler state the viewer uses.
+uint32_t SampleTexture(const TextureImage& texture, const core::vec2f& uv)
+{
+    float fx = (uv.x - floor(uv.x)) * float(texture.w) - 0.5f;
+    float fy = (uv.y - floor(uv.y)) * float(texture.h) - 0.5f;
+    int32_t x0 = int32_t(floor(fx));
+    int32_t y0 = int32_t(floor(fy));
+    float tx = fx - float(x0);
+    float ty = fy - float(y0);
+
+    int32_t w = int32_t(texture.w), h = int32_t(texture.h);
+    int32_t xs[2] = { (x0 % w + w) % w, ((x0 + 1) % w + w) % w };
+    int32_t ys[2] = { (y0 % h + h) % h, ((y0 + 1) % h + h) % h };
+
+    uint32_t color = 0;
+    for (uint32_t c = 0; c < 4; c++)
+    {
+        auto texel = [&](int32_t x, int32_t y) { return float(texture.rgba_data[(size_t(ys[y]) * texture.w + size_t(xs[x])) * 4 + c]); };
+        float top = texel(0, 0) + (texel(1, 0) - texel(0, 0)) * tx;
+        float bottom = texel(0, 1) + (texel(1, 1) - texel(0, 1)) * tx;
+        color |= uint32_t(min(max(top + (bottom - top) * ty + 0.5f, 0.0f), 255.0f)) << (c * 8);
+    }
+    return color;
+}
+
+uint32_t BlendColors(uint32_t c0, uint32_t c1, uint32_t c2, double w0, double w1, double w2)
+{
+    uint32_t color = 0;
+    for (uint32_t c = 0; c < 32; c += 8)
+    {
+        double v = ((c0 >> c) & 0xff) * w0 + ((c1 >> c) & 0xff) * w1 + ((c2 >> c) & 0xff) * w2;
+        color |= uint32_t(min(v + 0.5, 255.0)) << c;
+    }
+    return color;
+}
+
+void SampleMesh(const MeshData* mesh_data, const core::CoordinateTransformer& enu_frame,
+                int32_t zone, bool northp, const TextureImage* texture,
+                const PointCloudOptions& options, uint32_t seed,
+                vector<core::vec3d>& position_list, vector<uint32_t>& color_list)
+{
+    static const core::UTMProjector projector;
+    uint32_t num_vertex = uint32_t(mesh_data->num_vertex);
+    vector<core::vec3d> utm_list(num_vertex);
+    for (uint32_t i = 0; i < num_vertex; i++)
+    {
+        core::GpsCoord gps_coord = mesh_data->get_gps_coord(i, enu_frame);
+        core::vec2d utm_loc = projector.forward(core::vec2d(gps_coord.lat, gps_coord.lon), zone, northp);
+        utm_list[i] = core::vec3d(utm_loc.x, utm_loc.y, gps_coord.alt);
+    }
+
+    bool has_uv = texture && mesh_data->uv_list;
+    auto vertex_color = [&](uint32_t idx)
+    {
+        return has_uv ? SampleTexture(*texture, mesh_data->uv_list[idx]) :
+               (mesh_data->color_list ? mesh_data->color_list[idx] : 0xffffffff);
+    };
+
+    if (options.sample_mode == kPointSampleVertices)
+    {
+        position_list.insert(position_list.end(), utm_list.begin(), utm_list.end());
+        for (uint32_t i = 0; i < num_vertex; i++)
+        {
+            color_list.push_back(vertex_color(i));
+        }
+        return;
+    }
+
+    vector<uint32_t> index_list;
+    mesh_data->get_triangle_list(index_list);
+
+    mt19937 rng(seed);
+    uniform_real_distribution<double> uniform(0.0, 1.0);
+    for (size_t i = 0; i + 2 < index_list.size(); i += 3)
+    {
+        uint32_t i0 = index_list[i], i1 = index_list[i + 1], i2 = index_list[i + 2];
+        if (i0 >= num_vertex || i1 >= num_vertex || i2 >= num_vertex)
+        {
+            continue;
+        }
+
+        const core::vec3d& p0 = utm_list[i0];
+        core::vec3d e1 = utm_list[i1] - p0;
+        core::vec3d e2 = utm_list[i2] - p0;
+        double expected = 0.5 * core::length(cross(e1, e2)) * options.surface_density;
+        uint32_t num_samples = uint32_t(expected);
+        // the fraction is kept in expectation, small triangles still add up.
+        num_samples += uniform(rng) < expected - double(num_samples) ? 1 : 0;
+
+        for (uint32_t s = 0; s < num_samples; s++)
+        {
+            double r1 = sqrt(uniform(rng));
+            double r2 = uniform(rng);
+            double w1 = r1 * (1.0 - r2);
+            double w2 = r1 * r2;
+            double w0 = 1.0 - w1 - w2;
+            position_list.push_back(p0 + e1 * w1 + e2 * w2);
+
+            if (has_uv)
+            {
+                const core::vec2f& uv0 = mesh_data->uv_list[i0];
+                const core::vec2f& uv1 = mesh_data->uv_list[i1];
+                const core::vec2f& uv2 = mesh_data->uv_list[i2];
+                core::vec2f uv(float(uv0.x * w0 + uv1.x * w1 + uv2.x * w2), float(uv0.y * w0 + uv1.y * w1 + uv2.y * w2));
+                color_list.push_back(SampleTexture(*texture, uv));
+            }
+            else if (mesh_data->color_list)
+            {
+                color_list.push_back(BlendColors(mesh_data->color_list[i0], mesh_data->color_list[i1], mesh_data->color_list[i2], w0, w1, w2));
+            }
+            else
+            {
+                color_list.push_back(0xffffffff);
+            }
+        }
+    }
+}
+
+// captured textures are decoded, the others are loaded from their files, once per group.
+void LoadGroupTextures(const BatchMeshData* batch, const GroupMeshData* group,
+                       vector<TextureImage>& texture_list, vector<const TextureImage*>& mesh_texture_list)
+{
+    vector<string> file_name_list;
+    vector<uint32_t> texture_idx_list(group->meshes.size(), INVALID_VALUE);
+    if (batch->is_google_dump)
+    {
+        file_name_list.resize(group->loaded_textures.size());
+        for (uint32_t i = 0; i < group->meshes.size(); i++)
+        {
+            const MeshData* mesh_data = group->meshes[i];
+            if (mesh_data && mesh_data->idx_in_texture_list < group->loaded_textures.size())
+            {
+                texture_idx_list[i] = mesh_data->idx_in_texture_list;
+            }
+        }
+    }
+    else
+    {
+        unordered_map<string, uint32_t> file_name_map;
+        for (uint32_t i = 0; i < group->meshes.size(); i++)
+        {
+            const MeshData* mesh_data = group->meshes[i];
+            if (mesh_data && mesh_data->tex_file_name)
+            {
+                auto result = file_name_map.emplace(*mesh_data->tex_file_name, uint32_t(file_name_list.size()));
+                if (result.second)
+                {
+                    file_name_list.push_back(*mesh_data->tex_file_name);
+                }
+                texture_idx_list[i] = result.first->second;
+            }
+        }
+    }
+
+    texture_list.clear();
+    texture_list.resize(file_name_list.size());
+    vector<uint8_t> loaded(file_name_list.size(), 0);
+    core::ParallelFor(file_name_list.size(), 1, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            TextureImage& texture = texture_list[i];
+            if (batch->is_google_dump)
+            {
+                const core::Texture2DInfo* tex_info = group->loaded_textures[i];
+                if (tex_info && core::DecodeTextureLevel(tex_info, 0, texture.rgba_data))
+                {
+                    texture.w = tex_info->m_mips[0].m_width;
+                    texture.h = tex_info->m_mips[0].m_height;
+                    loaded[i] = texture.w > 0 && texture.h > 0;
+                }
+            }
+            else
+            {
+                loaded[i] = LoadTextureFile(file_name_list[i], texture);
+            }
+        }
+    });
+
+    mesh_texture_list.assign(group->meshes.size(), nullptr);
+    for (uint32_t i = 0; i < group->meshes.size(); i++)
+    {
+        uint32_t idx = texture_idx_list[i];
+        if (idx != INVALID_VALUE && loaded[idx])
+        {
+            mesh_texture_list[i] = &texture_list[idx];
+        }
+    }
+}
+
+uint32_t GetProjectedCsCode(int32_t zone, bool northp)
+{
+    // wgs 84 / utm zone n, wgs 84 / ups.
+    return zone == core::UTMProjector::kUpsZone ? (northp ? 32661 : 32761) : uint32_t((northp ? 32600 : 32700) + zone);
+}
+}
+
+bool SamplePointCloud(const vector<BatchMeshData*>& batch_mesh_data, const PointCloudOptions& options,
+                      PointCloud& point_cloud)
+{
+    point_cloud = PointCloud();
+
+    // one zone for everything, voted by the first vertex of every mesh.
+    vector<core::vec2d> zone_samples;
+    for (const auto batch : batch_mesh_data)
+    {
+        core::CoordinateTransformer enu_frame(batch->reference_pos.y, batch->reference_pos.x, 0.0);
+        for (const auto group : batch->group_meshes)
+        {
+            for (const auto mesh_data : group->meshes)
+            {
+                if (mesh_data && mesh_data->num_vertex > 0 && mesh_data->vertex_list)
+                {
+                    core::GpsCoord gps_coord = mesh_data->get_gps_coord(0, enu_frame);
+                    zone_samples.push_back(core::vec2d(gps_coord.lat, gps_coord.lon));
+                }
+            }
+        }
+    }
+
+    if (zone_samples.empty())
+    {
+        return false;
+    }
+
+    point_cloud.utm_zone = core::UTMProjector::common_zone(zone_samples.data(), zone_samples.size(), point_cloud.northp);
+
+    for (uint32_t i_batch = 0; i_batch < batch_mesh_data.size(); i_batch++)
+    {
+        const BatchMeshData* batch = batch_mesh_data[i_batch];
+        if (batch->is_spline_mesh)
+        {
+            continue;
+        }
+
+        core::CoordinateTransformer enu_frame(batch->reference_pos.y, batch->reference_pos.x, 0.0);
+        for (uint32_t i_group = 0; i_group < batch->group_meshes.size(); i_group++)
+        {
+            const GroupMeshData* group = batch->group_meshes[i_group];
+            vector<TextureImage> texture_list;
+            vector<const TextureImage*> mesh_texture_list;
+            LoadGroupTextures(batch, group, texture_list, mesh_texture_list);
+
+            size_t num_meshes = group->meshes.size();
+            vector<vector<core::vec3d>> position_lists(num_meshes);
+            vector<vector<uint32_t>> color_lists(num_meshes);
+            core::ParallelFor(num_meshes, 1, [&](size_t begin, size_t end)
+            {
+                for (size_t i_mesh = begin; i_mesh < end; i_mesh++)
+                {
+                    const MeshData* mesh_data = group->meshes[i_mesh];
+                    if (mesh_data && mesh_data->num_vertex > 0 && mesh_data->vertex_list)
+                    {
+                        uint32_t seed = uint32_t((i_batch * 65599u + i_group) * 65599u + i_mesh);
+                        SampleMesh(mesh_data, enu_frame, point_cloud.utm_zone, point_cloud.northp,
+                                   mesh_texture_list[i_mesh], options, seed,
+                                   position_lists[i_mesh], color_lists[i_mesh]);
+                    }
+                }
+            });
+
+            for (size_t i_mesh = 0; i_mesh < num_meshes; i_mesh++)
+            {
+                point_cloud.position_list.insert(point_cloud.position_list.end(), position_lists[i_mesh].begin(), position_lists[i_mesh].end());
+                point_cloud.color_list.insert(point_cloud.color_list.end(), color_lists[i_mesh].begin(), color_lists[i_mesh].end());
+            }
+        }
+    }
+
+    for (const auto& position : point_cloud.position_list)
+    {
+        point_cloud.bbox += position;
+    }
+
+    return !point_cloud.position_list.empty();
+}
+
+bool DownsamplePointCloud(PointCloud& point_cloud, double voxel_size)
+{
+    size_t num_points = point_cloud.position_list.size();
+    if (num_points == 0 || voxel_size <= 0.0)
+    {
+        return true;
+    }
+
+    const core::vec3d origin = point_cloud.bbox.bb_min;
+    core::vec3d extent = point_cloud.bbox.GetDiagonal() / voxel_size;
+    if (max(max(extent.x, extent.y), extent.z) >= double(kVoxelAxisMask))
+    {
+        core::output_debug_info("error", "voxel size " + to_string(voxel_size) + " is too small for the point cloud bounds");
+        return false;
+    }
+
+    // shards are slabs along x, key order is x major, so the shards concatenate sorted.
+    uint64_t num_x_voxels = uint64_t(extent.x) + 1;
+    auto shard_of = [&](uint64_t key) { return uint32_t((key >> (kVoxelAxisBits * 2)) * kNumVoxelShards / num_x_voxels); };
+
+    size_t num_chunks = (num_points + kVoxelChunkSize - 1) / kVoxelChunkSize;
+    vector<vector<VoxelSum>> chunk_shards(num_chunks * kNumVoxelShards);
+    core::ParallelFor(num_chunks, 1, [&](size_t begin, size_t end)
+    {
+        unordered_map<uint64_t, uint32_t> voxel_map;
+        vector<VoxelSum> sums;
+        for (size_t i_chunk = begin; i_chunk < end; i_chunk++)
+        {
+            voxel_map.clear();
+            sums.clear();
+            size_t first = i_chunk * kVoxelChunkSize;
+            size_t last = min(first + kVoxelChunkSize, num_points);
+            for (size_t i = first; i < last; i++)
+            {
+                core::vec3d p = point_cloud.position_list[i] - origin;
+                uint64_t vx = min(uint64_t(p.x / voxel_size), kVoxelAxisMask);
+                uint64_t vy = min(uint64_t(p.y / voxel_size), kVoxelAxisMask);
+                uint64_t vz = min(uint64_t(p.z / voxel_size), kVoxelAxisMask);
+                uint64_t key = (vx << (kVoxelAxisBits * 2)) | (vy << kVoxelAxisBits) | vz;
+
+                auto result = voxel_map.emplace(key, uint32_t(sums.size()));
+                if (result.second)
+                {
+                    sums.push_back(VoxelSum{ key, 0.0, 0.0, 0.0, 0, 0, 0, 0, 0 });
+                }
+
+                VoxelSum& sum = sums[result.first->second];
+                uint32_t color = point_cloud.color_list[i];
+                sum.x += p.x;
+                sum.y += p.y;
+                sum.z += p.z;
+                sum.r += color & 0xff;
+                sum.g += (color >> 8) & 0xff;
+                sum.b += (color >> 16) & 0xff;
+                sum.a += color >> 24;
+                sum.count++;
+            }
+
+            for (const auto& sum : sums)
+            {
+                chunk_shards[i_chunk * kNumVoxelShards + shard_of(sum.key)].push_back(sum);
+            }
+        }
+    });
+
+    // chunks are merged in order inside each shard, the sums come out the same every run.
+    vector<vector<VoxelSum>> shards(kNumVoxelShards);
+    core::ParallelFor(kNumVoxelShards, 1, [&](size_t begin, size_t end)
+    {
+        unordered_map<uint64_t, uint32_t> voxel_map;
+        for (size_t i_shard = begin; i_shard < end; i_shard++)
+        {
+            voxel_map.clear();
+            vector<VoxelSum>& merged = shards[i_shard];
+            for (size_t i_chunk = 0; i_chunk < num_chunks; i_chunk++)
+            {
+                for (const auto& sum : chunk_shards[i_chunk * kNumVoxelShards + i_shard])
+                {
+                    auto result = voxel_map.emplace(sum.key, uint32_t(merged.size()));
+                    if (result.second)
+                    {
+                        merged.push_back(sum);
+                        continue;
+                    }
+
+                    VoxelSum& dst = merged[result.first->second];
+                    dst.x += sum.x;
+                    dst.y += sum.y;
+                    dst.z += sum.z;
+                    dst.r += sum.r;
+                    dst.g += sum.g;
+                    dst.b += sum.b;
+                    dst.a += sum.a;
+                    dst.count += sum.count;
+                }
+                chunk_shards[i_chunk * kNumVoxelShards + i_shard] = vector<VoxelSum>();
+            }
+
+            sort(merged.begin(), merged.end(), [](const VoxelSum& a, const VoxelSum& b) { return a.key < b.key; });
+        }
+    });
+
+    point_cloud.position_list.clear();
+    point_cloud.color_list.clear();
+    point_cloud.bbox.Reset();
+    for (const auto& shard : shards)
+    {
+        for (const auto& sum : shard)
+        {
+            double inv_count = 1.0 / double(sum.count);
+            uint32_t half = sum.count / 2;
+            core::vec3d position = origin + core::vec3d(sum.x, sum.y, sum.z) * inv_count;
+            point_cloud.position_list.push_back(position);
+            point_cloud.color_list.push_back(((sum.r + half) / sum.count) |
+                                             (((sum.g + half) / sum.count) << 8) |
+                                             (((sum.b + half) / sum.count) << 16) |
+                                             (((sum.a + half) / sum.count) << 24));
+            point_cloud.bbox += position;
+        }
+    }
+
+    return true;
+}
+
+bool ExportPlyPointFile(const string& file_name, const PointCloud& point_cloud)
+{
+    size_t num_points = point_cloud.position_list.size();
+    string header = "ply\n"
+                    "format binary_little_endian 1.0\n"
+                    "comment utm zone " + to_string(point_cloud.utm_zone) + (point_cloud.northp ? " north\n" : " south\n") +
+                    "element vertex " + to_string(num_points) + "\n"
+                    "property double x\n"
+                    "property double y\n"
+                    "property double z\n"
+                    "property uchar red\n"
+                    "property uchar green\n"
+                    "property uchar blue\n"
+                    "end_header\n";
+
+    vector<uint8_t> body(num_points * kPlyPointSize);
+    core::ParallelFor(num_points, 4096, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            uint8_t* dst = &body[i * kPlyPointSize];
+            const core::vec3d& p = point_cloud.position_list[i];
+            uint32_t color = point_cloud.color_list[i];
+            double xyz[3] = { p.x, p.y, p.z };
+            memcpy(dst, xyz, sizeof(xyz));
+            dst[24] = uint8_t(color);
+            dst[25] = uint8_t(color >> 8);
+            dst[26] = uint8_t(color >> 16);
+        }
+    });
+
+    return WriteFileData(file_name, vector<uint8_t>(header.begin(), header.end()), body);
+}
+
+bool ExportLasPointFile(const string& file_name, const PointCloud& point_cloud)
+{
+    size_t num_points = point_cloud.position_list.size();
+    if (num_points > UINT32_MAX)
+    {
+        core::output_debug_info("error", "too many points for las 1.2 : " + to_string(num_points));
+        return false;
+    }
+
+    core::vec3d offset(0, 0, 0);
+    core::vec3d bb_min(0, 0, 0), bb_max(0, 0, 0);
+    if (num_points > 0)
+    {
+        offset = core::vec3d(floor(point_cloud.bbox.bb_min.x), floor(point_cloud.bbox.bb_min.y), floor(point_cloud.bbox.bb_min.z));
+        core::vec3d extent = point_cloud.bbox.bb_max - offset;
+        if (max(max(extent.x, extent.y), extent.z) / kLasScale >= double(INT32_MAX))
+        {
+            core::output_debug_info("error", "point cloud is too large for millimeter las coordinates");
+            return false;
+        }
+        // the bounds of the stored coordinates, not of the doubles.
+        for (int32_t c = 0; c < 3; c++)
+        {
+            bb_min[c] = offset[c] + double(llround((point_cloud.bbox.bb_min[c] - offset[c]) / kLasScale)) * kLasScale;
+            bb_max[c] = offset[c] + double(llround((point_cloud.bbox.bb_max[c] - offset[c]) / kLasScale)) * kLasScale;
+        }
+    }
+
+    // GeoKeyDirectoryTag: projected wgs 84 utm, meters.
+    const uint16_t geo_keys[] = { 1, 1, 0, 5,
+                                  1024, 0, 1, 1,            // model type projected
+                                  1025, 0, 1, 1,            // raster type pixel is area
+                                  3072, 0, 1, uint16_t(GetProjectedCsCode(point_cloud.utm_zone, point_cloud.northp)),
+                                  3076, 0, 1, 9001,         // linear units meter
+                                  4099, 0, 1, 9001 };       // vertical units meter
+
+    time_t now = time(nullptr);
+    tm* date = gmtime(&now);
+
+    vector<uint8_t> header;
+    header.reserve(kLasHeaderSize + kLasVlrHeaderSize + sizeof(geo_keys));
+    AppendString(header, "LASF", 4);
+    AppendValue<uint16_t>(header, 0);                   // file source id
+    AppendValue<uint16_t>(header, 0);                   // global encoding, gps week time
+    AppendString(header, "", 16);                       // project guid
+    AppendValue<uint8_t>(header, 1);
+    AppendValue<uint8_t>(header, 2);
+    AppendString(header, "OTHER", 32);                  // system identifier
+    AppendString(header, "MeshTool", 32);               // generating software
+    AppendValue<uint16_t>(header, uint16_t(date ? date->tm_yday + 1 : 0));
+    AppendValue<uint16_t>(header, uint16_t(date ? date->tm_year + 1900 : 0));
+    AppendValue<uint16_t>(header, uint16_t(kLasHeaderSize));
+    AppendValue<uint32_t>(header, uint32_t(kLasHeaderSize + kLasVlrHeaderSize + sizeof(geo_keys)));
+    AppendValue<uint32_t>(header, 1);                   // number of variable length records
+    AppendValue<uint8_t>(header, uint8_t(kLasPointFormat));
+    AppendValue<uint16_t>(header, uint16_t(kLasPointSize));
+    AppendValue<uint32_t>(header, uint32_t(num_points));
+    AppendValue<uint32_t>(header, uint32_t(num_points)); // all single returns
+    for (int32_t i = 1; i < 5; i++)
+    {
+        AppendValue<uint32_t>(header, 0);
+    }
+    for (int32_t c = 0; c < 3; c++)
+    {
+        AppendValue<double>(header, kLasScale);
+    }
+    for (int32_t c = 0; c < 3; c++)
+    {
+        AppendValue<double>(header, offset[c]);
+    }
+    for (int32_t c = 0; c < 3; c++)
+    {
+        AppendValue<double>(header, bb_max[c]);
+        AppendValue<double>(header, bb_min[c]);
+    }
+
+    AppendValue<uint16_t>(header, 0);                   // reserved
+    AppendString(header, "LASF_Projection", 16);
+    AppendValue<uint16_t>(header, 34735);
+    AppendValue<uint16_t>(header, uint16_t(sizeof(geo_keys)));
+    AppendString(header, "GeoKeyDirectoryTag", 32);
+    for (uint16_t key : geo_keys)
+    {
+        AppendValue<uint16_t>(header, key);
+    }
+
+    vector<uint8_t> body(num_points * kLasPointSize);
+    core::ParallelFor(num_points, 4096, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            uint8_t* dst = &body[i * kLasPointSize];
+            const core::vec3d& p = point_cloud.position_list[i];
+            uint32_t color = point_cloud.color_list[i];
+            int32_t xyz[3];
+            for (int32_t c = 0; c < 3; c++)
+            {
+                xyz[c] = int32_t(llround((p[c] - offset[c]) / kLasScale));
+            }
+            memcpy(dst, xyz, sizeof(xyz));
+            dst[12] = 0;                    // intensity
+            dst[13] = 0;
+            dst[14] = 0x09;                 // return 1 of 1
+            dst[15] = 0;                    // never classified
+            dst[16] = 0;                    // scan angle rank
+            dst[17] = 0;                    // user data
+            dst[18] = 0;                    // point source id
+            dst[19] = 0;
+            uint16_t rgb[3] = { uint16_t((color & 0xff) * 257), uint16_t(((color >> 8) & 0xff) * 257), uint16_t(((color >> 16) & 0xff) * 257) };
+            memcpy(dst + 20, rgb, sizeof(rgb));
+        }
+    });
+
+    return WriteFileData(file_name, header, body);
+}
+
+bool ExportPointCloudFile(const string& file_name, const vector<BatchMeshData*>& batch_mesh_data,
+                          const PointCloudOptions& options/* = PointCloudOptions()*/)
+{
+    size_t pos = file_name.rfind('.');
+    string ext_name = pos == string::npos ? "" : file_name.substr(pos);
+    transform(ext_name.begin(), ext_name.end(), ext_name.begin(), [](char c) { return char(tolower(c)); });
+    if (ext_name != ".ply" && ext_name != ".las")
+    {
+        core::output_debug_info("error", "unknown point cloud format : " + file_name);
+        return false;
+    }
+
+    PointCloud point_cloud;
+    if (!SamplePointCloud(batch_mesh_data, options, point_cloud))
+    {
+        core::output_debug_info("error", "no geometry to export as points");
+        return false;
+    }
+
+    if (!DownsamplePointCloud(point_cloud, options.voxel_size))
+    {
+        return false;
+    }
+
+    return ext_name == ".ply" ? ExportPlyPointFile(file_name, point_cloud) : ExportLasPointFile(file_name, point_cloud);
+}
@@ -217,6 +217,7 @@ char CPL_DLL *VSIStrerror( int );
 /* ==================================================================== */
 void CPL_DLL VSIInstallMemFileHandler(void);
 void CPL_DLL VSIInstallLargeFileHandler(void);
+void CPL_DLL VSIInstallMMapFileHandler(void);
 void CPL_DLL VSICleanupFileManager(void);
 
 FILE CPL_DLL *VSIFileFromMemBuffer( const char *pszFilename, 
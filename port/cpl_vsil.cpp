@@ -516,6 +516,7 @@ VSIFileManager *VSIFileManager::Get()
         poManager = new VSIFileManager;
         VSIInstallLargeFileHandler();
         VSIInstallMemFileHandler();
+        VSIInstallMMapFileHandler();
     }
     
     return poManager;
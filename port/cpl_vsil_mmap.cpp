@@ -0,0 +1,416 @@
+/******************************************************************************
+ *
+ * Project:  VSI Virtual File System
+ * Purpose:  Implementation of a read-only memory mapped file handler,
+ *           serving VSIFReadL() requests directly from a mapped view of
+ *           the file instead of going through fseek()/fread().
+ *
+ ******************************************************************************
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ******************************************************************************/
+
+#include "cpl_vsi_private.h"
+#include "cpl_string.h"
+#include "cpl_conv.h"
+
+#if defined(WIN32)
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <sys/types.h>
+#endif
+
+#define VSI_MMAP_PREFIX "/vsimmap/"
+
+/************************************************************************/
+/* ==================================================================== */
+/*                       VSIMMapFilesystemHandler                       */
+/* ==================================================================== */
+/************************************************************************/
+
+class VSIMMapFilesystemHandler : public VSIFilesystemHandler
+{
+public:
+    virtual VSIVirtualHandle *Open( const char *pszFilename,
+                                    const char *pszAccess);
+    virtual int      Stat( const char *pszFilename, VSIStatBufL *pStatBuf );
+    virtual char   **ReadDir( const char *pszDirname );
+};
+
+/************************************************************************/
+/* ==================================================================== */
+/*                             VSIMMapHandle                            */
+/* ==================================================================== */
+/************************************************************************/
+
+class VSIMMapHandle : public VSIVirtualHandle
+{
+  public:
+    GByte         *pabyData;
+    vsi_l_offset  nLength;
+    vsi_l_offset  nOffset;
+    int           bEOF;
+
+#if defined(WIN32)
+    HANDLE        hFile;
+    HANDLE        hMapping;
+#else
+    int           nFD;
+#endif
+
+                      VSIMMapHandle();
+
+    virtual int       Seek( vsi_l_offset nOffset, int nWhence );
+    virtual vsi_l_offset Tell();
+    virtual size_t    Read( void *pBuffer, size_t nSize, size_t nMemb );
+    virtual size_t    Write( const void *pBuffer, size_t nSize, size_t nMemb );
+    virtual int       Eof();
+    virtual int       Close();
+};
+
+/************************************************************************/
+/*                           VSIMMapHandle()                            */
+/************************************************************************/
+
+VSIMMapHandle::VSIMMapHandle()
+
+{
+    pabyData = NULL;
+    nLength = 0;
+    nOffset = 0;
+    bEOF = FALSE;
+#if defined(WIN32)
+    hFile = INVALID_HANDLE_VALUE;
+    hMapping = NULL;
+#else
+    nFD = -1;
+#endif
+}
+
+/************************************************************************/
+/*                               Close()                                */
+/************************************************************************/
+
+int VSIMMapHandle::Close()
+
+{
+#if defined(WIN32)
+    if( pabyData != NULL )
+        UnmapViewOfFile( pabyData );
+    if( hMapping != NULL )
+        CloseHandle( hMapping );
+    if( hFile != INVALID_HANDLE_VALUE )
+        CloseHandle( hFile );
+    hMapping = NULL;
+    hFile = INVALID_HANDLE_VALUE;
+#else
+    if( pabyData != NULL )
+        munmap( pabyData, (size_t) nLength );
+    if( nFD >= 0 )
+        close( nFD );
+    nFD = -1;
+#endif
+    pabyData = NULL;
+
+    return 0;
+}
+
+/************************************************************************/
+/*                                Seek()                                */
+/************************************************************************/
+
+int VSIMMapHandle::Seek( vsi_l_offset nOffset, int nWhence )
+
+{
+    vsi_l_offset nBase;
+
+    if( nWhence == SEEK_CUR )
+        nBase = this->nOffset;
+    else if( nWhence == SEEK_SET )
+        nBase = 0;
+    else if( nWhence == SEEK_END )
+        nBase = nLength;
+    else
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Like fseek(), offsets are signed relative to the base and a    */
+/*      position before the start fails leaving the offset as it is.   */
+/*      Seeking past the end is legal, reads there just return         */
+/*      nothing.                                                        */
+/* -------------------------------------------------------------------- */
+    if( (GIntBig) nOffset < 0 && (vsi_l_offset) -(GIntBig) nOffset > nBase )
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    this->nOffset = nBase + nOffset;
+    bEOF = FALSE;
+
+    return 0;
+}
+
+/************************************************************************/
+/*                                Tell()                                */
+/************************************************************************/
+
+vsi_l_offset VSIMMapHandle::Tell()
+
+{
+    return nOffset;
+}
+
+/************************************************************************/
+/*                                Read()                                */
+/************************************************************************/
+
+size_t VSIMMapHandle::Read( void * pBuffer, size_t nSize, size_t nCount )
+
+{
+    if( nSize == 0 || nCount == 0 )
+        return 0;
+
+    if( nOffset >= nLength )
+    {
+        bEOF = TRUE;
+        return 0;
+    }
+
+    vsi_l_offset nBytesToRead = (vsi_l_offset) nSize * nCount;
+
+    if( nBytesToRead > nLength - nOffset )
+    {
+        // match fread(): only whole elements are reported, but the
+        // trailing partial element is still copied out, and only a
+        // short read sets the end of file flag.
+        nBytesToRead = nLength - nOffset;
+        nCount = (size_t) (nBytesToRead / nSize);
+        bEOF = TRUE;
+    }
+
+    memcpy( pBuffer, pabyData + nOffset, (size_t) nBytesToRead );
+    nOffset += nBytesToRead;
+
+    return nCount;
+}
+
+/************************************************************************/
+/*                               Write()                                */
+/************************************************************************/
+
+size_t VSIMMapHandle::Write( const void * pBuffer, size_t nSize,
+                             size_t nCount )
+
+{
+    errno = EACCES;
+    return 0;
+}
+
+/************************************************************************/
+/*                                Eof()                                 */
+/************************************************************************/
+
+int VSIMMapHandle::Eof()
+
+{
+    return bEOF;
+}
+
+/************************************************************************/
+/* ==================================================================== */
+/*                       VSIMMapFilesystemHandler                       */
+/* ==================================================================== */
+/************************************************************************/
+
+/************************************************************************/
+/*                          VSIMMapStripPrefix()                        */
+/************************************************************************/
+
+static const char *VSIMMapStripPrefix( const char *pszFilename )
+
+{
+    if( EQUALN(pszFilename, VSI_MMAP_PREFIX, strlen(VSI_MMAP_PREFIX)) )
+        return pszFilename + strlen(VSI_MMAP_PREFIX);
+
+    return pszFilename;
+}
+
+/************************************************************************/
+/*                           VSIMMapTryMap()                            */
+/*                                                                      */
+/*      Map the whole file read-only.  Returns NULL if the file can     */
+/*      not be mapped for any reason (empty file, too large for the     */
+/*      address space, special file ...) so the caller can fall back.  */
+/************************************************************************/
+
+static VSIMMapHandle *VSIMMapTryMap( const char *pszFilename )
+
+{
+    VSIMMapHandle *poHandle = new VSIMMapHandle;
+
+#if defined(WIN32)
+    poHandle->hFile = CreateFileA( pszFilename, GENERIC_READ,
+                                   FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                   NULL, OPEN_EXISTING,
+                                   FILE_ATTRIBUTE_NORMAL
+                                   | FILE_FLAG_RANDOM_ACCESS, NULL );
+    if( poHandle->hFile == INVALID_HANDLE_VALUE )
+    {
+        delete poHandle;
+        return NULL;
+    }
+
+    LARGE_INTEGER li;
+    if( !GetFileSizeEx( poHandle->hFile, &li ) || li.QuadPart == 0
+        || (GUIntBig) li.QuadPart > (GUIntBig) ((size_t) -1) )
+    {
+        poHandle->Close();
+        delete poHandle;
+        return NULL;
+    }
+    poHandle->nLength = (vsi_l_offset) li.QuadPart;
+
+    poHandle->hMapping = CreateFileMappingA( poHandle->hFile, NULL,
+                                             PAGE_READONLY, 0, 0, NULL );
+    if( poHandle->hMapping != NULL )
+        poHandle->pabyData = (GByte *)
+            MapViewOfFile( poHandle->hMapping, FILE_MAP_READ, 0, 0, 0 );
+#else
+    poHandle->nFD = open( pszFilename, O_RDONLY );
+    if( poHandle->nFD < 0 )
+    {
+        delete poHandle;
+        return NULL;
+    }
+
+    struct stat sStat;
+    if( fstat( poHandle->nFD, &sStat ) != 0 || !S_ISREG(sStat.st_mode)
+        || sStat.st_size == 0
+        || (GUIntBig) sStat.st_size > (GUIntBig) ((size_t) -1) )
+    {
+        poHandle->Close();
+        delete poHandle;
+        return NULL;
+    }
+    poHandle->nLength = (vsi_l_offset) sStat.st_size;
+
+    void *pMapped = mmap( NULL, (size_t) poHandle->nLength, PROT_READ,
+                          MAP_SHARED, poHandle->nFD, 0 );
+    if( pMapped != MAP_FAILED )
+    {
+        poHandle->pabyData = (GByte *) pMapped;
+        // raster blocks are fetched in tile order, not sequentially.
+        madvise( pMapped, (size_t) poHandle->nLength, MADV_RANDOM );
+    }
+#endif
+
+    if( poHandle->pabyData == NULL )
+    {
+        poHandle->Close();
+        delete poHandle;
+        return NULL;
+    }
+
+    return poHandle;
+}
+
+/************************************************************************/
+/*                                Open()                                */
+/************************************************************************/
+
+VSIVirtualHandle *
+VSIMMapFilesystemHandler::Open( const char *pszFilename,
+                                const char *pszAccess )
+
+{
+    const char *pszRealFilename = VSIMMapStripPrefix( pszFilename );
+
+/* -------------------------------------------------------------------- */
+/*      Only read access is served from the mapping, anything else     */
+/*      and any file we fail to map goes to the regular handler.       */
+/* -------------------------------------------------------------------- */
+    if( strchr(pszAccess, 'w') == NULL && strchr(pszAccess, '+') == NULL
+        && strchr(pszAccess, 'a') == NULL )
+    {
+        VSIMMapHandle *poHandle = VSIMMapTryMap( pszRealFilename );
+        if( poHandle != NULL )
+            return poHandle;
+    }
+
+    VSIFilesystemHandler *poFSHandler =
+        VSIFileManager::GetHandler( pszRealFilename );
+
+    return poFSHandler->Open( pszRealFilename, pszAccess );
+}
+
+/************************************************************************/
+/*                                Stat()                                */
+/************************************************************************/
+
+int VSIMMapFilesystemHandler::Stat( const char * pszFilename,
+                                    VSIStatBufL * pStatBuf )
+
+{
+    return VSIStatL( VSIMMapStripPrefix( pszFilename ), pStatBuf );
+}
+
+/************************************************************************/
+/*                              ReadDir()                               */
+/************************************************************************/
+
+char **VSIMMapFilesystemHandler::ReadDir( const char *pszPath )
+
+{
+    const char *pszRealPath = VSIMMapStripPrefix( pszPath );
+
+    return VSIFileManager::GetHandler( pszRealPath )->ReadDir( pszRealPath );
+}
+
+/************************************************************************/
+/*                      VSIInstallMMapFileHandler()                     */
+/************************************************************************/
+
+/**
+ * \brief Install memory mapped read-only file system handler.
+ *
+ * Files opened for reading under the "/vsimmap/" prefix are mapped into
+ * the address space as a whole and VSIFReadL() becomes a plain memcpy()
+ * out of the mapped view, with 64-bit offsets.  Files opened for update,
+ * and files that can not be mapped (empty, special, larger than the
+ * address space), are transparently opened through the regular large
+ * file handler instead.
+ *
+ * It is already called the first time a virtualizable file access
+ * function is called.
+ */
+
+void VSIInstallMMapFileHandler()
+
+{
+    VSIFileManager::InstallHandler( std::string(VSI_MMAP_PREFIX),
+                                    new VSIMMapFilesystemHandler );
+}
@@ -0,0 +1,672 @@
+#include "quantizedmesh.h"
+#include "coregeographic.h"
+#include "corethread.h"
+#include "debugout.h"
+#include <cfloat>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+constexpr uint32_t kQuantizedRange = 32767;
+constexpr size_t kQuantizedHeaderSize = 88;
+// tiles sampled before a parallel meshing pass, bounds the resident height samples.
+constexpr size_t kTerrainTileBatchSize = 256;
+constexpr double kWgs84PolarRadius = 6356752.3142451793;
+// horizon occlusion point of tiles no point hides, in ellipsoid radii.
+constexpr double kFarHorizonMagnitude = 1.0e6;
+
+// right triangulated irregular network over a (2^n + 1)^2 grid, after mapbox's martini.
+// triangles are numbered by their position in the implicit binary tree of splits.
+struct RtinGrid
+{
+    uint32_t            grid_size;
+    uint32_t            tile_size;
+    uint32_t            num_triangles;
+    uint32_t            num_parent_triangles;
+    vector<uint16_t>    coords;     // ax ay bx by of every triangle, the hypotenuse
+
+    explicit RtinGrid(uint32_t size) : grid_size(size), tile_size(size - 1)
+    {
+        num_triangles = tile_size * tile_size * 2 - 2;
+        num_parent_triangles = num_triangles - tile_size * tile_size;
+        coords.resize(size_t(num_triangles) * 4);
+        for (uint32_t i = 0; i < num_triangles; i++)
+        {
+            uint32_t id = i + 2;
+            uint32_t ax = 0, ay = 0, bx = 0, by = 0, cx = 0, cy = 0;
+            if (id & 1)
+            {
+                bx = by = cx = tile_size;
+            }
+            else
+            {
+                ax = ay = cy = tile_size;
+            }
+
+            while ((id >>= 1) > 1)
+            {
+                uint32_t mx = (ax + bx) >> 1;
+                uint32_t my = (ay + by) >> 1;
+                if (id & 1)
+                {
+                    bx = ax; by = ay;
+                    ax = cx; ay = cy;
+                }
+                else
+                {
+                    ax = bx; ay = by;
+                    bx = cx; by = cy;
+                }
+                cx = mx; cy = my;
+            }
+
+            coords[i * 4 + 0] = uint16_t(ax);
+            coords[i * 4 + 1] = uint16_t(ay);
+            coords[i * 4 + 2] = uint16_t(bx);
+            coords[i * 4 + 3] = uint16_t(by);
+        }
+    }
+
+    // error of every split point, the largest of its own and of the splits below it.
+    void compute_errors(const float* heights, vector<float>& errors) const
+    {
+        errors.assign(size_t(grid_size) * grid_size, 0.0f);
+        for (int32_t i = int32_t(num_triangles) - 1; i >= 0; i--)
+        {
+            uint32_t ax = coords[i * 4 + 0], ay = coords[i * 4 + 1];
+            uint32_t bx = coords[i * 4 + 2], by = coords[i * 4 + 3];
+            uint32_t mx = (ax + bx) >> 1;
+            uint32_t my = (ay + by) >> 1;
+            uint32_t cx = mx + my - ay;
+            uint32_t cy = my + ax - mx;
+
+            float interpolated = (heights[ay * grid_size + ax] + heights[by * grid_size + bx]) * 0.5f;
+            uint32_t middle = my * grid_size + mx;
+            errors[middle] = max(errors[middle], fabs(interpolated - heights[middle]));
+
+            if (uint32_t(i) < num_parent_triangles)
+            {
+                uint32_t left = ((ay + cy) >> 1) * grid_size + ((ax + cx) >> 1);
+                uint32_t right = ((by + cy) >> 1) * grid_size + ((bx + cx) >> 1);
+                errors[middle] = max(errors[middle], max(errors[left], errors[right]));
+            }
+        }
+    }
+};
+
+struct RtinMesh
+{
+    vector<uint32_t>    vertex_list;    // grid index of each vertex
+    vector<uint32_t>    index_list;
+    float               max_error;
+};
+
+void AddRtinTriangles(const RtinGrid& grid, const vector<float>& errors, float max_error,
+                      uint32_t ax, uint32_t ay, uint32_t bx, uint32_t by, uint32_t cx, uint32_t cy,
+                      vector<uint32_t>& vertex_map, RtinMesh& mesh)
+{
+    uint32_t mx = (ax + bx) >> 1;
+    uint32_t my = (ay + by) >> 1;
+    uint32_t middle = my * grid.grid_size + mx;
+    bool splittable = (ax > cx ? ax - cx : cx - ax) + (ay > cy ? ay - cy : cy - ay) > 1;
+    if (splittable && errors[middle] > max_error)
+    {
+        AddRtinTriangles(grid, errors, max_error, cx, cy, ax, ay, mx, my, vertex_map, mesh);
+        AddRtinTriangles(grid, errors, max_error, bx, by, cx, cy, mx, my, vertex_map, mesh);
+        return;
+    }
+
+    if (splittable)
+    {
+        mesh.max_error = max(mesh.max_error, errors[middle]);
+    }
+
+    uint32_t corners[3] = { ay * grid.grid_size + ax, by * grid.grid_size + bx, cy * grid.grid_size + cx };
+    for (uint32_t corner : corners)
+    {
+        if (vertex_map[corner] == INVALID_VALUE)
+        {
+            vertex_map[corner] = uint32_t(mesh.vertex_list.size());
+            mesh.vertex_list.push_back(corner);
+        }
+        mesh.index_list.push_back(vertex_map[corner]);
+    }
+}
+
+void BuildRtinMesh(const RtinGrid& grid, const vector<float>& errors, float max_error, RtinMesh& mesh)
+{
+    vector<uint32_t> vertex_map(size_t(grid.grid_size) * grid.grid_size, INVALID_VALUE);
+    uint32_t t = grid.tile_size;
+    mesh.vertex_list.clear();
+    mesh.index_list.clear();
+    mesh.max_error = 0.0f;
+    AddRtinTriangles(grid, errors, max_error, 0, 0, t, t, t, 0, vertex_map, mesh);
+    AddRtinTriangles(grid, errors, max_error, t, t, 0, 0, 0, t, vertex_map, mesh);
+}
+
+double GetTileSize(int32_t level)
+{
+    return 180.0 / double(int64_t(1) << level);
+}
+
+core::vec3d ToEcef(double lon, double lat, double h)
+{
+    core::vec3d ecef(0, 0, 0);
+    core::CoordinateTransformer::lla_to_ecef(core::GpsCoord(lon, lat, h), ecef);
+    return ecef;
+}
+
+// cesium's EllipsoidalOccluder::computeHorizonCullingPoint, in ellipsoid scaled space.
+// no point hides a tile with vertices 90 degrees or more off the direction, as the level
+// 0 tiles have, those get a point far out along it, the farthest one returned. the vertices of such a tile may also
+// center on the earth's center, fallback_direction is taken then.
+core::vec3d ComputeHorizonOcclusionPoint(const core::vec3d& direction, const core::vec3d& fallback_direction,
+                                         const vector<core::vec3d>& positions)
+{
+    const core::vec3d radii(core::emajor, core::emajor, kWgs84PolarRadius);
+    core::vec3d scaled_direction = direction / radii;
+    if (core::length(scaled_direction) < 1.0e-6)
+    {
+        scaled_direction = fallback_direction / radii;
+    }
+    scaled_direction = scaled_direction / core::length(scaled_direction);
+
+    double max_magnitude = 0.0;
+    for (const auto& position : positions)
+    {
+        core::vec3d scaled_position = position / radii;
+        double magnitude_squared = core::dot(scaled_position, scaled_position);
+        double magnitude = sqrt(magnitude_squared);
+        core::vec3d dir = scaled_position / magnitude;
+
+        magnitude_squared = max(1.0, magnitude_squared);
+        magnitude = max(1.0, magnitude);
+        double cos_alpha = core::dot(dir, scaled_direction);
+        double sin_alpha = core::length(cross(dir, scaled_direction));
+        double cos_beta = 1.0 / magnitude;
+        double sin_beta = sqrt(magnitude_squared - 1.0) * cos_beta;
+        double denominator = cos_alpha * cos_beta - sin_alpha * sin_beta;
+        if (denominator * kFarHorizonMagnitude <= 1.0)
+        {
+            return scaled_direction * kFarHorizonMagnitude;
+        }
+        max_magnitude = max(max_magnitude, 1.0 / denominator);
+    }
+
+    return scaled_direction * max_magnitude;
+}
+
+// quantize an rtin mesh of the sampled heights, rows of the grid run north to south.
+void BuildQuantizedMesh(const RtinGrid& grid, const float* heights, const RtinMesh& rtin_mesh,
+                        double west, double south, double tile_size, QuantizedMesh& mesh)
+{
+    float min_height = FLT_MAX, max_height = -FLT_MAX;
+    for (uint32_t idx : rtin_mesh.vertex_list)
+    {
+        min_height = min(min_height, heights[idx]);
+        max_height = max(max_height, heights[idx]);
+    }
+    float height_range = max_height - min_height;
+
+    size_t num_vertices = rtin_mesh.vertex_list.size();
+    mesh.u_list.resize(num_vertices);
+    mesh.v_list.resize(num_vertices);
+    mesh.height_list.resize(num_vertices);
+    mesh.west_index_list.clear();
+    mesh.south_index_list.clear();
+    mesh.east_index_list.clear();
+    mesh.north_index_list.clear();
+    for (uint32_t i = 0; i < num_vertices; i++)
+    {
+        uint32_t idx = rtin_mesh.vertex_list[i];
+        uint32_t x = idx % grid.grid_size;
+        uint32_t y = idx / grid.grid_size;
+        mesh.u_list[i] = uint16_t((x * kQuantizedRange + grid.tile_size / 2) / grid.tile_size);
+        mesh.v_list[i] = uint16_t(((grid.tile_size - y) * kQuantizedRange + grid.tile_size / 2) / grid.tile_size);
+        mesh.height_list[i] = height_range > 0.0f ? uint16_t(lround((heights[idx] - min_height) / height_range * kQuantizedRange)) : 0;
+
+        if (x == 0)
+        {
+            mesh.west_index_list.push_back(i);
+        }
+        if (x == grid.tile_size)
+        {
+            mesh.east_index_list.push_back(i);
+        }
+        if (y == 0)
+        {
+            mesh.north_index_list.push_back(i);
+        }
+        if (y == grid.tile_size)
+        {
+            mesh.south_index_list.push_back(i);
+        }
+    }
+
+    // edges run south to north and west to east.
+    sort(mesh.west_index_list.begin(), mesh.west_index_list.end(), [&](uint32_t a, uint32_t b) { return mesh.v_list[a] < mesh.v_list[b]; });
+    sort(mesh.east_index_list.begin(), mesh.east_index_list.end(), [&](uint32_t a, uint32_t b) { return mesh.v_list[a] < mesh.v_list[b]; });
+    sort(mesh.south_index_list.begin(), mesh.south_index_list.end(), [&](uint32_t a, uint32_t b) { return mesh.u_list[a] < mesh.u_list[b]; });
+    sort(mesh.north_index_list.begin(), mesh.north_index_list.end(), [&](uint32_t a, uint32_t b) { return mesh.u_list[a] < mesh.u_list[b]; });
+
+    // counter clockwise seen from above, v points north while grid rows point south.
+    mesh.index_list = rtin_mesh.index_list;
+    for (size_t i = 0; i + 2 < mesh.index_list.size(); i += 3)
+    {
+        uint32_t i0 = mesh.index_list[i], i1 = mesh.index_list[i + 1], i2 = mesh.index_list[i + 2];
+        int64_t area = (int64_t(mesh.u_list[i1]) - mesh.u_list[i0]) * (int64_t(mesh.v_list[i2]) - mesh.v_list[i0]) -
+                       (int64_t(mesh.v_list[i1]) - mesh.v_list[i0]) * (int64_t(mesh.u_list[i2]) - mesh.u_list[i0]);
+        if (area < 0)
+        {
+            // keeps the first index first, the high water mark order stays valid.
+            swap(mesh.index_list[i + 1], mesh.index_list[i + 2]);
+        }
+    }
+
+    mesh.min_height = min_height;
+    mesh.max_height = max_height;
+    double center_height = (double(min_height) + double(max_height)) * 0.5;
+    mesh.center = ToEcef(west + tile_size * 0.5, south + tile_size * 0.5, center_height);
+
+    vector<core::vec3d> positions(num_vertices);
+    core::bounds3d bbox;
+    for (uint32_t i = 0; i < num_vertices; i++)
+    {
+        double lon = west + tile_size * mesh.u_list[i] / kQuantizedRange;
+        double lat = south + tile_size * mesh.v_list[i] / kQuantizedRange;
+        double h = double(min_height) + double(height_range) * mesh.height_list[i] / kQuantizedRange;
+        positions[i] = ToEcef(lon, lat, h);
+        bbox += positions[i];
+    }
+
+    mesh.bounding_sphere_center = bbox.GetCentroid();
+    mesh.bounding_sphere_radius = 0.0;
+    for (const auto& position : positions)
+    {
+        mesh.bounding_sphere_radius = max(mesh.bounding_sphere_radius, core::length(position - mesh.bounding_sphere_center));
+    }
+    mesh.horizon_occlusion_point = ComputeHorizonOcclusionPoint(mesh.bounding_sphere_center, mesh.center, positions);
+}
+
+template <class T>
+void AppendValue(vector<uint8_t>& data, T value)
+{
+    size_t ofs = data.size();
+    data.resize(ofs + sizeof(T));
+    memcpy(&data[ofs], &value, sizeof(T));
+}
+
+template <class T>
+bool ReadValue(const uint8_t* data, size_t size, size_t& ofs, T& value)
+{
+    if (ofs + sizeof(T) > size)
+    {
+        return false;
+    }
+    memcpy(&value, data + ofs, sizeof(T));
+    ofs += sizeof(T);
+    return true;
+}
+
+void AppendIndex(vector<uint8_t>& data, uint32_t index, bool index_32)
+{
+    if (index_32)
+    {
+        AppendValue<uint32_t>(data, index);
+    }
+    else
+    {
+        AppendValue<uint16_t>(data, uint16_t(index));
+    }
+}
+
+bool ReadIndex(const uint8_t* data, size_t size, size_t& ofs, bool index_32, uint32_t& index)
+{
+    if (index_32)
+    {
+        return ReadValue(data, size, ofs, index);
+    }
+
+    uint16_t index_16 = 0;
+    bool succeeded = ReadValue(data, size, ofs, index_16);
+    index = index_16;
+    return succeeded;
+}
+
+void AppendVec3(vector<uint8_t>& data, const core::vec3d& v)
+{
+    AppendValue<double>(data, v.x);
+    AppendValue<double>(data, v.y);
+    AppendValue<double>(data, v.z);
+}
+
+bool ReadVec3(const uint8_t* data, size_t size, size_t& ofs, core::vec3d& v)
+{
+    return ReadValue(data, size, ofs, v.x) && ReadValue(data, size, ofs, v.y) && ReadValue(data, size, ofs, v.z);
+}
+
+bool WriteTileFile(const string& file_name, const vector<uint8_t>& data)
+{
+    ofstream out_file(file_name, ofstream::binary);
+    out_file.write(reinterpret_cast<const char*>(data.data()), streamsize(data.size()));
+    return bool(out_file);
+}
+}
+
+bool EncodeQuantizedMesh(const QuantizedMesh& mesh, vector<uint8_t>& data)
+{
+    size_t num_vertices = mesh.u_list.size();
+    if (mesh.v_list.size() != num_vertices || mesh.height_list.size() != num_vertices ||
+        num_vertices > UINT32_MAX || mesh.index_list.size() % 3 != 0)
+    {
+        return false;
+    }
+
+    data.clear();
+    AppendVec3(data, mesh.center);
+    AppendValue<float>(data, mesh.min_height);
+    AppendValue<float>(data, mesh.max_height);
+    AppendVec3(data, mesh.bounding_sphere_center);
+    AppendValue<double>(data, mesh.bounding_sphere_radius);
+    AppendVec3(data, mesh.horizon_occlusion_point);
+
+    AppendValue<uint32_t>(data, uint32_t(num_vertices));
+    for (const vector<uint16_t>* values : { &mesh.u_list, &mesh.v_list, &mesh.height_list })
+    {
+        int32_t prev = 0;
+        for (uint16_t value : *values)
+        {
+            int32_t delta = int32_t(value) - prev;
+            AppendValue<uint16_t>(data, uint16_t((delta << 1) ^ (delta >> 31)));
+            prev = value;
+        }
+    }
+
+    bool index_32 = num_vertices > 65536;
+    if (index_32)
+    {
+        data.resize((data.size() + 3) & ~size_t(3), 0);
+    }
+
+    AppendValue<uint32_t>(data, uint32_t(mesh.index_list.size() / 3));
+    uint32_t highest = 0;
+    for (uint32_t index : mesh.index_list)
+    {
+        // every index is at most one past the highest so far, vertices in first use order.
+        if (index > highest || index >= num_vertices)
+        {
+            return false;
+        }
+        AppendIndex(data, highest - index, index_32);
+        highest += index == highest ? 1 : 0;
+    }
+
+    for (const vector<uint32_t>* edge : { &mesh.west_index_list, &mesh.south_index_list, &mesh.east_index_list, &mesh.north_index_list })
+    {
+        AppendValue<uint32_t>(data, uint32_t(edge->size()));
+        for (uint32_t index : *edge)
+        {
+            AppendIndex(data, index, index_32);
+        }
+    }
+
+    return true;
+}
+
+bool DecodeQuantizedMesh(const uint8_t* data, size_t size, QuantizedMesh& mesh)
+{
+    size_t ofs = 0;
+    uint32_t num_vertices;
+    if (!ReadVec3(data, size, ofs, mesh.center) ||
+        !ReadValue(data, size, ofs, mesh.min_height) ||
+        !ReadValue(data, size, ofs, mesh.max_height) ||
+        !ReadVec3(data, size, ofs, mesh.bounding_sphere_center) ||
+        !ReadValue(data, size, ofs, mesh.bounding_sphere_radius) ||
+        !ReadVec3(data, size, ofs, mesh.horizon_occlusion_point) ||
+        !ReadValue(data, size, ofs, num_vertices) ||
+        ofs != kQuantizedHeaderSize + 4 ||
+        size - ofs < size_t(num_vertices) * 6)
+    {
+        return false;
+    }
+
+    for (vector<uint16_t>* values : { &mesh.u_list, &mesh.v_list, &mesh.height_list })
+    {
+        values->resize(num_vertices);
+        int32_t value = 0;
+        for (uint32_t i = 0; i < num_vertices; i++)
+        {
+            uint16_t code = 0;
+            if (!ReadValue(data, size, ofs, code))
+            {
+                return false;
+            }
+            value += int32_t(code >> 1) ^ -int32_t(code & 1);
+            (*values)[i] = uint16_t(value);
+        }
+    }
+
+    bool index_32 = num_vertices > 65536;
+    if (index_32)
+    {
+        ofs = (ofs + 3) & ~size_t(3);
+    }
+
+    uint32_t num_triangles;
+    if (!ReadValue(data, size, ofs, num_triangles) || (size - ofs) / (index_32 ? 4 : 2) / 3 < num_triangles)
+    {
+        return false;
+    }
+
+    mesh.index_list.resize(size_t(num_triangles) * 3);
+    uint32_t highest = 0;
+    for (auto& index : mesh.index_list)
+    {
+        uint32_t code = 0;
+        if (!ReadIndex(data, size, ofs, index_32, code) || code > highest)
+        {
+            return false;
+        }
+        index = highest - code;
+        highest += code == 0 ? 1 : 0;
+    }
+
+    if (highest > num_vertices)
+    {
+        return false;
+    }
+
+    for (vector<uint32_t>* edge : { &mesh.west_index_list, &mesh.south_index_list, &mesh.east_index_list, &mesh.north_index_list })
+    {
+        uint32_t count;
+        if (!ReadValue(data, size, ofs, count) || (size - ofs) / (index_32 ? 4 : 2) < count)
+        {
+            return false;
+        }
+
+        edge->resize(count);
+        for (auto& index : *edge)
+        {
+            if (!ReadIndex(data, size, ofs, index_32, index) || index >= num_vertices)
+            {
+                return false;
+            }
+        }
+    }
+
+    // extensions may follow, they are not read.
+    return true;
+}
+
+bool ExportQuantizedMeshTiles(ElevationMosaic& elevation_mosaic, const string& folder_name,
+                              const TerrainTilerOptions& options/* = TerrainTilerOptions()*/,
+                              const core::GeoidModel* geoid_model/* = nullptr*/,
+                              vector<QuantizedMeshTileInfo>* tile_info_list/* = nullptr*/)
+{
+    uint32_t grid_size = options.grid_size;
+    if (elevation_mosaic.get_num_tiles() == 0 || grid_size < 3 || ((grid_size - 1) & (grid_size - 2)) != 0)
+    {
+        core::output_debug_info("error", "terrain tiles need rasters and a 2^n + 1 grid size");
+        return false;
+    }
+
+    const RtinGrid rtin_grid(grid_size);
+    uint32_t tile_size = grid_size - 1;
+    core::bounds2d bounds = elevation_mosaic.get_bounds();
+
+    int32_t max_level = options.max_level;
+    if (max_level < 0)
+    {
+        // the first level whose sample spacing is as fine as the rasters.
+        double pixel_size = fabs(elevation_mosaic.get_pixel_size().x);
+        max_level = int32_t(ceil(log2(180.0 / (tile_size * pixel_size))));
+        max_level = max(min(max_level, 24), 0);
+    }
+    int32_t min_level = max(min(options.min_level, max_level), 0);
+
+    struct TileRange
+    {
+        int32_t x0, y0, x1, y1;
+    };
+
+    vector<TileRange> range_list;
+    vector<QuantizedMeshTileInfo> tile_list;
+    for (int32_t level = min_level; level <= max_level; level++)
+    {
+        double size = GetTileSize(level);
+        int32_t num_x = int32_t(2) << level, num_y = int32_t(1) << level;
+        TileRange range;
+        range.x0 = level == 0 ? 0 : max(int32_t(floor((bounds.bb_min.x + 180.0) / size)), 0);
+        range.x1 = level == 0 ? num_x - 1 : min(int32_t(floor((bounds.bb_max.x + 180.0) / size)), num_x - 1);
+        range.y0 = level == 0 ? 0 : max(int32_t(floor((bounds.bb_min.y + 90.0) / size)), 0);
+        range.y1 = level == 0 ? num_y - 1 : min(int32_t(floor((bounds.bb_max.y + 90.0) / size)), num_y - 1);
+        range_list.push_back(range);
+
+        for (int32_t y = range.y0; y <= range.y1; y++)
+        {
+            for (int32_t x = range.x0; x <= range.x1; x++)
+            {
+                QuantizedMeshTileInfo info = {};
+                info.level = level;
+                info.x = x;
+                info.y = y;
+                tile_list.push_back(info);
+            }
+        }
+    }
+
+    size_t num_samples = size_t(grid_size) * grid_size;
+    vector<float> height_list;
+    vector<uint8_t> succeeded_list;
+    bool all_succeeded = true;
+    for (size_t batch_start = 0; batch_start < tile_list.size(); batch_start += kTerrainTileBatchSize)
+    {
+        size_t batch_size = min(kTerrainTileBatchSize, tile_list.size() - batch_start);
+
+        // the rasters page blocks through one cache, sampling stays on this thread.
+        height_list.resize(batch_size * num_samples);
+        for (size_t i = 0; i < batch_size; i++)
+        {
+            const QuantizedMeshTileInfo& info = tile_list[batch_start + i];
+            double step = GetTileSize(info.level) / tile_size;
+            float* heights = &height_list[i * num_samples];
+            for (uint32_t row = 0; row < grid_size; row++)
+            {
+                // global sample indices, neighbouring tiles sample their shared edge alike.
+                double lat = -90.0 + double(int64_t(info.y) * tile_size + (tile_size - row)) * step;
+                for (uint32_t col = 0; col < grid_size; col++)
+                {
+                    double lon = -180.0 + double(int64_t(info.x) * tile_size + col) * step;
+                    core::vec2d pos(lon, lat);
+                    float h = elevation_mosaic.contains(pos) ? elevation_mosaic.get_height(pos) : 0.0f;
+                    if (geoid_model)
+                    {
+                        h += float(geoid_model->undulation(lat, lon));
+                    }
+                    heights[row * grid_size + col] = h;
+                }
+            }
+
+            fs::create_directories(folder_name + "/" + to_string(info.level) + "/" + to_string(info.x));
+        }
+        elevation_mosaic.flush();
+
+        succeeded_list.assign(batch_size, 0);
+        core::ParallelFor(batch_size, 1, [&](size_t begin, size_t end)
+        {
+            vector<float> errors;
+            RtinMesh rtin_mesh;
+            QuantizedMesh mesh;
+            vector<uint8_t> data;
+            for (size_t i = begin; i < end; i++)
+            {
+                QuantizedMeshTileInfo& info = tile_list[batch_start + i];
+                const float* heights = &height_list[i * num_samples];
+                double size = GetTileSize(info.level);
+                float max_error = float(options.error_scale * kTerrainLevelZeroGeometricError / double(int64_t(1) << info.level));
+
+                rtin_grid.compute_errors(heights, errors);
+                BuildRtinMesh(rtin_grid, errors, max_error, rtin_mesh);
+                BuildQuantizedMesh(rtin_grid, heights, rtin_mesh, -180.0 + info.x * size, -90.0 + info.y * size, size, mesh);
+
+                info.num_vertices = uint32_t(mesh.u_list.size());
+                info.num_triangles = uint32_t(mesh.index_list.size() / 3);
+                info.max_error = rtin_mesh.max_error;
+                info.min_height = mesh.min_height;
+                info.max_height = mesh.max_height;
+
+                string file_name = folder_name + "/" + to_string(info.level) + "/" + to_string(info.x) + "/" + to_string(info.y) + ".terrain";
+                succeeded_list[i] = EncodeQuantizedMesh(mesh, data) && WriteTileFile(file_name, data);
+            }
+        });
+
+        all_succeeded = all_succeeded && find(succeeded_list.begin(), succeeded_list.end(), 0) == succeeded_list.end();
+    }
+
+    ofstream layer_file(folder_name + "/layer.json");
+    layer_file << "{\n"
+                  "  \"tilejson\": \"2.1.0\",\n"
+                  "  \"name\": \"terrain\",\n"
+                  "  \"version\": \"1.0.0\",\n"
+                  "  \"format\": \"quantized-mesh-1.0\",\n"
+                  "  \"scheme\": \"tms\",\n"
+                  "  \"tiles\": [\"{z}/{x}/{y}.terrain\"],\n"
+                  "  \"projection\": \"EPSG:4326\",\n";
+    layer_file << "  \"bounds\": [" << bounds.bb_min.x << ", " << bounds.bb_min.y << ", " << bounds.bb_max.x << ", " << bounds.bb_max.y << "],\n";
+    layer_file << "  \"minzoom\": " << min_level << ",\n  \"maxzoom\": " << max_level << ",\n  \"available\": [\n";
+    for (int32_t level = 0; level <= max_level; level++)
+    {
+        layer_file << "    [";
+        if (level >= min_level)
+        {
+            const TileRange& range = range_list[size_t(level - min_level)];
+            layer_file << "{\"startX\": " << range.x0 << ", \"startY\": " << range.y0 << ", \"endX\": " << range.x1 << ", \"endY\": " << range.y1 << "}";
+        }
+        layer_file << (level < max_level ? "],\n" : "]\n");
+    }
+    layer_file << "  ]\n}\n";
+
+    ofstream metrics_file(folder_name + "/tile_metrics.csv");
+    metrics_file << "level,x,y,vertices,triangles,max_error,min_height,max_height\n";
+    for (const auto& info : tile_list)
+    {
+        metrics_file << info.level << "," << info.x << "," << info.y << "," << info.num_vertices << "," << info.num_triangles << ","
+                     << info.max_error << "," << info.min_height << "," << info.max_height << "\n";
+    }
+
+    if (tile_info_list)
+    {
+        *tile_info_list = move(tile_list);
+    }
+
+    if (!all_succeeded || !layer_file || !metrics_file)
+    {
+        core::output_debug_info("error", "failed to write terrain tiles to " + folder_name);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,427 @@
+#include "registration.h"
+#include <algorithm>
+#include <random>
+
+namespace
+{
+// cyclic jacobi rotations of a symmetric matrix, eigenvalues to eigen_value_list and the
+// matching eigenvectors to the columns of eigen_vectors, largest first.
+template <int N>
+void SymmetricEigen(double mat[N][N], double eigen_vectors[N][N], double eigen_value_list[N])
+{
+    for (int i = 0; i < N; i++)
+    {
+        for (int j = 0; j < N; j++)
+        {
+            eigen_vectors[i][j] = i == j ? 1.0 : 0.0;
+        }
+    }
+
+    for (int i_sweep = 0; i_sweep < 50; i_sweep++)
+    {
+        double off_diag = 0.0;
+        for (int p = 0; p < N; p++)
+        {
+            for (int q = p + 1; q < N; q++)
+            {
+                off_diag += mat[p][q] * mat[p][q];
+            }
+        }
+
+        if (off_diag < 1e-30)
+        {
+            break;
+        }
+
+        for (int p = 0; p < N; p++)
+        {
+            for (int q = p + 1; q < N; q++)
+            {
+                if (mat[p][q] == 0.0)
+                {
+                    continue;
+                }
+
+                double theta = (mat[q][q] - mat[p][p]) / (2.0 * mat[p][q]);
+                double t = (theta >= 0.0 ? 1.0 : -1.0) / (fabs(theta) + sqrt(theta * theta + 1.0));
+                double c = 1.0 / sqrt(t * t + 1.0);
+                double s = t * c;
+
+                for (int k = 0; k < N; k++)
+                {
+                    double a_kp = mat[k][p];
+                    double a_kq = mat[k][q];
+                    mat[k][p] = c * a_kp - s * a_kq;
+                    mat[k][q] = s * a_kp + c * a_kq;
+                }
+
+                for (int k = 0; k < N; k++)
+                {
+                    double a_pk = mat[p][k];
+                    double a_qk = mat[q][k];
+                    mat[p][k] = c * a_pk - s * a_qk;
+                    mat[q][k] = s * a_pk + c * a_qk;
+                }
+
+                for (int k = 0; k < N; k++)
+                {
+                    double v_kp = eigen_vectors[k][p];
+                    double v_kq = eigen_vectors[k][q];
+                    eigen_vectors[k][p] = c * v_kp - s * v_kq;
+                    eigen_vectors[k][q] = s * v_kp + c * v_kq;
+                }
+            }
+        }
+    }
+
+    int order[N];
+    for (int i = 0; i < N; i++)
+    {
+        order[i] = i;
+    }
+    sort(order, order + N, [&](int a, int b) { return mat[a][a] > mat[b][b]; });
+
+    double sorted_vectors[N][N];
+    for (int i = 0; i < N; i++)
+    {
+        eigen_value_list[i] = mat[order[i]][order[i]];
+        for (int k = 0; k < N; k++)
+        {
+            sorted_vectors[k][i] = eigen_vectors[k][order[i]];
+        }
+    }
+    memcpy(eigen_vectors, sorted_vectors, sizeof(sorted_vectors));
+}
+
+// the points span a plane at least, the fit has a unique rotation.
+bool IsSpreadEnough(const core::vec3d* point_list, const uint32_t* idx_list, uint32_t num_points)
+{
+    core::vec3d centroid(0, 0, 0);
+    for (uint32_t i = 0; i < num_points; i++)
+    {
+        centroid += point_list[idx_list[i]];
+    }
+    centroid /= double(num_points);
+
+    double cov[3][3] = {};
+    for (uint32_t i = 0; i < num_points; i++)
+    {
+        core::vec3d d = point_list[idx_list[i]] - centroid;
+        for (int r = 0; r < 3; r++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                cov[r][c] += d[r] * d[c];
+            }
+        }
+    }
+
+    double eigen_vectors[3][3], eigen_value_list[3];
+    SymmetricEigen<3>(cov, eigen_vectors, eigen_value_list);
+    return eigen_value_list[0] > 0.0 && eigen_value_list[1] > 1e-12 * eigen_value_list[0];
+}
+
+bool FitSubset(const vector<core::vec3d>& src_list, const vector<core::vec3d>& dst_list,
+               const uint32_t* idx_list, uint32_t num_points, bool estimate_scale,
+               core::matrix4d& transform, double& scale)
+{
+    if (num_points < 3 || !IsSpreadEnough(src_list.data(), idx_list, num_points))
+    {
+        return false;
+    }
+
+    core::vec3d src_centroid(0, 0, 0), dst_centroid(0, 0, 0);
+    for (uint32_t i = 0; i < num_points; i++)
+    {
+        src_centroid += src_list[idx_list[i]];
+        dst_centroid += dst_list[idx_list[i]];
+    }
+    src_centroid /= double(num_points);
+    dst_centroid /= double(num_points);
+
+    // cross covariance s[a][b] = sum src_a * dst_b of the centered points.
+    double s[3][3] = {};
+    double src_variance = 0.0;
+    for (uint32_t i = 0; i < num_points; i++)
+    {
+        core::vec3d p = src_list[idx_list[i]] - src_centroid;
+        core::vec3d q = dst_list[idx_list[i]] - dst_centroid;
+        for (int a = 0; a < 3; a++)
+        {
+            for (int b = 0; b < 3; b++)
+            {
+                s[a][b] += p[a] * q[b];
+            }
+        }
+        src_variance += dot(p, p);
+    }
+
+    double n[4][4] =
+    {
+        { s[0][0] + s[1][1] + s[2][2], s[1][2] - s[2][1], s[2][0] - s[0][2], s[0][1] - s[1][0] },
+        { s[1][2] - s[2][1], s[0][0] - s[1][1] - s[2][2], s[0][1] + s[1][0], s[2][0] + s[0][2] },
+        { s[2][0] - s[0][2], s[0][1] + s[1][0], -s[0][0] + s[1][1] - s[2][2], s[1][2] + s[2][1] },
+        { s[0][1] - s[1][0], s[2][0] + s[0][2], s[1][2] + s[2][1], -s[0][0] - s[1][1] + s[2][2] },
+    };
+
+    double eigen_vectors[4][4], eigen_value_list[4];
+    SymmetricEigen<4>(n, eigen_vectors, eigen_value_list);
+
+    double w = eigen_vectors[0][0];
+    double x = eigen_vectors[1][0];
+    double y = eigen_vectors[2][0];
+    double z = eigen_vectors[3][0];
+    double rot[3][3] =
+    {
+        { 1.0 - 2.0 * (y * y + z * z), 2.0 * (x * y - w * z), 2.0 * (x * z + w * y) },
+        { 2.0 * (x * y + w * z), 1.0 - 2.0 * (x * x + z * z), 2.0 * (y * z - w * x) },
+        { 2.0 * (x * z - w * y), 2.0 * (y * z + w * x), 1.0 - 2.0 * (x * x + y * y) },
+    };
+
+    // umeyama's scale, trace(R^T * S^T) over the source variance.
+    scale = 1.0;
+    if (estimate_scale)
+    {
+        double trace = 0.0;
+        for (int a = 0; a < 3; a++)
+        {
+            for (int b = 0; b < 3; b++)
+            {
+                trace += rot[b][a] * s[a][b];
+            }
+        }
+
+        if (trace <= 0.0)
+        {
+            return false;
+        }
+        scale = trace / src_variance;
+    }
+
+    core::vec3d rotated_centroid(rot[0][0] * src_centroid.x + rot[0][1] * src_centroid.y + rot[0][2] * src_centroid.z,
+                                 rot[1][0] * src_centroid.x + rot[1][1] * src_centroid.y + rot[1][2] * src_centroid.z,
+                                 rot[2][0] * src_centroid.x + rot[2][1] * src_centroid.y + rot[2][2] * src_centroid.z);
+    core::vec3d translation = dst_centroid - rotated_centroid * scale;
+
+    transform = core::matrix4d();
+    for (int r = 0; r < 3; r++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            transform(r, c) = scale * rot[c][r];
+        }
+        transform(3, r) = translation[r];
+    }
+    return true;
+}
+
+core::vec3d TransformPoint(const core::vec3d& p, const core::matrix4d& transform)
+{
+    return core::vec3d(core::vec4d(p, 1.0) * transform);
+}
+
+// inliers under the threshold and the truncated squared residual sum that breaks ties.
+uint32_t ScoreTransform(const vector<core::vec3d>& src_list, const vector<core::vec3d>& dst_list,
+                        const core::matrix4d& transform, double threshold, double& cost)
+{
+    uint32_t num_inliers = 0;
+    double threshold_sq = threshold * threshold;
+    cost = 0.0;
+    for (uint32_t i = 0; i < src_list.size(); i++)
+    {
+        core::vec3d d = TransformPoint(src_list[i], transform) - dst_list[i];
+        double dist_sq = dot(d, d);
+        if (dist_sq <= threshold_sq)
+        {
+            num_inliers++;
+            cost += dist_sq;
+        }
+        else
+        {
+            cost += threshold_sq;
+        }
+    }
+    return num_inliers;
+}
+}
+
+bool EstimateSimilarityTransform(const vector<core::vec3d>& src_list, const vector<core::vec3d>& dst_list,
+                                 bool estimate_scale, core::matrix4d& transform, double* scale)
+{
+    uint32_t num_points = uint32_t(min(src_list.size(), dst_list.size()));
+    vector<uint32_t> idx_list(num_points);
+    for (uint32_t i = 0; i < num_points; i++)
+    {
+        idx_list[i] = i;
+    }
+
+    double fit_scale;
+    if (!FitSubset(src_list, dst_list, idx_list.data(), num_points, estimate_scale, transform, fit_scale))
+    {
+        return false;
+    }
+
+    if (scale)
+    {
+        *scale = fit_scale;
+    }
+    return true;
+}
+
+bool RegisterPoints(const PointCorrespondences& correspondences, const RegistrationOptions& options,
+                    RegistrationResult& result)
+{
+    result = RegistrationResult();
+
+    const auto& src_list = correspondences.src_list;
+    const auto& dst_list = correspondences.dst_list;
+    uint32_t num_points = uint32_t(src_list.size());
+    if (num_points < 3 || dst_list.size() != num_points)
+    {
+        return false;
+    }
+
+    // every triple when that is cheaper than the sampling budget.
+    uint64_t num_triples = uint64_t(num_points) * (num_points - 1) * (num_points - 2) / 6;
+    bool b_exhaustive = num_triples <= options.max_iterations;
+    uint64_t num_iterations = b_exhaustive ? num_triples : options.max_iterations;
+
+    mt19937 rng(options.random_seed);
+    uint32_t best_num_inliers = 0;
+    double best_cost = 0.0;
+    core::matrix4d best_transform;
+    bool b_found = false;
+
+    uint32_t sample[3] = { 0, 1, 2 };
+    for (uint64_t i_iter = 0; i_iter < num_iterations; i_iter++)
+    {
+        if (b_exhaustive)
+        {
+            if (i_iter > 0)
+            {
+                // next combination in lexicographic order.
+                int k = 2;
+                while (sample[k] == num_points - 3 + k)
+                {
+                    k--;
+                }
+                sample[k]++;
+                for (int j = k + 1; j < 3; j++)
+                {
+                    sample[j] = sample[j - 1] + 1;
+                }
+            }
+        }
+        else
+        {
+            sample[0] = rng() % num_points;
+            do { sample[1] = rng() % num_points; } while (sample[1] == sample[0]);
+            do { sample[2] = rng() % num_points; } while (sample[2] == sample[0] || sample[2] == sample[1]);
+        }
+
+        if (!IsSpreadEnough(dst_list.data(), sample, 3))
+        {
+            continue;
+        }
+
+        core::matrix4d transform;
+        double scale;
+        if (!FitSubset(src_list, dst_list, sample, 3, options.estimate_scale, transform, scale))
+        {
+            continue;
+        }
+
+        double cost;
+        uint32_t num_inliers = ScoreTransform(src_list, dst_list, transform, options.inlier_threshold, cost);
+        if (!b_found || num_inliers > best_num_inliers || (num_inliers == best_num_inliers && cost < best_cost))
+        {
+            b_found = true;
+            best_num_inliers = num_inliers;
+            best_cost = cost;
+            best_transform = transform;
+
+            if (!b_exhaustive && num_inliers > 3)
+            {
+                double inlier_ratio = double(num_inliers) / num_points;
+                double p_clean = inlier_ratio * inlier_ratio * inlier_ratio;
+                if (p_clean >= 1.0)
+                {
+                    num_iterations = i_iter + 1;
+                }
+                else
+                {
+                    double needed = log(1.0 - options.confidence) / log(1.0 - p_clean);
+                    num_iterations = min(num_iterations, uint64_t(ceil(needed)));
+                }
+            }
+        }
+    }
+
+    // refit on the inliers until the set settles.
+    double threshold_sq = options.inlier_threshold * options.inlier_threshold;
+    vector<uint32_t> inlier_idx_list;
+    core::matrix4d transform = best_transform;
+    double scale = 1.0;
+    for (uint32_t i_refine = 0; b_found && i_refine < 10; i_refine++)
+    {
+        vector<uint32_t> idx_list;
+        for (uint32_t i = 0; i < num_points; i++)
+        {
+            core::vec3d d = TransformPoint(src_list[i], transform) - dst_list[i];
+            if (dot(d, d) <= threshold_sq)
+            {
+                idx_list.push_back(i);
+            }
+        }
+
+        if (idx_list == inlier_idx_list)
+        {
+            break;
+        }
+
+        core::matrix4d refit_transform;
+        double refit_scale;
+        if (!FitSubset(src_list, dst_list, idx_list.data(), uint32_t(idx_list.size()), options.estimate_scale, refit_transform, refit_scale))
+        {
+            break;
+        }
+
+        inlier_idx_list = move(idx_list);
+        transform = refit_transform;
+        scale = refit_scale;
+    }
+
+    // the pairs are noisier than the threshold, one fit over all of them beats none.
+    bool b_least_squares = false;
+    if (inlier_idx_list.empty())
+    {
+        if (!options.least_squares_fallback ||
+            !EstimateSimilarityTransform(src_list, dst_list, options.estimate_scale, transform, &scale))
+        {
+            return false;
+        }
+        b_least_squares = true;
+    }
+
+    result.b_valid = true;
+    result.b_least_squares = b_least_squares;
+    result.transform = transform;
+    result.scale = scale;
+    result.residual_list.resize(num_points);
+    result.inlier_list.resize(num_points, 0);
+    double sum_sq = 0.0;
+    for (uint32_t i = 0; i < num_points; i++)
+    {
+        double residual = length(TransformPoint(src_list[i], transform) - dst_list[i]);
+        result.residual_list[i] = residual;
+        if (b_least_squares || residual <= options.inlier_threshold)
+        {
+            result.inlier_list[i] = 1;
+            result.num_inliers++;
+            sum_sq += residual * residual;
+        }
+    }
+    result.rms_error = result.num_inliers > 0 ? sqrt(sum_sq / result.num_inliers) : 0.0;
+
+    return true;
+}
@@ -0,0 +1,185 @@
+#include "boundsgrid.h"
+#include "meshdata.h"
+#include <gtest/gtest.h>
+#include <random>
+
+namespace
+{
+// what the grid replaces, every box tested against every other.
+void QueryAll(const vector<core::bounds2d>& bbox_list, const core::bounds2d& bbox, vector<uint32_t>& item_list)
+{
+    item_list.clear();
+    for (uint32_t i = 0; i < bbox_list.size(); i++)
+    {
+        if ((bbox ^ bbox_list[i]).b_valid)
+        {
+            item_list.push_back(i);
+        }
+    }
+}
+
+core::bounds2d MakeBounds(double x0, double y0, double x1, double y1)
+{
+    core::bounds2d bbox;
+    bbox += core::vec2d(x0, y0);
+    bbox += core::vec2d(x1, y1);
+    return bbox;
+}
+
+//
+// boxes on a coarse lattice so that many share edges and corners exactly, sit exactly on
+// cell borders, or are flat; a few are huge, invalid or far away.
+//
+core::bounds2d CreateRandomBounds(mt19937& rng, double lattice)
+{
+    uniform_int_distribution<int32_t> kind(0, 19);
+    uniform_int_distribution<int32_t> coord(-40, 40);
+    uniform_int_distribution<int32_t> extent(0, 12);
+    uniform_real_distribution<double> jitter(-0.5, 0.5);
+    switch (kind(rng))
+    {
+    case 0:
+        return core::bounds2d();
+    case 1:
+        return MakeBounds(-1e4 * lattice, -1e4 * lattice, 1e4 * lattice, coord(rng) * lattice);
+    case 2:
+        return MakeBounds(1e7 * lattice, 1e7 * lattice, 1e7 * lattice + lattice, 1e7 * lattice + lattice);
+    case 3:
+    case 4:
+    case 5:
+    {
+        double x = (coord(rng) + jitter(rng)) * lattice, y = (coord(rng) + jitter(rng)) * lattice;
+        return MakeBounds(x, y, x + (extent(rng) + jitter(rng) + 0.5) * lattice, y + (extent(rng) + jitter(rng) + 0.5) * lattice);
+    }
+    default:
+    {
+        double x = coord(rng) * lattice, y = coord(rng) * lattice;
+        return MakeBounds(x, y, x + extent(rng) * lattice, y + extent(rng) * lattice);
+    }
+    }
+}
+
+TEST(BoundsGridIndexTest, QueriesMatchTheNestedLoops)
+{
+    mt19937 rng(42);
+    // cells smaller, equal to and larger than the lattice, and ones the lattice doesn't divide.
+    for (double cell_size : { 0.25, 1.0, 3.0, 0.7, 17.3 })
+    {
+        for (int32_t round = 0; round < 20; round++)
+        {
+            BoundsGridIndex index(cell_size);
+            vector<core::bounds2d> bbox_list;
+            vector<uint32_t> expected, actual;
+            int32_t num_items = 1 + int32_t(rng() % 300);
+            for (int32_t i = 0; i < num_items; i++)
+            {
+                bbox_list.push_back(CreateRandomBounds(rng, 1.0));
+                ASSERT_EQ(index.add(bbox_list.back()), uint32_t(i));
+
+                // boxes added between queries are found by the next one.
+                if (i % 50 == 0)
+                {
+                    core::bounds2d bbox = CreateRandomBounds(rng, 1.0);
+                    QueryAll(bbox_list, bbox, expected);
+                    index.query(bbox, actual);
+                    ASSERT_EQ(actual, expected) << "cell size " << cell_size << " after " << i + 1 << " boxes";
+                }
+            }
+            ASSERT_EQ(index.get_num_items(), bbox_list.size());
+
+            for (int32_t q = 0; q < 200; q++)
+            {
+                core::bounds2d bbox = CreateRandomBounds(rng, 1.0);
+                QueryAll(bbox_list, bbox, expected);
+                index.query(bbox, actual);
+                ASSERT_EQ(actual, expected) << "cell size " << cell_size << " query " << bbox.bb_min.x << ", " << bbox.bb_min.y
+                                            << " - " << bbox.bb_max.x << ", " << bbox.bb_max.y;
+            }
+
+            // every stored box finds itself if it has an area.
+            for (uint32_t i = 0; i < bbox_list.size(); i++)
+            {
+                QueryAll(bbox_list, bbox_list[i], expected);
+                index.query(bbox_list[i], actual);
+                ASSERT_EQ(actual, expected) << "box " << i;
+            }
+        }
+    }
+}
+
+TEST(BoundsGridIndexTest, TouchingBoxesDoNotOverlap)
+{
+    BoundsGridIndex index(1.0);
+    index.add(MakeBounds(0.0, 0.0, 1.0, 1.0));
+    index.add(MakeBounds(1.0, 0.0, 2.0, 1.0));      // shares an edge on a cell border
+    index.add(MakeBounds(1.0, 1.0, 2.0, 2.0));      // shares a corner
+    index.add(MakeBounds(0.5, 0.5, 0.5, 3.0));      // flat
+
+    vector<uint32_t> item_list;
+    index.query(MakeBounds(0.0, 0.0, 1.0, 1.0), item_list);
+    EXPECT_EQ(item_list, vector<uint32_t>({ 0 }));
+    index.query(MakeBounds(0.99, 0.99, 1.01, 1.01), item_list);
+    EXPECT_EQ(item_list, vector<uint32_t>({ 0, 1, 2 }));
+    index.query(MakeBounds(0.5, 0.5, 0.5, 0.5), item_list);
+    EXPECT_TRUE(item_list.empty());
+
+    index.clear();
+    index.query(MakeBounds(0.0, 0.0, 1.0, 1.0), item_list);
+    EXPECT_TRUE(item_list.empty());
+    EXPECT_EQ(index.get_num_items(), 0u);
+}
+
+void ExpectSameList(const unique_ptr<uint32_t[]>& idx_list, const vector<uint32_t>& expected, const string& name)
+{
+    if (expected.empty())
+    {
+        EXPECT_EQ(idx_list, nullptr) << name;
+        return;
+    }
+    ASSERT_NE(idx_list, nullptr) << name;
+    for (size_t i = 0; i < expected.size(); i++)
+    {
+        ASSERT_EQ(idx_list[i], expected[i]) << name << " entry " << i;
+    }
+}
+
+TEST(BoundsGridIndexTest, PatchesCuttingMatchesTheNestedLoops)
+{
+    mt19937 rng(7);
+    for (int32_t round = 0; round < 30; round++)
+    {
+        // degrees sized boxes, the lattice makes patches, maps and textures share borders.
+        double lattice = round % 2 ? 0.01 : 1.0 / 3.0;
+        vector<core::bounds2d> patch_list, map_list, tex_list;
+        for (uint32_t i = rng() % 200; i > 0; i--)
+        {
+            patch_list.push_back(CreateRandomBounds(rng, lattice));
+        }
+        for (uint32_t i = rng() % 100; i > 0; i--)
+        {
+            map_list.push_back(CreateRandomBounds(rng, lattice));
+        }
+        for (uint32_t i = rng() % 400; i > 0; i--)
+        {
+            tex_list.push_back(CreateRandomBounds(rng, lattice));
+        }
+
+        // the results are appended after what the list already holds.
+        vector<PatchInfo> patch_info_list(3);
+        PatchesCutting(patch_list, map_list, tex_list, patch_info_list);
+        ASSERT_EQ(patch_info_list.size(), patch_list.size() + 3);
+
+        vector<uint32_t> expected;
+        for (uint32_t i = 0; i < patch_list.size(); i++)
+        {
+            const PatchInfo& patch_info = patch_info_list[i + 3];
+            string name = "round " + to_string(round) + " patch " + to_string(i);
+            EXPECT_EQ(patch_info.bbox.b_valid, patch_list[i].b_valid) << name;
+            QueryAll(map_list, patch_list[i], expected);
+            ExpectSameList(patch_info.map_idx_list, expected, name + " maps");
+            QueryAll(tex_list, patch_list[i], expected);
+            ExpectSameList(patch_info.tex_idx_list, expected, name + " textures");
+        }
+    }
+}
+}
@@ -0,0 +1,303 @@
+#include "coreblockcodec.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+namespace
+{
+//
+// reference decoders written from the format specifications, they share no code with
+// coreblockcodec.cpp so an encoder and decoder agreeing on a wrong layout still fails.
+//
+uint64_t ReadLittleEndian64(const uint8_t* data)
+{
+    uint64_t value = 0;
+    for (int32_t i = 7; i >= 0; i--)
+    {
+        value = (value << 8) | data[i];
+    }
+    return value;
+}
+
+uint8_t Interpolate(uint32_t e0, uint32_t e1, uint32_t numerator, uint32_t denominator)
+{
+    return uint8_t(floor((double(e0) * (denominator - numerator) + double(e1) * numerator) / denominator + 0.5));
+}
+
+void ReferenceDecodeColor(const uint8_t* block, bool force_four_color, uint8_t texels[16][4])
+{
+    uint64_t bits = ReadLittleEndian64(block);
+    uint32_t c[2] = { uint32_t(bits & 0xffff), uint32_t((bits >> 16) & 0xffff) };
+
+    uint8_t palette[4][4];
+    for (int32_t i = 0; i < 2; i++)
+    {
+        uint32_t r = c[i] >> 11, g = (c[i] >> 5) & 63, b = c[i] & 31;
+        palette[i][0] = uint8_t(r * 255 / 31.0 + 0.5);
+        palette[i][1] = uint8_t(g * 255 / 63.0 + 0.5);
+        palette[i][2] = uint8_t(b * 255 / 31.0 + 0.5);
+        palette[i][3] = 255;
+    }
+    bool four_color = force_four_color || c[0] > c[1];
+    for (int32_t k = 0; k < 4; k++)
+    {
+        palette[2][k] = four_color ? Interpolate(palette[0][k], palette[1][k], 1, 3) : Interpolate(palette[0][k], palette[1][k], 1, 2);
+        palette[3][k] = four_color ? Interpolate(palette[0][k], palette[1][k], 2, 3) : 0;
+    }
+
+    for (int32_t i = 0; i < 16; i++)
+    {
+        memcpy(texels[i], palette[(bits >> (32 + 2 * i)) & 3], 4);
+    }
+}
+
+void ReferenceDecodeChannel(const uint8_t* block, uint8_t texels[16][4], int32_t channel)
+{
+    uint64_t bits = ReadLittleEndian64(block);
+    uint32_t a0 = uint32_t(bits & 0xff), a1 = uint32_t((bits >> 8) & 0xff);
+
+    uint8_t palette[8] = { uint8_t(a0), uint8_t(a1) };
+    for (uint32_t i = 1; i < 7; i++)
+    {
+        if (a0 > a1)
+        {
+            palette[i + 1] = Interpolate(a0, a1, i, 7);
+        }
+        else if (i < 5)
+        {
+            palette[i + 1] = Interpolate(a0, a1, i, 5);
+        }
+    }
+    if (a0 <= a1)
+    {
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+
+    for (int32_t i = 0; i < 16; i++)
+    {
+        texels[i][channel] = palette[(bits >> (16 + 3 * i)) & 7];
+    }
+}
+
+// mode 6 is the only bc7 mode the encoder writes, anything else is a failure here.
+bool ReferenceDecodeBc7(const uint8_t* block, uint8_t texels[16][4])
+{
+    uint64_t lo = ReadLittleEndian64(block);
+    uint64_t hi = ReadLittleEndian64(block + 8);
+    uint32_t offset = 0;
+    auto read = [&](uint32_t count)
+    {
+        uint32_t value = 0;
+        for (uint32_t i = 0; i < count; i++, offset++)
+        {
+            uint64_t word = offset < 64 ? lo : hi;
+            value |= uint32_t((word >> (offset & 63)) & 1) << i;
+        }
+        return value;
+    };
+
+    if (read(7) != 0x40)
+    {
+        return false;
+    }
+
+    uint32_t endpoint[2][4];
+    for (int32_t k = 0; k < 4; k++)
+    {
+        endpoint[0][k] = read(7);
+        endpoint[1][k] = read(7);
+    }
+    uint32_t p_bit[2] = { read(1), read(1) };
+    for (int32_t k = 0; k < 4; k++)
+    {
+        endpoint[0][k] = (endpoint[0][k] << 1) | p_bit[0];
+        endpoint[1][k] = (endpoint[1][k] << 1) | p_bit[1];
+    }
+
+    static const uint32_t weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+    for (int32_t i = 0; i < 16; i++)
+    {
+        // the anchor index drops its implicit top bit.
+        uint32_t weight = weights[read(i == 0 ? 3 : 4)];
+        for (int32_t k = 0; k < 4; k++)
+        {
+            texels[i][k] = uint8_t((endpoint[0][k] * (64 - weight) + endpoint[1][k] * weight + 32) >> 6);
+        }
+    }
+    return offset == 128;
+}
+
+bool ReferenceDecode(const uint8_t* blocks, uint32_t w, uint32_t h, core::BlockFormat format, vector<uint8_t>& rgba_data)
+{
+    uint32_t block_size = format == core::kBlockFormatBc1 || format == core::kBlockFormatBc4 ? 8 : 16;
+    rgba_data.assign(size_t(w) * h * 4, 0);
+    for (uint32_t b_y = 0; b_y < (h + 3) / 4; b_y++)
+    {
+        for (uint32_t b_x = 0; b_x < (w + 3) / 4; b_x++, blocks += block_size)
+        {
+            uint8_t texels[16][4] = {};
+            switch (format)
+            {
+            case core::kBlockFormatBc1:
+                ReferenceDecodeColor(blocks, false, texels);
+                break;
+            case core::kBlockFormatBc3:
+                ReferenceDecodeColor(blocks + 8, true, texels);
+                ReferenceDecodeChannel(blocks, texels, 3);
+                break;
+            case core::kBlockFormatBc4:
+            case core::kBlockFormatBc5:
+                ReferenceDecodeChannel(blocks, texels, 0);
+                if (format == core::kBlockFormatBc5)
+                {
+                    ReferenceDecodeChannel(blocks + 8, texels, 1);
+                }
+                for (auto& texel : texels)
+                {
+                    texel[3] = 255;
+                }
+                break;
+            case core::kBlockFormatBc7:
+                if (!ReferenceDecodeBc7(blocks, texels))
+                {
+                    return false;
+                }
+                break;
+            }
+
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                uint32_t x = b_x * 4 + i % 4, y = b_y * 4 + i / 4;
+                if (x < w && y < h)
+                {
+                    memcpy(&rgba_data[(size_t(y) * w + x) * 4], texels[i], 4);
+                }
+            }
+        }
+    }
+    return true;
+}
+
+uint32_t GetNumStoredChannels(core::BlockFormat format)
+{
+    return format == core::kBlockFormatBc4 ? 1 : (format == core::kBlockFormatBc5 ? 2 : (format == core::kBlockFormatBc1 ? 3 : 4));
+}
+
+double ComputePsnr(const vector<uint8_t>& a, const vector<uint8_t>& b, uint32_t num_channels)
+{
+    double sum = 0.0;
+    size_t count = 0;
+    for (size_t i = 0; i < a.size(); i += 4)
+    {
+        for (uint32_t k = 0; k < num_channels; k++, count++)
+        {
+            double d = double(a[i + k]) - double(b[i + k]);
+            sum += d * d;
+        }
+    }
+    double mse = sum / double(count);
+    return mse == 0.0 ? 100.0 : 10.0 * log10(255.0 * 255.0 / mse);
+}
+
+// smooth gradients with some noise, the content terrain and building textures have.
+vector<uint8_t> CreateTestImage(uint32_t w, uint32_t h, uint32_t seed)
+{
+    mt19937 rng(seed);
+    normal_distribution<float> noise(0.0f, 3.0f);
+    vector<uint8_t> rgba_data(size_t(w) * h * 4);
+    for (uint32_t y = 0; y < h; y++)
+    {
+        for (uint32_t x = 0; x < w; x++)
+        {
+            float u = float(x) / w, v = float(y) / h;
+            float value[4] = { 255.0f * u, 128.0f + 100.0f * sinf(6.0f * v), 255.0f * (1.0f - u) * v, 200.0f * v + 40.0f * u };
+            for (int32_t k = 0; k < 4; k++)
+            {
+                rgba_data[(size_t(y) * w + x) * 4 + k] = uint8_t(min(max(value[k] + noise(rng), 0.0f), 255.0f));
+            }
+        }
+    }
+    return rgba_data;
+}
+
+struct BlockCodecParam
+{
+    core::BlockFormat   format;
+    double              min_psnr;   // over the stored channels of the test image
+};
+
+class BlockCodecTest : public ::testing::TestWithParam<BlockCodecParam>
+{
+};
+
+TEST_P(BlockCodecTest, RoundTripThroughReferenceDecoder)
+{
+    const BlockCodecParam& param = GetParam();
+    // partial edge blocks on the second size.
+    const uint32_t sizes[][2] = { { 64, 64 }, { 37, 29 } };
+    for (const auto& size : sizes)
+    {
+        uint32_t w = size[0], h = size[1];
+        vector<uint8_t> rgba_data = CreateTestImage(w, h, w * 1000 + h);
+
+        vector<uint8_t> blocks(((w + 3) / 4) * ((h + 3) / 4) * core::GetBlockFormatSize(param.format));
+        core::CompressBlockImage(rgba_data.data(), w, h, param.format, blocks.data());
+
+        vector<uint8_t> reference;
+        ASSERT_TRUE(ReferenceDecode(blocks.data(), w, h, param.format, reference)) << w << " x " << h;
+        double psnr = ComputePsnr(rgba_data, reference, GetNumStoredChannels(param.format));
+        // the narrower image has steeper gradients per block.
+        EXPECT_GE(psnr, w == 64 ? param.min_psnr : param.min_psnr - 4.0) << w << " x " << h;
+
+        // the codec's own decoder agrees with the reference up to interpolation rounding.
+        vector<uint8_t> decoded(rgba_data.size());
+        ASSERT_TRUE(core::DecompressBlockImage(blocks.data(), w, h, param.format, decoded.data()));
+        for (size_t i = 0; i < decoded.size(); i++)
+        {
+            ASSERT_LE(abs(int32_t(decoded[i]) - int32_t(reference[i])), 1) << "byte " << i << " of " << w << " x " << h;
+        }
+        EXPECT_NEAR(core::ComputeBlockPsnr(rgba_data.data(), w, h, param.format, blocks.data()),
+                    ComputePsnr(rgba_data, decoded, GetNumStoredChannels(param.format)), 1e-3);
+    }
+}
+
+TEST_P(BlockCodecTest, ConstantBlocksKeepTheirColor)
+{
+    const BlockCodecParam& param = GetParam();
+    mt19937 rng(7);
+    uniform_int_distribution<uint32_t> value(0, 255);
+    int32_t max_error = 0;
+    for (int32_t n = 0; n < 256; n++)
+    {
+        vector<uint8_t> rgba_data(64);
+        uint8_t color[4] = { uint8_t(value(rng)), uint8_t(value(rng)), uint8_t(value(rng)), uint8_t(value(rng)) };
+        for (size_t i = 0; i < rgba_data.size(); i++)
+        {
+            rgba_data[i] = color[i % 4];
+        }
+
+        vector<uint8_t> blocks(core::GetBlockFormatSize(param.format));
+        core::CompressBlockImage(rgba_data.data(), 4, 4, param.format, blocks.data());
+        vector<uint8_t> reference;
+        ASSERT_TRUE(ReferenceDecode(blocks.data(), 4, 4, param.format, reference));
+        for (size_t i = 0; i < reference.size(); i++)
+        {
+            if (i % 4 < GetNumStoredChannels(param.format))
+            {
+                max_error = max(max_error, abs(int32_t(reference[i]) - int32_t(rgba_data[i])));
+            }
+        }
+    }
+    // the encoder truncates a constant color to 565, one 5 bit step less one.
+    EXPECT_LE(max_error, param.format == core::kBlockFormatBc1 || param.format == core::kBlockFormatBc3 ? 7 : 1);
+}
+
+INSTANTIATE_TEST_CASE_P(Formats, BlockCodecTest, ::testing::Values(
+    BlockCodecParam{ core::kBlockFormatBc1, 31.0 },
+    BlockCodecParam{ core::kBlockFormatBc3, 32.0 },
+    BlockCodecParam{ core::kBlockFormatBc4, 46.0 },
+    BlockCodecParam{ core::kBlockFormatBc5, 45.0 },
+    BlockCodecParam{ core::kBlockFormatBc7, 36.0 }));
+}
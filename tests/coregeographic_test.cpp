@@ -0,0 +1,261 @@
+#include "coregeographic.h"
+#include "GeographicLib/TransverseMercator.hpp"
+#include "GeographicLib/UTMUPS.hpp"
+#include <gtest/gtest.h>
+#include <random>
+
+namespace
+{
+struct ReferenceUndulation
+{
+    double      lat;
+    double      lon;
+    double      undulation;
+};
+
+// the test points nga publishes with egm96 (intpt.dat / outintpt.dat).
+const ReferenceUndulation kEgm96References[] =
+{
+    {  38.6281550, 269.7791550, -31.628 },
+    { -14.6212170, 305.0211140,  -2.969 },
+    {  46.8743190, 102.4487290, -43.575 },
+    { -23.6174460, 133.8747120,  15.871 },
+    {  38.6254730, 359.9995000,  50.066 },
+    {  -0.4667440,   0.0023000,  17.329 },
+};
+
+// nga interpolates its 15' grid, the 5' grid with cubic interpolation agrees to a few cm.
+constexpr double kEgm96Tolerance = 0.05;
+
+// the projector evaluates the same 6th order series as geographiclib, both are good to
+// a few nanometers. ten nanometers still catches a series cut off after the 4th order.
+constexpr double kUtmTolerance = 1e-8;
+constexpr double kUtmAngleTolerance = 1e-12;
+
+// the grid is large and installed separately, the tests needing it pass without it.
+// gtest before 1.10 has no skipping, the test returns early and passes instead.
+#ifndef GTEST_SKIP
+#define GTEST_SKIP() return GTEST_MESSAGE_("Skipped", ::testing::TestPartResult::kSuccess)
+#endif
+
+TEST(GeoidModelTest, WithoutGridHeightsAreUnchanged)
+{
+    core::GeoidModel geoid_model;
+    EXPECT_FALSE(geoid_model.is_valid());
+    EXPECT_EQ(geoid_model.undulation(38.0, -122.0), 0.0);
+
+    core::GpsCoord coord(-122.0, 38.0, 120.0);
+    geoid_model.orthometric_to_ellipsoidal(&coord, 1);
+    EXPECT_EQ(coord.alt, 120.0);
+}
+
+TEST(GeoidModelTest, Egm96ReferenceUndulations)
+{
+    core::GeoidModel geoid_model;
+    if (!geoid_model.load("egm96-5"))
+    {
+        GTEST_SKIP() << "egm96-5 geoid grid not installed";
+    }
+
+    for (const auto& reference : kEgm96References)
+    {
+        EXPECT_NEAR(geoid_model.undulation(reference.lat, reference.lon), reference.undulation, kEgm96Tolerance)
+            << "lat " << reference.lat << " lon " << reference.lon;
+    }
+}
+
+TEST(GeoidModelTest, BatchedConversionsMatchUndulation)
+{
+    core::GeoidModel geoid_model;
+    if (!geoid_model.load("egm96-5"))
+    {
+        GTEST_SKIP() << "egm96-5 geoid grid not installed";
+    }
+
+    // more than one batch, so the parallel split is covered.
+    vector<core::GpsCoord> coords;
+    for (int32_t i = 0; i < 10000; i++)
+    {
+        coords.push_back(core::GpsCoord(-180.0 + 0.0719 * i, -80.0 + 160.0 * i / 10000.0, 100.0));
+    }
+
+    vector<double> undulations(coords.size());
+    geoid_model.undulations(coords.data(), undulations.data(), coords.size());
+
+    vector<core::GpsCoord> ellipsoidal = coords;
+    geoid_model.orthometric_to_ellipsoidal(ellipsoidal.data(), ellipsoidal.size());
+    vector<core::GpsCoord> orthometric = ellipsoidal;
+    geoid_model.ellipsoidal_to_orthometric(orthometric.data(), orthometric.size());
+
+    for (size_t i = 0; i < coords.size(); i++)
+    {
+        EXPECT_EQ(undulations[i], geoid_model.undulation(coords[i].lat, coords[i].lon));
+        EXPECT_DOUBLE_EQ(ellipsoidal[i].alt, 100.0 + undulations[i]);
+        EXPECT_NEAR(orthometric[i].alt, 100.0, 1e-9);
+    }
+}
+
+// utm without geographiclib's range checks, which reject points well outside the zone.
+core::vec2d GeographicLibUtm(double lat, double lon, int32_t zone, bool northp)
+{
+    core::vec2d utm_loc;
+    GeographicLib::TransverseMercator::UTM().Forward(zone * 6.0 - 183.0, lat, lon, utm_loc.x, utm_loc.y);
+    return core::vec2d(utm_loc.x + 500000.0, utm_loc.y + (northp ? 0.0 : 10000000.0));
+}
+
+TEST(UTMProjectorTest, ForwardMatchesGeographicLibInEveryZone)
+{
+    core::UTMProjector projector;
+    mt19937 rng(30);
+    uniform_real_distribution<double> lat(-80.0, 84.0), lon_ofs(-3.0, 3.0);
+    for (int32_t zone = 1; zone <= 60; zone++)
+    {
+        for (int32_t i = 0; i < 500; i++)
+        {
+            double gps_lat = lat(rng);
+            double gps_lon = zone * 6.0 - 183.0 + lon_ofs(rng);
+            int32_t ref_zone;
+            bool ref_northp;
+            core::vec2d ref;
+            GeographicLib::UTMUPS::Forward(gps_lat, gps_lon, ref_zone, ref_northp, ref.x, ref.y, zone);
+            ASSERT_EQ(ref_zone, zone);
+
+            core::vec2d utm_loc = projector.forward(core::vec2d(gps_lat, gps_lon), zone, ref_northp);
+            ASSERT_NEAR(utm_loc.x, ref.x, kUtmTolerance) << "zone " << zone << " at " << gps_lat << ", " << gps_lon;
+            ASSERT_NEAR(utm_loc.y, ref.y, kUtmTolerance) << "zone " << zone << " at " << gps_lat << ", " << gps_lon;
+        }
+    }
+}
+
+TEST(UTMProjectorTest, ForwardMatchesGeographicLibAcrossZoneEdges)
+{
+    // a batch straddling an edge is projected into one zone, up to a few zones away.
+    core::UTMProjector projector;
+    mt19937 rng(31);
+    uniform_real_distribution<double> lat(-80.0, 84.0), lon_ofs(-8.0, 8.0);
+    for (int32_t zone = 1; zone <= 60; zone++)
+    {
+        double edges[] = { zone * 6.0 - 186.0, zone * 6.0 - 180.0 };
+        for (int32_t i = 0; i < 500; i++)
+        {
+            double gps_lat = lat(rng);
+            double gps_lon = i < 20 ? edges[i & 1] : zone * 6.0 - 183.0 + lon_ofs(rng);
+            bool northp = gps_lat >= 0.0;
+            core::vec2d ref = GeographicLibUtm(gps_lat, gps_lon, zone, northp);
+            core::vec2d utm_loc = projector.forward(core::vec2d(gps_lat, gps_lon), zone, northp);
+            ASSERT_NEAR(utm_loc.x, ref.x, kUtmTolerance) << "zone " << zone << " at " << gps_lat << ", " << gps_lon;
+            ASSERT_NEAR(utm_loc.y, ref.y, kUtmTolerance) << "zone " << zone << " at " << gps_lat << ", " << gps_lon;
+        }
+    }
+}
+
+TEST(UTMProjectorTest, ReverseMatchesGeographicLib)
+{
+    core::UTMProjector projector;
+    mt19937 rng(32);
+    uniform_real_distribution<double> lat(-80.0, 84.0), lon_ofs(-5.0, 5.0);
+    for (int32_t i = 0; i < 20000; i++)
+    {
+        int32_t zone = 1 + i % 60;
+        double lon0 = zone * 6.0 - 183.0;
+        double gps_lat = lat(rng);
+        bool northp = gps_lat >= 0.0;
+        core::vec2d utm_loc = GeographicLibUtm(gps_lat, lon0 + lon_ofs(rng), zone, northp);
+
+        core::vec2d ref;
+        GeographicLib::TransverseMercator::UTM().Reverse(lon0, utm_loc.x - 500000.0, utm_loc.y - (northp ? 0.0 : 10000000.0), ref.x, ref.y);
+        core::vec2d gps_loc = projector.reverse(utm_loc, zone, northp);
+        ASSERT_NEAR(gps_loc.x, ref.x, kUtmAngleTolerance) << "zone " << zone << " at " << utm_loc.x << ", " << utm_loc.y;
+        ASSERT_NEAR(gps_loc.y, ref.y, kUtmAngleTolerance) << "zone " << zone << " at " << utm_loc.x << ", " << utm_loc.y;
+    }
+}
+
+TEST(UTMProjectorTest, UpsMatchesGeographicLibAtThePoles)
+{
+    core::UTMProjector projector;
+    mt19937 rng(33);
+    uniform_real_distribution<double> north_lat(84.0, 90.0), south_lat(-90.0, -80.0), lon(-180.0, 180.0);
+    for (int32_t i = 0; i < 20000; i++)
+    {
+        bool northp = (i & 1) == 0;
+        // both poles themselves, where the longitude does not matter.
+        double gps_lat = i < 16 ? (northp ? 90.0 : -90.0) : (northp ? north_lat(rng) : south_lat(rng));
+        double gps_lon = lon(rng);
+
+        int32_t ref_zone;
+        bool ref_northp;
+        core::vec2d ref;
+        GeographicLib::UTMUPS::Forward(gps_lat, gps_lon, ref_zone, ref_northp, ref.x, ref.y, GeographicLib::UTMUPS::UPS);
+        ASSERT_EQ(ref_zone, core::UTMProjector::kUpsZone);
+        ASSERT_EQ(ref_northp, northp);
+
+        core::vec2d utm_loc = projector.forward(core::vec2d(gps_lat, gps_lon), core::UTMProjector::kUpsZone, northp);
+        ASSERT_NEAR(utm_loc.x, ref.x, kUtmTolerance) << gps_lat << ", " << gps_lon;
+        ASSERT_NEAR(utm_loc.y, ref.y, kUtmTolerance) << gps_lat << ", " << gps_lon;
+
+        // the longitude of a point next to the pole is ill conditioned, compare the
+        // latitude and where geographiclib puts the reversed point instead.
+        core::vec2d gps_loc = projector.reverse(utm_loc, core::UTMProjector::kUpsZone, northp);
+        ASSERT_NEAR(gps_loc.x, gps_lat, kUtmAngleTolerance) << gps_lat << ", " << gps_lon;
+        core::vec2d back;
+        GeographicLib::UTMUPS::Forward(gps_loc.x, gps_loc.y, ref_zone, ref_northp, back.x, back.y, GeographicLib::UTMUPS::UPS);
+        ASSERT_NEAR(back.x, utm_loc.x, kUtmTolerance) << gps_lat << ", " << gps_lon;
+        ASSERT_NEAR(back.y, utm_loc.y, kUtmTolerance) << gps_lat << ", " << gps_lon;
+    }
+}
+
+TEST(UTMProjectorTest, StandardZonesMatchGeographicLib)
+{
+    // every band and zone edge, the norway and svalbard exceptions, the ups caps and the
+    // antimeridian, each hit exactly and from both sides.
+    vector<double> lat_list, lon_list;
+    for (double lat = -90.0; lat <= 90.0; lat += 4.0)
+    {
+        lat_list.push_back(lat);
+    }
+    for (double lat : { -80.0, 0.0, 56.0, 64.0, 72.0, 84.0 })
+    {
+        lat_list.insert(lat_list.end(), { lat - 1e-9, lat, lat + 1e-9 });
+    }
+    for (double lon = -186.0; lon <= 186.0; lon += 3.0)
+    {
+        lon_list.insert(lon_list.end(), { lon - 1e-9, lon, lon + 1e-9, lon + 1.5 });
+    }
+
+    for (double lat : lat_list)
+    {
+        for (double lon : lon_list)
+        {
+            EXPECT_EQ(core::UTMProjector::standard_zone(lat, lon), GeographicLib::UTMUPS::StandardZone(lat, lon))
+                << lat << ", " << lon;
+        }
+    }
+}
+
+TEST(UTMProjectorTest, BatchesMatchSinglePoints)
+{
+    // a batch over the edge of zones 10 and 11, mostly in 11, and enough points to be split.
+    core::UTMProjector projector;
+    vector<core::vec2d> gps_list;
+    for (int32_t i = 0; i < 100000; i++)
+    {
+        gps_list.push_back(core::vec2d(37.0 + i * 1e-5, -120.5 + i * 2e-5));
+    }
+
+    bool northp = false;
+    vector<core::vec2d> utm_list(gps_list.size());
+    int32_t zone = projector.forward(gps_list.data(), utm_list.data(), gps_list.size(), core::UTMProjector::kAutoZone, northp);
+    EXPECT_EQ(zone, 11);
+    EXPECT_TRUE(northp);
+
+    vector<core::vec2d> back_list(gps_list.size());
+    projector.reverse(utm_list.data(), back_list.data(), utm_list.size(), zone, northp);
+    for (size_t i = 0; i < gps_list.size(); i++)
+    {
+        ASSERT_EQ(utm_list[i], projector.forward(gps_list[i], zone, northp)) << i;
+        ASSERT_EQ(back_list[i], projector.reverse(utm_list[i], zone, northp)) << i;
+        ASSERT_NEAR(back_list[i].x, gps_list[i].x, kUtmAngleTolerance) << i;
+        ASSERT_NEAR(back_list[i].y, gps_list[i].y, kUtmAngleTolerance) << i;
+    }
+}
+}
@@ -0,0 +1,260 @@
+#include "corepng.h"
+#include <gtest/gtest.h>
+#include <cstring>
+#include <random>
+#include "zlib.h"
+
+namespace
+{
+struct DecodedPng
+{
+    uint32_t        w = 0;
+    uint32_t        h = 0;
+    uint32_t        bit_depth = 0;
+    uint32_t        color_type = 0;
+    vector<uint8_t> pixels;     // unfiltered rows in png sample order, 16 bit big endian
+};
+
+uint32_t ReadBigEndian32(const uint8_t* data)
+{
+    return (uint32_t(data[0]) << 24) | (uint32_t(data[1]) << 16) | (uint32_t(data[2]) << 8) | data[3];
+}
+
+//
+// a png reader written from the specification, only zlib's inflate is shared with the
+// encoder. chunk crcs, the chunk order and every filter type are checked on the way.
+//
+bool DecodePng(const vector<uint8_t>& png_data, DecodedPng& result)
+{
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', 0x0d, 0x0a, 0x1a, 0x0a };
+    if (png_data.size() < 8 || memcmp(png_data.data(), signature, 8) != 0)
+    {
+        return false;
+    }
+
+    vector<uint8_t> idat;
+    bool has_header = false, has_end = false;
+    for (size_t ofs = 8; ofs < png_data.size() && !has_end;)
+    {
+        if (ofs + 12 > png_data.size())
+        {
+            return false;
+        }
+        uint32_t size = ReadBigEndian32(&png_data[ofs]);
+        if (ofs + 12 + size > png_data.size())
+        {
+            return false;
+        }
+        const uint8_t* type = &png_data[ofs + 4];
+        const uint8_t* data = &png_data[ofs + 8];
+        if (uint32_t(crc32(0, type, size + 4)) != ReadBigEndian32(data + size))
+        {
+            return false;
+        }
+
+        if (memcmp(type, "IHDR", 4) == 0)
+        {
+            if (has_header || size != 13 || data[10] != 0 || data[11] != 0 || data[12] != 0)
+            {
+                return false;
+            }
+            result.w = ReadBigEndian32(data);
+            result.h = ReadBigEndian32(data + 4);
+            result.bit_depth = data[8];
+            result.color_type = data[9];
+            has_header = true;
+        }
+        else if (memcmp(type, "IDAT", 4) == 0)
+        {
+            if (!has_header)
+            {
+                return false;
+            }
+            idat.insert(idat.end(), data, data + size);
+        }
+        else if (memcmp(type, "IEND", 4) == 0)
+        {
+            has_end = ofs + 12 + size == png_data.size();
+        }
+        ofs += 12 + size;
+    }
+    if (!has_header || !has_end)
+    {
+        return false;
+    }
+
+    uint32_t channel_count = 0;
+    switch (result.color_type)
+    {
+    case 0: channel_count = 1; break;
+    case 4: channel_count = 2; break;
+    case 2: channel_count = 3; break;
+    case 6: channel_count = 4; break;
+    default: return false;
+    }
+    uint32_t bpp = channel_count * result.bit_depth / 8;
+    size_t row_bytes = size_t(result.w) * bpp;
+
+    // one filter byte per row, inflate has to end exactly on the stream end.
+    vector<uint8_t> filtered(result.h * (row_bytes + 1));
+    uLongf filtered_size = uLongf(filtered.size());
+    if (uncompress(filtered.data(), &filtered_size, idat.data(), uLong(idat.size())) != Z_OK || filtered_size != filtered.size())
+    {
+        return false;
+    }
+
+    result.pixels.assign(result.h * row_bytes, 0);
+    vector<uint8_t> zero_row(row_bytes, 0);
+    for (uint32_t y = 0; y < result.h; y++)
+    {
+        const uint8_t* src = &filtered[y * (row_bytes + 1)];
+        uint8_t* row = &result.pixels[y * row_bytes];
+        const uint8_t* prev = y == 0 ? zero_row.data() : row - row_bytes;
+        for (size_t i = 0; i < row_bytes; i++)
+        {
+            int32_t a = i >= bpp ? row[i - bpp] : 0;
+            int32_t b = prev[i];
+            int32_t c = i >= bpp ? prev[i - bpp] : 0;
+            int32_t predictor = 0;
+            switch (src[0])
+            {
+            case 0: predictor = 0; break;
+            case 1: predictor = a; break;
+            case 2: predictor = b; break;
+            case 3: predictor = (a + b) / 2; break;
+            case 4:
+            {
+                int32_t p = a + b - c;
+                int32_t pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+                predictor = pa <= pb && pa <= pc ? a : (pb <= pc ? b : c);
+                break;
+            }
+            default: return false;
+            }
+            row[i] = uint8_t(src[1 + i] + predictor);
+        }
+    }
+    return true;
+}
+
+// noise on top of gradients, so every filter has something to predict and something it can't.
+vector<uint8_t> CreateTestImage(uint32_t w, uint32_t h, size_t pitch, uint32_t channel_count, uint32_t bit_depth, uint32_t seed)
+{
+    mt19937 rng(seed);
+    uniform_int_distribution<uint32_t> noise(0, 15);
+    vector<uint8_t> image(pitch * h, 0xcd);
+    for (uint32_t y = 0; y < h; y++)
+    {
+        for (uint32_t x = 0; x < w; x++)
+        {
+            for (uint32_t c = 0; c < channel_count; c++)
+            {
+                uint32_t value = (x * 7 + y * 3 + c * 60) * 97 + noise(rng);
+                if (bit_depth == 8)
+                {
+                    image[y * pitch + x * channel_count + c] = uint8_t(value >> 4);
+                }
+                else
+                {
+                    uint16_t v = uint16_t(value * 13);
+                    memcpy(&image[y * pitch + (x * channel_count + c) * 2], &v, 2);
+                }
+            }
+        }
+    }
+    return image;
+}
+
+// the source sample the decoded png should hold at (x, y, c).
+uint32_t GetSourceSample(const vector<uint8_t>& image, size_t pitch, uint32_t x, uint32_t y, uint32_t c,
+                         uint32_t channel_count, uint32_t bit_depth, bool bgr_order)
+{
+    uint32_t src_c = bgr_order && channel_count >= 3 && c < 3 ? 2 - c : c;
+    size_t ofs = y * pitch + size_t(x * channel_count + src_c) * (bit_depth / 8);
+    if (bit_depth == 8)
+    {
+        return image[ofs];
+    }
+    uint16_t v;
+    memcpy(&v, &image[ofs], 2);
+    return v;
+}
+
+void CheckRoundTrip(uint32_t w, uint32_t h, uint32_t channel_count, uint32_t bit_depth, bool bgr_order,
+                    core::PngFilter filter, int32_t compression_level)
+{
+    SCOPED_TRACE(testing::Message() << w << " x " << h << " channels " << channel_count << " depth " << bit_depth
+                 << " bgr " << bgr_order << " filter " << filter << " level " << compression_level);
+
+    // padded rows, the encoder has to follow the pitch.
+    size_t pitch = size_t(w) * channel_count * (bit_depth / 8) + 5;
+    vector<uint8_t> image = CreateTestImage(w, h, pitch, channel_count, bit_depth, w * 31 + h);
+
+    vector<uint8_t> png_data;
+    ASSERT_TRUE(core::EncodePngImage(image.data(), w, h, pitch, channel_count, bit_depth, bgr_order, png_data, filter, compression_level));
+
+    DecodedPng decoded;
+    ASSERT_TRUE(DecodePng(png_data, decoded));
+    ASSERT_EQ(decoded.w, w);
+    ASSERT_EQ(decoded.h, h);
+    ASSERT_EQ(decoded.bit_depth, bit_depth);
+
+    uint32_t bytes = bit_depth / 8;
+    for (uint32_t y = 0; y < h; y++)
+    {
+        for (uint32_t x = 0; x < w; x++)
+        {
+            for (uint32_t c = 0; c < channel_count; c++)
+            {
+                const uint8_t* sample = &decoded.pixels[(size_t(y) * w * channel_count + x * channel_count + c) * bytes];
+                uint32_t value = bytes == 1 ? sample[0] : (uint32_t(sample[0]) << 8) | sample[1];
+                ASSERT_EQ(value, GetSourceSample(image, pitch, x, y, c, channel_count, bit_depth, bgr_order))
+                    << "at " << x << ", " << y << " channel " << c;
+            }
+        }
+    }
+}
+
+TEST(PngEncoderTest, EveryLayoutAndFilterDecodes)
+{
+    const core::PngFilter filters[] = { core::kPngFilterNone, core::kPngFilterSub, core::kPngFilterUp,
+                                        core::kPngFilterAverage, core::kPngFilterPaeth, core::kPngFilterAdaptive };
+    for (uint32_t channel_count = 1; channel_count <= 4; channel_count++)
+    {
+        for (uint32_t bit_depth : { 8u, 16u })
+        {
+            for (core::PngFilter filter : filters)
+            {
+                CheckRoundTrip(61, 17, channel_count, bit_depth, false, filter, 6);
+            }
+            if (channel_count >= 3)
+            {
+                CheckRoundTrip(61, 17, channel_count, bit_depth, true, core::kPngFilterAdaptive, 6);
+            }
+        }
+    }
+}
+
+TEST(PngEncoderTest, ParallelChunksJoinIntoOneStream)
+{
+    // several deflate chunks, the rows straddle the chunk boundaries.
+    CheckRoundTrip(1023, 300, 4, 8, true, core::kPngFilterAdaptive, 6);
+    CheckRoundTrip(517, 400, 3, 16, false, core::kPngFilterPaeth, 1);
+    CheckRoundTrip(700, 200, 4, 8, false, core::kPngFilterUp, 9);
+}
+
+TEST(PngEncoderTest, StoredAndTinyImages)
+{
+    CheckRoundTrip(300, 300, 3, 8, false, core::kPngFilterSub, 0);
+    CheckRoundTrip(1, 1, 1, 8, false, core::kPngFilterPaeth, 6);
+    CheckRoundTrip(1, 5, 2, 16, false, core::kPngFilterAverage, 6);
+}
+
+TEST(PngEncoderTest, RejectsUnsupportedLayouts)
+{
+    vector<uint8_t> image(64, 0), png_data;
+    EXPECT_FALSE(core::EncodePngImage(image.data(), 4, 4, 16, 5, 8, false, png_data));
+    EXPECT_FALSE(core::EncodePngImage(image.data(), 4, 4, 16, 1, 4, false, png_data));
+    EXPECT_FALSE(core::EncodePngImage(image.data(), 0, 4, 16, 1, 8, false, png_data));
+}
+}
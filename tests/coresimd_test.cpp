@@ -0,0 +1,210 @@
+#include "coremath.h"
+#include <gtest/gtest.h>
+#include <cfloat>
+#include <random>
+
+namespace
+{
+// the lane kernels accumulate like the scalar templates, they differ only where the
+// compiler contracts to fma, a few ulp of the largest term.
+constexpr double kMaxUlps = 4.0;
+
+template <class T>
+void ExpectNearUlps(T actual, T expected, T magnitude)
+{
+    EXPECT_LE(fabs(double(actual) - double(expected)), kMaxUlps * numeric_limits<T>::epsilon() * max(double(magnitude), 1.0))
+        << "actual " << actual << " expected " << expected;
+}
+
+template <class T>
+core::matrix4<T> RandomMatrix(mt19937& rng)
+{
+    uniform_real_distribution<T> value(T(-10), T(10));
+    core::matrix4<T> m;
+    for (int32_t i = 0; i < 16; i++)
+    {
+        m._array[i] = value(rng);
+    }
+    return m;
+}
+
+// diagonally dominant, well conditioned enough to check inverses against a reference.
+template <class T>
+core::matrix4<T> RandomInvertibleMatrix(mt19937& rng)
+{
+    core::matrix4<T> m = RandomMatrix<T>(rng);
+    for (int32_t i = 0; i < 4; i++)
+    {
+        m(i, i) += m(i, i) < T(0) ? T(-50) : T(50);
+    }
+    return m;
+}
+
+template <class T>
+T GetMagnitude(const core::matrix4<T>& m)
+{
+    T magnitude = T(0);
+    for (int32_t i = 0; i < 16; i++)
+    {
+        magnitude = max(magnitude, T(fabs(m._array[i])));
+    }
+    return magnitude;
+}
+
+template <class T>
+class CoreSimdTest : public ::testing::Test
+{
+};
+
+typedef ::testing::Types<float, double> ScalarTypes;
+TYPED_TEST_CASE(CoreSimdTest, ScalarTypes);
+
+TYPED_TEST(CoreSimdTest, ProductMatchesScalarReference)
+{
+    typedef TypeParam T;
+    mt19937 rng(1);
+    for (int32_t n = 0; n < 1000; n++)
+    {
+        core::matrix4<T> a = RandomMatrix<T>(rng);
+        core::matrix4<T> b = RandomMatrix<T>(rng);
+        core::matrix4<T> r = a * b;
+        T magnitude = GetMagnitude(a) * GetMagnitude(b) * T(4);
+        for (int32_t i = 0; i < 4; i++)
+        {
+            for (int32_t j = 0; j < 4; j++)
+            {
+                T expected = T(0);
+                for (int32_t k = 0; k < 4; k++)
+                {
+                    expected += a(i, k) * b(k, j);
+                }
+                ExpectNearUlps(r(i, j), expected, magnitude);
+            }
+        }
+    }
+}
+
+TYPED_TEST(CoreSimdTest, TransformMatchesScalarReference)
+{
+    typedef TypeParam T;
+    mt19937 rng(2);
+    uniform_real_distribution<T> value(T(-100), T(100));
+    for (int32_t n = 0; n < 1000; n++)
+    {
+        core::matrix4<T> m = RandomMatrix<T>(rng);
+        core::vec4<T> v(value(rng), value(rng), value(rng), value(rng));
+        core::vec4<T> r = m * v;
+        core::vec4<T> r_transposed = v * m;
+        T magnitude = GetMagnitude(m) * T(400);
+        for (int32_t i = 0; i < 4; i++)
+        {
+            T expected = m(i, 0) * v.x + m(i, 1) * v.y + m(i, 2) * v.z + m(i, 3) * v.w;
+            T expected_transposed = v.x * m(0, i) + v.y * m(1, i) + v.z * m(2, i) + v.w * m(3, i);
+            ExpectNearUlps(r[i], expected, magnitude);
+            ExpectNearUlps(r_transposed[i], expected_transposed, magnitude);
+        }
+    }
+}
+
+TYPED_TEST(CoreSimdTest, BatchedKernelsMatchScalarTemplates)
+{
+    typedef TypeParam T;
+    mt19937 rng(3);
+    uniform_real_distribution<float> value(-100.0f, 100.0f);
+    const size_t count = 257;
+    vector<core::vec3f> points(count);
+    for (auto& p : points)
+    {
+        p = core::vec3f(value(rng), value(rng), value(rng));
+    }
+
+    core::matrix4<T> m = RandomMatrix<T>(rng);
+    T magnitude = GetMagnitude(m) * T(400);
+
+    // explicit template arguments select the scalar templates over the simd overloads.
+    vector<core::vec4<T>> clip(count), clip_reference(count);
+    core::TransformPoints(m, points.data(), clip.data(), count);
+    core::TransformPoints<T, float>(m, points.data(), clip_reference.data(), count);
+
+    vector<core::vec3<T>> affine(count), affine_reference(count);
+    core::TransformPointsAffine(points.data(), count, m, affine.data());
+    core::TransformPointsAffine<T, float>(points.data(), count, m, affine_reference.data());
+
+    for (size_t i = 0; i < count; i++)
+    {
+        for (int32_t c = 0; c < 4; c++)
+        {
+            ExpectNearUlps(clip[i][c], clip_reference[i][c], magnitude);
+        }
+        for (int32_t c = 0; c < 3; c++)
+        {
+            ExpectNearUlps(affine[i][c], affine_reference[i][c], magnitude);
+        }
+    }
+
+    core::bounds3<T> bbox;
+    bbox += core::vec3<T>(T(-3), T(2), T(-7));
+    bbox += core::vec3<T>(T(5), T(9), T(1));
+    core::bounds3<T> r = core::TransformBoundsAffine(m, bbox);
+    core::bounds3<T> r_reference = core::TransformBoundsAffine<T>(m, bbox);
+    for (int32_t c = 0; c < 3; c++)
+    {
+        ExpectNearUlps(r.bb_min[c], r_reference.bb_min[c], magnitude);
+        ExpectNearUlps(r.bb_max[c], r_reference.bb_max[c], magnitude);
+    }
+
+    // the box corners under m are inside the transformed bounds.
+    core::vec4<T> corners[8];
+    core::TransformBounds(core::matrix4<T>(), bbox, corners);
+    for (int32_t i = 0; i < 8; i++)
+    {
+        core::vec4<T> p = m * corners[i];
+        for (int32_t c = 0; c < 3; c++)
+        {
+            EXPECT_GE(p[c] + magnitude * numeric_limits<T>::epsilon() * T(kMaxUlps), r.bb_min[c]);
+            EXPECT_LE(p[c] - magnitude * numeric_limits<T>::epsilon() * T(kMaxUlps), r.bb_max[c]);
+        }
+    }
+}
+
+TYPED_TEST(CoreSimdTest, InverseMatchesGaussianElimination)
+{
+    typedef TypeParam T;
+    mt19937 rng(4);
+    for (int32_t n = 0; n < 1000; n++)
+    {
+        core::matrix4<T> m = RandomInvertibleMatrix<T>(rng);
+        core::matrix4<T> m_inv = core::inverse(m);
+
+        // the pivoting elimination the adjugate replaced, in long double as the reference.
+        core::matrix4<long double> m_wide;
+        for (int32_t i = 0; i < 16; i++)
+        {
+            m_wide._array[i] = m._array[i];
+        }
+        core::matrix4<long double> m_inv_wide = core::InverseGaussian(m_wide);
+
+        for (int32_t i = 0; i < 16; i++)
+        {
+            // the entries are around 1 / 50, 64 ulp of the matrix magnitude covers the cofactor sums.
+            EXPECT_NEAR(double(m_inv._array[i]), double(m_inv_wide._array[i]), 64.0 * numeric_limits<T>::epsilon());
+        }
+    }
+}
+
+TYPED_TEST(CoreSimdTest, InverseOfSingularIsIdentity)
+{
+    typedef TypeParam T;
+    core::matrix4<T> m(T(0));
+    m(0, 0) = T(1);
+    m(1, 1) = T(2);
+    core::matrix4<T> m_inv = core::inverse(m);
+    for (int32_t i = 0; i < 4; i++)
+    {
+        for (int32_t j = 0; j < 4; j++)
+        {
+            EXPECT_EQ(m_inv(i, j), i == j ? T(1) : T(0));
+        }
+    }
+}
+}
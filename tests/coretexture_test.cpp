@@ -0,0 +1,327 @@
+#include "coretexture.h"
+#include "glfunctionlist.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+namespace
+{
+// random blocks, every fourth one in the 3 color mode, a few of those with equal end points.
+vector<uint8_t> CreateDxt1Blocks(uint32_t w, uint32_t h, uint32_t seed)
+{
+    mt19937 rng(seed);
+    size_t num_blocks = size_t((w + 3) / 4) * ((h + 3) / 4);
+    vector<uint8_t> data(num_blocks * 8);
+    for (size_t i = 0; i < num_blocks; i++)
+    {
+        uint8_t* block = &data[i * 8];
+        for (uint32_t j = 0; j < 8; j++)
+        {
+            block[j] = uint8_t(rng());
+        }
+
+        uint16_t color_0 = uint16_t(block[0] | (block[1] << 8));
+        uint16_t color_1 = uint16_t(block[2] | (block[3] << 8));
+        bool three_color = i % 4 == 3;
+        if (three_color ? color_0 > color_1 : color_0 < color_1)
+        {
+            swap(color_0, color_1);
+        }
+        if (i % 16 == 15)
+        {
+            color_1 = color_0;
+        }
+        else if (!three_color && color_0 == color_1)
+        {
+            color_0 = color_0 == 0 ? uint16_t(1) : color_0;
+            color_1 = uint16_t(color_0 - 1);
+        }
+        block[0] = uint8_t(color_0);
+        block[1] = uint8_t(color_0 >> 8);
+        block[2] = uint8_t(color_1);
+        block[3] = uint8_t(color_1 >> 8);
+    }
+    return data;
+}
+
+// the image through the block by block scalar decoder, 0x00rrggbb texels padded to whole
+// blocks, and the alpha the packed decoder writes for each texel.
+void DecodeReference(uint32_t w, uint32_t h, const vector<uint8_t>& dxt_data, vector<uint32_t>& texels, vector<uint8_t>& alphas)
+{
+    uint32_t block_w = (w + 3) / 4, block_h = (h + 3) / 4;
+    texels.assign(size_t(block_w) * 4 * block_h * 4, 0);
+    core::Dxt1Convertor::DecodeDxt1Texture(texels.data(), block_w * 4, block_h * 4, dxt_data.data());
+
+    alphas.assign(texels.size(), 255);
+    for (uint32_t y = 0; y < block_h * 4; y++)
+    {
+        for (uint32_t x = 0; x < block_w * 4; x++)
+        {
+            const uint8_t* block = &dxt_data[(size_t(y / 4) * block_w + x / 4) * 8];
+            uint32_t color_0 = block[0] | (block[1] << 8), color_1 = block[2] | (block[3] << 8);
+            uint32_t idx = (block[4 + y % 4] >> (2 * (x % 4))) & 0x03;
+            alphas[size_t(y) * block_w * 4 + x] = color_0 <= color_1 && idx == 3 ? 0 : 255;
+        }
+    }
+}
+
+struct Dxt1Layout
+{
+    uint32_t    channel_count;
+    bool        bgr_order;
+    bool        flip_y;
+};
+
+// sizes of whole blocks, partial edge blocks, single texels and a width of less than a block.
+const uint32_t kTestSizes[][2] = { { 64, 32 }, { 1, 1 }, { 3, 5 }, { 5, 3 }, { 17, 9 }, { 130, 67 }, { 255, 257 } };
+
+TEST(Dxt1ConvertorTest, DecodeImageMatchesTheScalarBlockDecoder)
+{
+    // the vector row expansion for whole blocks, the scalar one for the clipped ones.
+    uint32_t seed = 32;
+    for (const auto& size : kTestSizes)
+    {
+        uint32_t w = size[0], h = size[1];
+        vector<uint8_t> dxt_data = CreateDxt1Blocks(w, h, seed++);
+        vector<uint32_t> texels;
+        vector<uint8_t> alphas;
+        DecodeReference(w, h, dxt_data, texels, alphas);
+        uint32_t ref_w = (w + 3) / 4 * 4;
+
+        for (const Dxt1Layout& layout : { Dxt1Layout{ 3, false, false }, Dxt1Layout{ 3, true, true },
+                                          Dxt1Layout{ 4, false, true }, Dxt1Layout{ 4, true, false } })
+        {
+            SCOPED_TRACE(testing::Message() << w << " x " << h << ", " << layout.channel_count << " channels"
+                                            << (layout.bgr_order ? ", bgr" : ", rgb") << (layout.flip_y ? ", flipped" : ""));
+            uint32_t c = layout.channel_count;
+            // a guard byte past the image, edge blocks may not write beyond their texels.
+            vector<uint8_t> image(size_t(w) * h * c + 1, 0xcd);
+            core::Dxt1Convertor::DecodeDxt1Image(image.data(), w, h, dxt_data.data(), c, layout.bgr_order, layout.flip_y);
+            ASSERT_EQ(image.back(), 0xcd);
+
+            for (uint32_t y = 0; y < h; y++)
+            {
+                const uint8_t* row = &image[size_t(layout.flip_y ? h - 1 - y : y) * w * c];
+                for (uint32_t x = 0; x < w; x++)
+                {
+                    uint32_t texel = texels[size_t(y) * ref_w + x];
+                    uint8_t r = uint8_t(texel >> 16), g = uint8_t(texel >> 8), b = uint8_t(texel);
+                    uint8_t expected[4] = { layout.bgr_order ? b : r, g, layout.bgr_order ? r : b, alphas[size_t(y) * ref_w + x] };
+                    ASSERT_EQ(memcmp(row + x * c, expected, c), 0) << "texel " << x << ", " << y;
+                }
+            }
+        }
+    }
+}
+
+TEST(Dxt1ConvertorTest, DecodeImageKeepsTransparentBlackApart)
+{
+    // an opaque black texel and a transparent one in a 3 color block, both 0x000000.
+    const uint8_t block[8] = { 0x00, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x00, 0x00 };
+    uint8_t image[16 * 4];
+    core::Dxt1Convertor::DecodeDxt1Image(image, 4, 4, block, 4, false, false);
+    const uint8_t opaque_black[4] = { 0, 0, 0, 255 };
+    const uint8_t transparent[4] = { 0, 0, 0, 0 };
+    EXPECT_EQ(memcmp(image, opaque_black, 4), 0);
+    EXPECT_EQ(memcmp(image + 4, transparent, 4), 0);
+    EXPECT_EQ(memcmp(image + 8, opaque_black, 4), 0);
+}
+
+// level 0 of an uncompressed rgba texture.
+void CreateRgbaTexture(uint32_t w, uint32_t h, const vector<uint8_t>& rgba_data, core::Texture2DInfo& texture_info)
+{
+    texture_info.m_objectId = 1;
+    texture_info.m_levelCount = 1;
+    texture_info.m_internalFormat = kGlRgba;
+    texture_info.m_format = kGlRgba;
+    texture_info.m_type = kGlUByte;
+    texture_info.m_mips[0].m_width = w;
+    texture_info.m_mips[0].m_height = h;
+    texture_info.m_mips[0].m_size = w * h * 4;
+    texture_info.m_mips[0].m_imageData = make_unique<char[]>(rgba_data.size());
+    memcpy(texture_info.m_mips[0].m_imageData.get(), rgba_data.data(), rgba_data.size());
+}
+
+vector<uint8_t> CreateRandomTexels(uint32_t w, uint32_t h, uint32_t seed)
+{
+    mt19937 rng(seed);
+    vector<uint8_t> rgba_data(size_t(w) * h * 4);
+    for (uint8_t& value : rgba_data)
+    {
+        value = uint8_t(rng());
+    }
+    return rgba_data;
+}
+
+double ReferenceSrgbToLinear(double c)
+{
+    return c <= 0.04045 ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4);
+}
+
+double ReferenceLinearToSrgb(double c)
+{
+    return c <= 0.0031308 ? c * 12.92 : 1.055 * pow(c, 1.0 / 2.4) - 0.055;
+}
+
+// share of each source texel in an exact area average, destination texels cover
+// src_size / dst_size source texels.
+vector<vector<pair<uint32_t, double>>> ReferenceBoxWeights(uint32_t src_size, uint32_t dst_size)
+{
+    vector<vector<pair<uint32_t, double>>> weights(dst_size);
+    double scale = double(src_size) / dst_size;
+    for (uint32_t d = 0; d < dst_size; d++)
+    {
+        double lo = d * scale, hi = (d + 1) * scale;
+        for (uint32_t s = uint32_t(lo); s < src_size && s < hi; s++)
+        {
+            weights[d].push_back(make_pair(s, (min(hi, s + 1.0) - max(lo, double(s))) / scale));
+        }
+    }
+    return weights;
+}
+
+vector<double> ReferenceBoxLevel(const vector<double>& src, uint32_t w, uint32_t h, uint32_t dst_w, uint32_t dst_h)
+{
+    auto weights_x = ReferenceBoxWeights(w, dst_w);
+    auto weights_y = ReferenceBoxWeights(h, dst_h);
+    vector<double> dst(size_t(dst_w) * dst_h * 4, 0.0);
+    for (uint32_t y = 0; y < dst_h; y++)
+    {
+        for (uint32_t x = 0; x < dst_w; x++)
+        {
+            for (const auto& w_y : weights_y[y])
+            {
+                for (const auto& w_x : weights_x[x])
+                {
+                    for (uint32_t k = 0; k < 4; k++)
+                    {
+                        dst[(size_t(y) * dst_w + x) * 4 + k] += src[(size_t(w_y.first) * w + w_x.first) * 4 + k] * w_y.second * w_x.second;
+                    }
+                }
+            }
+        }
+    }
+    return dst;
+}
+
+// non power of two, single row and single column textures.
+const uint32_t kMipTestSizes[][2] = { { 1, 1 }, { 2, 1 }, { 1, 9 }, { 13, 1 }, { 37, 20 }, { 64, 64 }, { 100, 3 }, { 255, 129 } };
+
+TEST(BuildMipChainTest, LevelsHalveDownToOneTexel)
+{
+    for (const auto& size : kMipTestSizes)
+    {
+        uint32_t w = size[0], h = size[1];
+        SCOPED_TRACE(testing::Message() << w << " x " << h);
+        core::Texture2DInfo src_info, dst_info;
+        CreateRgbaTexture(w, h, CreateRandomTexels(w, h, w * 1000 + h), src_info);
+        ASSERT_TRUE(core::BuildMipChain(&src_info, &dst_info));
+
+        // one level per halving of the larger side, floor(log2(max(w, h))) + 1.
+        uint32_t expected_count = 1;
+        for (uint32_t side = max(w, h); side > 1; side /= 2)
+        {
+            expected_count++;
+        }
+        ASSERT_EQ(dst_info.m_levelCount, expected_count);
+        EXPECT_EQ(dst_info.m_format, uint32_t(kGlRgba));
+        EXPECT_EQ(memcmp(dst_info.m_mips[0].m_imageData.get(), src_info.m_mips[0].m_imageData.get(), size_t(w) * h * 4), 0);
+
+        for (uint32_t level = 0; level < dst_info.m_levelCount; level++)
+        {
+            const core::Texture2DSurfaceInfo& mip = dst_info.m_mips[level];
+            EXPECT_EQ(mip.m_width, max(w >> level, 1u)) << "level " << level;
+            EXPECT_EQ(mip.m_height, max(h >> level, 1u)) << "level " << level;
+            EXPECT_EQ(mip.m_size, mip.m_width * mip.m_height * 4) << "level " << level;
+            EXPECT_NE(mip.m_imageData, nullptr) << "level " << level;
+        }
+    }
+}
+
+TEST(BuildMipChainTest, BlockCompressedLevelsKeepTheirFormat)
+{
+    // a 3 x 2 block dxt1 texture of one color, each level holds whole blocks.
+    uint32_t w = 11, h = 6;
+    const uint8_t block[8] = { 0x00, 0xf8, 0x00, 0xf8, 0x00, 0x00, 0x00, 0x00 };
+    core::Texture2DInfo src_info, dst_info;
+    src_info.m_objectId = 1;
+    src_info.m_levelCount = 1;
+    src_info.m_internalFormat = kGLCmpsdRgbS3tcDxt1Ext;
+    src_info.m_format = kGLCmpsdRgbS3tcDxt1Ext;
+    src_info.m_type = kGlUByte;
+    src_info.m_mips[0].m_width = w;
+    src_info.m_mips[0].m_height = h;
+    src_info.m_mips[0].m_size = 6 * 8;
+    src_info.m_mips[0].m_imageData = make_unique<char[]>(6 * 8);
+    for (uint32_t i = 0; i < 6; i++)
+    {
+        memcpy(src_info.m_mips[0].m_imageData.get() + i * 8, block, 8);
+    }
+    ASSERT_TRUE(core::BuildMipChain(&src_info, &dst_info));
+    ASSERT_EQ(dst_info.m_levelCount, 4u);
+
+    for (uint32_t level = 0; level < dst_info.m_levelCount; level++)
+    {
+        const core::Texture2DSurfaceInfo& mip = dst_info.m_mips[level];
+        EXPECT_EQ(mip.m_size, (mip.m_width + 3) / 4 * ((mip.m_height + 3) / 4) * 8) << "level " << level;
+        vector<uint8_t> rgba_data;
+        ASSERT_TRUE(core::DecodeTextureLevel(&dst_info, level, rgba_data)) << "level " << level;
+        for (size_t i = 0; i < rgba_data.size(); i += 4)
+        {
+            ASSERT_EQ(rgba_data[i], 0xf8) << "level " << level;
+            ASSERT_EQ(rgba_data[i + 1], 0) << "level " << level;
+            ASSERT_EQ(rgba_data[i + 2], 0) << "level " << level;
+            ASSERT_EQ(rgba_data[i + 3], 255) << "level " << level;
+        }
+    }
+}
+
+TEST(BuildMipChainTest, BoxLevelsAverageColorInLinearSpace)
+{
+    // black and white average to 188 in srgb, not 128, alpha is linear.
+    core::Texture2DInfo src_info, dst_info;
+    CreateRgbaTexture(2, 1, { 0, 0, 255, 0, 255, 255, 0, 255 }, src_info);
+    ASSERT_TRUE(core::BuildMipChain(&src_info, &dst_info, core::kMipFilterBox));
+    ASSERT_EQ(dst_info.m_levelCount, 2u);
+    const uint8_t* texel = reinterpret_cast<const uint8_t*>(dst_info.m_mips[1].m_imageData.get());
+    EXPECT_EQ(texel[0], 188);
+    EXPECT_EQ(texel[1], 188);
+    EXPECT_EQ(texel[2], 188);
+    EXPECT_EQ(texel[3], 128);
+}
+
+TEST(BuildMipChainTest, BoxLevelsMatchAnAreaAverage)
+{
+    // each level is filtered from the unquantized one above it, so is the reference.
+    for (const auto& size : kMipTestSizes)
+    {
+        uint32_t w = size[0], h = size[1];
+        SCOPED_TRACE(testing::Message() << w << " x " << h);
+        vector<uint8_t> rgba_data = CreateRandomTexels(w, h, w * 1000 + h);
+        core::Texture2DInfo src_info, dst_info;
+        CreateRgbaTexture(w, h, rgba_data, src_info);
+        ASSERT_TRUE(core::BuildMipChain(&src_info, &dst_info, core::kMipFilterBox));
+
+        vector<double> linear(rgba_data.size());
+        for (size_t i = 0; i < rgba_data.size(); i++)
+        {
+            linear[i] = i % 4 == 3 ? rgba_data[i] / 255.0 : ReferenceSrgbToLinear(rgba_data[i] / 255.0);
+        }
+
+        for (uint32_t level = 1; level < dst_info.m_levelCount; level++)
+        {
+            uint32_t level_w = max(w >> level, 1u), level_h = max(h >> level, 1u);
+            linear = ReferenceBoxLevel(linear, max(w >> (level - 1), 1u), max(h >> (level - 1), 1u), level_w, level_h);
+
+            // float filtering against double, one step of rounding apart at most.
+            const uint8_t* texels = reinterpret_cast<const uint8_t*>(dst_info.m_mips[level].m_imageData.get());
+            for (size_t i = 0; i < linear.size(); i++)
+            {
+                double value = i % 4 == 3 ? linear[i] : ReferenceLinearToSrgb(linear[i]);
+                ASSERT_NEAR(texels[i], value * 255.0, 1.0) << "level " << level << ", texel " << i / 4 << ", channel " << i % 4;
+            }
+        }
+    }
+}
+}
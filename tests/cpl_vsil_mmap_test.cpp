@@ -0,0 +1,194 @@
+#include "base.h"
+#include "cpl_vsi.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <random>
+
+namespace
+{
+// a size that is no multiple of a page or of the element sizes read.
+const size_t kTestFileSize = 3 * 65536 + 4093;
+
+class VSIMMapTest : public ::testing::Test
+{
+protected:
+    const string file_name_ = "cpl_vsil_mmap_test.bin";
+    vector<uint8_t> file_data_;
+
+    void SetUp() override
+    {
+        mt19937 rng(26);
+        file_data_.resize(kTestFileSize);
+        for (uint8_t& value : file_data_)
+        {
+            value = uint8_t(rng());
+        }
+
+        FILE* file = fopen(file_name_.c_str(), "wb");
+        ASSERT_NE(file, nullptr);
+        ASSERT_EQ(fwrite(file_data_.data(), 1, file_data_.size(), file), file_data_.size());
+        fclose(file);
+    }
+
+    void TearDown() override
+    {
+        remove(file_name_.c_str());
+    }
+};
+
+// seeks, reads and eof checks done on a c stdio file and on the mapped handle, every
+// result has to agree. the large file handler of the platform is no reference, the
+// win32 one answers eof from the position instead of the last read.
+struct HandlePair
+{
+    FILE*   stdio_file;
+    FILE*   mmap_file;
+
+    void seek(vsi_l_offset offset, int whence)
+    {
+        ASSERT_EQ(VSIFSeekL(mmap_file, offset, whence), fseek(stdio_file, long(int64_t(offset)), whence))
+            << "seek " << int64_t(offset) << " whence " << whence;
+        ASSERT_EQ(VSIFTellL(mmap_file), vsi_l_offset(ftell(stdio_file)));
+        ASSERT_EQ(VSIFEofL(mmap_file) != 0, feof(stdio_file) != 0);
+    }
+
+    void read(size_t size, size_t count)
+    {
+        // the bytes past a short read are left alone by both.
+        vector<uint8_t> stdio_data(size * count + 1, 0xcd), mmap_data(size * count + 1, 0xcd);
+        long offset = ftell(stdio_file);
+        size_t num_read = fread(stdio_data.data(), size, count, stdio_file);
+        ASSERT_EQ(VSIFReadL(mmap_data.data(), size, count, mmap_file), num_read)
+            << "read " << size << " x " << count << " at " << offset;
+        ASSERT_EQ(mmap_data, stdio_data) << "read " << size << " x " << count << " at " << offset;
+        ASSERT_EQ(VSIFTellL(mmap_file), vsi_l_offset(ftell(stdio_file)));
+        ASSERT_EQ(VSIFEofL(mmap_file) != 0, feof(stdio_file) != 0) << "read " << size << " x " << count << " at " << offset;
+    }
+};
+
+TEST_F(VSIMMapTest, ReadsMatchTheStdioHandler)
+{
+    HandlePair handles;
+    handles.stdio_file = fopen(file_name_.c_str(), "rb");
+    handles.mmap_file = VSIFOpenL(("/vsimmap/" + file_name_).c_str(), "rb");
+    ASSERT_NE(handles.stdio_file, nullptr);
+    ASSERT_NE(handles.mmap_file, nullptr);
+
+    // the whole file in one read, then one more read at the end.
+    handles.read(1, kTestFileSize);
+    handles.read(1, 1);
+    handles.seek(0, SEEK_SET);
+    handles.read(kTestFileSize, 1);
+
+    // reading exactly up to the end is no eof yet, a trailing partial element is.
+    handles.seek(kTestFileSize - 16, SEEK_SET);
+    handles.read(8, 2);
+    handles.read(8, 1);
+    handles.seek(kTestFileSize - 10, SEEK_SET);
+    handles.read(4, 3);
+    handles.seek(0, SEEK_CUR);
+
+    // past the end, relative to the end and backwards, and before the start.
+    handles.seek(kTestFileSize + 100, SEEK_SET);
+    handles.read(1, 10);
+    handles.seek(vsi_l_offset(-100), SEEK_END);
+    handles.read(16, 4);
+    handles.seek(vsi_l_offset(-1000), SEEK_CUR);
+    handles.read(3, 7);
+    handles.seek(0, SEEK_END);
+    handles.read(0, 5);
+    handles.read(5, 0);
+    handles.seek(vsi_l_offset(-1), SEEK_SET);
+    handles.seek(vsi_l_offset(-int64_t(kTestFileSize) - 1), SEEK_END);
+    handles.read(2, 2);
+
+    mt19937 rng(1);
+    uniform_int_distribution<int32_t> op(0, 5);
+    uniform_int_distribution<size_t> size(1, 16), count(0, 5000);
+    uniform_int_distribution<int64_t> offset(0, int64_t(kTestFileSize) + 64), step(-20000, 20000);
+    for (int32_t i = 0; i < 2000; i++)
+    {
+        switch (op(rng))
+        {
+        case 0:
+            handles.seek(vsi_l_offset(offset(rng)), SEEK_SET);
+            break;
+        case 1:
+            handles.seek(vsi_l_offset(-offset(rng) / 8), SEEK_END);
+            break;
+        case 2:
+        {
+            int64_t delta = step(rng);
+            if (int64_t(ftell(handles.stdio_file)) + delta >= 0)
+            {
+                handles.seek(vsi_l_offset(delta), SEEK_CUR);
+            }
+            break;
+        }
+        default:
+            handles.read(size(rng), count(rng));
+            break;
+        }
+        if (HasFatalFailure())
+        {
+            break;
+        }
+    }
+
+    EXPECT_EQ(VSIFCloseL(handles.mmap_file), 0);
+    EXPECT_EQ(fclose(handles.stdio_file), 0);
+}
+
+TEST_F(VSIMMapTest, ReadsMatchTheFileData)
+{
+    FILE* file = VSIFOpenL(("/vsimmap/" + file_name_).c_str(), "rb");
+    ASSERT_NE(file, nullptr);
+
+    vector<uint8_t> data(4096);
+    for (size_t offset : { size_t(0), size_t(1), size_t(65535), kTestFileSize - 4096 })
+    {
+        ASSERT_EQ(VSIFSeekL(file, offset, SEEK_SET), 0);
+        ASSERT_EQ(VSIFReadL(data.data(), 1, data.size(), file), data.size());
+        EXPECT_TRUE(equal(data.begin(), data.end(), file_data_.begin() + offset)) << offset;
+    }
+
+    // the mapping is read only.
+    EXPECT_EQ(VSIFWriteL(data.data(), 1, 1, file), 0u);
+    EXPECT_EQ(VSIFCloseL(file), 0);
+
+    VSIStatBufL stat;
+    ASSERT_EQ(VSIStatL(("/vsimmap/" + file_name_).c_str(), &stat), 0);
+    EXPECT_EQ(uint64_t(stat.st_size), uint64_t(kTestFileSize));
+}
+
+TEST_F(VSIMMapTest, UnmappableFilesFallBackToStdio)
+{
+    // an empty file can not be mapped, update access is not served from a mapping.
+    const string empty_name = "cpl_vsil_mmap_test_empty.bin";
+    fclose(fopen(empty_name.c_str(), "wb"));
+    FILE* file = VSIFOpenL(("/vsimmap/" + empty_name).c_str(), "rb");
+    ASSERT_NE(file, nullptr);
+    uint8_t value = 0;
+    EXPECT_EQ(VSIFReadL(&value, 1, 1, file), 0u);
+    EXPECT_TRUE(VSIFEofL(file));
+    VSIFCloseL(file);
+    remove(empty_name.c_str());
+
+    file = VSIFOpenL(("/vsimmap/" + file_name_).c_str(), "r+b");
+    ASSERT_NE(file, nullptr);
+    value = uint8_t(~file_data_[10]);
+    ASSERT_EQ(VSIFSeekL(file, 10, SEEK_SET), 0);
+    EXPECT_EQ(VSIFWriteL(&value, 1, 1, file), 1u);
+    VSIFCloseL(file);
+
+    file = VSIFOpenL(("/vsimmap/" + file_name_).c_str(), "rb");
+    ASSERT_NE(file, nullptr);
+    uint8_t read_value = 0;
+    ASSERT_EQ(VSIFSeekL(file, 10, SEEK_SET), 0);
+    ASSERT_EQ(VSIFReadL(&read_value, 1, 1, file), 1u);
+    EXPECT_EQ(read_value, value);
+    VSIFCloseL(file);
+
+    EXPECT_EQ(VSIFOpenL("/vsimmap/cpl_vsil_mmap_test_missing.bin", "rb"), nullptr);
+}
+}
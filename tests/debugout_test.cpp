@@ -0,0 +1,11 @@
+#include "debugout.h"
+#include <cstdio>
+
+namespace core
+{
+// the tests run without qt, messages go to stderr instead of a message box.
+void output_debug_info(const string& message_head, const string& message_body)
+{
+    fprintf(stderr, "%s: %s\n", message_head.c_str(), message_body.c_str());
+}
+}
@@ -0,0 +1,433 @@
+#include "elevationgrid.h"
+#include "hfa/hfa_p.h"
+#include "hfa/hfa.h"
+#include <gtest/gtest.h>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+namespace
+{
+// a 1/3 arc second grid like the usgs rasters, nothing adds up exactly in binary.
+const core::vec2d kTestOrigin(-105.0001851852, 40.0001851852);
+const core::vec2d kTestPixelSize(1.0 / 10800.0, -1.0 / 10800.0);
+
+// each raster holds its own linear field, so overlaps blend different surfaces.
+// linear in pixels keeps the bilinear lookup of a single raster exact.
+float GetTestHeight(const core::vec2d& pos, int raster_idx)
+{
+    core::vec2d s = (pos - kTestOrigin) / kTestPixelSize;
+    return float(100.0 + 0.5 * s.x - 0.25 * s.y + 2.0 * raster_idx + 0.05 * raster_idx * s.x);
+}
+
+struct TestRaster
+{
+    string      file_name;
+    core::vec2d ul_corner;
+    core::vec2i lattice_ofs;    // node of the upper left pixel, aligned rasters only
+    int         w;
+    int         h;
+};
+
+// a float band in 64 x 64 blocks, the layout usgs rasters have.
+bool CreateRaster(const TestRaster& raster, int raster_idx)
+{
+    HFAHandle h_hfa = HFACreate(raster.file_name.c_str(), raster.w, raster.h, 1, EPT_f32, nullptr);
+    if (!h_hfa)
+    {
+        return false;
+    }
+
+    int data_type, block_w, block_h, num_overviews, compression;
+    HFAGetBandInfo(h_hfa, 1, &data_type, &block_w, &block_h, &num_overviews, &compression);
+    vector<float> block(size_t(block_w) * block_h);
+    bool succeeded = true;
+    for (int b_y = 0; b_y * block_h < raster.h; b_y++)
+    {
+        for (int b_x = 0; b_x * block_w < raster.w; b_x++)
+        {
+            for (int y = 0; y < block_h; y++)
+            {
+                for (int x = 0; x < block_w; x++)
+                {
+                    core::vec2d s(double(b_x * block_w + x), double(b_y * block_h + y));
+                    block[size_t(y) * block_w + x] = GetTestHeight(raster.ul_corner + kTestPixelSize * s, raster_idx);
+                }
+            }
+            succeeded &= HFASetRasterBlock(h_hfa, 1, b_x, b_y, block.data()) == CE_None;
+        }
+    }
+    HFAClose(h_hfa);
+    return succeeded;
+}
+
+class ElevationMosaicTest : public ::testing::Test
+{
+protected:
+    vector<TestRaster> raster_list_;
+    int num_aligned_;
+
+    // a 3 x 2 layout overlapping by 10 pixels, the last raster moved by last_ofs pixels.
+    void CreateRasters(const core::vec2d& last_ofs)
+    {
+        for (int i = 0; i < 6; i++)
+        {
+            TestRaster raster;
+            raster.file_name = "elevationgrid_test_" + to_string(i) + ".img";
+            raster.lattice_ofs = core::vec2i((i % 3) * 140, (i / 3) * 90);
+            // corners as a georeference states them, decimals not sums of pixel sizes.
+            core::vec2d ul_corner = kTestOrigin + kTestPixelSize * core::vec2d(double(raster.lattice_ofs.x), double(raster.lattice_ofs.y));
+            raster.ul_corner = core::vec2d(round(ul_corner.x * 1e12) / 1e12, round(ul_corner.y * 1e12) / 1e12);
+            raster.w = 150;
+            raster.h = 100;
+            raster_list_.push_back(raster);
+        }
+        raster_list_.back().ul_corner += kTestPixelSize * last_ofs;
+        num_aligned_ = last_ofs == core::vec2d(0.0, 0.0) ? 6 : 5;
+
+        for (size_t i = 0; i < raster_list_.size(); i++)
+        {
+            ASSERT_TRUE(CreateRaster(raster_list_[i], int(i))) << raster_list_[i].file_name;
+        }
+    }
+
+    void SetUp() override
+    {
+        CreateRasters(core::vec2d(0.37, 0.61));
+    }
+
+    void TearDown() override
+    {
+        for (const auto& raster : raster_list_)
+        {
+            remove(raster.file_name.c_str());
+        }
+    }
+
+    void OpenMosaic(ElevationMosaic& mosaic, bool b_build)
+    {
+        for (const auto& raster : raster_list_)
+        {
+            auto grid = make_shared<ElevationGrid>();
+            ASSERT_TRUE(grid->open(raster.file_name, 1, mosaic.get_cache()));
+            mosaic.add_tile(grid, raster.ul_corner, kTestPixelSize);
+        }
+        if (b_build)
+        {
+            mosaic.build();
+        }
+    }
+
+    core::vec2d GetPixelCoord(size_t raster_idx, const core::vec2d& pos) const
+    {
+        return (pos - raster_list_[raster_idx].ul_corner) / kTestPixelSize;
+    }
+
+    bool RasterContains(size_t raster_idx, const core::vec2d& pos) const
+    {
+        core::vec2d s = GetPixelCoord(raster_idx, pos);
+        const TestRaster& raster = raster_list_[raster_idx];
+        return s.x >= 0.0 && s.y >= 0.0 && s.x <= double(raster.w - 1) && s.y <= double(raster.h - 1);
+    }
+
+    // how many aligned rasters mesh each lattice cell, -1 for cells under none of them.
+    vector<int> CountCellOwners(const ElevationMosaic& mosaic, int x_cells, int y_cells) const
+    {
+        vector<int> num_owners(size_t(x_cells) * y_cells, -1);
+        for (int i = 0; i < num_aligned_; i++)
+        {
+            const TestRaster& raster = raster_list_[i];
+            core::bounds2d bbox = mosaic.get_owned_pixel_bounds(i);
+            core::vec2i owned_min = raster.lattice_ofs + core::vec2i(int32_t(bbox.bb_min.x), int32_t(bbox.bb_min.y));
+            core::vec2i owned_max = raster.lattice_ofs + core::vec2i(int32_t(bbox.bb_max.x), int32_t(bbox.bb_max.y));
+            for (int c_y = raster.lattice_ofs.y; c_y < raster.lattice_ofs.y + raster.h - 1; c_y++)
+            {
+                for (int c_x = raster.lattice_ofs.x; c_x < raster.lattice_ofs.x + raster.w - 1; c_x++)
+                {
+                    int& count = num_owners[size_t(c_y) * x_cells + c_x];
+                    count = max(count, 0);
+                    count += c_x >= owned_min.x && c_x + 1 <= owned_max.x && c_y >= owned_min.y && c_y + 1 <= owned_max.y ? 1 : 0;
+                }
+            }
+        }
+        return num_owners;
+    }
+
+    // nodes owned by two rasters are meshed twice, once from each side. both have to
+    // come up with the same bits or the meshes crack along the seam.
+    int32_t CheckSharedNodes(ElevationMosaic& mosaic) const
+    {
+        int32_t num_shared = 0;
+        for (int i = 0; i < num_aligned_; i++)
+        {
+            core::bounds2d bbox_i = mosaic.get_owned_pixel_bounds(i);
+            for (int j = i + 1; j < num_aligned_; j++)
+            {
+                core::bounds2d bbox_j = mosaic.get_owned_pixel_bounds(j);
+                core::vec2i ofs = raster_list_[j].lattice_ofs - raster_list_[i].lattice_ofs;
+                for (int y = int(bbox_i.bb_min.y); y <= int(bbox_i.bb_max.y); y++)
+                {
+                    for (int x = int(bbox_i.bb_min.x); x <= int(bbox_i.bb_max.x); x++)
+                    {
+                        core::vec2d s_i = core::vec2d(double(x), double(y));
+                        core::vec2d s_j = core::vec2d(double(x - ofs.x), double(y - ofs.y));
+                        if (s_j.x < bbox_j.bb_min.x || s_j.x > bbox_j.bb_max.x || s_j.y < bbox_j.bb_min.y || s_j.y > bbox_j.bb_max.y)
+                        {
+                            continue;
+                        }
+
+                        core::vec2d pos_i = mosaic.get_position(i, s_i);
+                        core::vec2d pos_j = mosaic.get_position(j, s_j);
+                        EXPECT_EQ(memcmp(&pos_i, &pos_j, sizeof(pos_i)), 0) << i << " " << j << " at " << x << ", " << y;
+                        float height_i = mosaic.get_height(pos_i);
+                        float height_j = mosaic.get_height(pos_j);
+                        EXPECT_EQ(memcmp(&height_i, &height_j, sizeof(height_i)), 0) << i << " " << j << " at " << x << ", " << y;
+                        EXPECT_NEAR(pos_i.x, raster_list_[i].ul_corner.x + kTestPixelSize.x * s_i.x, 1e-3 * kTestPixelSize.x);
+                        EXPECT_NEAR(pos_i.y, raster_list_[i].ul_corner.y + kTestPixelSize.y * s_i.y, -1e-3 * kTestPixelSize.y);
+                        num_shared++;
+                    }
+                }
+            }
+        }
+        return num_shared;
+    }
+};
+
+class AlignedElevationMosaicTest : public ElevationMosaicTest
+{
+protected:
+    void SetUp() override
+    {
+        CreateRasters(core::vec2d(0.0, 0.0));
+    }
+};
+
+TEST_F(ElevationMosaicTest, IndexedLookupsMatchTheTileScan)
+{
+    // an unbuilt mosaic has no tile index and tests every tile for every lookup.
+    ElevationMosaic indexed, scanned;
+    OpenMosaic(indexed, true);
+    OpenMosaic(scanned, false);
+
+    mt19937 rng(1);
+    uniform_real_distribution<double> x(-30.0, 470.0), y(-30.0, 220.0);
+    int32_t num_blended = 0;
+    for (int32_t i = 0; i < 20000; i++)
+    {
+        core::vec2d pos = kTestOrigin + kTestPixelSize * core::vec2d(x(rng), y(rng));
+        ASSERT_EQ(indexed.contains(pos), scanned.contains(pos)) << pos.x << ", " << pos.y;
+        float height = indexed.get_height(pos);
+        ASSERT_EQ(height, scanned.get_height(pos)) << pos.x << ", " << pos.y;
+        if (!indexed.contains(pos))
+        {
+            continue;
+        }
+
+        // one raster gives its own field, several a weighted mean of theirs.
+        float min_height = FLT_MAX, max_height = -FLT_MAX;
+        for (size_t j = 0; j < raster_list_.size(); j++)
+        {
+            if (RasterContains(j, pos))
+            {
+                min_height = min(min_height, GetTestHeight(pos, int(j)));
+                max_height = max(max_height, GetTestHeight(pos, int(j)));
+            }
+        }
+        ASSERT_GE(height, min_height - 1e-3f) << pos.x << ", " << pos.y;
+        ASSERT_LE(height, max_height + 1e-3f) << pos.x << ", " << pos.y;
+        num_blended += max_height - min_height > 1.0f ? 1 : 0;
+    }
+    EXPECT_GT(num_blended, 100);
+
+    // the pixel centers on the outer edges are inside, wherever rounding puts them.
+    for (size_t i = 0; i < raster_list_.size(); i++)
+    {
+        const TestRaster& raster = raster_list_[i];
+        for (int y = 0; y < raster.h; y++)
+        {
+            for (int x = 0; x < raster.w; x += (y == 0 || y == raster.h - 1) ? 1 : raster.w - 1)
+            {
+                core::vec2d pos = indexed.get_position(i, core::vec2d(double(x), double(y)));
+                ASSERT_TRUE(indexed.contains(pos)) << i << " at " << x << ", " << y;
+            }
+        }
+    }
+    EXPECT_FALSE(indexed.contains(kTestOrigin + kTestPixelSize * core::vec2d(-0.01, 0.0)));
+}
+
+TEST_F(ElevationMosaicTest, OverlapsFeatherBetweenRasters)
+{
+    ElevationMosaic mosaic;
+    OpenMosaic(mosaic, true);
+
+    // away from every other raster a raster's own field comes back.
+    core::vec2d inside_0 = kTestOrigin + kTestPixelSize * core::vec2d(60.0, 40.0);
+    core::vec2d inside_1 = kTestOrigin + kTestPixelSize * core::vec2d(210.5, 40.25);
+    EXPECT_NEAR(mosaic.get_height(inside_0), GetTestHeight(inside_0, 0), 1e-3);
+    EXPECT_NEAR(mosaic.get_height(inside_1), GetTestHeight(inside_1, 1), 1e-3);
+
+    // in the middle of an overlap both rasters are as far from their edges, an even mix.
+    core::vec2d middle = kTestOrigin + kTestPixelSize * core::vec2d(144.5, 40.0);
+    EXPECT_NEAR(mosaic.get_height(middle), 0.5f * (GetTestHeight(middle, 0) + GetTestHeight(middle, 1)), 1e-3);
+    EXPECT_GT(fabs(GetTestHeight(middle, 0) - GetTestHeight(middle, 1)), 5.0f);
+
+    // no step across the seam, including where raster 0 ends inside raster 1.
+    float last_height = mosaic.get_height(kTestOrigin + kTestPixelSize * core::vec2d(120.0, 40.0));
+    for (double s_x = 120.02; s_x < 170.0; s_x += 0.02)
+    {
+        core::vec2d pos = kTestOrigin + kTestPixelSize * core::vec2d(s_x, 40.0);
+        float height = mosaic.get_height(pos);
+        ASSERT_LT(fabs(height - last_height), 0.05f) << s_x;
+        last_height = height;
+    }
+}
+
+TEST_F(AlignedElevationMosaicTest, OwnedRangesTileTheLatticeOnce)
+{
+    ElevationMosaic mosaic;
+    OpenMosaic(mosaic, true);
+
+    // every cell of the 430 x 190 node lattice is meshed by exactly one raster.
+    vector<int> num_owners = CountCellOwners(mosaic, 429, 189);
+    for (size_t i = 0; i < num_owners.size(); i++)
+    {
+        ASSERT_EQ(num_owners[i], 1) << i % 429 << ", " << i / 429;
+    }
+
+    // neighbours split their overlaps in the middle.
+    core::bounds2d bbox = mosaic.get_owned_pixel_bounds(4);
+    EXPECT_EQ(bbox.bb_min, core::vec2d(4.0, 4.0));
+    EXPECT_EQ(bbox.bb_max, core::vec2d(144.0, 99.0));
+}
+
+TEST_F(ElevationMosaicTest, OwnedRangesLeaveNoHoles)
+{
+    ElevationMosaic mosaic;
+    OpenMosaic(mosaic, true);
+    for (int i = 0; i < num_aligned_; i++)
+    {
+        ASSERT_TRUE(mosaic.is_aligned(i)) << i;
+    }
+    ASSERT_FALSE(mosaic.is_aligned(num_aligned_));
+
+    // a raster off the lattice meshes all of itself.
+    core::bounds2d off_bbox = mosaic.get_owned_pixel_bounds(num_aligned_);
+    EXPECT_EQ(off_bbox.bb_min, core::vec2d(0.0, 0.0));
+    EXPECT_EQ(off_bbox.bb_max, core::vec2d(149.0, 99.0));
+
+    // with the lower right raster off the lattice, rasters 2 and 4 only meet at a
+    // corner that neither can give up. that corner is meshed twice, nothing is missed.
+    vector<int> num_owners = CountCellOwners(mosaic, 429, 189);
+    int32_t num_twice = 0;
+    for (int c_y = 0; c_y < 189; c_y++)
+    {
+        for (int c_x = 0; c_x < 429; c_x++)
+        {
+            int count = num_owners[size_t(c_y) * 429 + c_x];
+            ASSERT_NE(count, 0) << c_x << ", " << c_y;
+            if (count > 1)
+            {
+                EXPECT_TRUE(c_x >= 284 && c_x < 289 && c_y >= 94 && c_y < 99) << c_x << ", " << c_y;
+                num_twice++;
+            }
+        }
+    }
+    EXPECT_EQ(num_twice, 25);
+}
+
+TEST_F(AlignedElevationMosaicTest, SharedNodesAreBitIdentical)
+{
+    ElevationMosaic mosaic;
+    OpenMosaic(mosaic, true);
+
+    // 4 vertical seams of 95 or 96 nodes, 3 horizontal ones and the 2 corners where
+    // four rasters meet, counted by each of the diagonal pairs.
+    EXPECT_EQ(CheckSharedNodes(mosaic), 95 + 95 + 96 + 96 + 145 + 141 + 146 + 4);
+
+    // pixel coordinates within rounding of a node are the node.
+    EXPECT_EQ(mosaic.get_position(1, core::vec2d(3.0 + 1e-12, 7.0 - 1e-12)), mosaic.get_position(1, core::vec2d(3.0, 7.0)));
+}
+
+TEST_F(ElevationMosaicTest, SharedNodesAreBitIdenticalNextToAnOffLatticeRaster)
+{
+    ElevationMosaic mosaic;
+    OpenMosaic(mosaic, true);
+    EXPECT_GT(CheckSharedNodes(mosaic), 500);
+
+    // off the lattice positions come from the raster's own corner.
+    core::vec2d s(12.0, 34.0);
+    core::vec2d pos = mosaic.get_position(num_aligned_, s);
+    EXPECT_NEAR(pos.x, raster_list_[num_aligned_].ul_corner.x + kTestPixelSize.x * s.x, 1e-3 * kTestPixelSize.x);
+    EXPECT_NEAR(pos.y, raster_list_[num_aligned_].ul_corner.y + kTestPixelSize.y * s.y, -1e-3 * kTestPixelSize.y);
+}
+
+TEST_F(ElevationMosaicTest, TilesShareOneCacheBudget)
+{
+    // room for 8 of the 64 x 64 blocks across all 6 rasters, each has 6.
+    const size_t memory_cap = 8 * 64 * 64 * sizeof(float);
+    ElevationMosaic mosaic(memory_cap), unbounded;
+    OpenMosaic(mosaic, true);
+    OpenMosaic(unbounded, true);
+
+    for (double y = 0.0; y < 189.0; y += 0.75)
+    {
+        for (double x = 0.0; x < 429.0; x += 0.75)
+        {
+            core::vec2d pos = kTestOrigin + kTestPixelSize * core::vec2d(x, y);
+            ASSERT_EQ(mosaic.get_height(pos), unbounded.get_height(pos)) << x << ", " << y;
+            ASSERT_LE(mosaic.get_cache()->get_memory_used(), memory_cap);
+        }
+    }
+    EXPECT_GT(mosaic.get_cache()->get_num_evictions(), 0u);
+    EXPECT_EQ(unbounded.get_cache()->get_num_evictions(), 0u);
+
+    mosaic.flush();
+    EXPECT_EQ(mosaic.get_cache()->get_memory_used(), 0u);
+}
+
+TEST(ElevationBlockCacheTest, EvictsLeastRecentlyUsedAcrossGrids)
+{
+    const size_t block_heights = 16;
+    ElevationBlockCache cache(6 * block_heights * sizeof(float));
+    uint32_t grid_a = cache.add_grid();
+    uint32_t grid_b = cache.add_grid();
+
+    for (int i = 0; i < 3; i++)
+    {
+        cache.insert(grid_a, i, block_heights)[0] = float(i);
+        cache.insert(grid_b, i, block_heights)[0] = float(10 + i);
+    }
+    EXPECT_EQ(cache.get_memory_used(), 6 * block_heights * sizeof(float));
+    EXPECT_EQ(cache.get_num_evictions(), 0u);
+
+    // touching a's block 0 leaves b's block 0 the oldest.
+    ASSERT_NE(cache.find(grid_a, 0), nullptr);
+    EXPECT_EQ(cache.find(grid_a, 0)[0], 0.0f);
+    cache.insert(grid_a, 3, block_heights);
+    EXPECT_EQ(cache.find(grid_b, 0), nullptr);
+    EXPECT_NE(cache.find(grid_a, 0), nullptr);
+    EXPECT_EQ(cache.find(grid_b, 1)[0], 11.0f);
+    EXPECT_EQ(cache.get_num_evictions(), 1u);
+
+    cache.erase(grid_a);
+    EXPECT_EQ(cache.find(grid_a, 0), nullptr);
+    EXPECT_EQ(cache.get_memory_used(), 2 * block_heights * sizeof(float));
+}
+
+TEST(ElevationBlockCacheTest, KeepsFourBlocksUnderATinyBudget)
+{
+    ElevationBlockCache cache(1);
+    uint32_t grid = cache.add_grid();
+    for (int i = 0; i < 6; i++)
+    {
+        cache.insert(grid, i, 64);
+    }
+    for (int i = 2; i < 6; i++)
+    {
+        EXPECT_NE(cache.find(grid, i), nullptr) << i;
+    }
+    EXPECT_EQ(cache.find(grid, 1), nullptr);
+}
+}
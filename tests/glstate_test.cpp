@@ -0,0 +1,380 @@
+#include "glstate.h"
+#include "glfunctionlist.h"
+#include "gpaframe.h"
+#include "meshdata.h"
+#include "testgpaframe.h"
+#include <gtest/gtest.h>
+#include <cstring>
+
+extern string g_root_folder_name;
+extern string g_shaders_folder_name;
+
+namespace
+{
+vector<uint8_t> GetReadableBytes(const GlStateEmulator& gl_state, uint64_t key)
+{
+    const GlBufferObject* buffer = gl_state.get_buffer(key);
+    if (!buffer || !buffer->data)
+    {
+        return vector<uint8_t>();
+    }
+    return vector<uint8_t>(buffer->data, buffer->data + buffer->num_bytes);
+}
+
+void PointAttrib(GlStateEmulator& gl_state, uint32_t index, uint32_t name, uint64_t offset)
+{
+    ASSERT_TRUE(gl_state.bind_buffer(kGlArrayBuffer, name));
+    ASSERT_TRUE(gl_state.vertex_attrib_pointer(index, VertexFormat(kGlFloat, 3, false), 0, offset));
+    ASSERT_TRUE(gl_state.enable_vertex_attrib_array(index, true));
+}
+
+TEST(GlStateTest, ElementBufferFollowsTheVertexArray)
+{
+    GlStateEmulator gl_state;
+    ASSERT_TRUE(gl_state.bind_vertex_array(1));
+    ASSERT_TRUE(gl_state.bind_buffer(kGlElementArrayBuffer, 10));
+    uint64_t element_key_1 = gl_state.get_element_buffer();
+    EXPECT_EQ(GetGlObjectName(element_key_1), 10u);
+    PointAttrib(gl_state, 0, 20, 0);
+
+    // a new vertex array starts without an element buffer, the array buffer binding is global.
+    ASSERT_TRUE(gl_state.bind_vertex_array(2));
+    EXPECT_EQ(gl_state.get_element_buffer(), 0u);
+    EXPECT_EQ(gl_state.get_bound_buffer(kGlElementArrayBuffer), 0u);
+    EXPECT_EQ(GetGlObjectName(gl_state.get_bound_buffer(kGlArrayBuffer)), 20u);
+    EXPECT_FALSE(gl_state.get_vertex_attrib(0).b_enabled);
+    ASSERT_TRUE(gl_state.bind_buffer(kGlElementArrayBuffer, 11));
+    uint64_t element_key_2 = gl_state.get_element_buffer();
+    EXPECT_NE(element_key_2, element_key_1);
+
+    ASSERT_TRUE(gl_state.bind_vertex_array(1));
+    EXPECT_EQ(gl_state.get_element_buffer(), element_key_1);
+    EXPECT_TRUE(gl_state.get_vertex_attrib(0).b_enabled);
+    EXPECT_EQ(GetGlObjectName(gl_state.get_vertex_attrib(0).buffer_key), 20u);
+
+    // the default vertex array keeps its own too.
+    ASSERT_TRUE(gl_state.bind_vertex_array(0));
+    EXPECT_EQ(gl_state.get_element_buffer(), 0u);
+    ASSERT_TRUE(gl_state.bind_buffer(kGlElementArrayBuffer, 12));
+    ASSERT_TRUE(gl_state.bind_vertex_array(2));
+    EXPECT_EQ(gl_state.get_element_buffer(), element_key_2);
+    ASSERT_TRUE(gl_state.bind_vertex_array(0));
+    EXPECT_EQ(GetGlObjectName(gl_state.get_element_buffer()), 12u);
+}
+
+TEST(GlStateTest, BufferDataOrphansTheStore)
+{
+    const uint8_t first[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    const uint8_t second[4] = { 9, 10, 11, 12 };
+    GlStateEmulator gl_state;
+    PointAttrib(gl_state, 0, 5, 0);
+    ASSERT_TRUE(gl_state.buffer_data(kGlArrayBuffer, first, sizeof(first), kGlStaticDraw));
+    uint64_t key = gl_state.get_vertex_attrib(0).buffer_key;
+    EXPECT_EQ(GetReadableBytes(gl_state, key), vector<uint8_t>(first, first + 8));
+
+    // a draw read the first store, respecifying it reads the new data under the same object.
+    ASSERT_TRUE(gl_state.buffer_sub_data(kGlArrayBuffer, 0, second, 2));
+    ASSERT_TRUE(gl_state.buffer_data(kGlArrayBuffer, second, sizeof(second), kGlStaticDraw));
+    EXPECT_EQ(gl_state.get_bound_buffer(kGlArrayBuffer), key);
+    const GlBufferObject* buffer = gl_state.get_buffer(key);
+    ASSERT_NE(buffer, nullptr);
+    EXPECT_EQ(buffer->data, second);
+    EXPECT_EQ(buffer->size, sizeof(second));
+    EXPECT_TRUE(buffer->owned_data.empty());
+    EXPECT_EQ(GetReadableBytes(gl_state, key), vector<uint8_t>(second, second + 4));
+    EXPECT_EQ(first[0], 1);
+
+    // without data nothing is readable until written.
+    ASSERT_TRUE(gl_state.buffer_data(kGlArrayBuffer, nullptr, 16, kGlStaticDraw));
+    EXPECT_EQ(gl_state.get_buffer(key)->size, 16u);
+    EXPECT_TRUE(GetReadableBytes(gl_state, key).empty());
+
+    // nothing bound, nothing to respecify.
+    ASSERT_TRUE(gl_state.bind_buffer(kGlArrayBuffer, 0));
+    EXPECT_FALSE(gl_state.buffer_data(kGlArrayBuffer, first, sizeof(first), kGlStaticDraw));
+    EXPECT_FALSE(gl_state.buffer_data(0x1234, first, sizeof(first), kGlStaticDraw));
+}
+
+TEST(GlStateTest, BufferSubDataCopiesOnWrite)
+{
+    const uint8_t capture[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    const uint8_t patch[3] = { 20, 21, 22 };
+    GlStateEmulator gl_state;
+    ASSERT_TRUE(gl_state.bind_buffer(kGlArrayBuffer, 3));
+    ASSERT_TRUE(gl_state.buffer_data(kGlArrayBuffer, capture, sizeof(capture), kGlStaticDraw));
+    uint64_t key = gl_state.get_bound_buffer(kGlArrayBuffer);
+
+    ASSERT_TRUE(gl_state.buffer_sub_data(kGlArrayBuffer, 2, patch, sizeof(patch)));
+    const uint8_t expected[8] = { 1, 2, 20, 21, 22, 6, 7, 8 };
+    EXPECT_EQ(GetReadableBytes(gl_state, key), vector<uint8_t>(expected, expected + 8));
+    // the capture is never written.
+    EXPECT_EQ(capture[2], 3);
+    const uint8_t* owned = gl_state.get_buffer(key)->data;
+    EXPECT_NE(owned, capture);
+
+    // later writes go to the copy made by the first.
+    ASSERT_TRUE(gl_state.buffer_sub_data(kGlArrayBuffer, 7, patch, 1));
+    EXPECT_EQ(gl_state.get_buffer(key)->data, owned);
+    EXPECT_EQ(GetReadableBytes(gl_state, key)[7], 20);
+
+    // past the end of the store is an error and changes nothing.
+    EXPECT_FALSE(gl_state.buffer_sub_data(kGlArrayBuffer, 6, patch, 3));
+    EXPECT_FALSE(gl_state.buffer_sub_data(kGlArrayBuffer, 9, patch, 0));
+    EXPECT_EQ(GetReadableBytes(gl_state, key)[6], 7);
+
+    // a store made without data is readable as far as it has been written.
+    ASSERT_TRUE(gl_state.buffer_data(kGlArrayBuffer, nullptr, 16, kGlStaticDraw));
+    ASSERT_TRUE(gl_state.buffer_sub_data(kGlArrayBuffer, 8, patch, sizeof(patch)));
+    vector<uint8_t> readable = GetReadableBytes(gl_state, key);
+    ASSERT_EQ(readable.size(), 11u);
+    EXPECT_EQ(readable[0], 0);
+    EXPECT_EQ(readable[10], 22);
+}
+
+TEST(GlStateTest, DeletedNamesComeBackAsNewObjects)
+{
+    const uint8_t first[4] = { 1, 2, 3, 4 };
+    GlStateEmulator gl_state;
+    ASSERT_TRUE(gl_state.bind_buffer(kGlArrayBuffer, 7));
+    ASSERT_TRUE(gl_state.buffer_data(kGlArrayBuffer, first, sizeof(first), kGlStaticDraw));
+    uint64_t old_key = gl_state.get_bound_buffer(kGlArrayBuffer);
+
+    uint32_t name = 7;
+    gl_state.delete_buffers(&name, 1);
+    EXPECT_EQ(gl_state.get_bound_buffer(kGlArrayBuffer), 0u);
+
+    ASSERT_TRUE(gl_state.bind_buffer(kGlArrayBuffer, 7));
+    uint64_t new_key = gl_state.get_bound_buffer(kGlArrayBuffer);
+    EXPECT_EQ(GetGlObjectName(new_key), 7u);
+    EXPECT_NE(new_key, old_key);
+    EXPECT_TRUE(GetReadableBytes(gl_state, new_key).empty());
+    EXPECT_EQ(GetReadableBytes(gl_state, old_key), vector<uint8_t>(first, first + 4));
+
+    // names never made and name 0 are ignored.
+    uint32_t other_name_list[2] = { 0, 99 };
+    gl_state.delete_buffers(other_name_list, 2);
+    EXPECT_EQ(gl_state.get_bound_buffer(kGlArrayBuffer), new_key);
+
+    // the same for vertex arrays.
+    ASSERT_TRUE(gl_state.bind_vertex_array(4));
+    uint64_t old_vertex_array = gl_state.get_bound_vertex_array();
+    name = 4;
+    gl_state.delete_vertex_arrays(&name, 1);
+    EXPECT_EQ(gl_state.get_bound_vertex_array(), 0u);
+    ASSERT_TRUE(gl_state.bind_vertex_array(4));
+    EXPECT_NE(gl_state.get_bound_vertex_array(), old_vertex_array);
+}
+
+TEST(GlStateTest, DeleteBuffersLeavesOtherVertexArraysAttached)
+{
+    const uint8_t vertex_data[12] = {};
+    const uint8_t index_data[6] = {};
+    GlStateEmulator gl_state;
+    ASSERT_TRUE(gl_state.bind_vertex_array(1));
+    PointAttrib(gl_state, 0, 30, 0);
+    ASSERT_TRUE(gl_state.buffer_data(kGlArrayBuffer, vertex_data, sizeof(vertex_data), kGlStaticDraw));
+    ASSERT_TRUE(gl_state.bind_buffer(kGlElementArrayBuffer, 31));
+    ASSERT_TRUE(gl_state.buffer_data(kGlElementArrayBuffer, index_data, sizeof(index_data), kGlStaticDraw));
+    uint64_t vertex_key = gl_state.get_vertex_attrib(0).buffer_key;
+    uint64_t element_key = gl_state.get_element_buffer();
+
+    ASSERT_TRUE(gl_state.bind_vertex_array(2));
+    PointAttrib(gl_state, 0, 30, 0);
+    ASSERT_TRUE(gl_state.bind_buffer(kGlElementArrayBuffer, 31));
+
+    // deleted while vertex array 2 is bound, only its attachments go.
+    const uint32_t name_list[2] = { 30, 31 };
+    gl_state.delete_buffers(name_list, 2);
+    EXPECT_EQ(gl_state.get_vertex_attrib(0).buffer_key, 0u);
+    EXPECT_EQ(gl_state.get_element_buffer(), 0u);
+    EXPECT_EQ(gl_state.get_bound_buffer(kGlArrayBuffer), 0u);
+
+    ASSERT_TRUE(gl_state.bind_vertex_array(1));
+    EXPECT_EQ(gl_state.get_vertex_attrib(0).buffer_key, vertex_key);
+    EXPECT_EQ(gl_state.get_element_buffer(), element_key);
+    EXPECT_EQ(GetReadableBytes(gl_state, vertex_key).size(), sizeof(vertex_data));
+    EXPECT_EQ(GetReadableBytes(gl_state, element_key).size(), sizeof(index_data));
+}
+
+TEST(GlStateTest, TexturesBindPerUnitAndTarget)
+{
+    for (uint32_t face = kGlTextureCubemapPositiveXArb; face <= kGlTextureCubemapNegativeZArb; face++)
+    {
+        EXPECT_EQ(GetGlTextureBindTarget(face), uint32_t(kGlTextureCubemapArb)) << face;
+    }
+    // the binding and proxy enums on either side are not faces.
+    EXPECT_EQ(GetGlTextureBindTarget(kGlTextureCubemapPositiveXArb - 1), uint32_t(kGlTextureCubemapPositiveXArb - 1));
+    EXPECT_EQ(GetGlTextureBindTarget(kGlTextureCubemapNegativeZArb + 1), uint32_t(kGlTextureCubemapNegativeZArb + 1));
+    EXPECT_EQ(GetGlTextureBindTarget(kGlTexture2D), uint32_t(kGlTexture2D));
+    EXPECT_EQ(GetGlTextureBindTarget(kGlTextureCubemapArb), uint32_t(kGlTextureCubemapArb));
+
+    GlStateEmulator gl_state;
+    ASSERT_TRUE(gl_state.bind_texture(kGlTexture2D, 1));
+    ASSERT_TRUE(gl_state.active_texture(3));
+    ASSERT_TRUE(gl_state.bind_texture(kGlTexture2D, 1));
+    ASSERT_TRUE(gl_state.bind_texture(kGlTextureCubemapArb, 2));
+    uint64_t texture_key = gl_state.get_bound_texture(3, kGlTexture2D);
+    EXPECT_EQ(gl_state.get_bound_texture(0, kGlTexture2D), texture_key);
+    EXPECT_EQ(GetGlObjectName(gl_state.get_bound_texture(3, kGlTextureCubemapArb)), 2u);
+    EXPECT_EQ(gl_state.get_bound_texture(0, kGlTextureCubemapArb), 0u);
+    EXPECT_FALSE(gl_state.active_texture(kGlMaxTextureUnits));
+
+    // a texture keeps the target of its first bind.
+    EXPECT_FALSE(gl_state.bind_texture(kGlTextureCubemapArb, 1));
+    EXPECT_FALSE(gl_state.bind_texture(kGlTextureCubemapPositiveXArb, 3));
+
+    // deleting unbinds it from every unit, the object stays for meshes already using it.
+    const uint32_t name = 1;
+    gl_state.delete_textures(&name, 1);
+    EXPECT_EQ(gl_state.get_bound_texture(0, kGlTexture2D), 0u);
+    EXPECT_EQ(gl_state.get_bound_texture(3, kGlTexture2D), 0u);
+    EXPECT_NE(gl_state.get_texture(texture_key), nullptr);
+    ASSERT_TRUE(gl_state.bind_texture(kGlTexture2D, 1));
+    EXPECT_NE(gl_state.get_bound_texture(3, kGlTexture2D), texture_key);
+}
+
+// the capture numbers the calls of each gl version in the order of its header, gl2.h
+// sorted, gl3.h as declared. the ids the replay added are checked against the ids of
+// their neighbours that were in the table before.
+TEST(GlStateTest, CallTagsFollowTheHeaderOrder)
+{
+    // gl2.h: glCullFace, glDeleteBuffers, ... glDeleteShader, glDeleteTextures.
+    EXPECT_EQ(kGlDeleteBuffers, kGlCullFace + 1);
+    EXPECT_EQ(kGlDeleteTextures, kGlDeleteShader + 1);
+    // gl3.h: glBindVertexArray, glDeleteVertexArrays, glGenVertexArrays.
+    EXPECT_EQ(kGlDeleteVertexArrays, kGlBindVertexArray + 1);
+    EXPECT_EQ(kGlGenVertexArrays, kGlBindVertexArray + 2);
+    // gl3.h: glDrawArraysInstanced, glDrawElementsInstanced, 12 sync and sampler calls,
+    // glBindSampler, 6 sampler parameter calls, glVertexAttribDivisor, glBindTransformFeedback.
+    EXPECT_EQ(kGlDrawElementsInstanced, kGlDrawArraysInstanced + 1);
+    EXPECT_EQ(kGlBindSampler, kGlDrawArraysInstanced + 14);
+    EXPECT_EQ(kGlVertexAttribDivisor, kGlBindSampler + 7);
+    EXPECT_EQ(kGlBindTransformFeedback, kGlVertexAttribDivisor + 1);
+}
+
+struct ReplayedMesh
+{
+    vector<core::vec3f>     vertex_list;
+    vector<uint32_t>        index_list;
+};
+
+// the meshes parsed out of a frame, in world order, with positions looked up by index.
+vector<ReplayedMesh> ReplayFrame(const vector<uint8_t>& frame, GpaParseReport& report)
+{
+    // a folder that does not exist, so nothing the parser writes lands in the test folder.
+    g_root_folder_name = "glstate_test_no_output";
+    g_shaders_folder_name = "glstate_test_no_output";
+
+    GroupMeshData group_mesh_data;
+    ParseGpaFrame(frame.data(), frame.size(), &group_mesh_data, &report);
+    vector<ReplayedMesh> mesh_list;
+    for (auto& mesh_data : group_mesh_data.meshes)
+    {
+        ReplayedMesh mesh;
+        for (int32_t i = 0; i < mesh_data->draw_call_list[0].get_index_count(); i++)
+        {
+            uint32_t idx = mesh_data->draw_call_list[0].get_index(i);
+            mesh.index_list.push_back(idx);
+            mesh.vertex_list.push_back(mesh_data->vertex_list[idx]);
+        }
+        mesh_list.push_back(move(mesh));
+        SAFE_DELETE(mesh_data);
+    }
+    for (auto& texture : group_mesh_data.loaded_textures)
+    {
+        SAFE_DELETE(texture);
+    }
+    return mesh_list;
+}
+
+// a frame exercising the object state through the parser: every draw has to read the
+// buffers as they were at its point in the frame.
+TEST(GlStateTest, ReplayReadsBuffersAsEachDrawSawThem)
+{
+    const float quad[4][3] = { { 0, 0, 0 }, { 1, 0, 0 }, { 1, 1, 0 }, { 0, 1, 0 } };
+    const float moved_vertex[3] = { 5, 5, 5 };
+    const float triangle[3][3] = { { 7, 0, 0 }, { 8, 0, 0 }, { 8, 1, 0 } };
+    const float uv[4][2] = {};
+    const uint16_t quad_index[6] = { 0, 1, 2, 0, 2, 3 };
+    const uint16_t triangle_index[3] = { 2, 1, 0 };
+
+    TestGpaFrameWriter writer;
+    uint32_t offset_0 = writer.add_words({ 0 });
+    uint32_t quad_data = writer.add_data(kArrayBufferBlock, quad, sizeof(quad));
+    uint32_t uv_data = writer.add_data(kArrayBufferBlock, uv, sizeof(uv));
+    uint32_t quad_index_data = writer.add_data(kArrayBufferBlock, quad_index, sizeof(quad_index));
+    uint32_t moved_data = writer.add_data(kArrayBufferBlock, moved_vertex, sizeof(moved_vertex));
+    uint32_t triangle_data = writer.add_data(kArrayBufferBlock, triangle, sizeof(triangle));
+    uint32_t triangle_index_data = writer.add_data(kArrayBufferBlock, triangle_index, sizeof(triangle_index));
+    uint32_t deleted_names = writer.add_words({ 1, 3 });
+
+    auto draw = [&]() { writer.add_command(kGlDrawElements, { kGlTriangles, 3, kGlUShort, offset_0 }); };
+
+    // vertex array 1: positions in buffer 1, uvs in buffer 2, indexes in buffer 3.
+    writer.add_command(kGlBindVertexArray, { 1 });
+    writer.add_command(kGlBindBuffer, { kGlArrayBuffer, 1 });
+    writer.add_command(kGlBufferData, { kGlArrayBuffer, sizeof(quad), quad_data, kGlStaticDraw });
+    writer.add_command(kGlVertexAttribPointer, { 0, 3, kGlFloat, 0, 12, offset_0 });
+    writer.add_command(kGlEnableVertexAttribArray, { 0 });
+    writer.add_command(kGlBindBuffer, { kGlArrayBuffer, 2 });
+    writer.add_command(kGlBufferData, { kGlArrayBuffer, sizeof(uv), uv_data, kGlStaticDraw });
+    writer.add_command(kGlVertexAttribPointer, { 3, 2, kGlFloat, 0, 8, offset_0 });
+    writer.add_command(kGlEnableVertexAttribArray, { 3 });
+    writer.add_command(kGlBindBuffer, { kGlElementArrayBuffer, 3 });
+    writer.add_command(kGlBufferData, { kGlElementArrayBuffer, sizeof(quad_index), quad_index_data, kGlStaticDraw });
+    draw();
+
+    // sub data moves vertex 1, the draw before keeps the old position.
+    writer.add_command(kGlBindBuffer, { kGlArrayBuffer, 1 });
+    writer.add_command(kGlBufferSubData, { kGlArrayBuffer, 12, 12, moved_data });
+    draw();
+
+    // vertex array 2 has its own element buffer 4 over buffer 5.
+    writer.add_command(kGlBindVertexArray, { 2 });
+    writer.add_command(kGlBindBuffer, { kGlArrayBuffer, 5 });
+    writer.add_command(kGlBufferData, { kGlArrayBuffer, sizeof(triangle), triangle_data, kGlStaticDraw });
+    writer.add_command(kGlVertexAttribPointer, { 0, 3, kGlFloat, 0, 12, offset_0 });
+    writer.add_command(kGlEnableVertexAttribArray, { 0 });
+    writer.add_command(kGlBindBuffer, { kGlArrayBuffer, 2 });
+    writer.add_command(kGlVertexAttribPointer, { 3, 2, kGlFloat, 0, 8, offset_0 });
+    writer.add_command(kGlEnableVertexAttribArray, { 3 });
+    writer.add_command(kGlBindBuffer, { kGlElementArrayBuffer, 4 });
+    writer.add_command(kGlBufferData, { kGlElementArrayBuffer, sizeof(triangle_index), triangle_index_data, kGlStaticDraw });
+    draw();
+
+    // buffers 1 and 3 deleted while vertex array 2 is bound, vertex array 1 still draws them.
+    writer.add_command(kGlDeleteBuffers, { 2, deleted_names });
+    writer.add_command(kGlBindVertexArray, { 1 });
+    draw();
+
+    // buffer 1 orphaned with the triangle, the name is a new object, vertex array 1 is not
+    // attached to it.
+    writer.add_command(kGlBindBuffer, { kGlArrayBuffer, 1 });
+    writer.add_command(kGlBufferData, { kGlArrayBuffer, sizeof(triangle), triangle_data, kGlStaticDraw });
+    draw();
+    writer.add_command(kGlVertexAttribPointer, { 0, 3, kGlFloat, 0, 12, offset_0 });
+    draw();
+
+    GpaParseReport report;
+    vector<ReplayedMesh> mesh_list = ReplayFrame(writer.finish(), report);
+    EXPECT_TRUE(report.error_list.empty()) << FormatGpaParseError(report.error_list[0]);
+    ASSERT_EQ(mesh_list.size(), 6u);
+
+    auto expect_positions = [](const ReplayedMesh& mesh, const vector<core::vec3f>& expected, int32_t draw_idx)
+    {
+        ASSERT_EQ(mesh.vertex_list.size(), expected.size()) << "draw " << draw_idx;
+        for (size_t i = 0; i < expected.size(); i++)
+        {
+            EXPECT_EQ(mesh.vertex_list[i], expected[i]) << "draw " << draw_idx << " corner " << i;
+        }
+    };
+    core::vec3f q0(0, 0, 0), q1(1, 0, 0), q2(1, 1, 0), moved(5, 5, 5);
+    core::vec3f t0(7, 0, 0), t1(8, 0, 0), t2(8, 1, 0);
+    expect_positions(mesh_list[0], { q0, q1, q2 }, 0);
+    expect_positions(mesh_list[1], { q0, moved, q2 }, 1);
+    expect_positions(mesh_list[2], { t2, t1, t0 }, 2);
+    expect_positions(mesh_list[3], { q0, moved, q2 }, 3);
+    expect_positions(mesh_list[4], { q0, moved, q2 }, 4);
+    expect_positions(mesh_list[5], { t0, t1, t2 }, 5);
+}
+}
@@ -0,0 +1,291 @@
+#include "gpadiff.h"
+#include "meshdata.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <random>
+
+namespace
+{
+// a small triangle mesh of random vertices around center, placed by dumpped_matrix as captures are.
+MeshData* CreateTestMesh(const core::vec3d& center, uint32_t num_vertex, mt19937& rng, double radius = 2.0)
+{
+    uniform_real_distribution<float> offset(-float(radius), float(radius));
+    MeshData* mesh_data = new MeshData;
+    mesh_data->num_vertex = int(num_vertex);
+    mesh_data->vertex_list = make_unique<core::vec3f[]>(num_vertex);
+    for (uint32_t i = 0; i < num_vertex; i++)
+    {
+        mesh_data->vertex_list[i] = core::vec3f(offset(rng), offset(rng), offset(rng));
+    }
+    for (int32_t c = 0; c < 3; c++)
+    {
+        mesh_data->dumpped_matrix(3, c) = center[c];
+    }
+
+    mesh_data->add_draw_call_list(kGlTriangles, int(num_vertex / 3 * 3), int(num_vertex));
+    for (uint32_t i = 0; i < num_vertex / 3 * 3; i++)
+    {
+        mesh_data->get_last_draw_call_info().add_index(i);
+    }
+    return mesh_data;
+}
+
+MeshData* CopyTestMesh(const MeshData& mesh_data)
+{
+    MeshData* copy = new MeshData;
+    copy->num_vertex = mesh_data.num_vertex;
+    copy->dumpped_matrix = mesh_data.dumpped_matrix;
+    copy->vertex_list = make_unique<core::vec3f[]>(uint32_t(mesh_data.num_vertex));
+    std::copy(mesh_data.vertex_list.get(), mesh_data.vertex_list.get() + mesh_data.num_vertex, copy->vertex_list.get());
+    copy->add_draw_call_list(kGlTriangles, mesh_data.draw_call_list[0].get_index_count(), mesh_data.num_vertex);
+    for (int i = 0; i < mesh_data.draw_call_list[0].get_index_count(); i++)
+    {
+        copy->get_last_draw_call_info().add_index(mesh_data.draw_call_list[0].get_index(i));
+    }
+    return copy;
+}
+
+struct TestGroup
+{
+    GroupMeshData   group_mesh_data;
+
+    ~TestGroup()
+    {
+        for (auto& mesh_data : group_mesh_data.meshes)
+        {
+            SAFE_DELETE(mesh_data);
+        }
+    }
+
+    void add(MeshData* mesh_data) { group_mesh_data.meshes.push_back(mesh_data); }
+};
+
+// the centers of n meshes on a grid 50 units apart, far more than the match distance.
+core::vec3d GetGridCenter(uint32_t i)
+{
+    return core::vec3d(50.0 * (i % 100), 50.0 * ((i / 100) % 100), 50.0 * (i / 10000));
+}
+
+vector<core::vec3d> GetPositions(const MeshData& mesh_data)
+{
+    vector<core::vec3d> position_list;
+    for (int i = 0; i < mesh_data.num_vertex; i++)
+    {
+        const core::vec3f& v = mesh_data.vertex_list[uint32_t(i)];
+        core::vec4d p = core::vec4d(v.x, v.y, v.z, 1.0) * mesh_data.dumpped_matrix;
+        position_list.push_back(core::vec3d(p.x, p.y, p.z));
+    }
+    return position_list;
+}
+
+double GetBruteForceDistance(const core::vec3d& p, const vector<core::vec3d>& point_list)
+{
+    double best = DBL_MAX;
+    for (const auto& q : point_list)
+    {
+        best = min(best, core::length(q - p));
+    }
+    return best;
+}
+
+TEST(GpaDiffTest, MeshesAreSortedIntoUnchangedChangedAddedRemoved)
+{
+    mt19937 rng(3);
+    TestGroup old_group, new_group;
+    for (uint32_t i = 0; i < 50; i++)
+    {
+        old_group.add(CreateTestMesh(GetGridCenter(i), 12, rng));
+    }
+
+    // meshes 0-4 are gone, 5-9 have a vertex moved, 10-49 are kept, and 4 more come in.
+    for (uint32_t i = 5; i < 50; i++)
+    {
+        MeshData* mesh_data = CopyTestMesh(*old_group.group_mesh_data.meshes[i]);
+        if (i < 10)
+        {
+            mesh_data->vertex_list[3].x += 0.5f;
+        }
+        new_group.add(mesh_data);
+    }
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        new_group.add(CreateTestMesh(GetGridCenter(60 + i), 9, rng));
+    }
+
+    CaptureDiff diff;
+    DiffCaptureMeshes(old_group.group_mesh_data, new_group.group_mesh_data, MeshDiffOptions(), diff);
+    EXPECT_EQ(diff.num_unchanged, 40u);
+    EXPECT_EQ(diff.num_changed, 5u);
+    EXPECT_EQ(diff.num_added, 4u);
+    EXPECT_EQ(diff.num_removed, 5u);
+    ASSERT_EQ(diff.entry_list.size(), 54u);
+
+    for (const auto& entry : diff.entry_list)
+    {
+        if (entry.type == kMeshDiffRemoved)
+        {
+            EXPECT_LT(entry.old_idx, 5u);
+        }
+        else if (entry.type == kMeshDiffAdded)
+        {
+            EXPECT_GE(entry.new_idx, 45u);
+            EXPECT_EQ(entry.new_num_vertex, 9u);
+        }
+        else
+        {
+            // new meshes are the old ones from 5 on.
+            EXPECT_EQ(entry.new_idx + 5, entry.old_idx);
+            EXPECT_EQ(entry.type, entry.old_idx < 10 ? kMeshDiffChanged : kMeshDiffUnchanged) << entry.old_idx;
+            EXPECT_EQ(entry.old_hash == entry.new_hash, entry.type == kMeshDiffUnchanged);
+            if (entry.type == kMeshDiffChanged)
+            {
+                EXPECT_NEAR(entry.deviation.max_distance, 0.5, 1e-5);
+                EXPECT_FALSE(entry.b_texture_changed);
+            }
+        }
+    }
+}
+
+// the new capture is the old one turned and moved as a whole, the unchanged meshes have to
+// bring it back and nothing counts as moved.
+TEST(GpaDiffTest, RigidOffsetBetweenCapturesIsRecovered)
+{
+    mt19937 rng(4);
+    const double angle = 0.3;
+    core::matrix4d offset_mat;
+    offset_mat(0, 0) = cos(angle);
+    offset_mat(0, 1) = sin(angle);
+    offset_mat(1, 0) = -sin(angle);
+    offset_mat(1, 1) = cos(angle);
+    offset_mat(3, 0) = 1234.5;
+    offset_mat(3, 1) = -321.25;
+    offset_mat(3, 2) = 17.0;
+
+    TestGroup old_group, new_group;
+    for (uint32_t i = 0; i < 30; i++)
+    {
+        old_group.add(CreateTestMesh(GetGridCenter(i), 12, rng));
+        MeshData* mesh_data = CopyTestMesh(*old_group.group_mesh_data.meshes[i]);
+        mesh_data->dumpped_matrix = mesh_data->dumpped_matrix * offset_mat;
+        new_group.add(mesh_data);
+    }
+    // one changed in place, it has to be compared after the offset is taken out.
+    new_group.group_mesh_data.meshes[7]->vertex_list[0].y += 0.25f;
+
+    CaptureDiff diff;
+    DiffCaptureMeshes(old_group.group_mesh_data, new_group.group_mesh_data, MeshDiffOptions(), diff);
+    ASSERT_TRUE(diff.b_aligned);
+    EXPECT_EQ(diff.num_unchanged, 29u);
+    EXPECT_EQ(diff.num_changed, 1u);
+    EXPECT_EQ(diff.num_added, 0u);
+    EXPECT_EQ(diff.num_removed, 0u);
+    EXPECT_NEAR(diff.entry_list[7].deviation.max_distance, 0.25, 1e-4);
+
+    for (const auto& p : { core::vec3d(0, 0, 0), core::vec3d(100, -40, 7), core::vec3d(-2000, 3000, 50) })
+    {
+        core::vec4d q = core::vec4d(p.x, p.y, p.z, 1.0) * offset_mat * diff.new_to_old;
+        EXPECT_NEAR(q.x, p.x, 1e-6);
+        EXPECT_NEAR(q.y, p.y, 1e-6);
+        EXPECT_NEAR(q.z, p.z, 1e-6);
+    }
+
+    // without alignment every mesh is far from where it was.
+    MeshDiffOptions options;
+    options.align_captures = false;
+    DiffCaptureMeshes(old_group.group_mesh_data, new_group.group_mesh_data, options, diff);
+    EXPECT_FALSE(diff.b_aligned);
+    EXPECT_EQ(diff.num_unchanged, 0u);
+}
+
+// the vertex deviation of changed meshes goes through the nearest point grid, it has to
+// agree with comparing every vertex against every other, clustered sets and outliers included.
+TEST(GpaDiffTest, DeviationMatchesBruteForce)
+{
+    mt19937 rng(5);
+    uniform_real_distribution<double> unit(0.0, 1.0);
+    TestGroup old_group, new_group;
+    for (uint32_t i = 0; i < 20; i++)
+    {
+        uint32_t num_vertex = 3 + uint32_t(unit(rng) * 400);
+        MeshData* old_mesh = CreateTestMesh(GetGridCenter(i), num_vertex, rng, 0.5 + unit(rng) * 4.0);
+        MeshData* new_mesh = CreateTestMesh(GetGridCenter(i), 3 + uint32_t(unit(rng) * 400), rng, 0.5 + unit(rng) * 4.0);
+        // a tight cluster with one vertex far out stretches the grid cells.
+        if (i % 4 == 0)
+        {
+            for (int v = 0; v < new_mesh->num_vertex; v++)
+            {
+                new_mesh->vertex_list[uint32_t(v)] = new_mesh->vertex_list[uint32_t(v)] * 0.01f;
+            }
+            new_mesh->vertex_list[0] = core::vec3f(4.5f, -4.5f, 4.0f);
+        }
+        old_group.add(old_mesh);
+        new_group.add(new_mesh);
+    }
+
+    MeshDiffOptions options;
+    options.align_captures = false;
+    CaptureDiff diff;
+    DiffCaptureMeshes(old_group.group_mesh_data, new_group.group_mesh_data, options, diff);
+    ASSERT_EQ(diff.num_changed, 20u);
+
+    for (const auto& entry : diff.entry_list)
+    {
+        vector<core::vec3d> old_list = GetPositions(*old_group.group_mesh_data.meshes[entry.old_idx]);
+        vector<core::vec3d> new_list = GetPositions(*new_group.group_mesh_data.meshes[entry.new_idx]);
+        vector<double> dist_list;
+        double max_distance = 0.0, sum = 0.0, sum_2 = 0.0;
+        for (const auto& p : old_list)
+        {
+            double d = GetBruteForceDistance(p, new_list);
+            dist_list.push_back(d);
+            max_distance = max(max_distance, d);
+            sum += d;
+            sum_2 += d * d;
+        }
+        for (const auto& p : new_list)
+        {
+            max_distance = max(max_distance, GetBruteForceDistance(p, old_list));
+        }
+        sort(dist_list.begin(), dist_list.end());
+
+        EXPECT_DOUBLE_EQ(entry.deviation.max_distance, max_distance) << "mesh " << entry.old_idx;
+        EXPECT_NEAR(entry.deviation.mean_distance, sum / double(old_list.size()), 1e-9) << "mesh " << entry.old_idx;
+        EXPECT_NEAR(entry.deviation.rms_distance, sqrt(sum_2 / double(old_list.size())), 1e-9) << "mesh " << entry.old_idx;
+        size_t p95_idx = min(dist_list.size() - 1, size_t(double(dist_list.size()) * 0.95));
+        EXPECT_DOUBLE_EQ(entry.deviation.p95_distance, dist_list[p95_idx]) << "mesh " << entry.old_idx;
+    }
+}
+
+// nothing is compared all against all, a capture of 100k meshes diffs in seconds.
+TEST(GpaDiffTest, HundredThousandMeshesDiffQuickly)
+{
+    const uint32_t num_meshes = 100000;
+    mt19937 rng(6);
+    TestGroup old_group, new_group;
+    old_group.group_mesh_data.meshes.reserve(num_meshes);
+    new_group.group_mesh_data.meshes.reserve(num_meshes);
+    for (uint32_t i = 0; i < num_meshes; i++)
+    {
+        old_group.add(CreateTestMesh(GetGridCenter(i), 6, rng));
+        MeshData* mesh_data = CopyTestMesh(*old_group.group_mesh_data.meshes[i]);
+        if (i % 100 == 0)
+        {
+            mesh_data->vertex_list[1].z += 0.1f;
+        }
+        new_group.add(mesh_data);
+    }
+
+    auto start = chrono::steady_clock::now();
+    CaptureDiff diff;
+    DiffCaptureMeshes(old_group.group_mesh_data, new_group.group_mesh_data, MeshDiffOptions(), diff);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    EXPECT_EQ(diff.num_unchanged, num_meshes - num_meshes / 100);
+    EXPECT_EQ(diff.num_changed, num_meshes / 100);
+    EXPECT_EQ(diff.num_added + diff.num_removed, 0u);
+    // all against all would be 10^10 pairs, far over this even on one core.
+    EXPECT_LT(seconds, 10.0);
+}
+}
@@ -0,0 +1,288 @@
+#include "gpaframe.h"
+#include "glfunctionlist.h"
+#include "meshdata.h"
+#include "testgpaframe.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+extern string g_root_folder_name;
+extern string g_shaders_folder_name;
+
+namespace
+{
+const char* kFrameFileName = "gpaframe_test.gpa_frame";
+
+// indexed strips, each draw with its own vertex and element buffer.
+vector<uint8_t> CreateTestFrame(uint32_t num_draws, float vertex_bias)
+{
+    const float matrix[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+    TestGpaFrameWriter writer;
+    uint32_t offset_0 = writer.add_words({ 0 });
+    uint32_t matrix_data = writer.add_data(kParamsBlock, matrix, sizeof(matrix));
+    const uint16_t strip_index[4] = { 0, 1, 2, 3 };
+    uint32_t index_data = writer.add_data(kArrayBufferBlock, strip_index, sizeof(strip_index));
+    for (uint32_t i_draw = 0; i_draw < num_draws; i_draw++)
+    {
+        float vertex_list[12];
+        for (uint32_t i = 0; i < 12; i++)
+        {
+            vertex_list[i] = vertex_bias + float(i_draw * 12 + i);
+        }
+        uint32_t vertex_data = writer.add_data(kArrayBufferBlock, vertex_list, sizeof(vertex_list));
+
+        writer.add_command(kGlBindBuffer, { kGlArrayBuffer, 1 + i_draw });
+        writer.add_command(kGlBufferData, { kGlArrayBuffer, sizeof(vertex_list), vertex_data, kGlStaticDraw });
+        writer.add_command(kGlVertexAttribPointer, { 0, 3, kGlFloat, 0, 12, offset_0 });
+        writer.add_command(kGlEnableVertexAttribArray, { 0 });
+        writer.add_command(kGlBindBuffer, { kGlElementArrayBuffer, 1001 + i_draw });
+        writer.add_command(kGlBufferData, { kGlElementArrayBuffer, sizeof(strip_index), index_data, kGlStaticDraw });
+        writer.add_command(kGlUniformMatrix4fv, { 0, 1, 0, matrix_data });
+        writer.add_command(kGlDrawElements, { kGlTriangleStrip, 4, kGlUShort, offset_0 });
+    }
+    return writer.finish();
+}
+
+void WriteFile(const string& file_name, const vector<uint8_t>& data)
+{
+    ofstream file(file_name, ofstream::binary | ofstream::trunc);
+    file.write(reinterpret_cast<const char*>(data.data()), streamsize(data.size()));
+}
+
+vector<uint8_t> ReadFile(const string& file_name)
+{
+    ifstream file(file_name, ifstream::binary);
+    return vector<uint8_t>(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+}
+
+void ClearGroup(GroupMeshData& group_mesh_data)
+{
+    for (auto& mesh_data : group_mesh_data.meshes)
+    {
+        SAFE_DELETE(mesh_data);
+    }
+    for (auto& texture : group_mesh_data.loaded_textures)
+    {
+        SAFE_DELETE(texture);
+    }
+    group_mesh_data.meshes.clear();
+    group_mesh_data.loaded_textures.clear();
+}
+
+void ExpectSameParse(const GroupMeshData& group, const GpaParseReport& report,
+                     const GroupMeshData& expected_group, const GpaParseReport& expected_report)
+{
+    EXPECT_EQ(report.num_zones, expected_report.num_zones);
+    EXPECT_EQ(report.num_skipped_zones, expected_report.num_skipped_zones);
+    ASSERT_EQ(report.error_list.size(), expected_report.error_list.size());
+    for (size_t i = 0; i < report.error_list.size(); i++)
+    {
+        EXPECT_EQ(FormatGpaParseError(report.error_list[i]), FormatGpaParseError(expected_report.error_list[i]));
+    }
+
+    ASSERT_EQ(group.meshes.size(), expected_group.meshes.size());
+    for (size_t i_mesh = 0; i_mesh < group.meshes.size(); i_mesh++)
+    {
+        const MeshData& mesh = *group.meshes[i_mesh];
+        const MeshData& expected = *expected_group.meshes[i_mesh];
+        ASSERT_EQ(mesh.num_vertex, expected.num_vertex) << "mesh " << i_mesh;
+        for (int32_t i = 0; i < mesh.num_vertex; i++)
+        {
+            EXPECT_EQ(mesh.vertex_list[i], expected.vertex_list[i]) << "mesh " << i_mesh << " vertex " << i;
+        }
+        vector<uint32_t> index_list, expected_index_list;
+        mesh.get_triangle_list(index_list);
+        expected.get_triangle_list(expected_index_list);
+        EXPECT_EQ(index_list, expected_index_list) << "mesh " << i_mesh;
+    }
+}
+
+// a frame parsed by walking its zones and through an index built for it come out the same.
+void ExpectIndexedParseMatchesTheWalk(const vector<uint8_t>& frame, size_t num_meshes)
+{
+    GroupMeshData walked_group, indexed_group;
+    GpaParseReport walked_report, indexed_report;
+    bool b_walked = ParseGpaFrame(frame.data(), frame.size(), &walked_group, &walked_report);
+    EXPECT_EQ(walked_group.meshes.size(), num_meshes);
+
+    GpaFrameIndex index;
+    ASSERT_TRUE(BuildGpaFrameIndex(frame.data(), frame.size(), index));
+    EXPECT_TRUE(IsGpaFrameIndexCurrent(frame.data(), frame.size(), index));
+    EXPECT_TRUE(VerifyGpaFrameIndex(frame.data(), frame.size(), index));
+    EXPECT_EQ(ParseGpaFrame(frame.data(), frame.size(), index, &indexed_group, &indexed_report), b_walked);
+
+    ExpectSameParse(indexed_group, indexed_report, walked_group, walked_report);
+    ClearGroup(walked_group);
+    ClearGroup(indexed_group);
+}
+
+class GpaFrameIndexTest : public ::testing::Test
+{
+protected:
+    string index_file_name_ = GetGpaFrameIndexFileName(kFrameFileName);
+
+    void SetUp() override
+    {
+        // a folder that does not exist, so nothing the parser writes lands in the test folder.
+        g_root_folder_name = "gpaframe_test_no_output";
+        g_shaders_folder_name = "gpaframe_test_no_output";
+    }
+
+    void TearDown() override
+    {
+        remove(index_file_name_.c_str());
+        remove(kFrameFileName);
+    }
+
+    // the sidecar as the file stamp of the frame finds it.
+    bool LoadSidecar(GpaFrameIndex& index)
+    {
+        uint64_t file_size = 0;
+        int64_t file_time = 0;
+        return GetGpaFrameFileStamp(kFrameFileName, file_size, file_time) &&
+               LoadGpaFrameIndex(index_file_name_, file_size, file_time, index);
+    }
+
+    // opening the frame file gives the meshes of parsing it in memory, and leaves a
+    // sidecar current for it.
+    void ExpectOpenMatchesTheWalk(bool b_verify_index = false)
+    {
+        vector<uint8_t> frame = ReadFile(kFrameFileName);
+        GroupMeshData group, walked_group;
+        GpaParseReport report, walked_report;
+        CreateMeshFromDumpFile(kFrameFileName, &group, &report, b_verify_index);
+        ParseGpaFrame(frame.data(), frame.size(), &walked_group, &walked_report);
+        ExpectSameParse(group, report, walked_group, walked_report);
+        ClearGroup(group);
+        ClearGroup(walked_group);
+
+        GpaFrameIndex index;
+        ASSERT_TRUE(LoadSidecar(index));
+        EXPECT_TRUE(VerifyGpaFrameIndex(frame.data(), frame.size(), index));
+    }
+};
+
+TEST_F(GpaFrameIndexTest, IndexedParseMatchesTheWalk)
+{
+    vector<uint8_t> frame = CreateTestFrame(20, 0.0f);
+    ExpectIndexedParseMatchesTheWalk(frame, 20);
+
+    // cut inside a zone: the walk and the index both stop at the zone running past the end.
+    vector<uint8_t> truncated(frame.begin(), frame.begin() + frame.size() * 2 / 3);
+    ExpectIndexedParseMatchesTheWalk(truncated, 13);
+
+    // a draw with a damaged primitive in the middle is reported and skipped the same way.
+    vector<uint8_t> damaged = frame;
+    GpaFrameIndex index;
+    ASSERT_TRUE(BuildGpaFrameIndex(frame.data(), frame.size(), index));
+    auto draw_zone = find_if(index.zone_list.begin() + index.zone_list.size() / 2, index.zone_list.end(),
+                             [](const GpaZoneEntry& zone) { return zone.tag == kGlDrawElements; });
+    ASSERT_NE(draw_zone, index.zone_list.end());
+    uint32_t bad_primitive = 99;
+    memcpy(&damaged[draw_zone->offset + 8], &bad_primitive, 4);
+    ExpectIndexedParseMatchesTheWalk(damaged, 19);
+}
+
+TEST_F(GpaFrameIndexTest, SidecarIsWrittenAndReused)
+{
+    vector<uint8_t> frame = CreateTestFrame(20, 0.0f);
+    WriteFile(kFrameFileName, frame);
+    ExpectOpenMatchesTheWalk();
+
+    GpaFrameIndex index, built_index;
+    ASSERT_TRUE(LoadSidecar(index));
+    ASSERT_TRUE(BuildGpaFrameIndex(frame.data(), frame.size(), built_index));
+    EXPECT_EQ(index.version_number, built_index.version_number);
+    EXPECT_EQ(index.end_offset, built_index.end_offset);
+    EXPECT_EQ(index.end_tag, built_index.end_tag);
+    ASSERT_EQ(index.zone_list.size(), built_index.zone_list.size());
+    for (size_t i = 0; i < index.zone_list.size(); i++)
+    {
+        EXPECT_EQ(index.zone_list[i].offset, built_index.zone_list[i].offset);
+        EXPECT_EQ(index.zone_list[i].num_bytes, built_index.zone_list[i].num_bytes);
+        EXPECT_EQ(index.zone_list[i].tag, built_index.zone_list[i].tag);
+        EXPECT_EQ(index.zone_list[i].hash, built_index.zone_list[i].hash);
+    }
+
+    // a second open goes through the sidecar.
+    ExpectOpenMatchesTheWalk();
+}
+
+TEST_F(GpaFrameIndexTest, StaleSidecarIsRejected)
+{
+    WriteFile(kFrameFileName, CreateTestFrame(20, 0.0f));
+    ExpectOpenMatchesTheWalk();
+    vector<uint8_t> old_sidecar = ReadFile(index_file_name_);
+    fs::file_time_type old_time = fs::last_write_time(kFrameFileName);
+
+    // more draws, the size changed.
+    WriteFile(kFrameFileName, CreateTestFrame(21, 0.0f));
+    fs::last_write_time(kFrameFileName, old_time);
+    WriteFile(index_file_name_, old_sidecar);
+    GpaFrameIndex index;
+    EXPECT_FALSE(LoadSidecar(index));
+    EXPECT_FALSE(index.b_valid);
+    ExpectOpenMatchesTheWalk();
+
+    // the same size written again, only the write time tells.
+    WriteFile(kFrameFileName, CreateTestFrame(20, 0.0f));
+    fs::last_write_time(kFrameFileName, old_time + chrono::seconds(2));
+    WriteFile(index_file_name_, old_sidecar);
+    EXPECT_FALSE(LoadSidecar(index));
+    ExpectOpenMatchesTheWalk();
+
+    // a truncated frame.
+    WriteFile(kFrameFileName, CreateTestFrame(20, 0.0f));
+    fs::last_write_time(kFrameFileName, old_time);
+    WriteFile(index_file_name_, old_sidecar);
+    ASSERT_TRUE(LoadSidecar(index));
+    vector<uint8_t> frame = ReadFile(kFrameFileName);
+    frame.resize(frame.size() - 100);
+    EXPECT_FALSE(IsGpaFrameIndexCurrent(frame.data(), frame.size(), index));
+    WriteFile(kFrameFileName, frame);
+    fs::last_write_time(kFrameFileName, old_time);
+    EXPECT_FALSE(LoadSidecar(index));
+    ExpectOpenMatchesTheWalk();
+}
+
+TEST_F(GpaFrameIndexTest, TruncatedSidecarIsRejected)
+{
+    WriteFile(kFrameFileName, CreateTestFrame(20, 0.0f));
+    ExpectOpenMatchesTheWalk();
+    vector<uint8_t> sidecar = ReadFile(index_file_name_);
+
+    // cut in the zone entries, in the header, and empty.
+    for (size_t size : { sidecar.size() - 1, sidecar.size() - 24, size_t(20), size_t(0) })
+    {
+        WriteFile(index_file_name_, vector<uint8_t>(sidecar.begin(), sidecar.begin() + size));
+        GpaFrameIndex index;
+        EXPECT_FALSE(LoadSidecar(index)) << "sidecar of " << size << " bytes";
+        ExpectOpenMatchesTheWalk();
+    }
+}
+
+TEST_F(GpaFrameIndexTest, VerifyCatchesChangedZoneContents)
+{
+    vector<uint8_t> frame = CreateTestFrame(20, 0.0f);
+    WriteFile(kFrameFileName, frame);
+    ExpectOpenMatchesTheWalk();
+    fs::file_time_type old_time = fs::last_write_time(kFrameFileName);
+
+    // other vertices under the same zone headers and the same file stamp, the sidecar
+    // still loads and looks current.
+    vector<uint8_t> changed = CreateTestFrame(20, 1000.0f);
+    ASSERT_EQ(changed.size(), frame.size());
+    WriteFile(kFrameFileName, changed);
+    fs::last_write_time(kFrameFileName, old_time);
+    GpaFrameIndex index;
+    ASSERT_TRUE(LoadSidecar(index));
+    EXPECT_TRUE(IsGpaFrameIndexCurrent(changed.data(), changed.size(), index));
+    EXPECT_FALSE(VerifyGpaFrameIndex(changed.data(), changed.size(), index));
+
+    // verifying replaces the sidecar with one hashing the new contents.
+    ExpectOpenMatchesTheWalk(true);
+}
+}
@@ -0,0 +1,302 @@
+#include "meshbatch.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <array>
+#include <random>
+
+namespace
+{
+struct TestCorner
+{
+    core::vec3d     pos;
+    core::vec2f     uv;
+    uint32_t        color;
+};
+
+// every vertex made gets its own color, so a triangle is known by the colors of its corners
+// in order, whatever mesh and index it ends up under.
+uint32_t g_next_color = 1;
+
+// the middle of a default batch cell, so meshes around it batch together.
+const core::vec3d kTestOrigin(kDefaultBatchCellSize / 2, kDefaultBatchCellSize / 2, kDefaultBatchCellSize / 2);
+
+// a mesh of random vertices around kTestOrigin + translation, its bbox_ws in world space.
+MeshData* CreateTestMesh(uint32_t num_vertex, const core::vec3d& translation, uint32_t seed)
+{
+    mt19937 rng(seed);
+    uniform_real_distribution<float> pos_dist(-8.0f, 8.0f);
+    uniform_real_distribution<float> uv_dist(0.0f, 1.0f);
+
+    MeshData* mesh_data = new MeshData;
+    mesh_data->num_vertex = int(num_vertex);
+    mesh_data->translation = kTestOrigin + translation;
+    mesh_data->idx_in_texture_list = 2;
+    mesh_data->vertex_list = make_unique<core::vec3f[]>(num_vertex);
+    mesh_data->uv_list = make_unique<core::vec2f[]>(num_vertex);
+    mesh_data->color_list = make_unique<uint32_t[]>(num_vertex);
+    for (uint32_t i = 0; i < num_vertex; i++)
+    {
+        mesh_data->vertex_list[i] = core::vec3f(pos_dist(rng), pos_dist(rng), pos_dist(rng));
+        mesh_data->uv_list[i] = core::vec2f(uv_dist(rng), uv_dist(rng));
+        mesh_data->color_list[i] = g_next_color++;
+        const core::vec3f& v = mesh_data->vertex_list[i];
+        mesh_data->bbox_ws += core::vec3d(v.x, v.y, v.z) + mesh_data->translation;
+    }
+    return mesh_data;
+}
+
+void AddDrawCall(MeshData* mesh_data, PrimitiveType primitive_type, const vector<uint32_t>& index_list)
+{
+    uint32_t max_index = index_list.empty() ? 0 : *max_element(index_list.begin(), index_list.end());
+    mesh_data->add_draw_call_list(primitive_type, int(index_list.size()), int(max_index));
+    for (uint32_t index : index_list)
+    {
+        mesh_data->get_last_draw_call_info().add_index(index);
+    }
+}
+
+// num_index indices of a strip over the mesh, no two neighbours the same.
+vector<uint32_t> MakeStrip(uint32_t num_index, uint32_t num_vertex, mt19937& rng)
+{
+    vector<uint32_t> index_list;
+    for (uint32_t i = 0; i < num_index; i++)
+    {
+        uint32_t index;
+        do
+        {
+            index = uniform_int_distribution<uint32_t>(0, num_vertex - 1)(rng);
+        } while ((i > 0 && index == index_list[i - 1]) || (i > 1 && index == index_list[i - 2]));
+        index_list.push_back(index);
+    }
+    return index_list;
+}
+
+// the triangles get_triangle_list gives for the group, in world space, ordered by corner colors.
+vector<array<TestCorner, 3>> GetWorldTriangles(const GroupMeshData& group_mesh_data)
+{
+    vector<array<TestCorner, 3>> triangle_list;
+    for (const MeshData* mesh_data : group_mesh_data.meshes)
+    {
+        vector<uint32_t> index_list;
+        mesh_data->get_triangle_list(index_list);
+        for (size_t i = 0; i + 2 < index_list.size(); i += 3)
+        {
+            array<TestCorner, 3> triangle;
+            for (uint32_t c = 0; c < 3; c++)
+            {
+                uint32_t idx = index_list[i + c];
+                const core::vec3f& v = mesh_data->vertex_list[idx];
+                triangle[c].pos = core::vec3d(v.x, v.y, v.z) + mesh_data->translation;
+                triangle[c].uv = mesh_data->uv_list[idx];
+                triangle[c].color = mesh_data->color_list[idx];
+            }
+            triangle_list.push_back(triangle);
+        }
+    }
+
+    sort(triangle_list.begin(), triangle_list.end(), [](const array<TestCorner, 3>& a, const array<TestCorner, 3>& b)
+    {
+        return make_tuple(a[0].color, a[1].color, a[2].color) < make_tuple(b[0].color, b[1].color, b[2].color);
+    });
+    return triangle_list;
+}
+
+// what the merge has to keep: the same triangles with the same winding, positions only
+// moved by the float rounding of the new translation.
+void ExpectSameTriangles(const vector<array<TestCorner, 3>>& before, const vector<array<TestCorner, 3>>& after)
+{
+    ASSERT_EQ(before.size(), after.size());
+    for (size_t i = 0; i < before.size(); i++)
+    {
+        for (uint32_t c = 0; c < 3; c++)
+        {
+            ASSERT_EQ(before[i][c].color, after[i][c].color) << "triangle " << i << " corner " << c;
+            EXPECT_EQ(before[i][c].uv, after[i][c].uv) << "triangle " << i << " corner " << c;
+            EXPECT_NEAR(before[i][c].pos.x, after[i][c].pos.x, 1e-4) << "triangle " << i << " corner " << c;
+            EXPECT_NEAR(before[i][c].pos.y, after[i][c].pos.y, 1e-4) << "triangle " << i << " corner " << c;
+            EXPECT_NEAR(before[i][c].pos.z, after[i][c].pos.z, 1e-4) << "triangle " << i << " corner " << c;
+        }
+    }
+}
+
+void FreeGroupMeshData(GroupMeshData& group_mesh_data)
+{
+    for (auto& mesh_data : group_mesh_data.meshes)
+    {
+        SAFE_DELETE(mesh_data);
+    }
+    group_mesh_data.meshes.clear();
+}
+
+TEST(MeshBatchTest, TriangleListsMergeIntoOneDrawCall)
+{
+    mt19937 rng(11);
+    GroupMeshData group_mesh_data;
+    for (uint32_t i_mesh = 0; i_mesh < 5; i_mesh++)
+    {
+        MeshData* mesh_data = CreateTestMesh(20 + i_mesh, core::vec3d(10.0 * i_mesh, 3.0, -2.0 * i_mesh), i_mesh);
+        vector<uint32_t> index_list;
+        for (uint32_t i = 0; i < 30; i++)
+        {
+            index_list.push_back(uniform_int_distribution<uint32_t>(0, 19)(rng));
+        }
+        AddDrawCall(mesh_data, kGlTriangles, index_list);
+        group_mesh_data.meshes.push_back(mesh_data);
+    }
+
+    auto before = GetWorldTriangles(group_mesh_data);
+    MeshBatchStats stats = MergeGroupMeshes(&group_mesh_data);
+    EXPECT_EQ(stats.num_meshes_before, 5u);
+    EXPECT_EQ(stats.num_meshes_after, 1u);
+    EXPECT_EQ(stats.num_draw_calls_after, 1u);
+    ASSERT_EQ(group_mesh_data.meshes.size(), 1u);
+    EXPECT_EQ(group_mesh_data.meshes[0]->num_vertex, 20 + 21 + 22 + 23 + 24);
+    EXPECT_EQ(group_mesh_data.meshes[0]->draw_call_list[0].get_index_type(), uint32_t(kGlUShort));
+    ExpectSameTriangles(before, GetWorldTriangles(group_mesh_data));
+    FreeGroupMeshData(group_mesh_data);
+}
+
+// strips of odd and even lengths joined in every order, the padding has to keep each
+// strip's winding and add no triangle that draws.
+TEST(MeshBatchTest, StripsJoinKeepingTheirWinding)
+{
+    const uint32_t length_list[] = { 4, 5, 3, 3, 6, 7, 4 };
+    mt19937 rng(12);
+    GroupMeshData group_mesh_data;
+    uint32_t num_strips = 0;
+    for (uint32_t length : length_list)
+    {
+        MeshData* mesh_data = CreateTestMesh(12, core::vec3d(1.0, 2.0, 3.0), num_strips);
+        AddDrawCall(mesh_data, kGlTriangleStrip, MakeStrip(length, 12, rng));
+        // a second strip in the same mesh goes through the same join.
+        if (length % 2)
+        {
+            AddDrawCall(mesh_data, kGlTriangleStrip, MakeStrip(length + 1, 12, rng));
+        }
+        group_mesh_data.meshes.push_back(mesh_data);
+        num_strips++;
+    }
+
+    auto before = GetWorldTriangles(group_mesh_data);
+    MergeGroupMeshes(&group_mesh_data);
+    ASSERT_EQ(group_mesh_data.meshes.size(), 1u);
+    ASSERT_EQ(group_mesh_data.meshes[0]->draw_call_list.size(), 1u);
+    EXPECT_EQ(group_mesh_data.meshes[0]->draw_call_list[0].get_primitive_type(), kGlTriangleStrip);
+    ExpectSameTriangles(before, GetWorldTriangles(group_mesh_data));
+    FreeGroupMeshData(group_mesh_data);
+}
+
+TEST(MeshBatchTest, FansStaySeparateDrawCalls)
+{
+    GroupMeshData group_mesh_data;
+    const vector<uint32_t> fan_list[2] = { { 0, 1, 2, 3, 4 }, { 5, 4, 3, 2 } };
+    for (uint32_t i_mesh = 0; i_mesh < 2; i_mesh++)
+    {
+        MeshData* mesh_data = CreateTestMesh(6, core::vec3d(0, 0, 0), i_mesh);
+        AddDrawCall(mesh_data, kGlTriangleFan, fan_list[i_mesh]);
+        group_mesh_data.meshes.push_back(mesh_data);
+    }
+
+    MergeGroupMeshes(&group_mesh_data);
+    ASSERT_EQ(group_mesh_data.meshes.size(), 1u);
+    const MeshData* merged_mesh = group_mesh_data.meshes[0];
+    ASSERT_EQ(merged_mesh->draw_call_list.size(), 2u);
+    for (uint32_t i_mesh = 0; i_mesh < 2; i_mesh++)
+    {
+        const DrawCallInfo& draw_call_info = merged_mesh->draw_call_list[i_mesh];
+        EXPECT_EQ(draw_call_info.get_primitive_type(), kGlTriangleFan);
+        ASSERT_EQ(draw_call_info.get_index_count(), int(fan_list[i_mesh].size()));
+        for (uint32_t i = 0; i < fan_list[i_mesh].size(); i++)
+        {
+            EXPECT_EQ(draw_call_info.get_index(int(i)), fan_list[i_mesh][i] + 6 * i_mesh);
+        }
+    }
+    FreeGroupMeshData(group_mesh_data);
+}
+
+// a merged draw call needs 32 bit indices only once it addresses a vertex past 0xffff.
+TEST(MeshBatchTest, IndicesWidenOnlyPastSixteenBits)
+{
+    for (uint32_t extra_vertex = 0; extra_vertex < 2; extra_vertex++)
+    {
+        GroupMeshData group_mesh_data;
+        for (uint32_t i_mesh = 0; i_mesh < 2; i_mesh++)
+        {
+            uint32_t num_vertex = 0x8000 + (i_mesh == 1 ? extra_vertex : 0);
+            MeshData* mesh_data = CreateTestMesh(num_vertex, core::vec3d(0, 0, 0), i_mesh);
+            AddDrawCall(mesh_data, kGlTriangles, { 0, num_vertex / 2, num_vertex - 1 });
+            group_mesh_data.meshes.push_back(mesh_data);
+        }
+
+        auto before = GetWorldTriangles(group_mesh_data);
+        MeshBatchStats stats = MergeGroupMeshes(&group_mesh_data);
+        ASSERT_EQ(group_mesh_data.meshes.size(), 1u);
+        const DrawCallInfo& draw_call_info = group_mesh_data.meshes[0]->draw_call_list[0];
+        EXPECT_EQ(draw_call_info.get_index(5), 0xffffu + extra_vertex);
+        EXPECT_EQ(draw_call_info.get_index_type(), uint32_t(extra_vertex ? kGlUInt : kGlUShort));
+        EXPECT_EQ(stats.num_wide_draw_calls, extra_vertex);
+        ExpectSameTriangles(before, GetWorldTriangles(group_mesh_data));
+        FreeGroupMeshData(group_mesh_data);
+    }
+}
+
+TEST(MeshBatchTest, PatchedAndBrokenMeshesAreLeftAlone)
+{
+    GroupMeshData group_mesh_data;
+    MeshData* patched_mesh = CreateTestMesh(3, core::vec3d(0, 0, 0), 1);
+    AddDrawCall(patched_mesh, kGlTriangles, { 0, 1, 2 });
+    patched_mesh->patch_list.push_back(true);
+    MeshData* broken_mesh = CreateTestMesh(3, core::vec3d(0, 0, 0), 2);
+    AddDrawCall(broken_mesh, kGlTriangles, { 0, 1, 3 });
+    MeshData* mesh_0 = CreateTestMesh(3, core::vec3d(0, 0, 0), 3);
+    AddDrawCall(mesh_0, kGlTriangles, { 0, 1, 2 });
+    MeshData* mesh_1 = CreateTestMesh(3, core::vec3d(0, 0, 0), 4);
+    AddDrawCall(mesh_1, kGlTriangles, { 2, 1, 0 });
+    group_mesh_data.meshes = { patched_mesh, mesh_0, broken_mesh, mesh_1 };
+
+    MeshBatchStats stats = MergeGroupMeshes(&group_mesh_data);
+    EXPECT_EQ(stats.num_meshes_after, 3u);
+    ASSERT_EQ(group_mesh_data.meshes.size(), 3u);
+    EXPECT_EQ(group_mesh_data.meshes[0], patched_mesh);
+    EXPECT_EQ(group_mesh_data.meshes[1]->num_vertex, 6);
+    EXPECT_EQ(group_mesh_data.meshes[2], broken_mesh);
+    EXPECT_EQ(broken_mesh->draw_call_list[0].get_index(2), 3u);
+    FreeGroupMeshData(group_mesh_data);
+}
+
+// meshes a cell apart stay in batches of their own, so culling still sees them apart.
+TEST(MeshBatchTest, BatchesStayWithinACell)
+{
+    const double cell_size = 100.0;
+    for (double batch_cell_size : { cell_size, 0.0 })
+    {
+        GroupMeshData group_mesh_data;
+        for (uint32_t i_mesh = 0; i_mesh < 6; i_mesh++)
+        {
+            // three meshes each in two cells two apart.
+            core::vec3d translation(200.0 * (i_mesh % 2), 0.0, 10.0 * (i_mesh / 2));
+            MeshData* mesh_data = CreateTestMesh(4, translation, i_mesh);
+            AddDrawCall(mesh_data, kGlTriangles, { 0, 1, 2, 1, 2, 3 });
+            group_mesh_data.meshes.push_back(mesh_data);
+        }
+
+        auto before = GetWorldTriangles(group_mesh_data);
+        MergeGroupMeshes(&group_mesh_data, kDefaultBatchMaxVertices, batch_cell_size);
+        ExpectSameTriangles(before, GetWorldTriangles(group_mesh_data));
+        if (batch_cell_size == 0)
+        {
+            EXPECT_EQ(group_mesh_data.meshes.size(), 1u);
+        }
+        else
+        {
+            ASSERT_EQ(group_mesh_data.meshes.size(), 2u);
+            for (const MeshData* mesh_data : group_mesh_data.meshes)
+            {
+                EXPECT_EQ(mesh_data->num_vertex, 12);
+                EXPECT_LT(mesh_data->bbox_ws.bb_max.x - mesh_data->bbox_ws.bb_min.x, cell_size);
+            }
+        }
+        FreeGroupMeshData(group_mesh_data);
+    }
+}
+}
@@ -0,0 +1,399 @@
+#include "meshclip.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <map>
+
+namespace
+{
+const core::vec2d kGpsOrigin(-122.4, 37.8);
+constexpr double kGpsStep = 1e-4;       // degrees per grid cell
+
+// the attributes are linear in the position, so every interpolated vertex can be checked.
+double GetTestHeight(double x, double y)
+{
+    return 0.25 * x - 0.5 * y + 7.0;
+}
+
+core::vec2f GetTestUv(double x, double y)
+{
+    return core::vec2f(float(x / 64.0), float(y / 32.0));
+}
+
+uint32_t GetTestColor(double x, double y)
+{
+    uint32_t r = uint32_t(lround(x * 4.0)), g = uint32_t(lround(y * 4.0));
+    return r | (g << 8) | (uint32_t(lround(x + y)) << 16) | 0xff000000;
+}
+
+// a n x n grid of unit cells from the translation, diagonals alternating so the cut
+// lines meet edges of every direction. vertex_list is relative to the translation.
+unique_ptr<MeshData> CreateGridMesh(uint32_t n, const core::vec3d& translation)
+{
+    uint32_t row = n + 1;
+    auto mesh_data = make_unique<MeshData>();
+    mesh_data->num_vertex = int(row * row);
+    mesh_data->translation = translation;
+    mesh_data->vertex_list = make_unique<core::vec3f[]>(row * row);
+    mesh_data->gps_vert_list = make_unique<core::GpsCoord[]>(row * row);
+    mesh_data->uv_list = make_unique<core::vec2f[]>(row * row);
+    mesh_data->color_list = make_unique<uint32_t[]>(row * row);
+    for (uint32_t y = 0; y < row; y++)
+    {
+        for (uint32_t x = 0; x < row; x++)
+        {
+            uint32_t i = y * row + x;
+            mesh_data->vertex_list[i] = core::vec3f(float(x), float(y), float(GetTestHeight(x, y)));
+            mesh_data->gps_vert_list[i] = core::GpsCoord(kGpsOrigin.x + x * kGpsStep, kGpsOrigin.y + y * kGpsStep, GetTestHeight(x, y));
+            mesh_data->uv_list[i] = GetTestUv(x, y);
+            mesh_data->color_list[i] = GetTestColor(x, y);
+        }
+    }
+
+    mesh_data->idx_in_texture_list = 3;
+    mesh_data->add_draw_call_list(kGlTriangles, int(n * n * 6), int(row * row));
+    DrawCallInfo& draw_call = mesh_data->get_last_draw_call_info();
+    for (uint32_t y = 0; y < n; y++)
+    {
+        for (uint32_t x = 0; x < n; x++)
+        {
+            uint32_t i = y * row + x;
+            bool flip = (x + y) % 2 != 0;
+            uint32_t quad[6] = { i, i + 1, flip ? i + row : i + row + 1, flip ? i + 1 : i, i + row + 1, i + row };
+            for (uint32_t idx : quad)
+            {
+                draw_call.add_index(idx);
+            }
+        }
+    }
+    return mesh_data;
+}
+
+// x y of a clipped vertex in the space it was clipped in.
+core::vec2d GetClipPos(const MeshData& mesh_data, uint32_t idx, MeshClipSpace clip_space)
+{
+    if (clip_space == kMeshClipGps)
+    {
+        return core::vec2d(mesh_data.gps_vert_list[idx].lon, mesh_data.gps_vert_list[idx].lat);
+    }
+    const core::vec3f& v = mesh_data.vertex_list[idx];
+    return core::vec2d(v.x + mesh_data.translation.x, v.y + mesh_data.translation.y);
+}
+
+double Cross2(const core::vec2d& u, const core::vec2d& v)
+{
+    return u.x * v.y - u.y * v.x;
+}
+
+double GetPolygonArea(const vector<core::vec2d>& polygon)
+{
+    double area = 0.0;
+    for (size_t i = 0; i < polygon.size(); i++)
+    {
+        area += Cross2(polygon[i], polygon[(i + 1) % polygon.size()]);
+    }
+    return fabs(area) * 0.5;
+}
+
+// sum of the triangle areas, every triangle facing up as the grid's do.
+double GetMeshArea(const MeshData& mesh_data, MeshClipSpace clip_space)
+{
+    vector<uint32_t> index_list;
+    mesh_data.get_triangle_list(index_list);
+    double area = 0.0;
+    for (size_t i = 0; i < index_list.size(); i += 3)
+    {
+        core::vec2d p0 = GetClipPos(mesh_data, index_list[i], clip_space);
+        core::vec2d p1 = GetClipPos(mesh_data, index_list[i + 1], clip_space);
+        core::vec2d p2 = GetClipPos(mesh_data, index_list[i + 2], clip_space);
+        double tri_area = Cross2(p1 - p0, p2 - p0) * 0.5;
+        EXPECT_GE(tri_area, -1e-9) << "triangle " << i / 3 << " flipped";
+        area += tri_area;
+    }
+    return area;
+}
+
+double DistanceToSegment(const core::vec2d& pos, const core::vec2d& p, const core::vec2d& q)
+{
+    core::vec2d d = q - p;
+    double t = min(max(core::dot(pos - p, d) / core::dot(d, d), 0.0), 1.0);
+    return core::length(pos - (p + d * t));
+}
+
+bool IsOnOutline(const vector<core::vec2d>& polygon, const core::vec2d& a, const core::vec2d& b, double tolerance)
+{
+    for (size_t i = 0; i < polygon.size(); i++)
+    {
+        const core::vec2d& p = polygon[i];
+        const core::vec2d& q = polygon[(i + 1) % polygon.size()];
+        if (DistanceToSegment(a, p, q) < tolerance && DistanceToSegment(b, p, q) < tolerance)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+//
+// every edge inside the region is shared by two triangles running it in opposite
+// directions, and the edges used once all lie on the polygon's outline or the mesh's
+// own: no cracks, no t-junctions, no overlaps. the edges on the polygon are returned.
+//
+void ExpectWatertight(const MeshData& mesh_data, const vector<core::vec2d>& polygon, MeshClipSpace clip_space,
+                      double tolerance, vector<pair<core::vec2d, core::vec2d>>* border_list = nullptr,
+                      const vector<core::vec2d>& mesh_outline = vector<core::vec2d>())
+{
+    vector<uint32_t> index_list;
+    mesh_data.get_triangle_list(index_list);
+    // uses of each edge, and +1 for the lower index first, -1 the other way.
+    map<pair<uint32_t, uint32_t>, pair<int32_t, int32_t>> edge_map;
+    for (size_t i = 0; i < index_list.size(); i += 3)
+    {
+        for (uint32_t k = 0; k < 3; k++)
+        {
+            uint32_t a = index_list[i + k], b = index_list[i + (k + 1) % 3];
+            ASSERT_NE(a, b) << "triangle " << i / 3 << " is degenerate";
+            auto& edge = edge_map[make_pair(min(a, b), max(a, b))];
+            edge.first++;
+            edge.second += a < b ? 1 : -1;
+        }
+    }
+
+    for (const auto& item : edge_map)
+    {
+        uint32_t a = item.first.first, b = item.first.second;
+        ASSERT_LE(item.second.first, 2) << "edge " << a << " - " << b << " is shared by more than two triangles";
+        if (item.second.first == 2)
+        {
+            ASSERT_EQ(item.second.second, 0) << "edge " << a << " - " << b << " runs the same way twice";
+        }
+        else
+        {
+            core::vec2d pa = GetClipPos(mesh_data, a, clip_space), pb = GetClipPos(mesh_data, b, clip_space);
+            if (!mesh_outline.empty() && IsOnOutline(mesh_outline, pa, pb, tolerance))
+            {
+                continue;
+            }
+            ASSERT_TRUE(IsOnOutline(polygon, pa, pb, tolerance))
+                << "open edge inside the region at " << pa.x << ", " << pa.y << " - " << pb.x << ", " << pb.y;
+            if (border_list)
+            {
+                border_list->push_back(make_pair(pa, pb));
+            }
+        }
+    }
+}
+
+// the clipped vertices carry the attributes the grid has at their position.
+void ExpectInterpolatedAttributes(const MeshData& mesh_data)
+{
+    for (uint32_t i = 0; i < uint32_t(mesh_data.num_vertex); i++)
+    {
+        const core::vec3f& v = mesh_data.vertex_list[i];
+        double x = v.x, y = v.y;
+        ASSERT_NEAR(v.z, GetTestHeight(x, y), 1e-4) << "vertex " << i;
+        ASSERT_NEAR(mesh_data.gps_vert_list[i].lon, kGpsOrigin.x + x * kGpsStep, 1e-9) << "vertex " << i;
+        ASSERT_NEAR(mesh_data.gps_vert_list[i].lat, kGpsOrigin.y + y * kGpsStep, 1e-9) << "vertex " << i;
+        ASSERT_NEAR(mesh_data.gps_vert_list[i].alt, GetTestHeight(x, y), 1e-4) << "vertex " << i;
+        core::vec2f uv = GetTestUv(x, y);
+        ASSERT_NEAR(mesh_data.uv_list[i].x, uv.x, 1e-5) << "vertex " << i;
+        ASSERT_NEAR(mesh_data.uv_list[i].y, uv.y, 1e-5) << "vertex " << i;
+        uint32_t color = GetTestColor(x, y);
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            ASSERT_NEAR(double((mesh_data.color_list[i] >> (c * 8)) & 0xff), double((color >> (c * 8)) & 0xff), 1.0) << "vertex " << i;
+        }
+    }
+}
+
+vector<core::vec2d> Translate(const vector<core::vec2d>& polygon, const core::vec2d& offset)
+{
+    vector<core::vec2d> result;
+    for (const auto& point : polygon)
+    {
+        result.push_back(point + offset);
+    }
+    return result;
+}
+
+// regions well inside the 40 x 40 grid, convex and concave, both windings.
+vector<vector<core::vec2d>> CreateTestPolygons()
+{
+    vector<vector<core::vec2d>> polygon_list;
+    polygon_list.push_back({ { 3.3, 4.1 }, { 31.7, 6.9 }, { 17.2, 35.5 } });
+    polygon_list.push_back({ { 20.0, 2.5 }, { 37.5, 20.0 }, { 20.0, 37.5 }, { 2.5, 20.0 } });
+    // an l with a corner exactly on a grid vertex and edges along grid lines.
+    polygon_list.push_back({ { 5.0, 5.0 }, { 30.0, 5.0 }, { 30.0, 12.0 }, { 12.0, 12.0 }, { 12.0, 33.0 }, { 5.0, 33.0 } });
+
+    vector<core::vec2d> star;
+    for (int32_t i = 0; i < 14; i++)
+    {
+        double angle = i * 3.14159265358979 / 7.0 + 0.1;
+        double radius = i % 2 ? 6.3 : 17.1;
+        star.push_back(core::vec2d(20.0 + radius * cos(angle), 20.0 + radius * sin(angle)));
+    }
+    polygon_list.push_back(star);
+    polygon_list.push_back(vector<core::vec2d>(star.rbegin(), star.rend()));
+
+    // a comb, many pieces after ear clipping.
+    vector<core::vec2d> comb = { { 2.5, 2.5 }, { 37.5, 2.5 }, { 37.5, 37.5 } };
+    for (int32_t i = 0; i < 6; i++)
+    {
+        double x = 37.5 - i * 5.8;
+        comb.push_back(core::vec2d(x - 2.9, 10.0));
+        comb.push_back(core::vec2d(x - 5.8, 37.5));
+    }
+    polygon_list.push_back(comb);
+    return polygon_list;
+}
+
+TEST(MeshClipTest, PolygonsInsideKeepTheirArea)
+{
+    const core::vec3d translation(-7.0, 3.5, 0.0);
+    unique_ptr<MeshData> mesh_data = CreateGridMesh(40, translation);
+    for (const auto& polygon : CreateTestPolygons())
+    {
+        vector<core::vec2d> local_polygon = Translate(polygon, core::vec2d(translation.x, translation.y));
+        SCOPED_TRACE(testing::Message() << polygon.size() << " corners from " << polygon[0].x << ", " << polygon[0].y);
+
+        MeshData clipped_mesh;
+        ASSERT_TRUE(ClipMeshToPolygon(*mesh_data, local_polygon, kMeshClipLocal, clipped_mesh));
+        EXPECT_NEAR(GetMeshArea(clipped_mesh, kMeshClipLocal), GetPolygonArea(polygon), 1e-4);
+        EXPECT_EQ(clipped_mesh.idx_in_texture_list, 3u);
+        EXPECT_EQ(clipped_mesh.translation.x, translation.x);
+        ExpectWatertight(clipped_mesh, local_polygon, kMeshClipLocal, 1e-4);
+        ExpectInterpolatedAttributes(clipped_mesh);
+
+        // the same region in gps coordinates cuts the same triangles.
+        vector<core::vec2d> gps_polygon;
+        for (const auto& point : polygon)
+        {
+            gps_polygon.push_back(kGpsOrigin + point * kGpsStep);
+        }
+        MeshData gps_clipped_mesh;
+        ASSERT_TRUE(ClipMeshToPolygon(*mesh_data, gps_polygon, kMeshClipGps, gps_clipped_mesh));
+        EXPECT_NEAR(GetMeshArea(gps_clipped_mesh, kMeshClipGps), GetPolygonArea(gps_polygon), 1e-12);
+        ExpectWatertight(gps_clipped_mesh, gps_polygon, kMeshClipGps, 1e-9);
+        EXPECT_EQ(gps_clipped_mesh.num_vertex, clipped_mesh.num_vertex);
+    }
+}
+
+TEST(MeshClipTest, RegionsPastTheMeshKeepTheOverlap)
+{
+    unique_ptr<MeshData> mesh_data = CreateGridMesh(40, core::vec3d(0.0, 0.0, 0.0));
+
+    // everything, then a box hanging over two sides, then nothing.
+    vector<core::vec2d> all = { { -10.0, -10.0 }, { 50.0, -10.0 }, { 50.0, 50.0 }, { -10.0, 50.0 } };
+    MeshData clipped_mesh;
+    ASSERT_TRUE(ClipMeshToPolygon(*mesh_data, all, kMeshClipLocal, clipped_mesh));
+    EXPECT_NEAR(GetMeshArea(clipped_mesh, kMeshClipLocal), 1600.0, 1e-9);
+    EXPECT_EQ(clipped_mesh.num_vertex, mesh_data->num_vertex);
+
+    core::bounds2d bbox;
+    bbox += core::vec2d(25.25, -3.0);
+    bbox += core::vec2d(47.0, 12.75);
+    ASSERT_TRUE(ClipMeshToBounds(*mesh_data, bbox, kMeshClipLocal, clipped_mesh));
+    EXPECT_NEAR(GetMeshArea(clipped_mesh, kMeshClipLocal), (40.0 - 25.25) * 12.75, 1e-4);
+    ExpectInterpolatedAttributes(clipped_mesh);
+
+    vector<core::vec2d> outside = { { 41.0, 0.0 }, { 45.0, 0.0 }, { 45.0, 4.0 } };
+    EXPECT_FALSE(ClipMeshToPolygon(*mesh_data, outside, kMeshClipLocal, clipped_mesh));
+
+    // no gps coordinates to clip in.
+    mesh_data->gps_vert_list = nullptr;
+    EXPECT_FALSE(ClipMeshToPolygon(*mesh_data, all, kMeshClipGps, clipped_mesh));
+}
+
+TEST(MeshClipTest, PatchesTileTheMeshWithoutCracks)
+{
+    unique_ptr<MeshData> mesh_data = CreateGridMesh(40, core::vec3d(0.0, 0.0, 0.0));
+
+    const vector<core::vec2d> mesh_outline = { kGpsOrigin, kGpsOrigin + core::vec2d(40.0, 0.0) * kGpsStep,
+                                               kGpsOrigin + core::vec2d(40.0, 40.0) * kGpsStep, kGpsOrigin + core::vec2d(0.0, 40.0) * kGpsStep };
+
+    // patch lines off the grid lines, the outer patches reach past the mesh.
+    const double cuts[] = { -5.0, 9.37, 21.5, 30.01, 45.0 };
+    double total_area = 0.0;
+    map<pair<int32_t, int32_t>, vector<pair<core::vec2d, core::vec2d>>> border_map;
+    for (int32_t j = 0; j < 4; j++)
+    {
+        for (int32_t i = 0; i < 4; i++)
+        {
+            PatchInfo patch_info;
+            patch_info.bbox += kGpsOrigin + core::vec2d(cuts[i], cuts[j]) * kGpsStep;
+            patch_info.bbox += kGpsOrigin + core::vec2d(cuts[i + 1], cuts[j + 1]) * kGpsStep;
+
+            MeshData patch_mesh;
+            ASSERT_TRUE(PatchCutting(patch_info, *mesh_data, patch_mesh)) << i << ", " << j;
+            double area = GetMeshArea(patch_mesh, kMeshClipGps);
+            double w = min(cuts[i + 1], 40.0) - max(cuts[i], 0.0), h = min(cuts[j + 1], 40.0) - max(cuts[j], 0.0);
+            EXPECT_NEAR(area, w * h * kGpsStep * kGpsStep, 1e-13) << i << ", " << j;
+            total_area += area;
+
+            const core::bounds2d& bbox = patch_info.bbox;
+            vector<core::vec2d> outline = { bbox.bb_min, core::vec2d(bbox.bb_max.x, bbox.bb_min.y),
+                                            bbox.bb_max, core::vec2d(bbox.bb_min.x, bbox.bb_max.y) };
+            ExpectWatertight(patch_mesh, outline, kMeshClipGps, 1e-10, &border_map[make_pair(i, j)], mesh_outline);
+            ExpectInterpolatedAttributes(patch_mesh);
+        }
+    }
+    EXPECT_NEAR(total_area, 1600.0 * kGpsStep * kGpsStep, 1e-12);
+
+    // neighbouring patches cut the shared line at the same points.
+    auto find_point = [](const vector<pair<core::vec2d, core::vec2d>>& border_list, const core::vec2d& pos)
+    {
+        for (const auto& edge : border_list)
+        {
+            if (core::length(edge.first - pos) < 1e-12 || core::length(edge.second - pos) < 1e-12)
+            {
+                return true;
+            }
+        }
+        return false;
+    };
+    for (int32_t j = 0; j < 4; j++)
+    {
+        for (int32_t i = 0; i < 3; i++)
+        {
+            double line = kGpsOrigin.x + cuts[i + 1] * kGpsStep;
+            const auto& left = border_map[make_pair(i, j)];
+            const auto& right = border_map[make_pair(i + 1, j)];
+            for (const auto& edge : left)
+            {
+                if (fabs(edge.first.x - line) < 1e-12 && fabs(edge.second.x - line) < 1e-12)
+                {
+                    EXPECT_TRUE(find_point(right, edge.first)) << edge.first.x << ", " << edge.first.y;
+                    EXPECT_TRUE(find_point(right, edge.second)) << edge.second.x << ", " << edge.second.y;
+                }
+            }
+        }
+    }
+}
+
+TEST(MeshClipTest, MeshListsAreClippedOneByOne)
+{
+    unique_ptr<MeshData> inside = CreateGridMesh(40, core::vec3d(0.0, 0.0, 0.0));
+    unique_ptr<MeshData> outside = CreateGridMesh(10, core::vec3d(100.0, 0.0, 0.0));
+    vector<MeshData*> mesh_list = { inside.get(), nullptr, outside.get(), inside.get() };
+
+    vector<core::vec2d> polygon = CreateTestPolygons()[3];
+    vector<unique_ptr<MeshData>> clipped_mesh_list;
+    ClipMeshesToPolygon(mesh_list, polygon, kMeshClipLocal, clipped_mesh_list);
+    ASSERT_EQ(clipped_mesh_list.size(), mesh_list.size());
+    ASSERT_NE(clipped_mesh_list[0], nullptr);
+    EXPECT_EQ(clipped_mesh_list[1], nullptr);
+    EXPECT_EQ(clipped_mesh_list[2], nullptr);
+    ASSERT_NE(clipped_mesh_list[3], nullptr);
+
+    MeshData clipped_mesh;
+    ASSERT_TRUE(ClipMeshToPolygon(*inside, polygon, kMeshClipLocal, clipped_mesh));
+    EXPECT_EQ(clipped_mesh_list[0]->num_vertex, clipped_mesh.num_vertex);
+    EXPECT_EQ(clipped_mesh_list[3]->num_vertex, clipped_mesh.num_vertex);
+    EXPECT_NEAR(GetMeshArea(*clipped_mesh_list[0], kMeshClipLocal), GetPolygonArea(polygon), 1e-4);
+
+    // a degenerate polygon clips nothing.
+    vector<core::vec2d> line = { { 0.0, 0.0 }, { 10.0, 10.0 }, { 20.0, 20.0 } };
+    ClipMeshesToPolygon(mesh_list, line, kMeshClipLocal, clipped_mesh_list);
+    ASSERT_EQ(clipped_mesh_list.size(), mesh_list.size());
+    EXPECT_EQ(clipped_mesh_list[0], nullptr);
+}
+}
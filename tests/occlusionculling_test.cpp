@@ -0,0 +1,327 @@
+#include "occlusionculling.h"
+#include "meshdata.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+namespace
+{
+const float kFovY = core::DegreesToRadians(45.0f);
+
+core::bounds3f MakeBounds(const core::vec3f& a, const core::vec3f& b)
+{
+    core::bounds3f bbox;
+    bbox += a;
+    bbox += b;
+    return bbox;
+}
+
+// the eye at the origin looking down -z, as the viewer sets it up.
+core::matrix4f CreateCamera(float aspect)
+{
+    core::matrix4f proj_mat, view_mat;
+    core::perspective(proj_mat, kFovY, aspect, 0.05f, 8000.0f);
+    core::lookAt(view_mat, core::vec3f(0, 0, 0), core::vec3f(0, 0, -1), core::vec3f(0, 1, 0));
+    return proj_mat * view_mat;
+}
+
+void AddQuad(OcclusionCuller& culler, const core::matrix4f& world_proj_mat,
+             const core::vec3f& a, const core::vec3f& b, const core::vec3f& c, const core::vec3f& d)
+{
+    const core::vec3f vertex_list[4] = { a, b, c, d };
+    const uint32_t index_list[6] = { 0, 1, 2, 0, 2, 3 };
+    culler.add_occluder_triangles(vertex_list, 4, index_list, 6, world_proj_mat);
+}
+
+// the segment from the eye to p crosses the triangle before reaching p.
+bool IsBlocked(const core::vec3f& p, const core::vec3f& a, const core::vec3f& b, const core::vec3f& c)
+{
+    core::vec3f e1 = b - a, e2 = c - a;
+    core::vec3f h = cross(p, e2);
+    float det = dot(e1, h);
+    if (fabs(det) < 1e-12f)
+    {
+        return false;
+    }
+
+    float inv_det = 1.0f / det;
+    core::vec3f s = -a;
+    float u = inv_det * dot(s, h);
+    core::vec3f q = cross(s, e1);
+    float v = inv_det * dot(p, q);
+    float t = inv_det * dot(e2, q);
+    return u >= 0.0f && u <= 1.0f && v >= 0.0f && u + v <= 1.0f && t > 0.0f && t < 1.0f;
+}
+
+// a scene of meshes owned the way the batches own loaded dumps.
+struct TestWorld
+{
+    vector<BatchMeshData*> mesh_data_batches;
+
+    TestWorld()
+    {
+        mesh_data_batches.push_back(new BatchMeshData);
+        mesh_data_batches[0]->group_meshes.push_back(new GroupMeshData);
+    }
+
+    ~TestWorld()
+    {
+        for (BatchMeshData* batch_meshes : mesh_data_batches)
+        {
+            for (GroupMeshData* mesh_group : batch_meshes->group_meshes)
+            {
+                for (MeshData* mesh_data : mesh_group->meshes)
+                {
+                    SAFE_DELETE(mesh_data);
+                }
+                SAFE_DELETE(mesh_group);
+            }
+            SAFE_DELETE(batch_meshes);
+        }
+    }
+
+    // a quad facing the eye, size_x by size_y around translation.
+    MeshData* add_quad(const core::vec3d& translation, float size_x, float size_y, PrimitiveType prim_type)
+    {
+        MeshData* mesh = new MeshData;
+        mesh->translation = translation;
+        mesh->num_vertex = 4;
+        mesh->vertex_list = make_unique<core::vec3f[]>(4);
+        mesh->vertex_list[0] = core::vec3f(-size_x, -size_y, 0.0f);
+        mesh->vertex_list[1] = core::vec3f(size_x, -size_y, 0.0f);
+        mesh->vertex_list[2] = core::vec3f(-size_x, size_y, 0.0f);
+        mesh->vertex_list[3] = core::vec3f(size_x, size_y, 0.0f);
+        for (int32_t i = 0; i < 4; i++)
+        {
+            mesh->bbox_ws += core::vec3d(mesh->vertex_list[i]) + translation;
+        }
+
+        bool b_strip = prim_type == kGlTriangleStrip;
+        mesh->add_draw_call_list(prim_type, b_strip ? 4 : 6);
+        for (uint32_t idx : b_strip ? vector<uint32_t>{ 0, 1, 2, 3 } : vector<uint32_t>{ 0, 1, 3, 0, 3, 2 })
+        {
+            mesh->get_last_draw_call_info().add_index(idx);
+        }
+
+        mesh_data_batches[0]->group_meshes[0]->meshes.push_back(mesh);
+        return mesh;
+    }
+};
+
+TEST(OcclusionCullingTest, WallHidesWhatIsBehindIt)
+{
+    core::matrix4f world_proj_mat = CreateCamera(2.0f);
+    OcclusionCuller culler(kDefaultOcclusionBufferWidth, kDefaultOcclusionBufferWidth / 2);
+    AddQuad(culler, world_proj_mat, core::vec3f(-5, -5, -10), core::vec3f(5, -5, -10), core::vec3f(5, 5, -10), core::vec3f(-5, 5, -10));
+    culler.rasterize();
+    EXPECT_EQ(culler.get_num_triangles(), 2u);
+
+    EXPECT_FALSE(culler.is_visible(MakeBounds(core::vec3f(-1, -1, -20), core::vec3f(1, 1, -19)), world_proj_mat, 1.0f));
+    EXPECT_FALSE(culler.is_visible(MakeBounds(core::vec3f(8, -1, -20), core::vec3f(9, 1, -19)), world_proj_mat, 1.0f));
+    EXPECT_FALSE(culler.is_visible(MakeBounds(core::vec3f(-1, -1, -10.5f), core::vec3f(1, 1, -10.01f)), world_proj_mat, 1.0f));
+    // in front of the wall, past its edge, off the screen, around the eye.
+    EXPECT_TRUE(culler.is_visible(MakeBounds(core::vec3f(-1, -1, -6), core::vec3f(1, 1, -5)), world_proj_mat, 1.0f));
+    EXPECT_TRUE(culler.is_visible(MakeBounds(core::vec3f(9, -1, -20), core::vec3f(11, 1, -19)), world_proj_mat, 1.0f));
+    EXPECT_TRUE(culler.is_visible(MakeBounds(core::vec3f(100, 0, -20), core::vec3f(101, 1, -19)), world_proj_mat, 1.0f));
+    EXPECT_TRUE(culler.is_visible(MakeBounds(core::vec3f(-1, -1, -1), core::vec3f(1, 1, 1)), world_proj_mat, 1.0f));
+    // the occluder never hides itself.
+    EXPECT_TRUE(culler.is_visible(MakeBounds(core::vec3f(-5, -5, -10), core::vec3f(5, 5, -10)), world_proj_mat, 1.0f));
+    // bounds are scaled as the meshes are, half of a box twice as far lands behind the wall.
+    EXPECT_FALSE(culler.is_visible(MakeBounds(core::vec3f(-2, -2, -40), core::vec3f(2, 2, -38)), world_proj_mat, 0.5f));
+
+    culler.clear();
+    culler.rasterize();
+    EXPECT_EQ(culler.get_num_triangles(), 0u);
+    EXPECT_TRUE(culler.is_visible(MakeBounds(core::vec3f(-1, -1, -20), core::vec3f(1, 1, -19)), world_proj_mat, 1.0f));
+}
+
+TEST(OcclusionCullingTest, OccludersCrossingTheNearPlaneAndScreenEdges)
+{
+    core::matrix4f world_proj_mat = CreateCamera(2.0f);
+    OcclusionCuller culler;
+    // a floor from behind the eye into the distance, and a wall reaching far off the left.
+    AddQuad(culler, world_proj_mat, core::vec3f(-50, -1, 5), core::vec3f(50, -1, 5), core::vec3f(50, -1, -100), core::vec3f(-50, -1, -100));
+    AddQuad(culler, world_proj_mat, core::vec3f(-1000, -1, -30), core::vec3f(2, -1, -30), core::vec3f(2, 20, -30), core::vec3f(-1000, 20, -30));
+    culler.rasterize();
+
+    EXPECT_FALSE(culler.is_visible(MakeBounds(core::vec3f(-1, -5, -20), core::vec3f(1, -2, -19)), world_proj_mat, 1.0f));
+    EXPECT_TRUE(culler.is_visible(MakeBounds(core::vec3f(-1, 0, -20), core::vec3f(1, 2, -19)), world_proj_mat, 1.0f));
+    EXPECT_FALSE(culler.is_visible(MakeBounds(core::vec3f(-10, 0, -60), core::vec3f(-5, 5, -50)), world_proj_mat, 1.0f));
+    EXPECT_TRUE(culler.is_visible(MakeBounds(core::vec3f(5, 0, -60), core::vec3f(10, 5, -50)), world_proj_mat, 1.0f));
+}
+
+TEST(OcclusionCullingTest, WorldMeshesOccludeWhatTheyCover)
+{
+    core::vec3d reference_pos(1000.0, 2000.0, 3000.0);
+    core::matrix4f world_proj_mat = CreateCamera(2.0f);
+    TestWorld world;
+    MeshData* wall = world.add_quad(reference_pos + core::vec3d(0, 0, -10), 5.0f, 5.0f, kGlTriangleStrip);
+    MeshData* hidden = world.add_quad(reference_pos + core::vec3d(3, 0, -30), 1.0f, 1.0f, kGlTriangles);
+    MeshData* shown = world.add_quad(reference_pos + core::vec3d(-3, 0, -8), 1.0f, 1.0f, kGlTriangles);
+    MeshData* tiny = world.add_quad(reference_pos + core::vec3d(0, 3, -9), 0.01f, 0.01f, kGlTriangles);
+
+    OcclusionCuller culler;
+    // the tiny one covers too few pixels to be an occluder.
+    EXPECT_EQ(AddWorldOccluders(culler, world.mesh_data_batches, reference_pos, world_proj_mat, 1.0f), 3u);
+    culler.rasterize();
+    EXPECT_TRUE(culler.is_visible(wall, reference_pos, world_proj_mat, 1.0f));
+    EXPECT_FALSE(culler.is_visible(hidden, reference_pos, world_proj_mat, 1.0f));
+    EXPECT_TRUE(culler.is_visible(shown, reference_pos, world_proj_mat, 1.0f));
+    EXPECT_TRUE(culler.is_visible(tiny, reference_pos, world_proj_mat, 1.0f));
+
+    // patches draw under the selection mask, they don't occlude.
+    wall->draw_call_list[0].set_drawable_patches(true);
+    culler.clear();
+    AddWorldOccluders(culler, world.mesh_data_batches, reference_pos, world_proj_mat, 1.0f);
+    culler.rasterize();
+    EXPECT_TRUE(culler.is_visible(hidden, reference_pos, world_proj_mat, 1.0f));
+
+    // neither do spline meshes.
+    wall->draw_call_list[0].set_drawable_patches(false);
+    world.mesh_data_batches[0]->is_spline_mesh = true;
+    culler.clear();
+    EXPECT_EQ(AddWorldOccluders(culler, world.mesh_data_batches, reference_pos, world_proj_mat, 1.0f), 0u);
+}
+
+// random triangles and bounds at random buffer sizes. whatever the culler hides has to be
+// hidden from the eye too, checked by casting rays to points sampled in the bounds. a point
+// counts as seen only if the rays to it and to its neighbours 2 pixels away all get through,
+// so a box showing through less than a pixel may still be hidden.
+TEST(OcclusionCullingTest, RandomScenesNeverHideWhatRaysSee)
+{
+    mt19937 rng(7);
+    uniform_real_distribution<float> unit(0.0f, 1.0f);
+    float tan_half_fov = tan(kFovY * 0.5f);
+    uint32_t num_hidden = 0;
+    for (int32_t i_scene = 0; i_scene < 300; i_scene++)
+    {
+        float aspect = 0.5f + 2.0f * unit(rng);
+        core::matrix4f world_proj_mat = CreateCamera(aspect);
+        int32_t width = 64 + int32_t(unit(rng) * 300);
+        int32_t height = 32 + int32_t(unit(rng) * 200);
+        OcclusionCuller culler(width, height);
+
+        vector<core::vec3f> vertex_list;
+        int32_t num_triangles = 1 + int32_t(unit(rng) * 12);
+        for (int32_t i = 0; i < num_triangles; i++)
+        {
+            core::vec3f center((unit(rng) - 0.5f) * 30.0f, (unit(rng) - 0.5f) * 20.0f, -5.0f - unit(rng) * 30.0f);
+            for (int32_t k = 0; k < 3; k++)
+            {
+                vertex_list.push_back(center + core::vec3f((unit(rng) - 0.5f) * 30.0f, (unit(rng) - 0.5f) * 30.0f, (unit(rng) - 0.5f) * 6.0f));
+            }
+        }
+        vector<uint32_t> index_list(vertex_list.size());
+        for (uint32_t i = 0; i < index_list.size(); i++)
+        {
+            index_list[i] = i;
+        }
+        culler.add_occluder_triangles(vertex_list.data(), uint32_t(vertex_list.size()), index_list.data(), index_list.size(), world_proj_mat);
+        culler.rasterize();
+
+        for (int32_t i_box = 0; i_box < 40; i_box++)
+        {
+            core::vec3f center((unit(rng) - 0.5f) * 30.0f, (unit(rng) - 0.5f) * 20.0f, -10.0f - unit(rng) * 40.0f);
+            core::vec3f extent(unit(rng) * 2.0f + 0.1f, unit(rng) * 2.0f + 0.1f, unit(rng) * 2.0f + 0.1f);
+            core::bounds3f bbox = MakeBounds(center - extent, center + extent);
+            if (culler.is_visible(bbox, world_proj_mat, 1.0f))
+            {
+                continue;
+            }
+            num_hidden++;
+
+            float pixel_size = 2.0f * 2.0f * tan_half_fov / height;
+            for (int32_t i_sample = 0; i_sample < 400; i_sample++)
+            {
+                core::vec3f p = bbox.bb_min + core::vec3f(unit(rng), unit(rng), unit(rng)) * (bbox.bb_max - bbox.bb_min);
+                float dist = -p.z;
+                // the frustum culls what is off the screen, not this.
+                if (fabs(p.y) > dist * tan_half_fov * 0.98f || fabs(p.x) > dist * tan_half_fov * aspect * 0.98f)
+                {
+                    continue;
+                }
+
+                bool b_seen = true;
+                for (int32_t dy = -1; dy <= 1 && b_seen; dy++)
+                {
+                    for (int32_t dx = -1; dx <= 1 && b_seen; dx++)
+                    {
+                        core::vec3f q = p + core::vec3f(dx * pixel_size * dist * aspect * height / width, dy * pixel_size * dist, 0.0f);
+                        for (size_t t = 0; t < vertex_list.size() && b_seen; t += 3)
+                        {
+                            b_seen = !IsBlocked(q, vertex_list[t], vertex_list[t + 1], vertex_list[t + 2]);
+                        }
+                    }
+                }
+                ASSERT_FALSE(b_seen) << "scene " << i_scene << " box " << i_box << " hidden but seen at "
+                                     << p.x << " " << p.y << " " << p.z;
+            }
+        }
+    }
+    // the scenes are dense enough that plenty is hidden, or the test proves nothing.
+    EXPECT_GT(num_hidden, 100u);
+}
+
+// tiles own their pixels, so splitting them over threads must give the serial depth bit
+// for bit, small scenes that stay serial as well as ones past kMinParallelOcclusionBins.
+TEST(OcclusionCullingTest, ParallelTilesMatchSerialDepth)
+{
+    mt19937 rng(9);
+    uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (int32_t num_triangles : { 10, 500, 20000 })
+    {
+        core::matrix4f world_proj_mat = CreateCamera(2.0f);
+        vector<core::vec3f> vertex_list;
+        for (int32_t i = 0; i < num_triangles; i++)
+        {
+            core::vec3f center((unit(rng) - 0.5f) * 60.0f, (unit(rng) - 0.5f) * 30.0f, -1.0f - unit(rng) * 60.0f);
+            for (int32_t k = 0; k < 3; k++)
+            {
+                vertex_list.push_back(center + core::vec3f((unit(rng) - 0.5f) * 8.0f, (unit(rng) - 0.5f) * 8.0f, (unit(rng) - 0.5f) * 4.0f));
+            }
+        }
+        vector<uint32_t> index_list(vertex_list.size());
+        for (uint32_t i = 0; i < index_list.size(); i++)
+        {
+            index_list[i] = i;
+        }
+
+        OcclusionCuller serial_culler, parallel_culler;
+        serial_culler.set_num_threads(1);
+        parallel_culler.set_num_threads(4);
+        for (OcclusionCuller* culler : { &serial_culler, &parallel_culler })
+        {
+            // twice, the second frame reuses the pool and has to clear what the first left.
+            for (int32_t i_frame = 0; i_frame < 2; i_frame++)
+            {
+                culler->clear();
+                culler->add_occluder_triangles(vertex_list.data(), uint32_t(vertex_list.size()), index_list.data(), index_list.size(), world_proj_mat);
+                culler->rasterize();
+            }
+        }
+
+        uint32_t num_covered = 0;
+        for (int32_t y = 0; y < serial_culler.get_height(); y++)
+        {
+            for (int32_t x = 0; x < serial_culler.get_width(); x++)
+            {
+                float serial_depth = serial_culler.get_depth(x, y);
+                float parallel_depth = parallel_culler.get_depth(x, y);
+                ASSERT_EQ(memcmp(&serial_depth, &parallel_depth, sizeof(float)), 0)
+                    << num_triangles << " triangles, pixel " << x << " " << y;
+                num_covered += serial_depth > 0.0f ? 1 : 0;
+            }
+        }
+        EXPECT_GT(num_covered, 0u);
+
+        // the block depths the tests read have to agree too.
+        for (int32_t i_box = 0; i_box < 200; i_box++)
+        {
+            core::vec3f center((unit(rng) - 0.5f) * 60.0f, (unit(rng) - 0.5f) * 30.0f, -5.0f - unit(rng) * 60.0f);
+            core::bounds3f bbox = MakeBounds(center - core::vec3f(1, 1, 1), center + core::vec3f(1, 1, 1));
+            EXPECT_EQ(serial_culler.is_visible(bbox, world_proj_mat, 1.0f), parallel_culler.is_visible(bbox, world_proj_mat, 1.0f));
+        }
+    }
+}
+}
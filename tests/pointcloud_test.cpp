@@ -0,0 +1,350 @@
+#include "pointcloud.h"
+#include "coregeographic.h"
+#include <gtest/gtest.h>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <random>
+
+namespace
+{
+const core::vec2d kGpsOrigin(-122.4, 37.8);
+constexpr double kGpsStep = 1e-4;       // degrees per grid cell, about 9 x 11 meters
+
+// a n x n grid of cells from kGpsOrigin with gps coordinates, vertex colors and a gentle slope.
+MeshData* CreateGridMesh(uint32_t n)
+{
+    uint32_t row = n + 1;
+    MeshData* mesh_data = new MeshData;
+    mesh_data->num_vertex = int(row * row);
+    mesh_data->vertex_list = make_unique<core::vec3f[]>(row * row);
+    mesh_data->gps_vert_list = make_unique<core::GpsCoord[]>(row * row);
+    mesh_data->color_list = make_unique<uint32_t[]>(row * row);
+    for (uint32_t y = 0; y < row; y++)
+    {
+        for (uint32_t x = 0; x < row; x++)
+        {
+            uint32_t i = y * row + x;
+            mesh_data->vertex_list[i] = core::vec3f(float(x), float(y), 0.0f);
+            mesh_data->gps_vert_list[i] = core::GpsCoord(kGpsOrigin.x + x * kGpsStep, kGpsOrigin.y + y * kGpsStep, 10.0 + 0.5 * x);
+            mesh_data->color_list[i] = 0xff000000 | (x * 16) | ((y * 16) << 8) | (0x80 << 16);
+        }
+    }
+
+    mesh_data->add_draw_call_list(kGlTriangles, int(n * n * 6), int(row * row));
+    DrawCallInfo& draw_call = mesh_data->get_last_draw_call_info();
+    for (uint32_t y = 0; y < n; y++)
+    {
+        for (uint32_t x = 0; x < n; x++)
+        {
+            uint32_t i = y * row + x;
+            uint32_t quad[6] = { i, i + 1, i + row + 1, i, i + row + 1, i + row };
+            for (uint32_t idx : quad)
+            {
+                draw_call.add_index(idx);
+            }
+        }
+    }
+    return mesh_data;
+}
+
+struct TestWorld
+{
+    vector<BatchMeshData*> batch_mesh_data;
+
+    explicit TestWorld(uint32_t n)
+    {
+        BatchMeshData* batch = new BatchMeshData;
+        batch->reference_pos = kGpsOrigin;
+        GroupMeshData* group = new GroupMeshData;
+        group->meshes.push_back(CreateGridMesh(n));
+        batch->group_meshes.push_back(group);
+        batch_mesh_data.push_back(batch);
+    }
+
+    ~TestWorld()
+    {
+        for (auto batch : batch_mesh_data)
+        {
+            for (auto group : batch->group_meshes)
+            {
+                for (auto& mesh_data : group->meshes)
+                {
+                    SAFE_DELETE(mesh_data);
+                }
+                delete group;
+            }
+            delete batch;
+        }
+    }
+};
+
+vector<uint8_t> ReadFileData(const string& file_name)
+{
+    ifstream file(file_name, ifstream::binary);
+    return vector<uint8_t>(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+}
+
+template <class T>
+T ReadValue(const vector<uint8_t>& data, size_t offset)
+{
+    T value;
+    memcpy(&value, &data[offset], sizeof(T));
+    return value;
+}
+
+// points on a jittered grid with colors from their position, past one voxel chunk.
+PointCloud CreateTestCloud(uint32_t n, double spacing)
+{
+    mt19937 rng(5);
+    uniform_real_distribution<double> jitter(0.0, spacing);
+    PointCloud point_cloud;
+    point_cloud.utm_zone = 10;
+    for (uint32_t y = 0; y < n; y++)
+    {
+        for (uint32_t x = 0; x < n; x++)
+        {
+            core::vec3d p(550000.0 + x * spacing + jitter(rng), 4180000.0 + y * spacing + jitter(rng), 20.0 + jitter(rng) * 3.0);
+            point_cloud.position_list.push_back(p);
+            point_cloud.color_list.push_back(0xff000000 | (x & 0xff) | ((y & 0xff) << 8) | (((x + y) & 0xff) << 16));
+            point_cloud.bbox += p;
+        }
+    }
+    return point_cloud;
+}
+
+TEST(PointCloudTest, VoxelsAverageTheirPoints)
+{
+    const double voxel_size = 0.5;
+    PointCloud point_cloud = CreateTestCloud(300, 0.13);
+    core::bounds3d bbox = point_cloud.bbox;
+
+    // the voxels and their sums one point at a time.
+    struct Sum { core::vec3d p; uint32_t c[4]; uint32_t count; };
+    map<tuple<int64_t, int64_t, int64_t>, Sum> voxel_map;
+    for (size_t i = 0; i < point_cloud.position_list.size(); i++)
+    {
+        core::vec3d p = point_cloud.position_list[i] - bbox.bb_min;
+        auto key = make_tuple(int64_t(p.x / voxel_size), int64_t(p.y / voxel_size), int64_t(p.z / voxel_size));
+        Sum& sum = voxel_map.emplace(key, Sum{ core::vec3d(0, 0, 0), { 0, 0, 0, 0 }, 0 }).first->second;
+        sum.p += point_cloud.position_list[i];
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            sum.c[c] += (point_cloud.color_list[i] >> (c * 8)) & 0xff;
+        }
+        sum.count++;
+    }
+
+    ASSERT_TRUE(DownsamplePointCloud(point_cloud, voxel_size));
+    ASSERT_EQ(point_cloud.position_list.size(), voxel_map.size());
+    ASSERT_EQ(point_cloud.color_list.size(), voxel_map.size());
+
+    // the output is in voxel order, x major as the map is.
+    size_t i = 0;
+    for (const auto& item : voxel_map)
+    {
+        const Sum& sum = item.second;
+        core::vec3d mean = sum.p / double(sum.count);
+        const core::vec3d& p = point_cloud.position_list[i];
+        EXPECT_NEAR(p.x, mean.x, 1e-6) << "voxel " << i;
+        EXPECT_NEAR(p.y, mean.y, 1e-6) << "voxel " << i;
+        EXPECT_NEAR(p.z, mean.z, 1e-6) << "voxel " << i;
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            EXPECT_EQ((point_cloud.color_list[i] >> (c * 8)) & 0xff, (sum.c[c] + sum.count / 2) / sum.count) << "voxel " << i;
+        }
+        i++;
+    }
+
+    EXPECT_TRUE(point_cloud.bbox.b_valid);
+    for (int32_t c = 0; c < 3; c++)
+    {
+        EXPECT_GE(point_cloud.bbox.bb_min[c], bbox.bb_min[c]);
+        EXPECT_LE(point_cloud.bbox.bb_max[c], bbox.bb_max[c]);
+    }
+
+    // a voxel size the bounds can not be keyed with is refused.
+    PointCloud large_cloud = CreateTestCloud(4, 1000.0);
+    EXPECT_FALSE(DownsamplePointCloud(large_cloud, 1e-4));
+}
+
+// surface samples of a synthetic mesh land on it, as many as its area asks for.
+TEST(PointCloudTest, SurfaceSamplesCoverTheMesh)
+{
+    const uint32_t n = 6;
+    TestWorld world(n);
+    PointCloudOptions options;
+    options.surface_density = 2.0;
+
+    PointCloud point_cloud;
+    ASSERT_TRUE(SamplePointCloud(world.batch_mesh_data, options, point_cloud));
+    EXPECT_EQ(point_cloud.utm_zone, 10);
+    EXPECT_TRUE(point_cloud.northp);
+    ASSERT_EQ(point_cloud.position_list.size(), point_cloud.color_list.size());
+
+    // the utm corners of the grid, the cells are parallelograms to well within a centimeter.
+    core::UTMProjector projector;
+    core::bounds3d grid_bbox;
+    for (uint32_t y = 0; y <= n; y += n)
+    {
+        for (uint32_t x = 0; x <= n; x += n)
+        {
+            core::vec2d utm_loc = projector.forward(core::vec2d(kGpsOrigin.y + y * kGpsStep, kGpsOrigin.x + x * kGpsStep), 10, true);
+            grid_bbox += core::vec3d(utm_loc.x, utm_loc.y, 10.0 + 0.5 * x);
+        }
+    }
+    core::vec3d size = grid_bbox.GetDiagonal();
+    double expected = size.x * size.y * options.surface_density;
+    EXPECT_NEAR(double(point_cloud.position_list.size()), expected, expected * 0.05);
+    for (const auto& p : point_cloud.position_list)
+    {
+        ASSERT_GT(p.x, grid_bbox.bb_min.x - 0.5);
+        ASSERT_LT(p.x, grid_bbox.bb_max.x + 0.5);
+        ASSERT_GT(p.y, grid_bbox.bb_min.y - 0.5);
+        ASSERT_LT(p.y, grid_bbox.bb_max.y + 0.5);
+        ASSERT_GE(p.z, grid_bbox.bb_min.z - 1e-6);
+        ASSERT_LE(p.z, grid_bbox.bb_max.z + 1e-6);
+    }
+
+    // a point per vertex at the vertex.
+    options.sample_mode = kPointSampleVertices;
+    ASSERT_TRUE(SamplePointCloud(world.batch_mesh_data, options, point_cloud));
+    ASSERT_EQ(point_cloud.position_list.size(), size_t((n + 1) * (n + 1)));
+    const MeshData* mesh_data = world.batch_mesh_data[0]->group_meshes[0]->meshes[0];
+    for (uint32_t i = 0; i < point_cloud.position_list.size(); i++)
+    {
+        const core::GpsCoord& gps_coord = mesh_data->gps_vert_list[i];
+        core::vec2d utm_loc = projector.forward(core::vec2d(gps_coord.lat, gps_coord.lon), 10, true);
+        EXPECT_DOUBLE_EQ(point_cloud.position_list[i].x, utm_loc.x);
+        EXPECT_DOUBLE_EQ(point_cloud.position_list[i].y, utm_loc.y);
+        EXPECT_EQ(point_cloud.color_list[i], mesh_data->color_list[i]);
+    }
+
+    // downsampling keeps the bounds and leaves about a point per occupied cell.
+    options.sample_mode = kPointSampleSurface;
+    options.surface_density = 16.0;
+    ASSERT_TRUE(SamplePointCloud(world.batch_mesh_data, options, point_cloud));
+    core::bounds3d sample_bbox = point_cloud.bbox;
+    ASSERT_TRUE(DownsamplePointCloud(point_cloud, 1.0));
+    double num_cells = ceil(size.x) * ceil(size.y);
+    EXPECT_LE(double(point_cloud.position_list.size()), num_cells * ceil(size.z + 1.0));
+    EXPECT_GE(double(point_cloud.position_list.size()), size.x * size.y * 0.9);
+    for (int32_t c = 0; c < 3; c++)
+    {
+        EXPECT_GE(point_cloud.bbox.bb_min[c], sample_bbox.bb_min[c]);
+        EXPECT_LE(point_cloud.bbox.bb_max[c], sample_bbox.bb_max[c]);
+    }
+
+    vector<BatchMeshData*> no_batches;
+    EXPECT_FALSE(SamplePointCloud(no_batches, options, point_cloud));
+}
+
+TEST(PointCloudTest, PlyHeaderAndPoints)
+{
+    PointCloud point_cloud = CreateTestCloud(10, 1.0);
+    const string file_name = "pointcloud_test.ply";
+    ASSERT_TRUE(ExportPlyPointFile(file_name, point_cloud));
+    vector<uint8_t> data = ReadFileData(file_name);
+    remove(file_name.c_str());
+
+    const string end_header = "end_header\n";
+    string text(data.begin(), data.end());
+    size_t header_size = text.find(end_header);
+    ASSERT_NE(header_size, string::npos);
+    header_size += end_header.size();
+    string header = text.substr(0, header_size);
+    EXPECT_EQ(header.find("ply\nformat binary_little_endian 1.0\n"), 0u);
+    EXPECT_NE(header.find("comment utm zone 10 north\n"), string::npos);
+    EXPECT_NE(header.find("element vertex 100\n"), string::npos);
+    EXPECT_NE(header.find("property double x\nproperty double y\nproperty double z\n"
+                          "property uchar red\nproperty uchar green\nproperty uchar blue\n"), string::npos);
+    ASSERT_EQ(data.size(), header_size + 100 * 27);
+
+    for (size_t i = 0; i < 100; i++)
+    {
+        size_t offset = header_size + i * 27;
+        EXPECT_EQ(ReadValue<double>(data, offset), point_cloud.position_list[i].x);
+        EXPECT_EQ(ReadValue<double>(data, offset + 8), point_cloud.position_list[i].y);
+        EXPECT_EQ(ReadValue<double>(data, offset + 16), point_cloud.position_list[i].z);
+        uint32_t color = point_cloud.color_list[i];
+        EXPECT_EQ(data[offset + 24], uint8_t(color));
+        EXPECT_EQ(data[offset + 25], uint8_t(color >> 8));
+        EXPECT_EQ(data[offset + 26], uint8_t(color >> 16));
+    }
+}
+
+// the las 1.2 public header block, the geokey record and format 2 points.
+TEST(PointCloudTest, LasHeaderAndPoints)
+{
+    PointCloud point_cloud = CreateTestCloud(10, 1.3);
+    point_cloud.utm_zone = 33;
+    point_cloud.northp = false;
+    const string file_name = "pointcloud_test.las";
+    ASSERT_TRUE(ExportLasPointFile(file_name, point_cloud));
+    vector<uint8_t> data = ReadFileData(file_name);
+    remove(file_name.c_str());
+
+    const uint32_t header_size = 227, vlr_size = 54 + 48, num_points = 100;
+    ASSERT_EQ(data.size(), header_size + vlr_size + num_points * 26);
+    EXPECT_EQ(memcmp(data.data(), "LASF", 4), 0);
+    EXPECT_EQ(data[24], 1);
+    EXPECT_EQ(data[25], 2);
+    EXPECT_EQ(ReadValue<uint16_t>(data, 94), header_size);
+    EXPECT_EQ(ReadValue<uint32_t>(data, 96), header_size + vlr_size);
+    EXPECT_EQ(ReadValue<uint32_t>(data, 100), 1u);
+    EXPECT_EQ(data[104], 2);
+    EXPECT_EQ(ReadValue<uint16_t>(data, 105), 26);
+    EXPECT_EQ(ReadValue<uint32_t>(data, 107), num_points);
+    EXPECT_EQ(ReadValue<uint32_t>(data, 111), num_points);
+
+    double scale[3], offset[3], bb_max[3], bb_min[3];
+    for (int32_t c = 0; c < 3; c++)
+    {
+        scale[c] = ReadValue<double>(data, 131 + c * 8);
+        offset[c] = ReadValue<double>(data, 155 + c * 8);
+        bb_max[c] = ReadValue<double>(data, 179 + c * 16);
+        bb_min[c] = ReadValue<double>(data, 187 + c * 16);
+        EXPECT_EQ(scale[c], 0.001);
+        EXPECT_EQ(offset[c], floor(point_cloud.bbox.bb_min[c]));
+        EXPECT_NEAR(bb_min[c], point_cloud.bbox.bb_min[c], 0.0005);
+        EXPECT_NEAR(bb_max[c], point_cloud.bbox.bb_max[c], 0.0005);
+    }
+
+    // the projection record, wgs 84 / utm zone 33s.
+    size_t vlr = header_size;
+    EXPECT_EQ(string(reinterpret_cast<const char*>(&data[vlr + 2])), "LASF_Projection");
+    EXPECT_EQ(ReadValue<uint16_t>(data, vlr + 18), 34735);
+    EXPECT_EQ(ReadValue<uint16_t>(data, vlr + 20), 48);
+    size_t keys = vlr + 54;
+    EXPECT_EQ(ReadValue<uint16_t>(data, keys + 0), 1);
+    EXPECT_EQ(ReadValue<uint16_t>(data, keys + 6), 5);
+    bool b_found = false;
+    for (uint32_t i = 1; i <= 5; i++)
+    {
+        if (ReadValue<uint16_t>(data, keys + i * 8) == 3072)
+        {
+            EXPECT_EQ(ReadValue<uint16_t>(data, keys + i * 8 + 6), 32733);
+            b_found = true;
+        }
+    }
+    EXPECT_TRUE(b_found);
+
+    // the stored coordinates within half a millimeter, the colors widened to 16 bits.
+    for (uint32_t i = 0; i < num_points; i++)
+    {
+        size_t point = header_size + vlr_size + i * 26;
+        for (int32_t c = 0; c < 3; c++)
+        {
+            double value = ReadValue<int32_t>(data, point + c * 4) * scale[c] + offset[c];
+            EXPECT_NEAR(value, point_cloud.position_list[i][c], 0.0005) << "point " << i;
+            EXPECT_GE(value, bb_min[c]);
+            EXPECT_LE(value, bb_max[c]);
+        }
+        EXPECT_EQ(data[point + 14], 0x09);
+        uint32_t color = point_cloud.color_list[i];
+        EXPECT_EQ(ReadValue<uint16_t>(data, point + 20), (color & 0xff) * 257);
+        EXPECT_EQ(ReadValue<uint16_t>(data, point + 22), ((color >> 8) & 0xff) * 257);
+        EXPECT_EQ(ReadValue<uint16_t>(data, point + 24), ((color >> 16) & 0xff) * 257);
+    }
+}
+}
@@ -0,0 +1,372 @@
+#include "quantizedmesh.h"
+#include "hfa/hfa_p.h"
+#include "hfa/hfa.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <random>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+constexpr int32_t kQuantizedRange = 32767;
+
+// a mesh of random triangles whose vertices come in first use order, as the encoder requires.
+QuantizedMesh CreateTestMesh(uint32_t num_vertices, uint32_t num_triangles, uint32_t seed)
+{
+    mt19937 rng(seed);
+    uniform_int_distribution<uint32_t> value(0, kQuantizedRange);
+    QuantizedMesh mesh;
+    mesh.center = core::vec3d(-2700000.5, -4290000.25, 3860000.125);
+    mesh.min_height = -12.5f;
+    mesh.max_height = 1432.75f;
+    mesh.bounding_sphere_center = core::vec3d(-2700010.0, -4290020.0, 3860030.0);
+    mesh.bounding_sphere_radius = 5678.9;
+    mesh.horizon_occlusion_point = core::vec3d(-0.42, -0.67, 0.61);
+
+    uint32_t highest = 0;
+    for (uint32_t i = 0; i < num_triangles * 3; i++)
+    {
+        // mostly new vertices until all are used, so the high water mark climbs to the end.
+        bool b_new = highest < num_vertices && (highest == 0 || rng() % 4 != 0 || num_vertices - highest >= (num_triangles * 3 - i));
+        uint32_t index = b_new ? highest++ : rng() % highest;
+        mesh.index_list.push_back(index);
+    }
+    for (uint32_t i = 0; i < highest; i++)
+    {
+        // large jumps in both directions exercise the zig-zag deltas.
+        mesh.u_list.push_back(uint16_t(value(rng)));
+        mesh.v_list.push_back(uint16_t(i % 2 ? kQuantizedRange - value(rng) / 8 : value(rng) / 8));
+        mesh.height_list.push_back(uint16_t(value(rng)));
+    }
+    for (vector<uint32_t>* edge : { &mesh.west_index_list, &mesh.south_index_list, &mesh.east_index_list, &mesh.north_index_list })
+    {
+        for (uint32_t i = rng() % 5; i < highest; i += 1 + rng() % 97)
+        {
+            edge->push_back(i);
+        }
+    }
+    return mesh;
+}
+
+void ExpectSameVec3(const core::vec3d& a, const core::vec3d& b)
+{
+    EXPECT_EQ(a.x, b.x);
+    EXPECT_EQ(a.y, b.y);
+    EXPECT_EQ(a.z, b.z);
+}
+
+void ExpectSameMesh(const QuantizedMesh& a, const QuantizedMesh& b)
+{
+    ExpectSameVec3(a.center, b.center);
+    EXPECT_EQ(a.min_height, b.min_height);
+    EXPECT_EQ(a.max_height, b.max_height);
+    ExpectSameVec3(a.bounding_sphere_center, b.bounding_sphere_center);
+    EXPECT_EQ(a.bounding_sphere_radius, b.bounding_sphere_radius);
+    ExpectSameVec3(a.horizon_occlusion_point, b.horizon_occlusion_point);
+    EXPECT_EQ(a.u_list, b.u_list);
+    EXPECT_EQ(a.v_list, b.v_list);
+    EXPECT_EQ(a.height_list, b.height_list);
+    EXPECT_EQ(a.index_list, b.index_list);
+    EXPECT_EQ(a.west_index_list, b.west_index_list);
+    EXPECT_EQ(a.south_index_list, b.south_index_list);
+    EXPECT_EQ(a.east_index_list, b.east_index_list);
+    EXPECT_EQ(a.north_index_list, b.north_index_list);
+}
+
+TEST(QuantizedMeshTest, EncodeDecodeRoundTrip)
+{
+    // the last two need 32 bit indices, 65537 vertices is the first such size.
+    const uint32_t sizes[][2] = { { 3, 1 }, { 500, 900 }, { 65536, 40000 }, { 65537, 40000 }, { 100000, 70000 } };
+    for (const auto& size : sizes)
+    {
+        QuantizedMesh mesh = CreateTestMesh(size[0], size[1], size[0] + size[1]);
+        ASSERT_EQ(mesh.u_list.size(), size[0]);
+
+        vector<uint8_t> data;
+        ASSERT_TRUE(EncodeQuantizedMesh(mesh, data)) << size[0];
+        size_t index_size = size[0] > 65536 ? 4 : 2;
+        size_t edge_size = mesh.west_index_list.size() + mesh.south_index_list.size() + mesh.east_index_list.size() + mesh.north_index_list.size();
+        size_t vertex_end = 88 + 4 + size_t(size[0]) * 6;
+        size_t padding = index_size == 4 ? (4 - vertex_end % 4) % 4 : 0;
+        EXPECT_EQ(data.size(), vertex_end + padding + 4 + mesh.index_list.size() * index_size + 16 + edge_size * index_size) << size[0];
+
+        QuantizedMesh decoded;
+        ASSERT_TRUE(DecodeQuantizedMesh(data.data(), data.size(), decoded)) << size[0];
+        SCOPED_TRACE(testing::Message() << size[0] << " vertices");
+        ExpectSameMesh(mesh, decoded);
+    }
+}
+
+TEST(QuantizedMeshTest, DecodeRejectsTruncatedAndBadData)
+{
+    QuantizedMesh mesh = CreateTestMesh(200, 300, 5), decoded;
+    vector<uint8_t> data;
+    ASSERT_TRUE(EncodeQuantizedMesh(mesh, data));
+
+    // every cut that drops part of a section fails, the edge lists end the tile.
+    for (size_t size = 0; size < data.size(); size += 1 + size / 64)
+    {
+        EXPECT_FALSE(DecodeQuantizedMesh(data.data(), size, decoded)) << size;
+    }
+
+    // a high water mark code past the vertices seen so far.
+    vector<uint8_t> bad = data;
+    size_t index_ofs = 88 + 4 + 200 * 6 + 4;
+    uint16_t code = 5;
+    memcpy(&bad[index_ofs], &code, 2);
+    EXPECT_FALSE(DecodeQuantizedMesh(bad.data(), bad.size(), decoded));
+
+    // an edge index past the vertex count.
+    bad = data;
+    uint16_t edge_index = 200;
+    memcpy(&bad[bad.size() - 2], &edge_index, 2);
+    EXPECT_FALSE(DecodeQuantizedMesh(bad.data(), bad.size(), decoded));
+}
+
+TEST(QuantizedMeshTest, EncodeRejectsInvalidMeshes)
+{
+    QuantizedMesh mesh = CreateTestMesh(50, 40, 9);
+    vector<uint8_t> data;
+
+    QuantizedMesh bad = mesh;
+    bad.index_list[0] = 1;      // ahead of the first use order
+    EXPECT_FALSE(EncodeQuantizedMesh(bad, data));
+
+    bad = mesh;
+    bad.index_list.pop_back();
+    EXPECT_FALSE(EncodeQuantizedMesh(bad, data));
+
+    bad = mesh;
+    bad.height_list.pop_back();
+    EXPECT_FALSE(EncodeQuantizedMesh(bad, data));
+}
+
+// a hill over a slope, in meters over a raster in degrees.
+float GetTestHeight(const core::vec2d& pos)
+{
+    double dx = (pos.x + 121.85) * 40.0, dy = (pos.y - 37.9) * 40.0;
+    return float(300.0 * exp(-(dx * dx + dy * dy)) + 20.0 * pos.y - 700.0);
+}
+
+bool CreateRaster(const string& file_name, const core::vec2d& ul_corner, const core::vec2d& pixel_size, int w, int h)
+{
+    HFAHandle h_hfa = HFACreate(file_name.c_str(), w, h, 1, EPT_f32, nullptr);
+    if (!h_hfa)
+    {
+        return false;
+    }
+
+    int data_type, block_w, block_h, num_overviews, compression;
+    HFAGetBandInfo(h_hfa, 1, &data_type, &block_w, &block_h, &num_overviews, &compression);
+    vector<float> block(size_t(block_w) * block_h);
+    bool succeeded = true;
+    for (int b_y = 0; b_y * block_h < h; b_y++)
+    {
+        for (int b_x = 0; b_x * block_w < w; b_x++)
+        {
+            for (int y = 0; y < block_h; y++)
+            {
+                for (int x = 0; x < block_w; x++)
+                {
+                    core::vec2d s(double(b_x * block_w + x), double(b_y * block_h + y));
+                    block[size_t(y) * block_w + x] = GetTestHeight(ul_corner + pixel_size * s);
+                }
+            }
+            succeeded &= HFASetRasterBlock(h_hfa, 1, b_x, b_y, block.data()) == CE_None;
+        }
+    }
+    HFAClose(h_hfa);
+    return succeeded;
+}
+
+bool ReadTile(const string& file_name, vector<uint8_t>& data)
+{
+    ifstream in_file(file_name, ifstream::binary);
+    data.assign(istreambuf_iterator<char>(in_file), istreambuf_iterator<char>());
+    return bool(in_file) || in_file.eof();
+}
+
+// the edge vertices sit on the edge, ordered along it.
+void ExpectEdge(const vector<uint32_t>& edge, const vector<uint16_t>& across, uint16_t value, const vector<uint16_t>& along)
+{
+    for (size_t i = 0; i < edge.size(); i++)
+    {
+        EXPECT_EQ(across[edge[i]], value);
+        if (i > 0)
+        {
+            EXPECT_LT(along[edge[i - 1]], along[edge[i]]);
+        }
+    }
+}
+
+TEST(QuantizedMeshTest, ExportedTilesDecodeToTheSampledHeights)
+{
+    const string raster_name = "quantizedmesh_test.img";
+    const string folder_name = "quantizedmesh_test_tiles";
+    const core::vec2d ul_corner(-122.0, 38.0), pixel_size(0.001, -0.001);
+    ASSERT_TRUE(CreateRaster(raster_name, ul_corner, pixel_size, 300, 200));
+
+    ElevationMosaic mosaic;
+    auto grid = make_shared<ElevationGrid>();
+    ASSERT_TRUE(grid->open(raster_name, 1, mosaic.get_cache()));
+    mosaic.add_tile(grid, ul_corner, pixel_size);
+    mosaic.build();
+
+    TerrainTilerOptions options;
+    options.max_level = 10;
+    options.grid_size = 33;
+    options.error_scale = 0.01;
+    vector<QuantizedMeshTileInfo> tile_info_list;
+    ASSERT_TRUE(ExportQuantizedMeshTiles(mosaic, folder_name, options, nullptr, &tile_info_list));
+    ASSERT_FALSE(tile_info_list.empty());
+
+    const uint32_t tile_size = options.grid_size - 1;
+    for (const auto& info : tile_info_list)
+    {
+        SCOPED_TRACE(testing::Message() << info.level << "/" << info.x << "/" << info.y);
+        vector<uint8_t> data;
+        string file_name = folder_name + "/" + to_string(info.level) + "/" + to_string(info.x) + "/" + to_string(info.y) + ".terrain";
+        ASSERT_TRUE(ReadTile(file_name, data));
+
+        QuantizedMesh mesh;
+        ASSERT_TRUE(DecodeQuantizedMesh(data.data(), data.size(), mesh));
+        ASSERT_EQ(mesh.u_list.size(), info.num_vertices);
+        ASSERT_EQ(mesh.index_list.size(), size_t(info.num_triangles) * 3);
+        EXPECT_EQ(mesh.min_height, info.min_height);
+        EXPECT_EQ(mesh.max_height, info.max_height);
+
+        // outside the ellipsoid in its scaled space, the level 0 tiles spanning a hemisphere too.
+        const core::vec3d& horizon_point = mesh.horizon_occlusion_point;
+        ASSERT_TRUE(isfinite(horizon_point.x) && isfinite(horizon_point.y) && isfinite(horizon_point.z));
+        EXPECT_GE(core::length(horizon_point), 1.0);
+        EXPECT_LE(core::length(horizon_point), 1.0e6 * (1.0 + 1e-12));
+
+        // every vertex is a grid sample, its height quantized across the tile's range.
+        double step = 180.0 / double(int64_t(1) << info.level) / tile_size;
+        double height_step = (double(mesh.max_height) - mesh.min_height) / kQuantizedRange;
+        size_t num_west = 0, num_south = 0, num_east = 0, num_north = 0;
+        for (size_t i = 0; i < mesh.u_list.size(); i++)
+        {
+            uint32_t col = uint32_t(lround(double(mesh.u_list[i]) * tile_size / kQuantizedRange));
+            uint32_t row = tile_size - uint32_t(lround(double(mesh.v_list[i]) * tile_size / kQuantizedRange));
+            double lon = -180.0 + double(int64_t(info.x) * tile_size + col) * step;
+            double lat = -90.0 + double(int64_t(info.y) * tile_size + (tile_size - row)) * step;
+            core::vec2d pos(lon, lat);
+            float sample = mosaic.contains(pos) ? mosaic.get_height(pos) : 0.0f;
+            double height = mesh.min_height + height_step * mesh.height_list[i];
+            ASSERT_NEAR(height, sample, height_step * 0.5 + 1e-3) << "vertex " << i;
+
+            num_west += mesh.u_list[i] == 0 ? 1 : 0;
+            num_east += mesh.u_list[i] == kQuantizedRange ? 1 : 0;
+            num_south += mesh.v_list[i] == 0 ? 1 : 0;
+            num_north += mesh.v_list[i] == kQuantizedRange ? 1 : 0;
+        }
+
+        // the edge lists hold exactly the edge vertices.
+        ASSERT_EQ(mesh.west_index_list.size(), num_west);
+        ASSERT_EQ(mesh.east_index_list.size(), num_east);
+        ASSERT_EQ(mesh.south_index_list.size(), num_south);
+        ASSERT_EQ(mesh.north_index_list.size(), num_north);
+        ExpectEdge(mesh.west_index_list, mesh.u_list, 0, mesh.v_list);
+        ExpectEdge(mesh.east_index_list, mesh.u_list, kQuantizedRange, mesh.v_list);
+        ExpectEdge(mesh.south_index_list, mesh.v_list, 0, mesh.u_list);
+        ExpectEdge(mesh.north_index_list, mesh.v_list, kQuantizedRange, mesh.u_list);
+
+        // counter clockwise triangles that tile the square without gaps or overlaps.
+        int64_t total_area = 0;
+        for (size_t i = 0; i < mesh.index_list.size(); i += 3)
+        {
+            uint32_t i0 = mesh.index_list[i], i1 = mesh.index_list[i + 1], i2 = mesh.index_list[i + 2];
+            int64_t area = (int64_t(mesh.u_list[i1]) - mesh.u_list[i0]) * (int64_t(mesh.v_list[i2]) - mesh.v_list[i0]) -
+                           (int64_t(mesh.v_list[i1]) - mesh.v_list[i0]) * (int64_t(mesh.u_list[i2]) - mesh.u_list[i0]);
+            ASSERT_GT(area, 0) << "triangle " << i / 3;
+            total_area += area;
+        }
+        EXPECT_EQ(total_area, int64_t(kQuantizedRange) * kQuantizedRange * 2);
+    }
+
+    // the finest level resolves the hill, coarser ones may drop it.
+    const QuantizedMeshTileInfo& finest = tile_info_list.back();
+    EXPECT_EQ(finest.level, 10);
+    EXPECT_LE(finest.max_error, float(options.error_scale * kTerrainLevelZeroGeometricError / 1024.0));
+
+    EXPECT_TRUE(fs::exists(folder_name + "/layer.json"));
+    EXPECT_TRUE(fs::exists(folder_name + "/tile_metrics.csv"));
+    mosaic.clear();
+    fs::remove_all(folder_name);
+    remove(raster_name.c_str());
+}
+
+// the raster behind a mosaic with the given cache budget, meshed into folder_name.
+bool ExportTestTiles(const string& raster_name, const core::vec2d& ul_corner, const core::vec2d& pixel_size,
+                     size_t memory_cap, const string& folder_name, vector<QuantizedMeshTileInfo>& tile_info_list,
+                     uint64_t& num_block_loads)
+{
+    ElevationMosaic mosaic(memory_cap);
+    auto grid = make_shared<ElevationGrid>();
+    if (!grid->open(raster_name, 1, mosaic.get_cache()))
+    {
+        return false;
+    }
+    mosaic.add_tile(grid, ul_corner, pixel_size);
+    mosaic.build();
+
+    TerrainTilerOptions options;
+    options.max_level = 10;
+    options.grid_size = 33;
+    options.error_scale = 0.01;
+    bool succeeded = ExportQuantizedMeshTiles(mosaic, folder_name, options, nullptr, &tile_info_list);
+    num_block_loads = grid->get_num_block_loads();
+    return succeeded;
+}
+
+TEST(QuantizedMeshTest, TinyCacheBudgetMeshesLikeAnUnboundedOne)
+{
+    // 5 x 4 blocks of 64 x 64 floats, a budget of two blocks pages them in over and over.
+    const string raster_name = "quantizedmesh_test_paged.img";
+    const core::vec2d ul_corner(-122.0, 38.0), pixel_size(0.001, -0.001);
+    ASSERT_TRUE(CreateRaster(raster_name, ul_corner, pixel_size, 300, 200));
+    const size_t num_blocks = 20;
+    const size_t tiny_cap = 2 * 64 * 64 * sizeof(float);
+
+    vector<QuantizedMeshTileInfo> tiny_info_list, full_info_list;
+    uint64_t tiny_loads = 0, full_loads = 0;
+    ASSERT_TRUE(ExportTestTiles(raster_name, ul_corner, pixel_size, tiny_cap, "quantizedmesh_test_tiny", tiny_info_list, tiny_loads));
+    ASSERT_TRUE(ExportTestTiles(raster_name, ul_corner, pixel_size, numeric_limits<size_t>::max(), "quantizedmesh_test_full", full_info_list, full_loads));
+    remove(raster_name.c_str());
+
+    EXPECT_EQ(full_loads, num_blocks);
+    EXPECT_GT(tiny_loads, num_blocks);
+
+    ASSERT_EQ(tiny_info_list.size(), full_info_list.size());
+    for (size_t i = 0; i < tiny_info_list.size(); i++)
+    {
+        const QuantizedMeshTileInfo& info = full_info_list[i];
+        SCOPED_TRACE(testing::Message() << info.level << "/" << info.x << "/" << info.y);
+        ASSERT_EQ(tiny_info_list[i].level, info.level);
+        ASSERT_EQ(tiny_info_list[i].x, info.x);
+        ASSERT_EQ(tiny_info_list[i].y, info.y);
+        EXPECT_EQ(tiny_info_list[i].max_error, info.max_error);
+
+        string tile_name = "/" + to_string(info.level) + "/" + to_string(info.x) + "/" + to_string(info.y) + ".terrain";
+        vector<uint8_t> tiny_data, full_data;
+        ASSERT_TRUE(ReadTile("quantizedmesh_test_tiny" + tile_name, tiny_data));
+        ASSERT_TRUE(ReadTile("quantizedmesh_test_full" + tile_name, full_data));
+
+        QuantizedMesh tiny_mesh, full_mesh;
+        ASSERT_TRUE(DecodeQuantizedMesh(tiny_data.data(), tiny_data.size(), tiny_mesh));
+        ASSERT_TRUE(DecodeQuantizedMesh(full_data.data(), full_data.size(), full_mesh));
+        ExpectSameMesh(tiny_mesh, full_mesh);
+        // and the whole tile to the bit.
+        EXPECT_EQ(tiny_data, full_data);
+    }
+
+    fs::remove_all("quantizedmesh_test_tiny");
+    fs::remove_all("quantizedmesh_test_full");
+}
+}
@@ -0,0 +1,215 @@
+#include "registration.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+namespace
+{
+struct TestTransform
+{
+    double          rot[3][3];
+    double          scale;
+    core::vec3d     translation;
+    core::matrix4d  transform;
+};
+
+// a random rotation from a unit quaternion, scale and an ecef sized translation.
+TestTransform CreateRandomTransform(mt19937& rng, bool b_scale)
+{
+    normal_distribution<double> normal(0.0, 1.0);
+    uniform_real_distribution<double> scale(0.2, 5.0), offset(-6.4e6, 6.4e6);
+    double w = normal(rng), x = normal(rng), y = normal(rng), z = normal(rng);
+    double len = sqrt(w * w + x * x + y * y + z * z);
+    w /= len; x /= len; y /= len; z /= len;
+
+    TestTransform t;
+    double rot[3][3] =
+    {
+        { 1.0 - 2.0 * (y * y + z * z), 2.0 * (x * y - w * z), 2.0 * (x * z + w * y) },
+        { 2.0 * (x * y + w * z), 1.0 - 2.0 * (x * x + z * z), 2.0 * (y * z - w * x) },
+        { 2.0 * (x * z - w * y), 2.0 * (y * z + w * x), 1.0 - 2.0 * (x * x + y * y) },
+    };
+    memcpy(t.rot, rot, sizeof(rot));
+    t.scale = b_scale ? scale(rng) : 1.0;
+    t.translation = core::vec3d(offset(rng), offset(rng), offset(rng));
+
+    for (int r = 0; r < 3; r++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            t.transform(r, c) = t.scale * t.rot[c][r];
+        }
+        t.transform(3, r) = t.translation[r];
+    }
+    return t;
+}
+
+core::vec3d Apply(const core::matrix4d& transform, const core::vec3d& p)
+{
+    return core::vec3d(core::vec4d(p, 1.0) * transform);
+}
+
+// capture space points a few hundred units across, the size of a dumped frame.
+PointCorrespondences CreateCorrespondences(mt19937& rng, const TestTransform& t, uint32_t num_points, double noise,
+                                           const vector<uint32_t>& outlier_idx_list)
+{
+    uniform_real_distribution<double> coord(-300.0, 300.0), outlier(200.0, 2000.0);
+    normal_distribution<double> jitter(0.0, noise);
+    PointCorrespondences correspondences;
+    for (uint32_t i = 0; i < num_points; i++)
+    {
+        core::vec3d p(coord(rng), coord(rng), coord(rng));
+        correspondences.src_list.push_back(p);
+        correspondences.dst_list.push_back(Apply(t.transform, p) + core::vec3d(jitter(rng), jitter(rng), jitter(rng)));
+    }
+    for (uint32_t idx : outlier_idx_list)
+    {
+        correspondences.dst_list[idx] += core::vec3d(outlier(rng), -outlier(rng), outlier(rng));
+    }
+    return correspondences;
+}
+
+// the two transforms place a box the size of the points the same up to tolerance.
+void ExpectSameTransform(const core::matrix4d& actual, const core::matrix4d& expected, double tolerance)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        core::vec3d p(i & 1 ? 300.0 : -300.0, i & 2 ? 300.0 : -300.0, i & 4 ? 300.0 : -300.0);
+        EXPECT_LE(length(Apply(actual, p) - Apply(expected, p)), tolerance) << "corner " << i;
+    }
+}
+
+TEST(RegistrationTest, ExactPairsGiveTheTransform)
+{
+    mt19937 rng(1);
+    for (int32_t i = 0; i < 50; i++)
+    {
+        bool b_scale = i % 2 == 0;
+        TestTransform t = CreateRandomTransform(rng, b_scale);
+        PointCorrespondences correspondences = CreateCorrespondences(rng, t, 3 + i % 20, 0.0, {});
+
+        core::matrix4d transform;
+        double scale = 0.0;
+        ASSERT_TRUE(EstimateSimilarityTransform(correspondences.src_list, correspondences.dst_list, b_scale, transform, &scale));
+        EXPECT_NEAR(scale, t.scale, 1e-9 * t.scale);
+        ExpectSameTransform(transform, t.transform, 1e-5);
+    }
+}
+
+TEST(RegistrationTest, PlanarPointsNeverReflect)
+{
+    mt19937 rng(2);
+    TestTransform t = CreateRandomTransform(rng, true);
+    PointCorrespondences correspondences = CreateCorrespondences(rng, t, 6, 0.0, {});
+    for (auto& p : correspondences.src_list)
+    {
+        p.z = 0.0;
+    }
+    for (uint32_t i = 0; i < correspondences.src_list.size(); i++)
+    {
+        correspondences.dst_list[i] = Apply(t.transform, correspondences.src_list[i]);
+    }
+
+    core::matrix4d transform;
+    ASSERT_TRUE(EstimateSimilarityTransform(correspondences.src_list, correspondences.dst_list, true, transform));
+    ExpectSameTransform(transform, t.transform, 1e-5);
+}
+
+TEST(RegistrationTest, OutliersAreLeftOut)
+{
+    mt19937 rng(3);
+    for (int32_t i = 0; i < 40; i++)
+    {
+        // few pairs try every triple, many are sampled.
+        bool b_exhaustive = i % 2 == 0;
+        bool b_scale = i % 4 < 2;
+        uint32_t num_points = b_exhaustive ? 6 + i % 5 : 200;
+        uint32_t num_outliers = b_exhaustive ? 1 + i % 2 : 60;
+
+        TestTransform t = CreateRandomTransform(rng, b_scale);
+        vector<uint32_t> outlier_idx_list;
+        for (uint32_t j = 0; j < num_outliers; j++)
+        {
+            outlier_idx_list.push_back(j * (num_points / num_outliers));
+        }
+        PointCorrespondences correspondences = CreateCorrespondences(rng, t, num_points, 0.05, outlier_idx_list);
+
+        RegistrationOptions options;
+        options.estimate_scale = b_scale;
+        options.random_seed = i;
+        RegistrationResult result;
+        ASSERT_TRUE(RegisterPoints(correspondences, options, result)) << "set " << i;
+        ASSERT_TRUE(result.b_valid);
+        EXPECT_FALSE(result.b_least_squares);
+        ExpectSameTransform(result.transform, t.transform, 0.3);
+        EXPECT_NEAR(result.scale, t.scale, 1e-3 * t.scale);
+
+        EXPECT_EQ(result.num_inliers, num_points - num_outliers) << "set " << i;
+        ASSERT_EQ(result.inlier_list.size(), num_points);
+        ASSERT_EQ(result.residual_list.size(), num_points);
+        for (uint32_t j = 0; j < num_points; j++)
+        {
+            bool b_outlier = find(outlier_idx_list.begin(), outlier_idx_list.end(), j) != outlier_idx_list.end();
+            EXPECT_EQ(result.inlier_list[j] == 0, b_outlier) << "set " << i << " pair " << j;
+            EXPECT_EQ(result.residual_list[j] > options.inlier_threshold, b_outlier) << "set " << i << " pair " << j;
+        }
+        EXPECT_LT(result.rms_error, 0.2);
+    }
+}
+
+TEST(RegistrationTest, NoisyPairsFallBackToLeastSquares)
+{
+    // kml corners a few meters off, no three agree within the meter threshold.
+    mt19937 rng(4);
+    TestTransform t = CreateRandomTransform(rng, true);
+    PointCorrespondences correspondences = CreateCorrespondences(rng, t, 5, 8.0, {});
+
+    RegistrationOptions options;
+    RegistrationResult result;
+    EXPECT_FALSE(RegisterPoints(correspondences, options, result));
+    EXPECT_FALSE(result.b_valid);
+
+    options.least_squares_fallback = true;
+    ASSERT_TRUE(RegisterPoints(correspondences, options, result));
+    EXPECT_TRUE(result.b_least_squares);
+    EXPECT_EQ(result.num_inliers, 5u);
+
+    core::matrix4d transform;
+    ASSERT_TRUE(EstimateSimilarityTransform(correspondences.src_list, correspondences.dst_list, true, transform));
+    ExpectSameTransform(result.transform, transform, 1e-6);
+    ExpectSameTransform(result.transform, t.transform, 100.0);
+
+    // agreeing pairs never take the fallback.
+    correspondences = CreateCorrespondences(rng, t, 5, 0.01, {});
+    ASSERT_TRUE(RegisterPoints(correspondences, options, result));
+    EXPECT_FALSE(result.b_least_squares);
+}
+
+TEST(RegistrationTest, DegenerateInputIsRejected)
+{
+    mt19937 rng(5);
+    TestTransform t = CreateRandomTransform(rng, true);
+    RegistrationOptions options;
+    options.least_squares_fallback = true;
+    RegistrationResult result;
+
+    PointCorrespondences correspondences = CreateCorrespondences(rng, t, 2, 0.0, {});
+    EXPECT_FALSE(RegisterPoints(correspondences, options, result));
+
+    correspondences = CreateCorrespondences(rng, t, 5, 0.0, {});
+    correspondences.dst_list.pop_back();
+    EXPECT_FALSE(RegisterPoints(correspondences, options, result));
+
+    // points on one line leave the rotation about it open.
+    correspondences = PointCorrespondences();
+    for (int32_t i = 0; i < 6; i++)
+    {
+        core::vec3d p(10.0 * i, 5.0 * i, -2.0 * i);
+        correspondences.src_list.push_back(p);
+        correspondences.dst_list.push_back(Apply(t.transform, p));
+    }
+    EXPECT_FALSE(RegisterPoints(correspondences, options, result));
+    EXPECT_FALSE(result.b_valid);
+}
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "gpaframe.h"
+#include "glfunctionlist.h"
+#include <cstring>
+
+/**
+ * @brief  Writes a gpa frame in memory the way the capture layout has it: the file
+ *         header, data zones numbered by a running stamp that commands refer to
+ *         them by, command zones of 32 bit arguments, and the end tag.
+ */
+class TestGpaFrameWriter
+{
+    vector<uint8_t>     data_;
+    uint32_t            next_stamp_;
+
+public:
+    TestGpaFrameWriter() : next_stamp_(1)
+    {
+        append_word(kGpaFrameFileTag);
+        append_word(1);
+    }
+
+    void append_word(uint32_t value)
+    {
+        for (int32_t i = 0; i < 4; i++)
+        {
+            data_.push_back(uint8_t(value >> (i * 8)));
+        }
+    }
+
+    // the stamp of the zone.
+    uint32_t add_data(uint32_t tag, const void* bytes, size_t size)
+    {
+        uint32_t stamp = next_stamp_++;
+        append_word(uint32_t(4 + size));
+        append_word(tag);
+        append_word(stamp);
+        const uint8_t* byte_list = reinterpret_cast<const uint8_t*>(bytes);
+        data_.insert(data_.end(), byte_list, byte_list + size);
+        return stamp;
+    }
+
+    uint32_t add_words(const vector<uint32_t>& word_list)
+    {
+        return add_data(kParamsBlock, word_list.data(), word_list.size() * 4);
+    }
+
+    void add_command(uint32_t tag, const vector<uint32_t>& arg_list)
+    {
+        append_word(uint32_t(arg_list.size() * 4));
+        append_word(tag);
+        for (uint32_t arg : arg_list)
+        {
+            append_word(arg);
+        }
+    }
+
+    const vector<uint8_t>& finish()
+    {
+        append_word(0);
+        append_word(kGpaFrameEndTag);
+        return data_;
+    }
+};
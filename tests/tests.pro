@@ -0,0 +1,103 @@
+#-------------------------------------------------
+#
+# unit tests, gtest from the same ThirdParty tree MeshTool.pro uses.
+#
+#-------------------------------------------------
+
+QT       -= core gui
+
+TARGET = MeshToolTests
+TEMPLATE = app
+CONFIG += console c++17
+CONFIG -= app_bundle qt
+
+DEFINES += _HAS_STD_BYTE=0
+
+INCLUDEPATH += $$PWD/../../../ThirdParty/gtest-1.7.0/include/
+INCLUDEPATH += $$PWD/../../../ThirdParty/geographiclib/include
+INCLUDEPATH += $$PWD/../../../ThirdParty/zlib-1.2.3/
+INCLUDEPATH += $$PWD/../../../ThirdParty/opencv/include
+INCLUDEPATH += $$PWD/../include
+INCLUDEPATH += $$PWD/..
+INCLUDEPATH += $$PWD/../hfa
+INCLUDEPATH += $$PWD/../port
+
+QMAKE_LIBDIR += $$PWD/../../../ThirdParty/gtest-1.7.0/lib
+QMAKE_LIBDIR += $$PWD/../../../ThirdParty/opencv/x64/vc15/lib
+
+CONFIG(debug, debug|release) {
+        LIBS += gtestd.lib gtest_maind.lib opencv_world341d.lib
+    }
+    else {
+        LIBS += gtest.lib gtest_main.lib opencv_world341.lib
+    }
+
+SOURCES += \
+    coresimd_test.cpp \
+    coregeographic_test.cpp \
+    coretexture_test.cpp \
+    textureatlas_test.cpp \
+    coreblockcodec_test.cpp \
+    corepng_test.cpp \
+    elevationgrid_test.cpp \
+    quantizedmesh_test.cpp \
+    tileset_test.cpp \
+    meshclip_test.cpp \
+    boundsgrid_test.cpp \
+    registration_test.cpp \
+    vertexformat_test.cpp \
+    glstate_test.cpp \
+    gpaframe_test.cpp \
+    meshbatch_test.cpp \
+    pointcloud_test.cpp \
+    gpadiff_test.cpp \
+    tiledimage_test.cpp \
+    cpl_vsil_mmap_test.cpp \
+    occlusionculling_test.cpp \
+    debugout_test.cpp \
+    ../coregeographic.cpp \
+    ../coreblockcodec.cpp \
+    ../coretexture.cpp \
+    ../textureatlas.cpp \
+    ../corepng.cpp \
+    ../elevationgrid.cpp \
+    ../boundsgrid.cpp \
+    ../quantizedmesh.cpp \
+    ../tileset.cpp \
+    ../meshdata.cpp \
+    ../meshclip.cpp \
+    ../meshbatch.cpp \
+    ../pointcloud.cpp \
+    ../registration.cpp \
+    ../gpadiff.cpp \
+    ../tiledimage.cpp \
+    ../vertexformat.cpp \
+    ../GpaDumpAnalyzeTool.cpp \
+    ../gpaframe.cpp \
+    ../GlFunctionList.cpp \
+    ../glstate.cpp \
+    ../corefile.cpp \
+    ../occlusionculling.cpp \
+    ../hfa/hfaband.cpp \
+    ../hfa/hfacompress.cpp \
+    ../hfa/hfadictionary.cpp \
+    ../hfa/hfaentry.cpp \
+    ../hfa/hfafield.cpp \
+    ../hfa/hfaopen.cpp \
+    ../hfa/hfatype.cpp \
+    ../port/cpl_conv.cpp \
+    ../port/cpl_csv.cpp \
+    ../port/cpl_dir.cpp \
+    ../port/cpl_error.cpp \
+    ../port/cpl_findfile.cpp \
+    ../port/cpl_multiproc.cpp \
+    ../port/cpl_path.cpp \
+    ../port/cpl_string.cpp \
+    ../port/cpl_vsi_mem.cpp \
+    ../port/cpl_vsil.cpp \
+    ../port/cpl_vsil_mmap.cpp \
+    ../port/cpl_vsil_win32.cpp \
+    ../port/cpl_vsisimple.cpp
+
+SOURCES += $$files($$PWD/../../../ThirdParty/geographiclib/src/*.cpp)
+SOURCES += $$files($$PWD/../../../ThirdParty/zlib-1.2.11/*.c)
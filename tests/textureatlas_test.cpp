@@ -0,0 +1,259 @@
+#include "textureatlas.h"
+#include "coretexture.h"
+#include "glfunctionlist.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+namespace
+{
+// a page of 64 x 64 blocks, small enough that the test textures need several.
+constexpr uint32_t kTestPageSize = 256;
+constexpr uint32_t kNumTestTextures = 40;
+
+core::Texture2DInfo* CreateTexture(uint32_t format, uint32_t w, uint32_t h, mt19937& rng)
+{
+    core::Texture2DInfo* tex_info = new core::Texture2DInfo;
+    tex_info->m_objectId = 1;
+    tex_info->m_levelCount = 1;
+    tex_info->m_internalFormat = format;
+    tex_info->m_format = format;
+    tex_info->m_type = kGlUByte;
+    tex_info->m_mips[0].m_width = w;
+    tex_info->m_mips[0].m_height = h;
+    tex_info->m_mips[0].m_size = format == kGlRgba ? w * h * 4 : (w / 4) * (h / 4) * 8;
+    tex_info->m_mips[0].m_imageData = make_unique<char[]>(tex_info->m_mips[0].m_size);
+    for (uint32_t i = 0; i < tex_info->m_mips[0].m_size; i++)
+    {
+        tex_info->m_mips[0].m_imageData[i] = char(rng());
+    }
+    return tex_info;
+}
+
+// corners of the texture, texel centers along its edges and random points inside.
+MeshData* CreateMesh(uint32_t tex_idx, uint32_t w, uint32_t h, mt19937& rng)
+{
+    uniform_real_distribution<float> uv_dist(0.0f, 1.0f);
+    vector<core::vec2f> uv_list = { core::vec2f(0.0f, 0.0f), core::vec2f(1.0f, 1.0f), core::vec2f(1.0f, 0.0f), core::vec2f(0.0f, 1.0f) };
+    for (uint32_t x = 0; x < w; x++)
+    {
+        uv_list.push_back(core::vec2f((x + 0.5f) / w, 0.5f / h));
+        uv_list.push_back(core::vec2f((x + 0.5f) / w, (h - 0.5f) / h));
+    }
+    for (uint32_t y = 0; y < h; y++)
+    {
+        uv_list.push_back(core::vec2f(0.5f / w, (y + 0.5f) / h));
+        uv_list.push_back(core::vec2f((w - 0.5f) / w, (y + 0.5f) / h));
+    }
+    for (uint32_t i = 0; i < 200; i++)
+    {
+        uv_list.push_back(core::vec2f(uv_dist(rng), uv_dist(rng)));
+    }
+
+    MeshData* mesh = new MeshData;
+    mesh->num_vertex = int(uv_list.size());
+    mesh->idx_in_texture_list = tex_idx;
+    mesh->uv_list = make_unique<core::vec2f[]>(uv_list.size());
+    copy(uv_list.begin(), uv_list.end(), mesh->uv_list.get());
+    return mesh;
+}
+
+struct TestImage
+{
+    uint32_t            w;
+    uint32_t            h;
+    vector<uint8_t>     rgba_data;
+
+    // bilinear, texel centers at half integers, clamped to the edge like GL_CLAMP.
+    void sample(const core::vec2f& uv, float color[4]) const
+    {
+        float f_x = uv.x * w - 0.5f, f_y = uv.y * h - 0.5f;
+        int x = int(floor(f_x)), y = int(floor(f_y));
+        float t_x = f_x - x, t_y = f_y - y;
+        for (uint32_t k = 0; k < 4; k++)
+        {
+            color[k] = (texel(x, y, k) * (1.0f - t_x) + texel(x + 1, y, k) * t_x) * (1.0f - t_y) +
+                       (texel(x, y + 1, k) * (1.0f - t_x) + texel(x + 1, y + 1, k) * t_x) * t_y;
+        }
+    }
+
+    float texel(int x, int y, uint32_t k) const
+    {
+        x = min(max(x, 0), int(w) - 1);
+        y = min(max(y, 0), int(h) - 1);
+        return rgba_data[(size_t(y) * w + x) * 4 + k];
+    }
+};
+
+TestImage DecodeTestImage(const core::Texture2DInfo* tex_info)
+{
+    TestImage image = { tex_info->m_mips[0].m_width, tex_info->m_mips[0].m_height, {} };
+    EXPECT_TRUE(core::DecodeTextureLevel(tex_info, 0, image.rgba_data));
+    return image;
+}
+
+class TextureAtlasTest : public ::testing::Test
+{
+protected:
+    GroupMeshData               group_mesh_data_;
+    vector<TestImage>           image_list_;        // the textures before packing
+    vector<vector<core::vec2f>> uv_list_;           // the mesh uvs before packing
+    vector<uint32_t>            tex_idx_list_;      // the mesh textures before packing
+    vector<core::Texture2DInfo*> kept_list_;        // textures that may not be packed
+
+    void SetUp() override
+    {
+        // an rgba texture and one sampled outside [0, 1] stay on their own, random dxt1
+        // sizes of whole blocks fill the pages.
+        mt19937 rng(31);
+        uniform_int_distribution<uint32_t> blocks(1, 24);
+        group_mesh_data_.loaded_textures.push_back(CreateTexture(kGlRgba, 8, 8, rng));
+        group_mesh_data_.loaded_textures.push_back(CreateTexture(kGLCmpsdRgbS3tcDxt1Ext, 16, 16, rng));
+        for (uint32_t i = 0; i < kNumTestTextures; i++)
+        {
+            group_mesh_data_.loaded_textures.push_back(CreateTexture(kGLCmpsdRgbaS3tcDxt1Ext, blocks(rng) * 4, blocks(rng) * 4, rng));
+        }
+        kept_list_ = { group_mesh_data_.loaded_textures[0], group_mesh_data_.loaded_textures[1] };
+
+        for (uint32_t i = 0; i < group_mesh_data_.loaded_textures.size(); i++)
+        {
+            const core::Texture2DInfo* tex_info = group_mesh_data_.loaded_textures[i];
+            image_list_.push_back(DecodeTestImage(tex_info));
+            // two meshes on some textures, both have to follow it.
+            for (uint32_t j = 0; j < (i % 3 == 0 ? 2u : 1u); j++)
+            {
+                group_mesh_data_.meshes.push_back(CreateMesh(i, tex_info->m_mips[0].m_width, tex_info->m_mips[0].m_height, rng));
+            }
+        }
+        group_mesh_data_.meshes[2]->uv_list[5] = core::vec2f(1.5f, 0.5f);
+
+        for (const MeshData* mesh : group_mesh_data_.meshes)
+        {
+            uv_list_.emplace_back(mesh->uv_list.get(), mesh->uv_list.get() + mesh->num_vertex);
+            tex_idx_list_.push_back(mesh->idx_in_texture_list);
+        }
+    }
+
+    void TearDown() override
+    {
+        for (auto& mesh : group_mesh_data_.meshes)
+        {
+            SAFE_DELETE(mesh);
+        }
+        for (auto& tex_info : group_mesh_data_.loaded_textures)
+        {
+            SAFE_DELETE(tex_info);
+        }
+    }
+};
+
+TEST_F(TextureAtlasTest, RemappedUvsSampleTheSameTexels)
+{
+    uint32_t num_packed = BuildGroupTextureAtlas(&group_mesh_data_, kTestPageSize);
+    // a page left with a single texture is dropped again, at most one per format.
+    EXPECT_GE(num_packed, kNumTestTextures - 1);
+    const vector<core::Texture2DInfo*>& textures = group_mesh_data_.loaded_textures;
+    ASSERT_LT(textures.size(), size_t(kNumTestTextures / 2));
+    EXPECT_EQ(textures[0], kept_list_[0]);
+    EXPECT_EQ(textures[1], kept_list_[1]);
+
+    vector<TestImage> page_image_list;
+    for (const core::Texture2DInfo* tex_info : textures)
+    {
+        page_image_list.push_back(DecodeTestImage(tex_info));
+    }
+
+    // bilinear samples next to the edges read the gutter, it has to repeat the edge texels.
+    for (size_t i_mesh = 0; i_mesh < group_mesh_data_.meshes.size(); i_mesh++)
+    {
+        const MeshData* mesh = group_mesh_data_.meshes[i_mesh];
+        ASSERT_LT(mesh->idx_in_texture_list, textures.size());
+        const TestImage& image = image_list_[tex_idx_list_[i_mesh]];
+        const TestImage& page_image = page_image_list[mesh->idx_in_texture_list];
+        for (int i = 0; i < mesh->num_vertex; i++)
+        {
+            const core::vec2f& uv = uv_list_[i_mesh][size_t(i)];
+            if (uv.x > 1.0f)
+            {
+                continue;
+            }
+            float color[4], page_color[4];
+            image.sample(uv, color);
+            page_image.sample(mesh->uv_list[i], page_color);
+            for (uint32_t k = 0; k < 4; k++)
+            {
+                ASSERT_NEAR(page_color[k], color[k], 0.05f) << "mesh " << i_mesh << ", uv " << uv.x << ", " << uv.y;
+            }
+        }
+    }
+}
+
+TEST_F(TextureAtlasTest, PackedTexturesDoNotOverlap)
+{
+    BuildGroupTextureAtlas(&group_mesh_data_, kTestPageSize);
+    const vector<core::Texture2DInfo*>& textures = group_mesh_data_.loaded_textures;
+
+    // the uv corners of each packed texture give its texel rectangle on the page.
+    struct PackedRect
+    {
+        uint32_t    page_idx;
+        int32_t     x0, y0, x1, y1;
+    };
+    vector<PackedRect> rect_list;
+    vector<uint8_t> tex_seen(image_list_.size(), 0);
+    for (size_t i_mesh = 0; i_mesh < group_mesh_data_.meshes.size(); i_mesh++)
+    {
+        const MeshData* mesh = group_mesh_data_.meshes[i_mesh];
+        uint32_t tex_idx = tex_idx_list_[i_mesh];
+        const core::Texture2DInfo* page = textures[mesh->idx_in_texture_list];
+        if (tex_idx < 2 || find(kept_list_.begin(), kept_list_.end(), page) != kept_list_.end() || tex_seen[tex_idx])
+        {
+            continue;
+        }
+        tex_seen[tex_idx] = 1;
+
+        const core::Texture2DSurfaceInfo& mip = page->m_mips[0];
+        EXPECT_TRUE(page->m_format == kGLCmpsdRgbaS3tcDxt1Ext);
+        EXPECT_LE(mip.m_width, kTestPageSize);
+        EXPECT_LE(mip.m_height, kTestPageSize);
+        EXPECT_EQ(mip.m_size, mip.m_width / 4 * (mip.m_height / 4) * 8);
+
+        PackedRect rect;
+        rect.page_idx = mesh->idx_in_texture_list;
+        rect.x0 = int32_t(lround(mesh->uv_list[0].x * mip.m_width));
+        rect.y0 = int32_t(lround(mesh->uv_list[0].y * mip.m_height));
+        rect.x1 = int32_t(lround(mesh->uv_list[1].x * mip.m_width));
+        rect.y1 = int32_t(lround(mesh->uv_list[1].y * mip.m_height));
+
+        // on block boundaries, the texture's size, the gutter inside the page.
+        const TestImage& image = image_list_[tex_idx];
+        EXPECT_EQ(rect.x0 % 4, 0) << "texture " << tex_idx;
+        EXPECT_EQ(rect.y0 % 4, 0) << "texture " << tex_idx;
+        EXPECT_EQ(rect.x1 - rect.x0, int32_t(image.w)) << "texture " << tex_idx;
+        EXPECT_EQ(rect.y1 - rect.y0, int32_t(image.h)) << "texture " << tex_idx;
+        rect.x0 -= int32_t(kDefaultAtlasGutter);
+        rect.y0 -= int32_t(kDefaultAtlasGutter);
+        rect.x1 += int32_t(kDefaultAtlasGutter);
+        rect.y1 += int32_t(kDefaultAtlasGutter);
+        EXPECT_GE(rect.x0, 0) << "texture " << tex_idx;
+        EXPECT_GE(rect.y0, 0) << "texture " << tex_idx;
+        EXPECT_LE(rect.x1, int32_t(mip.m_width)) << "texture " << tex_idx;
+        EXPECT_LE(rect.y1, int32_t(mip.m_height)) << "texture " << tex_idx;
+        rect_list.push_back(rect);
+    }
+    EXPECT_GE(rect_list.size(), size_t(kNumTestTextures - 1));
+
+    // gutters included, no two textures share a texel.
+    for (size_t i = 0; i < rect_list.size(); i++)
+    {
+        for (size_t j = i + 1; j < rect_list.size(); j++)
+        {
+            const PackedRect& a = rect_list[i];
+            const PackedRect& b = rect_list[j];
+            bool overlap = a.page_idx == b.page_idx && a.x0 < b.x1 && b.x0 < a.x1 && a.y0 < b.y1 && b.y0 < a.y1;
+            EXPECT_FALSE(overlap) << "rectangles " << i << " and " << j << " on page " << a.page_idx;
+        }
+    }
+}
+}
@@ -0,0 +1,300 @@
+#include "tiledimage.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+namespace
+{
+struct TiffLayout
+{
+    const char* name;
+    bool        big_endian;
+    bool        big_tiff;
+    int         samples_per_pixel;
+    int         rows_per_strip;     // 0 for tiled files
+    int         tile_x_size;
+    int         tile_y_size;
+};
+
+void PrintTo(const TiffLayout& layout, ostream* os)
+{
+    *os << layout.name;
+}
+
+// an uncompressed chunky tiff written byte by byte in the file's own byte order.
+class TestTiffWriter
+{
+    struct Entry
+    {
+        uint16_t            tag;
+        uint16_t            type;
+        vector<uint64_t>    values;
+    };
+
+    const TiffLayout&   layout_;
+    vector<uint8_t>     data_;
+    vector<Entry>       entry_list_;
+
+    static uint32_t type_size(uint16_t type) { return type == 3 ? 2 : (type == 4 ? 4 : 8); }
+
+    void put(vector<uint8_t>& dst, uint64_t value, uint32_t num_bytes) const
+    {
+        for (uint32_t i = 0; i < num_bytes; i++)
+        {
+            uint32_t shift = layout_.big_endian ? (num_bytes - 1 - i) * 8 : i * 8;
+            dst.push_back(uint8_t(value >> shift));
+        }
+    }
+
+public:
+    explicit TestTiffWriter(const TiffLayout& layout) : layout_(layout) {}
+
+    vector<uint8_t> write(int w, int h, const vector<uint8_t>& pixels)
+    {
+        int spp = layout_.samples_per_pixel;
+        data_.clear();
+        data_.push_back(layout_.big_endian ? 'M' : 'I');
+        data_.push_back(layout_.big_endian ? 'M' : 'I');
+        if (layout_.big_tiff)
+        {
+            put(data_, 43, 2);
+            put(data_, 8, 2);
+            put(data_, 0, 2);
+            put(data_, 0, 8);   // ifd offset, patched below
+        }
+        else
+        {
+            put(data_, 42, 2);
+            put(data_, 0, 4);
+        }
+
+        // tiles are padded to whole tiles, strips end with a short one.
+        vector<uint64_t> offsets, byte_counts;
+        if (layout_.rows_per_strip > 0)
+        {
+            for (int y = 0; y < h; y += layout_.rows_per_strip)
+            {
+                int rows = min(layout_.rows_per_strip, h - y);
+                offsets.push_back(data_.size());
+                byte_counts.push_back(uint64_t(rows) * w * spp);
+                data_.insert(data_.end(), pixels.begin() + size_t(y) * w * spp, pixels.begin() + size_t(y + rows) * w * spp);
+            }
+        }
+        else
+        {
+            for (int t_y = 0; t_y < h; t_y += layout_.tile_y_size)
+            {
+                for (int t_x = 0; t_x < w; t_x += layout_.tile_x_size)
+                {
+                    offsets.push_back(data_.size());
+                    byte_counts.push_back(uint64_t(layout_.tile_x_size) * layout_.tile_y_size * spp);
+                    for (int row = 0; row < layout_.tile_y_size; row++)
+                    {
+                        for (int col = 0; col < layout_.tile_x_size * spp; col++)
+                        {
+                            int x = t_x * spp + col;
+                            data_.push_back(t_y + row < h && x < w * spp ? pixels[size_t(t_y + row) * w * spp + x] : 0);
+                        }
+                    }
+                }
+            }
+        }
+        if (data_.size() & 1)
+        {
+            data_.push_back(0);
+        }
+
+        uint16_t offset_type = layout_.big_tiff ? 16 : 4;
+        entry_list_.clear();
+        entry_list_.push_back({ 256, 4, { uint64_t(w) } });
+        entry_list_.push_back({ 257, 4, { uint64_t(h) } });
+        entry_list_.push_back({ 258, 3, vector<uint64_t>(spp, 8) });
+        entry_list_.push_back({ 259, 3, { 1 } });
+        entry_list_.push_back({ 262, 3, { spp == 1 ? 1u : 2u } });
+        if (layout_.rows_per_strip > 0)
+        {
+            entry_list_.push_back({ 273, offset_type, offsets });
+        }
+        entry_list_.push_back({ 277, 3, { uint64_t(spp) } });
+        if (layout_.rows_per_strip > 0)
+        {
+            entry_list_.push_back({ 278, 4, { uint64_t(layout_.rows_per_strip) } });
+            entry_list_.push_back({ 279, offset_type, byte_counts });
+        }
+        entry_list_.push_back({ 284, 3, { 1 } });
+        if (layout_.rows_per_strip == 0)
+        {
+            entry_list_.push_back({ 322, 4, { uint64_t(layout_.tile_x_size) } });
+            entry_list_.push_back({ 323, 4, { uint64_t(layout_.tile_y_size) } });
+            entry_list_.push_back({ 324, offset_type, offsets });
+            entry_list_.push_back({ 325, offset_type, byte_counts });
+        }
+
+        uint64_t ifd_offset = data_.size();
+        uint32_t count_size = layout_.big_tiff ? 8 : 2;
+        uint32_t entry_size = layout_.big_tiff ? 20 : 12;
+        uint32_t field_size = layout_.big_tiff ? 8 : 4;
+        vector<uint8_t> ifd, extra;
+        uint64_t extra_offset = ifd_offset + count_size + entry_list_.size() * entry_size + field_size;
+        put(ifd, entry_list_.size(), count_size);
+        for (const Entry& entry : entry_list_)
+        {
+            put(ifd, entry.tag, 2);
+            put(ifd, entry.type, 2);
+            put(ifd, entry.values.size(), field_size);
+            vector<uint8_t> value_data;
+            for (uint64_t value : entry.values)
+            {
+                put(value_data, value, type_size(entry.type));
+            }
+            if (value_data.size() > field_size)
+            {
+                put(ifd, extra_offset + extra.size(), field_size);
+                extra.insert(extra.end(), value_data.begin(), value_data.end());
+            }
+            else
+            {
+                value_data.resize(field_size, 0);
+                ifd.insert(ifd.end(), value_data.begin(), value_data.end());
+            }
+        }
+        put(ifd, 0, field_size);
+
+        vector<uint8_t> ifd_offset_data;
+        put(ifd_offset_data, ifd_offset, field_size);
+        copy(ifd_offset_data.begin(), ifd_offset_data.end(), data_.begin() + (layout_.big_tiff ? 8 : 4));
+        data_.insert(data_.end(), ifd.begin(), ifd.end());
+        data_.insert(data_.end(), extra.begin(), extra.end());
+        return data_;
+    }
+};
+
+void WriteFileData(const string& file_name, const vector<uint8_t>& data)
+{
+    FILE* file = fopen(file_name.c_str(), "wb");
+    ASSERT_NE(file, nullptr);
+    EXPECT_EQ(fwrite(data.data(), 1, data.size(), file), data.size());
+    fclose(file);
+}
+
+// rows of packed bgr against the same rectangle of an opencv image.
+bool SameBgrPixels(const uint8_t* data, size_t pitch, const cv::Mat& image, int x, int y, int w, int h)
+{
+    for (int row = 0; row < h; row++)
+    {
+        if (memcmp(data + row * pitch, image.ptr(y + row) + x * 3, size_t(w) * 3) != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+const int kTestWidth = 173;
+const int kTestHeight = 131;
+
+class TiledImageTest : public ::testing::TestWithParam<TiffLayout>
+{
+protected:
+    string              file_name_;
+    cv::Mat             expected_;
+
+    void SetUp() override
+    {
+        const TiffLayout& layout = GetParam();
+        mt19937 rng(35);
+        vector<uint8_t> pixels(size_t(kTestWidth) * kTestHeight * layout.samples_per_pixel);
+        for (uint8_t& value : pixels)
+        {
+            value = uint8_t(rng());
+        }
+
+        file_name_ = string("tiledimage_test_") + layout.name + ".tif";
+        WriteFileData(file_name_, TestTiffWriter(layout).write(kTestWidth, kTestHeight, pixels));
+
+        // opencv's decode is the reference the streamed reader has to match.
+        expected_ = cv::imread(file_name_);
+        ASSERT_FALSE(expected_.empty());
+        ASSERT_EQ(expected_.cols, kTestWidth);
+        ASSERT_EQ(expected_.rows, kTestHeight);
+    }
+
+    void TearDown() override
+    {
+        remove(file_name_.c_str());
+    }
+};
+
+TEST_P(TiledImageTest, BandsMatchImread)
+{
+    TiledImageReader reader;
+    ASSERT_TRUE(reader.open(file_name_));
+    ASSERT_TRUE(reader.is_streamed());
+    ASSERT_EQ(reader.get_x_size(), kTestWidth);
+    ASSERT_EQ(reader.get_y_size(), kTestHeight);
+
+    // band heights that do not line up with the strips or tiles, in an order that
+    // moves backwards through the file.
+    size_t pitch = size_t(kTestWidth) * 3;
+    for (int band_rows : { 1, 10, 17, kTestHeight })
+    {
+        vector<uint8_t> band(size_t(band_rows) * pitch);
+        for (int y = kTestHeight - band_rows; y >= 0; y -= band_rows)
+        {
+            ASSERT_TRUE(reader.read_rows(y, band_rows, band.data()));
+            EXPECT_TRUE(SameBgrPixels(band.data(), pitch, expected_, 0, y, kTestWidth, band_rows)) << "rows " << y << " + " << band_rows;
+        }
+    }
+
+    vector<uint8_t> band(pitch);
+    EXPECT_FALSE(reader.read_rows(kTestHeight - 1, 2, band.data()));
+    EXPECT_FALSE(reader.read_rows(-1, 1, band.data()));
+}
+
+TEST_P(TiledImageTest, CropsMatchImread)
+{
+    TiledImageReader reader;
+    ASSERT_TRUE(reader.open(file_name_));
+
+    // a 20 row budget: the first two crops overlap, so the second one starts a band
+    // inside the first band's rows, and the last one is taller than the budget.
+    vector<ImageCropInfo> crop_list =
+    {
+        { 0, 0, 40, 20, "" },
+        { 33, 15, 51, 19, "" },
+        { 150, 16, 23, 1, "" },
+        { 61, 30, 1, 9, "" },
+        { 100, 40, 73, 91, "" },
+        { 0, 130, 173, 1, "" },
+    };
+    for (size_t i = 0; i < crop_list.size(); i++)
+    {
+        crop_list[i].file_name = "tiledimage_test_crop" + to_string(i) + ".png";
+    }
+
+    ASSERT_TRUE(CropImageFiles(reader, crop_list, size_t(kTestWidth) * 3 * 20));
+
+    for (const ImageCropInfo& crop : crop_list)
+    {
+        cv::Mat crop_image = cv::imread(crop.file_name);
+        remove(crop.file_name.c_str());
+        ASSERT_EQ(crop_image.cols, crop.w) << crop.file_name;
+        ASSERT_EQ(crop_image.rows, crop.h) << crop.file_name;
+        EXPECT_TRUE(SameBgrPixels(crop_image.data, size_t(crop_image.step), expected_, crop.x, crop.y, crop.w, crop.h)) << crop.file_name;
+    }
+
+    vector<ImageCropInfo> outside_list = { { 170, 0, 4, 1, "tiledimage_test_outside.png" } };
+    EXPECT_FALSE(CropImageFiles(reader, outside_list));
+}
+
+INSTANTIATE_TEST_CASE_P(Layouts, TiledImageTest, ::testing::Values(
+    TiffLayout{ "strip", false, false, 3, 7, 0, 0 },
+    TiffLayout{ "strip_gray", false, false, 1, 13, 0, 0 },
+    TiffLayout{ "tiled", false, false, 3, 0, 32, 16 },
+    TiffLayout{ "bigtiff_tiled", false, true, 3, 0, 48, 32 },
+    TiffLayout{ "bigtiff_strip", false, true, 1, 5, 0, 0 },
+    TiffLayout{ "big_endian_strip", true, false, 3, 9, 0, 0 },
+    TiffLayout{ "big_endian_tiled", true, false, 1, 0, 16, 16 },
+    TiffLayout{ "big_endian_bigtiff", true, true, 3, 0, 32, 48 }));
+}
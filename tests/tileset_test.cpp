@@ -0,0 +1,293 @@
+#include "tileset.h"
+#include "corepng.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+constexpr uint32_t kGlbMagic = 0x46546c67;          // "glTF"
+constexpr uint32_t kGlbVersion = 2;
+constexpr uint32_t kGlbHeaderSize = 12;
+constexpr uint32_t kGlbChunkHeaderSize = 8;
+constexpr uint32_t kGlbJsonChunk = 0x4e4f534a;      // "JSON"
+constexpr uint32_t kGlbBinChunk = 0x004e4942;       // "BIN"
+
+template <class T>
+T ReadValue(const uint8_t* data)
+{
+    T value;
+    memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+bool IsInside(const core::bounds3d& inner, const core::bounds3d& outer)
+{
+    double tolerance = 1e-6 * max(1.0, core::length(outer.GetDiagonal()));
+    return inner.bb_min.x >= outer.bb_min.x - tolerance && inner.bb_min.y >= outer.bb_min.y - tolerance && inner.bb_min.z >= outer.bb_min.z - tolerance &&
+           inner.bb_max.x <= outer.bb_max.x + tolerance && inner.bb_max.y <= outer.bb_max.y + tolerance && inner.bb_max.z <= outer.bb_max.z + tolerance;
+}
+
+bool ValidateGlbFile(const string& file_name, string& error)
+{
+    ifstream in_file(file_name, ifstream::binary | ifstream::ate);
+    if (!in_file)
+    {
+        error = file_name + " is missing";
+        return false;
+    }
+
+    vector<uint8_t> data(size_t(in_file.tellg()));
+    in_file.seekg(0);
+    in_file.read(reinterpret_cast<char*>(data.data()), streamsize(data.size()));
+    if (data.size() < kGlbHeaderSize + kGlbChunkHeaderSize ||
+        ReadValue<uint32_t>(&data[0]) != kGlbMagic ||
+        ReadValue<uint32_t>(&data[4]) != kGlbVersion ||
+        ReadValue<uint32_t>(&data[8]) != data.size())
+    {
+        error = file_name + " has a bad glb header";
+        return false;
+    }
+
+    size_t json_size = ReadValue<uint32_t>(&data[12]);
+    size_t bin_ofs = kGlbHeaderSize + kGlbChunkHeaderSize + json_size;
+    if (ReadValue<uint32_t>(&data[16]) != kGlbJsonChunk || json_size % 4 != 0 ||
+        bin_ofs + kGlbChunkHeaderSize > data.size() ||
+        ReadValue<uint32_t>(&data[bin_ofs + 4]) != kGlbBinChunk ||
+        bin_ofs + kGlbChunkHeaderSize + ReadValue<uint32_t>(&data[bin_ofs]) != data.size())
+    {
+        error = file_name + " has bad chunks";
+        return false;
+    }
+
+    string json(reinterpret_cast<const char*>(&data[kGlbHeaderSize + kGlbChunkHeaderSize]), json_size);
+    string folder_name = fs::path(file_name).parent_path().string();
+    const string uri_key = "\"uri\":\"";
+    for (size_t pos = json.find(uri_key); pos != string::npos; pos = json.find(uri_key, pos + 1))
+    {
+        size_t begin = pos + uri_key.size();
+        string uri = json.substr(begin, json.find('"', begin) - begin);
+        if (!fs::exists(folder_name + "/" + uri))
+        {
+            error = file_name + " references missing " + uri;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//
+// structural checks of a written tileset: node links and depths, children boxes inside
+// their parent's, geometric errors not growing towards the leaves and leaves at 0, and
+// every payload a well formed glb whose referenced textures exist. error is the first
+// problem found.
+//
+bool ValidateTileset(const string& folder_name, const Tileset& tileset, string& error)
+{
+    if (tileset.node_list.empty() || tileset.node_list[0].parent != -1 || tileset.node_list[0].depth != 0)
+    {
+        error = "the tileset has no root";
+        return false;
+    }
+
+    if (!fs::exists(folder_name + "/tileset.json"))
+    {
+        error = "tileset.json is missing";
+        return false;
+    }
+
+    for (uint32_t i = 0; i < tileset.node_list.size(); i++)
+    {
+        const TilesetNode& node = tileset.node_list[i];
+        string name = "node " + to_string(i);
+        if (i > 0 && (node.parent < 0 || uint32_t(node.parent) >= i))
+        {
+            error = name + " comes before its parent";
+            return false;
+        }
+
+        if (node.child_list.empty() && node.geometric_error != 0.0)
+        {
+            error = name + " is a leaf with a geometric error";
+            return false;
+        }
+
+        for (uint32_t child_idx : node.child_list)
+        {
+            if (child_idx <= i || child_idx >= tileset.node_list.size())
+            {
+                error = name + " has a bad child index";
+                return false;
+            }
+
+            const TilesetNode& child = tileset.node_list[child_idx];
+            if (child.parent != int32_t(i) || child.depth != node.depth + 1)
+            {
+                error = name + " and its child " + to_string(child_idx) + " disagree on their link";
+                return false;
+            }
+
+            if (!IsInside(child.bbox, node.bbox))
+            {
+                error = "node " + to_string(child_idx) + " reaches outside its parent's box";
+                return false;
+            }
+
+            if (child.geometric_error > node.geometric_error)
+            {
+                error = "node " + to_string(child_idx) + " has a larger geometric error than its parent";
+                return false;
+            }
+        }
+
+        if ((node.num_triangles > 0) != !node.content_uri.empty())
+        {
+            error = name + " has content without triangles or triangles without content";
+            return false;
+        }
+
+        if (!node.content_uri.empty() && !ValidateGlbFile(folder_name + "/" + node.content_uri, error))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// a wavy grid of quads in the batch's east north up frame, meters.
+MeshData* CreateGridMesh(uint32_t num_cells, double cell_size, const core::vec3d& offset, const string* tex_file_name)
+{
+    uint32_t n = num_cells + 1;
+    MeshData* mesh_data = new MeshData;
+    mesh_data->num_vertex = int(n * n);
+    mesh_data->translation = offset;
+    mesh_data->vertex_list = make_unique<core::vec3f[]>(n * n);
+    mesh_data->uv_list = make_unique<core::vec2f[]>(n * n);
+    for (uint32_t y = 0; y < n; y++)
+    {
+        for (uint32_t x = 0; x < n; x++)
+        {
+            float px = float(x * cell_size), py = float(y * cell_size);
+            mesh_data->vertex_list[y * n + x] = core::vec3f(px, py, 3.0f * sinf(px * 0.05f) * cosf(py * 0.03f));
+            mesh_data->uv_list[y * n + x] = core::vec2f(float(x) / num_cells, float(y) / num_cells);
+        }
+    }
+    if (tex_file_name)
+    {
+        mesh_data->tex_file_name = make_unique<string>(*tex_file_name);
+    }
+
+    mesh_data->add_draw_call_list(kGlTriangles, int(num_cells * num_cells * 6), int(n * n));
+    DrawCallInfo& draw_call = mesh_data->get_last_draw_call_info();
+    for (uint32_t y = 0; y < num_cells; y++)
+    {
+        for (uint32_t x = 0; x < num_cells; x++)
+        {
+            uint32_t i = y * n + x;
+            for (uint32_t idx : { i, i + 1, i + n + 1, i, i + n + 1, i + n })
+            {
+                draw_call.add_index(idx);
+            }
+        }
+    }
+    return mesh_data;
+}
+
+class TilesetTest : public ::testing::Test
+{
+protected:
+    const string folder_name_ = "tileset_test";
+    const string texture_name_ = "tileset_test_texture.png";
+    BatchMeshData batch_;
+    GroupMeshData group_;
+
+    void SetUp() override
+    {
+        vector<uint8_t> image(64 * 64 * 3);
+        for (size_t i = 0; i < image.size(); i++)
+        {
+            image[i] = uint8_t(i * 7);
+        }
+        ASSERT_TRUE(core::ExportPngFile(texture_name_, image.data(), 64, 64, 64 * 3, 3, 8, true));
+
+        // an untextured terrain and a textured block on top of it.
+        batch_.reference_pos = core::vec2d(-122.4, 37.8);
+        group_.meshes.push_back(CreateGridMesh(150, 4.0, core::vec3d(0.0, 0.0, 0.0), nullptr));
+        group_.meshes.push_back(CreateGridMesh(40, 1.0, core::vec3d(200.0, 250.0, 20.0), &texture_name_));
+        batch_.group_meshes.push_back(&group_);
+    }
+
+    void TearDown() override
+    {
+        for (auto mesh_data : group_.meshes)
+        {
+            delete mesh_data;
+        }
+        fs::remove_all(folder_name_);
+        remove(texture_name_.c_str());
+    }
+};
+
+TEST_F(TilesetTest, ExportedTilesetIsValid)
+{
+    TilesetOptions options;
+    options.max_node_triangles = 4096;
+    options.lod_grid_size = 16;
+    Tileset tileset;
+    ASSERT_TRUE(ExportTileset(folder_name_, { &batch_ }, options, &tileset));
+
+    string error;
+    EXPECT_TRUE(ValidateTileset(folder_name_, tileset, error)) << error;
+
+    // every triangle sits in exactly one leaf, the inner nodes hold reduced copies.
+    uint32_t leaf_triangles = 0;
+    for (const auto& node : tileset.node_list)
+    {
+        if (node.child_list.empty())
+        {
+            leaf_triangles += node.num_triangles;
+            EXPECT_LE(node.num_triangles, options.max_node_triangles);
+        }
+    }
+    EXPECT_EQ(leaf_triangles, 150u * 150u * 2u + 40u * 40u * 2u);
+    EXPECT_GT(tileset.node_list.size(), 1u);
+    ASSERT_EQ(tileset.texture_uri_list.size(), 1u);
+    EXPECT_TRUE(fs::exists(folder_name_ + "/" + tileset.texture_uri_list[0]));
+}
+
+TEST_F(TilesetTest, ValidationCatchesBrokenTilesets)
+{
+    TilesetOptions options;
+    options.max_node_triangles = 4096;
+    Tileset tileset;
+    ASSERT_TRUE(ExportTileset(folder_name_, { &batch_ }, options, &tileset));
+
+    string error;
+    Tileset broken = tileset;
+    broken.node_list.back().geometric_error = 1.0;
+    EXPECT_FALSE(ValidateTileset(folder_name_, broken, error));
+
+    broken = tileset;
+    broken.node_list[1].bbox.bb_max.x += 1000.0;
+    EXPECT_FALSE(ValidateTileset(folder_name_, broken, error));
+
+    // a payload cut short.
+    const TilesetNode& leaf = tileset.node_list.back();
+    ASSERT_FALSE(leaf.content_uri.empty());
+    fs::resize_file(folder_name_ + "/" + leaf.content_uri, fs::file_size(folder_name_ + "/" + leaf.content_uri) - 4);
+    EXPECT_FALSE(ValidateTileset(folder_name_, tileset, error));
+}
+
+TEST_F(TilesetTest, NoGeometryWritesNothing)
+{
+    BatchMeshData empty_batch;
+    EXPECT_FALSE(ExportTileset(folder_name_, { &empty_batch }));
+    EXPECT_FALSE(fs::exists(folder_name_ + "/tileset.json"));
+}
+}
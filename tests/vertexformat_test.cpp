@@ -0,0 +1,504 @@
+#include "vertexformat.h"
+#include "glfunctionlist.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+namespace
+{
+const uint32_t kScalarTypeList[] = { kGlByte, kGlUByte, kGlShort, kGlUShort, kGlInt, kGlUInt,
+                                     kGlHalfFloat, kGlFloat, kGlDouble, kGlFixed };
+const uint32_t kPackedTypeList[] = { kGlUInt1010102Rev, kGlInt2101010Rev, kGlUInt10f11f11fRev };
+// types gl has, but not for vertex attributes.
+const uint32_t kOtherTypeList[] = { 0, kGl2Bytes, kGl3Bytes, kGl4Bytes, kGlUByte332, kGlUShort565, kGlUInt8888 };
+const uint32_t kComponentCountList[] = { 0, 1, 2, 3, 4, 5, kGlBgra };
+
+string GetFormatName(const VertexFormat& format)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "type 0x%x size %s%s", format.data_type,
+             format.num_components == kGlBgra ? "bgra" : to_string(format.num_components).c_str(),
+             format.b_normalized ? " normalized" : "");
+    return name;
+}
+
+uint32_t GetScalarTypeSize(uint32_t data_type)
+{
+    switch (data_type)
+    {
+    case kGlByte:
+    case kGlUByte:
+        return 1;
+    case kGlShort:
+    case kGlUShort:
+    case kGlHalfFloat:
+        return 2;
+    case kGlDouble:
+        return 8;
+    }
+    return 4;
+}
+
+bool IsScalarType(uint32_t data_type)
+{
+    return find(begin(kScalarTypeList), end(kScalarTypeList), data_type) != end(kScalarTypeList);
+}
+
+bool IsPacked1010102(uint32_t data_type)
+{
+    return data_type == kGlUInt1010102Rev || data_type == kGlInt2101010Rev;
+}
+
+// the table of glVertexAttribPointer's errors.
+bool IsExpectedValid(const VertexFormat& format)
+{
+    if (format.num_components == kGlBgra)
+    {
+        return format.b_normalized && (format.data_type == kGlUByte || IsPacked1010102(format.data_type));
+    }
+    if (IsPacked1010102(format.data_type))
+    {
+        return format.num_components == 4;
+    }
+    if (format.data_type == kGlUInt10f11f11fRev)
+    {
+        return format.num_components == 3;
+    }
+    return IsScalarType(format.data_type) && format.num_components >= 1 && format.num_components <= 4;
+}
+
+uint32_t GetExpectedSize(const VertexFormat& format)
+{
+    if (!IsExpectedValid(format))
+    {
+        return 0;
+    }
+    if (!IsScalarType(format.data_type))
+    {
+        return 4;
+    }
+    return GetScalarTypeSize(format.data_type) * (format.num_components == kGlBgra ? 4 : format.num_components);
+}
+
+float BitsToFloat(uint32_t bits)
+{
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+uint32_t FloatToBits(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// a float with a 5 bit exponent of bias 15, from its fields. nans keep their payload in the
+// top mantissa bits.
+float SmallFloatReference(uint32_t sign, uint32_t exponent, uint32_t mantissa, int32_t num_mantissa_bits)
+{
+    if (exponent == 31)
+    {
+        return BitsToFloat((sign << 31) | 0x7f800000 | (mantissa << (23 - num_mantissa_bits)));
+    }
+    double magnitude = exponent == 0 ? ldexp(double(mantissa), -14 - num_mantissa_bits)
+                                     : ldexp(1.0 + ldexp(double(mantissa), -num_mantissa_bits), int32_t(exponent) - 15);
+    return float(sign ? -magnitude : magnitude);
+}
+
+// c / (2^b - 1) and max(c / (2^(b-1) - 1), -1) in double, rounded to float once.
+float NormalizedReference(int64_t value, uint32_t num_bits, bool b_signed)
+{
+    double max_value = double((int64_t(1) << (b_signed ? num_bits - 1 : num_bits)) - 1);
+    return float(max(double(value) / max_value, -1.0));
+}
+
+template <class T>
+T Load(const uint8_t* data)
+{
+    T value;
+    memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+float ScalarReference(const uint8_t* data, uint32_t data_type, bool b_normalized)
+{
+    switch (data_type)
+    {
+    case kGlByte:
+        return b_normalized ? NormalizedReference(Load<int8_t>(data), 8, true) : float(Load<int8_t>(data));
+    case kGlUByte:
+        return b_normalized ? NormalizedReference(Load<uint8_t>(data), 8, false) : float(Load<uint8_t>(data));
+    case kGlShort:
+        return b_normalized ? NormalizedReference(Load<int16_t>(data), 16, true) : float(Load<int16_t>(data));
+    case kGlUShort:
+        return b_normalized ? NormalizedReference(Load<uint16_t>(data), 16, false) : float(Load<uint16_t>(data));
+    case kGlInt:
+        return b_normalized ? NormalizedReference(Load<int32_t>(data), 32, true) : float(double(Load<int32_t>(data)));
+    case kGlUInt:
+        return b_normalized ? NormalizedReference(Load<uint32_t>(data), 32, false) : float(double(Load<uint32_t>(data)));
+    case kGlHalfFloat:
+    {
+        uint16_t half = Load<uint16_t>(data);
+        return SmallFloatReference(half >> 15, (half >> 10) & 0x1f, half & 0x3ff, 10);
+    }
+    case kGlFloat:
+        return Load<float>(data);
+    case kGlDouble:
+        return float(Load<double>(data));
+    case kGlFixed:
+        return float(double(Load<int32_t>(data)) / 65536.0);
+    }
+    return 0.0f;
+}
+
+// written from the gl spec, independent of DecodeVertexElement.
+void DecodeReference(const uint8_t* element, const VertexFormat& format, float value[4])
+{
+    value[0] = 0.0f;
+    value[1] = 0.0f;
+    value[2] = 0.0f;
+    value[3] = 1.0f;
+    if (IsPacked1010102(format.data_type))
+    {
+        uint32_t word = Load<uint32_t>(element);
+        bool b_signed = format.data_type == kGlInt2101010Rev;
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            uint32_t num_bits = c < 3 ? 10 : 2;
+            int64_t field = (word >> (10 * c)) & ((1u << num_bits) - 1);
+            if (b_signed && field >= (int64_t(1) << (num_bits - 1)))
+            {
+                field -= int64_t(1) << num_bits;
+            }
+            value[c] = format.b_normalized ? NormalizedReference(field, num_bits, b_signed) : float(field);
+        }
+    }
+    else if (format.data_type == kGlUInt10f11f11fRev)
+    {
+        uint32_t word = Load<uint32_t>(element);
+        value[0] = SmallFloatReference(0, (word >> 6) & 0x1f, word & 0x3f, 6);
+        value[1] = SmallFloatReference(0, (word >> 17) & 0x1f, (word >> 11) & 0x3f, 6);
+        value[2] = SmallFloatReference(0, word >> 27, (word >> 22) & 0x1f, 5);
+    }
+    else
+    {
+        uint32_t num_components = format.num_components == kGlBgra ? 4 : format.num_components;
+        uint32_t component_size = GetScalarTypeSize(format.data_type);
+        for (uint32_t c = 0; c < num_components; c++)
+        {
+            value[c] = ScalarReference(element + c * component_size, format.data_type, format.b_normalized);
+        }
+    }
+
+    if (format.num_components == kGlBgra)
+    {
+        swap(value[0], value[2]);
+    }
+}
+
+// the 32 and 64 bit values can't all be tried, these are where conversions go wrong.
+vector<uint32_t> GetEdgeWords()
+{
+    vector<uint32_t> word_list = { 0, 1, 2, 0xffffffff, 0xfffffffe, 0x7fffffff, 0x80000000, 0x80000001,
+                                   0x00ffffff, 0x01000000, 0x01000001, 0x01000003, 0xfeffffff, 0xff000000,
+                                   0x7fffff80, 0x7fffffc0, 0xffffff80, 0xffffffc0, 0x0000ffff, 0x00010000,
+                                   0x7f800000, 0xff800000, 0x7fc00000, 0xffc00000, 0x7f800001, 0x7fbfffff,
+                                   0x00000001, 0x007fffff, 0x00800000, 0x807fffff, 0x3f800000, 0xbf800000 };
+    mt19937 rng(1);
+    for (int32_t i = 0; i < 8192; i++)
+    {
+        word_list.push_back(rng());
+    }
+    return word_list;
+}
+
+vector<double> GetEdgeDoubles()
+{
+    vector<double> value_list = { 0.0, -0.0, 1.0, -1.0, DBL_MAX, -DBL_MAX, DBL_MIN, DBL_MIN / 4.0,
+                                  double(FLT_MAX), nextafter(double(FLT_MAX), DBL_MAX), double(FLT_MAX) * 2.0,
+                                  double(FLT_MIN), double(FLT_MIN) / 3.0, ldexp(1.0, -149), ldexp(1.0, -150), ldexp(1.0, -151),
+                                  1.0 + ldexp(1.0, -24), 1.0 + ldexp(3.0, -25), 1.0 + ldexp(1.0, -24) + ldexp(1.0, -50),
+                                  HUGE_VAL, -HUGE_VAL, nan("") };
+    mt19937_64 rng(2);
+    uniform_real_distribution<double> value(-1.0e6, 1.0e6);
+    for (int32_t i = 0; i < 4096; i++)
+    {
+        value_list.push_back(value(rng));
+        uint64_t bits = rng();
+        double random_bits;
+        memcpy(&random_bits, &bits, sizeof(random_bits));
+        value_list.push_back(random_bits);
+    }
+    return value_list;
+}
+
+/**
+ * @brief  Tightly packed elements in which every component takes every value its type
+ *         has when that is at most 16 bits, 8 and 16 bit components by odd multiples of
+ *         the element index, packed fields by the low bits of it. Wider components cycle
+ *         through the edge values at a different phase each.
+ */
+vector<uint8_t> CreateTestElements(const VertexFormat& format, uint32_t& num_elements)
+{
+    uint32_t element_size = GetVertexFormatSize(format);
+    uint32_t num_components = element_size / GetScalarTypeSize(format.data_type);
+    vector<uint8_t> data;
+    auto append = [&data](const void* value, size_t size)
+    {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(value);
+        data.insert(data.end(), bytes, bytes + size);
+    };
+
+    if (!IsScalarType(format.data_type))
+    {
+        vector<uint32_t> word_list = GetEdgeWords();
+        num_elements = 2048 + uint32_t(word_list.size());
+        for (uint32_t i = 0; i < 2048; i++)
+        {
+            uint32_t word = format.data_type == kGlUInt10f11f11fRev ?
+                (i & 0x7ff) | (((i * 3 + 1) & 0x7ff) << 11) | (((i * 5 + 2) & 0x3ff) << 22) :
+                (i & 0x3ff) | (((i * 3 + 1) & 0x3ff) << 10) | (((i * 5 + 2) & 0x3ff) << 20) | ((i & 3) << 30);
+            append(&word, 4);
+        }
+        for (uint32_t word : word_list)
+        {
+            append(&word, 4);
+        }
+    }
+    else if (element_size / num_components <= 2)
+    {
+        uint32_t num_bits = 8 * (element_size / num_components);
+        num_elements = 1u << num_bits;
+        for (uint32_t i = 0; i < num_elements; i++)
+        {
+            for (uint32_t c = 0; c < num_components; c++)
+            {
+                uint16_t value = uint16_t(i * (2 * c + 1) + c);
+                append(&value, num_bits / 8);
+            }
+        }
+    }
+    else if (format.data_type == kGlDouble)
+    {
+        vector<double> value_list = GetEdgeDoubles();
+        num_elements = uint32_t(value_list.size());
+        for (uint32_t i = 0; i < num_elements; i++)
+        {
+            for (uint32_t c = 0; c < num_components; c++)
+            {
+                append(&value_list[(i + c * 7) % num_elements], 8);
+            }
+        }
+    }
+    else
+    {
+        vector<uint32_t> word_list = GetEdgeWords();
+        num_elements = uint32_t(word_list.size());
+        for (uint32_t i = 0; i < num_elements; i++)
+        {
+            for (uint32_t c = 0; c < num_components; c++)
+            {
+                append(&word_list[(i + c * 7) % num_elements], 4);
+            }
+        }
+    }
+    return data;
+}
+
+// the messages are only built for a mismatch, there are millions of compares.
+#define EXPECT_SAME_BITS(actual, expected, what) \
+    if (FloatToBits(actual) != FloatToBits(expected)) \
+        ADD_FAILURE() << what << ": " << (actual) << " expected " << (expected)
+
+vector<VertexFormat> GetValidFormats()
+{
+    vector<VertexFormat> format_list;
+    for (const auto& type_list : { vector<uint32_t>(begin(kScalarTypeList), end(kScalarTypeList)),
+                                   vector<uint32_t>(begin(kPackedTypeList), end(kPackedTypeList)) })
+    {
+        for (uint32_t data_type : type_list)
+        {
+            for (uint32_t num_components : kComponentCountList)
+            {
+                for (bool b_normalized : { false, true })
+                {
+                    VertexFormat format(data_type, num_components, b_normalized);
+                    if (IsExpectedValid(format))
+                    {
+                        format_list.push_back(format);
+                    }
+                }
+            }
+        }
+    }
+    return format_list;
+}
+
+TEST(VertexFormatTest, ValidityAndSizeOfEveryCombination)
+{
+    vector<uint32_t> type_list(begin(kScalarTypeList), end(kScalarTypeList));
+    type_list.insert(type_list.end(), begin(kPackedTypeList), end(kPackedTypeList));
+    type_list.insert(type_list.end(), begin(kOtherTypeList), end(kOtherTypeList));
+    uint32_t num_valid = 0;
+    for (uint32_t data_type : type_list)
+    {
+        for (uint32_t num_components : kComponentCountList)
+        {
+            for (bool b_normalized : { false, true })
+            {
+                VertexFormat format(data_type, num_components, b_normalized);
+                EXPECT_EQ(IsValidVertexFormat(format), IsExpectedValid(format)) << GetFormatName(format);
+                EXPECT_EQ(GetVertexFormatSize(format), GetExpectedSize(format)) << GetFormatName(format);
+                num_valid += IsExpectedValid(format) ? 1 : 0;
+
+                if (!IsExpectedValid(format))
+                {
+                    uint8_t element[32] = { 1, 2, 3, 4 };
+                    float value[4] = { 5.0f, 5.0f, 5.0f, 5.0f };
+                    EXPECT_FALSE(DecodeVertexElement(element, format, value)) << GetFormatName(format);
+                    EXPECT_EQ(value[3], 1.0f);
+                    EXPECT_EQ(DecodeVertexStream(element, sizeof(element), 4, format, value, 4), 0u) << GetFormatName(format);
+                }
+            }
+        }
+    }
+    // 10 scalar types in 4 sizes and both ways, 4 packed 2_10_10_10 and 2 more as bgra,
+    // 2 of 10f_11f_11f and normalized ubyte bgra.
+    EXPECT_EQ(num_valid, 80u + 4u + 2u + 2u + 1u);
+    EXPECT_EQ(GetValidFormats().size(), num_valid);
+}
+
+class VertexFormatDecodeTest : public ::testing::TestWithParam<VertexFormat>
+{
+protected:
+    vector<uint8_t> element_data_;
+    uint32_t num_elements_;
+    uint32_t element_size_;
+    vector<float> element_value_list_;     // DecodeVertexElement of each, 4 per element
+
+    void SetUp() override
+    {
+        element_data_ = CreateTestElements(GetParam(), num_elements_);
+        element_size_ = GetVertexFormatSize(GetParam());
+        ASSERT_EQ(element_data_.size(), size_t(num_elements_) * element_size_);
+
+        element_value_list_.resize(size_t(num_elements_) * 4);
+        for (uint32_t i = 0; i < num_elements_; i++)
+        {
+            ASSERT_TRUE(DecodeVertexElement(&element_data_[size_t(i) * element_size_], GetParam(), &element_value_list_[size_t(i) * 4]));
+        }
+    }
+};
+
+TEST_P(VertexFormatDecodeTest, ElementsMatchTheReference)
+{
+    const VertexFormat& format = GetParam();
+    for (uint32_t i = 0; i < num_elements_; i++)
+    {
+        float expected[4];
+        DecodeReference(&element_data_[size_t(i) * element_size_], format, expected);
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            EXPECT_SAME_BITS(element_value_list_[size_t(i) * 4 + c], expected[c],
+                             GetFormatName(format) << " element " << i << " component " << c);
+        }
+        if (HasFailure())
+        {
+            return;
+        }
+    }
+}
+
+// the simd lanes against the scalar elements, every destination width, packed and padded
+// strides. the data ends exactly at the end of its allocation so reads past it are caught
+// under a sanitizer, and the floats after the last element must stay untouched.
+TEST_P(VertexFormatDecodeTest, StreamsMatchTheElements)
+{
+    const VertexFormat& format = GetParam();
+    const float kGuard = -12345.0f;
+    for (size_t stride : { size_t(element_size_), size_t(element_size_) + 3, size_t(element_size_) * 2 + 1 })
+    {
+        size_t num_bytes = (num_elements_ - 1) * stride + element_size_;
+        unique_ptr<uint8_t[]> data(new uint8_t[num_bytes]);
+        memset(data.get(), 0xcd, num_bytes);
+        for (uint32_t i = 0; i < num_elements_; i++)
+        {
+            memcpy(&data[i * stride], &element_data_[size_t(i) * element_size_], element_size_);
+        }
+
+        for (uint32_t num_dst_components = 1; num_dst_components <= 4; num_dst_components++)
+        {
+            // the whole stream, and a count limit ending mid way.
+            for (size_t max_elements : { SIZE_MAX, size_t(num_elements_ / 2 + 1) })
+            {
+                size_t num_expected = min(size_t(num_elements_), max_elements);
+                vector<float> dst(num_expected * num_dst_components + 4, kGuard);
+                ASSERT_EQ(DecodeVertexStream(data.get(), num_bytes, stride, format, dst.data(), num_dst_components, max_elements), num_expected);
+                for (size_t i = 0; i < num_expected; i++)
+                {
+                    for (uint32_t c = 0; c < num_dst_components; c++)
+                    {
+                        EXPECT_SAME_BITS(dst[i * num_dst_components + c], element_value_list_[i * 4 + c],
+                                         GetFormatName(format) << " stride " << stride << " width " << num_dst_components <<
+                                         " element " << i << " component " << c);
+                    }
+                    if (HasFailure())
+                    {
+                        return;
+                    }
+                }
+                for (size_t i = num_expected * num_dst_components; i < dst.size(); i++)
+                {
+                    EXPECT_EQ(dst[i], kGuard) << GetFormatName(format) << " wrote past the last element";
+                }
+            }
+        }
+
+        // a last element cut short is not decoded.
+        vector<float> dst(size_t(num_elements_) * 4);
+        EXPECT_EQ(DecodeVertexStream(data.get(), num_bytes - 1, stride, format, dst.data(), 4), size_t(num_elements_ - 1));
+    }
+}
+
+TEST_P(VertexFormatDecodeTest, ColorStreamsMatchThePackedElements)
+{
+    const VertexFormat& format = GetParam();
+    vector<uint32_t> color_list(num_elements_ + 1, 0xdeadbeef);
+    ASSERT_EQ(DecodeVertexColorStream(element_data_.data(), element_data_.size(), element_size_, format, color_list.data()), num_elements_);
+    for (uint32_t i = 0; i < num_elements_; i++)
+    {
+        ASSERT_EQ(color_list[i], PackVertexColor(&element_value_list_[size_t(i) * 4])) << GetFormatName(format) << " element " << i;
+    }
+    EXPECT_EQ(color_list[num_elements_], 0xdeadbeef);
+}
+
+INSTANTIATE_TEST_CASE_P(EveryValidFormat, VertexFormatDecodeTest, ::testing::ValuesIn(GetValidFormats()));
+
+TEST(VertexFormatTest, BadStreamArgumentsDecodeNothing)
+{
+    uint8_t data[64] = {};
+    float dst[64];
+    VertexFormat format(kGlFloat, 3, false);
+    EXPECT_EQ(DecodeVertexStream(nullptr, sizeof(data), 12, format, dst, 3), 0u);
+    EXPECT_EQ(DecodeVertexStream(data, 11, 12, format, dst, 3), 0u);
+    EXPECT_EQ(DecodeVertexStream(data, sizeof(data), 0, format, dst, 3), 0u);
+    EXPECT_EQ(DecodeVertexStream(data, sizeof(data), 12, format, dst, 0), 0u);
+    EXPECT_EQ(DecodeVertexStream(data, sizeof(data), 12, format, dst, 5), 0u);
+    EXPECT_EQ(DecodeVertexStream(data, 12, 12, format, dst, 3), 1u);
+    EXPECT_EQ(DecodeVertexStream(data, sizeof(data), 12, format, dst, 3, 0), 0u);
+}
+
+TEST(VertexFormatTest, ColorsRoundAndClamp)
+{
+    const float value[4] = { 0.5f, 1.0f / 255.0f, -3.0f, 7.0f };
+    EXPECT_EQ(PackVertexColor(value), 0xff000180u);
+
+    const float special[4] = { nanf(""), HUGE_VALF, -HUGE_VALF, 0.998f };
+    EXPECT_EQ(PackVertexColor(special), 0xfe00ff00u);
+}
+}
@@ -0,0 +1,337 @@
+#include "textureatlas.h"
+#include "glfunctionlist.h"
+#include <algorithm>
+
+namespace
+{
+constexpr uint32_t kDxt1BlockSize = 8;
+
+struct AtlasShelf
+{
+    uint32_t    y;              // in blocks
+    uint32_t    height;
+    uint32_t    width_used;
+};
+
+struct AtlasPage
+{
+    uint32_t            format;
+    uint32_t            width;  // in blocks
+    uint32_t            height;
+    uint32_t            num_textures;
+    vector<AtlasShelf>  shelves;
+};
+
+struct AtlasRegion
+{
+    uint32_t    page_idx;
+    uint32_t    block_x;        // top left block of the texture, gutter excluded
+    uint32_t    block_y;
+};
+
+bool IsDxt1Texture(const core::Texture2DInfo* tex_info)
+{
+    if (!tex_info || tex_info->m_levelCount == 0 || !tex_info->m_mips[0].m_imageData ||
+        (tex_info->m_format != kGLCmpsdRgbS3tcDxt1Ext && tex_info->m_format != kGLCmpsdRgbaS3tcDxt1Ext))
+    {
+        return false;
+    }
+
+    uint32_t w = tex_info->m_mips[0].m_width;
+    uint32_t h = tex_info->m_mips[0].m_height;
+    return w > 0 && h > 0 && (w & 3) == 0 && (h & 3) == 0 &&
+           tex_info->m_mips[0].m_size >= (w / 4) * (h / 4) * kDxt1BlockSize;
+}
+
+bool IsUvInUnitRange(const MeshData* mesh)
+{
+    const float eps = 1e-4f;
+    if (!mesh->uv_list)
+    {
+        return true;
+    }
+
+    for (int i = 0; i < mesh->num_vertex; i++)
+    {
+        const core::vec2f& uv = mesh->uv_list[i];
+        if (uv.x < -eps || uv.x > 1.0f + eps || uv.y < -eps || uv.y > 1.0f + eps)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// first fit on the shelves of the pages with the same format, a new page if nothing fits.
+AtlasRegion PlaceRect(vector<AtlasPage>& page_list, uint32_t format, uint32_t rect_w, uint32_t rect_h, uint32_t page_blocks)
+{
+    for (uint32_t i_page = 0; i_page < page_list.size(); i_page++)
+    {
+        AtlasPage& page = page_list[i_page];
+        if (page.format != format)
+        {
+            continue;
+        }
+
+        for (auto& shelf : page.shelves)
+        {
+            if (rect_h <= shelf.height && shelf.width_used + rect_w <= page_blocks)
+            {
+                AtlasRegion region = { i_page, shelf.width_used, shelf.y };
+                shelf.width_used += rect_w;
+                page.width = max(page.width, shelf.width_used);
+                page.num_textures++;
+                return region;
+            }
+        }
+
+        if (page.height + rect_h <= page_blocks)
+        {
+            AtlasShelf shelf = { page.height, rect_h, rect_w };
+            page.shelves.push_back(shelf);
+            page.height += rect_h;
+            page.width = max(page.width, rect_w);
+            page.num_textures++;
+            return { i_page, 0, shelf.y };
+        }
+    }
+
+    AtlasPage page;
+    page.format = format;
+    page.width = rect_w;
+    page.height = rect_h;
+    page.num_textures = 1;
+    page.shelves.push_back({ 0, rect_h, rect_w });
+    page_list.push_back(page);
+
+    return { uint32_t(page_list.size() - 1), 0, 0 };
+}
+
+// copy a source block into the gutter, every texel takes the 2 bit index of the
+// nearest edge texel so the gutter reads like GL_CLAMP. clamp_x/clamp_y are the
+// column/row to replicate, or -1 to keep the block as is along that axis.
+void CopyClampedDxt1Block(uint8_t* dst, const uint8_t* src, int clamp_x, int clamp_y)
+{
+    memcpy(dst, src, 4);
+    for (int y = 0; y < 4; y++)
+    {
+        uint8_t src_row = src[4 + (clamp_y < 0 ? y : clamp_y)];
+        uint8_t dst_row = 0;
+        for (int x = 0; x < 4; x++)
+        {
+            int sx = clamp_x < 0 ? x : clamp_x;
+            dst_row |= uint8_t(((src_row >> (2 * sx)) & 3) << (2 * x));
+        }
+        dst[4 + y] = dst_row;
+    }
+}
+}
+
+uint32_t BuildGroupTextureAtlas(GroupMeshData* group_mesh_data, uint32_t page_size/* = kDefaultAtlasPageSize*/, uint32_t gutter/* = kDefaultAtlasGutter*/)
+{
+    // usgs groups address textures by name, leave them alone.
+    if (!group_mesh_data || group_mesh_data->loaded_textures.size() < 2 || group_mesh_data->texture_names.size() > 0)
+    {
+        return 0;
+    }
+
+    vector<core::Texture2DInfo*>& textures = group_mesh_data->loaded_textures;
+    uint32_t num_textures = uint32_t(textures.size());
+    uint32_t page_blocks = page_size / 4;
+    uint32_t gutter_blocks = (gutter + 3) / 4;
+
+    vector<uint8_t> can_pack(num_textures, 0);
+    for (uint32_t i = 0; i < num_textures; i++)
+    {
+        can_pack[i] = IsDxt1Texture(textures[i]) ? 1 : 0;
+    }
+
+    for (auto mesh : group_mesh_data->meshes)
+    {
+        if (mesh && mesh->idx_in_texture_list < num_textures && !IsUvInUnitRange(mesh))
+        {
+            can_pack[mesh->idx_in_texture_list] = 0;
+        }
+    }
+
+    // tallest first keeps the shelves tight.
+    vector<uint32_t> pack_order;
+    for (uint32_t i = 0; i < num_textures; i++)
+    {
+        uint32_t rect_w = textures[i] ? textures[i]->m_mips[0].m_width / 4 + 2 * gutter_blocks : 0;
+        uint32_t rect_h = textures[i] ? textures[i]->m_mips[0].m_height / 4 + 2 * gutter_blocks : 0;
+        if (can_pack[i] && rect_w <= page_blocks && rect_h <= page_blocks)
+        {
+            pack_order.push_back(i);
+        }
+    }
+
+    sort(pack_order.begin(), pack_order.end(), [&](uint32_t a, uint32_t b)
+    {
+        const core::Texture2DSurfaceInfo& mip_a = textures[a]->m_mips[0];
+        const core::Texture2DSurfaceInfo& mip_b = textures[b]->m_mips[0];
+        return mip_a.m_height != mip_b.m_height ? mip_a.m_height > mip_b.m_height : mip_a.m_width > mip_b.m_width;
+    });
+
+    vector<AtlasPage> page_list;
+    vector<AtlasRegion> region_list(num_textures, { INVALID_VALUE, 0, 0 });
+    for (auto i_tex : pack_order)
+    {
+        const core::Texture2DSurfaceInfo& mip = textures[i_tex]->m_mips[0];
+        AtlasRegion region = PlaceRect(page_list, textures[i_tex]->m_format,
+                                       mip.m_width / 4 + 2 * gutter_blocks,
+                                       mip.m_height / 4 + 2 * gutter_blocks,
+                                       page_blocks);
+        region.block_x += gutter_blocks;
+        region.block_y += gutter_blocks;
+        region_list[i_tex] = region;
+    }
+
+    // a page holding a single texture saves nothing, drop it and compact the rest.
+    vector<uint32_t> page_remap(page_list.size(), INVALID_VALUE);
+    uint32_t num_pages = 0;
+    for (uint32_t i_page = 0; i_page < page_list.size(); i_page++)
+    {
+        if (page_list[i_page].num_textures > 1)
+        {
+            page_list[num_pages] = page_list[i_page];
+            page_remap[i_page] = num_pages++;
+        }
+    }
+    page_list.resize(num_pages);
+
+    uint32_t num_packed = 0;
+    for (auto& region : region_list)
+    {
+        if (region.page_idx != INVALID_VALUE)
+        {
+            region.page_idx = page_remap[region.page_idx];
+            num_packed += region.page_idx != INVALID_VALUE ? 1 : 0;
+        }
+    }
+
+    if (num_packed == 0)
+    {
+        return 0;
+    }
+
+    vector<core::Texture2DInfo*> page_textures(num_pages);
+    for (uint32_t i_page = 0; i_page < num_pages; i_page++)
+    {
+        const AtlasPage& page = page_list[i_page];
+        core::Texture2DInfo* page_info = new core::Texture2DInfo;
+        page_info->m_objectId = 0;
+        page_info->m_levelCount = 1;
+        page_info->m_format = page.format;
+        page_info->m_internalFormat = page.format;
+        page_info->m_type = 0;
+        page_info->m_mips[0].m_width = page.width * 4;
+        page_info->m_mips[0].m_height = page.height * 4;
+        page_info->m_mips[0].m_size = page.width * page.height * kDxt1BlockSize;
+        page_info->m_mips[0].m_imageData = make_unique<char[]>(page_info->m_mips[0].m_size);
+        page_textures[i_page] = page_info;
+    }
+
+    for (uint32_t i_tex = 0; i_tex < num_textures; i_tex++)
+    {
+        const AtlasRegion& region = region_list[i_tex];
+        if (region.page_idx == INVALID_VALUE)
+        {
+            continue;
+        }
+
+        const core::Texture2DSurfaceInfo& src_mip = textures[i_tex]->m_mips[0];
+        const uint8_t* src = reinterpret_cast<const uint8_t*>(src_mip.m_imageData.get());
+        uint8_t* dst = reinterpret_cast<uint8_t*>(page_textures[region.page_idx]->m_mips[0].m_imageData.get());
+        int src_w = int(src_mip.m_width / 4);
+        int src_h = int(src_mip.m_height / 4);
+        int dst_w = int(page_list[region.page_idx].width);
+        int g = int(gutter_blocks);
+
+        for (int b_y = -g; b_y < src_h + g; b_y++)
+        {
+            int s_y = min(max(b_y, 0), src_h - 1);
+            int clamp_y = b_y < 0 ? 0 : (b_y >= src_h ? 3 : -1);
+            uint8_t* dst_row = dst + ((int(region.block_y) + b_y) * dst_w + int(region.block_x)) * int(kDxt1BlockSize);
+            const uint8_t* src_row = src + s_y * src_w * int(kDxt1BlockSize);
+
+            if (clamp_y < 0)
+            {
+                memcpy(dst_row, src_row, size_t(src_w) * kDxt1BlockSize);
+            }
+            else
+            {
+                for (int b_x = 0; b_x < src_w; b_x++)
+                {
+                    CopyClampedDxt1Block(dst_row + b_x * int(kDxt1BlockSize), src_row + b_x * int(kDxt1BlockSize), -1, clamp_y);
+                }
+            }
+
+            for (int b_x = 1; b_x <= g; b_x++)
+            {
+                CopyClampedDxt1Block(dst_row - b_x * int(kDxt1BlockSize), src_row, 0, clamp_y);
+                CopyClampedDxt1Block(dst_row + (src_w - 1 + b_x) * int(kDxt1BlockSize), src_row + (src_w - 1) * int(kDxt1BlockSize), 3, clamp_y);
+            }
+        }
+    }
+
+    // standalone textures keep their order, the pages go after them.
+    vector<core::Texture2DInfo*> new_textures;
+    vector<uint32_t> tex_remap(num_textures, INVALID_VALUE);
+    for (uint32_t i_tex = 0; i_tex < num_textures; i_tex++)
+    {
+        if (textures[i_tex] && region_list[i_tex].page_idx == INVALID_VALUE)
+        {
+            tex_remap[i_tex] = uint32_t(new_textures.size());
+            new_textures.push_back(textures[i_tex]);
+        }
+    }
+
+    uint32_t first_page_idx = uint32_t(new_textures.size());
+    new_textures.insert(new_textures.end(), page_textures.begin(), page_textures.end());
+
+    for (auto mesh : group_mesh_data->meshes)
+    {
+        if (!mesh || mesh->idx_in_texture_list >= num_textures)
+        {
+            continue;
+        }
+
+        const AtlasRegion& region = region_list[mesh->idx_in_texture_list];
+        if (region.page_idx == INVALID_VALUE)
+        {
+            mesh->idx_in_texture_list = tex_remap[mesh->idx_in_texture_list];
+            continue;
+        }
+
+        const core::Texture2DSurfaceInfo& src_mip = textures[mesh->idx_in_texture_list]->m_mips[0];
+        const core::Texture2DSurfaceInfo& page_mip = page_textures[region.page_idx]->m_mips[0];
+        core::vec2f uv_scale(float(src_mip.m_width) / float(page_mip.m_width),
+                             float(src_mip.m_height) / float(page_mip.m_height));
+        core::vec2f uv_offset(float(region.block_x * 4) / float(page_mip.m_width),
+                              float(region.block_y * 4) / float(page_mip.m_height));
+
+        if (mesh->uv_list)
+        {
+            for (int i = 0; i < mesh->num_vertex; i++)
+            {
+                mesh->uv_list[i] = mesh->uv_list[i] * uv_scale + uv_offset;
+            }
+        }
+
+        mesh->idx_in_texture_list = first_page_idx + region.page_idx;
+    }
+
+    for (uint32_t i_tex = 0; i_tex < num_textures; i_tex++)
+    {
+        if (region_list[i_tex].page_idx != INVALID_VALUE)
+        {
+            SAFE_DELETE(textures[i_tex]);
+        }
+    }
+
+    textures = move(new_textures);
+
+    return num_packed;
+}
@@ -0,0 +1,456 @@
+#include "tiledimage.h"
+#include "corethread.h"
+#include "corepng.h"
+#include <algorithm>
+
+namespace
+{
+enum TiffTag
+{
+    kTiffImageWidth = 256,
+    kTiffImageLength = 257,
+    kTiffBitsPerSample = 258,
+    kTiffCompression = 259,
+    kTiffPhotometric = 262,
+    kTiffStripOffsets = 273,
+    kTiffOrientation = 274,
+    kTiffSamplesPerPixel = 277,
+    kTiffRowsPerStrip = 278,
+    kTiffPlanarConfig = 284,
+    kTiffTileWidth = 322,
+    kTiffTileLength = 323,
+    kTiffTileOffsets = 324,
+};
+
+enum TiffType
+{
+    kTiffShort = 3,
+    kTiffLong = 4,
+    kTiffLong8 = 16,
+};
+}
+
+TiledImageReader::TiledImageReader() : big_endian_(false),
+                                       big_tiff_(false),
+                                       x_size_(0),
+                                       y_size_(0),
+                                       samples_per_pixel_(0),
+                                       rows_per_strip_(0),
+                                       tile_x_size_(0),
+                                       tile_y_size_(0)
+{
+}
+
+TiledImageReader::~TiledImageReader()
+{
+    close();
+}
+
+bool TiledImageReader::open(const string& file_name)
+{
+    close();
+
+    if (open_tiff(file_name))
+    {
+        return true;
+    }
+
+    close();
+    full_image_ = cv::imread(file_name);
+    x_size_ = full_image_.cols;
+    y_size_ = full_image_.rows;
+    return !full_image_.empty();
+}
+
+void TiledImageReader::close()
+{
+    if (file_.is_open())
+    {
+        file_.close();
+    }
+    file_.clear();
+
+    full_image_.release();
+    x_size_ = y_size_ = 0;
+    samples_per_pixel_ = 0;
+    rows_per_strip_ = 0;
+    tile_x_size_ = tile_y_size_ = 0;
+    chunk_offsets_.clear();
+    chunk_buffer_.clear();
+    chunk_buffer_.shrink_to_fit();
+}
+
+uint64_t TiledImageReader::to_uint(const uint8_t* data, uint32_t num_bytes) const
+{
+    uint64_t value = 0;
+    for (uint32_t i = 0; i < num_bytes; i++)
+    {
+        uint32_t shift = big_endian_ ? (num_bytes - 1 - i) * 8 : i * 8;
+        value |= uint64_t(data[i]) << shift;
+    }
+    return value;
+}
+
+bool TiledImageReader::read_tag_values(uint32_t type, uint64_t count, const uint8_t* value_field, vector<uint64_t>& values)
+{
+    uint32_t type_size = type == kTiffShort ? 2 : (type == kTiffLong ? 4 : (type == kTiffLong8 ? 8 : 0));
+    uint32_t field_size = big_tiff_ ? 8 : 4;
+    if (type_size == 0 || count == 0 || count > (uint64_t(1) << 32))
+    {
+        return false;
+    }
+
+    // values that fit in the entry are stored inline, the rest behind an offset.
+    vector<uint8_t> data;
+    const uint8_t* src = value_field;
+    if (count * type_size > field_size)
+    {
+        data.resize(size_t(count * type_size));
+        file_.seekg(streamoff(to_uint(value_field, field_size)));
+        if (!file_.read(reinterpret_cast<char*>(data.data()), streamsize(data.size())))
+        {
+            return false;
+        }
+        src = data.data();
+    }
+
+    values.resize(size_t(count));
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        values[i] = to_uint(src + i * type_size, type_size);
+    }
+    return true;
+}
+
+bool TiledImageReader::open_tiff(const string& file_name)
+{
+    file_.open(file_name, ios::binary);
+    if (!file_.is_open())
+    {
+        return false;
+    }
+
+    uint8_t header[16];
+    if (!file_.read(reinterpret_cast<char*>(header), 8))
+    {
+        return false;
+    }
+
+    if (header[0] != header[1] || (header[0] != 'I' && header[0] != 'M'))
+    {
+        return false;
+    }
+
+    big_endian_ = header[0] == 'M';
+    uint64_t version = to_uint(header + 2, 2);
+    uint64_t ifd_offset;
+    if (version == 42)
+    {
+        big_tiff_ = false;
+        ifd_offset = to_uint(header + 4, 4);
+    }
+    else if (version == 43)
+    {
+        big_tiff_ = true;
+        if (to_uint(header + 4, 2) != 8 || !file_.read(reinterpret_cast<char*>(header + 8), 8))
+        {
+            return false;
+        }
+        ifd_offset = to_uint(header + 8, 8);
+    }
+    else
+    {
+        return false;
+    }
+
+    uint32_t count_size = big_tiff_ ? 8 : 2;
+    uint32_t entry_size = big_tiff_ ? 20 : 12;
+    uint8_t count_data[8];
+    file_.seekg(streamoff(ifd_offset));
+    if (!file_.read(reinterpret_cast<char*>(count_data), count_size))
+    {
+        return false;
+    }
+
+    uint64_t num_entries = to_uint(count_data, count_size);
+    if (num_entries == 0 || num_entries > 4096)
+    {
+        return false;
+    }
+
+    vector<uint8_t> entries(size_t(num_entries * entry_size));
+    if (!file_.read(reinterpret_cast<char*>(entries.data()), streamsize(entries.size())))
+    {
+        return false;
+    }
+
+    // baseline defaults for the tags that may be missing.
+    uint64_t compression = 1, photometric = INVALID_VALUE, orientation = 1, planar_config = 1;
+    uint64_t bits_per_sample = 1, samples_per_pixel = 1, rows_per_strip = UINT32_MAX;
+    uint64_t width = 0, height = 0, tile_width = 0, tile_length = 0;
+    vector<uint64_t> values;
+    for (uint64_t i = 0; i < num_entries; i++)
+    {
+        const uint8_t* entry = &entries[size_t(i * entry_size)];
+        uint32_t tag = uint32_t(to_uint(entry, 2));
+        uint32_t type = uint32_t(to_uint(entry + 2, 2));
+        uint64_t count = to_uint(entry + 4, big_tiff_ ? 8 : 4);
+        const uint8_t* value_field = entry + (big_tiff_ ? 12 : 8);
+
+        switch (tag)
+        {
+        case kTiffImageWidth:
+        case kTiffImageLength:
+        case kTiffBitsPerSample:
+        case kTiffCompression:
+        case kTiffPhotometric:
+        case kTiffOrientation:
+        case kTiffSamplesPerPixel:
+        case kTiffRowsPerStrip:
+        case kTiffPlanarConfig:
+        case kTiffTileWidth:
+        case kTiffTileLength:
+        case kTiffStripOffsets:
+        case kTiffTileOffsets:
+            if (!read_tag_values(type, count, value_field, values))
+            {
+                return false;
+            }
+            break;
+
+        default:
+            continue;
+        }
+
+        switch (tag)
+        {
+        case kTiffImageWidth:       width = values[0]; break;
+        case kTiffImageLength:      height = values[0]; break;
+        case kTiffCompression:      compression = values[0]; break;
+        case kTiffPhotometric:      photometric = values[0]; break;
+        case kTiffOrientation:      orientation = values[0]; break;
+        case kTiffSamplesPerPixel:  samples_per_pixel = values[0]; break;
+        case kTiffRowsPerStrip:     rows_per_strip = values[0]; break;
+        case kTiffPlanarConfig:     planar_config = values[0]; break;
+        case kTiffTileWidth:        tile_width = values[0]; break;
+        case kTiffTileLength:       tile_length = values[0]; break;
+        case kTiffStripOffsets:
+        case kTiffTileOffsets:      chunk_offsets_ = values; break;
+        case kTiffBitsPerSample:
+            bits_per_sample = *max_element(values.begin(), values.end());
+            if (*min_element(values.begin(), values.end()) != bits_per_sample)
+            {
+                return false;
+            }
+            break;
+        }
+    }
+
+    // only what opencv would return unchanged: 8 bit, uncompressed, chunky, top-left
+    // origin, gray or rgb. alpha goes through libtiff's premultiplying path, skip it.
+    bool is_gray = photometric == 1 && samples_per_pixel == 1;
+    bool is_rgb = photometric == 2 && samples_per_pixel == 3;
+    if (compression != 1 || bits_per_sample != 8 || planar_config != 1 || orientation != 1 ||
+        !(is_gray || is_rgb) || width == 0 || height == 0 || width > INT32_MAX / 4 || height > INT32_MAX)
+    {
+        return false;
+    }
+
+    x_size_ = int(width);
+    y_size_ = int(height);
+    samples_per_pixel_ = int(samples_per_pixel);
+
+    size_t num_chunks;
+    if (tile_width > 0 || tile_length > 0)
+    {
+        if (tile_width == 0 || tile_length == 0 || tile_width > 65536 || tile_length > 65536)
+        {
+            return false;
+        }
+        tile_x_size_ = int(tile_width);
+        tile_y_size_ = int(tile_length);
+        num_chunks = size_t((width + tile_width - 1) / tile_width) * size_t((height + tile_length - 1) / tile_length);
+    }
+    else
+    {
+        rows_per_strip_ = int(min(rows_per_strip, height));
+        num_chunks = size_t((height + rows_per_strip_ - 1) / rows_per_strip_);
+    }
+
+    if (chunk_offsets_.size() < num_chunks)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+void TiledImageReader::convert_pixels(const uint8_t* src, int num_pixels, uint8_t* dst) const
+{
+    if (samples_per_pixel_ == 1)
+    {
+        for (int i = 0; i < num_pixels; i++, dst += 3)
+        {
+            dst[0] = dst[1] = dst[2] = src[i];
+        }
+        return;
+    }
+
+    for (int i = 0; i < num_pixels; i++, src += samples_per_pixel_, dst += 3)
+    {
+        dst[0] = src[2];
+        dst[1] = src[1];
+        dst[2] = src[0];
+    }
+}
+
+bool TiledImageReader::read_rows(int y, int num_rows, uint8_t* dst)
+{
+    if (y < 0 || num_rows <= 0 || y + num_rows > y_size_)
+    {
+        return false;
+    }
+
+    size_t dst_pitch = size_t(x_size_) * 3;
+    if (!full_image_.empty())
+    {
+        for (int r = 0; r < num_rows; r++)
+        {
+            memcpy(dst + size_t(r) * dst_pitch, full_image_.ptr(y + r), dst_pitch);
+        }
+        return true;
+    }
+
+    if (tile_x_size_ == 0)
+    {
+        // strips are whole rows, read just the rows needed out of each.
+        size_t row_bytes = size_t(x_size_) * size_t(samples_per_pixel_);
+        for (int row = y; row < y + num_rows;)
+        {
+            int strip = row / rows_per_strip_;
+            int strip_y = strip * rows_per_strip_;
+            int rows = min(strip_y + rows_per_strip_, y + num_rows) - row;
+
+            chunk_buffer_.resize(size_t(rows) * row_bytes);
+            file_.seekg(streamoff(chunk_offsets_[size_t(strip)] + uint64_t(row - strip_y) * row_bytes));
+            if (!file_.read(reinterpret_cast<char*>(chunk_buffer_.data()), streamsize(chunk_buffer_.size())))
+            {
+                file_.clear();
+                return false;
+            }
+
+            for (int r = 0; r < rows; r++)
+            {
+                convert_pixels(&chunk_buffer_[size_t(r) * row_bytes], x_size_, dst + size_t(row - y + r) * dst_pitch);
+            }
+            row += rows;
+        }
+        return true;
+    }
+
+    // edge tiles are stored padded to the full tile size.
+    size_t tile_pitch = size_t(tile_x_size_) * size_t(samples_per_pixel_);
+    int tiles_across = (x_size_ + tile_x_size_ - 1) / tile_x_size_;
+    chunk_buffer_.resize(tile_pitch * size_t(tile_y_size_));
+    for (int t_y = y / tile_y_size_; t_y <= (y + num_rows - 1) / tile_y_size_; t_y++)
+    {
+        int row_begin = max(y, t_y * tile_y_size_);
+        int row_end = min(y + num_rows, (t_y + 1) * tile_y_size_);
+        for (int t_x = 0; t_x < tiles_across; t_x++)
+        {
+            // only the tile rows that overlap the range.
+            size_t first_row = size_t(row_begin - t_y * tile_y_size_);
+            file_.seekg(streamoff(chunk_offsets_[size_t(t_y) * size_t(tiles_across) + size_t(t_x)] + first_row * tile_pitch));
+            if (!file_.read(reinterpret_cast<char*>(chunk_buffer_.data()), streamsize(size_t(row_end - row_begin) * tile_pitch)))
+            {
+                file_.clear();
+                return false;
+            }
+
+            int cols = min(tile_x_size_, x_size_ - t_x * tile_x_size_);
+            for (int row = row_begin; row < row_end; row++)
+            {
+                convert_pixels(&chunk_buffer_[size_t(row - row_begin) * tile_pitch], cols,
+                               dst + size_t(row - y) * dst_pitch + size_t(t_x * tile_x_size_) * 3);
+            }
+        }
+    }
+    return true;
+}
+
+bool CropImageFiles(TiledImageReader& reader, const vector<ImageCropInfo>& crop_list, size_t memory_cap/* = kDefaultImageCropMemorySize*/)
+{
+    int x_size = reader.get_x_size();
+    int y_size = reader.get_y_size();
+
+    vector<uint32_t> order;
+    for (uint32_t i = 0; i < crop_list.size(); i++)
+    {
+        const ImageCropInfo& crop = crop_list[i];
+        if (crop.x < 0 || crop.y < 0 || crop.w <= 0 || crop.h <= 0 || crop.x + crop.w > x_size || crop.y + crop.h > y_size)
+        {
+            return false;
+        }
+        order.push_back(i);
+    }
+
+    sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return crop_list[a].y < crop_list[b].y; });
+
+    // a band always holds at least one whole crop, even past the cap.
+    size_t row_bytes = size_t(x_size) * 3;
+    int max_band_rows = int(min(max(memory_cap / row_bytes, size_t(1)), size_t(y_size)));
+    vector<uint8_t> band_buffer;
+    // one flag per crop, the encoders run in parallel and must not share a bool.
+    vector<uint8_t> written_list(crop_list.size(), 0);
+
+    for (size_t first = 0; first < order.size();)
+    {
+        int band_y = crop_list[order[first]].y;
+        int band_end = band_y + crop_list[order[first]].h;
+        size_t last = first + 1;
+        while (last < order.size())
+        {
+            const ImageCropInfo& crop = crop_list[order[last]];
+            int end = max(band_end, crop.y + crop.h);
+            if (end - band_y > max_band_rows)
+            {
+                break;
+            }
+            band_end = end;
+            last++;
+        }
+
+        cv::Mat band;
+        if (reader.is_streamed())
+        {
+            band_buffer.resize(size_t(band_end - band_y) * row_bytes);
+            if (!reader.read_rows(band_y, band_end - band_y, band_buffer.data()))
+            {
+                return false;
+            }
+            band = cv::Mat(band_end - band_y, x_size, CV_8UC3, band_buffer.data());
+        }
+        else
+        {
+            band = reader.get_full_image().rowRange(band_y, band_end);
+        }
+
+        core::ParallelFor(last - first, 1, [&](size_t begin, size_t end)
+        {
+            for (size_t i = first + begin; i < first + end; i++)
+            {
+                const ImageCropInfo& crop = crop_list[order[i]];
+                cv::Mat sub_img(band, cv::Rect(crop.x, crop.y - band_y, crop.w, crop.h));
+                size_t ext_pos = crop.file_name.rfind('.');
+                bool is_png = ext_pos != string::npos && crop.file_name.compare(ext_pos, string::npos, ".png") == 0;
+                bool written = is_png ? core::ExportPngFile(crop.file_name, sub_img.data, uint32_t(crop.w), uint32_t(crop.h), sub_img.step, 3, 8, true) :
+                                        cv::imwrite(crop.file_name, sub_img);
+                written_list[order[i]] = written ? 1 : 0;
+            }
+        });
+
+        first = last;
+    }
+
+    return find(written_list.begin(), written_list.end(), 0) == written_list.end();
+}
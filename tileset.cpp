@@ -0,0 +1,736 @@
+#include "tileset.h"
+#include "corethread.h"
+#include "coregeographic.h"
+#include "corepng.h"
+#include "opencv2/opencv.hpp"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <filesystem>
+#include <unordered_map>
+#include <algorithm>
+#include <cfloat>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+constexpr uint32_t kGlbMagic = 0x46546c67;          // "glTF"
+constexpr uint32_t kGlbVersion = 2;
+constexpr uint32_t kGlbHeaderSize = 12;
+constexpr uint32_t kGlbChunkHeaderSize = 8;
+constexpr uint32_t kGlbJsonChunk = 0x4e4f534a;      // "JSON"
+constexpr uint32_t kGlbBinChunk = 0x004e4942;       // "BIN"
+constexpr uint32_t kClusterAxisBits = 21;
+// boxes are written at least this thick, flat ground would give a degenerate volume.
+constexpr double kMinBoxHalfSize = 0.01;
+
+// a captured texture of a google dump or a texture file.
+struct TextureSource
+{
+    const core::Texture2DInfo*  tex_info = nullptr;
+    string                      file_name;
+};
+
+// the world geometry as one indexed triangle list in the tileset frame.
+struct TriangleSoup
+{
+    vector<core::vec3d>     position_list;
+    vector<core::vec2f>     uv_list;
+    vector<uint32_t>        color_list;
+    vector<uint32_t>        index_list;
+    vector<uint32_t>        material_list;  // per triangle, texture index or INVALID_VALUE
+    vector<TextureSource>   texture_list;
+    bool                    has_colors = false;
+};
+
+// the triangles of one material in a node, vertices relative to nothing yet.
+struct NodePrimitive
+{
+    uint32_t                material;
+    vector<core::vec3d>     position_list;
+    vector<core::vec2f>     uv_list;
+    vector<uint32_t>        color_list;
+    vector<uint32_t>        index_list;
+};
+
+struct BuildNode
+{
+    core::bounds3d          cell;           // split region, the bbox may reach beyond it
+    vector<uint32_t>        triangle_list;
+};
+
+template <class T>
+void AppendValue(vector<uint8_t>& data, T value)
+{
+    size_t ofs = data.size();
+    data.resize(ofs + sizeof(T));
+    memcpy(&data[ofs], &value, sizeof(T));
+}
+
+bool WriteFileData(const string& file_name, const vector<uint8_t>& data)
+{
+    ofstream out_file(file_name, ofstream::binary);
+    out_file.write(reinterpret_cast<const char*>(data.data()), streamsize(data.size()));
+    return bool(out_file);
+}
+
+core::GpsCoord FindTilesetOrigin(const vector<BatchMeshData*>& batch_mesh_data)
+{
+    for (const auto batch : batch_mesh_data)
+    {
+        if (!batch->is_spline_mesh && !batch->group_meshes.empty())
+        {
+            return core::GpsCoord(batch->reference_pos.x, batch->reference_pos.y, 0.0);
+        }
+    }
+    return core::GpsCoord(0.0, 0.0, 0.0);
+}
+
+void GatherTriangles(const vector<BatchMeshData*>& batch_mesh_data, const core::GpsCoord& origin,
+                     TriangleSoup& soup)
+{
+    core::CoordinateTransformer frame(origin.lat, origin.lon, origin.alt);
+    unordered_map<string, uint32_t> file_texture_map;
+    for (const auto batch : batch_mesh_data)
+    {
+        if (batch->is_spline_mesh)
+        {
+            continue;
+        }
+
+        core::CoordinateTransformer enu_frame(batch->reference_pos.y, batch->reference_pos.x, 0.0);
+        bool same_frame = batch->reference_pos.x == origin.lon && batch->reference_pos.y == origin.lat && origin.alt == 0.0;
+        for (const auto group : batch->group_meshes)
+        {
+            size_t num_meshes = group->meshes.size();
+            vector<uint32_t> mesh_texture_list(num_meshes, INVALID_VALUE);
+            vector<uint32_t> slot_texture_list(group->loaded_textures.size(), INVALID_VALUE);
+            for (uint32_t i = 0; i < num_meshes; i++)
+            {
+                const MeshData* mesh_data = group->meshes[i];
+                if (!mesh_data || !mesh_data->uv_list)
+                {
+                    continue;
+                }
+
+                if (batch->is_google_dump)
+                {
+                    uint32_t slot = mesh_data->idx_in_texture_list;
+                    if (slot < group->loaded_textures.size() && group->loaded_textures[slot])
+                    {
+                        if (slot_texture_list[slot] == INVALID_VALUE)
+                        {
+                            slot_texture_list[slot] = uint32_t(soup.texture_list.size());
+                            soup.texture_list.push_back(TextureSource());
+                            soup.texture_list.back().tex_info = group->loaded_textures[slot];
+                        }
+                        mesh_texture_list[i] = slot_texture_list[slot];
+                    }
+                }
+                else if (mesh_data->tex_file_name)
+                {
+                    auto result = file_texture_map.emplace(*mesh_data->tex_file_name, uint32_t(soup.texture_list.size()));
+                    if (result.second)
+                    {
+                        soup.texture_list.push_back(TextureSource());
+                        soup.texture_list.back().file_name = *mesh_data->tex_file_name;
+                    }
+                    mesh_texture_list[i] = result.first->second;
+                }
+            }
+
+            vector<vector<core::vec3d>> position_lists(num_meshes);
+            vector<vector<uint32_t>> index_lists(num_meshes);
+            core::ParallelFor(num_meshes, 1, [&](size_t begin, size_t end)
+            {
+                for (size_t i_mesh = begin; i_mesh < end; i_mesh++)
+                {
+                    const MeshData* mesh_data = group->meshes[i_mesh];
+                    if (!mesh_data || mesh_data->num_vertex <= 0 || !mesh_data->vertex_list)
+                    {
+                        continue;
+                    }
+
+                    uint32_t num_vertex = uint32_t(mesh_data->num_vertex);
+                    vector<core::vec3d>& position_list = position_lists[i_mesh];
+                    position_list.resize(num_vertex);
+                    for (uint32_t i = 0; i < num_vertex; i++)
+                    {
+                        if (same_frame && !mesh_data->gps_vert_list)
+                        {
+                            const core::vec3f& v = mesh_data->vertex_list[i];
+                            position_list[i] = core::vec3d(v.x, v.y, v.z) + mesh_data->translation;
+                        }
+                        else
+                        {
+                            position_list[i] = frame.lla_to_enu(mesh_data->get_gps_coord(i, enu_frame));
+                        }
+                    }
+
+                    mesh_data->get_triangle_list(index_lists[i_mesh]);
+                }
+            });
+
+            for (size_t i_mesh = 0; i_mesh < num_meshes; i_mesh++)
+            {
+                const MeshData* mesh_data = group->meshes[i_mesh];
+                const vector<core::vec3d>& position_list = position_lists[i_mesh];
+                const vector<uint32_t>& index_list = index_lists[i_mesh];
+                if (position_list.empty() || index_list.empty())
+                {
+                    continue;
+                }
+
+                uint32_t base = uint32_t(soup.position_list.size());
+                uint32_t num_vertex = uint32_t(position_list.size());
+                soup.position_list.insert(soup.position_list.end(), position_list.begin(), position_list.end());
+                for (uint32_t i = 0; i < num_vertex; i++)
+                {
+                    soup.uv_list.push_back(mesh_data->uv_list ? mesh_data->uv_list[i] : core::vec2f(0.0f, 0.0f));
+                    soup.color_list.push_back(mesh_data->color_list ? mesh_data->color_list[i] : 0xffffffff);
+                }
+                soup.has_colors = soup.has_colors || mesh_data->color_list;
+
+                for (size_t i = 0; i + 2 < index_list.size(); i += 3)
+                {
+                    uint32_t i0 = index_list[i], i1 = index_list[i + 1], i2 = index_list[i + 2];
+                    if (i0 < num_vertex && i1 < num_vertex && i2 < num_vertex)
+                    {
+                        soup.index_list.push_back(base + i0);
+                        soup.index_list.push_back(base + i1);
+                        soup.index_list.push_back(base + i2);
+                        soup.material_list.push_back(mesh_texture_list[i_mesh]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// textures/<index>.png, captured textures are decoded and files re-encoded.
+void ExportTilesetTextures(const TriangleSoup& soup, const string& folder_name, vector<string>& texture_uri_list)
+{
+    texture_uri_list.assign(soup.texture_list.size(), string());
+    core::ParallelFor(soup.texture_list.size(), 1, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            const TextureSource& source = soup.texture_list[i];
+            string uri = "textures/" + to_string(i) + ".png";
+            string file_name = folder_name + "/" + uri;
+            bool succeeded = false;
+            if (source.tex_info)
+            {
+                vector<uint8_t> rgba_data;
+                uint32_t w = source.tex_info->m_mips[0].m_width;
+                uint32_t h = source.tex_info->m_mips[0].m_height;
+                succeeded = core::DecodeTextureLevel(source.tex_info, 0, rgba_data) &&
+                            core::ExportPngFile(file_name, rgba_data.data(), w, h, size_t(w) * 4, 4, 8, false);
+            }
+            else
+            {
+                cv::Mat image = cv::imread(source.file_name);
+                succeeded = !image.empty() &&
+                            core::ExportPngFile(file_name, image.data, uint32_t(image.cols), uint32_t(image.rows), image.step, 3, 8, true);
+            }
+
+            if (succeeded)
+            {
+                texture_uri_list[i] = uri;
+            }
+        }
+    });
+}
+
+void SplitNode(const TriangleSoup& soup, const BuildNode& node, vector<BuildNode>& child_list)
+{
+    const core::bounds3d& cell = node.cell;
+    core::vec3d size = cell.GetDiagonal();
+    core::vec3d mid = cell.GetCentroid();
+    // an octree split where the node is about as tall as it is wide, a quadtree otherwise.
+    bool split_z = size.z >= 0.5 * max(size.x, size.y);
+
+    child_list.assign(split_z ? 8 : 4, BuildNode());
+    for (uint32_t i = 0; i < child_list.size(); i++)
+    {
+        core::bounds3d& child_cell = child_list[i].cell;
+        child_cell.bb_min = cell.bb_min;
+        child_cell.bb_max = cell.bb_max;
+        child_cell.b_valid = true;
+        (i & 1 ? child_cell.bb_min.x : child_cell.bb_max.x) = mid.x;
+        (i & 2 ? child_cell.bb_min.y : child_cell.bb_max.y) = mid.y;
+        if (split_z)
+        {
+            (i & 4 ? child_cell.bb_min.z : child_cell.bb_max.z) = mid.z;
+        }
+    }
+
+    for (uint32_t tri : node.triangle_list)
+    {
+        const uint32_t* idx = &soup.index_list[size_t(tri) * 3];
+        core::vec3d centroid = (soup.position_list[idx[0]] + soup.position_list[idx[1]] + soup.position_list[idx[2]]) / 3.0;
+        uint32_t child = (centroid.x >= mid.x ? 1 : 0) | (centroid.y >= mid.y ? 2 : 0) | (split_z && centroid.z >= mid.z ? 4 : 0);
+        child_list[child].triangle_list.push_back(tri);
+    }
+
+    child_list.erase(remove_if(child_list.begin(), child_list.end(), [](const BuildNode& child) { return child.triangle_list.empty(); }), child_list.end());
+}
+
+NodePrimitive& GetPrimitive(vector<NodePrimitive>& primitive_list, unordered_map<uint32_t, uint32_t>& primitive_map, uint32_t material)
+{
+    auto result = primitive_map.emplace(material, uint32_t(primitive_list.size()));
+    if (result.second)
+    {
+        primitive_list.push_back(NodePrimitive());
+        primitive_list.back().material = material;
+    }
+    return primitive_list[result.first->second];
+}
+
+// the node's triangles as they are, split by material.
+void CollectPrimitives(const TriangleSoup& soup, const vector<uint32_t>& triangle_list, vector<NodePrimitive>& primitive_list)
+{
+    unordered_map<uint32_t, uint32_t> primitive_map;
+    vector<unordered_map<uint32_t, uint32_t>> vertex_maps;
+    for (uint32_t tri : triangle_list)
+    {
+        NodePrimitive& primitive = GetPrimitive(primitive_list, primitive_map, soup.material_list[tri]);
+        vertex_maps.resize(primitive_list.size());
+        auto& vertex_map = vertex_maps[size_t(&primitive - primitive_list.data())];
+        for (uint32_t c = 0; c < 3; c++)
+        {
+            uint32_t idx = soup.index_list[size_t(tri) * 3 + c];
+            auto result = vertex_map.emplace(idx, uint32_t(primitive.position_list.size()));
+            if (result.second)
+            {
+                primitive.position_list.push_back(soup.position_list[idx]);
+                primitive.uv_list.push_back(soup.uv_list[idx]);
+                primitive.color_list.push_back(soup.color_list[idx]);
+            }
+            primitive.index_list.push_back(result.first->second);
+        }
+    }
+}
+
+// vertex clustering, every vertex in a cube of cluster_size collapses to the cluster's
+// average and triangles left without area are dropped.
+void CollectClusteredPrimitives(const TriangleSoup& soup, const vector<uint32_t>& triangle_list,
+                                const core::bounds3d& bbox, double cluster_size, vector<NodePrimitive>& primitive_list)
+{
+    struct ClusterSum
+    {
+        core::vec3d     position;
+        double          u, v;
+        double          rgba[4];
+        uint32_t        count;
+    };
+
+    const uint64_t axis_mask = (uint64_t(1) << kClusterAxisBits) - 1;
+    unordered_map<uint32_t, uint32_t> primitive_map;
+    vector<unordered_map<uint64_t, uint32_t>> cluster_maps;
+    vector<vector<ClusterSum>> cluster_sums;
+    for (uint32_t tri : triangle_list)
+    {
+        NodePrimitive& primitive = GetPrimitive(primitive_list, primitive_map, soup.material_list[tri]);
+        size_t i_primitive = size_t(&primitive - primitive_list.data());
+        cluster_maps.resize(primitive_list.size());
+        cluster_sums.resize(primitive_list.size());
+
+        uint32_t cluster_idx[3];
+        for (uint32_t c = 0; c < 3; c++)
+        {
+            uint32_t idx = soup.index_list[size_t(tri) * 3 + c];
+            core::vec3d cell = (soup.position_list[idx] - bbox.bb_min) / cluster_size;
+            uint64_t key = (min(uint64_t(max(cell.x, 0.0)), axis_mask) << (kClusterAxisBits * 2)) |
+                           (min(uint64_t(max(cell.y, 0.0)), axis_mask) << kClusterAxisBits) |
+                           min(uint64_t(max(cell.z, 0.0)), axis_mask);
+            auto result = cluster_maps[i_primitive].emplace(key, uint32_t(cluster_sums[i_primitive].size()));
+            if (result.second)
+            {
+                ClusterSum sum;
+                sum.position = core::vec3d(0.0, 0.0, 0.0);
+                sum.u = sum.v = 0.0;
+                fill(sum.rgba, sum.rgba + 4, 0.0);
+                sum.count = 0;
+                cluster_sums[i_primitive].push_back(sum);
+            }
+            cluster_idx[c] = result.first->second;
+
+            ClusterSum& sum = cluster_sums[i_primitive][cluster_idx[c]];
+            sum.position += soup.position_list[idx];
+            sum.u += soup.uv_list[idx].x;
+            sum.v += soup.uv_list[idx].y;
+            for (uint32_t k = 0; k < 4; k++)
+            {
+                sum.rgba[k] += double((soup.color_list[idx] >> (k * 8)) & 0xff);
+            }
+            sum.count++;
+        }
+
+        if (cluster_idx[0] != cluster_idx[1] && cluster_idx[1] != cluster_idx[2] && cluster_idx[2] != cluster_idx[0])
+        {
+            primitive.index_list.insert(primitive.index_list.end(), cluster_idx, cluster_idx + 3);
+        }
+    }
+
+    for (size_t i = 0; i < primitive_list.size(); i++)
+    {
+        NodePrimitive& primitive = primitive_list[i];
+        for (const auto& sum : cluster_sums[i])
+        {
+            double scale = 1.0 / sum.count;
+            primitive.position_list.push_back(sum.position * scale);
+            primitive.uv_list.push_back(core::vec2f(float(sum.u * scale), float(sum.v * scale)));
+            uint32_t color = 0;
+            for (uint32_t k = 0; k < 4; k++)
+            {
+                color |= uint32_t(sum.rgba[k] * scale + 0.5) << (k * 8);
+            }
+            primitive.color_list.push_back(color);
+        }
+    }
+
+    primitive_list.erase(remove_if(primitive_list.begin(), primitive_list.end(), [](const NodePrimitive& primitive) { return primitive.index_list.empty(); }), primitive_list.end());
+}
+
+void AlignData(vector<uint8_t>& data, uint8_t pad)
+{
+    data.resize((data.size() + 3) & ~size_t(3), pad);
+}
+
+// binary gltf 2.0 of the primitives, positions relative to center and turned y up, the
+// axes 3d tiles turns back to z up.
+void EncodeGlb(const vector<NodePrimitive>& primitive_list, const core::vec3d& center,
+               const vector<string>& texture_uri_list, bool has_colors, vector<uint8_t>& glb)
+{
+    vector<uint8_t> bin;
+    ostringstream accessors, buffer_views, meshes, materials, textures;
+    accessors << setprecision(9);
+    uint32_t num_accessors = 0, num_views = 0;
+    unordered_map<uint32_t, uint32_t> material_map;
+    vector<uint32_t> material_list;
+
+    auto add_view = [&](size_t ofs, uint32_t target)
+    {
+        buffer_views << (num_views ? "," : "") << "{\"buffer\":0,\"byteOffset\":" << ofs << ",\"byteLength\":" << bin.size() - ofs
+                     << ",\"target\":" << target << "}";
+        AlignData(bin, 0);
+        return num_views++;
+    };
+
+    for (const auto& primitive : primitive_list)
+    {
+        uint32_t num_vertex = uint32_t(primitive.position_list.size());
+        bool textured = primitive.material < texture_uri_list.size() && !texture_uri_list[primitive.material].empty();
+
+        size_t ofs = bin.size();
+        core::vec3f min_pos(FLT_MAX, FLT_MAX, FLT_MAX), max_pos(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+        for (const auto& position : primitive.position_list)
+        {
+            core::vec3d p = position - center;
+            core::vec3f v(float(p.x), float(p.z), float(-p.y));
+            min_pos = min(min_pos, v);
+            max_pos = max(max_pos, v);
+            AppendValue(bin, v);
+        }
+        uint32_t view = add_view(ofs, kGlArrayBuffer);
+        uint32_t position_accessor = num_accessors++;
+        accessors << (position_accessor ? "," : "") << "{\"bufferView\":" << view << ",\"componentType\":" << kGlFloat
+                  << ",\"count\":" << num_vertex << ",\"type\":\"VEC3\",\"min\":[" << min_pos.x << "," << min_pos.y << "," << min_pos.z
+                  << "],\"max\":[" << max_pos.x << "," << max_pos.y << "," << max_pos.z << "]}";
+        meshes << (position_accessor ? "," : "") << "{\"attributes\":{\"POSITION\":" << position_accessor;
+
+        if (textured)
+        {
+            ofs = bin.size();
+            for (const auto& uv : primitive.uv_list)
+            {
+                AppendValue(bin, uv);
+            }
+            view = add_view(ofs, kGlArrayBuffer);
+            accessors << ",{\"bufferView\":" << view << ",\"componentType\":" << kGlFloat << ",\"count\":" << num_vertex << ",\"type\":\"VEC2\"}";
+            meshes << ",\"TEXCOORD_0\":" << num_accessors++;
+        }
+
+        if (has_colors)
+        {
+            ofs = bin.size();
+            for (uint32_t color : primitive.color_list)
+            {
+                AppendValue(bin, color);
+            }
+            view = add_view(ofs, kGlArrayBuffer);
+            accessors << ",{\"bufferView\":" << view << ",\"componentType\":" << kGlUByte << ",\"normalized\":true,\"count\":" << num_vertex << ",\"type\":\"VEC4\"}";
+            meshes << ",\"COLOR_0\":" << num_accessors++;
+        }
+
+        ofs = bin.size();
+        bool index_32 = num_vertex > 0xffff;
+        for (uint32_t index : primitive.index_list)
+        {
+            if (index_32)
+            {
+                AppendValue<uint32_t>(bin, index);
+            }
+            else
+            {
+                AppendValue<uint16_t>(bin, uint16_t(index));
+            }
+        }
+        view = add_view(ofs, kGlElementArrayBuffer);
+        accessors << ",{\"bufferView\":" << view << ",\"componentType\":" << (index_32 ? kGlUInt : kGlUShort)
+                  << ",\"count\":" << primitive.index_list.size() << ",\"type\":\"SCALAR\"}";
+
+        uint32_t material_key = textured ? primitive.material : INVALID_VALUE;
+        auto result = material_map.emplace(material_key, uint32_t(material_list.size()));
+        if (result.second)
+        {
+            material_list.push_back(material_key);
+        }
+        meshes << "},\"indices\":" << num_accessors++ << ",\"material\":" << result.first->second << "}";
+    }
+
+    uint32_t num_textures = 0;
+    ostringstream images;
+    for (size_t i = 0; i < material_list.size(); i++)
+    {
+        materials << (i ? "," : "") << "{\"pbrMetallicRoughness\":{";
+        if (material_list[i] != INVALID_VALUE)
+        {
+            materials << "\"baseColorTexture\":{\"index\":" << num_textures << "},";
+            textures << (num_textures ? "," : "") << "{\"sampler\":0,\"source\":" << num_textures << "}";
+            // nodes are written under tiles/, next to textures/.
+            images << (num_textures ? "," : "") << "{\"uri\":\"../" << texture_uri_list[material_list[i]] << "\"}";
+            num_textures++;
+        }
+        materials << "\"metallicFactor\":0,\"roughnessFactor\":1},\"extensions\":{\"KHR_materials_unlit\":{}}}";
+    }
+
+    ostringstream json;
+    json << setprecision(17);
+    json << "{\"asset\":{\"version\":\"2.0\",\"generator\":\"MeshTool\"},"
+         << "\"extensionsUsed\":[\"KHR_materials_unlit\"],"
+         << "\"scene\":0,\"scenes\":[{\"nodes\":[0]}],"
+         << "\"nodes\":[{\"mesh\":0,\"translation\":[" << center.x << "," << center.z << "," << -center.y << "]}],"
+         << "\"meshes\":[{\"primitives\":[" << meshes.str() << "]}],"
+         << "\"materials\":[" << materials.str() << "],";
+    if (num_textures > 0)
+    {
+        json << "\"textures\":[" << textures.str() << "],"
+             << "\"images\":[" << images.str() << "],"
+             << "\"samplers\":[{\"magFilter\":" << kGlLinear << ",\"minFilter\":" << kGlLinearMipmapLinear
+             << ",\"wrapS\":" << kGlRepeat << ",\"wrapT\":" << kGlRepeat << "}],";
+    }
+    json << "\"accessors\":[" << accessors.str() << "],"
+         << "\"bufferViews\":[" << buffer_views.str() << "],"
+         << "\"buffers\":[{\"byteLength\":" << bin.size() << "}]}";
+
+    string json_text = json.str();
+    vector<uint8_t> json_data(json_text.begin(), json_text.end());
+    AlignData(json_data, ' ');
+
+    glb.clear();
+    AppendValue<uint32_t>(glb, kGlbMagic);
+    AppendValue<uint32_t>(glb, kGlbVersion);
+    AppendValue<uint32_t>(glb, uint32_t(kGlbHeaderSize + kGlbChunkHeaderSize * 2 + json_data.size() + bin.size()));
+    AppendValue<uint32_t>(glb, uint32_t(json_data.size()));
+    AppendValue<uint32_t>(glb, kGlbJsonChunk);
+    glb.insert(glb.end(), json_data.begin(), json_data.end());
+    AppendValue<uint32_t>(glb, uint32_t(bin.size()));
+    AppendValue<uint32_t>(glb, kGlbBinChunk);
+    glb.insert(glb.end(), bin.begin(), bin.end());
+}
+
+void WriteTilesetNode(ostream& out, const Tileset& tileset, uint32_t node_idx, const string& indent)
+{
+    const TilesetNode& node = tileset.node_list[node_idx];
+    core::vec3d center = node.bbox.GetCentroid();
+    core::vec3d half = node.bbox.GetDiagonal() * 0.5;
+    half = core::vec3d(max(half.x, kMinBoxHalfSize), max(half.y, kMinBoxHalfSize), max(half.z, kMinBoxHalfSize));
+
+    out << indent << "{\n";
+    if (node_idx == 0)
+    {
+        // east north up at the origin to earth centered, column major.
+        core::CoordinateTransformer frame(tileset.origin.lat, tileset.origin.lon, tileset.origin.alt);
+        core::vec3d axes[3] = { frame.m_inv_rot_mat * core::vec3d(1, 0, 0),
+                                frame.m_inv_rot_mat * core::vec3d(0, 1, 0),
+                                frame.m_inv_rot_mat * core::vec3d(0, 0, 1) };
+        out << indent << "  \"transform\": [";
+        for (const auto& axis : axes)
+        {
+            out << axis.x << ", " << axis.y << ", " << axis.z << ", 0, ";
+        }
+        out << frame.m_origin_ecef.x << ", " << frame.m_origin_ecef.y << ", " << frame.m_origin_ecef.z << ", 1],\n";
+        out << indent << "  \"refine\": \"REPLACE\",\n";
+    }
+    out << indent << "  \"boundingVolume\": {\"box\": [" << center.x << ", " << center.y << ", " << center.z << ", "
+        << half.x << ", 0, 0, 0, " << half.y << ", 0, 0, 0, " << half.z << "]},\n";
+    out << indent << "  \"geometricError\": " << node.geometric_error;
+    if (!node.content_uri.empty())
+    {
+        out << ",\n" << indent << "  \"content\": {\"uri\": \"" << node.content_uri << "\"}";
+    }
+    if (!node.child_list.empty())
+    {
+        out << ",\n" << indent << "  \"children\": [\n";
+        for (size_t i = 0; i < node.child_list.size(); i++)
+        {
+            WriteTilesetNode(out, tileset, node.child_list[i], indent + "    ");
+            out << (i + 1 < node.child_list.size() ? ",\n" : "\n");
+        }
+        out << indent << "  ]";
+    }
+    out << "\n" << indent << "}";
+}
+}
+
+bool ExportTileset(const string& folder_name, const vector<BatchMeshData*>& batch_mesh_data,
+                   const TilesetOptions& options/* = TilesetOptions()*/, Tileset* tileset/* = nullptr*/)
+{
+    Tileset result;
+    result.origin = FindTilesetOrigin(batch_mesh_data);
+
+    TriangleSoup soup;
+    GatherTriangles(batch_mesh_data, result.origin, soup);
+    uint32_t num_triangles = uint32_t(soup.material_list.size());
+    if (num_triangles == 0)
+    {
+        core::output_debug_info("error", "no geometry to write as a tileset");
+        return false;
+    }
+
+    fs::create_directories(folder_name + "/tiles");
+    fs::create_directories(folder_name + "/textures");
+    ExportTilesetTextures(soup, folder_name, result.texture_uri_list);
+
+    // the root cell is square around the geometry, children halve it.
+    core::bounds3d bbox;
+    for (const auto& position : soup.position_list)
+    {
+        bbox += position;
+    }
+    core::vec3d size = bbox.GetDiagonal();
+    double cell_size = max(max(size.x, size.y), 1e-3);
+    vector<BuildNode> level_nodes(1);
+    level_nodes[0].cell.bb_min = bbox.bb_min;
+    level_nodes[0].cell.bb_max = core::vec3d(bbox.bb_min.x + cell_size, bbox.bb_min.y + cell_size, bbox.bb_max.z);
+    level_nodes[0].cell.b_valid = true;
+    level_nodes[0].triangle_list.resize(num_triangles);
+    for (uint32_t i = 0; i < num_triangles; i++)
+    {
+        level_nodes[0].triangle_list[i] = i;
+    }
+
+    TilesetNode root;
+    root.parent = -1;
+    root.depth = 0;
+    result.node_list.push_back(root);
+
+    bool all_succeeded = true;
+    uint32_t level_start = 0;
+    for (uint32_t depth = 0; !level_nodes.empty(); depth++)
+    {
+        size_t num_level_nodes = level_nodes.size();
+        vector<vector<BuildNode>> child_lists(num_level_nodes);
+        vector<uint8_t> succeeded_list(num_level_nodes, 0);
+        core::ParallelFor(num_level_nodes, 1, [&](size_t begin, size_t end)
+        {
+            vector<NodePrimitive> primitive_list;
+            vector<uint8_t> glb;
+            for (size_t i = begin; i < end; i++)
+            {
+                const BuildNode& build_node = level_nodes[i];
+                TilesetNode& node = result.node_list[level_start + i];
+                node.bbox.Reset();
+                for (uint32_t tri : build_node.triangle_list)
+                {
+                    for (uint32_t c = 0; c < 3; c++)
+                    {
+                        node.bbox += soup.position_list[soup.index_list[size_t(tri) * 3 + c]];
+                    }
+                }
+
+                bool is_leaf = build_node.triangle_list.size() <= options.max_node_triangles || depth >= options.max_depth;
+                if (!is_leaf)
+                {
+                    SplitNode(soup, build_node, child_lists[i]);
+                }
+
+                primitive_list.clear();
+                if (is_leaf)
+                {
+                    node.geometric_error = 0.0;
+                    CollectPrimitives(soup, build_node.triangle_list, primitive_list);
+                }
+                else
+                {
+                    core::vec3d cell = build_node.cell.GetDiagonal();
+                    double cluster_size = max(max(cell.x, cell.y), 1e-3) / max(options.lod_grid_size, 1u);
+                    // the largest move of a clustered vertex, the cluster's diagonal.
+                    node.geometric_error = cluster_size * sqrt(3.0);
+                    CollectClusteredPrimitives(soup, build_node.triangle_list, node.bbox, cluster_size, primitive_list);
+                }
+
+                node.num_triangles = 0;
+                for (const auto& primitive : primitive_list)
+                {
+                    node.num_triangles += uint32_t(primitive.index_list.size() / 3);
+                }
+
+                if (node.num_triangles > 0)
+                {
+                    node.content_uri = "tiles/" + to_string(level_start + i) + ".glb";
+                    EncodeGlb(primitive_list, node.bbox.GetCentroid(), result.texture_uri_list, soup.has_colors, glb);
+                    succeeded_list[i] = WriteFileData(folder_name + "/" + node.content_uri, glb);
+                }
+                else
+                {
+                    succeeded_list[i] = 1;
+                }
+            }
+        });
+        all_succeeded = all_succeeded && find(succeeded_list.begin(), succeeded_list.end(), 0) == succeeded_list.end();
+
+        uint32_t next_level_start = uint32_t(result.node_list.size());
+        vector<BuildNode> next_level_nodes;
+        for (size_t i = 0; i < num_level_nodes; i++)
+        {
+            for (auto& child : child_lists[i])
+            {
+                TilesetNode node;
+                node.parent = int32_t(level_start + i);
+                node.depth = depth + 1;
+                result.node_list[level_start + i].child_list.push_back(uint32_t(result.node_list.size()));
+                result.node_list.push_back(node);
+                next_level_nodes.push_back(move(child));
+            }
+        }
+        level_nodes = move(next_level_nodes);
+        level_start = next_level_start;
+    }
+
+    const TilesetNode& root_node = result.node_list[0];
+    ofstream tileset_file(folder_name + "/tileset.json");
+    tileset_file << setprecision(17);
+    tileset_file << "{\n"
+                    "  \"asset\": {\"version\": \"1.1\", \"generator\": \"MeshTool\"},\n"
+                    "  \"geometricError\": " << max(core::length(root_node.bbox.GetDiagonal()), root_node.geometric_error) << ",\n"
+                    "  \"root\":\n";
+    WriteTilesetNode(tileset_file, result, 0, "  ");
+    tileset_file << "\n}\n";
+    tileset_file.close();
+
+    if (!all_succeeded || !tileset_file)
+    {
+        core::output_debug_info("error", "failed to write the tileset to " + folder_name);
+        all_succeeded = false;
+    }
+
+    if (tileset)
+    {
+        *tileset = move(result);
+    }
+    return all_succeeded;
+}
@@ -0,0 +1,573 @@
+#include "vertexformat.h"
+#include "glfunctionlist.h"
+#include "coresimd.h"
+#include <cstring>
+
+namespace
+{
+template <class T>
+T LoadValue(const uint8_t* data)
+{
+    T value;
+    memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+float BitsToFloat(uint32_t bits)
+{
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+uint32_t FloatToBits(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// exact, denormals, infinities and nan payloads included.
+float HalfToFloat(uint16_t half)
+{
+    uint32_t sign = uint32_t(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1f;
+    uint32_t mantissa = half & 0x3ff;
+    if (exponent == 0x1f)
+    {
+        return BitsToFloat(sign | 0x7f800000 | (mantissa << 13));
+    }
+    if (exponent == 0)
+    {
+        return BitsToFloat(sign | FloatToBits(float(mantissa) * (1.0f / 16777216.0f)));
+    }
+    return BitsToFloat(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+// the unsigned 11 and 10 bit floats have the exponent of a half and a shorter mantissa.
+float SmallFloatToFloat(uint32_t value, uint32_t num_mantissa_bits)
+{
+    uint32_t exponent = (value >> num_mantissa_bits) & 0x1f;
+    uint32_t mantissa = value & ((1u << num_mantissa_bits) - 1);
+    return HalfToFloat(uint16_t((exponent << 10) | (mantissa << (10 - num_mantissa_bits))));
+}
+
+float NormalizeUnsigned(uint32_t value, uint32_t num_bits)
+{
+    if (num_bits == 32)
+    {
+        return float(double(value) / 4294967295.0);
+    }
+    return float(value) / float((1u << num_bits) - 1);
+}
+
+float NormalizeSigned(int32_t value, uint32_t num_bits)
+{
+    float result = num_bits == 32 ? float(double(value) / 2147483647.0) : float(value) / float((1u << (num_bits - 1)) - 1);
+    return max(result, -1.0f);
+}
+
+bool IsScalarVertexType(uint32_t data_type)
+{
+    switch (data_type)
+    {
+    case kGlByte:
+    case kGlUByte:
+    case kGlShort:
+    case kGlUShort:
+    case kGlInt:
+    case kGlUInt:
+    case kGlHalfFloat:
+    case kGlFloat:
+    case kGlDouble:
+    case kGlFixed:
+        return true;
+    }
+    return false;
+}
+
+void StoreComponents(const float value[4], float* dst, uint32_t num_dst_components)
+{
+    for (uint32_t c = 0; c < num_dst_components; c++)
+    {
+        dst[c] = value[c];
+    }
+}
+
+size_t DecodeElementsScalar(const uint8_t* data, size_t stride, size_t count, const VertexFormat& format,
+                            float* dst, uint32_t num_dst_components)
+{
+    float value[4];
+    for (size_t i = 0; i < count; i++)
+    {
+        DecodeVertexElement(data + i * stride, format, value);
+        StoreComponents(value, dst + i * num_dst_components, num_dst_components);
+    }
+    return count;
+}
+
+#if defined(CORE_SIMD_SSE)
+// what is done to the raw lanes of every element after the load.
+struct ElementLanes
+{
+    __m128      scale;              // divisor of normalized and fixed formats
+    bool        b_scaled;           // floats go through untouched, a divide would quiet signaling nans
+    __m128      keep_mask;          // lanes the format has
+    __m128      fill;               // the rest, (0, 0, 0, 1)
+    bool        b_signed_clamp;     // signed normalized, max(v, -1)
+    bool        b_bgra;
+};
+
+void StoreLanes(__m128 value, float* dst, uint32_t num_dst_components, bool b_last)
+{
+    switch (num_dst_components)
+    {
+    case 4:
+        _mm_storeu_ps(dst, value);
+        break;
+    case 3:
+        // the fourth lane is written over by the next element.
+        if (!b_last)
+        {
+            _mm_storeu_ps(dst, value);
+        }
+        else
+        {
+            _mm_storel_pi(reinterpret_cast<__m64*>(dst), value);
+            _mm_store_ss(dst + 2, _mm_movehl_ps(value, value));
+        }
+        break;
+    case 2:
+        _mm_storel_pi(reinterpret_cast<__m64*>(dst), value);
+        break;
+    case 1:
+        _mm_store_ss(dst, value);
+        break;
+    }
+}
+
+/**
+ * @brief  Load one element per register with load, which may read load_width bytes from
+ *         its pointer. Elements too close to the end of the data are copied to a zeroed
+ *         buffer first, nothing past num_bytes is read.
+ */
+template <class Load>
+void DecodeElementLanes(const uint8_t* data, size_t num_bytes, size_t stride, size_t count, uint32_t element_size,
+                        uint32_t load_width, const ElementLanes& lanes, float* dst, uint32_t num_dst_components, Load load)
+{
+    const __m128 minus_one = _mm_set1_ps(-1.0f);
+    for (size_t i = 0; i < count; i++)
+    {
+        const uint8_t* element = data + i * stride;
+        uint8_t padded[32];
+        if (i * stride + load_width > num_bytes)
+        {
+            memset(padded, 0, sizeof(padded));
+            memcpy(padded, element, element_size);
+            element = padded;
+        }
+
+        __m128 value = load(element);
+        if (lanes.b_scaled)
+        {
+            value = _mm_div_ps(value, lanes.scale);
+        }
+        if (lanes.b_signed_clamp)
+        {
+            value = _mm_max_ps(value, minus_one);
+        }
+        if (lanes.b_bgra)
+        {
+            value = _mm_shuffle_ps(value, value, _MM_SHUFFLE(3, 0, 1, 2));
+        }
+        value = _mm_or_ps(_mm_and_ps(value, lanes.keep_mask), lanes.fill);
+        StoreLanes(value, dst + i * num_dst_components, num_dst_components, i + 1 == count);
+    }
+}
+
+__m128i LoadInt32(const uint8_t* element)
+{
+    return _mm_cvtsi32_si128(LoadValue<int32_t>(element));
+}
+
+// rounds once, like the conversion of a scalar uint32_t.
+__m128 ConvertUInt32Lanes(__m128i value)
+{
+    __m128 high = _mm_cvtepi32_ps(_mm_srli_epi32(value, 16));
+    __m128 low = _mm_cvtepi32_ps(_mm_and_si128(value, _mm_set1_epi32(0xffff)));
+    return _mm_add_ps(_mm_mul_ps(high, _mm_set1_ps(65536.0f)), low);
+}
+
+// the bits of a half moved into a float with the exponent rebased, infinities and nans
+// get the full exponent. denormals are renormalized by subtracting 2^-14, so no lane
+// ever holds a denormal float, those are slow. same bits as HalfToFloat.
+__m128 ConvertHalfLanes(__m128i half)
+{
+    const __m128i exponent_adjust = _mm_set1_epi32((127 - 15) << 23);
+    const __m128i denormal_magic = _mm_set1_epi32(113 << 23);
+    __m128i exp_mantissa = _mm_and_si128(half, _mm_set1_epi32(0x7fff));
+    __m128i sign = _mm_slli_epi32(_mm_xor_si128(half, exp_mantissa), 16);
+    __m128i shifted = _mm_slli_epi32(exp_mantissa, 13);
+
+    __m128i inf_nan = _mm_cmpgt_epi32(exp_mantissa, _mm_set1_epi32(0x7bff));
+    __m128i normal = _mm_add_epi32(_mm_add_epi32(shifted, exponent_adjust), _mm_and_si128(inf_nan, exponent_adjust));
+    __m128 denormal = _mm_sub_ps(_mm_castsi128_ps(_mm_add_epi32(shifted, denormal_magic)), _mm_castsi128_ps(denormal_magic));
+
+    __m128 is_denormal = _mm_castsi128_ps(_mm_cmplt_epi32(exp_mantissa, _mm_set1_epi32(0x0400)));
+    __m128 value = _mm_or_ps(_mm_and_ps(is_denormal, denormal), _mm_andnot_ps(is_denormal, _mm_castsi128_ps(normal)));
+    return _mm_or_ps(value, _mm_castsi128_ps(sign));
+}
+
+// x y z in bits 0, 10, 20 and w in 30, as unsigned values. w is shifted down first,
+// the top bit would make the lane negative.
+__m128 ConvertPacked1010102Lanes(const uint8_t* element)
+{
+    __m128i packed = _mm_set1_epi32(LoadValue<int32_t>(element));
+    __m128i xyz = _mm_and_si128(packed, _mm_setr_epi32(0x3ff, 0x3ff << 10, 0x3ff << 20, 0));
+    __m128i w = _mm_and_si128(_mm_srli_epi32(packed, 2), _mm_setr_epi32(0, 0, 0, 0x3 << 28));
+    __m128 value = _mm_cvtepi32_ps(_mm_or_si128(xyz, w));
+    return _mm_mul_ps(value, _mm_setr_ps(1.0f, 1.0f / 1024.0f, 1.0f / 1048576.0f, 1.0f / 268435456.0f));
+}
+
+// false for the formats left to the scalar path.
+bool DecodeElementsSimd(const uint8_t* data, size_t num_bytes, size_t stride, size_t count, const VertexFormat& format,
+                        float* dst, uint32_t num_dst_components)
+{
+    uint32_t num_components = format.num_components == kGlBgra ? 4 : format.num_components;
+    uint32_t element_size = GetVertexFormatSize(format);
+    bool b_normalized = format.b_normalized;
+
+    ElementLanes lanes;
+    lanes.scale = _mm_set1_ps(1.0f);
+    lanes.b_scaled = b_normalized && format.data_type != kGlFloat && format.data_type != kGlHalfFloat && format.data_type != kGlDouble;
+    lanes.keep_mask = _mm_castsi128_ps(_mm_setr_epi32(-1, num_components > 1 ? -1 : 0, num_components > 2 ? -1 : 0, num_components > 3 ? -1 : 0));
+    lanes.fill = _mm_setr_ps(0.0f, 0.0f, 0.0f, num_components > 3 ? 0.0f : 1.0f);
+    lanes.b_signed_clamp = false;
+    lanes.b_bgra = format.num_components == kGlBgra;
+
+    const __m128i zero = _mm_setzero_si128();
+    switch (format.data_type)
+    {
+    case kGlFloat:
+        DecodeElementLanes(data, num_bytes, stride, count, element_size, 16, lanes, dst, num_dst_components,
+            [](const uint8_t* element) { return _mm_loadu_ps(reinterpret_cast<const float*>(element)); });
+        return true;
+    case kGlHalfFloat:
+        DecodeElementLanes(data, num_bytes, stride, count, element_size, 8, lanes, dst, num_dst_components,
+            [zero](const uint8_t* element) {
+                return ConvertHalfLanes(_mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(element)), zero));
+            });
+        return true;
+    case kGlDouble:
+        DecodeElementLanes(data, num_bytes, stride, count, element_size, 32, lanes, dst, num_dst_components,
+            [](const uint8_t* element) {
+                __m128 low = _mm_cvtpd_ps(_mm_loadu_pd(reinterpret_cast<const double*>(element)));
+                __m128 high = _mm_cvtpd_ps(_mm_loadu_pd(reinterpret_cast<const double*>(element) + 2));
+                return _mm_movelh_ps(low, high);
+            });
+        return true;
+    case kGlFixed:
+        lanes.scale = _mm_set1_ps(65536.0f);
+        lanes.b_scaled = true;
+        DecodeElementLanes(data, num_bytes, stride, count, element_size, 16, lanes, dst, num_dst_components,
+            [](const uint8_t* element) { return _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(element))); });
+        return true;
+    case kGlByte:
+        lanes.scale = _mm_set1_ps(b_normalized ? 127.0f : 1.0f);
+        lanes.b_signed_clamp = b_normalized;
+        DecodeElementLanes(data, num_bytes, stride, count, element_size, 4, lanes, dst, num_dst_components,
+            [](const uint8_t* element) {
+                __m128i bytes = LoadInt32(element);
+                __m128i words = _mm_srai_epi16(_mm_unpacklo_epi8(bytes, bytes), 8);
+                return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(words, words), 16));
+            });
+        return true;
+    case kGlUByte:
+        lanes.scale = _mm_set1_ps(b_normalized ? 255.0f : 1.0f);
+        DecodeElementLanes(data, num_bytes, stride, count, element_size, 4, lanes, dst, num_dst_components,
+            [zero](const uint8_t* element) {
+                return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(LoadInt32(element), zero), zero));
+            });
+        return true;
+    case kGlShort:
+        lanes.scale = _mm_set1_ps(b_normalized ? 32767.0f : 1.0f);
+        lanes.b_signed_clamp = b_normalized;
+        DecodeElementLanes(data, num_bytes, stride, count, element_size, 8, lanes, dst, num_dst_components,
+            [](const uint8_t* element) {
+                __m128i words = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(element));
+                return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(words, words), 16));
+            });
+        return true;
+    case kGlUShort:
+        lanes.scale = _mm_set1_ps(b_normalized ? 65535.0f : 1.0f);
+        DecodeElementLanes(data, num_bytes, stride, count, element_size, 8, lanes, dst, num_dst_components,
+            [zero](const uint8_t* element) {
+                return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(element)), zero));
+            });
+        return true;
+    case kGlInt:
+        if (b_normalized)
+        {
+            return false;
+        }
+        DecodeElementLanes(data, num_bytes, stride, count, element_size, 16, lanes, dst, num_dst_components,
+            [](const uint8_t* element) { return _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(element))); });
+        return true;
+    case kGlUInt:
+        if (b_normalized)
+        {
+            return false;
+        }
+        DecodeElementLanes(data, num_bytes, stride, count, element_size, 16, lanes, dst, num_dst_components,
+            [](const uint8_t* element) { return ConvertUInt32Lanes(_mm_loadu_si128(reinterpret_cast<const __m128i*>(element))); });
+        return true;
+    case kGlUInt1010102Rev:
+        lanes.scale = b_normalized ? _mm_setr_ps(1023.0f, 1023.0f, 1023.0f, 3.0f) : _mm_set1_ps(1.0f);
+        DecodeElementLanes(data, num_bytes, stride, count, element_size, 4, lanes, dst, num_dst_components,
+            ConvertPacked1010102Lanes);
+        return true;
+    case kGlInt2101010Rev:
+        lanes.scale = b_normalized ? _mm_setr_ps(511.0f, 511.0f, 511.0f, 1.0f) : _mm_set1_ps(1.0f);
+        lanes.b_signed_clamp = b_normalized;
+        DecodeElementLanes(data, num_bytes, stride, count, element_size, 4, lanes, dst, num_dst_components,
+            [](const uint8_t* element) {
+                // two's complement from the unsigned fields, subtract 2^b where the top bit is set.
+                __m128 value = ConvertPacked1010102Lanes(element);
+                __m128 negative = _mm_cmpge_ps(value, _mm_setr_ps(512.0f, 512.0f, 512.0f, 2.0f));
+                return _mm_sub_ps(value, _mm_and_ps(negative, _mm_setr_ps(1024.0f, 1024.0f, 1024.0f, 4.0f)));
+            });
+        return true;
+    }
+
+    return false;
+}
+#endif
+}
+
+bool IsValidVertexFormat(const VertexFormat& format)
+{
+    if (format.num_components == kGlBgra)
+    {
+        return format.b_normalized &&
+               (format.data_type == kGlUByte || format.data_type == kGlUInt1010102Rev || format.data_type == kGlInt2101010Rev);
+    }
+
+    if (format.data_type == kGlUInt1010102Rev || format.data_type == kGlInt2101010Rev)
+    {
+        return format.num_components == 4;
+    }
+
+    if (format.data_type == kGlUInt10f11f11fRev)
+    {
+        return format.num_components == 3;
+    }
+
+    return IsScalarVertexType(format.data_type) && format.num_components >= 1 && format.num_components <= 4;
+}
+
+uint32_t GetVertexFormatSize(const VertexFormat& format)
+{
+    if (!IsValidVertexFormat(format))
+    {
+        return 0;
+    }
+
+    uint32_t num_components = format.num_components == kGlBgra ? 4 : format.num_components;
+    switch (format.data_type)
+    {
+    case kGlByte:
+    case kGlUByte:
+        return num_components;
+    case kGlShort:
+    case kGlUShort:
+    case kGlHalfFloat:
+        return num_components * 2;
+    case kGlInt:
+    case kGlUInt:
+    case kGlFloat:
+    case kGlFixed:
+        return num_components * 4;
+    case kGlDouble:
+        return num_components * 8;
+    }
+
+    // the packed types hold all components in one 32 bit word.
+    return 4;
+}
+
+bool DecodeVertexElement(const uint8_t* element, const VertexFormat& format, float value[4])
+{
+    value[0] = 0.0f;
+    value[1] = 0.0f;
+    value[2] = 0.0f;
+    value[3] = 1.0f;
+    if (!IsValidVertexFormat(format))
+    {
+        return false;
+    }
+
+    bool b_normalized = format.b_normalized;
+    uint32_t num_components = format.num_components == kGlBgra ? 4 : format.num_components;
+    if (format.data_type == kGlUInt1010102Rev || format.data_type == kGlInt2101010Rev)
+    {
+        uint32_t packed = LoadValue<uint32_t>(element);
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            uint32_t num_bits = c < 3 ? 10 : 2;
+            uint32_t field = (packed >> (10 * c)) & ((1u << num_bits) - 1);
+            if (format.data_type == kGlUInt1010102Rev)
+            {
+                value[c] = b_normalized ? NormalizeUnsigned(field, num_bits) : float(field);
+            }
+            else
+            {
+                int32_t signed_field = int32_t(field) - ((field >> (num_bits - 1)) ? int32_t(1u << num_bits) : 0);
+                value[c] = b_normalized ? NormalizeSigned(signed_field, num_bits) : float(signed_field);
+            }
+        }
+    }
+    else if (format.data_type == kGlUInt10f11f11fRev)
+    {
+        uint32_t packed = LoadValue<uint32_t>(element);
+        value[0] = SmallFloatToFloat(packed & 0x7ff, 6);
+        value[1] = SmallFloatToFloat((packed >> 11) & 0x7ff, 6);
+        value[2] = SmallFloatToFloat(packed >> 22, 5);
+    }
+    else
+    {
+        for (uint32_t c = 0; c < num_components; c++)
+        {
+            switch (format.data_type)
+            {
+            case kGlByte:
+            {
+                int8_t v = LoadValue<int8_t>(element + c);
+                value[c] = b_normalized ? NormalizeSigned(v, 8) : float(v);
+                break;
+            }
+            case kGlUByte:
+            {
+                uint8_t v = element[c];
+                value[c] = b_normalized ? NormalizeUnsigned(v, 8) : float(v);
+                break;
+            }
+            case kGlShort:
+            {
+                int16_t v = LoadValue<int16_t>(element + c * 2);
+                value[c] = b_normalized ? NormalizeSigned(v, 16) : float(v);
+                break;
+            }
+            case kGlUShort:
+            {
+                uint16_t v = LoadValue<uint16_t>(element + c * 2);
+                value[c] = b_normalized ? NormalizeUnsigned(v, 16) : float(v);
+                break;
+            }
+            case kGlInt:
+            {
+                int32_t v = LoadValue<int32_t>(element + c * 4);
+                value[c] = b_normalized ? NormalizeSigned(v, 32) : float(v);
+                break;
+            }
+            case kGlUInt:
+            {
+                uint32_t v = LoadValue<uint32_t>(element + c * 4);
+                value[c] = b_normalized ? NormalizeUnsigned(v, 32) : float(v);
+                break;
+            }
+            case kGlHalfFloat:
+                value[c] = HalfToFloat(LoadValue<uint16_t>(element + c * 2));
+                break;
+            case kGlFloat:
+                value[c] = LoadValue<float>(element + c * 4);
+                break;
+            case kGlDouble:
+                value[c] = float(LoadValue<double>(element + c * 8));
+                break;
+            case kGlFixed:
+                value[c] = float(LoadValue<int32_t>(element + c * 4)) / 65536.0f;
+                break;
+            }
+        }
+    }
+
+    if (format.num_components == kGlBgra)
+    {
+        swap(value[0], value[2]);
+    }
+    return true;
+}
+
+size_t DecodeVertexStream(const uint8_t* data, size_t num_bytes, size_t stride, const VertexFormat& format,
+                          float* dst, uint32_t num_dst_components, size_t max_elements)
+{
+    uint32_t element_size = GetVertexFormatSize(format);
+    if (!data || element_size == 0 || stride == 0 || num_bytes < element_size || num_dst_components < 1 || num_dst_components > 4)
+    {
+        return 0;
+    }
+
+    size_t count = min((num_bytes - element_size) / stride + 1, max_elements);
+#if defined(CORE_SIMD_SSE)
+    if (DecodeElementsSimd(data, num_bytes, stride, count, format, dst, num_dst_components))
+    {
+        return count;
+    }
+#endif
+    return DecodeElementsScalar(data, stride, count, format, dst, num_dst_components);
+}
+
+uint32_t PackVertexColor(const float value[4])
+{
+    uint32_t color = 0;
+    for (uint32_t c = 0; c < 4; c++)
+    {
+        // nan goes to 0 like the max of the simd lanes.
+        float v = value[c] > 0.0f ? value[c] : 0.0f;
+        v = v < 1.0f ? v : 1.0f;
+        color |= uint32_t(v * 255.0f + 0.5f) << (8 * c);
+    }
+    return color;
+}
+
+size_t DecodeVertexColorStream(const uint8_t* data, size_t num_bytes, size_t stride, const VertexFormat& format,
+                               uint32_t* dst, size_t max_elements)
+{
+    // decoded in chunks small enough to stay in the l1 cache.
+    const size_t kChunkSize = 256;
+    float value_list[kChunkSize * 4];
+    size_t num_decoded = 0;
+    while (num_decoded < max_elements)
+    {
+        size_t ofs = num_decoded * stride;
+        if (ofs >= num_bytes)
+        {
+            break;
+        }
+
+        size_t count = DecodeVertexStream(data + ofs, num_bytes - ofs, stride, format, value_list, 4, min(kChunkSize, max_elements - num_decoded));
+        if (count == 0)
+        {
+            break;
+        }
+
+        size_t i = 0;
+#if defined(CORE_SIMD_SSE)
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        for (; i < count; i++)
+        {
+            __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(value_list + i * 4), zero), one);
+            __m128i c = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+            c = _mm_packs_epi32(c, c);
+            dst[num_decoded + i] = uint32_t(_mm_cvtsi128_si32(_mm_packus_epi16(c, c)));
+        }
+#endif
+        for (; i < count; i++)
+        {
+            dst[num_decoded + i] = PackVertexColor(value_list + i * 4);
+        }
+        num_decoded += count;
+    }
+    return num_decoded;
+}